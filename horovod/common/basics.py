@@ -19,6 +19,16 @@ import ctypes
 import horovod.common.util as util
 
 
+class _HorovodStats(ctypes.Structure):
+    _fields_ = [('name', ctypes.c_char * 64),
+                ('count', ctypes.c_uint64),
+                ('bytes', ctypes.c_uint64),
+                ('total_us', ctypes.c_uint64),
+                ('p50_us', ctypes.c_uint64),
+                ('p90_us', ctypes.c_uint64),
+                ('p99_us', ctypes.c_uint64)]
+
+
 class HorovodBasics(object):
     """Wrapper class for the basic Horovod API."""
 
@@ -63,6 +73,26 @@ class HorovodBasics(object):
         """A function that shuts Horovod down."""
         self.MPI_LIB_CTYPES.horovod_shutdown()
 
+    def reset(self):
+        """A function that rebuilds the Horovod communicators after the set of
+        processes of the job has changed, for example after some of them were
+        preempted or new ones were added.
+
+        The new rank and sizes are read from the HOROVOD_RANK, HOROVOD_SIZE,
+        HOROVOD_LOCAL_RANK, HOROVOD_LOCAL_SIZE, HOROVOD_CROSS_RANK and
+        HOROVOD_CROSS_SIZE environment variables, and all processes must set
+        HOROVOD_GLOO_RENDEZVOUS_GENERATION to the same new value. Processes that
+        join the job call init() instead. Collective operations that have not
+        completed are aborted. Fusion buffers, tuned parameters and the
+        communicators of nodes whose processes did not change are kept.
+
+        Only supported with Gloo.
+        """
+        if not self.MPI_LIB_CTYPES.horovod_reset():
+            raise RuntimeError(
+                'Horovod reset failed; it requires Horovod to be initialized '
+                'and running with Gloo, see the log for details.')
+
     def size(self):
         """A function that returns the number of Horovod processes.
 
@@ -114,6 +144,61 @@ class HorovodBasics(object):
                 'Horovod has not been initialized; use hvd.init().')
         return local_rank
 
+    def add_process_set(self, ranks):
+        """A function that registers a process set, a subset of the Horovod
+        processes that allreduce tensors among themselves. Allreduces of
+        different process sets do not wait for each other, so disjoint sets
+        make progress concurrently.
+
+        All processes must register the same process sets in the same order,
+        including those that are not members, before any of them allreduces
+        a tensor within one.
+
+        Args:
+          ranks: List of the Horovod ranks of the members.
+
+        Returns:
+          An integer id of the process set, to pass to allreduce. Registering
+          the same ranks again returns the same id.
+        """
+        ranks = list(ranks)
+        process_set_id = self.MPI_LIB_CTYPES.horovod_add_process_set(
+            (ctypes.c_int * len(ranks))(*ranks), ctypes.c_int(len(ranks)))
+        if process_set_id == -1:
+            raise ValueError(
+                'Process set of ranks {} could not be registered; Horovod '
+                'must be initialized and the ranks must be distinct Horovod '
+                'ranks.'.format(ranks))
+        return process_set_id
+
+    def process_set_rank(self, process_set_id):
+        """A function that returns the rank of the calling process within a
+        process set, or -1 if it is not a member.
+
+        Args:
+          process_set_id: Id returned by add_process_set, or 0 for all
+            processes.
+        """
+        if self.MPI_LIB_CTYPES.horovod_process_set_size(process_set_id) == -1:
+            raise ValueError(
+                'Process set {} is not registered, or Horovod has not been '
+                'initialized.'.format(process_set_id))
+        return self.MPI_LIB_CTYPES.horovod_process_set_rank(process_set_id)
+
+    def process_set_size(self, process_set_id):
+        """A function that returns the number of processes in a process set.
+
+        Args:
+          process_set_id: Id returned by add_process_set, or 0 for all
+            processes.
+        """
+        size = self.MPI_LIB_CTYPES.horovod_process_set_size(process_set_id)
+        if size == -1:
+            raise ValueError(
+                'Process set {} is not registered, or Horovod has not been '
+                'initialized.'.format(process_set_id))
+        return size
+
     def mpi_threads_supported(self):
         """A function that returns a flag indicating whether MPI multi-threading is supported.
 
@@ -195,3 +280,118 @@ class HorovodBasics(object):
           A boolean value indicating whether MLSL support was compiled.
         """
         return bool(self.MPI_LIB_CTYPES.horovod_mlsl_built())
+
+    def metrics(self):
+        """A function that returns the runtime metrics of Horovod, such as cycle
+        time, response cache hits and bytes per collective, in the Prometheus
+        text format. Set HOROVOD_METRICS_PORT to also serve them over HTTP on
+        localhost, on that port plus the local rank.
+
+        Returns:
+          A string with the metrics of the calling process.
+        """
+        length = self.MPI_LIB_CTYPES.horovod_metrics(None, 0)
+        if length == -1:
+            raise ValueError(
+                'Horovod has not been initialized; use hvd.init().')
+        # Metrics may grow between the two calls, leave some room.
+        buffer = ctypes.create_string_buffer(length + 4096)
+        self.MPI_LIB_CTYPES.horovod_metrics(buffer, len(buffer))
+        return buffer.value.decode('utf-8')
+
+    def stats(self):
+        """A function that returns where the background thread spends its
+        time: the time between the starts of its cycles, negotiation, waiting
+        for GPU tensors to be ready, copying host tensors into and out of
+        fusion buffers, and executing collectives, both overall and per
+        collective operation class, such as MPIAllreduce or
+        NCCLHierarchicalAllreduce. The memory Horovod currently holds is
+        reported under 'fusion_buffers' and, on GPU builds, 'host_buffers',
+        with the number of buffers as count and their size as bytes.
+
+        Returns:
+          A dictionary from the name of the phase or operation class to a
+          dictionary with its count, bytes, total_us, p50_us, p90_us and
+          p99_us, with times in microseconds.
+        """
+        count = self.MPI_LIB_CTYPES.horovod_get_stats(None, 0)
+        if count == -1:
+            raise ValueError(
+                'Horovod has not been initialized; use hvd.init().')
+        entries = (_HorovodStats * count)()
+        count = min(self.MPI_LIB_CTYPES.horovod_get_stats(entries, count),
+                    count)
+        stats = {}
+        for entry in entries[:count]:
+            stats[entry.name.decode('utf-8')] = {
+                field: getattr(entry, field)
+                for field, _ in _HorovodStats._fields_ if field != 'name'}
+        return stats
+
+    def set_parameters(self, fusion_threshold_bytes=None, cycle_time_ms=None,
+                       cache_capacity=None, hierarchical_allreduce=None,
+                       hierarchical_allgather=None):
+        """A function that sets tuning parameters of all ranks while the job
+        runs, e.g. from an external tuning service. It is called on rank 0
+        only. The parameters are sent to all ranks at the end of the next
+        background loop cycle, after its collectives, so that every rank
+        applies them between the same collectives. Parameters that are set
+        are no longer autotuned.
+
+        Args:
+          fusion_threshold_bytes: Tensor Fusion threshold in bytes.
+          cycle_time_ms: Background loop cycle time in milliseconds.
+          cache_capacity: Capacity of the response cache, zero disables it.
+            Changing it clears the cache.
+          hierarchical_allreduce: Whether to use hierarchical allreduce.
+          hierarchical_allgather: Whether to use hierarchical allgather.
+
+        Parameters left to None keep their current values.
+        """
+        def value(arg, convert):
+            return -1 if arg is None else convert(arg)
+
+        lib = self.MPI_LIB_CTYPES
+        lib.horovod_set_parameters.argtypes = [
+            ctypes.c_int64, ctypes.c_double, ctypes.c_int, ctypes.c_int,
+            ctypes.c_int]
+        lib.horovod_set_parameters.restype = ctypes.c_bool
+        if not lib.horovod_set_parameters(
+                value(fusion_threshold_bytes, int),
+                value(cycle_time_ms, float),
+                value(cache_capacity, int),
+                value(hierarchical_allreduce, int),
+                value(hierarchical_allgather, int)):
+            raise ValueError(
+                'Parameters could not be set; Horovod must be initialized '
+                'and they must be set on rank 0.')
+
+    def start_timeline(self, file_path, mark_cycles=False):
+        """A function that starts recording the timeline of this rank to a
+        file while the job runs, overwriting it, e.g. to capture a short
+        trace of a long job. If the timeline is already recorded, it switches
+        to the new file. Only tensors whose negotiation or operation starts
+        after the call are recorded. Use a different file on every rank that
+        records.
+
+        Args:
+          file_path: Path of the timeline file.
+          mark_cycles: Whether to mark the start of background loop cycles.
+        """
+        lib = self.MPI_LIB_CTYPES
+        lib.horovod_start_timeline.argtypes = [ctypes.c_char_p, ctypes.c_bool]
+        lib.horovod_start_timeline.restype = ctypes.c_bool
+        if not lib.horovod_start_timeline(file_path.encode('utf-8'),
+                                          bool(mark_cycles)):
+            raise ValueError(
+                'Timeline could not be started; Horovod must be initialized '
+                'and the file must be writable.')
+
+    def stop_timeline(self):
+        """A function that stops recording the timeline of this rank, once
+        the events recorded so far are written out."""
+        lib = self.MPI_LIB_CTYPES
+        lib.horovod_stop_timeline.restype = ctypes.c_bool
+        if not lib.horovod_stop_timeline():
+            raise ValueError(
+                'Timeline could not be stopped; Horovod must be initialized.')
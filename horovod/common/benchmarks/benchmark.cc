@@ -0,0 +1,291 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "benchmark.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <regex>
+#include <sstream>
+#include <thread>
+
+namespace horovod {
+namespace common {
+
+namespace {
+
+const int64_t MAX_ITERATIONS = 1000000000;
+
+std::vector<std::unique_ptr<Benchmark>>& Registry() {
+  static std::vector<std::unique_ptr<Benchmark>> registry;
+  return registry;
+}
+
+std::string RunName(const Benchmark& benchmark,
+                    const std::vector<int64_t>& args, int threads) {
+  std::ostringstream name;
+  name << benchmark.name();
+  for (auto arg : args) {
+    name << "/" << arg;
+  }
+  if (threads > 1) {
+    name << "/threads:" << threads;
+  }
+  return name.str();
+}
+
+// Formats value with a k, M or G suffix in powers of 1000, or of 1024 for
+// bytes.
+std::string HumanReadable(double value, bool bytes) {
+  const char* suffixes[] = {"", "k", "M", "G", "T"};
+  double base = bytes ? 1024 : 1000;
+  int i = 0;
+  while (value >= base && i < 4) {
+    value /= base;
+    ++i;
+  }
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%.4g%s%s", value, suffixes[i],
+                bytes && i > 0 ? "i" : "");
+  return buffer;
+}
+
+} // namespace
+
+BenchmarkState::BenchmarkState(int64_t max_iterations,
+                               const std::vector<int64_t>& args,
+                               int thread_index, int threads)
+    : max_iterations_(max_iterations), remaining_(max_iterations),
+      args_(args), thread_index_(thread_index), threads_(threads) {}
+
+bool BenchmarkState::KeepRunning() {
+  if (!started_) {
+    started_ = true;
+    if (wait_for_start_) {
+      wait_for_start_();
+    }
+    start_ = std::chrono::steady_clock::now();
+  }
+  if (remaining_ > 0) {
+    --remaining_;
+    return true;
+  }
+  if (!paused_) {
+    elapsed_ += std::chrono::steady_clock::now() - start_;
+    paused_ = true;
+  }
+  return false;
+}
+
+void BenchmarkState::PauseTiming() {
+  elapsed_ += std::chrono::steady_clock::now() - start_;
+  paused_ = true;
+}
+
+void BenchmarkState::ResumeTiming() {
+  paused_ = false;
+  start_ = std::chrono::steady_clock::now();
+}
+
+Benchmark::Benchmark(const std::string& name, BenchmarkFunction fn)
+    : name_(name), fn_(std::move(fn)) {}
+
+Benchmark* Benchmark::Arg(int64_t arg) {
+  args_.push_back({arg});
+  return this;
+}
+
+Benchmark* Benchmark::Args(const std::vector<int64_t>& args) {
+  args_.push_back(args);
+  return this;
+}
+
+Benchmark* Benchmark::Range(int64_t lo, int64_t hi, int64_t multiplier) {
+  Arg(lo);
+  int64_t arg = 1;
+  while (arg <= lo) {
+    arg *= multiplier;
+  }
+  for (; arg < hi; arg *= multiplier) {
+    Arg(arg);
+  }
+  if (hi > lo) {
+    Arg(hi);
+  }
+  return this;
+}
+
+Benchmark* Benchmark::Threads(int threads) {
+  threads_.push_back(threads);
+  return this;
+}
+
+Benchmark* RegisterBenchmark(const std::string& name, BenchmarkFunction fn) {
+  Registry().emplace_back(new Benchmark(name, std::move(fn)));
+  return Registry().back().get();
+}
+
+class BenchmarkRunner {
+public:
+  struct Result {
+    int64_t iterations = 0;
+    double seconds = 0;
+    int64_t bytes = 0;
+    int64_t items = 0;
+    std::string label;
+  };
+
+  // Runs the benchmark on threads threads, each for the given number of
+  // iterations. The time of the run is that of its slowest thread.
+  static Result Run(const Benchmark& benchmark,
+                    const std::vector<int64_t>& args, int threads,
+                    int64_t iterations) {
+    std::vector<BenchmarkState> states;
+    states.reserve(threads);
+    for (int i = 0; i < threads; ++i) {
+      states.emplace_back(iterations, args, i, threads);
+    }
+
+    if (threads == 1) {
+      benchmark.function()(states[0]);
+    } else {
+      std::atomic_int arrived(0);
+      auto wait_for_start = [&arrived, threads]() {
+        arrived++;
+        while (arrived.load() < threads) {
+          std::this_thread::yield();
+        }
+      };
+      std::vector<std::thread> workers;
+      for (auto& state : states) {
+        state.wait_for_start_ = wait_for_start;
+        workers.emplace_back(
+            [&benchmark, &state]() { benchmark.function()(state); });
+      }
+      for (auto& worker : workers) {
+        worker.join();
+      }
+    }
+
+    Result result;
+    result.iterations = iterations;
+    for (auto& state : states) {
+      result.seconds = std::max(result.seconds, state.elapsed_seconds());
+      result.bytes += state.bytes_processed();
+      result.items += state.items_processed();
+      if (!state.label().empty()) {
+        result.label = state.label();
+      }
+    }
+    return result;
+  }
+};
+
+int RunBenchmarks(int argc, char** argv) {
+  std::string filter = ".";
+  double min_time = 0.5;
+  bool list = false;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg.compare(0, 19, "--benchmark_filter=") == 0) {
+      filter = arg.substr(19);
+    } else if (arg.compare(0, 21, "--benchmark_min_time=") == 0) {
+      min_time = std::atof(arg.substr(21).c_str());
+    } else if (arg == "--benchmark_list") {
+      list = true;
+    } else {
+      std::fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+      return 1;
+    }
+  }
+
+  std::regex filter_regex;
+  try {
+    filter_regex = std::regex(filter);
+  } catch (const std::regex_error& e) {
+    std::fprintf(stderr, "Invalid benchmark filter %s: %s\n", filter.c_str(),
+                 e.what());
+    return 1;
+  }
+
+  if (!list) {
+    std::printf("%-48s %14s %12s %14s\n", "Benchmark", "Time", "Iterations",
+                "Throughput");
+    std::printf("%s\n", std::string(91, '-').c_str());
+  }
+
+  for (auto& benchmark : Registry()) {
+    auto all_args = benchmark->args();
+    if (all_args.empty()) {
+      all_args.emplace_back();
+    }
+    auto all_threads = benchmark->threads();
+    if (all_threads.empty()) {
+      all_threads.push_back(1);
+    }
+
+    for (auto& args : all_args) {
+      for (int threads : all_threads) {
+        auto name = RunName(*benchmark, args, threads);
+        if (!std::regex_search(name, filter_regex)) {
+          continue;
+        }
+        if (list) {
+          std::printf("%s\n", name.c_str());
+          continue;
+        }
+
+        // Grow the number of iterations until a run takes the minimum time.
+        int64_t iterations = 1;
+        BenchmarkRunner::Result result;
+        while (true) {
+          result = BenchmarkRunner::Run(*benchmark, args, threads, iterations);
+          if (result.seconds >= min_time || iterations >= MAX_ITERATIONS) {
+            break;
+          }
+          double multiplier =
+              result.seconds > 0 ? min_time * 1.4 / result.seconds : 10;
+          multiplier = std::min(std::max(multiplier, 1.5), 10.0);
+          iterations = std::min(
+              std::max((int64_t)(iterations * multiplier), iterations + 1),
+              MAX_ITERATIONS);
+        }
+
+        char time[32];
+        std::snprintf(time, sizeof(time), "%.0f ns",
+                      result.seconds * 1e9 / result.iterations);
+        std::string throughput;
+        if (result.bytes > 0) {
+          throughput = HumanReadable(result.bytes / result.seconds, true) +
+                       "B/s";
+        } else if (result.items > 0) {
+          throughput =
+              HumanReadable(result.items / result.seconds, false) + " items/s";
+        }
+        std::printf("%-48s %14s %12lld %14s %s\n", name.c_str(), time,
+                    (long long)result.iterations, throughput.c_str(),
+                    result.label.c_str());
+        std::fflush(stdout);
+      }
+    }
+  }
+  return 0;
+}
+
+} // namespace common
+} // namespace horovod
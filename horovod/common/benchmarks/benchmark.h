@@ -0,0 +1,156 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HOROVOD_BENCHMARK_H
+#define HOROVOD_BENCHMARK_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace horovod {
+namespace common {
+
+// A small benchmark runner following the interface of Google Benchmark, so
+// that benchmarks of the core library build without another dependency:
+//
+//   void BM_Example(BenchmarkState& state) {
+//     // Setup, not timed.
+//     while (state.KeepRunning()) {
+//       // Timed.
+//     }
+//     state.SetItemsProcessed(state.iterations() * state.range(0));
+//   }
+//   HOROVOD_BENCHMARK(BM_Example)->Arg(16)->Arg(1024);
+//
+// Every benchmark runs with an increasing number of iterations until it takes
+// at least the minimum time, and the time per iteration of the last run is
+// reported.
+class BenchmarkState {
+public:
+  BenchmarkState(int64_t max_iterations, const std::vector<int64_t>& args,
+                 int thread_index, int threads);
+
+  // Whether to run another iteration. Timing starts with the first call and
+  // stops with the call that returns false.
+  bool KeepRunning();
+
+  // Excludes per iteration setup from the measured time.
+  void PauseTiming();
+  void ResumeTiming();
+
+  // Arguments of this run, as set with Arg or Args.
+  int64_t range(size_t index = 0) const { return args_.at(index); }
+
+  // Index of this thread among the threads running the benchmark, and their
+  // number, as set with Threads.
+  int thread_index() const { return thread_index_; }
+  int threads() const { return threads_; }
+
+  int64_t iterations() const { return max_iterations_; }
+
+  // Reported as throughput over the measured time.
+  void SetBytesProcessed(int64_t bytes) { bytes_processed_ = bytes; }
+  void SetItemsProcessed(int64_t items) { items_processed_ = items; }
+
+  // Appended to the output line of the run.
+  void SetLabel(const std::string& label) { label_ = label; }
+
+  double elapsed_seconds() const { return elapsed_.count(); }
+  int64_t bytes_processed() const { return bytes_processed_; }
+  int64_t items_processed() const { return items_processed_; }
+  const std::string& label() const { return label_; }
+
+private:
+  friend class BenchmarkRunner;
+
+  int64_t max_iterations_;
+  int64_t remaining_;
+  bool started_ = false;
+  bool paused_ = false;
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::duration<double> elapsed_{0};
+
+  std::vector<int64_t> args_;
+  int thread_index_;
+  int threads_;
+
+  // Called before timing starts, so that threads start measuring together.
+  std::function<void()> wait_for_start_;
+
+  int64_t bytes_processed_ = 0;
+  int64_t items_processed_ = 0;
+  std::string label_;
+};
+
+using BenchmarkFunction = std::function<void(BenchmarkState&)>;
+
+class Benchmark {
+public:
+  Benchmark(const std::string& name, BenchmarkFunction fn);
+
+  // Adds a run with the given arguments.
+  Benchmark* Arg(int64_t arg);
+  Benchmark* Args(const std::vector<int64_t>& args);
+
+  // Adds runs for lo, powers of multiplier between lo and hi, and hi.
+  Benchmark* Range(int64_t lo, int64_t hi, int64_t multiplier = 8);
+
+  // Runs the benchmark on the given number of threads at once, in addition
+  // to the numbers already set. Each thread runs all the iterations.
+  Benchmark* Threads(int threads);
+
+  const std::string& name() const { return name_; }
+  const BenchmarkFunction& function() const { return fn_; }
+  const std::vector<std::vector<int64_t>>& args() const { return args_; }
+  const std::vector<int>& threads() const { return threads_; }
+
+private:
+  std::string name_;
+  BenchmarkFunction fn_;
+  std::vector<std::vector<int64_t>> args_;
+  std::vector<int> threads_;
+};
+
+// Registers a benchmark to be run by RunBenchmarks. The returned benchmark is
+// owned by the registry.
+Benchmark* RegisterBenchmark(const std::string& name, BenchmarkFunction fn);
+
+// Runs the registered benchmarks and prints one line per run. Accepts
+//   --benchmark_filter=<regex>  only run benchmarks whose name matches,
+//   --benchmark_min_time=<s>    minimum time of a run, 0.5 by default,
+//   --benchmark_list            print the names of the runs and exit.
+// Returns the exit code of the program.
+int RunBenchmarks(int argc, char** argv);
+
+// Keeps the compiler from optimizing away the computation of value.
+template <class T> inline void DoNotOptimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+} // namespace common
+} // namespace horovod
+
+#define HOROVOD_BENCHMARK_CONCAT_(a, b) a##b
+#define HOROVOD_BENCHMARK_CONCAT(a, b) HOROVOD_BENCHMARK_CONCAT_(a, b)
+
+#define HOROVOD_BENCHMARK(fn)                                                  \
+  static ::horovod::common::Benchmark* HOROVOD_BENCHMARK_CONCAT(               \
+      benchmark_, __LINE__) __attribute__((unused)) =                          \
+      ::horovod::common::RegisterBenchmark(#fn, fn)
+
+#endif // HOROVOD_BENCHMARK_H
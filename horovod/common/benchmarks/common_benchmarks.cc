@@ -0,0 +1,396 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+// Microbenchmarks of the data and control paths of the core library, run in a
+// single process. Negotiation goes through MockController, which takes the
+// coordinator path of a job of the given size without communicating.
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../global_state.h"
+#include "../half.h"
+#include "../ops/collective_operations.h"
+#include "benchmark.h"
+#include "mock_controller.h"
+
+namespace horovod {
+namespace common {
+
+namespace {
+
+// Typical size of a gradient tensor name.
+std::string TensorName(int i) {
+  return "DistributedOptimizer_Allreduce/gradients/layer_" +
+         std::to_string(i) + "/kernel";
+}
+
+// Tensor queue and controller of a single process job. Too large for the
+// stack.
+struct ControlPlane {
+  explicit ControlPlane(int size = 1) {
+    controller = std::make_shared<MockController>(
+        response_cache, tensor_queue, timeline, parameter_manager, size);
+    controller->Initialize();
+  }
+
+  // Enqueues num_tensors float32 allreduces of num_elements each and makes
+  // them visible to the controller. Returns their requests.
+  std::vector<Request> Enqueue(int num_tensors, int64_t num_elements) {
+    std::vector<Request> requests;
+    for (int i = 0; i < num_tensors; ++i) {
+      TensorTableEntry entry;
+      Request request;
+      MakeAllreduceTensor(TensorName(i), HOROVOD_FLOAT32, num_elements, entry,
+                          request);
+      requests.push_back(request);
+      tensor_queue.AddToTensorQueue(entry, request);
+    }
+    return requests;
+  }
+
+  // Removes the tensors of a response list from the tensor queue, as
+  // performing the operations does.
+  void Complete(ResponseList& response_list) {
+    for (auto response : response_list.responses()) {
+      std::vector<TensorTableEntry> entries;
+      tensor_queue.GetTensorEntriesFromResponse(response, entries);
+    }
+  }
+
+  ResponseCache response_cache;
+  TensorQueue tensor_queue;
+  Timeline timeline;
+  ParameterManager parameter_manager;
+  std::shared_ptr<MockController> controller;
+};
+
+std::deque<Response> AllreduceResponses(int num_tensors) {
+  std::deque<Response> responses;
+  for (int i = 0; i < num_tensors; ++i) {
+    Response response;
+    response.set_response_type(Response::ALLREDUCE);
+    response.add_tensor_name(TensorName(i));
+    response.add_device(CPU_DEVICE_ID);
+    responses.push_back(std::move(response));
+  }
+  return responses;
+}
+
+// Fuses range(0) allreduces of 4 KB.
+void BM_FuseResponses(BenchmarkState& state) {
+  int num_tensors = (int)state.range(0);
+  std::unique_ptr<ControlPlane> plane(new ControlPlane());
+  plane->Enqueue(num_tensors, 1024);
+  std::deque<Request> messages;
+  plane->tensor_queue.PopMessagesFromQueue(messages);
+  auto responses = AllreduceResponses(num_tensors);
+
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    auto batch = responses;
+    state.ResumeTiming();
+    auto response_list = plane->controller->FuseResponses(batch);
+    DoNotOptimize(response_list);
+  }
+  state.SetItemsProcessed(state.iterations() * num_tensors);
+}
+HOROVOD_BENCHMARK(BM_FuseResponses)->Range(8, 4096);
+
+// Puts range(0) responses into an empty cache with room for all of them.
+void BM_ResponseCachePut(BenchmarkState& state) {
+  int num_tensors = (int)state.range(0);
+  std::unique_ptr<ControlPlane> plane(new ControlPlane());
+  plane->Enqueue(num_tensors, 1024);
+  std::deque<Request> messages;
+  plane->tensor_queue.PopMessagesFromQueue(messages);
+  auto responses = AllreduceResponses(num_tensors);
+
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    plane->response_cache.clear();
+    plane->response_cache.set_capacity((uint32_t)num_tensors);
+    state.ResumeTiming();
+    for (auto& response : responses) {
+      plane->response_cache.put(response, plane->tensor_queue);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * num_tensors);
+}
+HOROVOD_BENCHMARK(BM_ResponseCachePut)->Range(8, 4096);
+
+// Looks up the requests of range(0) cached responses, as every cycle does
+// for the tensors enqueued since the last one.
+void BM_ResponseCacheGet(BenchmarkState& state) {
+  int num_tensors = (int)state.range(0);
+  std::unique_ptr<ControlPlane> plane(new ControlPlane());
+  plane->Enqueue(num_tensors, 1024);
+  std::deque<Request> messages;
+  plane->tensor_queue.PopMessagesFromQueue(messages);
+  plane->response_cache.set_capacity((uint32_t)num_tensors);
+  for (auto& response : AllreduceResponses(num_tensors)) {
+    plane->response_cache.put(response, plane->tensor_queue);
+  }
+
+  while (state.KeepRunning()) {
+    for (auto& message : messages) {
+      if (plane->response_cache.cached(message) ==
+          ResponseCache::CacheState::HIT) {
+        auto bit = plane->response_cache.peek_cache_bit(message);
+        DoNotOptimize(plane->response_cache.get_response(bit));
+      }
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * num_tensors);
+}
+HOROVOD_BENCHMARK(BM_ResponseCacheGet)->Range(8, 4096);
+
+// Synchronizes range(0) cache hits, the bit vector exchange of every cycle.
+void BM_CacheCoordinatorSync(BenchmarkState& state) {
+  int num_tensors = (int)state.range(0);
+  std::unique_ptr<ControlPlane> plane(new ControlPlane());
+  plane->Enqueue(num_tensors, 1024);
+  std::deque<Request> messages;
+  plane->tensor_queue.PopMessagesFromQueue(messages);
+  plane->response_cache.set_capacity((uint32_t)num_tensors);
+  for (auto& response : AllreduceResponses(num_tensors)) {
+    plane->response_cache.put(response, plane->tensor_queue);
+  }
+
+  while (state.KeepRunning()) {
+    CacheCoordinator cache_coordinator(plane->response_cache.num_active_bits());
+    for (int bit = 0; bit < num_tensors; ++bit) {
+      cache_coordinator.record_hit((uint32_t)bit);
+    }
+    cache_coordinator.sync(plane->controller, false);
+    DoNotOptimize(cache_coordinator.cache_hits());
+  }
+  state.SetItemsProcessed(state.iterations() * num_tensors);
+}
+HOROVOD_BENCHMARK(BM_CacheCoordinatorSync)->Range(8, 4096);
+
+// One full negotiation cycle of the coordinator for range(0) tensors enqueued
+// by range(1) ranks, of which none or all are cached as set by range(2).
+void BM_ComputeResponseList(BenchmarkState& state) {
+  int num_tensors = (int)state.range(0);
+  int size = (int)state.range(1);
+  bool cached = state.range(2) != 0;
+  std::unique_ptr<ControlPlane> plane(new ControlPlane(size));
+  plane->response_cache.set_capacity(cached ? (uint32_t)num_tensors : 0);
+  std::atomic_bool shut_down(false);
+
+  if (cached) {
+    // Negotiate the tensors once so that they are cached.
+    plane->controller->SetPeerRequests(plane->Enqueue(num_tensors, 1024));
+    auto response_list = plane->controller->ComputeResponseList(shut_down);
+    plane->Complete(response_list);
+  }
+
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    plane->controller->SetPeerRequests(plane->Enqueue(num_tensors, 1024));
+    state.ResumeTiming();
+    auto response_list = plane->controller->ComputeResponseList(shut_down);
+    state.PauseTiming();
+    plane->Complete(response_list);
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * num_tensors);
+  state.SetLabel(cached ? "cached" : "uncached");
+}
+HOROVOD_BENCHMARK(BM_ComputeResponseList)
+    ->Args({64, 1, 0})
+    ->Args({64, 1, 1})
+    ->Args({1024, 1, 0})
+    ->Args({1024, 1, 1})
+    ->Args({1024, 64, 0});
+
+std::vector<Request> Requests(int num_tensors) {
+  std::vector<Request> requests;
+  for (int i = 0; i < num_tensors; ++i) {
+    TensorTableEntry entry;
+    Request request;
+    MakeAllreduceTensor(TensorName(i), HOROVOD_FLOAT32, 1024, entry, request);
+    requests.push_back(std::move(request));
+  }
+  return requests;
+}
+
+// Encodes a list of range(0) requests, as every uncached worker does.
+void BM_RequestListSerialize(BenchmarkState& state) {
+  RequestList request_list;
+  request_list.set_requests(Requests((int)state.range(0)));
+  std::string encoded;
+  while (state.KeepRunning()) {
+    RequestList::SerializeToString(request_list, encoded);
+  }
+  state.SetBytesProcessed(state.iterations() * (int64_t)encoded.size());
+}
+HOROVOD_BENCHMARK(BM_RequestListSerialize)->Range(8, 4096);
+
+// Decodes a list of range(0) requests, as the coordinator does for each
+// worker.
+void BM_RequestListParse(BenchmarkState& state) {
+  RequestList request_list;
+  request_list.set_requests(Requests((int)state.range(0)));
+  std::string encoded;
+  RequestList::SerializeToString(request_list, encoded);
+  while (state.KeepRunning()) {
+    RequestList parsed;
+    RequestList::ParseFromBytes(parsed, (const uint8_t*)encoded.c_str());
+    DoNotOptimize(parsed);
+  }
+  state.SetBytesProcessed(state.iterations() * (int64_t)encoded.size());
+}
+HOROVOD_BENCHMARK(BM_RequestListParse)->Range(8, 4096);
+
+// Sums range(0) float16 values, the reduction of MPI and Gloo float16
+// allreduces and of compressed CPU allreduces.
+void BM_Float16Sum(BenchmarkState& state) {
+  int64_t n = state.range(0);
+  std::vector<uint16_t> a((size_t)n, 0x3c00), b((size_t)n, 0x3c00);
+  std::vector<uint16_t> out((size_t)n);
+  while (state.KeepRunning()) {
+    Float16Sum(a.data(), b.data(), out.data(), n);
+    DoNotOptimize(out.data());
+  }
+  state.SetBytesProcessed(state.iterations() * n * (int64_t)sizeof(uint16_t));
+}
+HOROVOD_BENCHMARK(BM_Float16Sum)->Range(1 << 10, 1 << 22, 16);
+
+void BM_BFloat16Sum(BenchmarkState& state) {
+  int64_t n = state.range(0);
+  std::vector<uint16_t> a((size_t)n, 0x3f80), b((size_t)n, 0x3f80);
+  std::vector<uint16_t> out((size_t)n);
+  while (state.KeepRunning()) {
+    BFloat16Sum(a.data(), b.data(), out.data(), n);
+    DoNotOptimize(out.data());
+  }
+  state.SetBytesProcessed(state.iterations() * n * (int64_t)sizeof(uint16_t));
+}
+HOROVOD_BENCHMARK(BM_BFloat16Sum)->Range(1 << 10, 1 << 22, 16);
+
+// Exposes the fusion buffer copies of CPU allreduces.
+class FusionBufferOp : public AllreduceOp {
+public:
+  explicit FusionBufferOp(HorovodGlobalState* global_state)
+      : AllreduceOp(global_state) {}
+
+  Status Execute(std::vector<TensorTableEntry>& entries,
+                 const Response& response) override {
+    const void* fused_input_data;
+    void* buffer_data;
+    size_t buffer_len;
+    MemcpyInFusionBuffer(entries, fused_input_data, buffer_data, buffer_len);
+    MemcpyOutFusionBuffer(buffer_data, entries);
+    return Status::OK();
+  }
+
+  bool Enabled(const ParameterManager& param_manager,
+               const std::vector<TensorTableEntry>& entries,
+               const Response& response) const override {
+    return true;
+  }
+};
+
+// Packs range(0) float32 tensors of range(1) elements each into the fusion
+// buffer and unpacks them, with range(2) memcpy threads besides the calling
+// one.
+void BM_FusionBufferCopy(BenchmarkState& state) {
+  int num_tensors = (int)state.range(0);
+  int64_t num_elements = state.range(1);
+  std::unique_ptr<HorovodGlobalState> global_state(new HorovodGlobalState());
+  if (state.range(2) > 0) {
+    global_state->fusion_memcpy_pool.Create((int)state.range(2), -1);
+  }
+
+  std::vector<TensorTableEntry> entries((size_t)num_tensors);
+  for (int i = 0; i < num_tensors; ++i) {
+    Request request;
+    MakeAllreduceTensor(TensorName(i), HOROVOD_FLOAT32, num_elements,
+                        entries[i], request);
+  }
+  int64_t total_bytes = num_tensors * num_elements * (int64_t)sizeof(float);
+  global_state->fusion_buffer.InitializeBuffer(
+      total_bytes, CPU_DEVICE_ID, entries[0].context, 0, []() {}, []() {});
+
+  FusionBufferOp op(global_state.get());
+  Response response;
+  while (state.KeepRunning()) {
+    op.Execute(entries, response);
+  }
+  state.SetBytesProcessed(state.iterations() * 2 * total_bytes);
+  global_state->fusion_memcpy_pool.Shutdown();
+}
+HOROVOD_BENCHMARK(BM_FusionBufferCopy)
+    ->Args({16, 1 << 18, 0})
+    ->Args({256, 1 << 14, 0})
+    ->Args({4096, 1 << 10, 0})
+    ->Args({16, 1 << 18, 4})
+    ->Args({256, 1 << 14, 4});
+
+// Framework threads enqueueing tensors while they are drained, as the
+// background thread does every cycle. Each thread enqueues batches of
+// range(0) tensors and then drains the queue and takes its tensors out.
+void BM_TensorQueueEnqueue(BenchmarkState& state) {
+  static TensorQueue tensor_queue;
+  int batch_size = (int)state.range(0);
+
+  std::vector<TensorTableEntry> entries((size_t)batch_size);
+  std::vector<Request> requests((size_t)batch_size);
+  Response response;
+  response.set_response_type(Response::ALLREDUCE);
+  for (int i = 0; i < batch_size; ++i) {
+    auto name = "thread_" + std::to_string(state.thread_index()) + "/" +
+                TensorName(i);
+    entries[i].tensor_name = name;
+    requests[i].set_tensor_name(name);
+    requests[i].set_request_type(Request::ALLREDUCE);
+    response.add_tensor_name(name);
+  }
+
+  std::deque<Request> messages;
+  std::vector<TensorTableEntry> done;
+  while (state.KeepRunning()) {
+    for (int i = 0; i < batch_size; ++i) {
+      auto entry = entries[i];
+      auto request = requests[i];
+      tensor_queue.AddToTensorQueue(entry, request);
+    }
+    tensor_queue.PopMessagesFromQueue(messages);
+    messages.clear();
+    done.clear();
+    tensor_queue.GetTensorEntriesFromResponse(response, done);
+  }
+  state.SetItemsProcessed(state.iterations() * batch_size);
+}
+HOROVOD_BENCHMARK(BM_TensorQueueEnqueue)
+    ->Arg(64)
+    ->Threads(1)
+    ->Threads(2)
+    ->Threads(4)
+    ->Threads(8);
+
+} // namespace
+
+} // namespace common
+} // namespace horovod
+
+int main(int argc, char** argv) {
+  return horovod::common::RunBenchmarks(argc, argv);
+}
@@ -0,0 +1,580 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+// Collective benchmark of the whole library, launched like a training job:
+//
+//   mpirun -np 8 hvd_bench --ops=allreduce --min_bytes=1K --max_bytes=64M
+//
+// Every measurement enqueues a number of tensors of one size and type through
+// the same entry points as the framework ops, and waits for their callbacks,
+// so that negotiation, fusion and the collective operation are all included.
+// Allreduces are run on each registered allreduce operation in turn. Rank 0
+// prints the algorithm and bus bandwidth, the latency percentiles of the
+// slowest rank, and the negotiation time of the background thread.
+//
+// The fusion threshold, cycle time and other knobs are read from the usual
+// HOROVOD_* environment variables at startup.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if HAVE_CUDA
+#include <cuda_runtime.h>
+#endif
+
+#include "../common.h"
+#include "../operations.h"
+#include "mock_controller.h"
+
+namespace horovod {
+namespace common {
+
+namespace {
+
+struct Options {
+  std::vector<std::string> ops = {"allreduce", "allgather", "broadcast"};
+  std::vector<DataType> dtypes = {HOROVOD_FLOAT32};
+  int64_t min_bytes = 1024;
+  int64_t max_bytes = 64 * 1024 * 1024;
+  int64_t step_factor = 4;
+  std::vector<int64_t> tensors = {1};
+  // Indices into the registered allreduce operations, empty for all of them.
+  std::vector<int64_t> allreduce_ops;
+  int iters = 20;
+  int warmup = 5;
+  bool gpu = false;
+};
+
+const char* USAGE =
+    "Usage: hvd_bench [options]\n"
+    "  --ops=allreduce,allgather,broadcast  collectives to run\n"
+    "  --dtypes=float32                     tensor types to run\n"
+    "  --min_bytes=1K --max_bytes=64M       range of the tensor sizes\n"
+    "  --step_factor=4                      ratio of consecutive sizes\n"
+    "  --tensors=1                          tensors per step, as a list\n"
+    "  --allreduce_ops=0,1                  indices of the allreduce operations,\n"
+    "                                       all of them by default\n"
+    "  --iters=20 --warmup=5                timed and untimed steps\n"
+#if HAVE_CUDA
+    "  --device=cpu|gpu                     where tensors are allocated\n"
+#endif
+    ;
+
+std::vector<std::string> Split(const std::string& value) {
+  std::vector<std::string> parts;
+  std::stringstream stream(value);
+  std::string part;
+  while (std::getline(stream, part, ',')) {
+    if (!part.empty()) {
+      parts.push_back(part);
+    }
+  }
+  return parts;
+}
+
+// Parses a byte count with an optional K, M or G suffix in powers of 1024.
+int64_t ParseBytes(const std::string& value) {
+  char* end = nullptr;
+  auto bytes = (int64_t)std::strtoll(value.c_str(), &end, 10);
+  switch (*end) {
+  case 'K':
+  case 'k':
+    return bytes << 10;
+  case 'M':
+  case 'm':
+    return bytes << 20;
+  case 'G':
+  case 'g':
+    return bytes << 30;
+  case '\0':
+    return bytes;
+  default:
+    throw std::invalid_argument("Invalid byte count " + value + ".");
+  }
+}
+
+DataType ParseDataType(const std::string& name) {
+  static const DataType dtypes[] = {
+      HOROVOD_UINT8,   HOROVOD_INT8,    HOROVOD_INT32,   HOROVOD_INT64,
+      HOROVOD_FLOAT16, HOROVOD_FLOAT32, HOROVOD_FLOAT64, HOROVOD_BFLOAT16};
+  for (auto dtype : dtypes) {
+    auto dtype_name = DataType_Name(dtype);
+    std::transform(dtype_name.begin(), dtype_name.end(), dtype_name.begin(),
+                   ::tolower);
+    if (name == dtype_name) {
+      return dtype;
+    }
+  }
+  throw std::invalid_argument("Unsupported type " + name + ".");
+}
+
+Options ParseOptions(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    auto eq = arg.find('=');
+    auto key = arg.substr(0, eq);
+    auto value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+    if (key == "--ops") {
+      options.ops = Split(value);
+    } else if (key == "--dtypes") {
+      options.dtypes.clear();
+      for (auto& name : Split(value)) {
+        options.dtypes.push_back(ParseDataType(name));
+      }
+    } else if (key == "--min_bytes") {
+      options.min_bytes = ParseBytes(value);
+    } else if (key == "--max_bytes") {
+      options.max_bytes = ParseBytes(value);
+    } else if (key == "--step_factor") {
+      options.step_factor = std::max(std::atoll(value.c_str()), 2LL);
+    } else if (key == "--tensors" || key == "--allreduce_ops") {
+      auto& list = key == "--tensors" ? options.tensors : options.allreduce_ops;
+      list.clear();
+      for (auto& part : Split(value)) {
+        list.push_back(std::atoll(part.c_str()));
+      }
+    } else if (key == "--iters") {
+      options.iters = std::max(std::atoi(value.c_str()), 1);
+    } else if (key == "--warmup") {
+      options.warmup = std::max(std::atoi(value.c_str()), 0);
+#if HAVE_CUDA
+    } else if (key == "--device" && (value == "cpu" || value == "gpu")) {
+      options.gpu = value == "gpu";
+#endif
+    } else {
+      throw std::invalid_argument("Unknown argument " + arg + ".\n" + USAGE);
+    }
+  }
+  for (auto& op : options.ops) {
+    if (op != "allreduce" && op != "allgather" && op != "broadcast") {
+      throw std::invalid_argument("Unknown collective " + op + ".");
+    }
+  }
+  return options;
+}
+
+int ElementSize(DataType dtype) {
+  switch (dtype) {
+  case HOROVOD_UINT8:
+  case HOROVOD_INT8:
+    return 1;
+  case HOROVOD_FLOAT16:
+  case HOROVOD_BFLOAT16:
+    return 2;
+  case HOROVOD_INT32:
+  case HOROVOD_FLOAT32:
+    return 4;
+  default:
+    return 8;
+  }
+}
+
+#if HAVE_CUDA
+// Device memory of the current device, released with the tensor.
+class GPUTensor : public Tensor {
+public:
+  GPUTensor(DataType dtype, const TensorShape& shape)
+      : dtype_(dtype), shape_(shape),
+        size_(shape.num_elements() * ElementSize(dtype)) {
+    if (cudaMalloc(&data_, (size_t)std::max(size_, (int64_t)1)) !=
+        cudaSuccess) {
+      throw std::runtime_error("cudaMalloc failed for a benchmark tensor.");
+    }
+    cudaMemset(data_, 0, (size_t)size_);
+  }
+  ~GPUTensor() override { cudaFree(data_); }
+
+  const DataType dtype() const override { return dtype_; }
+  const TensorShape shape() const override { return shape_; }
+  const void* data() const override { return data_; }
+  int64_t size() const override { return size_; }
+
+private:
+  DataType dtype_;
+  TensorShape shape_;
+  int64_t size_;
+  void* data_ = nullptr;
+};
+
+class GPUPersistentBuffer : public PersistentBuffer {
+public:
+  explicit GPUPersistentBuffer(int64_t size) {
+    if (cudaMalloc(&data_, (size_t)size) != cudaSuccess) {
+      throw std::runtime_error("cudaMalloc failed for the fusion buffer.");
+    }
+  }
+  ~GPUPersistentBuffer() override { cudaFree(data_); }
+
+  const void* AccessData(std::shared_ptr<OpContext> context) const override {
+    return data_;
+  }
+
+private:
+  void* data_ = nullptr;
+};
+
+// Allocates memory of the given device, as the TensorFlow context does for
+// GPU tensors.
+class GPUOpContext : public OpContext {
+public:
+  GPUOpContext(DataType dtype, int device) : dtype_(dtype), device_(device) {}
+
+  Status AllocatePersistent(int64_t size,
+                            std::shared_ptr<PersistentBuffer>* tensor) override {
+    cudaSetDevice(device_);
+    *tensor = std::make_shared<GPUPersistentBuffer>(size);
+    return Status::OK();
+  }
+
+  Status AllocateOutput(TensorShape shape,
+                        std::shared_ptr<Tensor>* tensor) override {
+    cudaSetDevice(device_);
+    *tensor = std::make_shared<GPUTensor>(dtype_, shape);
+    return Status::OK();
+  }
+
+  Framework framework() const override { return Framework::TENSORFLOW; }
+
+private:
+  DataType dtype_;
+  int device_;
+};
+#endif
+
+// Tensors of one measurement, enqueued together each step.
+class Step {
+public:
+  Step(const std::string& op, DataType dtype, int64_t bytes, int64_t count,
+       bool gpu)
+      : op_(op), device_(CPU_DEVICE_ID) {
+    TensorShape shape;
+    shape.AddDim(std::max(bytes / ElementSize(dtype), (int64_t)1));
+#if HAVE_CUDA
+    if (gpu) {
+      device_ = horovod_local_rank();
+      cudaSetDevice(device_);
+    }
+#endif
+    for (int64_t i = 0; i < count; ++i) {
+      std::stringstream name;
+      name << "hvd_bench." << op << "." << DataType_Name(dtype) << "."
+           << bytes << "." << i;
+      names_.push_back(name.str());
+#if HAVE_CUDA
+      if (gpu) {
+        contexts_.push_back(std::make_shared<GPUOpContext>(dtype, device_));
+        tensors_.push_back(std::make_shared<GPUTensor>(dtype, shape));
+        outputs_.push_back(op == "allreduce"
+                               ? std::make_shared<GPUTensor>(dtype, shape)
+                               : tensors_.back());
+        continue;
+      }
+#endif
+      contexts_.push_back(std::make_shared<MockOpContext>(dtype));
+      tensors_.push_back(std::make_shared<MockTensor>(dtype, shape));
+      // Broadcasts run in place, like the framework ops.
+      outputs_.push_back(op == "allreduce"
+                             ? std::make_shared<MockTensor>(dtype, shape)
+                             : tensors_.back());
+    }
+  }
+
+  // Enqueues all tensors and waits for their callbacks. Returns false if any
+  // of them failed.
+  bool Run() {
+    pending_ = (int)names_.size();
+    ok_ = true;
+    for (size_t i = 0; i < names_.size(); ++i) {
+      auto callback = [this](const Status& status) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if (!status.ok()) {
+          ok_ = false;
+          error_ = status.reason();
+        }
+        if (--pending_ == 0) {
+          done_.notify_one();
+        }
+      };
+      Status status;
+      if (op_ == "allreduce") {
+        status = EnqueueTensorAllreduce(contexts_[i], tensors_[i], outputs_[i],
+                                        nullptr, names_[i], device_, callback);
+      } else if (op_ == "allgather") {
+        status = EnqueueTensorAllgather(contexts_[i], tensors_[i], nullptr,
+                                        names_[i], device_, callback);
+      } else {
+        status = EnqueueTensorBroadcast(contexts_[i], tensors_[i], outputs_[i],
+                                        0, nullptr, names_[i], device_,
+                                        callback);
+      }
+      if (!status.ok()) {
+        throw std::runtime_error(status.reason());
+      }
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this]() { return pending_ == 0; });
+    return ok_;
+  }
+
+  const std::string& error() const { return error_; }
+
+private:
+  std::string op_;
+  int device_;
+  std::vector<std::string> names_;
+  std::vector<std::shared_ptr<OpContext>> contexts_;
+  std::vector<std::shared_ptr<Tensor>> tensors_;
+  std::vector<std::shared_ptr<Tensor>> outputs_;
+
+  std::mutex mutex_;
+  std::condition_variable done_;
+  int pending_ = 0;
+  bool ok_ = true;
+  std::string error_;
+};
+
+// Value of the first sample of the given metric in the Prometheus text.
+double MetricValue(const std::string& text, const std::string& name) {
+  auto pos = text.find("\n" + name + " ");
+  if (pos == std::string::npos) {
+    return 0;
+  }
+  return std::atof(text.c_str() + pos + name.size() + 2);
+}
+
+double NegotiationMicroseconds() {
+  int length = horovod_metrics(nullptr, 0);
+  std::string text((size_t)length + 1, '\0');
+  horovod_metrics(&text[0], length + 1);
+  return MetricValue(text, "horovod_negotiation_time_microseconds_sum");
+}
+
+// Elementwise maximum over all ranks, through a Horovod allreduce.
+std::vector<double> MaxOverRanks(const std::vector<double>& values) {
+  TensorShape shape;
+  shape.AddDim((int64_t)values.size());
+  auto context = std::make_shared<MockOpContext>(HOROVOD_FLOAT64);
+  auto tensor = std::make_shared<MockTensor>(HOROVOD_FLOAT64, shape);
+  auto output = std::make_shared<MockTensor>(HOROVOD_FLOAT64, shape);
+  std::memcpy(tensor->mutable_data(), values.data(),
+              values.size() * sizeof(double));
+
+  std::mutex mutex;
+  std::condition_variable done_cv;
+  bool done = false;
+  auto status = EnqueueTensorAllreduce(
+      context, tensor, output, nullptr, "hvd_bench.stats", CPU_DEVICE_ID,
+      [&](const Status& status) {
+        std::lock_guard<std::mutex> guard(mutex);
+        done = true;
+        done_cv.notify_one();
+      },
+      0, 1.0, 1.0, ReduceOp::MAX);
+  if (!status.ok()) {
+    throw std::runtime_error(status.reason());
+  }
+  std::unique_lock<std::mutex> lock(mutex);
+  done_cv.wait(lock, [&]() { return done; });
+
+  std::vector<double> result(values.size());
+  std::memcpy(result.data(), output->data(), values.size() * sizeof(double));
+  return result;
+}
+
+double Percentile(std::vector<double> sorted, double fraction) {
+  auto index = (size_t)(fraction * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(index, sorted.size() - 1)];
+}
+
+// Ratio of the bus bandwidth to the algorithm bandwidth, which makes results
+// comparable across job sizes: every rank sends and receives (n-1)/n of the
+// data per ring pass, and an allreduce takes two passes.
+double BusBandwidthFactor(const std::string& op, int size) {
+  if (op == "allreduce") {
+    return 2.0 * (size - 1) / size;
+  }
+  if (op == "allgather") {
+    return (double)(size - 1) / size;
+  }
+  return 1.0;
+}
+
+void PrintHeader(const std::string& op, const std::string& algorithm,
+                 DataType dtype) {
+  std::printf("\n# %s %s %s\n", op.c_str(), algorithm.c_str(),
+              DataType_Name(dtype).c_str());
+  std::printf("%12s %8s %10s %10s %10s %12s %12s %12s\n", "bytes", "tensors",
+              "p50(us)", "p90(us)", "p99(us)", "algbw(GB/s)", "busbw(GB/s)",
+              "negot(us)");
+}
+
+// Runs all sizes and tensor counts of one collective, type and algorithm,
+// given by the index of the allreduce operation, or -1 for the default.
+void RunSweep(const Options& options, const std::string& op,
+              const std::string& algorithm, int allreduce_op, DataType dtype) {
+  int rank = horovod_rank();
+  int size = horovod_size();
+  bool header = false;
+  for (auto count : options.tensors) {
+    for (int64_t bytes = options.min_bytes; bytes <= options.max_bytes;
+         bytes *= options.step_factor) {
+      Step step(op, dtype, bytes, count, options.gpu);
+      bool ok = true;
+      for (int i = 0; i < options.warmup && ok; ++i) {
+        ok = step.Run();
+      }
+
+      // One value per step, then the failure flag and the negotiation time.
+      std::vector<double> values;
+      double negotiation_start = NegotiationMicroseconds();
+      for (int i = 0; i < options.iters && ok; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        ok = step.Run();
+        std::chrono::duration<double, std::micro> elapsed =
+            std::chrono::steady_clock::now() - start;
+        values.push_back(elapsed.count());
+      }
+      values.resize((size_t)options.iters, 0.0);
+      values.push_back(ok ? 0.0 : 1.0);
+      values.push_back((NegotiationMicroseconds() - negotiation_start) /
+                       options.iters);
+      // The statistics themselves go through the first enabled operation.
+      horovod_set_allreduce_op(-1);
+      values = MaxOverRanks(values);
+      horovod_set_allreduce_op(allreduce_op);
+
+      bool failed = values[options.iters] > 0;
+      if (failed) {
+        if (rank == 0) {
+          std::printf("# %s %s %s skipped: %s\n", op.c_str(), algorithm.c_str(),
+                      DataType_Name(dtype).c_str(),
+                      ok ? "failed on another rank" : step.error().c_str());
+        }
+        return;
+      }
+      if (rank != 0) {
+        continue;
+      }
+      if (!header) {
+        PrintHeader(op, algorithm, dtype);
+        header = true;
+      }
+
+      std::vector<double> latencies(values.begin(),
+                                    values.begin() + options.iters);
+      std::sort(latencies.begin(), latencies.end());
+      double mean = 0;
+      for (auto latency : latencies) {
+        mean += latency;
+      }
+      mean /= latencies.size();
+      // An allgather moves the input of every rank to every rank.
+      double total_bytes =
+          (double)bytes * count * (op == "allgather" ? size : 1);
+      double algbw = total_bytes / mean / 1e3;
+      std::printf("%12lld %8lld %10.1f %10.1f %10.1f %12.3f %12.3f %12.1f\n",
+                  (long long)bytes, (long long)count,
+                  Percentile(latencies, 0.5), Percentile(latencies, 0.9),
+                  Percentile(latencies, 0.99), algbw,
+                  algbw * BusBandwidthFactor(op, size),
+                  values[options.iters + 1]);
+      std::fflush(stdout);
+    }
+  }
+}
+
+std::vector<std::string> AllreduceOpNames() {
+  int length = horovod_allreduce_ops(nullptr, 0);
+  std::string text((size_t)length + 1, '\0');
+  horovod_allreduce_ops(&text[0], length + 1);
+  std::vector<std::string> names;
+  std::stringstream stream(text.c_str());
+  std::string name;
+  while (std::getline(stream, name)) {
+    names.push_back(name);
+  }
+  return names;
+}
+
+int Main(int argc, char** argv) {
+  Options options;
+  try {
+    options = ParseOptions(argc, argv);
+  } catch (const std::invalid_argument& e) {
+    std::fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+
+  horovod_init(nullptr, 0);
+  if (horovod_rank() == 0) {
+    auto threshold = std::getenv(HOROVOD_FUSION_THRESHOLD);
+    auto cycle_time = std::getenv(HOROVOD_CYCLE_TIME);
+    std::printf("# ranks %d, device %s, %s=%s, %s=%s\n", horovod_size(),
+                options.gpu ? "gpu" : "cpu", HOROVOD_FUSION_THRESHOLD,
+                threshold != nullptr ? threshold : "default",
+                HOROVOD_CYCLE_TIME,
+                cycle_time != nullptr ? cycle_time : "default");
+  }
+
+  auto allreduce_names = AllreduceOpNames();
+  auto allreduce_ops = options.allreduce_ops;
+  if (allreduce_ops.empty()) {
+    for (size_t i = 0; i < allreduce_names.size(); ++i) {
+      allreduce_ops.push_back((int64_t)i);
+    }
+  }
+
+  for (auto dtype : options.dtypes) {
+    for (auto& op : options.ops) {
+      if (op != "allreduce") {
+        RunSweep(options, op, "default", -1, dtype);
+        continue;
+      }
+      for (auto index : allreduce_ops) {
+        if (!horovod_set_allreduce_op((int)index)) {
+          if (horovod_rank() == 0) {
+            std::fprintf(stderr, "No allreduce operation %lld.\n",
+                         (long long)index);
+          }
+          continue;
+        }
+        RunSweep(options, op, allreduce_names[index], (int)index, dtype);
+      }
+      horovod_set_allreduce_op(-1);
+    }
+  }
+
+  horovod_shutdown();
+  return 0;
+}
+
+} // namespace
+
+} // namespace common
+} // namespace horovod
+
+int main(int argc, char** argv) {
+  return horovod::common::Main(argc, argv);
+}
@@ -0,0 +1,503 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+// Replays request traces recorded with HOROVOD_REQUEST_TRACE through the
+// coordinator of a simulated job of any size, in a single process:
+//
+//   HOROVOD_REQUEST_TRACE=/tmp/trace horovodrun -np 8 python train.py
+//   hvd_controller_sim --trace=/tmp/trace --ranks=2048
+//
+// Virtual rank r submits the requests of trace r modulo the number of traces
+// in the same cycles as the recorded rank. Rank 0 negotiates through the real
+// controller, response cache, cache coordination and fusion. The other ranks
+// are simulated: they compute their cache bits from the shared response
+// cache, which every rank of a real job keeps identical, and send their
+// uncached requests serialized in the wire format. For every cycle, the CPU
+// time of the coordinator, excluding the simulation of the other ranks, and
+// the bytes it receives and sends are reported.
+//
+// Groups are replayed as single tensors, and process sets, hierarchical
+// negotiation and static graph replay are not simulated.
+
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "../request_trace.h"
+#include "mock_controller.h"
+
+namespace horovod {
+namespace common {
+
+namespace {
+
+struct Options {
+  std::string trace;
+  int ranks = 0;
+  int64_t cycles = -1;
+  int cache_capacity = 1024;
+  int64_t fusion_threshold = 64 * 1024 * 1024;
+  std::string csv;
+};
+
+const char* USAGE =
+    "Usage: hvd_controller_sim --trace=PREFIX [options]\n"
+    "  --trace=PREFIX          recorded traces PREFIX.0, PREFIX.1, ...\n"
+    "  --ranks=N               size of the simulated job, the number of\n"
+    "                          traces by default\n"
+    "  --cycles=N              cycles to replay, all of them by default\n"
+    "  --cache_capacity=1024   response cache capacity, 0 disables it\n"
+    "  --fusion_threshold=64M  tensor fusion threshold\n"
+    "  --csv=FILE              writes the measurements of every cycle\n";
+
+// Parses a byte count with an optional K, M or G suffix in powers of 1024.
+int64_t ParseBytes(const std::string& value) {
+  char* end = nullptr;
+  auto bytes = (int64_t)std::strtoll(value.c_str(), &end, 10);
+  switch (*end) {
+  case 'K':
+  case 'k':
+    return bytes << 10;
+  case 'M':
+  case 'm':
+    return bytes << 20;
+  case 'G':
+  case 'g':
+    return bytes << 30;
+  case '\0':
+    return bytes;
+  default:
+    throw std::invalid_argument("Invalid byte count " + value + ".");
+  }
+}
+
+Options ParseOptions(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    auto eq = arg.find('=');
+    auto key = arg.substr(0, eq);
+    auto value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+    if (key == "--trace") {
+      options.trace = value;
+    } else if (key == "--ranks") {
+      options.ranks = std::max(std::atoi(value.c_str()), 0);
+    } else if (key == "--cycles") {
+      options.cycles = std::atoll(value.c_str());
+    } else if (key == "--cache_capacity") {
+      options.cache_capacity = std::max(std::atoi(value.c_str()), 0);
+    } else if (key == "--fusion_threshold") {
+      options.fusion_threshold = ParseBytes(value);
+    } else if (key == "--csv") {
+      options.csv = value;
+    } else {
+      throw std::invalid_argument("Unknown argument " + arg + ".\n" + USAGE);
+    }
+  }
+  if (options.trace.empty()) {
+    throw std::invalid_argument(USAGE);
+  }
+  return options;
+}
+
+double ThreadCpuSeconds() {
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+double Percentile(std::vector<double> sorted, double fraction) {
+  auto index = (size_t)(fraction * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(index, sorted.size() - 1)];
+}
+
+// Coordinator of a simulated job. Every rank other than this one holds the
+// requests it submitted and has not yet sent or seen a response for.
+class SimController : public MockController {
+public:
+  SimController(ResponseCache& response_cache, TensorQueue& tensor_queue,
+                Timeline& timeline, ParameterManager& parameter_manager,
+                int size)
+      : MockController(response_cache, tensor_queue, timeline,
+                       parameter_manager, size),
+        pending_((size_t)size), bits_((size_t)size),
+        invalid_bits_((size_t)size) {}
+
+  // Adds the requests a simulated rank submits this cycle.
+  void Submit(int rank, const RequestList& request_list) {
+    for (auto request : request_list.requests()) {
+      request.set_request_rank(rank);
+      pending_[rank].push_back(std::move(request));
+    }
+  }
+
+  // Records the cache hits of the simulated ranks, as they do at the start of
+  // their cycle, and resets the measurements.
+  void StartCycle() {
+    request_bytes_ = 0;
+    response_bytes_ = 0;
+    bitvector_bytes_ = 0;
+    overhead_seconds_ = 0;
+    if (response_cache_.capacity() == 0) {
+      return;
+    }
+    auto num_active_bits = response_cache_.num_active_bits();
+    for (size_t rank = 1; rank < pending_.size(); ++rank) {
+      CacheCoordinator cache_coordinator(num_active_bits);
+      for (auto& request : pending_[rank]) {
+        auto state = response_cache_.cached(request);
+        if (state == ResponseCache::CacheState::HIT) {
+          cache_coordinator.record_hit(response_cache_.peek_cache_bit(request));
+          continue;
+        }
+        if (state == ResponseCache::CacheState::INVALID) {
+          cache_coordinator.record_invalid_bit(
+              response_cache_.peek_cache_bit(request.tensor_name()));
+        }
+        cache_coordinator.set_uncached_in_queue(true);
+      }
+      bits_[rank] = cache_coordinator.local_bitvector();
+      invalid_bits_[rank] = cache_coordinator.local_invalid_bitvector();
+    }
+  }
+
+  // Drops the requests of the simulated ranks that were responded to.
+  void FinishCycle(const ResponseList& response_list) {
+    std::unordered_set<std::string> names;
+    for (auto& response : response_list.responses()) {
+      names.insert(response.tensor_names().begin(),
+                   response.tensor_names().end());
+    }
+    for (size_t rank = 1; rank < pending_.size(); ++rank) {
+      auto& requests = pending_[rank];
+      requests.erase(std::remove_if(requests.begin(), requests.end(),
+                                    [&names](const Request& request) {
+                                      return names.count(
+                                                 request.tensor_name()) > 0;
+                                    }),
+                     requests.end());
+    }
+  }
+
+  void CrossRankBitwiseAnd(std::vector<long long>& bitvector,
+                           int count) override {
+    CombineBits(bitvector, count, bits_, true);
+  }
+
+  void CrossRankBitwiseOr(std::vector<long long>& bitvector,
+                          int count) override {
+    CombineBits(bitvector, count, invalid_bits_, false);
+  }
+
+  int64_t request_bytes() const { return request_bytes_; }
+  int64_t response_bytes() const { return response_bytes_; }
+  int64_t bitvector_bytes() const { return bitvector_bytes_; }
+  double overhead_seconds() const { return overhead_seconds_; }
+
+protected:
+  // The simulated ranks send their requests that are not cache hits. They
+  // are serialized and parsed like the requests received over the network,
+  // only parsing being work of the coordinator.
+  void RecvReadyTensors(std::vector<std::string>& ready_to_reduce,
+                        std::vector<RequestList>& ready_list) override {
+    ready_list.assign(pending_.size(), RequestList());
+    std::string encoded;
+    for (size_t rank = 1; rank < pending_.size(); ++rank) {
+      auto start = ThreadCpuSeconds();
+      RequestList sent;
+      auto& requests = pending_[rank];
+      auto kept = requests.begin();
+      for (auto it = requests.begin(); it != requests.end(); ++it) {
+        if (response_cache_.capacity() > 0 &&
+            response_cache_.cached(*it) == ResponseCache::CacheState::HIT) {
+          *kept++ = std::move(*it);
+        } else {
+          sent.add_request(*it);
+        }
+      }
+      requests.erase(kept, requests.end());
+      RequestList::SerializeToString(sent, encoded);
+      request_bytes_ += (int64_t)encoded.size();
+      overhead_seconds_ += ThreadCpuSeconds() - start;
+
+      RequestList::ParseFromBytes(
+          ready_list[rank], reinterpret_cast<const uint8_t*>(encoded.data()));
+    }
+  }
+
+  void SendFinalTensors(ResponseList& response_list) override {
+    MockController::SendFinalTensors(response_list);
+    response_bytes_ +=
+        (int64_t)last_response_list_bytes() * (int64_t)(pending_.size() - 1);
+  }
+
+private:
+  // Stands in for the bitwise allreduce with the simulated ranks, whose cost
+  // is communication rather than work of the coordinator.
+  void CombineBits(std::vector<long long>& bitvector, int count,
+                   const std::vector<std::vector<long long>>& rank_bits,
+                   bool bitwise_and) {
+    auto start = ThreadCpuSeconds();
+    for (size_t rank = 1; rank < rank_bits.size(); ++rank) {
+      auto& bits = rank_bits[rank];
+      for (int i = 0; i < count && i < (int)bits.size(); ++i) {
+        if (bitwise_and) {
+          bitvector[i] &= bits[i];
+        } else {
+          bitvector[i] |= bits[i];
+        }
+      }
+    }
+    bitvector_bytes_ +=
+        (int64_t)count * (int64_t)sizeof(long long) * (int64_t)(rank_bits.size() - 1);
+    overhead_seconds_ += ThreadCpuSeconds() - start;
+  }
+
+  std::vector<std::vector<Request>> pending_;
+  std::vector<std::vector<long long>> bits_;
+  std::vector<std::vector<long long>> invalid_bits_;
+  int64_t request_bytes_ = 0;
+  int64_t response_bytes_ = 0;
+  int64_t bitvector_bytes_ = 0;
+  double overhead_seconds_ = 0;
+};
+
+// Enqueues the requests of rank 0 on the tensor queue with host tensors of
+// their shape, so that fusion sees their sizes.
+int EnqueueRequests(TensorQueue& tensor_queue, const RequestList& request_list) {
+  int rejected = 0;
+  for (auto request : request_list.requests()) {
+    TensorShape shape;
+    for (auto dim : request.tensor_shape()) {
+      shape.AddDim(dim);
+    }
+    TensorTableEntry entry;
+    entry.tensor_name = request.tensor_name();
+    entry.context = std::make_shared<MockOpContext>(request.tensor_type());
+    entry.tensor = std::make_shared<MockTensor>(request.tensor_type(), shape);
+    entry.output = std::make_shared<MockTensor>(request.tensor_type(), shape);
+    entry.device = request.device();
+    entry.callback = [](const Status& status) {};
+    request.set_request_rank(0);
+    if (!tensor_queue.AddToTensorQueue(entry, request).ok()) {
+      ++rejected;
+    }
+  }
+  return rejected;
+}
+
+struct CycleStats {
+  int64_t requests = 0;
+  int64_t responses = 0;
+  double cpu_seconds = 0;
+  int64_t request_bytes = 0;
+  int64_t response_bytes = 0;
+  int64_t bitvector_bytes = 0;
+};
+
+// Controller state of the simulated coordinator. Too large for the stack.
+struct ControlPlane {
+  ResponseCache response_cache;
+  TensorQueue tensor_queue;
+  Timeline timeline;
+  ParameterManager parameter_manager;
+  std::shared_ptr<SimController> controller;
+};
+
+int Main(int argc, char** argv) {
+  Options options;
+  try {
+    options = ParseOptions(argc, argv);
+  } catch (const std::invalid_argument& e) {
+    std::fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+
+  std::vector<std::unique_ptr<RequestTraceReader>> traces;
+  try {
+    for (int i = 0;; ++i) {
+      auto file_name = options.trace + "." + std::to_string(i);
+      if (!std::ifstream(file_name)) {
+        break;
+      }
+      traces.emplace_back(new RequestTraceReader(file_name));
+    }
+  } catch (const std::runtime_error& e) {
+    std::fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  if (traces.empty()) {
+    std::fprintf(stderr, "No request trace %s.0.\n", options.trace.c_str());
+    return 1;
+  }
+  int size = options.ranks > 0 ? options.ranks : (int)traces.size();
+
+  std::unique_ptr<ControlPlane> plane(new ControlPlane());
+  plane->parameter_manager.SetTensorFusionThresholdBytes(
+      options.fusion_threshold, true);
+  plane->parameter_manager.SetCacheCapacity(options.cache_capacity, true);
+  plane->response_cache.set_capacity((uint32_t)options.cache_capacity);
+  plane->controller = std::make_shared<SimController>(
+      plane->response_cache, plane->tensor_queue, plane->timeline,
+      plane->parameter_manager, size);
+  auto& controller = *plane->controller;
+  controller.Initialize();
+  controller.GetStallInspector().SetPerformStallCheck(false);
+
+  std::FILE* csv = nullptr;
+  if (!options.csv.empty()) {
+    csv = std::fopen(options.csv.c_str(), "w");
+    if (csv == nullptr) {
+      std::fprintf(stderr, "Could not create %s.\n", options.csv.c_str());
+      return 1;
+    }
+    std::fprintf(csv, "cycle,requests,responses,cpu_us,request_bytes,"
+                      "response_bytes,bitvector_bytes\n");
+  }
+
+  std::printf("# ranks %d, traces %d, cache capacity %d, fusion threshold "
+              "%lld\n",
+              size, (int)traces.size(), options.cache_capacity,
+              (long long)options.fusion_threshold);
+
+  std::atomic_bool shut_down(false);
+  std::vector<RequestList> cycle_requests(traces.size());
+  std::vector<bool> trace_done(traces.size(), false);
+  std::vector<CycleStats> stats;
+  int rejected = 0;
+  for (int64_t cycle = 0; options.cycles < 0 || cycle < options.cycles;
+       ++cycle) {
+    bool any_trace = false;
+    for (size_t t = 0; t < traces.size(); ++t) {
+      if (!trace_done[t] && !traces[t]->ReadCycle(cycle_requests[t])) {
+        trace_done[t] = true;
+      }
+      if (trace_done[t]) {
+        cycle_requests[t] = RequestList();
+      } else {
+        any_trace = true;
+      }
+    }
+    if (!any_trace) {
+      break;
+    }
+
+    CycleStats cycle_stats;
+    for (int rank = 0; rank < size; ++rank) {
+      auto& request_list = cycle_requests[rank % traces.size()];
+      cycle_stats.requests += (int64_t)request_list.requests().size();
+      if (rank == 0) {
+        rejected += EnqueueRequests(plane->tensor_queue, request_list);
+      } else {
+        controller.Submit(rank, request_list);
+      }
+    }
+
+    controller.StartCycle();
+    auto start = ThreadCpuSeconds();
+    auto response_list = controller.ComputeResponseList(shut_down);
+    cycle_stats.cpu_seconds =
+        ThreadCpuSeconds() - start - controller.overhead_seconds();
+
+    // Take the tensors of rank 0 out of the queue, as performing the
+    // operations does.
+    for (auto response : response_list.responses()) {
+      cycle_stats.responses += (int64_t)response.tensor_names().size();
+      std::vector<TensorTableEntry> entries;
+      plane->tensor_queue.GetTensorEntriesFromResponse(response, entries);
+    }
+    controller.FinishCycle(response_list);
+
+    cycle_stats.request_bytes = controller.request_bytes();
+    cycle_stats.response_bytes = controller.response_bytes();
+    cycle_stats.bitvector_bytes = controller.bitvector_bytes();
+    if (csv != nullptr) {
+      std::fprintf(csv, "%lld,%lld,%lld,%.3f,%lld,%lld,%lld\n",
+                   (long long)cycle, (long long)cycle_stats.requests,
+                   (long long)cycle_stats.responses,
+                   cycle_stats.cpu_seconds * 1e6,
+                   (long long)cycle_stats.request_bytes,
+                   (long long)cycle_stats.response_bytes,
+                   (long long)cycle_stats.bitvector_bytes);
+    }
+    stats.push_back(cycle_stats);
+  }
+  if (csv != nullptr) {
+    std::fclose(csv);
+  }
+
+  if (rejected > 0) {
+    std::printf("# %d requests of rank 0 were rejected as duplicates\n",
+                rejected);
+  }
+  if (stats.empty()) {
+    std::printf("# no cycles\n");
+    return 0;
+  }
+
+  // Cycles without requests or responses are idle polling and left out of
+  // the statistics.
+  std::vector<double> cpu_us;
+  CycleStats total;
+  for (auto& cycle_stats : stats) {
+    total.requests += cycle_stats.requests;
+    total.responses += cycle_stats.responses;
+    total.request_bytes += cycle_stats.request_bytes;
+    total.response_bytes += cycle_stats.response_bytes;
+    total.bitvector_bytes += cycle_stats.bitvector_bytes;
+    total.cpu_seconds += cycle_stats.cpu_seconds;
+    if (cycle_stats.requests > 0 || cycle_stats.responses > 0) {
+      cpu_us.push_back(cycle_stats.cpu_seconds * 1e6);
+    }
+  }
+  std::sort(cpu_us.begin(), cpu_us.end());
+  std::printf("# %-10s %12s %12s %12s %12s %12s\n", "cycles", "requests",
+              "responses", "request_B", "response_B", "bitvector_B");
+  std::printf("  %-10lld %12lld %12lld %12lld %12lld %12lld\n",
+              (long long)stats.size(), (long long)total.requests,
+              (long long)total.responses, (long long)total.request_bytes,
+              (long long)total.response_bytes,
+              (long long)total.bitvector_bytes);
+  if (!cpu_us.empty()) {
+    double sum = 0;
+    for (auto value : cpu_us) {
+      sum += value;
+    }
+    std::printf("# coordinator cpu per active cycle (us): mean %.1f, p50 %.1f, "
+                "p99 %.1f, max %.1f over %d cycles\n",
+                sum / cpu_us.size(), Percentile(cpu_us, 0.5),
+                Percentile(cpu_us, 0.99), cpu_us.back(), (int)cpu_us.size());
+  }
+  std::printf("# coordinator cpu total %.3f s\n", total.cpu_seconds);
+  return 0;
+}
+
+} // namespace
+
+} // namespace common
+} // namespace horovod
+
+int main(int argc, char** argv) {
+  return horovod::common::Main(argc, argv);
+}
@@ -0,0 +1,143 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "mock_controller.h"
+
+#include <stdexcept>
+
+namespace horovod {
+namespace common {
+
+namespace {
+
+int ElementSize(DataType dtype) {
+  switch (dtype) {
+  case HOROVOD_UINT8:
+  case HOROVOD_INT8:
+  case HOROVOD_BOOL:
+  case HOROVOD_BYTE:
+    return 1;
+  case HOROVOD_UINT16:
+  case HOROVOD_INT16:
+  case HOROVOD_FLOAT16:
+  case HOROVOD_BFLOAT16:
+    return 2;
+  case HOROVOD_INT32:
+  case HOROVOD_FLOAT32:
+    return 4;
+  case HOROVOD_INT64:
+  case HOROVOD_FLOAT64:
+    return 8;
+  default:
+    throw std::logic_error("Type " + DataType_Name(dtype) +
+                           " is not supported by the mock controller.");
+  }
+}
+
+} // namespace
+
+MockController::MockController(ResponseCache& response_cache,
+                               TensorQueue& tensor_queue, Timeline& timeline,
+                               ParameterManager& parameter_manager, int size)
+    : Controller(response_cache, tensor_queue, timeline, parameter_manager),
+      mock_size_(size) {}
+
+void MockController::Initialize() {
+  rank_ = 0;
+  size_ = mock_size_;
+  local_rank_ = 0;
+  local_size_ = mock_size_;
+  min_local_size_ = mock_size_;
+  cross_rank_ = 0;
+  cross_size_ = 1;
+  is_coordinator_ = true;
+  is_homogeneous_ = true;
+
+  local_comm_ranks_.clear();
+  for (int i = 0; i < mock_size_; ++i) {
+    local_comm_ranks_.push_back(i);
+  }
+  cross_comm_ranks_ = {0};
+  local_sizes_for_cross_rank_ = {mock_size_};
+}
+
+int MockController::GetTypeSize(DataType dtype) {
+  return ElementSize(dtype);
+}
+
+void MockController::SetPeerRequests(const std::vector<Request>& requests) {
+  peer_requests_.assign((size_t)mock_size_, RequestList());
+  for (int rank = 1; rank < mock_size_; ++rank) {
+    for (auto request : requests) {
+      request.set_request_rank(rank);
+      peer_requests_[rank].emplace_request(std::move(request));
+    }
+  }
+}
+
+void MockController::RecvReadyTensors(std::vector<std::string>& ready_to_reduce,
+                                      std::vector<RequestList>& ready_list) {
+  if (peer_requests_.empty()) {
+    ready_list.assign((size_t)mock_size_, RequestList());
+  } else {
+    ready_list = peer_requests_;
+  }
+}
+
+void MockController::SendFinalTensors(ResponseList& response_list) {
+  ResponseList::SerializeToString(response_list, encoded_response_);
+}
+
+MockTensor::MockTensor(DataType dtype, const TensorShape& shape)
+    : dtype_(dtype), shape_(shape) {
+  buffer_.resize((size_t)(shape.num_elements() * ElementSize(dtype)));
+}
+
+Status
+MockOpContext::AllocatePersistent(int64_t size,
+                                  std::shared_ptr<PersistentBuffer>* tensor) {
+  *tensor = std::make_shared<MockPersistentBuffer>(size);
+  return Status::OK();
+}
+
+Status MockOpContext::AllocateOutput(TensorShape shape,
+                                     std::shared_ptr<Tensor>* tensor) {
+  *tensor = std::make_shared<MockTensor>(dtype_, shape);
+  return Status::OK();
+}
+
+void MakeAllreduceTensor(const std::string& name, DataType dtype,
+                         int64_t num_elements, TensorTableEntry& entry,
+                         Request& request) {
+  TensorShape shape;
+  shape.AddDim(num_elements);
+
+  entry.tensor_name = name;
+  entry.context = std::make_shared<MockOpContext>(dtype);
+  entry.tensor = std::make_shared<MockTensor>(dtype, shape);
+  entry.output = std::make_shared<MockTensor>(dtype, shape);
+  entry.device = CPU_DEVICE_ID;
+  entry.callback = [](const Status& status) {};
+
+  request.set_request_rank(0);
+  request.set_tensor_name(name);
+  request.set_tensor_type(dtype);
+  request.set_request_type(Request::ALLREDUCE);
+  request.set_device(CPU_DEVICE_ID);
+  request.set_tensor_shape(shape.to_vector());
+}
+
+} // namespace common
+} // namespace horovod
@@ -0,0 +1,136 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HOROVOD_MOCK_CONTROLLER_H
+#define HOROVOD_MOCK_CONTROLLER_H
+
+#include <string>
+#include <vector>
+
+#include "../common.h"
+#include "../controller.h"
+#include "../message.h"
+#include "../tensor_queue.h"
+
+namespace horovod {
+namespace common {
+
+// Controller of the coordinator of a job of the given size, run in a single
+// process. Every other rank is assumed to request the tensors set with
+// SetPeerRequests each cycle and to agree on the cache bits of this rank, so
+// that negotiation follows the coordinator path without communication.
+// Response lists are still serialized like an MPI controller sends them.
+class MockController : public Controller {
+public:
+  MockController(ResponseCache& response_cache, TensorQueue& tensor_queue,
+                 Timeline& timeline, ParameterManager& parameter_manager,
+                 int size = 1);
+
+  void Initialize() override;
+
+  int GetTypeSize(DataType dtype) override;
+
+  void CrossRankBitwiseAnd(std::vector<long long>& bitvector,
+                           int count) override {}
+
+  void CrossRankBitwiseOr(std::vector<long long>& bitvector,
+                          int count) override {}
+
+  void Bcast(void* buffer, size_t size, int root_rank,
+             Communicator communicator) override {}
+
+  void Barrier(Communicator communicator) override {}
+
+  // Requests received from each other rank in every following cycle. Their
+  // request rank is set to the rank they are received from.
+  void SetPeerRequests(const std::vector<Request>& requests);
+
+  // Length of the response list serialized the last cycle.
+  size_t last_response_list_bytes() const { return encoded_response_.size(); }
+
+  using Controller::FuseResponses;
+
+protected:
+  void RecvReadyTensors(std::vector<std::string>& ready_to_reduce,
+                        std::vector<RequestList>& ready_list) override;
+
+  void SendReadyTensors(RequestList& message_list) override {}
+
+  void SendFinalTensors(ResponseList& response_list) override;
+
+  void RecvFinalTensors(ResponseList& response_list) override {}
+
+private:
+  int mock_size_;
+  std::vector<RequestList> peer_requests_;
+  std::string encoded_response_;
+};
+
+// Host memory tensor of the given type and shape.
+class MockTensor : public Tensor {
+public:
+  MockTensor(DataType dtype, const TensorShape& shape);
+
+  const DataType dtype() const override { return dtype_; }
+  const TensorShape shape() const override { return shape_; }
+  const void* data() const override { return buffer_.data(); }
+  int64_t size() const override { return (int64_t)buffer_.size(); }
+
+  void* mutable_data() { return buffer_.data(); }
+
+private:
+  DataType dtype_;
+  TensorShape shape_;
+  std::vector<uint8_t> buffer_;
+};
+
+class MockPersistentBuffer : public PersistentBuffer {
+public:
+  explicit MockPersistentBuffer(int64_t size) : buffer_((size_t)size) {}
+
+  const void* AccessData(std::shared_ptr<OpContext> context) const override {
+    return buffer_.data();
+  }
+
+private:
+  std::vector<uint8_t> buffer_;
+};
+
+// Allocates host memory, as the TensorFlow context does for CPU tensors.
+class MockOpContext : public OpContext {
+public:
+  explicit MockOpContext(DataType dtype) : dtype_(dtype) {}
+
+  Status AllocatePersistent(int64_t size,
+                            std::shared_ptr<PersistentBuffer>* tensor) override;
+
+  Status AllocateOutput(TensorShape shape,
+                        std::shared_ptr<Tensor>* tensor) override;
+
+  Framework framework() const override { return Framework::TENSORFLOW; }
+
+private:
+  DataType dtype_;
+};
+
+// Entry and request of a CPU allreduce of num_elements values of dtype.
+void MakeAllreduceTensor(const std::string& name, DataType dtype,
+                         int64_t num_elements, TensorTableEntry& entry,
+                         Request& request);
+
+} // namespace common
+} // namespace horovod
+
+#endif // HOROVOD_MOCK_CONTROLLER_H
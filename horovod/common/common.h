@@ -22,6 +22,10 @@
 #include <string>
 #include <unordered_map>
 
+#if HAVE_CUDA
+#include <cuda_runtime.h>
+#endif
+
 #include "message.h"
 
 namespace horovod {
@@ -43,11 +47,17 @@ namespace common {
 #define MEMCPY_OUT_HOST_BUFFER "MEMCPY_OUT_HOST_BUFFER"
 #define NCCL_ALLREDUCE "NCCL_ALLREDUCE"
 #define MEMCPY_OUT_FUSION_BUFFER "MEMCPY_OUT_FUSION_BUFFER"
+#define MPI_REDUCE "MPI_REDUCE"
 #define MPI_BCAST "MPI_BCAST"
+#define MPI_PIPELINED_BCAST "MPI_PIPELINED_BCAST"
+#define MPI_REDUCESCATTER "MPI_REDUCESCATTER"
+#define MPI_ALLTOALL "MPI_ALLTOALL"
 #define NCCL_REDUCESCATTER "NCCL_REDUCESCATTER"
 #define NCCL_ALLGATHER "NCCL_ALLGATHER"
+#define NCCL_CROSS_ALLGATHER "NCCL_CROSS_ALLGATHER"
 #define NCCL_REDUCE "NCCL_REDUCE"
 #define NCCL_BCAST "NCCL_BCAST"
+#define NCCL_ALLTOALL "NCCL_ALLTOALL"
 #define COPY_ALLGATHER_OUTPUT "COPY_ALLGATHER_OUTPUT"
 #define ALLOCATE_SHARED_BUFFER "ALLOCATE_SHARED_BUFFER"
 #define MLSL_ALLREDUCE "MLSL_ALLREDUCE"
@@ -55,27 +65,87 @@ namespace common {
 #define MLSL_BCAST "MLSL_BCAST"
 #define GLOO_ALLREDUCE "GLOO_ALLREDUCE"
 #define GLOO_ALLGATHER "GLOO_ALLGATHER"
+#define GLOO_REDUCE "GLOO_REDUCE"
 #define GLOO_BCAST "GLOO_BCAST"
+#define GLOO_REDUCESCATTER "GLOO_REDUCESCATTER"
+#define GLOO_ALLTOALL "GLOO_ALLTOALL"
+#define SPARSE_ALLGATHER "SPARSE_ALLGATHER"
+#define QUANTIZED_ALLTOALL "QUANTIZED_ALLTOALL"
+#define QUANTIZED_REDUCE "QUANTIZED_REDUCE"
+#define QUANTIZED_ALLGATHER "QUANTIZED_ALLGATHER"
+#define SHARED_MEMORY_ALLREDUCE "SHARED_MEMORY_ALLREDUCE"
+#define SHARED_MEMORY_BCAST "SHARED_MEMORY_BCAST"
+#define ADASUM_ALLREDUCE "ADASUM_ALLREDUCE"
 
 // Horovod knobs.
 #define HOROVOD_MPI_THREADS_DISABLE "HOROVOD_MPI_THREADS_DISABLE"
+#define HOROVOD_MPI_CUDA_AWARE "HOROVOD_MPI_CUDA_AWARE"
+#define HOROVOD_MPI_PERSISTENT_COLLECTIVES "HOROVOD_MPI_PERSISTENT_COLLECTIVES"
+#define HOROVOD_MPI_ASYNC "HOROVOD_MPI_ASYNC"
+#define HOROVOD_MPI_CUDA_CHUNK_SIZE "HOROVOD_MPI_CUDA_CHUNK_SIZE"
 #define HOROVOD_TIMELINE "HOROVOD_TIMELINE"
 #define HOROVOD_TIMELINE_MARK_CYCLES "HOROVOD_TIMELINE_MARK_CYCLES"
+#define HOROVOD_REQUEST_TRACE "HOROVOD_REQUEST_TRACE"
+#define HOROVOD_TIMELINE_BINARY "HOROVOD_TIMELINE_BINARY"
+#define HOROVOD_TIMELINE_ALL_RANKS "HOROVOD_TIMELINE_ALL_RANKS"
+#define HOROVOD_TIMELINE_SAMPLE_CYCLES "HOROVOD_TIMELINE_SAMPLE_CYCLES"
+#define HOROVOD_TIMELINE_TENSORS "HOROVOD_TIMELINE_TENSORS"
+#define HOROVOD_METRICS_PORT "HOROVOD_METRICS_PORT"
 #define HOROVOD_AUTOTUNE "HOROVOD_AUTOTUNE"
 #define HOROVOD_AUTOTUNE_LOG "HOROVOD_AUTOTUNE_LOG"
+#define HOROVOD_AUTOTUNE_CONTINUOUS "HOROVOD_AUTOTUNE_CONTINUOUS"
+#define HOROVOD_AUTOTUNE_PROFILE "HOROVOD_AUTOTUNE_PROFILE"
+#define HOROVOD_AUTOTUNE_MEMORY_WEIGHT "HOROVOD_AUTOTUNE_MEMORY_WEIGHT"
 #define HOROVOD_FUSION_THRESHOLD "HOROVOD_FUSION_THRESHOLD"
+#define HOROVOD_FUSION_MEMCPY_THREADS "HOROVOD_FUSION_MEMCPY_THREADS"
+#define HOROVOD_FUSION_BUFFER_NUMA_NODE "HOROVOD_FUSION_BUFFER_NUMA_NODE"
+#define HOROVOD_FUSION_BUFFER_SLOTS "HOROVOD_FUSION_BUFFER_SLOTS"
+#define HOROVOD_BUFFER_MEMORY_BUDGET "HOROVOD_BUFFER_MEMORY_BUDGET"
+#define HOROVOD_BUFFER_IDLE_CYCLES "HOROVOD_BUFFER_IDLE_CYCLES"
+#define HOROVOD_CONCURRENT_CPU_GPU "HOROVOD_CONCURRENT_CPU_GPU"
 #define HOROVOD_CYCLE_TIME "HOROVOD_CYCLE_TIME"
+#define HOROVOD_WAKE_ON_ENQUEUE "HOROVOD_WAKE_ON_ENQUEUE"
+#define HOROVOD_BUSY_POLL "HOROVOD_BUSY_POLL"
+#define HOROVOD_THREAD_AFFINITY "HOROVOD_THREAD_AFFINITY"
+#define HOROVOD_PIPELINED_NEGOTIATION "HOROVOD_PIPELINED_NEGOTIATION"
 #define HOROVOD_STALL_CHECK_DISABLE "HOROVOD_STALL_CHECK_DISABLE"
 #define HOROVOD_STALL_CHECK_TIME_SECONDS "HOROVOD_STALL_CHECK_TIME_SECONDS"
 #define HOROVOD_STALL_SHUTDOWN_TIME_SECONDS "HOROVOD_STALL_SHUTDOWN_TIME_SECONDS"
 #define HOROVOD_HIERARCHICAL_ALLREDUCE "HOROVOD_HIERARCHICAL_ALLREDUCE"
+#define HOROVOD_HIERARCHICAL_ALLREDUCE_CHUNK_SIZE "HOROVOD_HIERARCHICAL_ALLREDUCE_CHUNK_SIZE"
 #define HOROVOD_HIERARCHICAL_ALLGATHER "HOROVOD_HIERARCHICAL_ALLGATHER"
+#define HOROVOD_HIERARCHICAL_NEGOTIATION "HOROVOD_HIERARCHICAL_NEGOTIATION"
 #define HOROVOD_CACHE_CAPACITY "HOROVOD_CACHE_CAPACITY"
+#define HOROVOD_CACHE_CAPACITY_MAX "HOROVOD_CACHE_CAPACITY_MAX"
+#define HOROVOD_STATIC_GRAPH "HOROVOD_STATIC_GRAPH"
 #define HOROVOD_MLSL_BGT_AFFINITY "HOROVOD_MLSL_BGT_AFFINITY"
 #define HOROVOD_NUM_NCCL_STREAMS "HOROVOD_NUM_NCCL_STREAMS"
+#define HOROVOD_NCCL_EAGER_INIT "HOROVOD_NCCL_EAGER_INIT"
+#define HOROVOD_BATCH_D2D_MEMCOPIES "HOROVOD_BATCH_D2D_MEMCOPIES"
+#define HOROVOD_CUDA_GRAPH "HOROVOD_CUDA_GRAPH"
+#define HOROVOD_STREAM_WAIT_READY_EVENTS "HOROVOD_STREAM_WAIT_READY_EVENTS"
 #define HOROVOD_CPU_OPERATIONS "HOROVOD_CPU_OPERATIONS"
+#define HOROVOD_CPU_COMPRESSION "HOROVOD_CPU_COMPRESSION"
+#define HOROVOD_SPARSE_ALLREDUCE_RATIO "HOROVOD_SPARSE_ALLREDUCE_RATIO"
+#define HOROVOD_CPU_ALLREDUCE_LATENCY_THRESHOLD "HOROVOD_CPU_ALLREDUCE_LATENCY_THRESHOLD"
+#define HOROVOD_URGENT_THRESHOLD "HOROVOD_URGENT_THRESHOLD"
+#define HOROVOD_NEGOTIATION_THREADS "HOROVOD_NEGOTIATION_THREADS"
+#define HOROVOD_GRADIENT_ACCUMULATION_STEPS "HOROVOD_GRADIENT_ACCUMULATION_STEPS"
+#define HOROVOD_STRAGGLER_TIMEOUT "HOROVOD_STRAGGLER_TIMEOUT"
+#define HOROVOD_MAX_STALENESS "HOROVOD_MAX_STALENESS"
+#define HOROVOD_DETERMINISTIC_ALLREDUCE "HOROVOD_DETERMINISTIC_ALLREDUCE"
+#define HOROVOD_BROADCAST_CHUNK_SIZE "HOROVOD_BROADCAST_CHUNK_SIZE"
+#define HOROVOD_SHARED_MEMORY_DISABLE "HOROVOD_SHARED_MEMORY_DISABLE"
 #define HOROVOD_CONTROLLER "HOROVOD_CONTROLLER"
 #define HOROVOD_GLOO_IFACE "HOROVOD_GLOO_IFACE"
+#define HOROVOD_GLOO_STRIPE_THRESHOLD "HOROVOD_GLOO_STRIPE_THRESHOLD"
+#define HOROVOD_GLOO_TRANSPORT "HOROVOD_GLOO_TRANSPORT"
+#define HOROVOD_GLOO_IBV_DEVICE "HOROVOD_GLOO_IBV_DEVICE"
+#define HOROVOD_GLOO_IBV_PORT "HOROVOD_GLOO_IBV_PORT"
+#define HOROVOD_GLOO_IBV_INDEX "HOROVOD_GLOO_IBV_INDEX"
+#define HOROVOD_RACK_ID "HOROVOD_RACK_ID"
+#define HOROVOD_TOPOLOGY_FILE "HOROVOD_TOPOLOGY_FILE"
+#define HOROVOD_ENABLE_XLA_OPS "HOROVOD_ENABLE_XLA_OPS"
 #define HOROVOD_MPI "MPI"
 #define HOROVOD_MLSL "MLSL"
 #define HOROVOD_GLOO "GLOO"
@@ -88,11 +158,18 @@ namespace common {
 #define FUSION_BUFFER_ATOMIC_UNIT 64
 #define RANK_ZERO 0
 
+// Number of NCCL streams the autotuner may use unless HOROVOD_NUM_NCCL_STREAMS
+// is set.
+#define MAX_AUTOTUNED_NCCL_STREAMS 4
+
 // Device ID used for CPU.
 #define CPU_DEVICE_ID (-1)
 
+// Name of the tensor table entry of a rank that joined, see EnqueueJoin.
+#define JOIN_TENSOR_NAME "join.noname"
+
 // List of supported frameworks.
-enum Framework { TENSORFLOW, PYTORCH, MXNET };
+enum Framework { TENSORFLOW, PYTORCH, MXNET, XLA };
 
 enum StatusType { OK, UNKNOWN_ERROR, PRECONDITION_ERROR, ABORTED, INVALID_ARGUMENT, IN_PROGRESS };
 
@@ -179,6 +256,12 @@ private:
 class ReadyEvent {
 public:
   virtual bool Ready() const = 0;
+#if HAVE_CUDA
+  // CUDA event recorded on the framework stream, which a collective stream
+  // can wait on instead of polling Ready() on the host. Null if the
+  // framework does not expose one.
+  virtual cudaEvent_t CudaEvent() const { return nullptr; }
+#endif
   virtual ~ReadyEvent() = default;
 };
 
@@ -207,6 +290,13 @@ public:
                      std::shared_ptr<PersistentBuffer>* tensor) = 0;
   virtual Status AllocateOutput(TensorShape shape,
                                 std::shared_ptr<Tensor>* tensor) = 0;
+  // Allocates a tensor of zeros on the device of the context, which a rank
+  // that joined takes part in collectives with. Only needed for GPU joins.
+  virtual Status AllocateZeros(int64_t num_elements, DataType dtype,
+                               std::shared_ptr<Tensor>* tensor) {
+    return Status::PreconditionError(
+        "Joining on a GPU is not supported by this framework.");
+  }
   virtual Framework framework() const = 0;
   virtual ~OpContext() = default;
 };
@@ -235,6 +325,28 @@ struct TensorTableEntry {
   int device = CPU_DEVICE_ID;
   // A callback to call with the status.
   StatusCallback callback;
+  // Tensors with higher priority are fused and reduced first. Must be the
+  // same on all ranks for a given name.
+  int32_t priority = 0;
+  // Allreduce inputs are multiplied by the prescale factor while they are
+  // packed for the collective, and the reduced values by the postscale factor
+  // while they are unpacked, e.g. 1 / size to average.
+  double prescale_factor = 1.0;
+  double postscale_factor = 1.0;
+  // How allreduce inputs are combined across ranks. Must be the same on all
+  // ranks for a given name.
+  ReduceOp reduce_op = ReduceOp::SUM;
+  // How allreduce inputs are quantized on the wire. Must be the same on all
+  // ranks for a given name.
+  Compression compression = Compression::NONE;
+  // Name of the group the tensor was enqueued with, negotiated as a single
+  // request, or empty.
+  std::string group_name;
+  // Process set the tensor is reduced over, or 0 for all ranks.
+  int32_t process_set_id = 0;
+  // Interned ID of the request the tensor was submitted with, held while the
+  // tensor is in the tensor table, or -1 if it has no request of its own.
+  int32_t tensor_id = -1;
 };
 using TensorTable = std::unordered_map<std::string, TensorTableEntry>;
 
@@ -15,6 +15,7 @@
 
 #include "controller.h"
 
+#include <algorithm>
 #include <atomic>
 #include <map>
 #include <queue>
@@ -30,19 +31,162 @@ namespace common {
 
 
 void Controller::SynchronizeParameters() {
-  ParameterManager::Params param;
+  // The timeline marks of cached tensors change the size of the cache
+  // synchronization, so they are turned on and off with the parameters.
+  struct {
+    ParameterManager::Params param;
+    bool timeline_enabled;
+  } sync;
+  auto& param = sync.param;
+  bool overridden = false;
   if (is_coordinator_) {
     param = parameter_manager_.GetParams();
+    std::lock_guard<std::mutex> guard(overrides_mutex_);
+    sync.timeline_enabled = timeline_requested_;
+    overrides_pending_ = false;
+    if (overrides_set_) {
+      if (overrides_.tensor_fusion_threshold_bytes >= 0) {
+        param.tensor_fusion_threshold =
+            double(overrides_.tensor_fusion_threshold_bytes) / (1024 * 1024);
+      }
+      if (overrides_.cycle_time_ms >= 0) {
+        param.cycle_time = overrides_.cycle_time_ms;
+      }
+      // The cache stays off for partial allreduces.
+      if (overrides_.cache_capacity >= 0 && !StalenessEnabled()) {
+        param.cache_capacity = overrides_.cache_capacity;
+      }
+      // Hierarchical operations are only used across nodes.
+      if (overrides_.hierarchical_allreduce >= 0) {
+        param.hierarchical_allreduce =
+            overrides_.hierarchical_allreduce > 0 && size_ != local_size_;
+      }
+      if (overrides_.hierarchical_allgather >= 0) {
+        param.hierarchical_allgather =
+            overrides_.hierarchical_allgather > 0 && size_ != local_size_;
+      }
+      // Parameters set from outside are not tuned anymore.
+      param.active = false;
+      overrides_ = ParameterManager::Overrides();
+      overrides_set_ = false;
+      overridden = true;
+    }
   }
 
-  void* buffer = (void*)(&param);
-  size_t param_size = sizeof(param);
-  Bcast(buffer, param_size, 0, Communicator::GLOBAL);
+  void* buffer = (void*)(&sync);
+  size_t sync_size = sizeof(sync);
+  Bcast(buffer, sync_size, 0, Communicator::GLOBAL);
 
-  if (!is_coordinator_) {
+  if (!is_coordinator_ || overridden) {
     parameter_manager_.SetParams(param);
   }
+  timeline_enabled_ = sync.timeline_enabled;
   parameter_manager_.Reset();
+
+  // Resizing the cache clears it unless it grows, on all ranks at the same
+  // cycle boundary.
+  if (response_cache_.capacity() !=
+      (uint32_t)parameter_manager_.CacheCapacity()) {
+    response_cache_.set_capacity(parameter_manager_.CacheCapacity());
+    DiscardStaticPlan();
+  }
+}
+
+void Controller::SetCacheCapacityMax(uint32_t max_capacity) {
+  cache_min_capacity_ = response_cache_.capacity();
+  cache_max_capacity_ =
+      max_capacity > cache_min_capacity_ && cache_min_capacity_ > 0
+          ? max_capacity
+          : 0;
+  response_cache_.set_max_capacity(cache_max_capacity_);
+}
+
+void Controller::AdaptCacheCapacity() {
+  // Tuned and overridden capacities take precedence.
+  uint32_t capacity = response_cache_.capacity();
+  if (cache_max_capacity_ == 0 || capacity == 0 ||
+      parameter_manager_.IsAutoTuning() || overrides_pending_) {
+    return;
+  }
+
+  // Tensors evicted and negotiated again mean that the tensors used together
+  // do not fit. Growing keeps the cached entries, so it is done at once.
+  // Shrinking clears the cache, so it waits for a long stretch in which less
+  // than a quarter of the capacity was hit or put. Entries are never dropped
+  // for being unused, so the size of the cache does not tell.
+  uint32_t new_capacity = capacity;
+  uint64_t reput = response_cache_.reput_after_eviction();
+  if (reput > cache_reput_seen_) {
+    new_capacity = (uint32_t)std::min<uint64_t>(2 * (uint64_t)capacity,
+                                                cache_max_capacity_);
+    cache_quiet_cycles_ = 0;
+    response_cache_.start_window();
+  } else if (++cache_quiet_cycles_ >= CACHE_SHRINK_CYCLES) {
+    if (response_cache_.window_bits() <= capacity / 4) {
+      new_capacity = std::max(capacity / 2, cache_min_capacity_);
+    }
+    cache_quiet_cycles_ = 0;
+    response_cache_.start_window();
+  }
+  cache_reput_seen_ = reput;
+
+  if (new_capacity != capacity) {
+    LOG(DEBUG) << "Changing the response cache capacity from " << capacity
+               << " to " << new_capacity << ".";
+    parameter_manager_.SetCacheCapacity((int32_t)new_capacity, true);
+    // The counters restart with the new capacity.
+    cache_reput_seen_ = 0;
+    cache_quiet_cycles_ = 0;
+    overrides_pending_ = true;
+  }
+}
+
+void Controller::SetParameterOverrides(
+    const ParameterManager::Overrides& overrides) {
+  // Values set by an earlier call and not sent yet are kept, unless set
+  // again.
+  std::lock_guard<std::mutex> guard(overrides_mutex_);
+  if (overrides.tensor_fusion_threshold_bytes >= 0) {
+    overrides_.tensor_fusion_threshold_bytes =
+        overrides.tensor_fusion_threshold_bytes;
+  }
+  if (overrides.cycle_time_ms >= 0) {
+    overrides_.cycle_time_ms = overrides.cycle_time_ms;
+  }
+  if (overrides.cache_capacity >= 0) {
+    overrides_.cache_capacity = overrides.cache_capacity;
+  }
+  if (overrides.hierarchical_allreduce >= 0) {
+    overrides_.hierarchical_allreduce = overrides.hierarchical_allreduce;
+  }
+  if (overrides.hierarchical_allgather >= 0) {
+    overrides_.hierarchical_allgather = overrides.hierarchical_allgather;
+  }
+  overrides_set_ = true;
+  overrides_pending_ = true;
+}
+
+void Controller::RequestTimelineEnabled(bool value) {
+  std::lock_guard<std::mutex> guard(overrides_mutex_);
+  timeline_requested_ = value;
+  overrides_pending_ = true;
+}
+
+void Controller::ResetMembership() {
+  message_table_.clear();
+  first_request_time_.clear();
+  contributions_.clear();
+  staleness_.clear();
+  stall_inspector_.Clear();
+  fused_responses_.clear();
+  joined_ = false;
+  joined_ranks_.clear();
+  joined_devices_.clear();
+
+  // The recorded plan holds the devices of the ranks of the old membership.
+  static_plan_bits_.clear();
+  static_plan_ = ResponseList();
+  static_plan_repeats_ = 0;
 }
 
 Controller::Controller(ResponseCache& response_cache, TensorQueue& tensor_queue,
@@ -54,8 +198,7 @@ Controller::Controller(ResponseCache& response_cache, TensorQueue& tensor_queue,
 ResponseList Controller::ComputeResponseList(std::atomic_bool& shut_down) {
   // Update cache capacity if autotuning is active.
   if (parameter_manager_.IsAutoTuning()) {
-    response_cache_.set_capacity((int)parameter_manager_.CacheEnabled() *
-                                 cache_capacity_);
+    response_cache_.set_capacity(parameter_manager_.CacheCapacity());
   }
 
   // Copy the data structures out from parameters.
@@ -66,8 +209,19 @@ ResponseList Controller::ComputeResponseList(std::atomic_bool& shut_down) {
 
   // message queue used only in this cycle
   std::deque<Request> message_queue_tmp;
-  tensor_queue_.PopMessagesFromQueue(message_queue_tmp);
+  if (request_trace_ != nullptr) {
+    RequestList new_messages;
+    tensor_queue_.PopMessagesFromQueue(message_queue_tmp, &new_messages);
+    new_messages.set_shutdown(shut_down);
+    request_trace_->WriteCycle(new_messages);
+  } else {
+    tensor_queue_.PopMessagesFromQueue(message_queue_tmp);
+  }
   for (auto& message : message_queue_tmp) {
+    if (message.request_type() == Request::JOIN) {
+      joined_ = true;
+    }
+
     // Keep track of cache hits
     if (response_cache_.capacity() > 0) {
       auto cache_ = response_cache_.cached(message);
@@ -84,6 +238,9 @@ ResponseList Controller::ComputeResponseList(std::atomic_bool& shut_down) {
           cache_coordinator.record_invalid_bit(cache_bit);
         }
         cache_coordinator.set_uncached_in_queue(true);
+        if (metrics_ != nullptr) {
+          metrics_->cache_misses.Add();
+        }
 
         // Remove timing entry if uncached or marked invalid.
         stall_inspector_.RemoveCachedTensor(message.tensor_name());
@@ -91,13 +248,42 @@ ResponseList Controller::ComputeResponseList(std::atomic_bool& shut_down) {
     }
   }
 
+  // A rank that joined has no tensors to hit the cache with, so the other
+  // ranks would wait for common hits forever. Its cache entries are
+  // invalidated on all ranks, and the tensors of the other ranks are
+  // negotiated with the coordinator, which counts this rank in.
+  if (joined_ && response_cache_.capacity() > 0) {
+    for (size_t bit = 0; bit < response_cache_.num_active_bits(); ++bit) {
+      cache_coordinator.record_invalid_bit((uint32_t)bit);
+    }
+    cache_coordinator.set_uncached_in_queue(true);
+  }
+
   // Flag indicating that the background thread should shut down.
   bool should_shut_down = shut_down;
 
+  // Parameter overrides are sent at the end of a cycle whose response list
+  // comes from the coordinator, so the coordinator takes the uncached path.
+  bool sync_parameters = is_coordinator_ && overrides_pending_;
+  if (sync_parameters) {
+    cache_coordinator.set_uncached_in_queue(true);
+  }
+
   // Check for stalled tensors.
+  bool stall_check_performed = false;
+  if (is_coordinator_) {
+    stall_inspector_.AdvanceWheel();
+  }
   if (stall_inspector_.ShouldPerformCheck()) {
+    stall_check_performed = true;
     if (is_coordinator_) {
       should_shut_down |= stall_inspector_.CheckForStalledTensors(size_);
+      if (metrics_ != nullptr) {
+        metrics_->stalled_tensors.Set(
+            stall_inspector_.GetStalledTensorCount());
+        metrics_->stragglers.Set(
+            stall_inspector_.GetStragglers(Metrics::NUM_STRAGGLERS));
+      }
     }
 
     if (response_cache_.capacity() > 0) {
@@ -108,6 +294,24 @@ ResponseList Controller::ComputeResponseList(std::atomic_bool& shut_down) {
 
   cache_coordinator.set_should_shut_down(should_shut_down);
 
+  // In steady state of a static graph, replay the recorded plan after a
+  // single cross-rank check instead of coordinating the cache. A rank that
+  // has just checked for stalls votes against it, since it may have
+  // invalidated cache entries.
+  if (StaticPlanArmed()) {
+    ResponseList replayed_list;
+    if (ReplayStaticPlan(message_queue_tmp,
+                         !stall_check_performed && !sync_parameters,
+                         should_shut_down, replayed_list)) {
+      if (metrics_ != nullptr) {
+        for (auto& response : replayed_list.responses()) {
+          metrics_->cache_hits.Add(response.tensor_names().size());
+        }
+      }
+      return replayed_list;
+    }
+  }
+
   if (response_cache_.capacity() > 0) {
     // Obtain common cache hits and cache invalidations across workers. Also,
     // determine if any worker has uncached messages in queue or requests
@@ -123,8 +327,7 @@ ResponseList Controller::ComputeResponseList(std::atomic_bool& shut_down) {
       auto message = message_queue_tmp.front();
       if (response_cache_.cached(message) == ResponseCache::CacheState::HIT) {
         uint32_t cache_bit = response_cache_.peek_cache_bit(message);
-        if (cache_coordinator.cache_hits().find(cache_bit) ==
-            cache_coordinator.cache_hits().end()) {
+        if (!cache_coordinator.is_cache_hit(cache_bit)) {
           // Try to process again in next cycle.
           tensor_queue_.PushMessageToQueue(message);
         } else {
@@ -145,8 +348,12 @@ ResponseList Controller::ComputeResponseList(std::atomic_bool& shut_down) {
                       << " messages to coordinator.";
   }
 
+  // Without the cache, the coordinator is not synced and the shutdown flags
+  // of the other ranks arrive with their requests.
   ResponseList response_list;
-  response_list.set_shutdown(cache_coordinator.should_shut_down());
+  response_list.set_shutdown(response_cache_.capacity() > 0
+                                 ? cache_coordinator.should_shut_down()
+                                 : should_shut_down);
 
   bool need_communication = true;
   if (response_cache_.capacity() > 0 &&
@@ -166,18 +373,33 @@ ResponseList Controller::ComputeResponseList(std::atomic_bool& shut_down) {
     // If all messages in queue have responses in cache, use fast path with
     // no additional coordination.
 
-    std::deque<Response> responses;
-    // Convert cache hits to responses. Populate so that least
-    // recently used responses get priority. All workers call the code
-    // here so we use the get method here to consistently update the cache
-    // order.
-    for (auto bit : cache_coordinator.cache_hits()) {
-      responses.push_back(response_cache_.get_response(bit));
+    // Convert cache hits to responses in cache bit order. All workers call
+    // the code here so we use the get method here to consistently update
+    // the cache order.
+    auto& cache_hits = cache_coordinator.cache_hits();
+    if (LookupFusedResponses(cache_hits, response_list)) {
+      for (auto bit : cache_hits) {
+        response_cache_.get_response(bit);
+      }
+    } else {
+      std::deque<Response> responses;
+      for (auto bit : cache_hits) {
+        responses.push_back(response_cache_.get_response(bit));
+      }
+
+      // Fuse responses as normal.
+      response_list = FuseResponses(responses);
+      StoreFusedResponses(cache_hits, response_list);
     }
+    response_list.set_shutdown(cache_coordinator.should_shut_down());
 
-    // Fuse responses as normal.
-    response_list = FuseResponses(responses);
+    if (static_graph_warmup_ > 0) {
+      RecordStaticPlan(cache_coordinator, response_list);
+    }
   } else {
+    // The set of tensors is changing, wait for it to settle again.
+    DiscardStaticPlan();
+
     // There are uncached messages coming in, need communication to figure out
     // whether those are ready to be reduced.
 
@@ -188,14 +410,21 @@ ResponseList Controller::ComputeResponseList(std::atomic_bool& shut_down) {
 
     if (is_coordinator_) {
       LOG(TRACE) << "Adding messages from rank 0";
+      size_t num_joined = joined_ranks_.size();
       while (!message_queue_tmp.empty()) {
         // Pop the first available message
-        Request message = message_queue_tmp.front();
+        Request message = std::move(message_queue_tmp.front());
         message_queue_tmp.pop_front();
+        if (message.request_type() == Request::JOIN) {
+          RecordJoin(message);
+          continue;
+        }
 
         bool reduce = IncrementTensorCount(message);
+        auto process_set = GetProcessSet(message.process_set_id());
         stall_inspector_.RecordUncachedTensorStart(
-            message.tensor_name(), message.request_rank(), size_);
+            message.tensor_name(), message.request_rank(), size_,
+            process_set != nullptr ? &process_set->ranks : nullptr);
         if (reduce) {
           ready_to_reduce.push_back(message.tensor_name());
         }
@@ -205,16 +434,22 @@ ResponseList Controller::ComputeResponseList(std::atomic_bool& shut_down) {
       std::vector<RequestList> ready_list;
       RecvReadyTensors(ready_to_reduce, ready_list);
 
-      // Process messages.
-      for (int i = 1; i < size_; ++i) {
-        LOG(TRACE) << "Adding messages from rank " << i;
-        auto received_message_list = ready_list[i];
+      // Process messages. With hierarchical negotiation there is one list
+      // per node rather than per rank.
+      for (size_t i = 1; i < ready_list.size(); ++i) {
+        LOG(TRACE) << "Adding messages from list " << i;
+        auto& received_message_list = ready_list[i];
         for (auto& received_message : received_message_list.requests()) {
+          if (received_message.request_type() == Request::JOIN) {
+            RecordJoin(received_message);
+            continue;
+          }
           auto& received_name = received_message.tensor_name();
           bool reduce = IncrementTensorCount(received_message);
+          auto process_set = GetProcessSet(received_message.process_set_id());
           stall_inspector_.RecordUncachedTensorStart(
               received_message.tensor_name(), received_message.request_rank(),
-              size_);
+              size_, process_set != nullptr ? &process_set->ranks : nullptr);
           if (reduce) {
             ready_to_reduce.push_back(received_name);
           }
@@ -225,6 +460,25 @@ ResponseList Controller::ComputeResponseList(std::atomic_bool& shut_down) {
         }
       }
 
+      // Tensors that only waited for the ranks that joined in this cycle
+      // are ready now.
+      if (joined_ranks_.size() > num_joined) {
+        std::unordered_set<std::string> ready(ready_to_reduce.begin(),
+                                              ready_to_reduce.end());
+        for (auto& item : message_table_) {
+          auto& requests = item.second;
+          auto process_set_id = requests[0].process_set_id();
+          if (ready.find(item.first) == ready.end() &&
+              (process_set_id == 0
+                   ? requests.size() + JoinedAbsentRanks(requests).size() ==
+                         (size_t)size_
+                   : HasJoinedMember(process_set_id))) {
+            timeline_.NegotiateEnd(item.first);
+            ready_to_reduce.push_back(item.first);
+          }
+        }
+      }
+
       // At this point, rank zero should have a fully updated tensor count
       // table and should know all the tensors that need to be reduced or
       // gathered, and everyone else should have sent all their information
@@ -234,22 +488,79 @@ ResponseList Controller::ComputeResponseList(std::atomic_bool& shut_down) {
       std::deque<Response> responses;
 
       if (response_cache_.capacity() > 0) {
-        // Prepopulate response list with cached responses. Populate so that
-        // least recently used responses get priority. Since only the
-        // coordinator rank calls this code, use peek instead of get here to
-        // preserve cache order across workers.
+        // Prepopulate response list with cached responses in cache bit
+        // order. Since only the coordinator rank calls this code, use peek
+        // instead of get here to preserve cache order across workers.
         for (auto bit : cache_coordinator.cache_hits()) {
           responses.push_back(response_cache_.peek_response(bit));
         }
       }
 
-      for (auto& tensor_name : ready_to_reduce) {
-        Response response = ConstructResponse(tensor_name);
+      // Groups are fused on their own, after the other tensors, and so are
+      // the tensors of process sets.
+      std::vector<std::pair<Response, std::vector<std::string>>> groups;
+      std::vector<ProcessSetResponse> process_set_responses;
+      // Responses ranks that joined take part in. The coordinator may have
+      // joined itself and lack the tensors, so they are neither fused nor
+      // expanded into the tensors of their group.
+      std::vector<Response> joined_responses;
+      std::vector<char> requests_match;
+      MatchRequests(ready_to_reduce, requests_match);
+      for (size_t i = 0; i < ready_to_reduce.size(); ++i) {
+        auto& tensor_name = ready_to_reduce[i];
+        auto& request = message_table_[tensor_name][0];
+        if (request.process_set_id() != 0) {
+          int64_t num_elements = 1;
+          for (auto dim : request.tensor_shape()) {
+            num_elements *= dim;
+          }
+          auto dtype = request.tensor_type();
+          Response response =
+              ConstructResponse(tensor_name, requests_match[i] != 0);
+          process_set_responses.push_back(ProcessSetResponse{
+              std::move(response), dtype, num_elements * GetTypeSize(dtype)});
+          continue;
+        }
+        Response response =
+            ConstructResponse(tensor_name, requests_match[i] != 0);
+        if (!response.absent_ranks().empty()) {
+          joined_responses.push_back(std::move(response));
+          continue;
+        }
+        std::vector<std::string> group_tensor_names;
+        if (tensor_queue_.GetGroupTensorNames(tensor_name,
+                                              group_tensor_names)) {
+          groups.emplace_back(std::move(response),
+                              std::move(group_tensor_names));
+          continue;
+        }
         responses.push_back(std::move(response));
       }
 
       response_list = FuseResponses(responses);
+      for (auto& group : groups) {
+        AddGroupResponses(group.first, group.second, response_list);
+      }
+      AddProcessSetResponses(process_set_responses, response_list);
+      for (auto& response : joined_responses) {
+        response_list.emplace_response(std::move(response));
+      }
+      // Ranks that joined are not left out of partial allreduces, they take
+      // part in all of them with zeros.
+      if (StalenessEnabled() && joined_ranks_.empty()) {
+        AddPartialResponses(response_list);
+      }
+      // Once every rank joined, all of them are released together, after
+      // the tensors negotiated with the last ones.
+      if ((int)joined_ranks_.size() == size_) {
+        Response response;
+        response.set_response_type(Response::JOIN);
+        response.add_tensor_name(JOIN_TENSOR_NAME);
+        response_list.emplace_response(std::move(response));
+        joined_ranks_.clear();
+      }
       response_list.set_shutdown(should_shut_down);
+      response_list.set_sync_parameters(sync_parameters);
 
       // Broadcast final results to other ranks.
       SendFinalTensors(response_list);
@@ -283,16 +594,51 @@ ResponseList Controller::ComputeResponseList(std::atomic_bool& shut_down) {
   if (need_communication && response_cache_.capacity() > 0) {
     // All workers add supported responses to cache. This updates the cache
     // order consistently across workers.
+    // Allgather responses are cached with the first dimension of every rank.
+    // A rank whose shape changes misses its entry, which invalidates it on
+    // all ranks, so the sizes are gathered again.
+    // Groups are negotiated with a single request and not cached, and
+    // neither are the tensors of process sets, which not all ranks have, or
+    // the tensors ranks that joined take part in.
     for (auto& response : response_list.responses()) {
-      if (response.response_type() == Response::ResponseType::ALLREDUCE &&
-          (int)response.devices().size() == size_) {
+      if ((response.response_type() == Response::ResponseType::ALLREDUCE ||
+           response.response_type() == Response::ResponseType::ALLGATHER) &&
+          response.process_set_id() == 0 &&
+          (int)response.devices().size() == size_ &&
+          response.absent_ranks().empty() &&
+          tensor_queue_.GetTensorEntry(response.tensor_names()[0])
+              .group_name.empty()) {
         response_cache_.put(response, tensor_queue_);
       }
     }
   }
 
-  // Reassign cache bits based on current cache order.
+  // Drop the cache bits freed at the end of the bit range.
   response_cache_.update_cache_bits();
+  response_cache_.release_tensor_ids(tensor_queue_);
+
+  if (need_communication && is_coordinator_) {
+    AdaptCacheCapacity();
+  }
+
+  // The late tensors of the partial allreduces this rank was left out of are
+  // not negotiated again. A rank that joined has no late tensors.
+  if (StalenessEnabled() && !joined_) {
+    for (auto& response : response_list.responses()) {
+      auto& absent_ranks = response.absent_ranks();
+      if (response.response_type() == Response::ALLREDUCE &&
+          std::find(absent_ranks.begin(), absent_ranks.end(), rank_) !=
+              absent_ranks.end()) {
+        tensor_queue_.MarkLate(response.tensor_names());
+      }
+    }
+  }
+
+  for (auto& response : response_list.responses()) {
+    if (response.response_type() == Response::JOIN) {
+      joined_ = false;
+    }
+  }
 
   return response_list;
 }
@@ -301,23 +647,161 @@ int64_t Controller::TensorFusionThresholdBytes() {
   int64_t proposed_fusion_threshold =
       parameter_manager_.TensorFusionThresholdBytes();
 
-  // If the cluster is homogeneous and hierarchical allreduce is enabled,
-  // adjust buffer size to make sure it is divisible by local_size to improve
+  // If hierarchical allreduce is enabled, adjust buffer size to make sure it
+  // is divisible by the number of local ranks that split it, local_size on a
+  // homogeneous cluster and the smallest local size otherwise, to improve
   // performance.
-  if (is_homogeneous_ && parameter_manager_.HierarchicalAllreduce()) {
+  if (parameter_manager_.HierarchicalAllreduce()) {
     // Assume the worst-case data type float64, since if it is divisible with
     // float64, it will be divisible for other types too.
 
     // Ensuring that fusion buffer can hold a number of elements divisible by
     // FUSION_BUFFER_ATOMIC_UNIT for performance
     int double_size = GetTypeSize(HOROVOD_FLOAT64);
-    int64_t div = local_size_ * double_size * FUSION_BUFFER_ATOMIC_UNIT;
+    int64_t div = min_local_size_ * double_size * FUSION_BUFFER_ATOMIC_UNIT;
     return ((proposed_fusion_threshold + div - 1) / div) * div;
   }
   return proposed_fusion_threshold;
 }
 
-Response Controller::ConstructResponse(std::string& name) {
+void Controller::AddGroupResponses(const Response& group_response,
+                                   const std::vector<std::string>& tensor_names,
+                                   ResponseList& response_list) {
+  // All tensors of the group fail together.
+  if (group_response.response_type() == Response::ERROR) {
+    Response response = group_response;
+    response.set_tensor_names(tensor_names);
+    response_list.emplace_response(std::move(response));
+    return;
+  }
+
+  int64_t threshold = TensorFusionThresholdBytes();
+  Response response;
+  int64_t fused_size = 0;
+  for (auto& name : tensor_names) {
+    int64_t tensor_size = tensor_queue_.GetTensorEntry(name).tensor->size();
+    if (!response.tensor_names().empty() &&
+        fused_size + tensor_size > threshold) {
+      response_list.emplace_response(std::move(response));
+      response = Response();
+      fused_size = 0;
+    }
+    if (response.tensor_names().empty()) {
+      response.set_response_type(group_response.response_type());
+      response.set_devices(group_response.devices());
+      response.set_reduce_op(group_response.reduce_op());
+      response.set_compression(group_response.compression());
+    }
+    response.add_tensor_name(name);
+    fused_size += tensor_size;
+  }
+  if (!response.tensor_names().empty()) {
+    response_list.emplace_response(std::move(response));
+  }
+}
+
+void Controller::AddProcessSetResponses(
+    std::vector<ProcessSetResponse>& responses, ResponseList& response_list) {
+  // Prescale and postscale factors are not known here. The ranks of the set
+  // split fused responses where the factors change, see PerformOperation.
+  int64_t threshold = TensorFusionThresholdBytes();
+  std::vector<bool> fused(responses.size(), false);
+  for (size_t i = 0; i < responses.size(); ++i) {
+    if (fused[i]) {
+      continue;
+    }
+    Response response = std::move(responses[i].response);
+    int64_t fused_size = responses[i].size;
+    if (response.response_type() == Response::ALLREDUCE) {
+      for (size_t j = i + 1; j < responses.size(); ++j) {
+        auto& next = responses[j];
+        if (!fused[j] && next.response.response_type() == Response::ALLREDUCE &&
+            next.response.process_set_id() == response.process_set_id() &&
+            next.response.devices() == response.devices() &&
+            next.response.reduce_op() == response.reduce_op() &&
+            next.response.compression() == response.compression() &&
+            next.dtype == responses[i].dtype &&
+            fused_size + next.size <= threshold) {
+          response.add_tensor_name(next.response.tensor_names()[0]);
+          fused_size += next.size;
+          fused[j] = true;
+        }
+      }
+    }
+    response_list.emplace_response(std::move(response));
+  }
+}
+
+void Controller::SetNegotiationThreads(int num_threads,
+                                       const std::vector<int>& cpus) {
+  negotiation_pool_.Shutdown();
+  if (num_threads > 1) {
+    // The background thread checks its own share.
+    negotiation_pool_.Create(num_threads - 1, cpus);
+  }
+}
+
+bool Controller::RequestsMatch(const std::vector<Request>& requests) {
+  auto& first = requests[0];
+  auto message_type = first.request_type();
+  auto& first_shape = first.tensor_shape();
+  bool first_dim_varies = message_type == Request::ALLGATHER ||
+                          message_type == Request::ALLTOALL;
+  bool first_device_is_cpu = first.device() == CPU_DEVICE_ID;
+  for (size_t i = 1; i < requests.size(); ++i) {
+    auto& request = requests[i];
+    if (request.tensor_type() != first.tensor_type() ||
+        request.process_set_id() != first.process_set_id() ||
+        request.request_type() != message_type ||
+        (request.device() == CPU_DEVICE_ID) != first_device_is_cpu) {
+      return false;
+    }
+    if (message_type == Request::ALLREDUCE &&
+        (request.reduce_op() != first.reduce_op() ||
+         request.compression() != first.compression())) {
+      return false;
+    }
+    if (message_type == Request::BROADCAST &&
+        request.root_rank() != first.root_rank()) {
+      return false;
+    }
+    auto& shape = request.tensor_shape();
+    if (first_dim_varies) {
+      if (shape.empty() || shape.size() != first_shape.size() ||
+          !std::equal(shape.begin() + 1, shape.end(),
+                      first_shape.begin() + 1)) {
+        return false;
+      }
+    } else if (shape != first_shape) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void Controller::MatchRequests(const std::vector<std::string>& names,
+                               std::vector<char>& matches) {
+  matches.assign(names.size(), 0);
+  auto match = [&](int i) {
+    matches[i] = RequestsMatch(message_table_.find(names[i])->second) ? 1 : 0;
+  };
+  // Spread the checks over the pool once they outweigh waking it up.
+  int64_t num_requests = 0;
+  for (auto& name : names) {
+    num_requests += (int64_t)message_table_.find(name)->second.size();
+  }
+  if (negotiation_pool_.num_threads() > 0 && names.size() > 1 &&
+      num_requests >= 4096) {
+    negotiation_pool_.ParallelFor((int)names.size(), match);
+  } else {
+    for (size_t i = 0; i < names.size(); ++i) {
+      match((int)i);
+    }
+  }
+}
+
+Response Controller::ConstructResponse(std::string& name,
+                                       bool requests_match) {
   bool error = false;
   auto it = message_table_.find(name);
   assert(it != message_table_.end());
@@ -327,10 +811,14 @@ Response Controller::ConstructResponse(std::string& name) {
 
   std::ostringstream error_message_stream;
 
+  // The checks between ranks compare every request with the first one. If
+  // the requests are known to match, only the first one is checked.
+  size_t num_compared = requests_match ? 1 : requests.size();
+
   // Check that all data types of tensors being reduced, gathered or broadcasted
   // are identical.
   auto data_type = requests[0].tensor_type();
-  for (unsigned int i = 1; i < requests.size(); ++i) {
+  for (size_t i = 1; i < num_compared; ++i) {
     auto request_type = requests[i].tensor_type();
     if (data_type != request_type) {
       error = true;
@@ -342,9 +830,44 @@ Response Controller::ConstructResponse(std::string& name) {
     }
   }
 
+  // Check that all ranks reduce the tensor within the same process set, and
+  // that the set is registered.
+  auto process_set_id = requests[0].process_set_id();
+  for (size_t i = 1; i < num_compared; ++i) {
+    if (error) {
+      break;
+    }
+
+    auto request_process_set_id = requests[i].process_set_id();
+    if (process_set_id != request_process_set_id) {
+      error = true;
+      error_message_stream << "Mismatched process sets: One rank reduced "
+                              "within process set "
+                           << process_set_id
+                           << ", but another rank within process set "
+                           << request_process_set_id << ".";
+      process_set_id = std::max(process_set_id, request_process_set_id);
+      break;
+    }
+  }
+  if (!error && process_set_id != 0 &&
+      GetProcessSet(process_set_id) == nullptr) {
+    error = true;
+    error_message_stream << "Process set " << process_set_id
+                         << " is not registered on the coordinator. Register "
+                            "process sets on all ranks before reducing "
+                            "tensors within them.";
+  }
+  if (!error && process_set_id != 0 && HasJoinedMember(process_set_id)) {
+    error = true;
+    error_message_stream << "Process set " << process_set_id
+                         << " has ranks that joined, only tensors of all "
+                            "ranks are reduced after ranks joined.";
+  }
+
   // Check that all requested operations are the same
   auto message_type = requests[0].request_type();
-  for (unsigned int i = 1; i < requests.size(); ++i) {
+  for (size_t i = 1; i < num_compared; ++i) {
     if (error) {
       break;
     }
@@ -360,15 +883,73 @@ Response Controller::ConstructResponse(std::string& name) {
     }
   }
 
-  // If we are doing an allreduce or broadcast, check that all tensor shapes are
-  // identical.
+  // Check that all ranks combine the tensors of an allreduce the same way.
+  if (message_type == Request::ALLREDUCE) {
+    auto reduce_op = requests[0].reduce_op();
+    for (size_t i = 1; i < num_compared; ++i) {
+      if (error) {
+        break;
+      }
+
+      auto request_reduce_op = requests[i].reduce_op();
+      if (reduce_op != request_reduce_op) {
+        error = true;
+        error_message_stream << "Mismatched reduction: One rank did a "
+                             << ReduceOp_Name(reduce_op)
+                             << " allreduce, but another rank did a "
+                             << ReduceOp_Name(request_reduce_op) << ".";
+        break;
+      }
+    }
+    if (!error && reduce_op == ReduceOp::ADASUM &&
+        data_type != HOROVOD_FLOAT16 && data_type != HOROVOD_BFLOAT16 &&
+        data_type != HOROVOD_FLOAT32 && data_type != HOROVOD_FLOAT64) {
+      error = true;
+      error_message_stream << "Adasum allreduce requires a floating point "
+                              "tensor, got type "
+                           << DataType_Name(data_type) << ".";
+    }
+    if (!error &&
+        (reduce_op == ReduceOp::MIN || reduce_op == ReduceOp::MAX ||
+         reduce_op == ReduceOp::PRODUCT) &&
+        data_type == HOROVOD_BOOL) {
+      error = true;
+      error_message_stream << ReduceOp_Name(reduce_op)
+                           << " allreduce does not support bool tensors.";
+    }
+
+    auto compression = requests[0].compression();
+    for (size_t i = 1; i < num_compared; ++i) {
+      auto request_compression = requests[i].compression();
+      if (!error && compression != request_compression) {
+        error = true;
+        error_message_stream << "Mismatched compression: One rank did a "
+                             << Compression_Name(compression)
+                             << " allreduce, but another rank did a "
+                             << Compression_Name(request_compression) << ".";
+      }
+    }
+    if (!error && compression != Compression::NONE &&
+        (data_type != HOROVOD_FLOAT32 || reduce_op != ReduceOp::SUM)) {
+      error = true;
+      error_message_stream << Compression_Name(compression)
+                           << " allreduce requires a float32 tensor and a sum, "
+                              "got type "
+                           << DataType_Name(data_type) << " and reduction "
+                           << ReduceOp_Name(reduce_op) << ".";
+    }
+  }
+
+  // If we are doing an allreduce, reduce-scatter or broadcast, check that all
+  // tensor shapes are identical.
   if (message_type == Request::ALLREDUCE ||
+      message_type == Request::REDUCESCATTER ||
       message_type == Request::BROADCAST) {
     TensorShape tensor_shape;
     for (auto dim : requests[0].tensor_shape()) {
       tensor_shape.AddDim(dim);
     }
-    for (unsigned int i = 1; i < requests.size(); ++i) {
+    for (size_t i = 1; i < num_compared; ++i) {
       if (error) {
         break;
       }
@@ -390,11 +971,22 @@ Response Controller::ConstructResponse(std::string& name) {
     }
   }
 
-  // If we are doing an allgather, make sure all but the first dimension are
-  // the same. The first dimension may be different and the output tensor is
-  // the sum of the first dimension. Collect the sizes by rank.
+  // A reduce-scatter splits the tensor along its first dimension.
+  if (message_type == Request::REDUCESCATTER && !error &&
+      requests[0].tensor_shape().empty()) {
+    error = true;
+    error_message_stream << "Rank zero tried to "
+                         << Request::RequestType_Name(message_type)
+                         << " a rank-zero tensor.";
+  }
+
+  // If we are doing an allgather or alltoall, make sure all but the first
+  // dimension are the same. The first dimension may be different and the
+  // allgather output tensor is the sum of the first dimension. Collect the
+  // sizes by rank.
   std::vector<int64_t> tensor_sizes(requests.size());
-  if (message_type == Request::ALLGATHER) {
+  if (message_type == Request::ALLGATHER ||
+      message_type == Request::ALLTOALL) {
     TensorShape tensor_shape;
     for (auto dim : requests[0].tensor_shape()) {
       tensor_shape.AddDim(dim);
@@ -409,7 +1001,7 @@ Response Controller::ConstructResponse(std::string& name) {
       tensor_sizes[requests[0].request_rank()] = tensor_shape.dim_size(0);
     }
 
-    for (unsigned int i = 1; i < requests.size(); ++i) {
+    for (size_t i = 1; i < num_compared; ++i) {
       if (error) {
         break;
       }
@@ -449,12 +1041,63 @@ Response Controller::ConstructResponse(std::string& name) {
 
       tensor_sizes[requests[i].request_rank()] = request_shape.dim_size(0);
     }
+    for (size_t i = num_compared; i < requests.size(); ++i) {
+      tensor_sizes[requests[i].request_rank()] = requests[i].tensor_shape()[0];
+    }
+  }
+
+  // If we are doing an alltoall, check that the splits of every rank add up
+  // to its first dimension, and collect them as a size x size matrix. Empty
+  // splits divide the first dimension evenly.
+  std::vector<int64_t> splits_matrix;
+  if (message_type == Request::ALLTOALL && !error) {
+    splits_matrix.resize((size_t)size_ * size_);
+    for (auto& request : requests) {
+      int rank = request.request_rank();
+      int64_t rows = tensor_sizes[rank];
+      auto& splits = request.splits();
+      if (splits.empty()) {
+        if (rows % size_ != 0) {
+          error = true;
+          error_message_stream
+              << "Rank " << rank << " tried to "
+              << Request::RequestType_Name(message_type)
+              << " a tensor with first dimension " << rows
+              << " without splits, but it is not divisible by the number of "
+              << "ranks " << size_ << ".";
+          break;
+        }
+        std::fill(splits_matrix.begin() + (size_t)rank * size_,
+                  splits_matrix.begin() + (size_t)(rank + 1) * size_,
+                  rows / size_);
+        continue;
+      }
+
+      int64_t total = 0;
+      bool negative = false;
+      for (auto split : splits) {
+        negative |= split < 0;
+        total += split;
+      }
+      if ((int)splits.size() != size_ || negative || total != rows) {
+        error = true;
+        error_message_stream
+            << "Rank " << rank << " specified " << splits.size()
+            << " splits for " << Request::RequestType_Name(message_type)
+            << " of a tensor with first dimension " << rows
+            << ", but splits must be " << size_
+            << " non-negative numbers adding up to the first dimension.";
+        break;
+      }
+      std::copy(splits.begin(), splits.end(),
+                splits_matrix.begin() + (size_t)rank * size_);
+    }
   }
 
   // If we are doing a broadcast, check that all root ranks are identical.
   if (message_type == Request::BROADCAST) {
     int first_root_rank = requests[0].root_rank();
-    for (unsigned int i = 1; i < requests.size(); ++i) {
+    for (size_t i = 1; i < num_compared; ++i) {
       if (error) {
         break;
       }
@@ -473,7 +1116,7 @@ Response Controller::ConstructResponse(std::string& name) {
   }
 
   bool first_device_is_cpu = requests[0].device() == CPU_DEVICE_ID;
-  for (unsigned int i = 1; i < requests.size(); ++i) {
+  for (size_t i = 1; i < num_compared; ++i) {
     if (error) {
       break;
     }
@@ -490,13 +1133,60 @@ Response Controller::ConstructResponse(std::string& name) {
       break;
     }
   }
-  std::vector<int32_t> devices(requests.size());
+  // Ranks that joined take part with zeros, which only leave sums and
+  // broadcasts from a rank that did not join unchanged. They have none of
+  // the tensors, so groups cannot be split into them.
+  std::vector<int32_t> joined_ranks;
+  if (process_set_id == 0 && !joined_ranks_.empty()) {
+    joined_ranks = JoinedAbsentRanks(requests);
+  }
+  if (!joined_ranks.empty() && !error) {
+    bool root_joined = message_type == Request::BROADCAST &&
+                       std::find(joined_ranks.begin(), joined_ranks.end(),
+                                 requests[0].root_rank()) !=
+                           joined_ranks.end();
+    if (requests[0].group()) {
+      error = true;
+      error_message_stream << "Group " << name
+                           << " cannot be allreduced after ranks joined.";
+    } else if (!(message_type == Request::ALLREDUCE &&
+                 requests[0].reduce_op() == ReduceOp::SUM) &&
+               !(message_type == Request::BROADCAST && !root_joined)) {
+      error = true;
+      error_message_stream
+          << Request::RequestType_Name(message_type) << " of " << name
+          << " is not supported after ranks joined, only sum allreduces and "
+             "broadcasts from a rank that did not join are.";
+    }
+    for (auto r : joined_ranks) {
+      if (error) {
+        break;
+      }
+      bool joined_on_cpu = joined_devices_[r] == CPU_DEVICE_ID;
+      if (joined_on_cpu != first_device_is_cpu) {
+        error = true;
+        error_message_stream
+            << "Mismatched " << Request::RequestType_Name(message_type)
+            << " CPU/GPU device selection: Rank " << r << " joined on "
+            << (joined_on_cpu ? "CPU" : "GPU")
+            << ", but another rank specified device "
+            << (first_device_is_cpu ? "CPU" : "GPU") << ".";
+      }
+    }
+  }
+
+  // Ranks left out of a partial allreduce reduce in host memory.
+  std::vector<int32_t> devices(size_, CPU_DEVICE_ID);
   for (auto& request : requests) {
     devices[request.request_rank()] = request.device();
   }
+  for (auto r : joined_ranks) {
+    devices[r] = joined_devices_[r];
+  }
 
   Response response;
   response.add_tensor_name(name);
+  response.set_process_set_id(process_set_id);
   if (error) {
     std::string error_message = error_message_stream.str();
     response.set_response_type(Response::ERROR);
@@ -508,22 +1198,273 @@ Response Controller::ConstructResponse(std::string& name) {
     }
   } else if (message_type == Request::ALLREDUCE) {
     response.set_response_type(Response::ALLREDUCE);
+    response.set_reduce_op(requests[0].reduce_op());
+    response.set_compression(requests[0].compression());
   } else if (message_type == Request::BROADCAST) {
     response.set_response_type(Response::BROADCAST);
+  } else if (message_type == Request::REDUCESCATTER) {
+    response.set_response_type(Response::REDUCESCATTER);
+  } else if (message_type == Request::ALLTOALL) {
+    response.set_response_type(Response::ALLTOALL);
+    response.set_tensor_sizes(std::move(splits_matrix));
   }
   response.set_devices(devices);
+  if (!joined_ranks.empty()) {
+    response.set_absent_ranks(joined_ranks);
+    response.set_joined(true);
+    if (!error) {
+      int64_t num_elements = 1;
+      for (auto dim : requests[0].tensor_shape()) {
+        num_elements *= dim;
+      }
+      response.set_tensor_type(data_type);
+      response.add_tensor_size(num_elements);
+    }
+  }
 
   // Clear all queued up requests for this name. They are now taken care of
   // by the constructed response.
   message_table_.erase(it);
   stall_inspector_.RemoveUncachedTensor(name);
+  if (StalenessEnabled()) {
+    first_request_time_.erase(name);
+    contributions_.erase(name);
+  }
 
   return response;
 }
 
+void Controller::AddPartialResponses(ResponseList& response_list) {
+  auto now = std::chrono::steady_clock::now();
+  std::vector<std::string> timed_out;
+  for (auto& item : first_request_time_) {
+    if (now - item.second >= staleness_timeout_) {
+      timed_out.push_back(item.first);
+    }
+  }
+  std::sort(timed_out.begin(), timed_out.end());
+
+  int64_t threshold = TensorFusionThresholdBytes();
+  std::vector<Response> partial_responses;
+  std::vector<int64_t> fused_sizes;
+  std::vector<DataType> fused_types;
+  std::vector<std::pair<double, double>> fused_factors;
+  for (auto& name : timed_out) {
+    auto& requests = message_table_[name];
+
+    // The coordinator's own tensor tells whether the allreduce qualifies, so
+    // the coordinator is always waited for.
+    std::vector<bool> present(size_, false);
+    bool qualifies = true;
+    for (auto& request : requests) {
+      present[request.request_rank()] = true;
+      qualifies &= request.request_type() == Request::ALLREDUCE &&
+                   request.device() == CPU_DEVICE_ID &&
+                   request.reduce_op() == ReduceOp::SUM &&
+                   request.compression() == Compression::NONE;
+    }
+    std::vector<std::string> group_tensor_names;
+    if (!qualifies || !present[rank_] ||
+        tensor_queue_.GetGroupTensorNames(name, group_tensor_names)) {
+      continue;
+    }
+
+    // Ranks that never requested the tensor have nothing to take part with,
+    // and the others are only left out a bounded number of times in a row.
+    auto& staleness = staleness_[name];
+    std::vector<int32_t> absent_ranks;
+    for (int r = 0; r < size_; ++r) {
+      if (!present[r]) {
+        if (staleness[r] < 0 || staleness[r] >= max_staleness_) {
+          qualifies = false;
+          break;
+        }
+        absent_ranks.push_back(r);
+      }
+    }
+    if (!qualifies) {
+      continue;
+    }
+
+    auto dtype = requests[0].tensor_type();
+    int64_t num_elements = 1;
+    for (auto dim : requests[0].tensor_shape()) {
+      num_elements *= dim;
+    }
+    int64_t tensor_size = num_elements * GetTypeSize(dtype);
+    auto& entry = tensor_queue_.GetTensorEntry(name);
+    auto factors = std::make_pair(entry.prescale_factor, entry.postscale_factor);
+    int contributions = contributions_[name];
+    timeline_.NegotiateEnd(name);
+    Response response = ConstructResponse(name);
+    response.set_absent_ranks(absent_ranks);
+    if (response.response_type() == Response::ERROR) {
+      response_list.emplace_response(std::move(response));
+      continue;
+    }
+    for (auto r : absent_ranks) {
+      ++staleness[r];
+    }
+    LOG(DEBUG) << "Allreducing " << name << " without " << absent_ranks.size()
+               << " late ranks.";
+
+    size_t i = 0;
+    for (; i < partial_responses.size(); ++i) {
+      auto& partial = partial_responses[i];
+      if (partial.absent_ranks() == absent_ranks &&
+          partial.contributions() == contributions && fused_types[i] == dtype &&
+          fused_factors[i] == factors &&
+          fused_sizes[i] + tensor_size <= threshold) {
+        partial.add_tensor_name(name);
+        partial.add_tensor_size(num_elements);
+        fused_sizes[i] += tensor_size;
+        break;
+      }
+    }
+    if (i == partial_responses.size()) {
+      // The ranks left out take part with zeros of the size of the tensor.
+      response.set_tensor_type(dtype);
+      response.add_tensor_size(num_elements);
+      response.set_contributions(contributions);
+      partial_responses.push_back(std::move(response));
+      fused_sizes.push_back(tensor_size);
+      fused_types.push_back(dtype);
+      fused_factors.push_back(factors);
+    }
+  }
+
+  for (auto& response : partial_responses) {
+    response_list.emplace_response(std::move(response));
+  }
+}
+
+namespace {
+
+uint64_t HashCacheHits(const std::vector<uint32_t>& cache_hits) {
+  // FNV-1a over the bits.
+  uint64_t hash = 14695981039346656037ULL;
+  for (auto bit : cache_hits) {
+    hash = (hash ^ bit) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+} // namespace
+
+bool Controller::LookupFusedResponses(const std::vector<uint32_t>& cache_hits,
+                                      ResponseList& response_list) {
+  auto it = fused_responses_.find(HashCacheHits(cache_hits));
+  if (it == fused_responses_.end()) {
+    return false;
+  }
+  auto& fused = it->second;
+  if (fused.cache_generation != response_cache_.generation() ||
+      fused.fusion_attributes_version !=
+          tensor_queue_.FusionAttributesVersion() ||
+      fused.fusion_threshold != TensorFusionThresholdBytes() ||
+      fused.cache_hits != cache_hits) {
+    return false;
+  }
+  response_list = fused.response_list;
+  return true;
+}
+
+void Controller::StoreFusedResponses(const std::vector<uint32_t>& cache_hits,
+                                     const ResponseList& response_list) {
+  // Changing sets of hits, e.g. while the cache warms up, would otherwise
+  // accumulate. Steady state training only cycles through a few.
+  if (fused_responses_.size() >= MAX_FUSED_RESPONSES) {
+    fused_responses_.clear();
+  }
+  auto& fused = fused_responses_[HashCacheHits(cache_hits)];
+  fused.cache_hits = cache_hits;
+  fused.cache_generation = response_cache_.generation();
+  fused.fusion_attributes_version = tensor_queue_.FusionAttributesVersion();
+  fused.fusion_threshold = TensorFusionThresholdBytes();
+  fused.response_list = response_list;
+}
+
+bool Controller::StaticPlanArmed() const {
+  return static_graph_warmup_ > 0 && response_cache_.capacity() > 0 &&
+         !parameter_manager_.IsAutoTuning() && !static_plan_bits_.empty() &&
+         static_plan_repeats_ >= static_graph_warmup_;
+}
+
+void Controller::RecordStaticPlan(const CacheCoordinator& cache_coordinator,
+                                  const ResponseList& response_list) {
+  if (!cache_coordinator.invalid_bits().empty()) {
+    DiscardStaticPlan();
+    return;
+  }
+  // The cache hits and the fused response list are identical on all ranks,
+  // so every rank arms the plan in the same cycle.
+  if (cache_coordinator.cache_hits() == static_plan_bits_) {
+    ++static_plan_repeats_;
+    return;
+  }
+  static_plan_bits_ = cache_coordinator.cache_hits();
+  static_plan_ = response_list;
+  static_plan_repeats_ = 1;
+}
+
+void Controller::DiscardStaticPlan() {
+  static_plan_bits_.clear();
+  static_plan_ = ResponseList();
+  static_plan_repeats_ = 0;
+}
+
+bool Controller::ReplayStaticPlan(std::deque<Request>& message_queue,
+                                  bool can_replay, bool should_shut_down,
+                                  ResponseList& response_list) {
+  // Check whether all tensors of the plan are in the queue as cache hits.
+  size_t num_planned = 0;
+  for (auto& message : message_queue) {
+    if (response_cache_.cached(message) == ResponseCache::CacheState::HIT &&
+        std::binary_search(static_plan_bits_.begin(), static_plan_bits_.end(),
+                           response_cache_.peek_cache_bit(message))) {
+      ++num_planned;
+    }
+  }
+
+  // Single word "go" vote: bit 0 is set if the plan is ready, bit 1 if the
+  // rank does not want to shut down.
+  std::vector<long long> vote{
+      (can_replay && num_planned == static_plan_bits_.size() ? 1ll : 0ll) |
+      (should_shut_down ? 0ll : 2ll)};
+  CrossRankBitwiseAnd(vote, 1);
+  if ((vote[0] & 1) == 0) {
+    // Fall back to regular negotiation for this cycle.
+    return false;
+  }
+
+  // Tensors outside the plan wait for the next cycle.
+  for (auto& message : message_queue) {
+    if (response_cache_.cached(message) == ResponseCache::CacheState::HIT &&
+        std::binary_search(static_plan_bits_.begin(), static_plan_bits_.end(),
+                           response_cache_.peek_cache_bit(message))) {
+      stall_inspector_.RemoveCachedTensor(message.tensor_name());
+    } else {
+      tensor_queue_.PushMessageToQueue(message);
+    }
+  }
+  message_queue.clear();
+
+  // Keep the cache order in sync with ranks taking the regular path.
+  for (auto bit : static_plan_bits_) {
+    response_cache_.get_response(bit);
+  }
+
+  response_list = static_plan_;
+  response_list.set_shutdown((vote[0] & 2) == 0);
+  return true;
+}
+
 void Controller::CoordinateCacheAndState(CacheCoordinator& cache_coordinator) {
   // Sync cache and state information across workers.
   cache_coordinator.sync(shared_from_this(), timeline_enabled_);
+  if (metrics_ != nullptr) {
+    metrics_->cache_hits.Add(cache_coordinator.cache_hits().size());
+  }
 
   // If invalid cache entries exist, erase associated entries.
   if (!cache_coordinator.invalid_bits().empty()) {
@@ -549,6 +1490,45 @@ void Controller::CoordinateCacheAndState(CacheCoordinator& cache_coordinator) {
 }
 
 ResponseList Controller::FuseResponses(std::deque<Response>& responses) {
+  // If the framework assigned priorities, reduce the tensors needed first by
+  // the next iteration first. The sort is stable and priorities are the same
+  // on all ranks, so ranks fusing cached responses agree on the order. The
+  // priority of each response is looked up once.
+  bool prioritized = false;
+  std::vector<std::pair<int32_t, size_t>> priorities;
+  priorities.reserve(responses.size());
+  for (size_t i = 0; i < responses.size(); ++i) {
+    int32_t priority = 0;
+    if (responses[i].response_type() == Response::ResponseType::ALLREDUCE) {
+      priority =
+          tensor_queue_.GetTensorEntry(responses[i].tensor_names()[0]).priority;
+      prioritized |= priority != 0;
+    }
+    priorities.emplace_back(priority, i);
+  }
+  if (prioritized) {
+    std::stable_sort(priorities.begin(), priorities.end(),
+                     [](const std::pair<int32_t, size_t>& a,
+                        const std::pair<int32_t, size_t>& b) {
+                       return a.first > b.first;
+                     });
+    std::deque<Response> sorted;
+    for (auto& priority : priorities) {
+      sorted.push_back(std::move(responses[priority.second]));
+    }
+    responses.swap(sorted);
+  }
+
+  // Urgent tensors go first, so that a small allreduce the training loop is
+  // blocked on does not wait for the gradient buckets negotiated with it.
+  auto is_urgent = [this](const Response& response) {
+    return IsUrgent(response.response_type(),
+                    tensor_queue_.GetTensorEntry(response.tensor_names()[0]));
+  };
+  if (urgent_threshold_bytes_ > 0) {
+    std::stable_partition(responses.begin(), responses.end(), is_urgent);
+  }
+
   ResponseList response_list;
   while (!responses.empty()) {
 
@@ -556,11 +1536,15 @@ ResponseList Controller::FuseResponses(std::deque<Response>& responses) {
     assert(response.tensor_names().size() == 1);
     responses.pop_front();
     int64_t tensor_size = 0;
-    if (response.response_type() == Response::ResponseType::ALLREDUCE) {
-      // Attempt to add more responses to this fused response.
+    if (response.response_type() == Response::ResponseType::ALLREDUCE ||
+        response.response_type() == Response::ResponseType::REDUCESCATTER) {
+      // Attempt to add more responses to this fused response. Reduce-scatters
+      // pack their whole inputs into the fusion buffer, so they are sized like
+      // allreduces.
       const auto& entry =
           tensor_queue_.GetTensorEntry(response.tensor_names()[0]);
       tensor_size = entry.tensor->size();
+      bool urgent = IsUrgent(response.response_type(), entry);
 
       std::deque<Response> skipped_responses;
       int64_t skipped_size = 0;
@@ -574,6 +1558,11 @@ ResponseList Controller::FuseResponses(std::deque<Response>& responses) {
         if (response.response_type() == new_response.response_type() &&
             response.devices() == new_response.devices() &&
             entry.tensor->dtype() == new_entry.tensor->dtype() &&
+            entry.prescale_factor == new_entry.prescale_factor &&
+            entry.postscale_factor == new_entry.postscale_factor &&
+            response.reduce_op() == new_response.reduce_op() &&
+            response.compression() == new_response.compression() &&
+            urgent == IsUrgent(new_response.response_type(), new_entry) &&
             tensor_size + new_tensor_size <= TensorFusionThresholdBytes()) {
           // These tensors will fuse together well.
           tensor_size += new_tensor_size;
@@ -586,8 +1575,9 @@ ResponseList Controller::FuseResponses(std::deque<Response>& responses) {
           // tensors could be reduced at that time. However, mixed-precision
           // training may yield requests of various dtype in a mixed-up
           // sequence causing breakups in fusion. To counter this some look
-          // ahead is allowed.
-
+          // ahead is allowed. It is bounded by the threshold with priorities
+          // too, so that lower-priority tensors far behind are not packed
+          // ahead of the skipped ones.
           skipped_size += new_tensor_size;
           if (tensor_size + skipped_size <= TensorFusionThresholdBytes()) {
             // Skip response and look ahead for more to fuse.
@@ -658,6 +1648,56 @@ ResponseList Controller::FuseResponses(std::deque<Response>& responses) {
         }
       }
 
+      // Replace any skipped responses.
+      while (!skipped_responses.empty()) {
+        responses.push_front(std::move(skipped_responses.back()));
+        skipped_responses.pop_back();
+      }
+
+    } else if (response.response_type() == Response::ResponseType::BROADCAST) {
+      // Broadcasts of CPU tensors from the same root rank are packed into the
+      // fusion buffer, e.g. when broadcasting all parameters at startup. GPU
+      // tensors are packed too when NCCL broadcasts them.
+      const auto& entry =
+          tensor_queue_.GetTensorEntry(response.tensor_names()[0]);
+      tensor_size = entry.tensor->size();
+#if HAVE_NCCL && HOROVOD_GPU_BROADCAST == 'N'
+      bool fuse = true;
+#else
+      bool fuse = entry.device == CPU_DEVICE_ID;
+#endif
+
+      std::deque<Response> skipped_responses;
+      int64_t skipped_size = 0;
+      while (fuse && !responses.empty()) {
+        auto new_response = responses.front();
+        assert(new_response.tensor_names().size() == 1);
+        const auto& new_entry =
+            tensor_queue_.GetTensorEntry(new_response.tensor_names()[0]);
+        int64_t new_tensor_size = new_entry.tensor->size();
+
+        if (response.response_type() == new_response.response_type() &&
+            response.devices() == new_response.devices() &&
+            entry.tensor->dtype() == new_entry.tensor->dtype() &&
+            entry.root_rank == new_entry.root_rank &&
+            tensor_size + new_tensor_size <= TensorFusionThresholdBytes()) {
+          // These tensors will fuse together well.
+          tensor_size += new_tensor_size;
+          response.add_tensor_name(new_response.tensor_names()[0]);
+          responses.pop_front();
+        } else {
+          // Look ahead past broadcasts of other dtypes or root ranks, as
+          // for allreduce.
+          skipped_size += new_tensor_size;
+          if (tensor_size + skipped_size <= TensorFusionThresholdBytes()) {
+            skipped_responses.push_back(std::move(responses.front()));
+            responses.pop_front();
+          } else {
+            break;
+          }
+        }
+      }
+
       // Replace any skipped responses.
       while (!skipped_responses.empty()) {
         responses.push_front(std::move(skipped_responses.back()));
@@ -713,14 +1753,97 @@ bool Controller::IncrementTensorCount(const Request& msg) {
 
   timeline_.NegotiateRankReady(name, msg.request_rank());
 
+  // A rank left out of partial allreduces of the tensor folds its late
+  // tensors into this request.
+  if (StalenessEnabled() && msg.process_set_id() == 0) {
+    if (table_iter->second.size() == 1) {
+      first_request_time_[name] = std::chrono::steady_clock::now();
+    }
+    auto& staleness = staleness_[name];
+    if (staleness.empty()) {
+      staleness.assign(size_, -1);
+    }
+    int& missed = staleness[msg.request_rank()];
+    contributions_[name] += 1 + std::max(missed, 0);
+    missed = 0;
+  }
+
+  // Tensors of unregistered process sets, and tensors requested within
+  // different sets, are ready right away for ConstructResponse to report the
+  // error.
   std::vector<Request>& messages = table_iter->second;
   int count = (int)messages.size();
-  bool ready_to_reduce = count == size_;
+  int expected = size_;
+  auto process_set_id = messages[0].process_set_id();
+  if (process_set_id != 0) {
+    auto process_set = GetProcessSet(process_set_id);
+    expected = process_set != nullptr ? process_set->Size() : count;
+    if (HasJoinedMember(process_set_id)) {
+      expected = count;
+    }
+  } else if (!joined_ranks_.empty()) {
+    expected -= (int)JoinedAbsentRanks(messages).size();
+  }
+  bool ready_to_reduce =
+      count == expected || msg.process_set_id() != process_set_id;
   if (ready_to_reduce) {
     timeline_.NegotiateEnd(name);
   }
   return ready_to_reduce;
 }
 
+void Controller::RecordJoin(const Request& msg) {
+  int32_t rank = msg.request_rank();
+  if (joined_devices_.empty()) {
+    joined_devices_.assign(size_, CPU_DEVICE_ID);
+  }
+  joined_devices_[rank] = msg.device();
+  auto it = std::lower_bound(joined_ranks_.begin(), joined_ranks_.end(), rank);
+  if (it == joined_ranks_.end() || *it != rank) {
+    joined_ranks_.insert(it, rank);
+  }
+  LOG(DEBUG) << "Rank " << rank << " joined, " << joined_ranks_.size()
+             << " of " << size_ << " ranks joined.";
+}
+
+std::vector<int32_t>
+Controller::JoinedAbsentRanks(const std::vector<Request>& requests) const {
+  std::vector<int32_t> absent_ranks;
+  for (auto r : joined_ranks_) {
+    bool requested = false;
+    for (auto& request : requests) {
+      if (request.request_rank() == r) {
+        requested = true;
+        break;
+      }
+    }
+    if (!requested) {
+      absent_ranks.push_back(r);
+    }
+  }
+  return absent_ranks;
+}
+
+bool Controller::HasJoinedMember(int32_t process_set_id) const {
+  auto process_set = GetProcessSet(process_set_id);
+  if (process_set == nullptr) {
+    return false;
+  }
+  for (auto r : joined_ranks_) {
+    if (process_set->IsMember(r)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::shared_ptr<const ProcessSet>
+Controller::GetProcessSet(int32_t id) const {
+  if (id == 0 || process_sets_ == nullptr) {
+    return nullptr;
+  }
+  return process_sets_->Get(id);
+}
+
 } // namespace common
 } // namespace horovod
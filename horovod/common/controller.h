@@ -16,14 +16,22 @@
 #ifndef HOROVOD_CONTROL_MANAGER_H
 #define HOROVOD_CONTROL_MANAGER_H
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <mutex>
 #include <queue>
+#include <unordered_map>
 #include <vector>
 
+#include "metrics.h"
 #include "parameter_manager.h"
+#include "process_set.h"
+#include "request_trace.h"
 #include "response_cache.h"
 #include "stall_inspector.h"
 #include "tensor_queue.h"
+#include "thread_pool.h"
 #include "timeline.h"
 
 namespace horovod {
@@ -54,9 +62,36 @@ public:
 
   virtual void Barrier(Communicator communicator) = 0;
 
+  // Prepare for negotiation running on a different thread than collective
+  // operations. Returns false if the controller does not support it.
+  virtual bool EnablePipelinedNegotiation() { return false; }
+
+  // Aggregate requests per node on local rank zero so that the coordinator
+  // only communicates with one rank per node. Returns false if the
+  // controller does not support it.
+  virtual bool EnableHierarchicalNegotiation() { return false; }
+
   // Concrete controller functions
+
+  // Broadcasts the parameters of the coordinator, with the overrides set
+  // through SetParameterOverrides if any, and applies them on all ranks.
+  // Called by all ranks at the same cycle boundary.
   void SynchronizeParameters();
 
+  // Sets parameters on the coordinator from any thread. They are sent to all
+  // ranks at the end of the next cycle, which is negotiated with the
+  // coordinator even if its tensors are cached.
+  void SetParameterOverrides(const ParameterManager::Overrides& overrides);
+
+  // Turns the timeline marks of cached tensors on or off on all ranks from
+  // any thread of the coordinator, at the end of the next cycle like
+  // parameter overrides.
+  void RequestTimelineEnabled(bool value);
+
+  // Drops the negotiation state of the previous membership, before the
+  // controller is initialized again for a new one.
+  void ResetMembership();
+
   // This function performs all the preparation work for workers to agree
   // on what tensors to be all-reduced or all-gathered. The output is a
   // response list that includes all tensors that are ready.
@@ -101,6 +136,10 @@ public:
 
   int GetLocalSizeAtCrossRank(int i);
 
+  // Smallest number of ranks on a node. The local ranks below it are present
+  // on every node, so their cross-node communicators span all nodes.
+  int GetMinLocalSize() const { return min_local_size_; };
+
   // Set ranks that will be used to create global communicator.
   void SetRanks(const int* ranks, int nrank) {
     ranks_.clear();
@@ -109,7 +148,72 @@ public:
     }
   };
 
-  void SetTimelineEnabled(bool value) { timeline_enabled_ = value; }
+  // Must be the same on all ranks, use RequestTimelineEnabled once the
+  // background thread runs.
+  void SetTimelineEnabled(bool value) {
+    timeline_enabled_ = value;
+    timeline_requested_ = value;
+  }
+
+  // Count cache hits, misses and stalled tensors in the given metrics.
+  void SetMetrics(Metrics* metrics) { metrics_ = metrics; }
+
+  // Process sets the tensors of requests with a process set id are counted
+  // and validated against.
+  void SetProcessSets(const ProcessSetTable* process_sets) {
+    process_sets_ = process_sets;
+  }
+
+  // Replay the fused response list once the same set of cached tensors has
+  // been fused in this many consecutive cycles. Zero disables replay.
+  void SetStaticGraphWarmup(int cycles) { static_graph_warmup_ = cycles; }
+
+  // Record the requests submitted on this rank in every cycle to the trace,
+  // for replay in hvd_controller_sim. Null disables recording.
+  void SetRequestTrace(std::shared_ptr<RequestTraceWriter> request_trace) {
+    request_trace_ = std::move(request_trace);
+  }
+
+  // Lets the coordinator grow the response cache, up to max_capacity, when
+  // evicted tensors are negotiated again, and shrink it back towards its
+  // current capacity when most of it stays unused. New capacities are sent to
+  // all ranks with the parameters, so every rank resizes its cache at the
+  // same cycle boundary. Zero, or not above the current capacity, disables
+  // it.
+  void SetCacheCapacityMax(uint32_t max_capacity);
+
+  // Allreduces of tensors of at most this many bytes, e.g. loss scalars the
+  // training loop waits on, are urgent. Zero disables it.
+  void SetUrgentThresholdBytes(int64_t bytes) { urgent_threshold_bytes_ = bytes; }
+
+  // Check the requests of the tensors that become ready in a cycle on this
+  // many threads of the coordinator, the calling thread included. The workers
+  // are pinned to the given CPUs in turn unless the list is empty.
+  void SetNegotiationThreads(int num_threads, const std::vector<int>& cpus);
+
+  // Urgent tensors are fused only with each other, and performed before the
+  // other responses of a cycle.
+  bool IsUrgent(Response::ResponseType response_type,
+                const TensorTableEntry& entry) const {
+    return urgent_threshold_bytes_ > 0 &&
+           response_type == Response::ResponseType::ALLREDUCE &&
+           entry.tensor->size() <= urgent_threshold_bytes_;
+  }
+
+  // Bounded staleness: once the first request to allreduce a tensor in host
+  // memory is older than timeout_ms, the coordinator performs the allreduce
+  // without the ranks that are late, unless one of them was already left out
+  // of max_staleness consecutive allreduces of the tensor. The late ranks
+  // take part with zeros, get the result once their tensor arrives and fold
+  // their tensor into their next allreduce of it. A timeout of zero disables
+  // it. Requires the response cache to be disabled.
+  void SetStaleness(double timeout_ms, int max_staleness) {
+    staleness_timeout_ = std::chrono::microseconds((int64_t)(timeout_ms * 1000));
+    max_staleness_ = timeout_ms > 0 ? std::max(max_staleness, 1) : 0;
+  }
+
+  bool StalenessEnabled() const { return max_staleness_ > 0; }
+
   std::vector<int>& GetRanks() { return ranks_; };
   int GetRank() { return rank_; };
   int GetLocalRank() { return local_rank_; };
@@ -118,6 +222,8 @@ public:
   int GetLocalSize() { return local_size_; };
   int GetCrossSize() { return cross_size_; };
   const std::vector<int>& GetLocalCommRanks() { return local_comm_ranks_; };
+  const std::vector<int>& GetCrossCommRanks() { return cross_comm_ranks_; };
+  const std::vector<int>& GetLocalRanks() { return local_ranks_; };
   bool IsCoordinator() const { return is_coordinator_; };
   bool IsHomogeneous() const { return is_homogeneous_; };
 
@@ -142,7 +248,19 @@ protected:
   // also contains error messages in case the submitted Requests were not
   // valid (for example, contained mismatched shapes or types).
   // Constructing the Response, thus, requires a whole lot of error checking.
-  Response ConstructResponse(std::string& name);
+  // If requests_match, the requests are known to agree with each other and
+  // only the checks of the first one are done.
+  Response ConstructResponse(std::string& name, bool requests_match = false);
+
+  // Whether the requests agree in everything ConstructResponse compares
+  // between ranks. Only reads the requests, so that it can run on several
+  // threads. A false result only means the full checks are needed.
+  static bool RequestsMatch(const std::vector<Request>& requests);
+
+  // Runs RequestsMatch on the requests of each name, in parallel if there
+  // are many of them.
+  void MatchRequests(const std::vector<std::string>& names,
+                     std::vector<char>& matches);
 
   // Routine to sync cache hit and invalid bit sets across workers.
   // Also determines global shutdown state and whether uncached requests
@@ -151,22 +269,90 @@ protected:
 
   ResponseList FuseResponses(std::deque<Response>& responses);
 
+  // Response to a tensor of a process set, with the data type and byte size
+  // of the tensor taken from its requests, since the coordinator need not be
+  // a member of the set and have the tensor.
+  struct ProcessSetResponse {
+    Response response;
+    DataType dtype;
+    int64_t size;
+  };
+
+  // Fuses the allreduces of the same process set up to the fusion threshold
+  // and appends them, and the errors, to the response list.
+  void AddProcessSetResponses(std::vector<ProcessSetResponse>& responses,
+                              ResponseList& response_list);
+
+  // Expands the response negotiated for a group into responses fusing its
+  // tensors in order, up to the fusion threshold each, and appends them.
+  void AddGroupResponses(const Response& group_response,
+                         const std::vector<std::string>& tensor_names,
+                         ResponseList& response_list);
+
+  // Sets response_list to the fused responses last computed for exactly
+  // these cache hits, if the cached responses, the fusion attributes of the
+  // tensors and the fusion threshold are unchanged since.
+  bool LookupFusedResponses(const std::vector<uint32_t>& cache_hits,
+                            ResponseList& response_list);
+
+  void StoreFusedResponses(const std::vector<uint32_t>& cache_hits,
+                           const ResponseList& response_list);
+
+  // Static graph replay: whether a recorded plan may be replayed this cycle.
+  bool StaticPlanArmed() const;
+
+  // Counts consecutive cycles fusing the same cache hits into the same plan.
+  void RecordStaticPlan(const CacheCoordinator& cache_coordinator,
+                        const ResponseList& response_list);
+
+  void DiscardStaticPlan();
+
+  // Agrees across ranks with a single bitwise AND whether every rank can
+  // replay and has the planned tensors queued. If so, requeues any other
+  // tensor and returns the recorded plan in response_list.
+  bool ReplayStaticPlan(std::deque<Request>& message_queue, bool can_replay,
+                        bool should_shut_down, ResponseList& response_list);
+
+  // Appends partial allreduces of the tensors that timed out waiting for
+  // some ranks, fused with each other if the same ranks are absent.
+  void AddPartialResponses(ResponseList& response_list);
+
   // Return the total byte size of the final allgathered output tensor
   int64_t
   TotalByteSizeOfAllgatherOutput(const std::vector<int64_t>& tensor_sizes,
                                  const TensorTableEntry& entry);
 
   // Store the Request for a name, and return whether the total count of
-  // Requests for that tensor is now equal to the HOROVOD size (and thus we are
-  // ready to reduce the tensor).
+  // Requests for that tensor is now equal to the HOROVOD size, or the size of
+  // its process set (and thus we are ready to reduce the tensor). Ranks that
+  // joined count as having requested the tensors of the global set.
   bool IncrementTensorCount(const Request& msg);
 
+  // Records the join of the rank of the request on the coordinator, see
+  // EnqueueJoin.
+  void RecordJoin(const Request& msg);
+
+  // Ranks that joined and are not among the ranks of the requests. They take
+  // part in the response with zeros.
+  std::vector<int32_t>
+  JoinedAbsentRanks(const std::vector<Request>& requests) const;
+
+  // Whether a rank that joined is a member of the registered process set.
+  // Its tensors are then ready right away for ConstructResponse to report
+  // the error.
+  bool HasJoinedMember(int32_t process_set_id) const;
+
+  // Returns the registered process set with the given id, or nullptr for the
+  // global set and unregistered ids.
+  std::shared_ptr<const ProcessSet> GetProcessSet(int32_t id) const;
+
   int rank_ = 0;
   int local_rank_ = 0;
   int cross_rank_ = 0;
   int size_ = 1;
   int local_size_ = 1;
   int cross_size_ = 1;
+  int min_local_size_ = 1;
   bool is_coordinator_ = false;
   bool is_homogeneous_ = false;
 
@@ -176,11 +362,16 @@ protected:
   // COMM_WORLD ranks of processes running on this node.
   std::vector<int> local_comm_ranks_;
 
+  // COMM_WORLD ranks of the processes at each cross rank, in the order of the
+  // cross-node communicator.
+  std::vector<int> cross_comm_ranks_;
+
+  // Local rank of every COMM_WORLD rank.
+  std::vector<int> local_ranks_;
+
   // Numbers of ranks running per node
   std::vector<int> local_sizes_for_cross_rank_;
 
-  uint32_t cache_capacity_ = 1024;
-
   StallInspector stall_inspector_;
 
   // Only exists on the coordinator node (rank zero). Maintains a vector of
@@ -189,6 +380,76 @@ protected:
 
   bool timeline_enabled_ = false;
 
+  int64_t urgent_threshold_bytes_ = 0;
+
+  // Workers checking requests on the coordinator, if any.
+  ThreadPool negotiation_pool_;
+
+  // Bounded staleness state, only used on the coordinator: when the first
+  // request for each tensor in the message table arrived, the number of
+  // tensors its requests sum, counting late ones folded in, and per rank -1
+  // if the rank never requested the tensor, otherwise the number of
+  // consecutive partial allreduces of it the rank was left out of.
+  std::chrono::steady_clock::duration staleness_timeout_{0};
+  int max_staleness_ = 0;
+  std::unordered_map<std::string, std::chrono::steady_clock::time_point>
+      first_request_time_;
+  std::unordered_map<std::string, int> contributions_;
+  std::unordered_map<std::string, std::vector<int>> staleness_;
+
+  // Whether this rank joined and waits for all ranks to join. On the
+  // coordinator, the ranks that joined in ascending order and the device
+  // every rank joined with, indexed by rank.
+  bool joined_ = false;
+  std::vector<int32_t> joined_ranks_;
+  std::vector<int32_t> joined_devices_;
+
+  // Adaptive response cache capacity, decided on the coordinator. The
+  // number of evicted tensors put again since the last decision, and the
+  // negotiated cycles without such tensors. The cache counts the bits used
+  // over those cycles.
+  void AdaptCacheCapacity();
+  static constexpr int CACHE_SHRINK_CYCLES = 1000;
+  uint32_t cache_min_capacity_ = 0;
+  uint32_t cache_max_capacity_ = 0;
+  uint64_t cache_reput_seen_ = 0;
+  int cache_quiet_cycles_ = 0;
+
+  Metrics* metrics_ = nullptr;
+
+  std::shared_ptr<RequestTraceWriter> request_trace_;
+
+  const ProcessSetTable* process_sets_ = nullptr;
+
+  // Parameter overrides waiting to be sent to all ranks, only set on the
+  // coordinator.
+  // A synchronization is pending when overrides are set or the timeline is
+  // turned on or off.
+  std::mutex overrides_mutex_;
+  ParameterManager::Overrides overrides_;
+  bool overrides_set_ = false;
+  bool timeline_requested_ = false;
+  std::atomic_bool overrides_pending_{false};
+
+  // Fused responses of the cache hit fast path, keyed by a hash of the cache
+  // hits, and the state they were fused under.
+  struct FusedResponses {
+    std::vector<uint32_t> cache_hits;
+    uint64_t cache_generation;
+    uint64_t fusion_attributes_version;
+    int64_t fusion_threshold;
+    ResponseList response_list;
+  };
+  static constexpr size_t MAX_FUSED_RESPONSES = 16;
+  std::unordered_map<uint64_t, FusedResponses> fused_responses_;
+
+  // Static graph replay state: cache bits and fused responses of the plan,
+  // and the number of consecutive cycles it was seen.
+  int static_graph_warmup_ = 0;
+  std::vector<uint32_t> static_plan_bits_;
+  ResponseList static_plan_;
+  int static_plan_repeats_ = 0;
+
   // Outside dependencies
   TensorQueue& tensor_queue_;
 
@@ -15,38 +15,185 @@
 
 #include "fusion_buffer_manager.h"
 
+#include "logging.h"
+#include "thread_pool.h"
+
 namespace horovod {
 namespace common {
 
+namespace {
+
+constexpr int64_t MIN_SIZE_CLASS = 1 << 20;
+
+} // namespace
+
+int64_t FusionBufferManager::SizeClass(int64_t threshold) {
+  int64_t size = MIN_SIZE_CLASS;
+  while (size < threshold) {
+    size <<= 1;
+  }
+  return size;
+}
+
 Status FusionBufferManager::InitializeBuffer(int64_t threshold, int device, std::shared_ptr<OpContext> context,
                                              int stream_id,
                                              std::function<void()> on_start_init,
                                              std::function<void()> on_end_init) {
-  auto& elem = tensor_fusion_buffers_[std::make_tuple(device, context->framework(), stream_id)];
-  auto& buffer = elem.first;
-  int64_t& size = elem.second;
-  if (size != threshold) {
-    buffer.reset();
-    size = 0;
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto& arena = GetArena(device, context->framework(), stream_id);
+  arena.last_used = cycle_;
+  if (arena.slice_size >= threshold &&
+      arena.slices[arena.current] != nullptr) {
+    return Status::OK();
   }
 
-  if (buffer == nullptr) {
-    on_start_init();
-    size = threshold;
+  // Lazily allocate persistent buffer for Tensor Fusion and keep it per
+  // device until it is idle, only growing it to the size class of a larger
+  // threshold.
+  on_start_init();
+  auto slice_size = std::max(arena.slice_size, SizeClass(threshold));
+  auto arena_size = slice_size * (int64_t)arena.slices.size();
+  std::shared_ptr<PersistentBuffer> buffer;
+  Status status = context->AllocatePersistent(arena_size, &buffer);
+  if (status.ok()) {
+    if (device == CPU_DEVICE_ID && numa_node_ >= 0 &&
+        !BindToNumaNode(const_cast<void*>(buffer->AccessData(context)),
+                        (size_t)arena_size, numa_node_)) {
+      LOG(WARNING) << "Unable to place the fusion buffer on NUMA node "
+                   << numa_node_ << ".";
+    }
+    Release(arena);
+    arena.slice_size = slice_size;
+    allocated_bytes_ += arena_size;
+    ++allocated_arenas_;
+    ++generations_[arena.host ? 0 : 1];
+    for (size_t i = 0; i < arena.slices.size(); ++i) {
+      arena.slices[i] = std::make_shared<PersistentBufferSlice>(
+          buffer, slice_size * (int64_t)i);
+    }
+  }
+  on_end_init();
+
+  return status;
+}
+
+std::shared_ptr<PersistentBuffer> FusionBufferManager::GetBuffer(int device, Framework framework, int stream_id) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto& arena = GetArena(device, framework, stream_id);
+  return arena.slices[arena.current];
+}
+
+void FusionBufferManager::NextSlot(int device, Framework framework, int stream_id) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto& arena = GetArena(device, framework, stream_id);
+  arena.current = (arena.current + 1) % arena.slices.size();
+  arena.last_used = cycle_;
+}
+
+int FusionBufferManager::ResolveStream(int64_t threshold, int device,
+                                       Framework framework, int stream_id,
+                                       bool global) {
+  if (budget_ <= 0 || device == CPU_DEVICE_ID) {
+    return stream_id;
+  }
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto key = std::make_tuple(framework, stream_id);
+  auto needed_bytes = SizeClass(threshold) * (int64_t)num_slots_;
+  int64_t reserved_bytes = 0;
+  int64_t total_bytes = 0;
+  for (auto& entry : reservations_) {
+    if (entry.first == key) {
+      reserved_bytes = entry.second.bytes;
+    }
+    total_bytes += entry.second.bytes;
+  }
+  if (needed_bytes <= reserved_bytes ||
+      total_bytes - reserved_bytes + needed_bytes <= budget_) {
+    if (global) {
+      auto& reservation = reservations_[key];
+      reservation.bytes = std::max(reserved_bytes, needed_bytes);
+      reservation.last_used = cycle_;
+    }
+    return stream_id;
+  }
 
-    // Lazily allocate persistent buffer for Tensor Fusion and keep it
-    // forever per device.
-    Status status = context->AllocatePersistent(threshold, &buffer);
-    on_end_init();
+  // Every framework gets the buffers of one stream, even if they do not fit
+  // in the budget.
+  int shared_stream = -1;
+  for (auto& entry : reservations_) {
+    if (std::get<0>(entry.first) == framework &&
+        std::get<1>(entry.first) != stream_id && entry.second.bytes > 0) {
+      shared_stream = std::get<1>(entry.first);
+      break;
+    }
+  }
+  if (shared_stream < 0) {
+    if (global) {
+      auto& reservation = reservations_[key];
+      reservation.bytes = needed_bytes;
+      reservation.last_used = cycle_;
+    }
+    return stream_id;
+  }
+  if (global) {
+    reservations_.erase(key);
+    auto& reservation =
+        reservations_[std::make_tuple(framework, shared_stream)];
+    reservation.bytes = std::max(reservation.bytes, needed_bytes);
+    reservation.last_used = cycle_;
+  }
+  Release(GetArena(device, framework, stream_id));
+  return shared_stream;
+}
 
-    return status;
+void FusionBufferManager::EndCycle() {
+  std::lock_guard<std::mutex> guard(mutex_);
+  ++cycle_;
+  if (idle_cycles_ <= 0) {
+    return;
   }
+  for (auto& entry : arenas_) {
+    auto& arena = entry.second;
+    if (arena.slice_size > 0 && cycle_ - arena.last_used > idle_cycles_) {
+      Release(arena);
+    }
+  }
+  // All ranks end the same cycles, so they drop the same reservations.
+  for (auto it = reservations_.begin(); it != reservations_.end();) {
+    if (cycle_ - it->second.last_used > idle_cycles_) {
+      it = reservations_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
 
-  return Status::OK();
+void FusionBufferManager::Release(FusionBufferArena& arena) {
+  if (arena.slice_size == 0) {
+    return;
+  }
+  allocated_bytes_ -= arena.slice_size * (int64_t)arena.slices.size();
+  --allocated_arenas_;
+  arena.slices.assign(arena.slices.size(), nullptr);
+  arena.slice_size = 0;
+  // Cached references to the buffer memory, such as persistent MPI requests,
+  // must not be used anymore.
+  ++generations_[arena.host ? 0 : 1];
 }
 
-std::shared_ptr<PersistentBuffer> FusionBufferManager::GetBuffer(int device, Framework framework, int stream_id) {
-  return tensor_fusion_buffers_[std::make_tuple(device, framework, stream_id)].first;
+FusionBufferManager::FusionBufferArena&
+FusionBufferManager::GetArena(int device, Framework framework, int stream_id) {
+  if (device == CPU_DEVICE_ID) {
+    stream_id = 0;
+  }
+  auto& arena = arenas_[std::make_tuple(device, framework, stream_id)];
+  arena.host = device == CPU_DEVICE_ID;
+  if (arena.slices.size() != (size_t)num_slots_) {
+    Release(arena);
+    arena.slices.assign(num_slots_, nullptr);
+    arena.current %= arena.slices.size();
+  }
+  return arena;
 }
 
 } // namespace common
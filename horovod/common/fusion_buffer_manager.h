@@ -16,8 +16,13 @@
 #ifndef HOROVOD_FUSION_BUFFER_MANAGER_H
 #define HOROVOD_FUSION_BUFFER_MANAGER_H
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 
 #include "common.h"
 #include "hashes.h"
@@ -25,11 +30,34 @@
 namespace horovod {
 namespace common {
 
-// Encapsulates the process of creating and destroying fusion buffers as the requested
-// threshold is changed.
+// A fusion buffer sliced out of a larger buffer, which it keeps alive.
+class PersistentBufferSlice : public PersistentBuffer {
+public:
+  PersistentBufferSlice(std::shared_ptr<PersistentBuffer> arena, int64_t offset)
+      : arena_(std::move(arena)), offset_(offset) {}
+
+  const void* AccessData(std::shared_ptr<OpContext> context) const override {
+    return static_cast<const uint8_t*>(arena_->AccessData(context)) + offset_;
+  }
+
+private:
+  std::shared_ptr<PersistentBuffer> arena_;
+  int64_t offset_;
+};
+
+// Host and GPU responses may be performed on different threads at the same
+// time, so the buffers are looked up and allocated under a lock. Host
+// collectives run one at a time, so host buffers are shared by all streams.
 class FusionBufferManager {
 public:
-  // Initializes a buffer of the given threshold size if not already cached.
+  // Initializes a buffer of at least the given threshold size if not already
+  // cached.
+  //
+  // The buffers of all the slots of a device, framework and stream are slices
+  // of one arena, allocated together. The slices are sized in powers of two
+  // and only ever grow, so that changes of the threshold, e.g. while
+  // autotuning, reallocate the arena at most once per size class rather than
+  // on every change.
   //
   // Args:
   //  threshold: Size of the buffer in bytes.
@@ -46,13 +74,117 @@ public:
   // Returns the buffer associated with the given device and framework, or null.
   std::shared_ptr<PersistentBuffer> GetBuffer(int device, Framework framework, int stream_id);
 
+  // Places CPU fusion buffers allocated from now on on the given NUMA node,
+  // typically the one local to the network interface. Negative disables it.
+  void SetNumaNode(int numa_node) { numa_node_ = numa_node; }
+
+  // Sets the number of buffers kept per device, framework and stream. With
+  // more than one, consecutive fused responses use different buffers so that
+  // packing the next one does not have to wait for the previous one.
+  void SetNumSlots(int num_slots) { num_slots_ = std::max(num_slots, 1); }
+
+  int NumSlots() const { return num_slots_; }
+
+  // Moves on to the next buffer for the given device, framework and stream.
+  // The buffer returned by GetBuffer changes accordingly.
+  void NextSlot(int device, Framework framework, int stream_id);
+
+  // Caps the bytes of the buffers of each device. Zero disables the cap.
+  void SetBudget(int64_t budget_bytes) { budget_ = budget_bytes; }
+
+  // Releases the buffers of a device, framework and stream once they have
+  // not been used for the given number of cycles. Zero keeps them forever.
+  void SetIdleCycles(int64_t idle_cycles) { idle_cycles_ = idle_cycles; }
+
+  // Returns the stream whose buffers a fused response of the given stream
+  // uses. It is the stream itself, unless its buffers would not fit in the
+  // budget, in which case it is the first stream of the framework that has
+  // buffers, and the buffers of the given stream are released. The response
+  // has to run on the returned stream, so that it is ordered with the other
+  // users of the buffers.
+  //
+  // The choice must be the same on all ranks, while the buffers a rank
+  // actually holds depend on the process sets it is a member of. It is thus
+  // made on reservations of the streams, which only responses of all ranks
+  // (global) update, in the negotiated order. Responses of process sets
+  // follow the reservations without changing them.
+  int ResolveStream(int64_t threshold, int device, Framework framework,
+                    int stream_id, bool global);
+
+  // Ends a cycle of the background loop, releasing the buffers that have been
+  // idle for too long. Operations still in flight keep their buffer alive.
+  void EndCycle();
+
+  // Bytes and number of the buffers currently allocated, over all devices.
+  // May be called from any thread.
+  int64_t AllocatedBytes() const {
+    return allocated_bytes_.load(std::memory_order_relaxed);
+  }
+  int64_t AllocatedArenas() const {
+    return allocated_arenas_.load(std::memory_order_relaxed);
+  }
+
+  // Incremented whenever host buffers, or GPU buffers for a GPU device, are
+  // allocated or released. Allocations follow the fusion threshold, so they
+  // happen at the same point on all ranks.
+  uint64_t Generation(int device) const {
+    return generations_[device == CPU_DEVICE_ID ? 0 : 1].load(
+        std::memory_order_acquire);
+  }
+
 private:
-  // Memory buffers for Tensor Fusion.  They are keyed off device ID and
-  // framework, and all are allocated tensor_fusion_threshold bytes if
-  // initialized.
-  std::unordered_map<
-      std::tuple<int, Framework, int>,
-      std::pair<std::shared_ptr<PersistentBuffer>, int64_t>> tensor_fusion_buffers_;
+  int numa_node_ = -1;
+
+  int num_slots_ = 1;
+
+  std::mutex mutex_;
+
+  // Generations of the host and of the GPU buffers.
+  std::atomic<uint64_t> generations_[2] = {{0}, {0}};
+
+  int64_t budget_ = 0;
+
+  int64_t idle_cycles_ = 0;
+
+  // Number of cycles ended so far.
+  int64_t cycle_ = 0;
+
+  std::atomic<int64_t> allocated_bytes_{0};
+
+  std::atomic<int64_t> allocated_arenas_{0};
+
+  struct FusionBufferArena {
+    int64_t slice_size = 0;
+    // One slice per slot, each keeping the arena alive.
+    std::vector<std::shared_ptr<PersistentBuffer>> slices;
+    size_t current = 0;
+    // Cycle of the last use.
+    int64_t last_used = 0;
+    bool host = false;
+  };
+
+  // Requires mutex_.
+  FusionBufferArena& GetArena(int device, Framework framework, int stream_id);
+
+  // Drops the slices of the arena, freeing its memory once the operations
+  // holding them complete.
+  void Release(FusionBufferArena& arena);
+
+  // Bytes of buffers reserved by the GPU responses of all ranks for a
+  // framework and stream, and the cycle of their last use. Requires mutex_.
+  struct StreamReservation {
+    int64_t bytes = 0;
+    int64_t last_used = 0;
+  };
+  std::map<std::tuple<Framework, int>, StreamReservation> reservations_;
+
+  // Smallest power of two of at least threshold bytes, and at least 1 MB.
+  static int64_t SizeClass(int64_t threshold);
+
+  // Memory buffers for Tensor Fusion. They are keyed off device ID, framework
+  // and stream, and are allocated when first used.
+  std::unordered_map<std::tuple<int, Framework, int>, FusionBufferArena>
+      arenas_;
 };
 
 } // namespace common
@@ -21,9 +21,14 @@
 #include <thread>
 
 #include "fusion_buffer_manager.h"
+#include "metrics.h"
 #include "parameter_manager.h"
+#include "process_set.h"
 #include "response_cache.h"
+#include "response_queue.h"
+#include "shared_memory.h"
 #include "tensor_queue.h"
+#include "thread_pool.h"
 #include "timeline.h"
 #include "utils/env_parser.h"
 
@@ -53,49 +58,138 @@ struct HorovodGlobalState {
   // Timeline writer.
   Timeline timeline;
 
+  // Runtime metrics, and the optional endpoint serving them.
+  Metrics metrics;
+  MetricsServer metrics_server;
+
+  // Rank subsets registered for concurrent allreduces.
+  ProcessSetTable process_sets;
+
   // Flag indicating whether timeline enabled.
   bool timeline_enabled = false;
 
-  // Flag indicating whether to mark cycles in the timeline.
-  bool mark_cycles_in_timeline = false;
-
   ParameterManager parameter_manager;
 
   // Encapsulates the fusion buffers, handles resizing and auto-tuning of buffer
   // size.
   FusionBufferManager fusion_buffer;
 
+  // Worker threads splitting large CPU fusion buffer copies across cores.
+  ThreadPool fusion_memcpy_pool;
+
+  // Worker that enqueues the NCCL allreduces of a response list while the
+  // background thread performs its host collectives, if started.
+  ThreadPool gpu_enqueue_pool;
+
+  // Number of cycles after which unused pinned host buffers are unmapped,
+  // unless zero.
+  int64_t buffer_idle_cycles = 0;
+
   // Time point when last cycle started.
   std::chrono::steady_clock::time_point last_cycle_start;
 
+  // Whether NCCL allreduce makes its stream wait for the ready events of the
+  // tensors rather than the background thread polling them.
+  bool stream_wait_ready_events = false;
+
+  // Whether CUDA fusion buffer packing and unpacking is done with a single
+  // batched memcpy kernel launch instead of one cudaMemcpyAsync per tensor.
+  bool batch_d2d_memcopies = true;
+
+  // Whether framework threads may allreduce GPU tensors on their own streams
+  // for CUDA graph capture, over a communicator of their own.
+  bool cuda_graph = false;
+
+  // Size of the chunks GPU buffers are staged through host memory in when
+  // the MPI library cannot access device memory, and by Gloo.
+  int64_t cuda_staging_chunk_bytes = 4 * 1024 * 1024;
+
+  // Whether to start a new cycle as soon as a tensor is enqueued, using the
+  // cycle time only as an upper bound on the wait.
+  bool wake_on_enqueue = false;
+
+  // Whether the background thread spins on the tensor queue until the cycle
+  // deadline instead of sleeping, and polls ready events without sleeping.
+  bool busy_poll = false;
+
+  // CPUs of this rank given by HOROVOD_THREAD_AFFINITY. The background
+  // thread runs on the first one, and the other threads of Horovod on the
+  // rest in turn, or on the first one too if there is no other.
+  std::vector<int> thread_cpus;
+
+  // Whether negotiation of the next cycle runs on the background thread
+  // while a separate execution thread performs the current cycle.
+  bool pipelined_negotiation = false;
+
+  // Thread performing collective operations when negotiation is pipelined.
+  std::thread execution_thread;
+
+  // Negotiated response lists waiting for the execution thread.
+  ResponseListQueue response_queue;
+
   // Whether collective context has been completed on the background thread.
   std::atomic_bool initialization_done{false};
 
+  // Set by horovod_reset() for the background thread to rebuild the
+  // communicators for a new membership at the next cycle, and cleared once it
+  // is done.
+  std::atomic_bool reset_requested{false};
+
+  // Whether the last reset succeeded. If not, the background thread shuts
+  // down.
+  std::atomic_bool reset_succeeded{false};
+
   std::shared_ptr<Controller> controller;
 
   TensorQueue tensor_queue;
 
-  // Pointer to shared buffer for allgather
+  // Pointer to shared buffer for allgather, when the shared memory arena is
+  // not enabled
   void* shared_buffer = nullptr;
 
   // Current shared buffer size
   int64_t shared_buffer_size = 0;
 
+  // POSIX shared memory of the ranks on the same node
+  SharedMemoryArena shared_memory;
+
   // LRU cache of Responses
   ResponseCache response_cache;
 
   // Number of responses that can be cached
   uint32_t cache_capacity = 1024;
 
-  // Number of CUDA streams to use
+  // Number of CUDA streams allocated, of which the parameter manager decides
+  // how many to use.
   int num_nccl_streams = 1;
 
-  // Index of current CUDA stream to use
-  int current_nccl_stream = 0;
+  // Index of current CUDA stream to use. Host collectives performed
+  // alongside GPU ones read it without using it.
+  std::atomic_int current_nccl_stream{0};
+
+  // Index of the CUDA stream reserved for urgent responses, or -1.
+  int urgent_nccl_stream = -1;
 
   // A LibType indicating what framework we are using to perform CPU operations.
   LibType cpu_operation;
 
+  // Type that float32 tensors are allreduced in by MPI and Gloo CPU
+  // operations: HOROVOD_FLOAT16 or HOROVOD_BFLOAT16 to halve the bytes sent,
+  // or HOROVOD_FLOAT32 for no compression.
+  DataType cpu_compression = HOROVOD_FLOAT32;
+
+  // Fraction of the elements of fused float32 CPU gradients that MPI and Gloo
+  // send in a top-k sparsified allreduce, or zero to allreduce them densely.
+  double sparse_allreduce_ratio = 0;
+
+  // Whether MPI allreduces host tensors in a fixed reduction tree, so that
+  // results are the same bits from run to run whatever the fusion layout.
+  bool deterministic_allreduce = false;
+
+  // Size of the chunks that MPI broadcasts of large host buffers are
+  // pipelined in across nodes, or zero to broadcast them in one call.
+  int64_t broadcast_chunk_bytes = 0;
+
   // A LibType indicating what framework we are using to perform controller
   // operations.
   LibType control_operation;
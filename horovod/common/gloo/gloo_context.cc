@@ -15,13 +15,30 @@
 
 #include "gloo_context.h"
 
+#include <algorithm>
+#include <chrono>
+#include <future>
 #include <memory>
+#include <sstream>
+
+#include <unistd.h>
+
+#include "gloo/allgather.h"
+#include "gloo/allreduce.h"
 
 #include "gloo/rendezvous/context.h"
 #include "gloo/rendezvous/file_store.h"
 #include "gloo/rendezvous/prefix_store.h"
 #include "gloo/transport/tcp/device.h"
 
+#if HAVE_GLOO_UV
+#include "gloo/transport/uv/device.h"
+#endif
+
+#if HAVE_GLOO_IBVERBS
+#include "gloo/transport/ibverbs/device.h"
+#endif
+
 #if HAVE_MPI
 #include "gloo/mpi/context.h"
 #endif
@@ -45,6 +62,7 @@ namespace common {
 #define HOROVOD_LOCAL_SIZE "HOROVOD_LOCAL_SIZE"
 #define HOROVOD_CROSS_RANK "HOROVOD_CROSS_RANK"
 #define HOROVOD_CROSS_SIZE "HOROVOD_CROSS_SIZE"
+#define HOROVOD_GLOO_RENDEZVOUS_GENERATION "HOROVOD_GLOO_RENDEZVOUS_GENERATION"
 
 std::shared_ptr<gloo::Context> Rendezvous(const std::string& prefix,
                                           const char* server_addr_env, int server_port,
@@ -65,6 +83,148 @@ std::shared_ptr<gloo::Context> Rendezvous(const std::string& prefix,
   return context;
 }
 
+namespace {
+
+// Scopes of the first generation keep their names, later ones are prefixed
+// with the generation.
+std::string GenerationPrefix() {
+  int generation = GetIntEnvOrDefault(HOROVOD_GLOO_RENDEZVOUS_GENERATION, 0);
+  return generation > 0 ? std::to_string(generation) + "_" : "";
+}
+
+// FNV-1a, which unlike std::hash is the same across hosts.
+uint64_t HashHostname(const char* hostname) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (const char* c = hostname; *c != '\0'; ++c) {
+    hash = (hash ^ (uint8_t)*c) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+// Bytes of the allreduce the throughput of each rail is measured with.
+#define RAIL_PROBE_BYTES (4 * 1024 * 1024)
+
+// Allreduce algorithms registered on the staging buffer of each ibverbs
+// context.
+#define VERBS_REGISTERED_ALGORITHMS 16
+
+// Transport of HOROVOD_GLOO_TRANSPORT, or tcp if Horovod was built without
+// the requested one.
+std::string ParseTransport() {
+  auto env_value = std::getenv(HOROVOD_GLOO_TRANSPORT);
+  std::string transport = env_value != nullptr ? env_value : "tcp";
+  std::transform(transport.begin(), transport.end(), transport.begin(),
+                 ::tolower);
+  bool available = transport == "tcp";
+#if HAVE_GLOO_UV
+  available = available || transport == "uv";
+#endif
+#if HAVE_GLOO_IBVERBS
+  available = available || transport == "ibverbs";
+#endif
+  if (!available) {
+    LOG(WARNING) << "Gloo transport " << transport
+                 << " is not available in this build, using tcp.";
+    return "tcp";
+  }
+  return transport;
+}
+
+std::shared_ptr<gloo::transport::Device>
+CreateDevice(const std::string& transport, const std::string& iface) {
+#if HAVE_GLOO_UV
+  if (transport == "uv") {
+    gloo::transport::uv::attr attr;
+    attr.iface = iface;
+    attr.ai_family = AF_UNSPEC;
+    return gloo::transport::uv::CreateDevice(attr);
+  }
+#endif
+  gloo::transport::tcp::attr attr;
+  attr.iface = iface;
+  attr.ai_family = AF_UNSPEC;
+  return gloo::transport::tcp::CreateDevice(attr);
+}
+
+// Creates a device on each of the comma-separated interfaces, or on the
+// default one if there are none. Contexts over ibverbs are twins of TCP
+// ones.
+std::vector<std::shared_ptr<gloo::transport::Device>>
+CreateDevices(const std::string& gloo_iface, const std::string& transport) {
+  std::vector<std::shared_ptr<gloo::transport::Device>> devs;
+  std::stringstream ifaces(gloo_iface);
+  std::string iface;
+  while (std::getline(ifaces, iface, ',')) {
+    if (iface.empty() && !devs.empty()) {
+      continue;
+    }
+    devs.push_back(CreateDevice(transport, iface));
+  }
+  if (devs.empty()) {
+    devs.push_back(CreateDevice(transport, gloo_iface));
+  }
+  return devs;
+}
+
+// The ibverbs device of HOROVOD_GLOO_IBV_DEVICE, the first one by default.
+std::shared_ptr<gloo::transport::Device> CreateVerbsDevice() {
+#if HAVE_GLOO_IBVERBS
+  gloo::transport::ibverbs::attr attr;
+  auto name = std::getenv(HOROVOD_GLOO_IBV_DEVICE);
+  attr.name = name != nullptr ? name : "";
+  attr.port = GetIntEnvOrDefault(HOROVOD_GLOO_IBV_PORT, 1);
+  attr.index = GetIntEnvOrDefault(HOROVOD_GLOO_IBV_INDEX, 0);
+  return gloo::transport::ibverbs::CreateDevice(attr);
+#else
+  return nullptr;
+#endif
+}
+
+// Reductions of the allreduces the rails are set up with.
+template <typename T>
+void MinReduce(void* c, const void* a, const void* b, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    ((T*)c)[i] = std::min(((const T*)a)[i], ((const T*)b)[i]);
+  }
+}
+
+template <typename T>
+void MaxReduce(void* c, const void* a, const void* b, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    ((T*)c)[i] = std::max(((const T*)a)[i], ((const T*)b)[i]);
+  }
+}
+
+template <typename T>
+void SumReduce(void* c, const void* a, const void* b, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    ((T*)c)[i] = ((const T*)a)[i] + ((const T*)b)[i];
+  }
+}
+
+template <typename T>
+void AllreduceValues(const std::shared_ptr<gloo::Context>& ctx,
+                     std::vector<T>& values,
+                     void (*reduce)(void*, const void*, const void*, size_t)) {
+  if (ctx->size == 1 || values.empty()) {
+    return;
+  }
+  gloo::AllreduceOptions opts(ctx);
+  opts.setOutput<T>(values.data(), values.size());
+  opts.setReduceFunction(gloo::AllreduceOptions::Func(reduce));
+  gloo::allreduce(opts);
+}
+
+// Number of rails that every rank has a device for.
+size_t AgreedRailCount(const std::shared_ptr<gloo::Context>& ctx,
+                       size_t num_rails) {
+  std::vector<int64_t> count = {(int64_t)num_rails};
+  AllreduceValues(ctx, count, &MinReduce<int64_t>);
+  return (size_t)count[0];
+}
+
+} // namespace
+
 #if HAVE_MPI
 void GlooContext::InitializeFromMPI(MPIContext& mpi_ctx,
                                     const std::string& gloo_iface) {
@@ -72,27 +232,39 @@ void GlooContext::InitializeFromMPI(MPIContext& mpi_ctx,
     return;
   }
 
-  // TODO(sihan): Add support for multiple interfaces:
-  //  https://github.com/facebookincubator/gloo/issues/190
-  gloo::transport::tcp::attr attr;
-  attr.iface = gloo_iface;
-  attr.ai_family = AF_UNSPEC;
-  auto dev = gloo::transport::tcp::CreateDevice(attr);
+  // Interfaces after the first carry rails of the global context.
+  transport = ParseTransport();
+  auto devs = CreateDevices(gloo_iface, transport);
+  auto dev = devs[0];
+  rail_devs_.assign(devs.begin() + 1, devs.end());
+
+  mpi_ctx_ = &mpi_ctx;
+  mpi_dev_ = dev;
 
   auto context =
       std::make_shared<gloo::mpi::Context>(mpi_ctx.GetMPICommunicator(GLOBAL));
   context->connectFullMesh(dev);
   ctx = context;
 
-  auto cross_context =
-      std::make_shared<gloo::mpi::Context>(mpi_ctx.GetMPICommunicator(CROSS));
-  cross_context->connectFullMesh(dev);
-  cross_ctx = cross_context;
+  if (transport == "ibverbs") {
+    verbs_dev_ = CreateVerbsDevice();
+    auto verbs_context = std::make_shared<gloo::mpi::Context>(
+        mpi_ctx.GetMPICommunicator(GLOBAL));
+    verbs_context->connectFullMesh(verbs_dev_);
+    verbs_ctx.context = verbs_context;
+  }
+
+  // The local and cross-node contexts are connected over the communicators
+  // of the same name on first use.
+  MPI_Comm_rank(mpi_ctx.GetMPICommunicator(LOCAL), &local_rank);
+  MPI_Comm_size(mpi_ctx.GetMPICommunicator(LOCAL), &local_size);
+  MPI_Comm_rank(mpi_ctx.GetMPICommunicator(CROSS), &cross_rank);
+  MPI_Comm_size(mpi_ctx.GetMPICommunicator(CROSS), &cross_size);
+  char hostname[256] = {0};
+  gethostname(hostname, sizeof(hostname) - 1);
+  host_hash = HashHostname(hostname);
 
-  auto local_context =
-      std::make_shared<gloo::mpi::Context>(mpi_ctx.GetMPICommunicator(LOCAL));
-  local_context->connectFullMesh(dev);
-  local_ctx = local_context;
+  ConnectRails(mpi_ctx);
 }
 #endif
 
@@ -101,21 +273,93 @@ void GlooContext::Initialize(const std::string& gloo_iface) {
     return;
   }
 
-  // Create a tcp device for communication
-  // TODO(sihan): Add support for multiple interfaces:
-  //  https://github.com/facebookincubator/gloo/issues/190
-  gloo::transport::tcp::attr attr;
-  attr.iface = gloo_iface;
+  // Create a device for communication over each interface. Interfaces
+  // after the first carry rails of the global context.
+  transport = ParseTransport();
+  auto devs = CreateDevices(gloo_iface, transport);
+  dev_ = devs[0];
+  rail_devs_.assign(devs.begin() + 1, devs.end());
+  if (transport == "ibverbs") {
+    verbs_dev_ = CreateVerbsDevice();
+  }
 
-  attr.ai_family = AF_UNSPEC;
-  auto dev = gloo::transport::tcp::CreateDevice(attr);
+  ReadTopology();
+  auto prefix = GenerationPrefix();
+  ConnectGlobal(prefix + HOROVOD_GLOO_GLOBAL_PREFIX);
+  ConnectRails(prefix);
+}
+
+void GlooContext::Reset(const std::string& gloo_iface) {
+  if (dev_ == nullptr) {
+    Initialize(gloo_iface);
+    return;
+  }
+
+  // Stores of all generations live on the same rendezvous server, so each
+  // generation has its own scopes.
+  auto prefix = GenerationPrefix();
+  ctx.reset();
+  cross_ctx.reset();
+  verbs_cross_ctx = GlooVerbsContext();
+  rail_ctxs.clear();
+  process_set_ctxs.clear();
+  ReadTopology();
+  ConnectGlobal(prefix + HOROVOD_GLOO_GLOBAL_PREFIX);
+  ConnectRails(prefix);
+
+  // Every rank tells on which host it is, which local context it had and
+  // whether its local rank and size are unchanged. A node keeps its local
+  // context if all ranks on it had the same one, in the same places.
+  bool unchanged = local_ctx != nullptr && local_ctx->rank == local_rank &&
+                   local_ctx->size == local_size;
+  std::vector<int64_t> member = {(int64_t)host_hash, local_generation_,
+                                 unchanged ? 1 : 0};
+  std::vector<int64_t> members(member.size() * ctx->size);
+  {
+    gloo::AllgatherOptions opts(ctx);
+    opts.setInput(member.data(), member.size());
+    opts.setOutput(members.data(), members.size());
+    gloo::allgather(opts);
+  }
+  bool keep_local = unchanged;
+  int ranks_on_host = 0;
+  for (int i = 0; i < ctx->size; ++i) {
+    const int64_t* other = &members[i * member.size()];
+    if (other[0] != member[0]) {
+      continue;
+    }
+    ++ranks_on_host;
+    keep_local = keep_local && other[1] == member[1] && other[2] == 1;
+  }
+  keep_local = keep_local && ranks_on_host == local_size;
+
+  if (!keep_local) {
+    local_ctx.reset();
+  }
+  LOG(DEBUG) << "Gloo contexts reset, local context "
+             << (keep_local ? "kept." : "rebuilt on first use.");
+}
+
+void GlooContext::ReadTopology() {
+  local_rank = GetIntEnvOrDefault(HOROVOD_LOCAL_RANK, 0);
+  local_size = GetIntEnvOrDefault(HOROVOD_LOCAL_SIZE, 1);
+  cross_rank = GetIntEnvOrDefault(HOROVOD_CROSS_RANK, 0);
+  cross_size = GetIntEnvOrDefault(HOROVOD_CROSS_SIZE, 1);
+  char hostname[256] = {0};
+  gethostname(hostname, sizeof(hostname) - 1);
+  host_hash = HashHostname(hostname);
+
+  // The scopes are fixed now, as the generation in the environment may move
+  // on before the contexts are first used.
+  auto prefix = GenerationPrefix();
+  local_prefix_ = prefix + HOROVOD_GLOO_LOCAL_PREFIX;
+  cross_prefix_ = prefix + HOROVOD_GLOO_CROSS_PREFIX;
+  generation_ = GetIntEnvOrDefault(HOROVOD_GLOO_RENDEZVOUS_GENERATION, 0);
+}
 
+void GlooContext::ConnectGlobal(const std::string& prefix) {
   int rank = GetIntEnvOrDefault(HOROVOD_RANK, 0);
   int size = GetIntEnvOrDefault(HOROVOD_SIZE, 1);
-  int local_rank = GetIntEnvOrDefault(HOROVOD_LOCAL_RANK, 0);
-  int local_size = GetIntEnvOrDefault(HOROVOD_LOCAL_SIZE, 1);
-  int cross_rank = GetIntEnvOrDefault(HOROVOD_CROSS_RANK, 0);
-  int cross_size = GetIntEnvOrDefault(HOROVOD_CROSS_SIZE, 1);
 
   auto rendezvous_addr_env = std::getenv(HOROVOD_GLOO_RENDEZVOUS_ADDR);
   auto rendezvous_port = GetIntEnvOrDefault(HOROVOD_GLOO_RENDEZVOUS_PORT, -1);
@@ -125,22 +369,161 @@ void GlooContext::Initialize(const std::string& gloo_iface) {
     LOG(DEBUG) << "no rendezvous server provided, assuming single process execution";
   }
 
-  ctx = Rendezvous(HOROVOD_GLOO_GLOBAL_PREFIX,
-                   rendezvous_addr_env, rendezvous_port,
-                   rank, size, dev);
+  // The ibverbs twin connects over its own device while ctx does.
+  std::future<std::shared_ptr<gloo::Context>> verbs_context;
+  if (verbs_dev_ != nullptr) {
+    verbs_context = std::async(std::launch::async, [&]() {
+      return Rendezvous("ibverbs_" + prefix, rendezvous_addr_env,
+                        rendezvous_port, rank, size, verbs_dev_);
+    });
+  }
+  ctx = Rendezvous(prefix, rendezvous_addr_env, rendezvous_port, rank, size,
+                   dev_);
+  if (verbs_context.valid()) {
+    verbs_ctx = GlooVerbsContext();
+    verbs_ctx.context = verbs_context.get();
+  }
   LOG(DEBUG) << "Global Gloo context initialized.";
+}
 
-  local_ctx = Rendezvous(HOROVOD_GLOO_LOCAL_PREFIX,
-                         rendezvous_addr_env, rendezvous_port,
-                         local_rank, local_size, dev);
+void GlooContext::ConnectLocal() {
+#if HAVE_MPI
+  if (mpi_ctx_ != nullptr) {
+    auto context = std::make_shared<gloo::mpi::Context>(
+        mpi_ctx_->GetMPICommunicator(LOCAL));
+    context->connectFullMesh(mpi_dev_);
+    local_ctx = context;
+    return;
+  }
+#endif
+  auto rendezvous_addr_env = std::getenv(HOROVOD_GLOO_RENDEZVOUS_ADDR);
+  auto rendezvous_port = GetIntEnvOrDefault(HOROVOD_GLOO_RENDEZVOUS_PORT, -1);
+  local_ctx = Rendezvous(local_prefix_, rendezvous_addr_env, rendezvous_port,
+                         local_rank, local_size, dev_);
+  local_generation_ = generation_;
   LOG(DEBUG) << "Local Gloo context initialized.";
+}
 
-  cross_ctx = Rendezvous(HOROVOD_GLOO_CROSS_PREFIX,
-                         rendezvous_addr_env, rendezvous_port,
-                         cross_rank, cross_size, dev);
+void GlooContext::ConnectCross() {
+#if HAVE_MPI
+  if (mpi_ctx_ != nullptr) {
+    auto context = std::make_shared<gloo::mpi::Context>(
+        mpi_ctx_->GetMPICommunicator(CROSS));
+    context->connectFullMesh(mpi_dev_);
+    cross_ctx = context;
+    if (verbs_dev_ != nullptr) {
+      auto verbs_context = std::make_shared<gloo::mpi::Context>(
+          mpi_ctx_->GetMPICommunicator(CROSS));
+      verbs_context->connectFullMesh(verbs_dev_);
+      verbs_cross_ctx = GlooVerbsContext();
+      verbs_cross_ctx.context = verbs_context;
+    }
+    return;
+  }
+#endif
+  auto rendezvous_addr_env = std::getenv(HOROVOD_GLOO_RENDEZVOUS_ADDR);
+  auto rendezvous_port = GetIntEnvOrDefault(HOROVOD_GLOO_RENDEZVOUS_PORT, -1);
+  std::future<std::shared_ptr<gloo::Context>> verbs_context;
+  if (verbs_dev_ != nullptr) {
+    verbs_context = std::async(std::launch::async, [&]() {
+      return Rendezvous("ibverbs_" + cross_prefix_, rendezvous_addr_env,
+                        rendezvous_port, cross_rank, cross_size, verbs_dev_);
+    });
+  }
+  cross_ctx = Rendezvous(cross_prefix_, rendezvous_addr_env, rendezvous_port,
+                         cross_rank, cross_size, dev_);
+  if (verbs_context.valid()) {
+    verbs_cross_ctx = GlooVerbsContext();
+    verbs_cross_ctx.context = verbs_context.get();
+  }
   LOG(DEBUG) << "Cross-node Gloo context initialized.";
 }
 
+void GlooContext::ConnectRails(const std::string& prefix) {
+  rail_ctxs.clear();
+  size_t num_rails = AgreedRailCount(ctx, rail_devs_.size());
+  if (num_rails == 0) {
+    return;
+  }
+
+  int rank = GetIntEnvOrDefault(HOROVOD_RANK, 0);
+  int size = GetIntEnvOrDefault(HOROVOD_SIZE, 1);
+  auto rendezvous_addr_env = std::getenv(HOROVOD_GLOO_RENDEZVOUS_ADDR);
+  auto rendezvous_port = GetIntEnvOrDefault(HOROVOD_GLOO_RENDEZVOUS_PORT, -1);
+  // Each rail has a device of its own, so they all connect at once.
+  std::vector<std::future<std::shared_ptr<gloo::Context>>> rails;
+  for (size_t i = 0; i < num_rails; ++i) {
+    rails.push_back(std::async(std::launch::async, [&, i]() {
+      return Rendezvous(prefix + "rail" + std::to_string(i + 1) + "_" +
+                            HOROVOD_GLOO_GLOBAL_PREFIX,
+                        rendezvous_addr_env, rendezvous_port, rank, size,
+                        rail_devs_[i]);
+    }));
+  }
+  for (auto& rail : rails) {
+    rail_ctxs.push_back(rail.get());
+  }
+  MeasureRails();
+}
+
+#if HAVE_MPI
+void GlooContext::ConnectRails(MPIContext& mpi_ctx) {
+  rail_ctxs.clear();
+  size_t num_rails = AgreedRailCount(ctx, rail_devs_.size());
+  for (size_t i = 0; i < num_rails; ++i) {
+    auto context = std::make_shared<gloo::mpi::Context>(
+        mpi_ctx.GetMPICommunicator(GLOBAL));
+    context->connectFullMesh(rail_devs_[i]);
+    rail_ctxs.push_back(context);
+  }
+  if (num_rails > 0) {
+    MeasureRails();
+  }
+}
+#endif
+
+void GlooContext::MeasureRails() {
+  stripe_threshold_bytes =
+      GetIntEnvOrDefault(HOROVOD_GLOO_STRIPE_THRESHOLD, 1024 * 1024);
+
+  // Every rank times the same allreduce over ctx and each rail, after one
+  // to warm up the connections, and takes the slowest rank's time, so that
+  // the weights are the same on all ranks.
+  std::vector<float> probe(RAIL_PROBE_BYTES / sizeof(float), 0.0f);
+  std::vector<double> seconds(rail_ctxs.size() + 1);
+  for (size_t i = 0; i < seconds.size(); ++i) {
+    auto& context = i == 0 ? ctx : rail_ctxs[i - 1];
+    AllreduceValues(context, probe, &SumReduce<float>);
+    auto start = std::chrono::steady_clock::now();
+    AllreduceValues(context, probe, &SumReduce<float>);
+    seconds[i] = std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - start).count();
+  }
+  AllreduceValues(ctx, seconds, &MaxReduce<double>);
+
+  rail_weights.resize(seconds.size());
+  for (size_t i = 0; i < seconds.size(); ++i) {
+    rail_weights[i] = RAIL_PROBE_BYTES / std::max(seconds[i], 1e-9);
+    LOG(DEBUG) << "Gloo rail " << i << " measured at "
+               << rail_weights[i] / 1e6 << " MB/s.";
+  }
+}
+
+std::vector<int64_t> GlooContext::StripeCounts(int64_t count) const {
+  std::vector<int64_t> counts(rail_weights.size(), 0);
+  double total = 0;
+  for (auto weight : rail_weights) {
+    total += weight;
+  }
+  int64_t assigned = 0;
+  for (size_t i = 1; i < counts.size(); ++i) {
+    counts[i] = (int64_t)(count * (rail_weights[i] / total));
+    assigned += counts[i];
+  }
+  counts[0] = count - assigned;
+  return counts;
+}
+
 void GlooContext::Finalize() {
   if (!enabled_) {
     return;
@@ -149,6 +532,82 @@ void GlooContext::Finalize() {
   ctx.reset();
   cross_ctx.reset();
   local_ctx.reset();
+  rail_ctxs.clear();
+  process_set_ctxs.clear();
+  stripe_buffers.clear();
+  verbs_ctx = GlooVerbsContext();
+  verbs_cross_ctx = GlooVerbsContext();
+}
+
+GlooVerbsContext*
+GlooContext::GetVerbsContext(const std::shared_ptr<gloo::Context>& context) {
+  if (context == nullptr) {
+    return nullptr;
+  }
+  if (context == ctx && verbs_ctx.context != nullptr) {
+    return &verbs_ctx;
+  }
+  if (context == cross_ctx && verbs_cross_ctx.context != nullptr) {
+    return &verbs_cross_ctx;
+  }
+  return nullptr;
+}
+
+gloo::Algorithm& GlooVerbsContext::Registered(
+    const Key& key, size_t bytes,
+    const std::function<std::unique_ptr<gloo::Algorithm>(void*)>& create) {
+  size_t words = (bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+  if (words > buffer.size()) {
+    // The algorithms hold registrations of the old buffer.
+    algorithms.clear();
+    buffer.resize(words);
+  }
+
+  for (auto it = algorithms.begin(); it != algorithms.end(); ++it) {
+    if (it->first == key) {
+      algorithms.splice(algorithms.begin(), algorithms, it);
+      return *algorithms.front().second;
+    }
+  }
+
+  if (algorithms.size() >= VERBS_REGISTERED_ALGORITHMS) {
+    algorithms.pop_back();
+  }
+  algorithms.emplace_front(key, create(data()));
+  return *algorithms.front().second;
+}
+
+std::shared_ptr<gloo::Context>
+GlooContext::GetProcessSetContext(const ProcessSet* process_set) {
+  if (process_set == nullptr) {
+    return ctx;
+  }
+  auto it = process_set_ctxs.find(process_set->id);
+  if (it != process_set_ctxs.end()) {
+    return it->second;
+  }
+
+  // Only the members connect, in the order the first responses of their sets
+  // are performed, which is the same on all members.
+  std::shared_ptr<gloo::Context> context;
+#if HAVE_MPI
+  if (mpi_ctx_ != nullptr) {
+    auto mpi_context = std::make_shared<gloo::mpi::Context>(
+        mpi_ctx_->GetProcessSetCommunicator(process_set));
+    mpi_context->connectFullMesh(mpi_dev_);
+    context = mpi_context;
+  }
+#endif
+  if (context == nullptr) {
+    auto rendezvous_addr_env = std::getenv(HOROVOD_GLOO_RENDEZVOUS_ADDR);
+    auto rendezvous_port = GetIntEnvOrDefault(HOROVOD_GLOO_RENDEZVOUS_PORT, -1);
+    context = Rendezvous(GenerationPrefix() + "process_set_" +
+                             std::to_string(process_set->id),
+                         rendezvous_addr_env, rendezvous_port,
+                         process_set->rank, process_set->Size(), dev_);
+  }
+  process_set_ctxs[process_set->id] = context;
+  return context;
 }
 
 std::shared_ptr<gloo::Context>
@@ -157,8 +616,14 @@ GlooContext::GetGlooContext(Communicator communicator) {
   case Communicator::GLOBAL:
     return ctx;
   case Communicator::LOCAL:
+    if (local_ctx == nullptr && ctx != nullptr) {
+      ConnectLocal();
+    }
     return local_ctx;
   case Communicator::CROSS:
+    if (cross_ctx == nullptr && ctx != nullptr) {
+      ConnectCross();
+    }
     return cross_ctx;
   default:
     throw std::logic_error("Unsupported communicator type.");
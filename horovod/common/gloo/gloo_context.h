@@ -16,10 +16,18 @@
 #ifndef HOROVOD_GLOO_CONTEXT_H
 #define HOROVOD_GLOO_CONTEXT_H
 
+#include <functional>
+#include <list>
+#include <map>
+#include <tuple>
+
+#include "gloo/algorithm.h"
 #include "gloo/context.h"
+#include "gloo/transport/device.h"
 
 #include "../common.h"
 #include "../logging.h"
+#include "../process_set.h"
 
 #if HAVE_MPI
 #include "../mpi/mpi_context.h"
@@ -28,6 +36,33 @@
 namespace horovod {
 namespace common {
 
+// Context over the ibverbs transport, which only supports algorithms whose
+// buffers are registered when they are created. Allreduces run in a staging
+// buffer that algorithms are registered on once for each size, type,
+// reduction and algorithm, and reused in later calls.
+struct GlooVerbsContext {
+  // Elements, type, reduction and whether the latency optimized algorithm
+  // is used.
+  typedef std::tuple<int64_t, size_t, int, bool> Key;
+
+  // Returns the algorithm registered for key, which create builds on the
+  // staging buffer of at least bytes on first use. The least recently used
+  // algorithms are dropped, and all of them when the buffer grows. All ranks
+  // of the context make the same calls, so they build algorithms together.
+  gloo::Algorithm&
+  Registered(const Key& key, size_t bytes,
+             const std::function<std::unique_ptr<gloo::Algorithm>(void*)>& create);
+
+  void* data() { return buffer.data(); }
+
+  std::shared_ptr<gloo::Context> context;
+
+  // Staging buffer, in 8-byte words so that any element type is aligned.
+  std::vector<uint64_t> buffer;
+
+  std::list<std::pair<Key, std::unique_ptr<gloo::Algorithm>>> algorithms;
+};
+
 struct GlooContext {
 
 #if HAVE_MPI
@@ -36,10 +71,25 @@ struct GlooContext {
 
   void Initialize(const std::string& gloo_iface);
 
+  // Rendezvouses again after a membership change, with the ranks and sizes
+  // and the rendezvous generation read from the environment anew. The global
+  // context is rebuilt and the cross-node one dropped. The local context is
+  // kept when the same ranks are still on this node at the same local ranks.
+  void Reset(const std::string& gloo_iface);
+
   void Finalize();
 
+  // Returns the context of the communicator. The local and cross-node
+  // contexts are connected on first use, which all of their members reach
+  // together, so that jobs without hierarchical collectives never pay for
+  // them.
   std::shared_ptr<gloo::Context> GetGlooContext(Communicator communicator);
 
+  // Context of the members of the process set, connected by them on first
+  // use, or the global context if process_set is null.
+  std::shared_ptr<gloo::Context>
+  GetProcessSetContext(const ProcessSet* process_set);
+
   void Enable() {
     enabled_ = true;
     LOG(DEBUG) << "Gloo context enabled.";
@@ -48,13 +98,96 @@ struct GlooContext {
   bool IsEnabled() { return enabled_; }
 
 
+  // Splits count elements of a striped collective between ctx and each rail
+  // in proportion to their weights. The same on all ranks.
+  std::vector<int64_t> StripeCounts(int64_t count) const;
+
+  // Returns the ibverbs twin that allreduces over the given global or
+  // cross-node context run on, or nullptr if there is none.
+  GlooVerbsContext* GetVerbsContext(const std::shared_ptr<gloo::Context>& context);
+
   std::shared_ptr<gloo::Context> ctx = nullptr; // Global context
+  // Null until first use, see GetGlooContext.
   std::shared_ptr<gloo::Context> cross_ctx = nullptr;
   std::shared_ptr<gloo::Context> local_ctx = nullptr;
 
+  // Place of this rank in the local and cross-node contexts, known before
+  // they are connected, and a hash of its host name.
+  int local_rank = 0;
+  int local_size = 1;
+  int cross_rank = 0;
+  int cross_size = 1;
+  uint64_t host_hash = 0;
+
+  // Contexts of the process sets this rank is a member of, by set id.
+  std::map<int32_t, std::shared_ptr<gloo::Context>> process_set_ctxs;
+
+  // Global contexts over the interfaces of HOROVOD_GLOO_IFACE after the
+  // first one. Allreduces and allgathers of at least stripe_threshold_bytes
+  // over ctx are striped across it and these rails.
+  std::vector<std::shared_ptr<gloo::Context>> rail_ctxs;
+  int64_t stripe_threshold_bytes = 1024 * 1024;
+
+  // Throughput measured on ctx and on each rail, in bytes per second.
+  std::vector<double> rail_weights;
+
+  // Scratch buffers of striped allgathers, one per rail and ctx.
+  std::vector<std::vector<uint8_t>> stripe_buffers;
+
+  // Transport of HOROVOD_GLOO_TRANSPORT: "tcp", "uv" or "ibverbs". With
+  // ibverbs, ctx, cross_ctx and local_ctx are TCP contexts that carry all
+  // collectives but the allreduces of their ibverbs twins.
+  std::string transport = "tcp";
+  GlooVerbsContext verbs_ctx;
+  GlooVerbsContext verbs_cross_ctx;
+
 private:
+  // Connects a global context over each rail device, as many as every rank
+  // has, and measures the throughput of ctx and the rails.
+  void ConnectRails(const std::string& prefix);
+#if HAVE_MPI
+  void ConnectRails(MPIContext& mpi_ctx);
+#endif
+  void MeasureRails();
+
+  // Reads the local and cross-node ranks and sizes from the environment.
+  void ReadTopology();
+
+  // Builds the global context of the given HTTP store scope, and its ibverbs
+  // twin at the same time.
+  void ConnectGlobal(const std::string& prefix);
+
+  void ConnectLocal();
+  void ConnectCross();
+
   // Flag indicating whether gloo is enabled.
   bool enabled_ = false;
+
+  // Transport device, kept across resets.
+  std::shared_ptr<gloo::transport::Device> dev_;
+
+  // Transport devices of the rails, kept across resets.
+  std::vector<std::shared_ptr<gloo::transport::Device>> rail_devs_;
+
+  // ibverbs device of the twins of ctx and cross_ctx, kept across resets.
+  std::shared_ptr<gloo::transport::Device> verbs_dev_;
+
+#if HAVE_MPI
+  // Context and device the contexts were connected over when initialized
+  // from MPI, which process set contexts are connected over too.
+  MPIContext* mpi_ctx_ = nullptr;
+  std::shared_ptr<gloo::transport::Device> mpi_dev_;
+#endif
+
+  // HTTP store scopes the local and cross-node contexts connect in, and the
+  // rendezvous generation they belong to.
+  std::string local_prefix_;
+  std::string cross_prefix_;
+  int64_t generation_ = 0;
+
+  // Rendezvous generation the local context was built in, -1 before there is
+  // one. Ranks that share a local context agree on it.
+  int64_t local_generation_ = -1;
 };
 
 } // namespace common
@@ -15,6 +15,7 @@
 
 #include "gloo_controller.h"
 
+#include <algorithm>
 #include <cstring>
 
 #include "gloo/allgather.h"
@@ -46,57 +47,65 @@ void GlooController::Initialize() {
     cross_rank_ = 0;
     local_size_ = 1;
     cross_size_ = 1;
+    cross_comm_ranks_ = {0};
+    local_ranks_ = {0};
     is_homogeneous_ = true;
     return;
   }
 
-  // Determine local rank by if local context is presented.
-  if (gloo_context_.local_ctx != nullptr) {
-    local_rank_ = gloo_context_.local_ctx->rank;
-    local_size_ = gloo_context_.local_ctx->size;
-    local_comm_ranks_ = std::vector<int>((size_t)local_size_);
-    local_comm_ranks_[local_rank_] = rank_;
-    {
-      gloo::AllgatherOptions opts(gloo_context_.local_ctx);
-      opts.setInput(&rank_, 1);
-      opts.setOutput(local_comm_ranks_.data(), local_size_);
-      gloo::allgather(opts);
-    }
-
-    // Determine if cluster is homogeneous, i.e., if every node has the same
-    // local_size
-    auto local_sizes = std::vector<int>(size_);
-    {
-      gloo::AllgatherOptions opts(gloo_context_.ctx);
-      opts.setInput(&local_size_, 1);
-      opts.setOutput(local_sizes.data(), size_);
-      gloo::allgather(opts);
+  // Every rank tells on which host it is and where it sits in the local and
+  // cross-node contexts, which one allgather over the global context finds
+  // the members of without connecting them.
+  local_rank_ = gloo_context_.local_rank;
+  local_size_ = gloo_context_.local_size;
+  cross_rank_ = gloo_context_.cross_rank;
+  cross_size_ = gloo_context_.cross_size;
+  std::vector<int64_t> member = {(int64_t)gloo_context_.host_hash, local_rank_,
+                                 local_size_, cross_rank_};
+  std::vector<int64_t> members(member.size() * size_);
+  {
+    gloo::AllgatherOptions opts(gloo_context_.ctx);
+    opts.setInput(member.data(), member.size());
+    opts.setOutput(members.data(), members.size());
+    gloo::allgather(opts);
+  }
+  local_comm_ranks_ = std::vector<int>((size_t)local_size_);
+  cross_comm_ranks_ = std::vector<int>((size_t)cross_size_);
+  local_ranks_ = std::vector<int>((size_t)size_);
+  auto local_sizes = std::vector<int>(size_);
+  for (int i = 0; i < size_; ++i) {
+    const int64_t* other = &members[i * member.size()];
+    local_ranks_[i] = (int)other[1];
+    local_sizes[i] = (int)other[2];
+    if (other[0] == member[0] && other[1] < local_size_) {
+      local_comm_ranks_[other[1]] = i;
     }
-    is_homogeneous_ = true;
-    for (int i = 0; i < size_; ++i) {
-      if (local_sizes[i] != local_size_) {
-        is_homogeneous_ = false;
-        break;
-      }
+    if (other[1] == local_rank_ && other[3] < cross_size_) {
+      cross_comm_ranks_[other[3]] = i;
     }
+  }
 
-    // Construct a shorter local sizes vector with length cross size.
-    // e.g. For local_sizes = {4, 4, 4, 4, 3, 3, 3},
-    //      we want to construct a local_sizes_for_cross_rank_ = {4, 3}
-    local_sizes_for_cross_rank_ = std::vector<int>(cross_size_);
-    int displacement = 0;
-    // For each cross rank iter, set corresponding local size and move
-    // displacement advance by the local size
-    for (int cross_rank = 0; cross_rank < cross_size_; ++cross_rank) {
-      local_sizes_for_cross_rank_[cross_rank] = local_sizes[displacement];
-      displacement += local_sizes[displacement];
+  // Determine if cluster is homogeneous, i.e., if every node has the same
+  // local_size
+  is_homogeneous_ = true;
+  min_local_size_ = local_size_;
+  for (int i = 0; i < size_; ++i) {
+    if (local_sizes[i] != local_size_) {
+      is_homogeneous_ = false;
     }
+    min_local_size_ = std::min(min_local_size_, local_sizes[i]);
   }
 
-  // Get cross-node rank and size in case of hierarchical allreduce.
-  if (gloo_context_.cross_ctx != nullptr) {
-    cross_rank_ = gloo_context_.cross_ctx->rank;
-    cross_size_ = gloo_context_.cross_ctx->size;
+  // Construct a shorter local sizes vector with length cross size.
+  // e.g. For local_sizes = {4, 4, 4, 4, 3, 3, 3},
+  //      we want to construct a local_sizes_for_cross_rank_ = {4, 3}
+  local_sizes_for_cross_rank_ = std::vector<int>(cross_size_);
+  int displacement = 0;
+  // For each cross rank iter, set corresponding local size and move
+  // displacement advance by the local size
+  for (int cross_rank = 0; cross_rank < cross_size_; ++cross_rank) {
+    local_sizes_for_cross_rank_[cross_rank] = local_sizes[displacement];
+    displacement += local_sizes[displacement];
   }
 
   LOG(DEBUG) << "Gloo controller initialized.";
@@ -124,6 +133,8 @@ int GlooController::GetTypeSize(DataType dtype) {
     return sizeof(double);
   case HOROVOD_BOOL:
     return sizeof(bool);
+  case HOROVOD_BFLOAT16:
+    return sizeof(uint16_t);
   default:
     throw std::logic_error("Type " + DataType_Name(dtype) +
                            " is not supported in Gloo mode.");
@@ -15,6 +15,8 @@
 
 #include "http_store.h"
 
+#include <algorithm>
+#include <cstdio>
 #include <cstring>
 #include <iostream>
 #include <istream>
@@ -36,8 +38,14 @@ void HTTPStore::set(const std::string& key, const std::vector<char>& data) {
 }
 
 std::vector<char> HTTPStore::get(const std::string& key) {
+  auto it = keys_.find(key);
+  if (it != keys_.end()) {
+    return it->second;
+  }
   std::vector<char> result;
-  HTTP_GET(key, result);
+  if (HTTP_GET(key, result)) {
+    keys_[key] = result;
+  }
   return result;
 }
 
@@ -45,26 +53,48 @@ void HTTPStore::wait(const std::vector<std::string>& keys,
                      const std::chrono::milliseconds& timeout) {
   const auto start = std::chrono::steady_clock::now();
 
-  while (!CheckKeys(keys)) {
-    const auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
+  // The server holds each request until the missing keys are set, so there
+  // is no need to sleep between requests.
+  std::vector<std::string> missing;
+  while (true) {
+    missing.clear();
+    for (const auto& key : keys) {
+      if (keys_.find(key) == keys_.end()) {
+        missing.push_back(key);
+      }
+    }
+    if (missing.empty()) {
+      return;
+    }
+
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
         std::chrono::steady_clock::now() - start);
-    if (timeout != gloo::kNoTimeout && elapsed > timeout) {
-      GLOO_THROW_IO_EXCEPTION(GLOO_ERROR_MSG("Wait timeout for key(s): ",
-                                             ::gloo::MakeString(keys)));
+    auto wait_time = std::chrono::milliseconds(MAX_WAIT_MILLSEC);
+    if (timeout != gloo::kNoTimeout) {
+      if (elapsed > timeout) {
+        GLOO_THROW_IO_EXCEPTION(GLOO_ERROR_MSG("Wait timeout for key(s): ",
+                                               ::gloo::MakeString(keys)));
+      }
+      wait_time = std::min(wait_time, timeout - elapsed);
     }
-    /* sleep override */
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    HTTP_GET_SCOPE(missing, wait_time);
   }
 }
 
 bool HTTPStore::CheckKeys(const std::vector<std::string>& keys) {
-  std::vector<char> result;
-  for (const auto& key : keys) {
-    if (!HTTP_GET(key, result)) {
-      return false;
+  auto all_known = [&]() {
+    for (const auto& key : keys) {
+      if (keys_.find(key) == keys_.end()) {
+        return false;
+      }
     }
+    return true;
+  };
+  if (all_known()) {
+    return true;
   }
-  return true;
+  HTTP_GET_SCOPE(keys, std::chrono::milliseconds(0));
+  return all_known();
 }
 
 // Perform http request to rendezvous server with retry logic
@@ -111,6 +141,45 @@ bool HTTPStore::HTTP_GET(const std::string& key, std::vector<char>& result) {
   return true;
 }
 
+void HTTPStore::HTTP_GET_SCOPE(const std::vector<std::string>& keys,
+                               const std::chrono::milliseconds& timeout) {
+  std::string url = url_prefix_ + "?keys=";
+  for (size_t i = 0; i < keys.size(); ++i) {
+    url += (i > 0 ? "," : "") + keys[i];
+  }
+  url += "&timeout=" + std::to_string(timeout.count());
+  LOG(TRACE) << "Send GET request to " << url;
+  http::Request request(url);
+
+  http::Response response = PerformHTTP(request, HTTP_GET_METHOD);
+  if (response.status != HTTP_OK) {
+    return;
+  }
+
+  // Each key and value is preceded by a line with their lengths.
+  const auto& body = response.body;
+  size_t pos = 0;
+  while (pos < body.size()) {
+    auto line_end = std::find(body.begin() + pos, body.end(), '\n');
+    if (line_end == body.end()) {
+      throw std::runtime_error("Malformed batched HTTP GET response.");
+    }
+    std::string line(body.begin() + pos, line_end);
+    size_t key_len, value_len;
+    if (std::sscanf(line.c_str(), "%zu %zu", &key_len, &value_len) != 2) {
+      throw std::runtime_error("Malformed batched HTTP GET response.");
+    }
+    pos = line_end - body.begin() + 1;
+    if (pos + key_len + value_len > body.size()) {
+      throw std::runtime_error("Malformed batched HTTP GET response.");
+    }
+    std::string key(body.begin() + pos, body.begin() + pos + key_len);
+    pos += key_len;
+    keys_[key].assign(body.begin() + pos, body.begin() + pos + value_len);
+    pos += value_len;
+  }
+}
+
 void HTTPStore::HTTP_PUT(const std::string& key,
                          const std::vector<char>& data) {
   std::string url = url_prefix_ + key;
@@ -16,6 +16,8 @@
 #ifndef HOROVOD_GLOO_HTTP_STORE_H
 #define HOROVOD_GLOO_HTTP_STORE_H
 
+#include <unordered_map>
+
 #include "HTTPRequest.hpp"
 
 #include "gloo_store.h"
@@ -30,6 +32,7 @@ namespace common {
 #define HTTP_DELETE_METHOD "DELETE"
 #define HTTP_OK 200
 #define HTTP_NOT_FOUND 404
+#define MAX_WAIT_MILLSEC 10000
 
 class HTTPStore : public GlooStore {
 public:
@@ -51,6 +54,8 @@ public:
   void wait(const std::vector<std::string>& keys,
             const std::chrono::milliseconds& timeout) override;
 
+  // Returns whether all keys are set, fetching the keys of the scope set so
+  // far if some are not known yet.
   bool CheckKeys(const std::vector<std::string>& keys);
 
   void Finalize() override;
@@ -74,8 +79,17 @@ protected:
   // this rank has finished.
   void HTTP_DELETE(const std::string& key);
 
+  // Batched HTTP GET: waits on the server up to timeout for the keys to be
+  // set, and adds all keys of the scope set so far to keys_.
+  void HTTP_GET_SCOPE(const std::vector<std::string>& keys,
+                      const std::chrono::milliseconds& timeout);
+
   std::string url_prefix_;
   int rank_;
+
+  // Keys received from the server. Rendezvous keys are set only once, so
+  // they are served from here without another request.
+  std::unordered_map<std::string, std::vector<char>> keys_;
 };
 
 } // namespace common
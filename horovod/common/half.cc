@@ -15,64 +15,556 @@
 
 #include "half.h"
 
+#include <algorithm>
+#include <stdexcept>
+
 #if __AVX__ && __F16C__
 #include <cpuid.h>
 #include <immintrin.h>
 #endif
 
+#if __aarch64__
+#include <arm_neon.h>
+#endif
+
 namespace horovod {
 namespace common {
 
+namespace {
+
+void Float16SumScalar(const uint16_t* a, const uint16_t* b, uint16_t* out,
+                      int64_t n) {
+  for (int64_t i = 0; i < n; ++i) {
+    unsigned short a_bits = a[i];
+    unsigned short b_bits = b[i];
+    float a_float;
+    float b_float;
+    HalfBits2Float(&a_bits, &a_float);
+    HalfBits2Float(&b_bits, &b_float);
+    float sum = a_float + b_float;
+    Float2HalfBits(&sum, out + i);
+  }
+}
+
+void BFloat16SumScalar(const uint16_t* a, const uint16_t* b, uint16_t* out,
+                       int64_t n) {
+  for (int64_t i = 0; i < n; ++i) {
+    unsigned short a_bits = a[i];
+    unsigned short b_bits = b[i];
+    float a_float;
+    float b_float;
+    BFloat16Bits2Float(&a_bits, &a_float);
+    BFloat16Bits2Float(&b_bits, &b_float);
+    float sum = a_float + b_float;
+    Float2BFloat16Bits(&sum, out + i);
+  }
+}
+
+void FloatToFloat16Scalar(const float* src, uint16_t* dst, int64_t n) {
+  for (int64_t i = 0; i < n; ++i) {
+    float value = src[i];
+    Float2HalfBits(&value, dst + i);
+  }
+}
+
+void Float16ToFloatScalar(const uint16_t* src, float* dst, int64_t n) {
+  for (int64_t i = 0; i < n; ++i) {
+    unsigned short bits = src[i];
+    HalfBits2Float(&bits, dst + i);
+  }
+}
+
+void FloatToBFloat16Scalar(const float* src, uint16_t* dst, int64_t n) {
+  for (int64_t i = 0; i < n; ++i) {
+    float value = src[i];
+    Float2BFloat16Bits(&value, dst + i);
+  }
+}
+
+void BFloat16ToFloatScalar(const uint16_t* src, float* dst, int64_t n) {
+  for (int64_t i = 0; i < n; ++i) {
+    unsigned short bits = src[i];
+    BFloat16Bits2Float(&bits, dst + i);
+  }
+}
+
 #if __AVX__ && __F16C__
-// Query CPUID to determine AVX and F16C runtime support.
+// Query CPUID and XCR0 to determine runtime support of the instruction sets,
+// and whether the OS saves their registers.
+uint64_t ReadXCR0() {
+  uint32_t eax, edx;
+  __asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return (uint64_t(edx) << 32) | eax;
+}
+
 bool is_avx_and_f16c() {
-  static bool initialized = false;
-  static bool result = false;
-  if (!initialized) {
-    unsigned int eax, ebx, ecx, edx;
-    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
-      result = (ecx & bit_AVX) && (ecx & bit_F16C);
-    }
-    initialized = true;
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+  return (ecx & bit_AVX) && (ecx & bit_F16C) && (ecx & bit_OSXSAVE) &&
+         (ReadXCR0() & 0x6) == 0x6;
+}
+
+bool is_avx2() {
+  unsigned int eax, ebx, ecx, edx;
+  if (!is_avx_and_f16c() || !__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+  return ebx & bit_AVX2;
+}
+
+bool is_avx512f() {
+  unsigned int eax, ebx, ecx, edx;
+  if (!is_avx_and_f16c() || !__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+  // XMM, YMM, opmask and ZMM state.
+  return (ebx & bit_AVX512F) && (ReadXCR0() & 0xe6) == 0xe6;
+}
+
+inline __m256 LoadFloat16AVX(const uint16_t* p) {
+  return _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)p));
+}
+
+inline void StoreFloat16AVX(uint16_t* p, __m256 v) {
+  _mm_storeu_si128((__m128i*)p, _mm256_cvtps_ph(v, 0));
+}
+
+// bfloat16 is converted with integer shifts, and rounded to nearest even by
+// adding 0x7fff plus the lowest kept bit before truncating, as in
+// Float2BFloat16Bits.
+__attribute__((target("avx2")))
+inline __m256 LoadBFloat16AVX2(const uint16_t* p) {
+  return _mm256_castsi256_ps(_mm256_slli_epi32(
+      _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)p)), 16));
+}
+
+__attribute__((target("avx2")))
+inline void StoreBFloat16AVX2(uint16_t* p, __m256 v) {
+  __m256i bits = _mm256_castps_si256(v);
+  __m256i lsb =
+      _mm256_and_si256(_mm256_srli_epi32(bits, 16), _mm256_set1_epi32(1));
+  __m256i rounded = _mm256_add_epi32(
+      bits, _mm256_add_epi32(lsb, _mm256_set1_epi32(0x7fff)));
+  __m256 nan = _mm256_cmp_ps(v, v, _CMP_UNORD_Q);
+  __m256i quiet = _mm256_or_si256(bits, _mm256_set1_epi32(0x400000));
+  rounded = _mm256_castps_si256(_mm256_blendv_ps(
+      _mm256_castsi256_ps(rounded), _mm256_castsi256_ps(quiet), nan));
+  __m256i shifted = _mm256_srli_epi32(rounded, 16);
+
+  // Values fit in 16 bits, so packing does not saturate.
+  _mm_storeu_si128((__m128i*)p,
+                   _mm_packus_epi32(_mm256_castsi256_si128(shifted),
+                                    _mm256_extracti128_si256(shifted, 1)));
+}
+
+__attribute__((target("avx512f")))
+inline __m512 LoadFloat16AVX512(const uint16_t* p) {
+  return _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i*)p));
+}
+
+__attribute__((target("avx512f")))
+inline void StoreFloat16AVX512(uint16_t* p, __m512 v) {
+  _mm256_storeu_si256((__m256i*)p, _mm512_cvtps_ph(v, 0));
+}
+
+__attribute__((target("avx512f")))
+inline __m512 LoadBFloat16AVX512(const uint16_t* p) {
+  return _mm512_castsi512_ps(_mm512_slli_epi32(
+      _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i*)p)), 16));
+}
+
+__attribute__((target("avx512f")))
+inline void StoreBFloat16AVX512(uint16_t* p, __m512 v) {
+  __m512i bits = _mm512_castps_si512(v);
+  __m512i lsb =
+      _mm512_and_si512(_mm512_srli_epi32(bits, 16), _mm512_set1_epi32(1));
+  __m512i rounded = _mm512_add_epi32(
+      bits, _mm512_add_epi32(lsb, _mm512_set1_epi32(0x7fff)));
+  __mmask16 nan = _mm512_cmp_ps_mask(v, v, _CMP_UNORD_Q);
+  rounded = _mm512_mask_blend_epi32(
+      nan, rounded, _mm512_or_si512(bits, _mm512_set1_epi32(0x400000)));
+  _mm256_storeu_si256((__m256i*)p,
+                      _mm512_cvtepi32_epi16(_mm512_srli_epi32(rounded, 16)));
+}
+
+void Float16SumAVX(const uint16_t* a, const uint16_t* b, uint16_t* out,
+                   int64_t n) {
+  int64_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    StoreFloat16AVX(out + i,
+                    _mm256_add_ps(LoadFloat16AVX(a + i), LoadFloat16AVX(b + i)));
+  }
+  Float16SumScalar(a + i, b + i, out + i, n - i);
+}
+
+void FloatToFloat16AVX(const float* src, uint16_t* dst, int64_t n) {
+  int64_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    StoreFloat16AVX(dst + i, _mm256_loadu_ps(src + i));
+  }
+  FloatToFloat16Scalar(src + i, dst + i, n - i);
+}
+
+void Float16ToFloatAVX(const uint16_t* src, float* dst, int64_t n) {
+  int64_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(dst + i, LoadFloat16AVX(src + i));
+  }
+  Float16ToFloatScalar(src + i, dst + i, n - i);
+}
+
+__attribute__((target("avx2")))
+void BFloat16SumAVX2(const uint16_t* a, const uint16_t* b, uint16_t* out,
+                     int64_t n) {
+  int64_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    StoreBFloat16AVX2(out + i, _mm256_add_ps(LoadBFloat16AVX2(a + i),
+                                             LoadBFloat16AVX2(b + i)));
+  }
+  BFloat16SumScalar(a + i, b + i, out + i, n - i);
+}
+
+__attribute__((target("avx2")))
+void FloatToBFloat16AVX2(const float* src, uint16_t* dst, int64_t n) {
+  int64_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    StoreBFloat16AVX2(dst + i, _mm256_loadu_ps(src + i));
+  }
+  FloatToBFloat16Scalar(src + i, dst + i, n - i);
+}
+
+__attribute__((target("avx2")))
+void BFloat16ToFloatAVX2(const uint16_t* src, float* dst, int64_t n) {
+  int64_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(dst + i, LoadBFloat16AVX2(src + i));
+  }
+  BFloat16ToFloatScalar(src + i, dst + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+void Float16SumAVX512(const uint16_t* a, const uint16_t* b, uint16_t* out,
+                      int64_t n) {
+  int64_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    StoreFloat16AVX512(out + i, _mm512_add_ps(LoadFloat16AVX512(a + i),
+                                              LoadFloat16AVX512(b + i)));
+  }
+  Float16SumAVX(a + i, b + i, out + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+void FloatToFloat16AVX512(const float* src, uint16_t* dst, int64_t n) {
+  int64_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    StoreFloat16AVX512(dst + i, _mm512_loadu_ps(src + i));
+  }
+  FloatToFloat16AVX(src + i, dst + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+void Float16ToFloatAVX512(const uint16_t* src, float* dst, int64_t n) {
+  int64_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    _mm512_storeu_ps(dst + i, LoadFloat16AVX512(src + i));
+  }
+  Float16ToFloatAVX(src + i, dst + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+void BFloat16SumAVX512(const uint16_t* a, const uint16_t* b, uint16_t* out,
+                       int64_t n) {
+  int64_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    StoreBFloat16AVX512(out + i, _mm512_add_ps(LoadBFloat16AVX512(a + i),
+                                               LoadBFloat16AVX512(b + i)));
+  }
+  BFloat16SumScalar(a + i, b + i, out + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+void FloatToBFloat16AVX512(const float* src, uint16_t* dst, int64_t n) {
+  int64_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    StoreBFloat16AVX512(dst + i, _mm512_loadu_ps(src + i));
   }
-  return result;
+  FloatToBFloat16Scalar(src + i, dst + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+void BFloat16ToFloatAVX512(const uint16_t* src, float* dst, int64_t n) {
+  int64_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    _mm512_storeu_ps(dst + i, LoadBFloat16AVX512(src + i));
+  }
+  BFloat16ToFloatScalar(src + i, dst + i, n - i);
 }
 #endif
 
-// float16 custom data type summation operation.
-void float16_sum(void* invec, void* inoutvec, int* len,
-                 MPI_Datatype* datatype) {
-  // cast invec and inoutvec to your float16 type
-  auto* in = (unsigned short*)invec;
-  auto* inout = (unsigned short*)inoutvec;
+#if __aarch64__
+inline float32x4_t LoadFloat16NEON(const uint16_t* p) {
+  return vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(p)));
+}
+
+inline void StoreFloat16NEON(uint16_t* p, float32x4_t v) {
+  vst1_u16(p, vreinterpret_u16_f16(vcvt_f16_f32(v)));
+}
+
+inline float32x4_t LoadBFloat16NEON(const uint16_t* p) {
+  return vreinterpretq_f32_u32(vshll_n_u16(vld1_u16(p), 16));
+}
 
-  int i = 0;
+inline void StoreBFloat16NEON(uint16_t* p, float32x4_t v) {
+  uint32x4_t bits = vreinterpretq_u32_f32(v);
+  uint32x4_t lsb = vandq_u32(vshrq_n_u32(bits, 16), vdupq_n_u32(1));
+  uint32x4_t rounded = vaddq_u32(bits, vaddq_u32(lsb, vdupq_n_u32(0x7fff)));
+  uint32x4_t is_number = vceqq_f32(v, v);
+  rounded =
+      vbslq_u32(is_number, rounded, vorrq_u32(bits, vdupq_n_u32(0x400000)));
+  vst1_u16(p, vshrn_n_u32(rounded, 16));
+}
+
+void Float16SumNEON(const uint16_t* a, const uint16_t* b, uint16_t* out,
+                    int64_t n) {
+  int64_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    StoreFloat16NEON(out + i,
+                     vaddq_f32(LoadFloat16NEON(a + i), LoadFloat16NEON(b + i)));
+  }
+  Float16SumScalar(a + i, b + i, out + i, n - i);
+}
+
+void FloatToFloat16NEON(const float* src, uint16_t* dst, int64_t n) {
+  int64_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    StoreFloat16NEON(dst + i, vld1q_f32(src + i));
+  }
+  FloatToFloat16Scalar(src + i, dst + i, n - i);
+}
+
+void Float16ToFloatNEON(const uint16_t* src, float* dst, int64_t n) {
+  int64_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    vst1q_f32(dst + i, LoadFloat16NEON(src + i));
+  }
+  Float16ToFloatScalar(src + i, dst + i, n - i);
+}
+
+void BFloat16SumNEON(const uint16_t* a, const uint16_t* b, uint16_t* out,
+                     int64_t n) {
+  int64_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    StoreBFloat16NEON(
+        out + i, vaddq_f32(LoadBFloat16NEON(a + i), LoadBFloat16NEON(b + i)));
+  }
+  BFloat16SumScalar(a + i, b + i, out + i, n - i);
+}
+
+void FloatToBFloat16NEON(const float* src, uint16_t* dst, int64_t n) {
+  int64_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    StoreBFloat16NEON(dst + i, vld1q_f32(src + i));
+  }
+  FloatToBFloat16Scalar(src + i, dst + i, n - i);
+}
+
+void BFloat16ToFloatNEON(const uint16_t* src, float* dst, int64_t n) {
+  int64_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    vst1q_f32(dst + i, LoadBFloat16NEON(src + i));
+  }
+  BFloat16ToFloatScalar(src + i, dst + i, n - i);
+}
+#endif
+
+struct HalfKernels {
+  void (*float16_sum)(const uint16_t*, const uint16_t*, uint16_t*, int64_t);
+  void (*bfloat16_sum)(const uint16_t*, const uint16_t*, uint16_t*, int64_t);
+  void (*float_to_float16)(const float*, uint16_t*, int64_t);
+  void (*float16_to_float)(const uint16_t*, float*, int64_t);
+  void (*float_to_bfloat16)(const float*, uint16_t*, int64_t);
+  void (*bfloat16_to_float)(const uint16_t*, float*, int64_t);
+};
+
+HalfKernels SelectKernels() {
+  HalfKernels k = {&Float16SumScalar,      &BFloat16SumScalar,
+                   &FloatToFloat16Scalar,  &Float16ToFloatScalar,
+                   &FloatToBFloat16Scalar, &BFloat16ToFloatScalar};
 #if __AVX__ && __F16C__
-  if (is_avx_and_f16c()) {
-    for (; i < (*len / 8) * 8; i += 8) {
-      // convert in & inout to m256
-      __m256 in_m256 = _mm256_cvtph_ps(_mm_loadu_si128((__m128i*)(in + i)));
-      __m256 inout_m256 =
-          _mm256_cvtph_ps(_mm_loadu_si128((__m128i*)(inout + i)));
-
-      // add them together to new_inout_m256
-      __m256 new_inout_m256 = _mm256_add_ps(in_m256, inout_m256);
-
-      // convert back and store in inout
-      __m128i new_inout_m128i = _mm256_cvtps_ph(new_inout_m256, 0);
-      _mm_storeu_si128((__m128i*)(inout + i), new_inout_m128i);
+  if (is_avx512f()) {
+    k = {&Float16SumAVX512,      &BFloat16SumAVX512,
+         &FloatToFloat16AVX512,  &Float16ToFloatAVX512,
+         &FloatToBFloat16AVX512, &BFloat16ToFloatAVX512};
+  } else {
+    if (is_avx_and_f16c()) {
+      k.float16_sum = &Float16SumAVX;
+      k.float_to_float16 = &FloatToFloat16AVX;
+      k.float16_to_float = &Float16ToFloatAVX;
+    }
+    if (is_avx2()) {
+      k.bfloat16_sum = &BFloat16SumAVX2;
+      k.float_to_bfloat16 = &FloatToBFloat16AVX2;
+      k.bfloat16_to_float = &BFloat16ToFloatAVX2;
     }
   }
 #endif
-  for (; i < *len; ++i) {
-    float in_float;
-    float inout_float;
-    HalfBits2Float(in + i, &in_float);
-    HalfBits2Float(inout + i, &inout_float);
-    inout_float += in_float;
-    Float2HalfBits(&inout_float, inout + i);
+#if __aarch64__
+  k = {&Float16SumNEON,      &BFloat16SumNEON,
+       &FloatToFloat16NEON,  &Float16ToFloatNEON,
+       &FloatToBFloat16NEON, &BFloat16ToFloatNEON};
+#endif
+  return k;
+}
+
+const HalfKernels& Kernels() {
+  static const HalfKernels kernels = SelectKernels();
+  return kernels;
+}
+
+// Applies reduce_op in float to blocks of n values converted with to_float
+// and from_float.
+void HalfReduce(ReduceOp reduce_op, const uint16_t* a, const uint16_t* b,
+                uint16_t* out, int64_t n,
+                void (*to_float)(const uint16_t*, float*, int64_t),
+                void (*from_float)(const float*, uint16_t*, int64_t)) {
+  const int64_t block = 256;
+  float a_float[block];
+  float b_float[block];
+  for (int64_t i = 0; i < n; i += block) {
+    int64_t count = std::min(block, n - i);
+    to_float(a + i, a_float, count);
+    to_float(b + i, b_float, count);
+    switch (reduce_op) {
+    case ReduceOp::SUM:
+      for (int64_t j = 0; j < count; ++j) {
+        a_float[j] += b_float[j];
+      }
+      break;
+    case ReduceOp::MIN:
+      for (int64_t j = 0; j < count; ++j) {
+        a_float[j] = std::min(a_float[j], b_float[j]);
+      }
+      break;
+    case ReduceOp::MAX:
+      for (int64_t j = 0; j < count; ++j) {
+        a_float[j] = std::max(a_float[j], b_float[j]);
+      }
+      break;
+    case ReduceOp::PRODUCT:
+      for (int64_t j = 0; j < count; ++j) {
+        a_float[j] *= b_float[j];
+      }
+      break;
+    default:
+      throw std::logic_error("Reduction " + ReduceOp_Name(reduce_op) +
+                             " is not elementwise.");
+    }
+    from_float(a_float, out + i, count);
   }
 }
 
+} // namespace
+
+void Float16Sum(const uint16_t* a, const uint16_t* b, uint16_t* out,
+                int64_t n) {
+  Kernels().float16_sum(a, b, out, n);
+}
+
+void BFloat16Sum(const uint16_t* a, const uint16_t* b, uint16_t* out,
+                 int64_t n) {
+  Kernels().bfloat16_sum(a, b, out, n);
+}
+
+void FloatToFloat16(const float* src, uint16_t* dst, int64_t n) {
+  Kernels().float_to_float16(src, dst, n);
+}
+
+void Float16ToFloat(const uint16_t* src, float* dst, int64_t n) {
+  Kernels().float16_to_float(src, dst, n);
+}
+
+void FloatToBFloat16(const float* src, uint16_t* dst, int64_t n) {
+  Kernels().float_to_bfloat16(src, dst, n);
+}
+
+void BFloat16ToFloat(const uint16_t* src, float* dst, int64_t n) {
+  Kernels().bfloat16_to_float(src, dst, n);
+}
+
+void Float16Reduce(ReduceOp reduce_op, const uint16_t* a, const uint16_t* b,
+                   uint16_t* out, int64_t n) {
+  if (reduce_op == ReduceOp::SUM) {
+    Float16Sum(a, b, out, n);
+    return;
+  }
+  HalfReduce(reduce_op, a, b, out, n, Kernels().float16_to_float,
+             Kernels().float_to_float16);
+}
+
+void BFloat16Reduce(ReduceOp reduce_op, const uint16_t* a, const uint16_t* b,
+                    uint16_t* out, int64_t n) {
+  if (reduce_op == ReduceOp::SUM) {
+    BFloat16Sum(a, b, out, n);
+    return;
+  }
+  HalfReduce(reduce_op, a, b, out, n, Kernels().bfloat16_to_float,
+             Kernels().float_to_bfloat16);
+}
+
+#if HAVE_MPI
+// float16 custom data type summation operation.
+void float16_sum(void* invec, void* inoutvec, int* len,
+                 MPI_Datatype* datatype) {
+  Float16Sum((const uint16_t*)invec, (const uint16_t*)inoutvec,
+             (uint16_t*)inoutvec, *len);
+}
+
+// bfloat16 custom data type summation operation.
+void bfloat16_sum(void* invec, void* inoutvec, int* len,
+                  MPI_Datatype* datatype) {
+  BFloat16Sum((const uint16_t*)invec, (const uint16_t*)inoutvec,
+              (uint16_t*)inoutvec, *len);
+}
+
+// float16 and bfloat16 custom data type min, max and product operations.
+void float16_min(void* invec, void* inoutvec, int* len,
+                 MPI_Datatype* datatype) {
+  Float16Reduce(ReduceOp::MIN, (const uint16_t*)invec,
+                (const uint16_t*)inoutvec, (uint16_t*)inoutvec, *len);
+}
+
+void bfloat16_min(void* invec, void* inoutvec, int* len,
+                  MPI_Datatype* datatype) {
+  BFloat16Reduce(ReduceOp::MIN, (const uint16_t*)invec,
+                 (const uint16_t*)inoutvec, (uint16_t*)inoutvec, *len);
+}
+
+void float16_max(void* invec, void* inoutvec, int* len,
+                 MPI_Datatype* datatype) {
+  Float16Reduce(ReduceOp::MAX, (const uint16_t*)invec,
+                (const uint16_t*)inoutvec, (uint16_t*)inoutvec, *len);
+}
+
+void bfloat16_max(void* invec, void* inoutvec, int* len,
+                  MPI_Datatype* datatype) {
+  BFloat16Reduce(ReduceOp::MAX, (const uint16_t*)invec,
+                 (const uint16_t*)inoutvec, (uint16_t*)inoutvec, *len);
+}
+
+void float16_prod(void* invec, void* inoutvec, int* len,
+                  MPI_Datatype* datatype) {
+  Float16Reduce(ReduceOp::PRODUCT, (const uint16_t*)invec,
+                (const uint16_t*)inoutvec, (uint16_t*)inoutvec, *len);
+}
+
+void bfloat16_prod(void* invec, void* inoutvec, int* len,
+                   MPI_Datatype* datatype) {
+  BFloat16Reduce(ReduceOp::PRODUCT, (const uint16_t*)invec,
+                 (const uint16_t*)inoutvec, (uint16_t*)inoutvec, *len);
+}
+#endif
+
 } // namespace common
 } // namespace horovod
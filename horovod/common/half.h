@@ -27,9 +27,14 @@
 #define HOROVOD_HALF_H
 
 #include <stdint.h>
+#include <cstring>
 
+#include "message.h"
+
+#if HAVE_MPI
 #define OMPI_SKIP_MPICXX
 #include "mpi.h"
+#endif
 
 namespace horovod {
 namespace common {
@@ -132,7 +137,56 @@ inline void Float2HalfBits(float* src, unsigned short* dest) {
   *dest = u;
 }
 
+inline void BFloat16Bits2Float(unsigned short* src, float* res) {
+  // bfloat16 is the upper half of a float
+  uint32_t f = uint32_t(*src) << 16;
+  std::memcpy(res, &f, sizeof(f));
+}
+
+inline void Float2BFloat16Bits(float* src, unsigned short* dest) {
+  uint32_t s;
+  std::memcpy(&s, src, sizeof(s));
+  if ((s & 0x7fffffff) > 0x7f800000) {
+    // not a number, keep it quiet so that rounding cannot turn it into inf
+    *dest = uint16_t((s >> 16) | 0x40);
+    return;
+  }
+
+  // round to nearest even
+  *dest = uint16_t((s + 0x7fff + ((s >> 16) & 1)) >> 16);
+}
+
+// Element-wise out = a + b of n float16 or bfloat16 values, accumulated in
+// float. out may alias a or b. The fastest kernel supported by the CPU is
+// chosen on first use: AVX-512, AVX-F16C (float16) or AVX2 (bfloat16) on
+// x86, NEON on aarch64, or a scalar loop.
+void Float16Sum(const uint16_t* a, const uint16_t* b, uint16_t* out, int64_t n);
+void BFloat16Sum(const uint16_t* a, const uint16_t* b, uint16_t* out, int64_t n);
+
+// Convert n floats to float16 or bfloat16 (rounded to nearest even) and back,
+// with the same kernel selection as above.
+void FloatToFloat16(const float* src, uint16_t* dst, int64_t n);
+void Float16ToFloat(const uint16_t* src, float* dst, int64_t n);
+void FloatToBFloat16(const float* src, uint16_t* dst, int64_t n);
+void BFloat16ToFloat(const uint16_t* src, float* dst, int64_t n);
+
+// Element-wise out = a op b of n float16 or bfloat16 values for any
+// elementwise reduce_op, computed in float. out may alias a or b.
+void Float16Reduce(ReduceOp reduce_op, const uint16_t* a, const uint16_t* b,
+                   uint16_t* out, int64_t n);
+void BFloat16Reduce(ReduceOp reduce_op, const uint16_t* a, const uint16_t* b,
+                    uint16_t* out, int64_t n);
+
+#if HAVE_MPI
 void float16_sum(void* invec, void* inoutvec, int* len, MPI_Datatype* datatype);
+void bfloat16_sum(void* invec, void* inoutvec, int* len, MPI_Datatype* datatype);
+void float16_min(void* invec, void* inoutvec, int* len, MPI_Datatype* datatype);
+void bfloat16_min(void* invec, void* inoutvec, int* len, MPI_Datatype* datatype);
+void float16_max(void* invec, void* inoutvec, int* len, MPI_Datatype* datatype);
+void bfloat16_max(void* invec, void* inoutvec, int* len, MPI_Datatype* datatype);
+void float16_prod(void* invec, void* inoutvec, int* len, MPI_Datatype* datatype);
+void bfloat16_prod(void* invec, void* inoutvec, int* len, MPI_Datatype* datatype);
+#endif
 
 } // namespace common
 } // namespace horovod
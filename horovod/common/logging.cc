@@ -2,23 +2,37 @@
 
 #include <chrono>
 #include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
 #include <iostream>
 #include <iomanip>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 namespace horovod {
 namespace common {
 
-LogMessage::LogMessage(const char* fname, int line, LogLevel severity)
-    : fname_(fname), line_(line), severity_(severity) {}
+namespace {
 
-void LogMessage::GenerateLogMessage(bool log_time) {
-  bool use_cout = static_cast<int>(severity_) <= static_cast<int>(LogLevel::INFO);
+// Messages queued for the writer thread at most, when logging asynchronously.
+const size_t ASYNC_LOG_CAPACITY = 4096;
+
+struct LogRecord {
+  LogLevel severity;
+  std::chrono::system_clock::time_point time;
+  const char* fname;
+  int line;
+  std::string message;
+};
+
+void WriteLogRecord(const LogRecord& record, bool log_time) {
+  bool use_cout = static_cast<int>(record.severity) <= static_cast<int>(LogLevel::INFO);
   std::ostream& os = use_cout ? std::cout : std::cerr;
   if (log_time) {
-    auto now = std::chrono::system_clock::now();
-    auto as_time_t = std::chrono::system_clock::to_time_t(now);
+    auto as_time_t = std::chrono::system_clock::to_time_t(record.time);
 
-    auto duration = now.time_since_epoch();
+    auto duration = record.time.time_since_epoch();
     auto seconds = std::chrono::duration_cast<std::chrono::seconds>(duration);
     auto micros_remainder = std::chrono::duration_cast<std::chrono::microseconds>(duration - seconds);
 
@@ -26,19 +40,167 @@ void LogMessage::GenerateLogMessage(bool log_time) {
     char time_buffer[time_buffer_size];
     strftime(time_buffer, time_buffer_size, "%Y-%m-%d %H:%M:%S",
              localtime(&as_time_t));
-    os << "[" << time_buffer << "." << std::setw(6) << micros_remainder.count() 
-              << ": " << LOG_LEVELS[static_cast<int>(severity_)] << " " 
-              << fname_ << ":" << line_ << "] " << str() << std::endl;
+    os << "[" << time_buffer << "." << std::setw(6) << micros_remainder.count()
+              << ": " << LOG_LEVELS[static_cast<int>(record.severity)] << " "
+              << record.fname << ":" << record.line << "] " << record.message << std::endl;
   } else {
-    os << "[" << LOG_LEVELS[static_cast<int>(severity_)] << " " 
-              << fname_ << ":" << line_ << "] " << str() << std::endl;
+    os << "[" << LOG_LEVELS[static_cast<int>(record.severity)] << " "
+              << record.fname << ":" << record.line << "] " << record.message << std::endl;
+  }
+}
+
+// Ring buffer of messages written to the console by a background thread, so
+// that logging threads do not wait for the console. Messages that do not fit
+// are dropped, and their number is logged once there is room again.
+class AsyncLogSink {
+ public:
+  AsyncLogSink() : ring_(ASYNC_LOG_CAPACITY) {
+    std::thread(&AsyncLogSink::WriteLoop, this).detach();
+  }
+
+  void Push(LogRecord&& record) {
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      if (queued_ - written_ == ring_.size()) {
+        ++dropped_;
+        return;
+      }
+      ring_[queued_ % ring_.size()] = std::move(record);
+      ++queued_;
+    }
+    queued_cv_.notify_one();
+  }
+
+  // Waits until the messages queued so far are written.
+  void Flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto target = queued_;
+    written_cv_.wait(lock, [&]() { return written_ >= target; });
+  }
+
+ private:
+  void WriteLoop() {
+    static bool log_time = LogTimeFromEnv();
+    std::vector<LogRecord> batch;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      queued_cv_.wait(lock, [&]() { return queued_ > written_; });
+      auto end = queued_;
+      for (auto i = written_; i < end; ++i) {
+        batch.push_back(std::move(ring_[i % ring_.size()]));
+      }
+      int64_t dropped = dropped_;
+      dropped_ = 0;
+      lock.unlock();
+
+      for (auto& record : batch) {
+        WriteLogRecord(record, log_time);
+      }
+      if (dropped > 0) {
+        WriteLogRecord({LogLevel::WARNING, std::chrono::system_clock::now(),
+                        __FILE__, __LINE__,
+                        std::to_string(dropped) +
+                            " log messages were dropped because the log "
+                            "queue was full."},
+                       log_time);
+      }
+      batch.clear();
+
+      lock.lock();
+      written_ = end;
+      written_cv_.notify_all();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable queued_cv_;
+  std::condition_variable written_cv_;
+  std::vector<LogRecord> ring_;
+  // Messages queued and written since the start, ring_ holds the difference.
+  uint64_t queued_ = 0;
+  uint64_t written_ = 0;
+  int64_t dropped_ = 0;
+};
+
+bool LogAsyncFromEnv() {
+  const char* env_var_val = getenv("HOROVOD_LOG_ASYNC");
+  return env_var_val != nullptr && std::strtol(env_var_val, nullptr, 10) > 0;
+}
+
+// Null unless HOROVOD_LOG_ASYNC is set. Never destroyed, so that messages
+// logged during exit are still accepted.
+AsyncLogSink* GetAsyncLogSink() {
+  static AsyncLogSink* sink = []() -> AsyncLogSink* {
+    if (!LogAsyncFromEnv()) {
+      return nullptr;
+    }
+    std::atexit(FlushLog);
+    return new AsyncLogSink();
+  }();
+  return sink;
+}
+
+int64_t LogRateLimitFromEnv() {
+  const char* env_var_val = getenv("HOROVOD_LOG_RATE_LIMIT");
+  return env_var_val != nullptr ? std::strtol(env_var_val, nullptr, 10) : 0;
+}
+
+} // namespace
+
+bool LogSite::Allow() {
+  static int64_t limit = LogRateLimitFromEnv();
+  if (limit <= 0) {
+    return true;
+  }
+  auto now = std::chrono::duration_cast<std::chrono::seconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  auto window = window_.load();
+  if (window != now && window_.compare_exchange_strong(window, now)) {
+    count_ = 0;
+  }
+  if (count_.fetch_add(1) < limit) {
+    return true;
+  }
+  ++suppressed_;
+  return false;
+}
+
+LogMessage::LogMessage(const char* fname, int line, LogLevel severity,
+                       LogSite* site)
+    : fname_(fname), line_(line), severity_(severity) {
+  if (site != nullptr) {
+    if (site->Allow()) {
+      suppressed_before_ = site->TakeSuppressed();
+    } else {
+      // Arguments are still evaluated, but not formatted.
+      suppressed_ = true;
+      setstate(std::ios_base::badbit);
+    }
+  }
+}
+
+void LogMessage::GenerateLogMessage(bool log_time) {
+  LogRecord record{severity_, std::chrono::system_clock::now(), fname_, line_,
+                   str()};
+  if (suppressed_before_ > 0) {
+    record.message += " (" + std::to_string(suppressed_before_) +
+                      " more messages from here were suppressed)";
+  }
+  auto sink = GetAsyncLogSink();
+  if (sink != nullptr && severity_ != LogLevel::FATAL) {
+    sink->Push(std::move(record));
+    return;
   }
+  if (sink != nullptr) {
+    // Keep the order of the messages before the process aborts.
+    sink->Flush();
+  }
+  WriteLogRecord(record, log_time);
 }
 
 LogMessage::~LogMessage() {
-  static LogLevel min_log_level = MinLogLevelFromEnv();
   static bool log_time = LogTimeFromEnv();
-  if (severity_ >= min_log_level) {
+  if (!suppressed_ && LogEnabled(severity_)) {
     GenerateLogMessage(log_time);
   }
 }
@@ -52,6 +214,18 @@ LogMessageFatal::~LogMessageFatal() {
   abort();
 }
 
+LogLevel MinLogLevel() {
+  static LogLevel min_log_level = MinLogLevelFromEnv();
+  return min_log_level;
+}
+
+void FlushLog() {
+  auto sink = GetAsyncLogSink();
+  if (sink != nullptr) {
+    sink->Flush();
+  }
+}
+
 LogLevel ParseLogLevelStr(const char* env_var_val) {
   std::string min_log_level(env_var_val);
   std::transform(min_log_level.begin(), min_log_level.end(), min_log_level.begin(), ::tolower);
@@ -1,6 +1,8 @@
 #ifndef HOROVOD_LOGGING_H
 #define HOROVOD_LOGGING_H
 
+#include <atomic>
+#include <cstdint>
 #include <sstream>
 #include <string>
 
@@ -13,11 +15,31 @@ enum class LogLevel {
 
 #define LOG_LEVELS "TDIWEF"
 
+// State of one LOG statement, to limit how often it is written. Set
+// HOROVOD_LOG_RATE_LIMIT to the number of messages per second that each
+// statement may write; the others are dropped and counted.
+class LogSite {
+ public:
+  // Whether a message may be written now.
+  bool Allow();
+
+  // Number of messages dropped since the last one written.
+  int64_t TakeSuppressed() { return suppressed_.exchange(0); }
+
+ private:
+  std::atomic<int64_t> window_{-1};
+  std::atomic<int64_t> count_{0};
+  std::atomic<int64_t> suppressed_{0};
+};
+
 class LogMessage : public std::basic_ostringstream<char> {
  public:
-  LogMessage(const char* fname, int line, LogLevel severity);
+  LogMessage(const char* fname, int line, LogLevel severity,
+             LogSite* site = nullptr);
   ~LogMessage();
 
+  std::ostream& stream() { return *this; }
+
  protected:
   void GenerateLogMessage(bool log_time);
 
@@ -25,6 +47,8 @@ class LogMessage : public std::basic_ostringstream<char> {
   const char* fname_;
   int line_;
   LogLevel severity_;
+  bool suppressed_ = false;
+  int64_t suppressed_before_ = 0;
 };
 
 // LogMessageFatal ensures the process will exit in failure after
@@ -35,16 +59,35 @@ class LogMessageFatal : public LogMessage {
   ~LogMessageFatal();
 };
 
-#define _HVD_LOG_TRACE \
-  LogMessage(__FILE__, __LINE__, LogLevel::TRACE)
-#define _HVD_LOG_DEBUG \
-  LogMessage(__FILE__, __LINE__, LogLevel::DEBUG)
-#define _HVD_LOG_INFO \
-  LogMessage(__FILE__, __LINE__, LogLevel::INFO)
-#define _HVD_LOG_WARNING \
-  LogMessage(__FILE__, __LINE__, LogLevel::WARNING)
-#define _HVD_LOG_ERROR \
-  LogMessage(__FILE__, __LINE__, LogLevel::ERROR)
+// Turns the stream of a message into void, so that the macros below are a
+// single expression in both branches.
+struct LogMessageVoidify {
+  void operator&(std::ostream&) {}
+};
+
+// Minimum level of the messages to write, from HOROVOD_LOG_LEVEL.
+LogLevel MinLogLevel();
+
+inline bool LogEnabled(LogLevel severity) {
+  return severity >= MinLogLevel();
+}
+
+// Messages below the minimum level are not formatted at all, so that their
+// arguments are not evaluated.
+#define _HVD_LOG_AT(severity)                                                  \
+  !LogEnabled(LogLevel::severity)                                              \
+      ? (void)0                                                                \
+      : LogMessageVoidify() &                                                  \
+            LogMessage(__FILE__, __LINE__, LogLevel::severity, []() {          \
+              static LogSite site;                                             \
+              return &site;                                                    \
+            }()).stream()
+
+#define _HVD_LOG_TRACE _HVD_LOG_AT(TRACE)
+#define _HVD_LOG_DEBUG _HVD_LOG_AT(DEBUG)
+#define _HVD_LOG_INFO _HVD_LOG_AT(INFO)
+#define _HVD_LOG_WARNING _HVD_LOG_AT(WARNING)
+#define _HVD_LOG_ERROR _HVD_LOG_AT(ERROR)
 #define _HVD_LOG_FATAL \
   LogMessageFatal(__FILE__, __LINE__)
 
@@ -58,6 +101,9 @@ class LogMessageFatal : public LogMessage {
 LogLevel MinLogLevelFromEnv();
 bool LogTimeFromEnv();
 
+// Writes queued messages now, when HOROVOD_LOG_ASYNC is set.
+void FlushLog();
+
 }
 }
 
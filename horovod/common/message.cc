@@ -55,6 +55,52 @@ const std::string& DataType_Name(DataType value) {
     case HOROVOD_BOOL:
       static const std::string bool_("bool");
       return bool_;
+    case HOROVOD_BYTE:
+      static const std::string byte("byte");
+      return byte;
+    case HOROVOD_BFLOAT16:
+      static const std::string bfloat16("bfloat16");
+      return bfloat16;
+    default:
+      static const std::string unknown("<unknown>");
+      return unknown;
+  }
+}
+
+const std::string& ReduceOp_Name(ReduceOp value) {
+  switch (value) {
+    case ReduceOp::SUM:
+      static const std::string sum("SUM");
+      return sum;
+    case ReduceOp::ADASUM:
+      static const std::string adasum("ADASUM");
+      return adasum;
+    case ReduceOp::MIN:
+      static const std::string min("MIN");
+      return min;
+    case ReduceOp::MAX:
+      static const std::string max("MAX");
+      return max;
+    case ReduceOp::PRODUCT:
+      static const std::string product("PRODUCT");
+      return product;
+    default:
+      static const std::string unknown("<unknown>");
+      return unknown;
+  }
+}
+
+const std::string& Compression_Name(Compression value) {
+  switch (value) {
+    case Compression::NONE:
+      static const std::string none("NONE");
+      return none;
+    case Compression::INT8:
+      static const std::string int8("INT8");
+      return int8;
+    case Compression::INT4:
+      static const std::string int4("INT4");
+      return int4;
     default:
       static const std::string unknown("<unknown>");
       return unknown;
@@ -72,6 +118,15 @@ const std::string& Request::RequestType_Name(RequestType value) {
     case RequestType::BROADCAST:
       static const std::string broadcast("BROADCAST");
       return broadcast;
+    case RequestType::REDUCESCATTER:
+      static const std::string reducescatter("REDUCESCATTER");
+      return reducescatter;
+    case RequestType::ALLTOALL:
+      static const std::string alltoall("ALLTOALL");
+      return alltoall;
+    case RequestType::JOIN:
+      static const std::string join("JOIN");
+      return join;
     default:
       static const std::string unknown("<unknown>");
       return unknown;
@@ -98,6 +153,10 @@ void Request::set_tensor_name(const std::string& value) {
   tensor_name_ = value;
 }
 
+void Request::set_tensor_name(std::string&& value) {
+  tensor_name_ = std::move(value);
+}
+
 int32_t Request::root_rank() const { return root_rank_; }
 
 void Request::set_root_rank(int32_t value) { root_rank_ = value; }
@@ -114,12 +173,50 @@ void Request::set_tensor_shape(const std::vector<int64_t>& value) {
   tensor_shape_ = value;
 }
 
+void Request::set_tensor_shape(std::vector<int64_t>&& value) {
+  tensor_shape_ = std::move(value);
+}
+
 void Request::add_tensor_shape(int64_t value) {
   tensor_shape_.push_back(value);
 }
 
+const std::vector<int64_t>& Request::splits() const { return splits_; }
+
+void Request::set_splits(const std::vector<int64_t>& value) {
+  splits_ = value;
+}
+
+ReduceOp Request::reduce_op() const { return reduce_op_; }
+
+void Request::set_reduce_op(ReduceOp value) { reduce_op_ = value; }
+
+int32_t Request::process_set_id() const { return process_set_id_; }
+
+void Request::set_process_set_id(int32_t value) { process_set_id_ = value; }
+
+Compression Request::compression() const { return compression_; }
+
+void Request::set_compression(Compression value) { compression_ = value; }
+
+bool Request::group() const { return group_; }
+
+void Request::set_group(bool value) { group_ = value; }
+
+int32_t Request::tensor_id() const { return tensor_id_; }
+
+void Request::set_tensor_id(int32_t value) { tensor_id_ = value; }
+
 namespace {
 
+// Builders keep their buffer across Clear(), so reusing one per thread avoids
+// reallocating it for every message.
+flatbuffers::FlatBufferBuilder& ReusableBuilder() {
+  static thread_local flatbuffers::FlatBufferBuilder builder(1024);
+  builder.Clear();
+  return builder;
+}
+
 void Request_ParseFromWire(Request& request,
                            const wire::Request* obj) {
   request.set_request_rank(obj->request_rank());
@@ -130,6 +227,14 @@ void Request_ParseFromWire(Request& request,
   request.set_device(obj->device());
   request.set_tensor_shape(std::vector<int64_t>(obj->tensor_shape()->begin(),
                                                 obj->tensor_shape()->end()));
+  if (obj->splits() != nullptr) {
+    request.set_splits(
+        std::vector<int64_t>(obj->splits()->begin(), obj->splits()->end()));
+  }
+  request.set_reduce_op((ReduceOp) obj->reduce_op());
+  request.set_process_set_id(obj->process_set_id());
+  request.set_compression((Compression) obj->compression());
+  request.set_group(obj->group());
 }
 
 void Request_SerializeToWire(const Request& request,
@@ -138,6 +243,11 @@ void Request_SerializeToWire(const Request& request,
   // FlatBuffers must be built bottom-up.
   auto tensor_name_wire = builder.CreateString(request.tensor_name());
   auto tensor_shape_wire = builder.CreateVector(request.tensor_shape());
+  // Only alltoall requests carry splits. A null offset is not added.
+  flatbuffers::Offset<flatbuffers::Vector<int64_t>> splits_wire;
+  if (!request.splits().empty()) {
+    splits_wire = builder.CreateVector(request.splits());
+  }
 
   wire::RequestBuilder request_builder(builder);
   request_builder.add_request_rank(request.request_rank());
@@ -148,6 +258,11 @@ void Request_SerializeToWire(const Request& request,
   request_builder.add_root_rank(request.root_rank());
   request_builder.add_device(request.device());
   request_builder.add_tensor_shape(tensor_shape_wire);
+  request_builder.add_splits(splits_wire);
+  request_builder.add_reduce_op((wire::ReduceOp) request.reduce_op());
+  request_builder.add_process_set_id(request.process_set_id());
+  request_builder.add_compression((wire::Compression) request.compression());
+  request_builder.add_group(request.group());
   obj = request_builder.Finish();
 }
 
@@ -160,14 +275,14 @@ void Request::ParseFromBytes(Request& request, const uint8_t* input) {
 
 void Request::SerializeToString(const Request& request,
                                 std::string& output) {
-  flatbuffers::FlatBufferBuilder builder(1024);
+  auto& builder = ReusableBuilder();
   flatbuffers::Offset<wire::Request> obj;
   Request_SerializeToWire(request, builder, obj);
   builder.Finish(obj);
 
   uint8_t* buf = builder.GetBufferPointer();
   auto size = builder.GetSize();
-  output = std::string((char*) buf, size);
+  output.assign((char*) buf, size);
 }
 
 const std::vector<Request>& RequestList::requests() const {
@@ -187,12 +302,14 @@ void RequestList::add_request(const Request& value) {
 }
 
 void RequestList::emplace_request(Request&& value) {
-  requests_.emplace_back(value);
+  requests_.emplace_back(std::move(value));
 }
 
 void RequestList::ParseFromBytes(RequestList& request_list,
                                  const uint8_t* input) {
   auto obj = flatbuffers::GetRoot<wire::RequestList>(input);
+  request_list.requests_.reserve(request_list.requests_.size() +
+                                 obj->requests()->size());
   for (const auto& req_obj : *obj->requests()) {
     Request request;
     Request_ParseFromWire(request, req_obj);
@@ -204,7 +321,7 @@ void RequestList::ParseFromBytes(RequestList& request_list,
 void RequestList::SerializeToString(const RequestList& request_list,
                                     std::string& output) {
   // FlatBuffers must be built bottom-up.
-  flatbuffers::FlatBufferBuilder builder(1024);
+  auto& builder = ReusableBuilder();
   std::vector<flatbuffers::Offset<wire::Request>> requests;
   requests.reserve(request_list.requests().size());
   for (const auto& req : request_list.requests()) {
@@ -222,7 +339,7 @@ void RequestList::SerializeToString(const RequestList& request_list,
 
   uint8_t* buf = builder.GetBufferPointer();
   auto size = builder.GetSize();
-  output = std::string((char*) buf, size);
+  output.assign((char*) buf, size);
 }
 
 const std::string& Response::ResponseType_Name(ResponseType value) {
@@ -239,6 +356,15 @@ const std::string& Response::ResponseType_Name(ResponseType value) {
     case ResponseType::ERROR:
       static const std::string error("ERROR");
       return error;
+    case ResponseType::REDUCESCATTER:
+      static const std::string reducescatter("REDUCESCATTER");
+      return reducescatter;
+    case ResponseType::ALLTOALL:
+      static const std::string alltoall("ALLTOALL");
+      return alltoall;
+    case ResponseType::JOIN:
+      static const std::string join("JOIN");
+      return join;
     default:
       static const std::string unknown("<unknown>");
       return unknown;
@@ -279,6 +405,10 @@ void Response::add_tensor_name(const std::string& value) {
   tensor_names_.push_back(value);
 }
 
+void Response::add_tensor_name(std::string&& value) {
+  tensor_names_.push_back(std::move(value));
+}
+
 const std::string& Response::error_message() const { return error_message_; }
 
 void Response::set_error_message(const std::string& value) {
@@ -291,6 +421,10 @@ void Response::set_devices(const std::vector<int32_t>& value) {
   devices_ = value;
 }
 
+void Response::set_devices(std::vector<int32_t>&& value) {
+  devices_ = std::move(value);
+}
+
 void Response::add_device(int32_t value) { devices_.push_back(value); }
 
 const std::vector<int64_t>& Response::tensor_sizes() const {
@@ -301,10 +435,46 @@ void Response::set_tensor_sizes(const std::vector<int64_t>& value) {
   tensor_sizes_ = value;
 }
 
+void Response::set_tensor_sizes(std::vector<int64_t>&& value) {
+  tensor_sizes_ = std::move(value);
+}
+
 void Response::add_tensor_size(int64_t value) {
   tensor_sizes_.push_back(value);
 }
 
+ReduceOp Response::reduce_op() const { return reduce_op_; }
+
+void Response::set_reduce_op(ReduceOp value) { reduce_op_ = value; }
+
+const std::vector<int32_t>& Response::absent_ranks() const {
+  return absent_ranks_;
+}
+
+void Response::set_absent_ranks(const std::vector<int32_t>& value) {
+  absent_ranks_ = value;
+}
+
+int32_t Response::contributions() const { return contributions_; }
+
+void Response::set_contributions(int32_t value) { contributions_ = value; }
+
+int32_t Response::process_set_id() const { return process_set_id_; }
+
+void Response::set_process_set_id(int32_t value) { process_set_id_ = value; }
+
+Compression Response::compression() const { return compression_; }
+
+void Response::set_compression(Compression value) { compression_ = value; }
+
+DataType Response::tensor_type() const { return tensor_type_; }
+
+void Response::set_tensor_type(DataType value) { tensor_type_ = value; }
+
+bool Response::joined() const { return joined_; }
+
+void Response::set_joined(bool value) { joined_ = value; }
+
 void Response::add_allgather_response(const Response& response) {
   assert(response_type() == Response::ResponseType::ALLGATHER);
   assert(response.tensor_names().size() == 1);
@@ -326,6 +496,16 @@ void Response_ParseFromWire(Response& response,
       std::vector<int32_t>(obj->devices()->begin(), obj->devices()->end()));
   response.set_tensor_sizes(std::vector<int64_t>(obj->tensor_sizes()->begin(),
                                                  obj->tensor_sizes()->end()));
+  response.set_reduce_op((ReduceOp) obj->reduce_op());
+  if (obj->absent_ranks() != nullptr) {
+    response.set_absent_ranks(std::vector<int32_t>(
+        obj->absent_ranks()->begin(), obj->absent_ranks()->end()));
+  }
+  response.set_contributions(obj->contributions());
+  response.set_process_set_id(obj->process_set_id());
+  response.set_compression((Compression) obj->compression());
+  response.set_tensor_type((DataType) obj->tensor_type());
+  response.set_joined(obj->joined());
 }
 
 void Response::ParseFromBytes(Response& response, const uint8_t* input) {
@@ -342,6 +522,7 @@ void Response_SerializeToWire(const Response& response,
   auto error_message_wire = builder.CreateString(response.error_message());
   auto devices_wire = builder.CreateVector(response.devices());
   auto tensor_sizes_wire = builder.CreateVector(response.tensor_sizes());
+  auto absent_ranks_wire = builder.CreateVector(response.absent_ranks());
 
   wire::ResponseBuilder response_builder(builder);
   response_builder.add_response_type(
@@ -350,19 +531,27 @@ void Response_SerializeToWire(const Response& response,
   response_builder.add_error_message(error_message_wire);
   response_builder.add_devices(devices_wire);
   response_builder.add_tensor_sizes(tensor_sizes_wire);
+  response_builder.add_reduce_op((wire::ReduceOp) response.reduce_op());
+  response_builder.add_absent_ranks(absent_ranks_wire);
+  response_builder.add_contributions(response.contributions());
+  response_builder.add_process_set_id(response.process_set_id());
+  response_builder.add_compression(
+      (wire::Compression) response.compression());
+  response_builder.add_tensor_type((wire::DataType) response.tensor_type());
+  response_builder.add_joined(response.joined());
   obj = response_builder.Finish();
 }
 
 void Response::SerializeToString(const Response& response,
                                  std::string& output) {
-  flatbuffers::FlatBufferBuilder builder(1024);
+  auto& builder = ReusableBuilder();
   flatbuffers::Offset<wire::Response> obj;
   Response_SerializeToWire(response, builder, obj);
   builder.Finish(obj);
 
   uint8_t* buf = builder.GetBufferPointer();
   auto size = builder.GetSize();
-  output = std::string((char*) buf, size);
+  output.assign((char*) buf, size);
 }
 
 const std::vector<Response>& ResponseList::responses() const {
@@ -377,29 +566,38 @@ bool ResponseList::shutdown() const { return shutdown_; }
 
 void ResponseList::set_shutdown(bool value) { shutdown_ = value; }
 
+bool ResponseList::sync_parameters() const { return sync_parameters_; }
+
+void ResponseList::set_sync_parameters(bool value) {
+  sync_parameters_ = value;
+}
+
 void ResponseList::add_response(const Response& value) {
   responses_.push_back(value);
 }
 
 void ResponseList::emplace_response(Response&& value) {
-  responses_.emplace_back(value);
+  responses_.emplace_back(std::move(value));
 }
 
 void ResponseList::ParseFromBytes(ResponseList& response_list,
                                   const uint8_t* input) {
   auto obj = flatbuffers::GetRoot<wire::ResponseList>(input);
+  response_list.responses_.reserve(response_list.responses_.size() +
+                                   obj->responses()->size());
   for (const auto& resp_obj : *obj->responses()) {
     Response response;
     Response_ParseFromWire(response, resp_obj);
     response_list.emplace_response(std::move(response));
   }
   response_list.set_shutdown(obj->shutdown());
+  response_list.set_sync_parameters(obj->sync_parameters());
 }
 
 void ResponseList::SerializeToString(const ResponseList& response_list,
                                      std::string& output) {
   // FlatBuffers must be built bottom-up.
-  flatbuffers::FlatBufferBuilder builder(1024);
+  auto& builder = ReusableBuilder();
   std::vector<flatbuffers::Offset<wire::Response>> responses;
   responses.reserve(response_list.responses().size());
   for (const auto& resp : response_list.responses()) {
@@ -412,12 +610,13 @@ void ResponseList::SerializeToString(const ResponseList& response_list,
   wire::ResponseListBuilder response_list_builder(builder);
   response_list_builder.add_responses(responses_wire);
   response_list_builder.add_shutdown(response_list.shutdown());
+  response_list_builder.add_sync_parameters(response_list.sync_parameters());
   auto obj = response_list_builder.Finish();
   builder.Finish(obj);
 
   uint8_t* buf = builder.GetBufferPointer();
   auto size = builder.GetSize();
-  output = std::string((char*) buf, size);
+  output.assign((char*) buf, size);
 }
 
 } // namespace common
@@ -35,17 +35,33 @@ enum DataType {
   HOROVOD_FLOAT64 = 8,
   HOROVOD_BOOL = 9,
   HOROVOD_BYTE = 10,
+  HOROVOD_BFLOAT16 = 11,
 };
 
 const std::string& DataType_Name(DataType value);
 
+// How the tensors of an allreduce are combined across ranks. ADASUM combines
+// them pairwise with the scale-invariant adaptive summation of gradients
+// rather than adding them. MIN, MAX and PRODUCT are elementwise.
+enum class ReduceOp { SUM = 0, ADASUM = 1, MIN = 2, MAX = 3, PRODUCT = 4 };
+
+const std::string& ReduceOp_Name(ReduceOp value);
+
+// How the float32 values of an allreduce are quantized on the wire. INT8 and
+// INT4 send signed integers of that width with a scale per chunk of values,
+// rounded stochastically so that the quantization is unbiased.
+enum class Compression { NONE = 0, INT8 = 1, INT4 = 2 };
+
+const std::string& Compression_Name(Compression value);
+
 // A Request is a message sent from a rank greater than zero to the
 // coordinator (rank zero), informing the coordinator of an operation that
 // the rank wants to do and the tensor that it wants to apply the operation to.
 class Request {
 public:
   enum RequestType {
-    ALLREDUCE = 0, ALLGATHER = 1, BROADCAST = 2
+    ALLREDUCE = 0, ALLGATHER = 1, BROADCAST = 2, REDUCESCATTER = 3,
+    ALLTOALL = 4, JOIN = 5
   };
 
   static const std::string& RequestType_Name(RequestType value);
@@ -69,6 +85,8 @@ public:
 
   void set_tensor_name(const std::string& value);
 
+  void set_tensor_name(std::string&& value);
+
   int32_t root_rank() const;
 
   void set_root_rank(int32_t value);
@@ -81,10 +99,48 @@ public:
 
   void set_tensor_shape(const std::vector<int64_t>& value);
 
+  void set_tensor_shape(std::vector<int64_t>&& value);
+
   void add_tensor_shape(int64_t value);
 
+  // Empty unless request_type is ALLTOALL. Number of first dimension rows
+  // sent to each rank, or empty to split the tensor evenly.
+  const std::vector<int64_t>& splits() const;
+
+  void set_splits(const std::vector<int64_t>& value);
+
+  // SUM unless request_type is ALLREDUCE.
+  ReduceOp reduce_op() const;
+
+  void set_reduce_op(ReduceOp value);
+
+  // Process set the tensor is reduced within, see ProcessSetTable. 0 for all
+  // ranks.
+  int32_t process_set_id() const;
+
+  void set_process_set_id(int32_t value);
+
+  // NONE unless request_type is ALLREDUCE.
+  Compression compression() const;
+
+  void set_compression(Compression value);
+
+  // Whether the request negotiates a group of tensors. Its shape is then the
+  // number of elements of each tensor of the group.
+  bool group() const;
+
+  void set_group(bool value);
+
+  // Process-local interned ID of the tensor name, assigned by TensorQueue
+  // when the tensor is first enqueued. Not serialized, -1 if unassigned.
+  int32_t tensor_id() const;
+
+  void set_tensor_id(int32_t value);
+
   static void ParseFromBytes(Request& request, const uint8_t* input);
 
+  // Serialization reuses a per-thread FlatBufferBuilder, and the output
+  // string keeps its capacity if it is reused by the caller.
   static void SerializeToString(const Request& request, std::string& output);
 
 private:
@@ -93,8 +149,14 @@ private:
   DataType tensor_type_ = DataType::HOROVOD_UINT8;
   int32_t root_rank_ = 0;
   int32_t device_ = 0;
+  ReduceOp reduce_op_ = ReduceOp::SUM;
+  int32_t process_set_id_ = 0;
+  Compression compression_ = Compression::NONE;
+  bool group_ = false;
   std::string tensor_name_;
   std::vector<int64_t> tensor_shape_;
+  std::vector<int64_t> splits_;
+  int32_t tensor_id_ = -1;
 };
 
 class RequestList {
@@ -130,9 +192,13 @@ private:
 class Response {
 public:
   enum ResponseType {
-    ALLREDUCE = 0, ALLGATHER = 1, BROADCAST = 2, ERROR = 3
+    ALLREDUCE = 0, ALLGATHER = 1, BROADCAST = 2, ERROR = 3, REDUCESCATTER = 4,
+    ALLTOALL = 5, JOIN = 6
   };
 
+  // Number of response types, JOIN being the last one.
+  static constexpr int NUM_RESPONSE_TYPES = JOIN + 1;
+
   static const std::string& ResponseType_Name(ResponseType value);
 
   ResponseType response_type() const;
@@ -148,6 +214,8 @@ public:
 
   void add_tensor_name(const std::string& value);
 
+  void add_tensor_name(std::string&& value);
+
   // Empty unless response_type is ERROR.
   const std::string& error_message() const;
 
@@ -157,17 +225,67 @@ public:
 
   void set_devices(const std::vector<int32_t>& value);
 
+  void set_devices(std::vector<int32_t>&& value);
+
   void add_device(int32_t value);
 
-  // Empty unless response_type is ALLGATHER.
-  // These tensor sizes are the dimension zero sizes of all the input matrices,
-  // indexed by the rank.
+  // Empty unless response_type is ALLGATHER or ALLTOALL, or ranks that
+  // joined take part.
+  // For ALLGATHER, these tensor sizes are the dimension zero sizes of all the
+  // input matrices, indexed by the rank. For ALLTOALL, they are the number of
+  // rows each rank sends to each other rank, indexed by
+  // sender * size + receiver. With joined ranks, and for partial allreduces,
+  // they are the number of elements of each tensor, which the absent ranks
+  // take part with.
   const std::vector<int64_t>& tensor_sizes() const;
 
   void set_tensor_sizes(const std::vector<int64_t>& value);
 
+  void set_tensor_sizes(std::vector<int64_t>&& value);
+
   void add_tensor_size(int64_t value);
 
+  // Reduction of an allreduce, shared by all fused tensors.
+  ReduceOp reduce_op() const;
+
+  void set_reduce_op(ReduceOp value);
+
+  // Ranks left out of a partial allreduce because they were late, see
+  // Controller::SetStaleness, or ranks that joined and take part with zeros.
+  // Empty for all other responses.
+  const std::vector<int32_t>& absent_ranks() const;
+
+  void set_absent_ranks(const std::vector<int32_t>& value);
+
+  // Number of tensors summed by a partial allreduce, counting the late
+  // tensors folded in by the ranks present, or 0.
+  int32_t contributions() const;
+
+  void set_contributions(int32_t value);
+
+  // Process set the tensors are reduced within, 0 for all ranks. Only the
+  // ranks of the set perform the response.
+  int32_t process_set_id() const;
+
+  void set_process_set_id(int32_t value);
+
+  // Quantization of an allreduce, shared by all fused tensors.
+  Compression compression() const;
+
+  void set_compression(Compression value);
+
+  // Data type of the tensors, set for the ranks that joined, which have no
+  // tensors of their own.
+  DataType tensor_type() const;
+
+  void set_tensor_type(DataType value);
+
+  // Whether the absent ranks joined and take part with zeros, rather than
+  // being left out of a partial allreduce.
+  bool joined() const;
+
+  void set_joined(bool value);
+
   // To fuse multiple allgather responses
   void add_allgather_response(const Response& response);
 
@@ -182,6 +300,13 @@ private:
   std::string error_message_;
   std::vector<int32_t> devices_;
   std::vector<int64_t> tensor_sizes_;
+  ReduceOp reduce_op_ = ReduceOp::SUM;
+  std::vector<int32_t> absent_ranks_;
+  int32_t contributions_ = 0;
+  int32_t process_set_id_ = 0;
+  Compression compression_ = Compression::NONE;
+  DataType tensor_type_ = DataType::HOROVOD_UINT8;
+  bool joined_ = false;
 };
 
 class ResponseList {
@@ -198,6 +323,12 @@ public:
 
   void set_shutdown(bool value);
 
+  // Whether all ranks synchronize the parameters set at runtime on the
+  // coordinator once the responses are performed.
+  bool sync_parameters() const;
+
+  void set_sync_parameters(bool value);
+
   static void ParseFromBytes(ResponseList& response_list,
                              const uint8_t* input);
 
@@ -207,6 +338,7 @@ public:
 private:
   std::vector<Response> responses_;
   bool shutdown_ = false;
+  bool sync_parameters_ = false;
 };
 
 } // namespace common
@@ -0,0 +1,335 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "metrics.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "message.h"
+
+namespace horovod {
+namespace common {
+
+namespace {
+
+void WriteCounter(std::ostream& out, const std::string& name,
+                  const std::string& help, uint64_t value) {
+  out << "# HELP " << name << " " << help << "\n";
+  out << "# TYPE " << name << " counter\n";
+  out << name << " " << value << "\n";
+}
+
+void WriteGauge(std::ostream& out, const std::string& name,
+                const std::string& help, int64_t value) {
+  out << "# HELP " << name << " " << help << "\n";
+  out << "# TYPE " << name << " gauge\n";
+  out << name << " " << value << "\n";
+}
+
+} // namespace
+
+Histogram::Histogram(std::vector<uint64_t> bounds)
+    : bounds_(std::move(bounds)),
+      counts_(new std::atomic<uint64_t>[bounds_.size() + 1]) {
+  for (size_t i = 0; i <= bounds_.size(); ++i) {
+    counts_[i] = 0;
+  }
+}
+
+void Histogram::Observe(uint64_t value) {
+  auto bucket =
+      std::lower_bound(bounds_.begin(), bounds_.end(), value) - bounds_.begin();
+  counts_[bucket].fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+}
+
+std::vector<uint64_t> Histogram::ExponentialBounds(uint64_t first, int factor,
+                                                   int count) {
+  std::vector<uint64_t> bounds;
+  bounds.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    bounds.push_back(first);
+    first *= factor;
+  }
+  return bounds;
+}
+
+std::vector<uint64_t> Histogram::LogLinearBounds(uint64_t first,
+                                                 int sub_buckets, int octaves) {
+  std::vector<uint64_t> bounds = {first};
+  for (int i = 0; i < octaves; ++i) {
+    uint64_t base = first << i;
+    for (int j = 1; j <= sub_buckets; ++j) {
+      uint64_t bound = base + base * j / sub_buckets;
+      // Octaves narrower than sub_buckets have repeated bounds.
+      if (bound > bounds.back()) {
+        bounds.push_back(bound);
+      }
+    }
+  }
+  return bounds;
+}
+
+uint64_t Histogram::Count() const {
+  uint64_t count = 0;
+  for (size_t i = 0; i <= bounds_.size(); ++i) {
+    count += counts_[i].load(std::memory_order_relaxed);
+  }
+  return count;
+}
+
+uint64_t Histogram::Percentile(double fraction) const {
+  auto count = Count();
+  if (count == 0) {
+    return 0;
+  }
+  // Rank of the observation at the fraction, starting from one.
+  auto rank = std::max((uint64_t)(fraction * count + 0.5), (uint64_t)1);
+  uint64_t cumulative = 0;
+  for (size_t i = 0; i < bounds_.size(); ++i) {
+    cumulative += counts_[i].load(std::memory_order_relaxed);
+    if (cumulative >= rank) {
+      return bounds_[i];
+    }
+  }
+  return bounds_.back();
+}
+
+void Histogram::Write(std::ostream& out, const std::string& name,
+                      const std::string& help) const {
+  out << "# HELP " << name << " " << help << "\n";
+  out << "# TYPE " << name << " histogram\n";
+  uint64_t cumulative = 0;
+  for (size_t i = 0; i < bounds_.size(); ++i) {
+    cumulative += counts_[i].load(std::memory_order_relaxed);
+    out << name << "_bucket{le=\"" << bounds_[i] << "\"} " << cumulative
+        << "\n";
+  }
+  cumulative += counts_[bounds_.size()].load(std::memory_order_relaxed);
+  out << name << "_bucket{le=\"+Inf\"} " << cumulative << "\n";
+  out << name << "_sum " << sum_.load(std::memory_order_relaxed) << "\n";
+  out << name << "_count " << cumulative << "\n";
+}
+
+void Histogram::WriteSummary(std::ostream& out, const std::string& name,
+                             const std::string& labels) const {
+  auto prefix = labels.empty() ? "" : labels + ",";
+  auto suffix = labels.empty() ? " " : "{" + labels + "} ";
+  for (auto quantile : {"0.5", "0.9", "0.99"}) {
+    out << name << "{" << prefix << "quantile=\"" << quantile << "\"} "
+        << Percentile(std::atof(quantile)) << "\n";
+  }
+  out << name << "_sum" << suffix << Sum() << "\n";
+  out << name << "_count" << suffix << Count() << "\n";
+}
+
+OperationMetrics* Metrics::AddOperation(const std::string& name) {
+  int count = num_operations.load();
+  for (int i = 0; i < count; ++i) {
+    if (operations[i].name == name) {
+      return &operations[i];
+    }
+  }
+  if (count == MAX_OPERATIONS) {
+    return nullptr;
+  }
+  operations[count].name = name;
+  // Publishes the name to threads rendering the metrics.
+  num_operations.store(count + 1, std::memory_order_release);
+  return &operations[count];
+}
+
+std::string Metrics::Render() const {
+  std::stringstream out;
+  WriteCounter(out, "horovod_cycles_total",
+               "Background loop cycles.", cycles.Value());
+  cycle_time_us.Write(out, "horovod_cycle_time_microseconds",
+                      "Time between the starts of consecutive cycles.");
+  negotiation_time_us.Write(out, "horovod_negotiation_time_microseconds",
+                            "Time to compute the response list of a cycle.");
+  WriteCounter(out, "horovod_response_cache_hits_total",
+               "Tensors served from the response cache.", cache_hits.Value());
+  WriteCounter(out, "horovod_response_cache_misses_total",
+               "Tensors negotiated through the coordinator.",
+               cache_misses.Value());
+
+  out << "# HELP horovod_collectives_total Collective operations performed.\n";
+  out << "# TYPE horovod_collectives_total counter\n";
+  for (int i = 0; i < NUM_RESPONSE_TYPES; ++i) {
+    auto value = collectives[i].Value();
+    if (value > 0) {
+      out << "horovod_collectives_total{type=\""
+          << Response::ResponseType_Name((Response::ResponseType)i) << "\"} "
+          << value << "\n";
+    }
+  }
+  WriteCounter(out, "horovod_collective_bytes_total",
+               "Bytes of tensor data passed to collective operations.",
+               collective_bytes_total.Value());
+  collective_bytes.Write(out, "horovod_collective_bytes",
+                         "Bytes of tensor data per collective operation.");
+  collective_time_us.Write(out, "horovod_collective_time_microseconds",
+                           "Time to execute a collective operation.");
+  fusion_buffer_fill_percent.Write(
+      out, "horovod_fusion_buffer_fill_percent",
+      "Fill ratio of the fusion buffer for fused collectives.");
+
+  out << "# HELP horovod_wait_for_data_time_microseconds Time the background "
+         "thread waited for GPU tensors to be ready, per collective.\n";
+  out << "# TYPE horovod_wait_for_data_time_microseconds summary\n";
+  wait_for_data_time_us.WriteSummary(
+      out, "horovod_wait_for_data_time_microseconds", "");
+  WriteCounter(out, "horovod_memcpy_bytes_total",
+               "Bytes of host tensors copied into and out of fusion buffers.",
+               memcpy_bytes.Value());
+  out << "# HELP horovod_memcpy_time_microseconds Time to copy host tensors "
+         "into or out of a fusion buffer.\n";
+  out << "# TYPE horovod_memcpy_time_microseconds summary\n";
+  memcpy_time_us.WriteSummary(out, "horovod_memcpy_time_microseconds", "");
+
+  int count = num_operations.load(std::memory_order_acquire);
+  out << "# HELP horovod_operation_bytes_total Bytes of tensor data passed to "
+         "each operation class.\n";
+  out << "# TYPE horovod_operation_bytes_total counter\n";
+  for (int i = 0; i < count; ++i) {
+    out << "horovod_operation_bytes_total{operation=\"" << operations[i].name
+        << "\"} " << operations[i].bytes.Value() << "\n";
+  }
+  out << "# HELP horovod_operation_time_microseconds Time to execute a "
+         "collective on each operation class.\n";
+  out << "# TYPE horovod_operation_time_microseconds summary\n";
+  for (int i = 0; i < count; ++i) {
+    operations[i].time_us.WriteSummary(
+        out, "horovod_operation_time_microseconds",
+        "operation=\"" + operations[i].name + "\"");
+  }
+  WriteGauge(out, "horovod_stalled_tensors",
+             "Tensors reported as stalled by the last stall check.",
+             stalled_tensors.Value());
+
+  out << "# HELP horovod_straggler_last_arrivals Uncached tensors whose "
+         "negotiation waited for the rank the longest, for the ranks that "
+         "did so most often.\n";
+  out << "# TYPE horovod_straggler_last_arrivals gauge\n";
+  for (auto& straggler : stragglers.Value()) {
+    out << "horovod_straggler_last_arrivals{rank=\"" << straggler.first
+        << "\"} " << straggler.second << "\n";
+  }
+
+  out << "# HELP horovod_init_seconds Time taken by each step of the last "
+         "initialization or membership reset.\n";
+  out << "# TYPE horovod_init_seconds gauge\n";
+  for (auto& step : init_seconds.Value()) {
+    out << "horovod_init_seconds{step=\"" << step.first << "\"} "
+        << step.second << "\n";
+  }
+  return out.str();
+}
+
+MetricsServer::~MetricsServer() { Stop(); }
+
+bool MetricsServer::Start(int port, std::function<std::string()> render) {
+  listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_fd_ < 0) {
+    return false;
+  }
+  int reuse = 1;
+  setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons((uint16_t)port);
+  if (bind(listen_fd_, (sockaddr*)&addr, sizeof(addr)) != 0 ||
+      listen(listen_fd_, 16) != 0) {
+    close(listen_fd_);
+    listen_fd_ = -1;
+    return false;
+  }
+
+  render_ = std::move(render);
+  shut_down_ = false;
+  thread_ = std::thread(&MetricsServer::ServeLoop, this);
+  return true;
+}
+
+void MetricsServer::Stop() {
+  shut_down_ = true;
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  if (listen_fd_ >= 0) {
+    close(listen_fd_);
+    listen_fd_ = -1;
+  }
+}
+
+void MetricsServer::ServeLoop() {
+  while (!shut_down_) {
+    // Wake up regularly to check for shutdown.
+    pollfd pfd{listen_fd_, POLLIN, 0};
+    if (poll(&pfd, 1, 200) <= 0) {
+      continue;
+    }
+    int fd = accept(listen_fd_, nullptr, nullptr);
+    if (fd < 0) {
+      continue;
+    }
+
+    // Only the request line matters, and scrapers send small requests.
+    char request[4096];
+    pollfd cfd{fd, POLLIN, 0};
+    ssize_t n = poll(&cfd, 1, 1000) > 0
+                    ? recv(fd, request, sizeof(request) - 1, 0)
+                    : 0;
+    request[n > 0 ? n : 0] = '\0';
+
+    std::string status = "200 OK";
+    std::string body;
+    if (std::strncmp(request, "GET /metrics", 12) == 0) {
+      body = render_();
+    } else {
+      status = "404 Not Found";
+    }
+    std::stringstream response;
+    response << "HTTP/1.1 " << status << "\r\n"
+             << "Content-Type: text/plain; version=0.0.4\r\n"
+             << "Content-Length: " << body.size() << "\r\n"
+             << "Connection: close\r\n\r\n"
+             << body;
+    auto data = response.str();
+    size_t sent = 0;
+    while (sent < data.size()) {
+      auto written = send(fd, data.data() + sent, data.size() - sent,
+                          MSG_NOSIGNAL);
+      if (written <= 0) {
+        break;
+      }
+      sent += written;
+    }
+    close(fd);
+  }
+}
+
+} // namespace common
+} // namespace horovod
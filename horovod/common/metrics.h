@@ -0,0 +1,223 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HOROVOD_METRICS_H
+#define HOROVOD_METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "message.h"
+
+namespace horovod {
+namespace common {
+
+// Monotonic counter, safe to update from any thread.
+class Counter {
+public:
+  void Add(uint64_t value = 1) {
+    value_.fetch_add(value, std::memory_order_relaxed);
+  }
+  uint64_t Value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<uint64_t> value_{0};
+};
+
+// Value that can go up and down, safe to update from any thread.
+class Gauge {
+public:
+  void Set(int64_t value) { value_.store(value, std::memory_order_relaxed); }
+  int64_t Value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<int64_t> value_{0};
+};
+
+// Counts of the ranks that stand out for some event, replaced as a whole,
+// safe to update from any thread.
+class RankCounts {
+public:
+  void Set(std::vector<std::pair<int32_t, uint64_t>> value) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    value_ = std::move(value);
+  }
+  std::vector<std::pair<int32_t, uint64_t>> Value() const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return value_;
+  }
+
+private:
+  mutable std::mutex mutex_;
+  std::vector<std::pair<int32_t, uint64_t>> value_;
+};
+
+// Durations of named steps in the order they ran, replaced as a whole, safe
+// to update from any thread.
+class StepDurations {
+public:
+  void Set(std::vector<std::pair<std::string, double>> value) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    value_ = std::move(value);
+  }
+  std::vector<std::pair<std::string, double>> Value() const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return value_;
+  }
+
+private:
+  mutable std::mutex mutex_;
+  std::vector<std::pair<std::string, double>> value_;
+};
+
+// Histogram of integer observations with fixed bucket upper bounds. Only the
+// bucket counts are updated after construction, with relaxed atomics.
+class Histogram {
+public:
+  explicit Histogram(std::vector<uint64_t> bounds);
+  Histogram(const Histogram&) = delete;
+
+  void Observe(uint64_t value);
+
+  // Upper bounds first * factor^i for i in [0, count).
+  static std::vector<uint64_t> ExponentialBounds(uint64_t first, int factor,
+                                                 int count);
+
+  // Upper bounds that split each power of two from first to first *
+  // 2^octaves into sub_buckets equal parts, as HdrHistogram does, so that
+  // percentiles are within 1 / sub_buckets of the observed value.
+  static std::vector<uint64_t> LogLinearBounds(uint64_t first, int sub_buckets,
+                                               int octaves);
+
+  uint64_t Count() const;
+  uint64_t Sum() const { return sum_.load(std::memory_order_relaxed); }
+
+  // Upper bound of the bucket holding the given fraction of the
+  // observations, or the last bound if it is above all of them.
+  uint64_t Percentile(double fraction) const;
+
+  // Appends the histogram in the Prometheus text format.
+  void Write(std::ostream& out, const std::string& name,
+             const std::string& help) const;
+
+  // Appends the 0.5, 0.9 and 0.99 quantiles, the sum and the count as a
+  // series of a Prometheus summary, with the given labels.
+  void WriteSummary(std::ostream& out, const std::string& name,
+                    const std::string& labels) const;
+
+private:
+  std::vector<uint64_t> bounds_;
+  // One count per bound, plus one for values above the last bound.
+  std::unique_ptr<std::atomic<uint64_t>[]> counts_;
+  std::atomic<uint64_t> sum_{0};
+};
+
+// Executions of one collective operation class, timed until Execute
+// returns, which for GPU operations is when their work is queued.
+struct OperationMetrics {
+  std::string name;
+  Counter bytes;
+  Histogram time_us{Histogram::LogLinearBounds(1, 8, 26)};
+};
+
+// Runtime metrics of the background thread, exported in the Prometheus text
+// format through horovod_metrics() and the optional HTTP endpoint.
+struct Metrics {
+  // Background loop.
+  Counter cycles;
+  Histogram cycle_time_us{Histogram::LogLinearBounds(1, 8, 26)};
+  Histogram negotiation_time_us{Histogram::ExponentialBounds(16, 2, 20)};
+
+  // Response cache, counted per tensor.
+  Counter cache_hits;
+  Counter cache_misses;
+
+  // Collectives, indexed by Response::ResponseType.
+  static constexpr int NUM_RESPONSE_TYPES = Response::NUM_RESPONSE_TYPES;
+  Counter collectives[NUM_RESPONSE_TYPES];
+  Counter collective_bytes_total;
+  Histogram collective_bytes{Histogram::ExponentialBounds(1024, 4, 14)};
+  Histogram collective_time_us{Histogram::ExponentialBounds(16, 2, 22)};
+
+  // Host side waits for the ready events of GPU tensors, per collective.
+  Histogram wait_for_data_time_us{Histogram::LogLinearBounds(1, 8, 26)};
+
+  // Copies of host tensors into and out of fusion buffers.
+  Counter memcpy_bytes;
+  Histogram memcpy_time_us{Histogram::LogLinearBounds(1, 8, 26)};
+
+  // Collective operations by class. They are registered before the
+  // background loop runs collectives, and no more than MAX_OPERATIONS of
+  // them are tracked.
+  static constexpr int MAX_OPERATIONS = 32;
+  OperationMetrics operations[MAX_OPERATIONS];
+  std::atomic_int num_operations{0};
+
+  // Returns the metrics of the operation class with the given name, added if
+  // needed, or null if too many are tracked. Not safe to call concurrently.
+  OperationMetrics* AddOperation(const std::string& name);
+
+  // Fill ratio of the fusion buffer, in percent, for fused collectives.
+  Histogram fusion_buffer_fill_percent{
+      {5, 10, 20, 30, 40, 50, 60, 70, 80, 90, 100}};
+
+  // Tensors reported as stalled by the last stall check.
+  Gauge stalled_tensors;
+
+  // Ranks whose request was most often the last one needed to negotiate a
+  // tensor, as of the last stall check.
+  static constexpr int NUM_STRAGGLERS = 8;
+  RankCounts stragglers;
+
+  // Seconds taken by each step of the last initialization or membership
+  // reset of the background thread.
+  StepDurations init_seconds;
+
+  std::string Render() const;
+};
+
+// Minimal HTTP server answering GET /metrics on the loopback interface.
+class MetricsServer {
+public:
+  MetricsServer() = default;
+  MetricsServer(const MetricsServer&) = delete;
+  ~MetricsServer();
+
+  // Returns false if the port could not be bound.
+  bool Start(int port, std::function<std::string()> render);
+
+  void Stop();
+
+private:
+  void ServeLoop();
+
+  int listen_fd_ = -1;
+  std::function<std::string()> render_;
+  std::thread thread_;
+  std::atomic_bool shut_down_{false};
+};
+
+} // namespace common
+} // namespace horovod
+
+#endif // HOROVOD_METRICS_H
@@ -16,17 +16,55 @@
 
 #include "mpi_context.h"
 
+#include <algorithm>
+#include <climits>
+#include <functional>
 #include <iostream>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "../common.h"
 #include "../half.h"
 #include "../logging.h"
+#include "../topology.h"
+#include "../utils/env_parser.h"
+
+#if defined(OPEN_MPI) && OPEN_MPI
+// Declares MPIX_Query_cuda_support() when Open MPI has the CUDA extension.
+#include <mpi-ext.h>
+#endif
 
 namespace horovod {
 namespace common {
 
+namespace {
+
+// Returns whether the MPI library can be given pointers to GPU memory. Open
+// MPI reports it through its CUDA extension, MVAPICH2 and Cray MPICH only
+// access GPU memory when enabled in their environment. Other libraries are
+// trusted to, as Horovod built with HOROVOD_GPU_ALLREDUCE=MPI always did.
+bool QueryCUDASupport() {
+  int value = GetIntEnvOrDefault(HOROVOD_MPI_CUDA_AWARE, -1);
+  if (value >= 0) {
+    return value > 0;
+  }
+#if defined(MPIX_CUDA_AWARE_SUPPORT) && MPIX_CUDA_AWARE_SUPPORT
+  return MPIX_Query_cuda_support() == 1;
+#elif defined(OPEN_MPI) && OPEN_MPI
+  return false;
+#elif defined(MVAPICH2_VERSION)
+  return GetIntEnvOrDefault("MV2_USE_CUDA", 0) > 0;
+#else
+  if (std::getenv("MPICH_RDMA_ENABLED_CUDA") != nullptr) {
+    return GetIntEnvOrDefault("MPICH_RDMA_ENABLED_CUDA", 0) > 0;
+  }
+  return true;
+#endif
+}
+
+} // namespace
+
 MPI_Datatype MPIContext::GetMPIDataType(const std::shared_ptr<Tensor> tensor) {
   return GetMPIDataType(tensor->dtype());
 }
@@ -55,6 +93,8 @@ MPI_Datatype MPIContext::GetMPIDataType(const DataType dtype) {
     return MPI_C_BOOL;
   case HOROVOD_BYTE:
     return MPI_BYTE;
+  case HOROVOD_BFLOAT16:
+    return mpi_bfloat16_t;
   default:
     throw std::logic_error("Type " + DataType_Name(dtype) +
                            " is not supported in MPI mode.");
@@ -62,7 +102,33 @@ MPI_Datatype MPIContext::GetMPIDataType(const DataType dtype) {
 }
 
 MPI_Op MPIContext::GetMPISumOp(DataType dtype) {
-  return dtype == HOROVOD_FLOAT16 ? mpi_float16_sum : MPI_SUM;
+  switch (dtype) {
+  case HOROVOD_FLOAT16:
+    return mpi_float16_sum;
+  case HOROVOD_BFLOAT16:
+    return mpi_bfloat16_sum;
+  default:
+    return MPI_SUM;
+  }
+}
+
+MPI_Op MPIContext::GetMPIOp(DataType dtype, ReduceOp reduce_op) {
+  bool float16 = dtype == HOROVOD_FLOAT16;
+  bool bfloat16 = dtype == HOROVOD_BFLOAT16;
+  switch (reduce_op) {
+  case ReduceOp::SUM:
+    return GetMPISumOp(dtype);
+  case ReduceOp::MIN:
+    return float16 ? mpi_float16_min : bfloat16 ? mpi_bfloat16_min : MPI_MIN;
+  case ReduceOp::MAX:
+    return float16 ? mpi_float16_max : bfloat16 ? mpi_bfloat16_max : MPI_MAX;
+  case ReduceOp::PRODUCT:
+    return float16 ? mpi_float16_prod
+                   : bfloat16 ? mpi_bfloat16_prod : MPI_PROD;
+  default:
+    throw std::logic_error("Reduction " + ReduceOp_Name(reduce_op) +
+                           " is not supported in MPI mode.");
+  }
 }
 
 MPI_Comm MPIContext::GetMPICommunicator(Communicator comm) {
@@ -79,6 +145,35 @@ MPI_Comm MPIContext::GetMPICommunicator(Communicator comm) {
   }
 }
 
+MPI_Comm MPIContext::GetProcessSetCommunicator(const ProcessSet* process_set) {
+  if (process_set == nullptr) {
+    return mpi_comm;
+  }
+  auto it = process_set_comms.find(process_set->id);
+  if (it != process_set_comms.end()) {
+    return it->second;
+  }
+
+  // Only the members take part, so sets are created in the order their first
+  // responses are performed, which is the same on all members.
+  MPI_Group world_group;
+  MPI_Group set_group;
+  MPI_Comm comm;
+  MPI_Comm_group(mpi_comm, &world_group);
+  MPI_Group_incl(world_group, process_set->Size(), process_set->ranks.data(),
+                 &set_group);
+  int op = MPI_Comm_create_group(mpi_comm, set_group, process_set->id, &comm);
+  MPI_Group_free(&set_group);
+  MPI_Group_free(&world_group);
+  if (op != MPI_SUCCESS) {
+    throw std::runtime_error("MPI_Comm_create_group failed for process set " +
+                             std::to_string(process_set->id) +
+                             ", see MPI output for details.");
+  }
+  process_set_comms[process_set->id] = comm;
+  return comm;
+}
+
 int MPIContext::GetMPITypeSize(DataType dtype) {
   int out;
   MPI_Type_size(GetMPIDataType(dtype), &out);
@@ -156,23 +251,105 @@ void MPIContext::Initialize(const std::vector<int>& ranks,
 
   // Create cross node communicator.
   MPI_Comm_split(mpi_comm, local_rank, world_rank, &cross_comm);
+  OrderCrossCommByRack();
 
   // Create custom MPI float16 data type.
   MPI_Type_contiguous(2, MPI_BYTE, &mpi_float16_t);
   MPI_Type_commit(&mpi_float16_t);
 
-  // Create custom MPI float16 summation op.
+  // Create custom MPI float16 reduction ops.
   MPI_Op_create(&float16_sum, 1, &mpi_float16_sum);
+  MPI_Op_create(&float16_min, 1, &mpi_float16_min);
+  MPI_Op_create(&float16_max, 1, &mpi_float16_max);
+  MPI_Op_create(&float16_prod, 1, &mpi_float16_prod);
+
+  // Create custom MPI bfloat16 data type and reduction ops.
+  MPI_Type_contiguous(2, MPI_BYTE, &mpi_bfloat16_t);
+  MPI_Type_commit(&mpi_bfloat16_t);
+  MPI_Op_create(&bfloat16_sum, 1, &mpi_bfloat16_sum);
+  MPI_Op_create(&bfloat16_min, 1, &mpi_bfloat16_min);
+  MPI_Op_create(&bfloat16_max, 1, &mpi_bfloat16_max);
+  MPI_Op_create(&bfloat16_prod, 1, &mpi_bfloat16_prod);
+
+  cuda_aware_ = QueryCUDASupport();
+  LOG(DEBUG) << "MPI library is " << (cuda_aware_ ? "" : "not ")
+             << "CUDA-aware.";
+
+  async_collectives = GetIntEnvOrDefault(HOROVOD_MPI_ASYNC, 0) > 0;
+
+#if MPI_VERSION >= 4
+  persistent_collectives =
+      GetIntEnvOrDefault(HOROVOD_MPI_PERSISTENT_COLLECTIVES, 0) > 0;
+#else
+  if (GetIntEnvOrDefault(HOROVOD_MPI_PERSISTENT_COLLECTIVES, 0) > 0) {
+    LOG(WARNING) << "Persistent collectives require MPI 4, ignoring "
+                 << HOROVOD_MPI_PERSISTENT_COLLECTIVES << ".";
+  }
+#endif
+}
+
+void MPIContext::OrderCrossCommByRack() {
+  auto rack = DiscoverRackId();
+  int local_size;
+  MPI_Comm_size(local_comm, &local_size);
+
+  // Minimum and maximum over all ranks of whether the rack is known and of
+  // the node size.
+  int known = rack.empty() ? 0 : 1;
+  int bounds[4] = {known, local_size, -known, -local_size};
+  MPI_Allreduce(MPI_IN_PLACE, bounds, 4, MPI_INT, MPI_MIN, mpi_comm);
+  if (bounds[2] == 0) {
+    return;
+  }
+  if (bounds[0] == 0) {
+    LOG(WARNING) << "Some ranks do not know their rack, not ordering the "
+                    "cross-node communicator by rack.";
+    return;
+  }
+  if (bounds[1] != -bounds[3]) {
+    // Nodes of different sizes have cross communicators of different
+    // members, which would not agree on an order.
+    LOG(WARNING) << "Nodes have different numbers of ranks, not ordering the "
+                    "cross-node communicator by rack.";
+    return;
+  }
+
+  int cross_rank, cross_size;
+  MPI_Comm_rank(cross_comm, &cross_rank);
+  MPI_Comm_size(cross_comm, &cross_size);
+  std::vector<uint64_t> racks((size_t)cross_size);
+  uint64_t rack_hash = std::hash<std::string>()(rack);
+  MPI_Allgather(&rack_hash, 1, MPI_UINT64_T, racks.data(), 1, MPI_UINT64_T,
+                cross_comm);
+  auto order = RackRingOrder(racks);
+
+  MPI_Comm ordered_comm;
+  MPI_Comm_split(cross_comm, 0, order[cross_rank], &ordered_comm);
+  MPI_Comm_free(&cross_comm);
+  cross_comm = ordered_comm;
+  LOG(DEBUG) << "Rack " << rack << ", cross-node position " << cross_rank
+             << " -> " << order[cross_rank] << ".";
 }
 
 void MPIContext::Finalize(MPIContextManager& ctx_manager) {
   if (!enabled_) {
     return;
   }
+  FreePersistentRequests();
+
+  for (auto& it : process_set_comms) {
+    MPI_Comm_free(&it.second);
+  }
+  process_set_comms.clear();
+
   if (mpi_comm != MPI_COMM_NULL && mpi_comm != MPI_COMM_WORLD) {
     MPI_Comm_free(&mpi_comm);
   }
 
+  if (control_comm != MPI_COMM_NULL) {
+    MPI_Comm_free(&control_comm);
+  }
+
   if (local_comm != MPI_COMM_NULL) {
     MPI_Comm_free(&local_comm);
   }
@@ -185,8 +362,22 @@ void MPIContext::Finalize(MPIContextManager& ctx_manager) {
     MPI_Type_free(&mpi_float16_t);
   }
 
-  if (mpi_float16_sum != MPI_OP_NULL) {
-    MPI_Op_free(&mpi_float16_sum);
+  for (auto op : {&mpi_float16_sum, &mpi_float16_min, &mpi_float16_max,
+                  &mpi_float16_prod}) {
+    if (*op != MPI_OP_NULL) {
+      MPI_Op_free(op);
+    }
+  }
+
+  if (mpi_bfloat16_t != MPI_DATATYPE_NULL) {
+    MPI_Type_free(&mpi_bfloat16_t);
+  }
+
+  for (auto op : {&mpi_bfloat16_sum, &mpi_bfloat16_min, &mpi_bfloat16_max,
+                  &mpi_bfloat16_prod}) {
+    if (*op != MPI_OP_NULL) {
+      MPI_Op_free(op);
+    }
   }
 
   if (should_finalize) {
@@ -194,6 +385,297 @@ void MPIContext::Finalize(MPIContextManager& ctx_manager) {
   }
 }
 
+namespace {
+
+// Elements per call when large counts are split.
+const int64_t MAX_MPI_COUNT = INT_MAX;
+
+// Persistent allreduce requests kept before they are all freed.
+const size_t MAX_PERSISTENT_REQUESTS = 64;
+
+// Collectives left in flight before waiting for the oldest.
+const size_t MAX_IN_FLIGHT_COLLECTIVES = 8;
+
+MPI_Aint TypeExtent(MPI_Datatype datatype) {
+  MPI_Aint lb, extent;
+  MPI_Type_get_extent(datatype, &lb, &extent);
+  return extent;
+}
+
+const void* OffsetSendBuffer(const void* sendbuf, int64_t offset) {
+  return sendbuf == MPI_IN_PLACE ? MPI_IN_PLACE
+                                 : (const uint8_t*)sendbuf + offset;
+}
+
+} // namespace
+
+int MPILargeAllreduce(const void* sendbuf, void* recvbuf, int64_t count,
+                      MPI_Datatype datatype, MPI_Op op, MPI_Comm comm) {
+  if (count <= MAX_MPI_COUNT) {
+    return MPI_Allreduce(sendbuf, recvbuf, (int)count, datatype, op, comm);
+  }
+#if MPI_VERSION >= 4
+  return MPI_Allreduce_c(sendbuf, recvbuf, (MPI_Count)count, datatype, op,
+                         comm);
+#else
+  MPI_Aint extent = TypeExtent(datatype);
+  for (int64_t first = 0; first < count; first += MAX_MPI_COUNT) {
+    int n = (int)std::min(MAX_MPI_COUNT, count - first);
+    int result = MPI_Allreduce(OffsetSendBuffer(sendbuf, first * extent),
+                               (uint8_t*)recvbuf + first * extent, n, datatype,
+                               op, comm);
+    if (result != MPI_SUCCESS) {
+      return result;
+    }
+  }
+  return MPI_SUCCESS;
+#endif
+}
+
+int MPIContext::StartPersistentAllreduce(void* buffer, int count,
+                                         MPI_Datatype datatype, MPI_Op op,
+                                         MPI_Comm comm,
+                                         uint64_t buffer_generation,
+                                         MPI_Request& request) {
+#if MPI_VERSION >= 4
+  // The requests are bound to the buffers, start over whenever they are
+  // reallocated.
+  if (buffer_generation != persistent_generation) {
+    FreePersistentRequests();
+    persistent_generation = buffer_generation;
+  }
+  auto key = std::make_tuple(buffer, count, datatype, op, comm);
+  auto it = persistent_requests.find(key);
+  if (it == persistent_requests.end()) {
+    // Misses happen at the same point on all ranks, so they can all start
+    // over when the number of requests is bounded.
+    if (persistent_requests.size() >= MAX_PERSISTENT_REQUESTS) {
+      FreePersistentRequests();
+    }
+    MPI_Request created;
+    int result = MPI_Allreduce_init(MPI_IN_PLACE, buffer, count, datatype, op,
+                                    comm, MPI_INFO_NULL, &created);
+    if (result != MPI_SUCCESS) {
+      return result;
+    }
+    it = persistent_requests.emplace(key, created).first;
+  }
+  request = it->second;
+  return MPI_Start(&it->second);
+#else
+  return MPI_ERR_UNSUPPORTED_OPERATION;
+#endif
+}
+
+int MPIContext::PersistentAllreduce(void* buffer, int64_t count,
+                                    MPI_Datatype datatype, MPI_Op op,
+                                    MPI_Comm comm,
+                                    uint64_t buffer_generation) {
+#if MPI_VERSION >= 4
+  if (count <= MAX_MPI_COUNT) {
+    MPI_Request request;
+    int result = StartPersistentAllreduce(buffer, (int)count, datatype, op,
+                                          comm, buffer_generation, request);
+    if (result != MPI_SUCCESS) {
+      return result;
+    }
+    return MPI_Wait(&request, MPI_STATUS_IGNORE);
+  }
+#endif
+  return MPILargeAllreduce(MPI_IN_PLACE, buffer, count, datatype, op, comm);
+}
+
+void MPIContext::FreePersistentRequests() {
+  Progress(true);
+  for (auto& entry : persistent_requests) {
+    MPI_Request_free(&entry.second);
+  }
+  persistent_requests.clear();
+}
+
+void MPIContext::Enqueue(MPI_Request request,
+                         const std::vector<TensorTableEntry>& entries,
+                         std::shared_ptr<PersistentBuffer> buffer,
+                         std::function<void()> on_complete,
+                         std::string error_message, Timeline& timeline) {
+  std::lock_guard<std::mutex> guard(in_flight_mutex_);
+  while (in_flight_.size() >= MAX_IN_FLIGHT_COLLECTIVES) {
+    Complete(in_flight_.front(), true);
+    in_flight_.pop_front();
+  }
+  in_flight_.push_back({request, entries, std::move(buffer),
+                        std::move(on_complete),
+                        std::move(error_message), &timeline});
+}
+
+void MPIContext::Progress(bool wait) {
+  std::lock_guard<std::mutex> guard(in_flight_mutex_);
+  for (auto it = in_flight_.begin(); it != in_flight_.end();) {
+    if (Complete(*it, wait)) {
+      it = in_flight_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void MPIContext::WaitForBuffer(
+    const std::shared_ptr<PersistentBuffer>& buffer) {
+  std::lock_guard<std::mutex> guard(in_flight_mutex_);
+  for (auto it = in_flight_.begin(); it != in_flight_.end();) {
+    if (it->buffer == buffer) {
+      Complete(*it, true);
+      it = in_flight_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+bool MPIContext::Complete(InFlightCollective& collective, bool wait) {
+  int result;
+  if (wait) {
+    result = MPI_Wait(&collective.request, MPI_STATUS_IGNORE);
+  } else {
+    int done = 0;
+    result = MPI_Test(&collective.request, &done, MPI_STATUS_IGNORE);
+    if (result == MPI_SUCCESS && !done) {
+      return false;
+    }
+  }
+  Status status = result == MPI_SUCCESS
+                      ? Status::OK()
+                      : Status::UnknownError(collective.error_message);
+  auto& timeline = *collective.timeline;
+  timeline.ActivityEndAll(collective.entries);
+
+  if (status.ok() && collective.on_complete) {
+    try {
+      collective.on_complete();
+    } catch (const std::exception& ex) {
+      status = Status::UnknownError(ex.what());
+    }
+  }
+
+  for (auto& e : collective.entries) {
+    timeline.End(e.tensor_name, status.ok() ? e.output : nullptr);
+    e.callback(status);
+  }
+  return true;
+}
+
+int MPILargeReduce(const void* sendbuf, void* recvbuf, int64_t count,
+                   MPI_Datatype datatype, MPI_Op op, int root, MPI_Comm comm) {
+  if (count <= MAX_MPI_COUNT) {
+    return MPI_Reduce(sendbuf, recvbuf, (int)count, datatype, op, root, comm);
+  }
+#if MPI_VERSION >= 4
+  return MPI_Reduce_c(sendbuf, recvbuf, (MPI_Count)count, datatype, op, root,
+                      comm);
+#else
+  MPI_Aint extent = TypeExtent(datatype);
+  for (int64_t first = 0; first < count; first += MAX_MPI_COUNT) {
+    int n = (int)std::min(MAX_MPI_COUNT, count - first);
+    int result = MPI_Reduce(OffsetSendBuffer(sendbuf, first * extent),
+                            (uint8_t*)recvbuf + first * extent, n, datatype,
+                            op, root, comm);
+    if (result != MPI_SUCCESS) {
+      return result;
+    }
+  }
+  return MPI_SUCCESS;
+#endif
+}
+
+int MPILargeBcast(void* buffer, int64_t count, MPI_Datatype datatype, int root,
+                  MPI_Comm comm) {
+  if (count <= MAX_MPI_COUNT) {
+    return MPI_Bcast(buffer, (int)count, datatype, root, comm);
+  }
+#if MPI_VERSION >= 4
+  return MPI_Bcast_c(buffer, (MPI_Count)count, datatype, root, comm);
+#else
+  MPI_Aint extent = TypeExtent(datatype);
+  for (int64_t first = 0; first < count; first += MAX_MPI_COUNT) {
+    int n = (int)std::min(MAX_MPI_COUNT, count - first);
+    int result =
+        MPI_Bcast((uint8_t*)buffer + first * extent, n, datatype, root, comm);
+    if (result != MPI_SUCCESS) {
+      return result;
+    }
+  }
+  return MPI_SUCCESS;
+#endif
+}
+
+int MPILargeAllgatherv(const void* sendbuf, int64_t sendcount,
+                       MPI_Datatype datatype, void* recvbuf,
+                       const int64_t* recvcounts, const int64_t* displs,
+                       MPI_Comm comm) {
+  int size;
+  MPI_Comm_size(comm, &size);
+  bool fits = sendcount <= MAX_MPI_COUNT;
+  for (int i = 0; i < size && fits; ++i) {
+    fits = recvcounts[i] <= MAX_MPI_COUNT && displs[i] <= MAX_MPI_COUNT;
+  }
+
+  if (fits) {
+    thread_local std::vector<int> counts;
+    thread_local std::vector<int> displacements;
+    counts.assign(recvcounts, recvcounts + size);
+    displacements.assign(displs, displs + size);
+    return MPI_Allgatherv(sendbuf, (int)sendcount, datatype, recvbuf,
+                          counts.data(), displacements.data(), datatype, comm);
+  }
+
+#if MPI_VERSION >= 4
+  thread_local std::vector<MPI_Count> counts;
+  thread_local std::vector<MPI_Aint> displacements;
+  counts.assign(recvcounts, recvcounts + size);
+  displacements.assign(displs, displs + size);
+  return MPI_Allgatherv_c(sendbuf, (MPI_Count)sendcount, datatype, recvbuf,
+                          counts.data(), displacements.data(), datatype, comm);
+#else
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Aint extent = TypeExtent(datatype);
+  uint8_t* own_block = (uint8_t*)recvbuf + displs[rank] * extent;
+
+  // Place this rank's block first. Going through MPI keeps this working for
+  // device memory with a CUDA-aware library.
+  if (sendbuf != MPI_IN_PLACE) {
+    for (int64_t first = 0; first < sendcount; first += MAX_MPI_COUNT) {
+      int n = (int)std::min(MAX_MPI_COUNT, sendcount - first);
+      int result = MPI_Sendrecv(
+          (const uint8_t*)sendbuf + first * extent, n, datatype, rank, 0,
+          own_block + first * extent, n, datatype, rank, 0, comm,
+          MPI_STATUS_IGNORE);
+      if (result != MPI_SUCCESS) {
+        return result;
+      }
+    }
+  }
+
+  thread_local std::vector<MPI_Request> requests;
+  requests.clear();
+  for (int root = 0; root < size; ++root) {
+    uint8_t* block = (uint8_t*)recvbuf + displs[root] * extent;
+    for (int64_t first = 0; first < recvcounts[root];
+         first += MAX_MPI_COUNT) {
+      int n = (int)std::min(MAX_MPI_COUNT, recvcounts[root] - first);
+      requests.emplace_back();
+      int result = MPI_Ibcast(block + first * extent, n, datatype, root, comm,
+                              &requests.back());
+      if (result != MPI_SUCCESS) {
+        return result;
+      }
+    }
+  }
+  return MPI_Waitall((int)requests.size(), requests.data(),
+                     MPI_STATUSES_IGNORE);
+#endif
+}
+
 void MPIContextManager::EnvInitialize(int mpi_threads_required) {
   int mpi_threads_provided;
   MPI_Init_thread(nullptr, nullptr, mpi_threads_required,
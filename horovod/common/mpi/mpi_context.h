@@ -17,13 +17,20 @@
 #ifndef HOROVOD_MPI_CONTEXT_H
 #define HOROVOD_MPI_CONTEXT_H
 
+#include <deque>
+#include <functional>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <tuple>
 #include <vector>
 
 #include "../common.h"
 #include "../half.h"
 #include "../logging.h"
+#include "../process_set.h"
+#include "../timeline.h"
 
 namespace horovod {
 namespace common {
@@ -62,34 +69,160 @@ struct MPIContext {
 
   MPI_Op GetMPISumOp(DataType dtype);
 
+  // MPI operation of an elementwise reduction of the given type, using the
+  // custom ops for float16 and bfloat16.
+  MPI_Op GetMPIOp(DataType dtype, ReduceOp reduce_op);
+
   MPI_Comm GetMPICommunicator(Communicator comm);
 
+  // Communicator of the members of the process set, created collectively by
+  // them on first use, or the global communicator if process_set is null.
+  MPI_Comm GetProcessSetCommunicator(const ProcessSet* process_set);
+
   int GetMPITypeSize(DataType dtype);
 
+  // Reorders the ranks of cross_comm so that the nodes of each rack are
+  // adjacent in its rings, when every rank knows its rack.
+  void OrderCrossCommByRack();
+
+  // Whether the MPI library accepts pointers to GPU memory, queried from the
+  // library when it supports it and overridden by HOROVOD_MPI_CUDA_AWARE.
+  bool IsCUDAAware() const { return cuda_aware_; }
+
+  // Allreduces buffer in place with a persistent request, created by
+  // MPI_Allreduce_init on the first use of the buffer, count, datatype, op
+  // and communicator and only started afterwards. Creating the requests is
+  // collective, so the buffer must be allocated at the same point on all
+  // ranks, like the fusion buffers. The requests are freed whenever
+  // buffer_generation changes, i.e. the buffers are reallocated. Without
+  // MPI 4 a regular allreduce is done.
+  int PersistentAllreduce(void* buffer, int64_t count, MPI_Datatype datatype,
+                          MPI_Op op, MPI_Comm comm, uint64_t buffer_generation);
+
+  // Starts the persistent allreduce of buffer without waiting for it, and
+  // sets request to wait on. Requires MPI 4.
+  int StartPersistentAllreduce(void* buffer, int count, MPI_Datatype datatype,
+                               MPI_Op op, MPI_Comm comm,
+                               uint64_t buffer_generation,
+                               MPI_Request& request);
+
+  // Completes the requests in flight first.
+  void FreePersistentRequests();
+
+  // Leaves the non-blocking collective issued for the entries in flight. Once
+  // it is done, on_complete runs, e.g. to copy the outputs out of the fusion
+  // buffer, and the entries are completed. buffer is the fusion buffer used
+  // by the collective, or null, and is kept alive until it completes.
+  void Enqueue(MPI_Request request, const std::vector<TensorTableEntry>& entries,
+               std::shared_ptr<PersistentBuffer> buffer,
+               std::function<void()> on_complete, std::string error_message,
+               Timeline& timeline);
+
+  // Completes the collectives that are done, or with wait all of them.
+  void Progress(bool wait);
+
+  // Completes the collectives still using the given fusion buffer, before it
+  // is overwritten.
+  void WaitForBuffer(const std::shared_ptr<PersistentBuffer>& buffer);
+
+  // Whether CPU collectives are started without waiting for them, set by
+  // HOROVOD_MPI_ASYNC.
+  bool async_collectives = false;
+
+  // Whether fusion buffers are allreduced with persistent requests, set by
+  // HOROVOD_MPI_PERSISTENT_COLLECTIVES.
+  bool persistent_collectives = false;
+
+  // Fusion buffer generation the persistent requests were created in.
+  uint64_t persistent_generation = 0;
+
+  std::map<std::tuple<void*, int64_t, MPI_Datatype, MPI_Op, MPI_Comm>,
+           MPI_Request>
+      persistent_requests;
+
   // Flag indicating whether mpi is enabled.
   bool enabled_ = false;
 
+  bool cuda_aware_ = true;
+
   // MPI custom data type for float16.
   MPI_Datatype mpi_float16_t;
   MPI_Op mpi_float16_sum;
+  MPI_Op mpi_float16_min;
+  MPI_Op mpi_float16_max;
+  MPI_Op mpi_float16_prod;
+
+  // MPI custom data type for bfloat16.
+  MPI_Datatype mpi_bfloat16_t;
+  MPI_Op mpi_bfloat16_sum;
+  MPI_Op mpi_bfloat16_min;
+  MPI_Op mpi_bfloat16_max;
+  MPI_Op mpi_bfloat16_prod;
 
   // Private MPI communicator for Horovod to ensure no collisions with other
   // threads using MPI.
   MPI_Comm mpi_comm;
 
+  // Duplicate of mpi_comm used by the controller when negotiation is
+  // pipelined with collective operations.
+  MPI_Comm control_comm = MPI_COMM_NULL;
+
   // Node-local communicator.
   MPI_Comm local_comm;
 
   // Cross-node communicator for hierarchical allreduce.
   MPI_Comm cross_comm;
 
+  // Communicators of the process sets this rank is a member of, by set id.
+  std::map<int32_t, MPI_Comm> process_set_comms;
+
   // MPI Window used for shared memory allgather
   MPI_Win window;
 
   // Whether mpi context should be finalize.
   bool should_finalize = false;
+
+private:
+  struct InFlightCollective {
+    MPI_Request request;
+    std::vector<TensorTableEntry> entries;
+    std::shared_ptr<PersistentBuffer> buffer;
+    std::function<void()> on_complete;
+    std::string error_message;
+    Timeline* timeline;
+  };
+
+  // Completes the collective, waiting for it if wait is true. Returns false
+  // if it is not done yet.
+  bool Complete(InFlightCollective& collective, bool wait);
+
+  // Collectives in the order they were issued. Operations may run on the
+  // execution thread while the background thread makes progress.
+  std::deque<InFlightCollective> in_flight_;
+  std::mutex in_flight_mutex_;
 };
 
+// Collectives whose counts and displacements, in elements of datatype, may
+// not fit in an int. Counts that fit are passed to the regular calls. With
+// MPI 4 larger ones use the large count variants, otherwise they are split
+// into calls of at most INT_MAX elements. Return MPI error codes like the
+// calls they replace.
+int MPILargeAllreduce(const void* sendbuf, void* recvbuf, int64_t count,
+                      MPI_Datatype datatype, MPI_Op op, MPI_Comm comm);
+
+int MPILargeReduce(const void* sendbuf, void* recvbuf, int64_t count,
+                   MPI_Datatype datatype, MPI_Op op, int root, MPI_Comm comm);
+
+int MPILargeBcast(void* buffer, int64_t count, MPI_Datatype datatype, int root,
+                  MPI_Comm comm);
+
+// Without MPI 4, blocks that do not fit are broadcast from each rank in
+// turn, all in flight at once.
+int MPILargeAllgatherv(const void* sendbuf, int64_t sendcount,
+                       MPI_Datatype datatype, void* recvbuf,
+                       const int64_t* recvcounts, const int64_t* displs,
+                       MPI_Comm comm);
+
 } // namespace common
 } // namespace horovod
 
@@ -15,6 +15,8 @@
 
 #include "mpi_controller.h"
 
+#include <algorithm>
+
 #include "../common.h"
 #include "../logging.h"
 
@@ -46,6 +48,9 @@ void MPIController::Initialize() {
   local_comm_ranks_[local_rank_] = rank_;
   MPI_Allgather(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, local_comm_ranks_.data(), 1,
                 MPI_INT, mpi_ctx_.local_comm);
+  local_ranks_ = std::vector<int>((size_t)size_);
+  MPI_Allgather(&local_rank_, 1, MPI_INT, local_ranks_.data(), 1, MPI_INT,
+                mpi_ctx_.mpi_comm);
 
   // Determine if cluster is homogeneous, i.e., if every node has the same
   // local_size
@@ -54,16 +59,20 @@ void MPIController::Initialize() {
                 mpi_ctx_.mpi_comm);
 
   is_homogeneous_ = true;
+  min_local_size_ = local_size_;
   for (int i = 0; i < size_; ++i) {
     if (local_sizes[i] != local_size_) {
       is_homogeneous_ = false;
-      break;
     }
+    min_local_size_ = std::min(min_local_size_, local_sizes[i]);
   }
 
   // Get cross-node rank and size in case of hierarchical allreduce.
   MPI_Comm_rank(mpi_ctx_.cross_comm, &cross_rank_);
   MPI_Comm_size(mpi_ctx_.cross_comm, &cross_size_);
+  cross_comm_ranks_ = std::vector<int>((size_t)cross_size_);
+  MPI_Allgather(&rank_, 1, MPI_INT, cross_comm_ranks_.data(), 1, MPI_INT,
+                mpi_ctx_.cross_comm);
 
   // Construct a shorter local sizes vector with length cross size.
   // e.g. For local_sizes = {4, 4, 4, 4, 3, 3, 3},
@@ -80,6 +89,26 @@ void MPIController::Initialize() {
   LOG(DEBUG) << "MPI controller initialized.";
 }
 
+bool MPIController::EnablePipelinedNegotiation() {
+  // Negotiation and collective operations are issued from different threads.
+  if (!mpi_threads_supported_) {
+    return false;
+  }
+  // Hierarchical negotiation uses the local and cross communicators, which
+  // are shared with hierarchical collective operations.
+  if (hierarchical_negotiation_) {
+    return false;
+  }
+  // Collectives from two threads must not interleave on one communicator.
+  MPI_Comm_dup(mpi_ctx_.mpi_comm, &mpi_ctx_.control_comm);
+  return true;
+}
+
+MPI_Comm MPIController::ControlComm() const {
+  return mpi_ctx_.control_comm != MPI_COMM_NULL ? mpi_ctx_.control_comm
+                                                : mpi_ctx_.mpi_comm;
+}
+
 int MPIController::GetTypeSize(DataType dtype) {
   return mpi_ctx_.GetMPITypeSize(dtype);
 }
@@ -87,7 +116,7 @@ int MPIController::GetTypeSize(DataType dtype) {
 void MPIController::CrossRankBitwiseAnd(std::vector<long long>& bitvector,
                                         int count) {
   int ret_code = MPI_Allreduce(MPI_IN_PLACE, bitvector.data(), count,
-                               MPI_LONG_LONG_INT, MPI_BAND, mpi_ctx_.mpi_comm);
+                               MPI_LONG_LONG_INT, MPI_BAND, ControlComm());
   if (ret_code != MPI_SUCCESS) {
     throw std::runtime_error(
         "MPI_AllReduce failed, see MPI output for details.");
@@ -97,7 +126,7 @@ void MPIController::CrossRankBitwiseAnd(std::vector<long long>& bitvector,
 void MPIController::CrossRankBitwiseOr(std::vector<long long>& bitvector,
                                        int count) {
   int ret_code = MPI_Allreduce(MPI_IN_PLACE, bitvector.data(), count,
-                               MPI_LONG_LONG_INT, MPI_BOR, mpi_ctx_.mpi_comm);
+                               MPI_LONG_LONG_INT, MPI_BOR, ControlComm());
   if (ret_code != MPI_SUCCESS) {
     throw std::runtime_error(
         "MPI_AllReduce failed, see MPI output for details.");
@@ -110,16 +139,112 @@ void MPIController::RecvReadyTensors(std::vector<std::string>& ready_to_reduce,
   // Now, it should count all the tensors that are coming from other
   // ranks at this tick.
 
+  // create a dummy list for rank 0
+  ready_list.emplace_back();
+
+  if (!hierarchical_negotiation_) {
+    RecvRequestLists(ControlComm(), ready_list);
+    return;
+  }
+
+  // Requests of the other ranks on this node, followed by the aggregated
+  // requests of every other node.
+  std::vector<RequestList> local_lists;
+  RecvRequestLists(mpi_ctx_.local_comm, local_lists);
+  RequestList node_list;
+  MergeRequestLists(local_lists, node_list);
+  ready_list.push_back(std::move(node_list));
+
+  RecvRequestLists(mpi_ctx_.cross_comm, ready_list);
+}
+
+void MPIController::SendFinalTensors(ResponseList& response_list) {
+  // Notify all nodes which tensors we'd like to reduce at this step.
+  std::string encoded_response;
+  ResponseList::SerializeToString(response_list, encoded_response);
+
+  if (!hierarchical_negotiation_) {
+    BcastEncoded(encoded_response, ControlComm());
+    return;
+  }
+
+  // Send to the node leaders, which forward to their local ranks.
+  BcastEncoded(encoded_response, mpi_ctx_.cross_comm);
+  BcastEncoded(encoded_response, mpi_ctx_.local_comm);
+}
+
+void MPIController::SendReadyTensors(RequestList& message_list) {
+  if (!hierarchical_negotiation_) {
+    SendRequestList(message_list, ControlComm());
+    return;
+  }
+
+  if (local_rank_ != 0) {
+    SendRequestList(message_list, mpi_ctx_.local_comm);
+    return;
+  }
+
+  // Node leader aggregates the requests of its local ranks before sending
+  // them to the coordinator.
+  std::vector<RequestList> local_lists;
+  RecvRequestLists(mpi_ctx_.local_comm, local_lists);
+  MergeRequestLists(local_lists, message_list);
+  SendRequestList(message_list, mpi_ctx_.cross_comm);
+}
+
+void MPIController::RecvFinalTensors(ResponseList& response_list) {
+  std::string encoded_response;
+  if (!hierarchical_negotiation_) {
+    BcastEncoded(encoded_response, ControlComm());
+  } else {
+    if (local_rank_ == 0) {
+      BcastEncoded(encoded_response, mpi_ctx_.cross_comm);
+    }
+    BcastEncoded(encoded_response, mpi_ctx_.local_comm);
+  }
+  ResponseList::ParseFromBytes(response_list,
+                               (const uint8_t*)encoded_response.c_str());
+}
+
+bool MPIController::EnableHierarchicalNegotiation() {
+  hierarchical_negotiation_ = true;
+  return true;
+}
+
+void MPIController::SendRequestList(RequestList& message_list,
+                                    MPI_Comm comm) {
+  std::string encoded_message;
+  RequestList::SerializeToString(message_list, encoded_message);
+  int encoded_message_length = (int)encoded_message.length() + 1;
+  int ret_code = MPI_Gather(&encoded_message_length, 1, MPI_INT, nullptr, 1,
+                            MPI_INT, RANK_ZERO, comm);
+  if (ret_code != MPI_SUCCESS) {
+    throw std::runtime_error("MPI_Gather failed, see MPI output for details.");
+  }
+
+  ret_code = MPI_Gatherv((void*)encoded_message.c_str(), encoded_message_length,
+                         MPI_BYTE, nullptr, nullptr, nullptr, MPI_BYTE,
+                         RANK_ZERO, comm);
+  if (ret_code != MPI_SUCCESS) {
+    throw std::runtime_error("MPI_Gather failed, see MPI output for details.");
+  }
+}
+
+void MPIController::RecvRequestLists(MPI_Comm comm,
+                                     std::vector<RequestList>& lists) {
+  int comm_size;
+  MPI_Comm_size(comm, &comm_size);
+
   // 1. Get message lengths from every rank.
-  auto recvcounts = new int[size_];
+  auto recvcounts = new int[comm_size];
   recvcounts[0] = 0;
   MPI_Gather(MPI_IN_PLACE, 1, MPI_INT, recvcounts, 1, MPI_INT, RANK_ZERO,
-             mpi_ctx_.mpi_comm);
+             comm);
 
   // 2. Compute displacements.
-  auto displcmnts = new int[size_];
+  auto displcmnts = new int[comm_size];
   size_t total_size = 0;
-  for (int i = 0; i < size_; ++i) {
+  for (int i = 0; i < comm_size; ++i) {
     if (i == 0) {
       displcmnts[i] = 0;
     } else {
@@ -131,16 +256,14 @@ void MPIController::RecvReadyTensors(std::vector<std::string>& ready_to_reduce,
   // 3. Collect messages from every rank.
   auto buffer = new uint8_t[total_size];
   MPI_Gatherv(nullptr, 0, MPI_BYTE, buffer, recvcounts, displcmnts, MPI_BYTE,
-              RANK_ZERO, mpi_ctx_.mpi_comm);
+              RANK_ZERO, comm);
 
   // 4. Process messages.
-  // create a dummy list for rank 0
-  ready_list.emplace_back();
-  for (int i = 1; i < size_; ++i) {
+  for (int i = 1; i < comm_size; ++i) {
     auto rank_buffer_ptr = buffer + displcmnts[i];
     RequestList received_message_list;
     RequestList::ParseFromBytes(received_message_list, rank_buffer_ptr);
-    ready_list.push_back(std::move(received_message_list));
+    lists.push_back(std::move(received_message_list));
   }
 
   // 5. Free buffers.
@@ -149,53 +272,38 @@ void MPIController::RecvReadyTensors(std::vector<std::string>& ready_to_reduce,
   delete[] buffer;
 }
 
-void MPIController::SendFinalTensors(ResponseList& response_list) {
-  // Notify all nodes which tensors we'd like to reduce at this step.
-  std::string encoded_response;
-  ResponseList::SerializeToString(response_list, encoded_response);
-  int encoded_response_length = (int)encoded_response.length() + 1;
-  MPI_Bcast(&encoded_response_length, 1, MPI_INT, RANK_ZERO, mpi_ctx_.mpi_comm);
-
-  MPI_Bcast((void*)encoded_response.c_str(), encoded_response_length, MPI_BYTE,
-            RANK_ZERO, mpi_ctx_.mpi_comm);
-}
-
-void MPIController::SendReadyTensors(RequestList& message_list) {
-  std::string encoded_message;
-  RequestList::SerializeToString(message_list, encoded_message);
-  int encoded_message_length = (int)encoded_message.length() + 1;
-  int ret_code = MPI_Gather(&encoded_message_length, 1, MPI_INT, nullptr, 1,
-                            MPI_INT, RANK_ZERO, mpi_ctx_.mpi_comm);
-  if (ret_code != MPI_SUCCESS) {
-    throw std::runtime_error("MPI_Gather failed, see MPI output for details.");
-  }
-
-  ret_code = MPI_Gatherv((void*)encoded_message.c_str(), encoded_message_length,
-                         MPI_BYTE, nullptr, nullptr, nullptr, MPI_BYTE,
-                         RANK_ZERO, mpi_ctx_.mpi_comm);
-  if (ret_code != MPI_SUCCESS) {
-    throw std::runtime_error("MPI_Gather failed, see MPI output for details.");
+void MPIController::MergeRequestLists(const std::vector<RequestList>& lists,
+                                      RequestList& merged) {
+  for (auto& list : lists) {
+    for (auto& request : list.requests()) {
+      merged.add_request(request);
+    }
+    if (list.shutdown()) {
+      merged.set_shutdown(true);
+    }
   }
 }
 
-void MPIController::RecvFinalTensors(ResponseList& response_list) {
-  int msg_length;
-  int ret_code =
-      MPI_Bcast(&msg_length, 1, MPI_INT, RANK_ZERO, mpi_ctx_.mpi_comm);
+void MPIController::BcastEncoded(std::string& encoded, MPI_Comm comm) {
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  int encoded_length = (int)encoded.length();
+  int ret_code = MPI_Bcast(&encoded_length, 1, MPI_INT, RANK_ZERO, comm);
   if (ret_code != MPI_SUCCESS) {
     throw std::runtime_error(
         "MPI_Broadcast failed, see MPI output for details.");
   }
 
-  auto buffer = new uint8_t[msg_length];
-  ret_code =
-      MPI_Bcast(buffer, msg_length, MPI_BYTE, RANK_ZERO, mpi_ctx_.mpi_comm);
+  if (rank != RANK_ZERO) {
+    encoded.resize(encoded_length);
+  }
+  // std::string storage is contiguous. Its terminator is not sent, since it
+  // must not be written.
+  ret_code = MPI_Bcast(&encoded[0], encoded_length, MPI_BYTE, RANK_ZERO, comm);
   if (ret_code != MPI_SUCCESS) {
     throw std::runtime_error(
         "MPI_Broadcast failed, see MPI output for details.");
   }
-  ResponseList::ParseFromBytes(response_list, buffer);
-  delete[] buffer;
 }
 
 void MPIController::Bcast(void* buffer, size_t size, int root_rank,
@@ -57,13 +57,37 @@ public:
 
   void Barrier(Communicator communicator) override;
 
+  bool EnablePipelinedNegotiation() override;
+
+  bool EnableHierarchicalNegotiation() override;
+
   bool IsMpiThreadsSupported() const { return mpi_threads_supported_; }
 
 protected:
+  // Communicator used for negotiation.
+  MPI_Comm ControlComm() const;
+
+  // Send a request list to rank zero of the communicator.
+  void SendRequestList(RequestList& message_list, MPI_Comm comm);
+
+  // On rank zero of the communicator, receive the request lists sent by all
+  // other ranks and append them in rank order.
+  void RecvRequestLists(MPI_Comm comm, std::vector<RequestList>& lists);
+
+  void MergeRequestLists(const std::vector<RequestList>& lists,
+                         RequestList& merged);
+
+  // Broadcast a serialized message from rank zero of the communicator.
+  void BcastEncoded(std::string& encoded, MPI_Comm comm);
+
   MPIContext& mpi_ctx_;
 
   // flag indicating whether MPI multi-threading is supported
   bool mpi_threads_supported_ = false;
+
+  // Whether requests are aggregated per node by local rank zero before being
+  // sent to the coordinator.
+  bool hierarchical_negotiation_ = false;
 };
 
 } // namespace common
@@ -18,11 +18,14 @@
 
 #include "operations.h"
 
+#include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cstring>
 #include <map>
 #include <queue>
+#include <regex>
 #include <set>
 #include <sstream>
 #include <thread>
@@ -45,6 +48,7 @@
 #include "mpi.h"
 #include "mpi/mpi_context.h"
 #include "mpi/mpi_controller.h"
+#include "ops/adasum_operations.h"
 #include "ops/mpi_operations.h"
 #endif
 
@@ -53,6 +57,9 @@
 #if HAVE_MPI
 #include "ops/mpi_cuda_operations.h"
 #endif
+#if HAVE_GLOO
+#include "ops/gloo_cuda_operations.h"
+#endif
 #endif
 
 #if HAVE_NCCL
@@ -94,6 +101,14 @@
  *      - HorovodBroadcast:
  *          Perform a broadcast on a Tensor, broadcasting Tensor
  *          value from root rank to all other ranks.
+ *      - HorovodReducescatter:
+ *          Perform a reduce-scatter on a Tensor, returning the slice of the
+ *          sum across all processes along the first dimension that belongs
+ *          to this process.
+ *      - HorovodAlltoall:
+ *          Perform an alltoall on a Tensor, sending consecutive slices of
+ *          the first dimension to every process and returning the
+ *          concatenation of the slices received from all processes.
  *
  * Additionally, this library provides C APIs to initialize Horovod and query
  * rank, local rank and world size.  These are used in Python directly through
@@ -139,12 +154,42 @@ OperationManager* CreateOperationManager(HorovodGlobalState& state) {
   // sequentially from the first to the last. The first 'Enabled' operation will
   // be executed.
   std::vector<std::shared_ptr<AllreduceOp>> allreduce_ops;
+  std::vector<std::shared_ptr<AllreduceOp>> adasum_ops;
   std::vector<std::shared_ptr<AllgatherOp>> allgather_ops;
   std::vector<std::shared_ptr<BroadcastOp>> broadcast_ops;
+  std::vector<std::shared_ptr<ReducescatterOp>> reducescatter_ops;
+  std::vector<std::shared_ptr<AlltoallOp>> alltoall_ops;
+
+#if HAVE_NCCL && HOROVOD_GPU_ALLGATHER == 'N'
+  allgather_ops.push_back(std::shared_ptr<AllgatherOp>(
+      new NCCLHierarchicalAllgather(&nccl_context, &cuda_context, &state)));
+  allgather_ops.push_back(std::shared_ptr<AllgatherOp>(
+      new NCCLAllgather(&nccl_context, &cuda_context, &state)));
+#endif
+
+#if HAVE_NCCL && HOROVOD_GPU_BROADCAST == 'N'
+  broadcast_ops.push_back(std::shared_ptr<BroadcastOp>(
+      new NCCLBroadcast(&nccl_context, &cuda_context, &state)));
+#endif
+
+#if HAVE_GLOO && HAVE_CUDA && HOROVOD_GPU_ALLREDUCE == 'G'
+  // GPU tensors are staged through host memory for Gloo, or for MPI when it
+  // is not enabled.
+  if (gloo_context.IsEnabled()) {
+    allreduce_ops.push_back(std::shared_ptr<AllreduceOp>(
+        new GlooCUDAAllreduce(&gloo_context, &cuda_context, &state)));
+  }
+#endif
 
 #if HAVE_MPI && HAVE_CUDA
   if (mpi_context.IsEnabled()) {
-#if HOROVOD_GPU_ALLREDUCE == 'M'
+#if HAVE_NCCL && HOROVOD_GPU_ALLREDUCE == 'N'
+    adasum_ops.push_back(
+        std::shared_ptr<AllreduceOp>(new AdasumNCCLHierarchicalAllreduce(
+            &nccl_context, &mpi_context, &cuda_context, &state)));
+#endif
+
+#if HOROVOD_GPU_ALLREDUCE == 'M' || HOROVOD_GPU_ALLREDUCE == 'G'
     allreduce_ops.push_back(std::shared_ptr<AllreduceOp>(
         new MPI_CUDAAllreduce(&mpi_context, &cuda_context, &state)));
 
@@ -165,16 +210,30 @@ OperationManager* CreateOperationManager(HorovodGlobalState& state) {
 #if HAVE_NCCL && HOROVOD_GPU_ALLREDUCE == 'N'
   allreduce_ops.push_back(std::shared_ptr<AllreduceOp>(
       new NCCLAllreduce(&nccl_context, &cuda_context, &state)));
+  reducescatter_ops.push_back(std::shared_ptr<ReducescatterOp>(
+      new NCCLReducescatter(&nccl_context, &cuda_context, &state)));
+  alltoall_ops.push_back(std::shared_ptr<AlltoallOp>(
+      new NCCLAlltoall(&nccl_context, &cuda_context, &state)));
 #endif
 
 #if HAVE_GLOO
   if (gloo_context.IsEnabled()) {
+    allreduce_ops.push_back(std::shared_ptr<AllreduceOp>(
+        new GlooQuantizedAllreduce(&gloo_context, &state)));
+    allreduce_ops.push_back(std::shared_ptr<AllreduceOp>(
+        new GlooSparseAllreduce(&gloo_context, &state)));
+    allreduce_ops.push_back(std::shared_ptr<AllreduceOp>(
+        new GlooHierarchicalAllreduce(&gloo_context, &state)));
     allreduce_ops.push_back(
         std::shared_ptr<AllreduceOp>(new GlooAllreduce(&gloo_context, &state)));
     allgather_ops.push_back(
         std::shared_ptr<AllgatherOp>(new GlooAllgather(&gloo_context, &state)));
     broadcast_ops.push_back(
         std::shared_ptr<BroadcastOp>(new GlooBroadcast(&gloo_context, &state)));
+    reducescatter_ops.push_back(std::shared_ptr<ReducescatterOp>(
+        new GlooReducescatter(&gloo_context, &state)));
+    alltoall_ops.push_back(
+        std::shared_ptr<AlltoallOp>(new GlooAlltoall(&gloo_context, &state)));
   }
 #endif
 
@@ -191,34 +250,235 @@ OperationManager* CreateOperationManager(HorovodGlobalState& state) {
 
 #if HAVE_MPI
   if (mpi_context.IsEnabled()){
+    adasum_ops.push_back(std::shared_ptr<AllreduceOp>(
+        new AdasumMPIAllreduce(&mpi_context, &state)));
+    allreduce_ops.push_back(std::shared_ptr<AllreduceOp>(
+        new MPIQuantizedAllreduce(&mpi_context, &state)));
+    allreduce_ops.push_back(std::shared_ptr<AllreduceOp>(
+        new MPISparseAllreduce(&mpi_context, &state)));
+    allreduce_ops.push_back(std::shared_ptr<AllreduceOp>(
+        new MPIHierarchicalAllreduce(&mpi_context, &state)));
     allreduce_ops.push_back(
         std::shared_ptr<AllreduceOp>(new MPIAllreduce(&mpi_context,&state)));
     allgather_ops.push_back(
         std::shared_ptr<AllgatherOp>(new MPIAllgather(&mpi_context, &state)));
+    broadcast_ops.push_back(std::shared_ptr<BroadcastOp>(
+        new MPIPipelinedBroadcast(&mpi_context, &state)));
     broadcast_ops.push_back(
         std::shared_ptr<BroadcastOp>(new MPIBroadcast(&mpi_context, &state)));
+    reducescatter_ops.push_back(std::shared_ptr<ReducescatterOp>(
+        new MPIReducescatter(&mpi_context, &state)));
+    alltoall_ops.push_back(
+        std::shared_ptr<AlltoallOp>(new MPIAlltoall(&mpi_context, &state)));
+  }
+#endif
+
+  // Allreduces within process sets run on communicators of their own, over
+  // MPI or Gloo. GPU tensors are staged through host memory if the library
+  // cannot access them.
+  std::vector<std::shared_ptr<AllreduceOp>> process_set_ops;
+#if HAVE_MPI && HAVE_CUDA
+  if (mpi_context.IsEnabled()) {
+    process_set_ops.push_back(std::shared_ptr<AllreduceOp>(
+        new MPI_CUDAAllreduce(&mpi_context, &cuda_context, &state)));
+  }
+#endif
+#if HAVE_GLOO && HAVE_CUDA
+  if (gloo_context.IsEnabled()) {
+    process_set_ops.push_back(std::shared_ptr<AllreduceOp>(
+        new GlooCUDAAllreduce(&gloo_context, &cuda_context, &state)));
+  }
+#endif
+#if HAVE_MPI
+  if (mpi_context.IsEnabled()) {
+    process_set_ops.push_back(
+        std::shared_ptr<AllreduceOp>(new MPIAllreduce(&mpi_context, &state)));
+  }
+#endif
+#if HAVE_GLOO
+  if (gloo_context.IsEnabled()) {
+    process_set_ops.push_back(
+        std::shared_ptr<AllreduceOp>(new GlooAllreduce(&gloo_context, &state)));
   }
 #endif
 
   std::shared_ptr<ErrorOp> error_op(new ErrorOp(&state));
 
-  return new OperationManager(&state.parameter_manager, allreduce_ops,
-                              allgather_ops, broadcast_ops, error_op);
+  return new OperationManager(&state.parameter_manager, &state.metrics,
+                              allreduce_ops,
+                              adasum_ops, allgather_ops, broadcast_ops, reducescatter_ops,
+                              alltoall_ops, process_set_ops, error_op);
 }
 
-// Process a Response by doing a reduction, a gather, a broadcast, or
-// raising an error.
+// Process a Response by doing a reduction, a gather, a broadcast, a
+// reduce-scatter, an alltoall, raising an error, or releasing the ranks that
+// joined.
 void PerformOperation(Response response) {
   std::vector<TensorTableEntry> entries;
-  horovod_global.tensor_queue.GetTensorEntriesFromResponse(response, entries);
+  auto& tensor_queue = horovod_global.tensor_queue;
+  if (response.response_type() == Response::JOIN) {
+    tensor_queue.GetTensorEntriesFromResponse(response, entries);
+    for (auto& e : entries) {
+      e.callback(Status::OK());
+    }
+    return;
+  }
+  if (response.process_set_id() != 0) {
+    // Only the members of a process set perform its responses, and errors
+    // are reported to the ranks that enqueued the tensors.
+    if (response.response_type() == Response::ERROR) {
+      std::vector<std::string> names;
+      for (auto& name : response.tensor_names()) {
+        if (tensor_queue.HasTensor(name)) {
+          names.push_back(name);
+        }
+      }
+      if (names.empty()) {
+        return;
+      }
+      response.set_tensor_names(names);
+    } else {
+      auto process_set =
+          horovod_global.process_sets.Get(response.process_set_id());
+      if (process_set == nullptr || process_set->rank < 0) {
+        return;
+      }
+
+      // The coordinator fuses the tensors of a set without knowing their
+      // scale factors, so the members split the response where they change.
+      std::vector<Response> parts;
+      std::pair<double, double> factors;
+      for (auto& name : response.tensor_names()) {
+        auto& entry = tensor_queue.GetTensorEntry(name);
+        auto entry_factors =
+            std::make_pair(entry.prescale_factor, entry.postscale_factor);
+        if (parts.empty() || entry_factors != factors) {
+          parts.push_back(response);
+          parts.back().set_tensor_names({});
+          factors = entry_factors;
+        }
+        parts.back().add_tensor_name(name);
+      }
+      if (parts.size() > 1) {
+        for (auto& part : parts) {
+          PerformOperation(std::move(part));
+        }
+        return;
+      }
+    }
+  }
+  auto& absent_ranks = response.absent_ranks();
+  bool absent = std::find(absent_ranks.begin(), absent_ranks.end(),
+                          horovod_global.controller->GetRank()) !=
+                absent_ranks.end();
+  if (absent && response.joined()) {
+    // This rank joined. It takes part with zeros on the device it joined
+    // with, and has no tensors to report an error to.
+    if (response.response_type() == Response::ERROR) {
+      return;
+    }
+    // The other ranks are about to start the collective, and would wait for
+    // this rank forever.
+    Status status = tensor_queue.GetJoinedEntries(response, entries);
+    if (!status.ok()) {
+      LOG(FATAL, horovod_global.controller->GetRank())
+          << "Rank joined but cannot take part in "
+          << response.tensor_names_string() << ": " << status.reason();
+    }
+  } else if (absent) {
+    // This rank was left out of a partial allreduce. It takes part with
+    // zeros and keeps the result for its late tensors, and has no tensors to
+    // report an error to.
+    if (response.response_type() != Response::ALLREDUCE) {
+      return;
+    }
+    Status status = tensor_queue.GetStaleEntries(response, entries);
+    if (!status.ok()) {
+      LOG(FATAL, horovod_global.controller->GetRank())
+          << "Rank cannot take part in the partial allreduce of "
+          << response.tensor_names_string() << ": " << status.reason();
+    }
+  } else {
+    // Errors negotiated while ranks are joined name groups as a whole, since
+    // the coordinator may not have their tensors.
+    if (response.response_type() == Response::ERROR && !absent_ranks.empty()) {
+      std::vector<std::string> names;
+      for (auto& name : response.tensor_names()) {
+        std::vector<std::string> group_tensor_names;
+        if (tensor_queue.GetGroupTensorNames(name, group_tensor_names)) {
+          names.insert(names.end(), group_tensor_names.begin(),
+                       group_tensor_names.end());
+        } else {
+          names.push_back(name);
+        }
+      }
+      response.set_tensor_names(names);
+    }
+    tensor_queue.GetTensorEntriesFromResponse(response, entries);
+    if (tensor_queue.StalenessEnabled() &&
+        response.response_type() == Response::ALLREDUCE) {
+      tensor_queue.FoldLateTensors(entries);
+    }
+  }
+  if (response.contributions() > 0) {
+    // Scale the sum of the tensors that arrived as if all ranks contributed
+    // one.
+    double factor = (double)horovod_global.controller->GetSize() /
+                    response.contributions();
+    for (auto& e : entries) {
+      e.postscale_factor *= factor;
+    }
+  }
 
   auto& timeline = horovod_global.timeline;
   for (auto& e : entries) {
     timeline.Start(e.tensor_name, response.response_type());
   }
 
+#if HAVE_CUDA
+  // Spread GPU responses over the NCCL streams, so that independent
+  // collectives run concurrently on their own streams and communicators.
+  // Allgather and alltoall move a different number of bytes on every rank and
+  // are not weighted, to keep the choice the same on all ranks, and responses
+  // of process sets are not recorded, since only their members see them.
+  // Urgent allreduces use the stream reserved for them.
+  if (!entries.empty() && entries[0].device != CPU_DEVICE_ID) {
+    if (horovod_global.urgent_nccl_stream >= 0 &&
+        horovod_global.controller->IsUrgent(response.response_type(),
+                                            entries[0])) {
+      horovod_global.current_nccl_stream = horovod_global.urgent_nccl_stream;
+    } else {
+      int64_t bytes = 0;
+      if (response.response_type() != Response::ALLGATHER &&
+          response.response_type() != Response::ALLTOALL) {
+        for (auto& e : entries) {
+          bytes += e.tensor->size();
+        }
+      }
+      horovod_global.current_nccl_stream = cuda_context.PickStream(
+          bytes, horovod_global.parameter_manager.NumNCCLStreams(),
+          response.process_set_id() == 0);
+    }
+  }
+#endif
+
   if (entries.size() > 1) {
     auto first_entry = entries[0];
+    // Under a memory budget, a stream whose buffers do not fit runs on a
+    // stream that has some.
+    if (first_entry.device != CPU_DEVICE_ID) {
+      horovod_global.current_nccl_stream =
+          horovod_global.fusion_buffer.ResolveStream(
+              horovod_global.controller->TensorFusionThresholdBytes(),
+              first_entry.device, first_entry.context->framework(),
+              horovod_global.current_nccl_stream,
+              response.process_set_id() == 0);
+    }
+    // Use the next buffer of the ring, so that a collective still in flight
+    // on the previous one is not overwritten.
+    horovod_global.fusion_buffer.NextSlot(first_entry.device,
+                                          first_entry.context->framework(),
+                                          horovod_global.current_nccl_stream);
     // Note: it is OK for different entries to come from different frameworks
     // since buffer allocated here is guaranteed to survive at least till the
     // end of this operation.
@@ -237,14 +497,35 @@ void PerformOperation(Response response) {
     }
   }
 
-  // On GPU data readiness is signalled by ready_event.
+  // On GPU data readiness is signalled by ready_event. NCCL allreduce can
+  // instead make its stream wait for the event, so the host does not block.
+  // Other operations, such as the MPI and Gloo ones staging GPU tensors
+  // through host memory, still need the host to wait.
+#if HAVE_NCCL && HOROVOD_GPU_ALLREDUCE == 'N'
+  bool stream_waits = horovod_global.stream_wait_ready_events &&
+                 response.response_type() == Response::ALLREDUCE &&
+                 op_manager->AllreduceWaitsForReadyEvents(entries, response);
+#endif
+  auto host_waits = [&](const TensorTableEntry& e) {
+    if (e.ready_event == nullptr) {
+      return false;
+    }
+#if HAVE_NCCL && HOROVOD_GPU_ALLREDUCE == 'N'
+    if (stream_waits && e.ready_event->CudaEvent() != nullptr) {
+      return false;
+    }
+#endif
+    return true;
+  };
   std::vector<TensorTableEntry> waiting_tensors;
   for (auto& e : entries) {
-    if (e.ready_event != nullptr) {
+    if (host_waits(e)) {
       timeline.ActivityStart(e.tensor_name, WAIT_FOR_DATA);
       waiting_tensors.push_back(e);
     }
   }
+  bool waited = !waiting_tensors.empty();
+  auto wait_start = std::chrono::steady_clock::now();
   while (!waiting_tensors.empty()) {
     for (auto it = waiting_tensors.begin(); it != waiting_tensors.end();) {
       if (it->ready_event->Ready()) {
@@ -255,20 +536,49 @@ void PerformOperation(Response response) {
         ++it;
       }
     }
-    std::this_thread::sleep_for(std::chrono::nanoseconds(100));
+    if (!horovod_global.busy_poll) {
+      std::this_thread::sleep_for(std::chrono::nanoseconds(100));
+    }
   }
   for (auto& e : entries) {
-    if (e.ready_event != nullptr) {
+    if (host_waits(e)) {
       timeline.ActivityEnd(e.tensor_name);
     }
   }
 
+  auto& metrics = horovod_global.metrics;
+  if (waited) {
+    metrics.wait_for_data_time_us.Observe(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - wait_start).count());
+  }
+  int64_t total_bytes = 0;
+  for (auto& e : entries) {
+    total_bytes += e.tensor->size();
+  }
+  if ((int)response.response_type() < Metrics::NUM_RESPONSE_TYPES) {
+    metrics.collectives[response.response_type()].Add();
+  }
+  metrics.collective_bytes_total.Add(total_bytes);
+  metrics.collective_bytes.Observe(total_bytes);
+  if (entries.size() > 1) {
+    auto threshold = horovod_global.controller->TensorFusionThresholdBytes();
+    if (threshold > 0) {
+      metrics.fusion_buffer_fill_percent.Observe(total_bytes * 100 /
+                                                 threshold);
+    }
+  }
+
   Status status;
+  auto execute_start = std::chrono::steady_clock::now();
   try {
     status = op_manager->ExecuteOperation(entries, response);
   } catch (const std::exception& ex) {
     status = Status::UnknownError(ex.what());
   }
+  metrics.collective_time_us.Observe(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - execute_start).count());
 
   if (!status.in_progress()) {
     for (auto& e : entries) {
@@ -278,6 +588,56 @@ void PerformOperation(Response response) {
   }
 }
 
+// Align the timeline clock of every rank to the coordinator's, so that
+// per-rank timeline shards can be merged. Ranks leave the barrier at nearly
+// the same time and then adopt the coordinator's time since start, which is
+// accurate to within the skew of leaving the barrier.
+void SynchronizeTimelineClocks(HorovodGlobalState& state) {
+  auto& controller = state.controller;
+  // The first barrier absorbs ranks arriving at different times.
+  controller->Barrier(Communicator::GLOBAL);
+  controller->Barrier(Communicator::GLOBAL);
+  auto barrier_exit = std::chrono::steady_clock::now();
+  long root_micros = state.timeline.TimeSinceStartMicros();
+  controller->Bcast(&root_micros, sizeof(root_micros), 0, Communicator::GLOBAL);
+  if (!controller->IsCoordinator()) {
+    auto since_exit = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - barrier_exit);
+    state.timeline.SetTimeSinceStartMicros(root_micros + since_exit.count());
+  }
+}
+
+// Times the steps of initializing or resetting the background thread, each
+// from the end of the previous one.
+class InitTimer {
+public:
+  void Step(const std::string& name) {
+    auto now = std::chrono::steady_clock::now();
+    steps_.emplace_back(name,
+                        std::chrono::duration<double>(now - last_).count());
+    last_ = now;
+  }
+
+  // Publishes the steps and their total through the metrics.
+  void Finish(HorovodGlobalState& state) {
+    double total = 0;
+    std::stringstream breakdown;
+    for (auto& step : steps_) {
+      total += step.second;
+      breakdown << " " << step.first << "=" << step.second << "s";
+    }
+    steps_.emplace_back("total", total);
+    LOG(DEBUG, state.controller->GetRank())
+        << "Initialization took " << total << "s:" << breakdown.str();
+    state.metrics.init_seconds.Set(std::move(steps_));
+  }
+
+private:
+  std::chrono::steady_clock::time_point last_ =
+      std::chrono::steady_clock::now();
+  std::vector<std::pair<std::string, double>> steps_;
+};
+
 // The background thread loop coordinates all the controller processes and the
 // tensor reductions. The design of the communicator mechanism is limited by a
 // few considerations:
@@ -300,11 +660,72 @@ void PerformOperation(Response response) {
 //      progress if we have a thread pool limit.
 bool RunLoopOnce(HorovodGlobalState& state);
 
+void ExecutionThreadLoop(HorovodGlobalState& state);
+
+// Splits the CPUs of HOROVOD_THREAD_AFFINITY evenly between the local ranks,
+// in local rank order. With fewer CPUs than local ranks, ranks get one CPU
+// each and share them.
+std::vector<int> LocalRankCpus(const std::vector<int>& cpus, int local_rank,
+                               int local_size) {
+  if (cpus.empty()) {
+    return cpus;
+  }
+  if ((int)cpus.size() < local_size) {
+    return {cpus[local_rank % cpus.size()]};
+  }
+  size_t begin = cpus.size() * local_rank / local_size;
+  size_t end = cpus.size() * (local_rank + 1) / local_size;
+  return std::vector<int>(cpus.begin() + begin, cpus.begin() + end);
+}
+
+// CPUs of the threads other than the background thread.
+std::vector<int> HelperCpus(const HorovodGlobalState& state) {
+  if (state.thread_cpus.size() <= 1) {
+    return state.thread_cpus;
+  }
+  return std::vector<int>(state.thread_cpus.begin() + 1,
+                          state.thread_cpus.end());
+}
+
+// CPUs of the workers of the negotiation and fusion memcpy thread pools. The
+// execution thread, the CUDA finalizer and the GPU enqueue worker take the
+// first three helper CPUs, or share the first one when there are fewer. Empty
+// if the rank has no CPU besides that of the background thread.
+std::vector<int> PoolCpus(const HorovodGlobalState& state) {
+  if (state.thread_cpus.size() <= 1) {
+    return {};
+  }
+  auto cpus = HelperCpus(state);
+  size_t reserved = cpus.size() > 3 ? 3 : (cpus.size() > 1 ? 1 : 0);
+  return std::vector<int>(cpus.begin() + reserved, cpus.end());
+}
+
+// Number of threads, the background thread included, of a pool configured
+// with num_threads by env_name. Pinned pools without a CPU of their own would
+// only compete with the background thread, so they are not created.
+int PoolThreads(const HorovodGlobalState& state, int num_threads,
+                const char* env_name) {
+  if (num_threads > 1 && !state.thread_cpus.empty() &&
+      PoolCpus(state).empty()) {
+    LOG(WARNING, state.controller->GetRank())
+        << env_name << " is ignored, since " << HOROVOD_THREAD_AFFINITY
+        << " leaves no CPU for the workers besides that of the background "
+           "thread.";
+    return 1;
+  }
+  return num_threads;
+}
+
+bool ResetMembership(HorovodGlobalState& state);
+
 void BackgroundThreadLoop(HorovodGlobalState& state) {
+  InitTimer init_timer;
+
   // Initialize mlsl context
 #if HAVE_MLSL
   if (state.cpu_operation == LibType::MLSL) {
     mlsl_context.Init();
+    init_timer.Step("mlsl");
   }
 #endif
 
@@ -318,6 +739,7 @@ void BackgroundThreadLoop(HorovodGlobalState& state) {
   auto mpi_ctx_manager = MPIContextManager();
 #endif
   mpi_context.Initialize(state.controller->GetRanks(), mpi_ctx_manager);
+  init_timer.Step("mpi");
 #endif
 
 #if HAVE_GLOO
@@ -331,49 +753,186 @@ void BackgroundThreadLoop(HorovodGlobalState& state) {
     {
       gloo_context.Initialize(ParseGlooIface());
     }
+    init_timer.Step("gloo");
 #endif
 
   // Initialize controller
   state.controller->Initialize();
+  init_timer.Step("controller");
+
+  // Map the shared memory arena of the ranks on this node, which CPU
+  // hierarchical collectives exchange data through.
+  bool shared_memory_disabled = false;
+  SetBoolFromEnv(HOROVOD_SHARED_MEMORY_DISABLE, shared_memory_disabled, true);
+  if (!shared_memory_disabled) {
+    state.shared_memory.Initialize(*state.controller);
+  }
+  init_timer.Step("shared_memory");
 
   bool is_coordinator = state.controller->IsCoordinator();
   bool is_homogeneous = state.controller->IsHomogeneous();
   int size = state.controller->GetSize();
   int local_size = state.controller->GetLocalSize();
 
+  // Pin the background thread, and the threads started below, to the CPUs
+  // given for this rank.
+  auto horovod_thread_affinity = std::getenv(HOROVOD_THREAD_AFFINITY);
+  if (horovod_thread_affinity != nullptr) {
+    state.thread_cpus =
+        LocalRankCpus(ParseCpuList(horovod_thread_affinity),
+                      state.controller->GetLocalRank(), local_size);
+    if (state.thread_cpus.empty() ||
+        !PinCurrentThread(state.thread_cpus[0])) {
+      LOG(WARNING, state.controller->GetRank())
+          << "Could not pin the background thread to the CPUs "
+          << horovod_thread_affinity << ".";
+      state.thread_cpus.clear();
+    }
+  }
+  SetBoolFromEnv(HOROVOD_BUSY_POLL, state.busy_poll, true);
+
 #if HAVE_MLSL
   mlsl_context.Setup(size);
 #endif
 
+  // Allreduce small tensors, e.g. loss scalars, ahead of gradient buckets.
+  int64_t urgent_threshold = GetIntEnvOrDefault(HOROVOD_URGENT_THRESHOLD, 0);
+  state.controller->SetUrgentThresholdBytes(urgent_threshold);
+
+  // Check the requests of newly ready tensors on several threads of the
+  // coordinator.
+  if (is_coordinator) {
+    state.controller->SetNegotiationThreads(
+        PoolThreads(state, GetIntEnvOrDefault(HOROVOD_NEGOTIATION_THREADS, 0),
+                    HOROVOD_NEGOTIATION_THREADS),
+        PoolCpus(state));
+  }
+
+  // Sum allreduces of host tensors locally over this many steps.
+  state.tensor_queue.SetAccumulationSteps(
+      std::max(GetIntEnvOrDefault(HOROVOD_GRADIENT_ACCUMULATION_STEPS, 1), 1));
+
 #if HAVE_CUDA
-  // Set number of CUDA streams to use
+  // Set number of CUDA streams to use. Unless set, streams are allocated for
+  // the autotuner to use up to MAX_AUTOTUNED_NCCL_STREAMS of them.
+  state.parameter_manager.SetNumNCCLStreams(1);
   auto horovod_num_nccl_streams =
       std::getenv(HOROVOD_NUM_NCCL_STREAMS);
   if (horovod_num_nccl_streams != nullptr &&
       std::stol(horovod_num_nccl_streams, nullptr, 10) > 0) {
     state.num_nccl_streams = std::atoi(horovod_num_nccl_streams);
+    state.parameter_manager.SetNumNCCLStreams(state.num_nccl_streams, true);
+  } else {
+    state.num_nccl_streams = MAX_AUTOTUNED_NCCL_STREAMS;
+    state.parameter_manager.SetMaxNumNCCLStreams(state.num_nccl_streams);
+  }
+
+  // Urgent responses get a stream and communicators of their own, so that
+  // they do not queue behind a bucket still in flight on the other streams.
+  if (urgent_threshold > 0) {
+    state.urgent_nccl_stream = state.num_nccl_streams;
   }
+  int num_streams =
+      std::max(state.num_nccl_streams, state.urgent_nccl_stream + 1);
 
 #if HAVE_NCCL
-  nccl_context.nccl_comms.resize(state.num_nccl_streams);
+  nccl_context.nccl_comms.resize(num_streams);
+  nccl_context.global_comms.resize(num_streams);
+  nccl_context.cross_comms.resize(num_streams);
 #endif
-  cuda_context.streams.resize(state.num_nccl_streams);
+  cuda_context.streams.resize(num_streams);
+  cuda_context.copy_streams.resize(num_streams);
+  cuda_context.InitializeEventPools(num_streams);
+  auto helper_cpus = HelperCpus(state);
+  if (!helper_cpus.empty()) {
+    // The execution thread of pipelined negotiation takes the first one.
+    cuda_context.finalizer_cpu = helper_cpus[1 % helper_cpus.size()];
+  }
+
+#if HAVE_NCCL && HOROVOD_GPU_ALLREDUCE == 'N'
+  // Enqueue the NCCL allreduces of a response list on a worker while the
+  // background thread performs the host collectives of the list.
+  bool concurrent_cpu_gpu = false;
+  SetBoolFromEnv(HOROVOD_CONCURRENT_CPU_GPU, concurrent_cpu_gpu, true);
+  if (concurrent_cpu_gpu) {
+    std::vector<int> enqueue_cpus;
+    if (!helper_cpus.empty()) {
+      enqueue_cpus.push_back(helper_cpus[2 % helper_cpus.size()]);
+    }
+    state.gpu_enqueue_pool.Create(1, enqueue_cpus);
+  }
 #endif
 
-  // Open the timeline file on coordinator.
+  // Let the collective stream wait for tensor ready events.
+  SetBoolFromEnv(HOROVOD_STREAM_WAIT_READY_EVENTS,
+                 state.stream_wait_ready_events, true);
+
+  // Use a batched memcpy kernel for the fusion buffer unless disabled.
+  state.batch_d2d_memcopies =
+      GetIntEnvOrDefault(HOROVOD_BATCH_D2D_MEMCOPIES, 1) > 0;
+
+  // Pipeline chunk size of MPI and Gloo allreduce of GPU tensors staged
+  // through host memory.
+  state.cuda_staging_chunk_bytes = std::max<int64_t>(
+      GetIntEnvOrDefault(HOROVOD_MPI_CUDA_CHUNK_SIZE,
+                         (int)state.cuda_staging_chunk_bytes),
+      FUSION_BUFFER_ATOMIC_UNIT * sizeof(double));
+#else
+  state.parameter_manager.SetNumNCCLStreams(1, true);
+#endif
+
+  // Open the timeline file on coordinator, or a shard of it on every rank.
   auto horovod_timeline = std::getenv(HOROVOD_TIMELINE);
-  if (is_coordinator && horovod_timeline != nullptr) {
-    state.timeline.Initialize(std::string(horovod_timeline),
-                              static_cast<unsigned int>(size));
+  bool timeline_binary = false;
+  SetBoolFromEnv(HOROVOD_TIMELINE_BINARY, timeline_binary, true);
+  bool timeline_all_ranks = false;
+  SetBoolFromEnv(HOROVOD_TIMELINE_ALL_RANKS, timeline_all_ranks, true);
+  state.timeline.Initialize(static_cast<unsigned int>(size), timeline_binary);
+  bool mark_cycles_in_timeline = false;
+  SetBoolFromEnv(HOROVOD_TIMELINE_MARK_CYCLES, mark_cycles_in_timeline, true);
+  state.timeline.SetMarkCycles(mark_cycles_in_timeline);
+  int timeline_sample_cycles =
+      GetIntEnvOrDefault(HOROVOD_TIMELINE_SAMPLE_CYCLES, 1);
+  auto timeline_tensors = std::getenv(HOROVOD_TIMELINE_TENSORS);
+  try {
+    state.timeline.SetSampling(
+        timeline_sample_cycles,
+        timeline_tensors != nullptr ? timeline_tensors : "");
+  } catch (const std::regex_error& e) {
+    LOG(WARNING, state.controller->GetRank())
+        << "Invalid " << HOROVOD_TIMELINE_TENSORS
+        << ", recording all tensors in the timeline: " << e.what();
+    state.timeline.SetSampling(timeline_sample_cycles, "");
+  }
+  if (horovod_timeline != nullptr && (is_coordinator || timeline_all_ranks)) {
+    std::string timeline_file(horovod_timeline);
+    if (timeline_all_ranks) {
+      timeline_file += "." + std::to_string(state.controller->GetRank());
+    }
+    state.timeline.StartRecording(timeline_file);
+  }
+  if (horovod_timeline != nullptr && timeline_all_ranks) {
+    SynchronizeTimelineClocks(state);
   }
   if (horovod_timeline != nullptr) {
     state.controller->SetTimelineEnabled(true);
   }
+  init_timer.Step("timeline");
 
   ParseStallInspectorFromEnv(state.controller->GetStallInspector());
 
-  SetBoolFromEnv(HOROVOD_TIMELINE_MARK_CYCLES, state.mark_cycles_in_timeline,
-                 true);
+  // Serve metrics on localhost, one port per local rank.
+  state.controller->SetMetrics(&state.metrics);
+  state.controller->SetProcessSets(&state.process_sets);
+  int metrics_port = GetIntEnvOrDefault(HOROVOD_METRICS_PORT, 0);
+  if (metrics_port > 0) {
+    int port = metrics_port + state.controller->GetLocalRank();
+    if (!state.metrics_server.Start(
+            port, [&state]() { return state.metrics.Render(); })) {
+      LOG(WARNING, state.controller->GetRank())
+          << "Could not serve metrics on port " << port << ".";
+    }
+  }
 
   // Override Tensor Fusion threshold, if it's set.
   state.parameter_manager.SetTensorFusionThresholdBytes(64 * 1024 * 1024);
@@ -383,6 +942,38 @@ void BackgroundThreadLoop(HorovodGlobalState& state) {
     state.parameter_manager.SetTensorFusionThresholdBytes(threshold, true);
   }
 
+  // Keep several fusion buffers per device so that packing the next fused
+  // response can overlap with the collective on the previous one.
+  state.fusion_buffer.SetNumSlots(
+      GetIntEnvOrDefault(HOROVOD_FUSION_BUFFER_SLOTS, 1));
+
+  // Split large CPU fusion buffer copies across worker threads, optionally
+  // pinned together with the fusion buffer to a NUMA node.
+  int fusion_buffer_numa_node =
+      GetIntEnvOrDefault(HOROVOD_FUSION_BUFFER_NUMA_NODE, -1);
+  state.fusion_buffer.SetNumaNode(fusion_buffer_numa_node);
+
+  // Cap the bytes of the fusion buffers of each device, and release them and
+  // the pinned host buffers when left unused for a number of cycles.
+  auto horovod_buffer_memory_budget = std::getenv(HOROVOD_BUFFER_MEMORY_BUDGET);
+  if (horovod_buffer_memory_budget != nullptr) {
+    int64_t budget = std::strtoll(horovod_buffer_memory_budget, nullptr, 10);
+    state.fusion_buffer.SetBudget(budget);
+  }
+  state.buffer_idle_cycles = GetIntEnvOrDefault(HOROVOD_BUFFER_IDLE_CYCLES, 0);
+  state.fusion_buffer.SetIdleCycles(state.buffer_idle_cycles);
+  int fusion_memcpy_threads =
+      PoolThreads(state, GetIntEnvOrDefault(HOROVOD_FUSION_MEMCPY_THREADS, 0),
+                  HOROVOD_FUSION_MEMCPY_THREADS);
+  if (fusion_memcpy_threads > 1 && !state.thread_cpus.empty()) {
+    // The background thread copies its own share.
+    state.fusion_memcpy_pool.Create(fusion_memcpy_threads - 1,
+                                    PoolCpus(state));
+  } else if (fusion_memcpy_threads > 1) {
+    state.fusion_memcpy_pool.Create(fusion_memcpy_threads - 1,
+                                    fusion_buffer_numa_node);
+  }
+
   // Override the cycle time.
   state.parameter_manager.SetCycleTimeMs(5);
   auto horovod_cycle_time = std::getenv(HOROVOD_CYCLE_TIME);
@@ -391,16 +982,76 @@ void BackgroundThreadLoop(HorovodGlobalState& state) {
         std::strtof(horovod_cycle_time, nullptr), true);
   }
 
+  // Wake up the background thread as soon as a tensor is enqueued.
+  SetBoolFromEnv(HOROVOD_WAKE_ON_ENQUEUE, state.wake_on_enqueue, true);
+
   // Override response cache capacity, if it's set.
-  state.parameter_manager.SetCacheEnabled(true);
+  state.parameter_manager.SetCacheCapacity(state.cache_capacity);
   auto horovod_cache_capacity = std::getenv(HOROVOD_CACHE_CAPACITY);
   if (horovod_cache_capacity != nullptr) {
     uint32_t cache_capacity = std::strtol(horovod_cache_capacity, nullptr, 10);
     state.cache_capacity = cache_capacity;
-    state.parameter_manager.SetCacheEnabled(cache_capacity > 0, true);
+    state.parameter_manager.SetCacheCapacity(cache_capacity, true);
+  }
+
+  // Allreduce host tensors in a fixed reduction tree for reproducible
+  // results.
+  SetBoolFromEnv(HOROVOD_DETERMINISTIC_ALLREDUCE, state.deterministic_allreduce,
+                 true);
+
+  // Broadcast large host buffers in chunks relayed along a chain of nodes.
+  state.broadcast_chunk_bytes =
+      GetIntEnvOrDefault(HOROVOD_BROADCAST_CHUNK_SIZE, 4 * 1024 * 1024);
+
+  // Allreduce host tensors without the ranks that are late by this many
+  // milliseconds. Only the coordinator can leave ranks out, so the response
+  // cache, which lets ranks agree without it, is disabled. Which ranks are
+  // left out depends on timing, so this is off in deterministic mode.
+  auto horovod_straggler_timeout = std::getenv(HOROVOD_STRAGGLER_TIMEOUT);
+  if (horovod_straggler_timeout != nullptr &&
+      std::strtod(horovod_straggler_timeout, nullptr) > 0 &&
+      state.deterministic_allreduce && is_coordinator) {
+    LOG(WARNING) << "Ignoring " << HOROVOD_STRAGGLER_TIMEOUT << ", as "
+                 << HOROVOD_DETERMINISTIC_ALLREDUCE << " is set.";
+  }
+  if (horovod_straggler_timeout != nullptr &&
+      std::strtod(horovod_straggler_timeout, nullptr) > 0 &&
+      !state.deterministic_allreduce) {
+    state.controller->SetStaleness(
+        std::strtod(horovod_straggler_timeout, nullptr),
+        GetIntEnvOrDefault(HOROVOD_MAX_STALENESS, 1));
+    state.tensor_queue.SetStalenessEnabled(true);
+    if (state.parameter_manager.CacheCapacity() > 0 && is_coordinator) {
+      LOG(INFO) << "Disabling the response cache, as "
+                << HOROVOD_STRAGGLER_TIMEOUT << " is set.";
+    }
+    state.parameter_manager.SetCacheCapacity(0, true);
+  }
+  state.response_cache.set_capacity(state.parameter_manager.CacheCapacity());
+
+  // Grow the response cache up to this capacity when the tensors used
+  // together do not fit in it.
+  state.controller->SetCacheCapacityMax(
+      (uint32_t)std::max(GetIntEnvOrDefault(HOROVOD_CACHE_CAPACITY_MAX, 0), 0));
+
+  // Replay fused responses of a static graph after this many identical
+  // cycles.
+  state.controller->SetStaticGraphWarmup(
+      GetIntEnvOrDefault(HOROVOD_STATIC_GRAPH, 0));
+
+  // Record the requests of every cycle to a trace per rank, which
+  // hvd_controller_sim replays at other job sizes.
+  auto horovod_request_trace = std::getenv(HOROVOD_REQUEST_TRACE);
+  if (horovod_request_trace != nullptr) {
+    auto trace_file = std::string(horovod_request_trace) + "." +
+                      std::to_string(state.controller->GetRank());
+    try {
+      state.controller->SetRequestTrace(
+          std::make_shared<RequestTraceWriter>(trace_file));
+    } catch (const std::exception& e) {
+      LOG(WARNING, state.controller->GetRank()) << e.what();
+    }
   }
-  state.response_cache.set_capacity(
-      (int)state.parameter_manager.CacheEnabled() * state.cache_capacity);
 
   // Set flag for hierarchical allgather. Ignore if Horovod is running on a
   // single node.
@@ -417,16 +1068,39 @@ void BackgroundThreadLoop(HorovodGlobalState& state) {
   auto horovod_hierarchical_allreduce =
       std::getenv(HOROVOD_HIERARCHICAL_ALLREDUCE);
   state.parameter_manager.SetHierarchicalAllreduce(false);
+  bool hierarchical_allreduce_fixed = false;
   if (horovod_hierarchical_allreduce != nullptr) {
     bool value = std::strtol(horovod_hierarchical_allreduce, nullptr, 10) > 0 &&
                  (size != local_size);
     state.parameter_manager.SetHierarchicalAllreduce(value, true);
+    hierarchical_allreduce_fixed = !value;
+  }
+  // Pipeline the cross-node phase of hierarchical allreduce in chunks.
+  state.parameter_manager.SetHierarchicalAllreduceChunkBytes(0);
+  auto horovod_chunk_size =
+      std::getenv(HOROVOD_HIERARCHICAL_ALLREDUCE_CHUNK_SIZE);
+  if (horovod_chunk_size != nullptr) {
+    state.parameter_manager.SetHierarchicalAllreduceChunkBytes(
+        std::strtol(horovod_chunk_size, nullptr, 10), true);
+  }
+
+  // Fused CPU buffers up to this size are allreduced in a logarithmic number
+  // of steps, which beats the ring on many ranks.
+  state.parameter_manager.SetCPUAllreduceLatencyThresholdBytes(64 * 1024);
+  auto horovod_latency_threshold =
+      std::getenv(HOROVOD_CPU_ALLREDUCE_LATENCY_THRESHOLD);
+  if (horovod_latency_threshold != nullptr) {
+    state.parameter_manager.SetCPUAllreduceLatencyThresholdBytes(
+        std::strtol(horovod_latency_threshold, nullptr, 10), true);
   }
 
-#if HOROVOD_GPU_ALLREDUCE != 'N' && HOROVOD_GPU_ALLREDUCE != 'D'
-  // Hierarchical allreduce is not supported without NCCL or DDL
-  state.parameter_manager.SetHierarchicalAllreduce(false, true);
+#if HOROVOD_GPU_ALLREDUCE != 'N'
+  // Only NCCL hierarchical allreduce is chunked.
+  hierarchical_allreduce_fixed = true;
 #endif
+  if (hierarchical_allreduce_fixed) {
+    state.parameter_manager.SetHierarchicalAllreduceChunkBytes(0, true);
+  }
 
   // Issue warning if hierarchical allreduce is enabled in heterogeneous cluster
   if (is_coordinator &&
@@ -434,11 +1108,13 @@ void BackgroundThreadLoop(HorovodGlobalState& state) {
        state.parameter_manager.HierarchicalAllgather()) &&
       !is_homogeneous) {
     std::cerr
-        << "WARNING: Using different number of ranks per node might cause "
-           "performance loss in hierarchical allgather and "
-           "hierarchical allreduce. Consider assigning the same "
-           "number of ranks to each node, or disabling hierarchical "
-           "allgather and hierarchical allreduce.";
+        << "WARNING: Using different number of ranks per node limits the "
+           "cross-node phases of hierarchical allreduce to the "
+           << state.controller->GetMinLocalSize()
+           << " local ranks that every node has, and of hierarchical "
+              "allgather to local rank 0. Consider assigning the same "
+              "number of ranks to each node."
+           << std::endl;
   }
 
   // Enable auto-tuning.
@@ -451,19 +1127,139 @@ void BackgroundThreadLoop(HorovodGlobalState& state) {
                                            ? std::string(horovod_autotune_log)
                                            : "");
     state.parameter_manager.SetAutoTuning(true);
+
+    // Start from and save to the best parameters of the same topology.
+    auto horovod_autotune_profile = std::getenv(HOROVOD_AUTOTUNE_PROFILE);
+    if (horovod_autotune_profile != nullptr) {
+      std::string key = "size=" + std::to_string(size) +
+                        ";local_size=" + std::to_string(local_size) +
+                        ";cross_size=" +
+                        std::to_string(state.controller->GetCrossSize()) +
+                        ";homogeneous=" + std::to_string(is_homogeneous);
+      state.parameter_manager.SetProfile(horovod_autotune_profile, key);
+    }
+
+    // Penalize the memory taken by fusion buffers.
+    auto horovod_autotune_memory_weight =
+        std::getenv(HOROVOD_AUTOTUNE_MEMORY_WEIGHT);
+    if (horovod_autotune_memory_weight != nullptr) {
+      state.parameter_manager.SetMemoryWeight(
+          std::strtod(horovod_autotune_memory_weight, nullptr));
+    }
+
+    // Keep watching the throughput and tune again when it drifts.
+    bool continuous = false;
+    SetBoolFromEnv(HOROVOD_AUTOTUNE_CONTINUOUS, continuous, true);
+    state.parameter_manager.SetContinuous(continuous);
+  }
+
+  // Aggregate requests per node before they reach the coordinator. Ignore if
+  // Horovod is running on a single node.
+  bool hierarchical_negotiation = false;
+  SetBoolFromEnv(HOROVOD_HIERARCHICAL_NEGOTIATION, hierarchical_negotiation,
+                 true);
+  if (hierarchical_negotiation && size != local_size &&
+      !state.controller->EnableHierarchicalNegotiation()) {
+    LOG(WARNING, state.controller->GetRank())
+        << "Hierarchical negotiation is not supported by the controller.";
+  }
+
+  // Overlap negotiation of the next cycle with execution of the current one.
+  bool pipelined_negotiation = false;
+  SetBoolFromEnv(HOROVOD_PIPELINED_NEGOTIATION, pipelined_negotiation, true);
+  if (pipelined_negotiation) {
+    if (state.parameter_manager.IsAutoTuning()) {
+      LOG(WARNING, state.controller->GetRank())
+          << "Pipelined negotiation is not supported with autotuning, "
+             "running negotiation and execution on the same thread.";
+    } else if (!state.controller->EnablePipelinedNegotiation()) {
+      LOG(WARNING, state.controller->GetRank())
+          << "Pipelined negotiation is not supported by the "
+             "controller, running negotiation and execution on the same "
+             "thread.";
+    } else {
+      state.pipelined_negotiation = true;
+    }
   }
 
   op_manager.reset(CreateOperationManager(state));
+  init_timer.Step("operations");
+
+#if HAVE_NCCL
+  // Create the global NCCL communicators before the first step instead of
+  // in its first collective.
+  bool nccl_eager_init = false;
+  SetBoolFromEnv(HOROVOD_NCCL_EAGER_INIT, nccl_eager_init, true);
+  if (nccl_eager_init) {
+    try {
+      nccl_context.InitGlobalCommsEagerly(&state);
+    } catch (const std::exception& ex) {
+      LOG(WARNING, state.controller->GetRank())
+          << "Eager NCCL initialization failed, communicators are created on "
+             "first use: " << ex.what();
+    }
+    init_timer.Step("nccl");
+  }
+#endif
+
+#if HAVE_NCCL
+  // Create the communicator of graph-capturable allreduces, which framework
+  // threads issue on their own streams.
+  SetBoolFromEnv(HOROVOD_CUDA_GRAPH, state.cuda_graph, true);
+  if (state.cuda_graph) {
+    try {
+      nccl_context.InitCaptureComm(&state);
+    } catch (const std::exception& ex) {
+      LOG(WARNING, state.controller->GetRank())
+          << "Graph-capturable allreduces are disabled: " << ex.what();
+    }
+    init_timer.Step("nccl_capture");
+  }
+#endif
+
+  if (state.pipelined_negotiation) {
+    state.execution_thread = std::thread(ExecutionThreadLoop, std::ref(state));
+  }
 
   // Signal that initialization is completed.
+  init_timer.Finish(state);
   state.initialization_done = true;
   LOG(INFO, horovod_global.controller->GetRank()) << "Horovod Initialized";
 
-  // Iterate until shutdown.
-  while (RunLoopOnce(state))
-    ;
+  // Iterate until shutdown, rebuilding the communicators in place whenever
+  // the membership is reset.
+  while (true) {
+    while (RunLoopOnce(state))
+      ;
+    if (!state.reset_requested || !ResetMembership(state)) {
+      break;
+    }
+  }
+
+  // Wait for the execution thread to drain the remaining response lists.
+  if (state.execution_thread.joinable()) {
+    state.execution_thread.join();
+  }
+#if HAVE_MPI
+  if (mpi_context.async_collectives) {
+    mpi_context.Progress(true);
+  }
+#endif
+#if HAVE_MLSL
+  if (state.cpu_operation == LibType::MLSL) {
+    mlsl_context.Progress(true);
+  }
+#endif
+  state.fusion_memcpy_pool.Shutdown();
+  state.gpu_enqueue_pool.Shutdown();
+  state.metrics_server.Stop();
+  state.shared_memory.Finalize();
 
     // Finalize all contexts
+#if HAVE_CUDA
+  cuda_context.ShutDownFinalizer();
+#endif
+
 #if HAVE_NCCL
   nccl_context.ShutDown();
 #endif
@@ -484,6 +1280,7 @@ void BackgroundThreadLoop(HorovodGlobalState& state) {
   for (auto& cb : callbacks) {
     cb(SHUT_DOWN_ERROR);
   }
+  state.process_sets.Clear();
 
 #if HAVE_MPI
   mpi_context.Finalize(mpi_ctx_manager);
@@ -497,56 +1294,310 @@ void BackgroundThreadLoop(HorovodGlobalState& state) {
 
 }
 
+// Whether all ranks perform the response on host tensors.
+bool RunsOnHost(const Response& response) {
+  auto& devices = response.devices();
+  return response.response_type() != Response::JOIN && !devices.empty() &&
+         std::all_of(devices.begin(), devices.end(),
+                     [](int32_t device) { return device == CPU_DEVICE_ID; });
+}
+
+// Whether the response is a flat NCCL allreduce on communicators that exist
+// already, which does not use MPI or Gloo, so that it can be performed
+// alongside host collectives.
+bool RunsOnNCCLOnly(const HorovodGlobalState& state,
+                    const Response& response) {
+#if HAVE_NCCL && HOROVOD_GPU_ALLREDUCE == 'N'
+  auto& devices = response.devices();
+  if (response.response_type() != Response::ALLREDUCE ||
+      response.reduce_op() == ReduceOp::ADASUM ||
+      response.process_set_id() != 0 || !response.absent_ranks().empty() ||
+      response.contributions() > 0 || devices.empty() ||
+      state.parameter_manager.HierarchicalAllreduce() ||
+      op_manager->AllreduceOpForced()) {
+    return false;
+  }
+  if (std::any_of(devices.begin(), devices.end(),
+                  [](int32_t device) { return device == CPU_DEVICE_ID; })) {
+    return false;
+  }
+  return nccl_context.HasGlobalComms(&state, devices);
+#else
+  return false;
+#endif
+}
+
+// Performs the negotiated responses of a cycle, which are the same on all
+// ranks, and releases the buffers that have been idle for too long. With a
+// GPU enqueue worker, a list holding both host collectives and NCCL
+// allreduces is split: the worker enqueues the allreduces on their streams
+// while this thread performs the host collectives. Each communicator still
+// sees its collectives in the order of the list.
+void PerformOperations(HorovodGlobalState& state,
+                       const ResponseList& response_list) {
+  int rank = state.controller->GetRank();
+  auto perform = [rank](const Response& response) {
+    LOG(TRACE, rank) << "Performing " << response.tensor_names_string();
+    LOG(DEBUG, rank) << "Processing " << response.tensor_names().size()
+                     << " tensors";
+    PerformOperation(response);
+    LOG(TRACE, rank) << "Finished performing "
+                     << response.tensor_names_string();
+  };
+
+  std::vector<const Response*> host_responses;
+  std::vector<const Response*> gpu_responses;
+  bool split = state.gpu_enqueue_pool.num_threads() > 0;
+  for (auto& response : response_list.responses()) {
+    if (!split) {
+      break;
+    }
+    if (RunsOnHost(response)) {
+      host_responses.push_back(&response);
+    } else if (RunsOnNCCLOnly(state, response)) {
+      gpu_responses.push_back(&response);
+    } else {
+      split = false;
+    }
+  }
+
+  if (split && !host_responses.empty() && !gpu_responses.empty()) {
+    state.gpu_enqueue_pool.RunAlongside(
+        [&]() {
+          for (auto response : gpu_responses) {
+            perform(*response);
+          }
+        },
+        [&]() {
+          for (auto response : host_responses) {
+            perform(*response);
+          }
+        });
+  } else {
+    for (auto& response : response_list.responses()) {
+      perform(response);
+    }
+  }
+
+  state.fusion_buffer.EndCycle();
+#if HAVE_CUDA
+  cuda_context.host_buffers.EndCycle(state.buffer_idle_cycles);
+#endif
+}
+
 bool RunLoopOnce(HorovodGlobalState& state) {
+  // Stop at the cycle boundary without negotiating, the communicators may
+  // include ranks that are gone.
+  if (state.reset_requested) {
+    return false;
+  }
+
   // This delay determines thread frequency and communication message latency
   auto start_time = std::chrono::steady_clock::now();
-  auto sleep_duration = state.last_cycle_start +
+  auto cycle_deadline = state.last_cycle_start +
                         std::chrono::microseconds(long(
-                            state.parameter_manager.CycleTimeMs() * 1000.)) -
-                        start_time;
+                            state.parameter_manager.CycleTimeMs() * 1000.));
+  auto sleep_duration = cycle_deadline - start_time;
   if (sleep_duration > std::chrono::steady_clock::duration::zero()) {
-    std::this_thread::sleep_for(sleep_duration);
+    if (state.busy_poll) {
+      // Waking up a sleeping thread takes tens of microseconds, spinning on
+      // the queue starts the cycle as soon as there is work.
+      while (!state.tensor_queue.HasNewMessages() &&
+             std::chrono::steady_clock::now() < cycle_deadline) {
+      }
+    } else if (state.wake_on_enqueue) {
+      // Cycle time is only an upper bound, start as soon as there is work.
+      state.tensor_queue.WaitForNewMessages(cycle_deadline);
+    } else {
+      std::this_thread::sleep_for(sleep_duration);
+    }
   }
-  state.last_cycle_start = std::chrono::steady_clock::now();
+  auto cycle_start = std::chrono::steady_clock::now();
+  state.metrics.cycles.Add();
+  state.metrics.cycle_time_us.Observe(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          cycle_start - state.last_cycle_start).count());
+  state.last_cycle_start = cycle_start;
 
-  if (state.mark_cycles_in_timeline) {
-    // Mark start of the new cycle.
-    state.timeline.MarkCycleStart();
+  // Mark start of the new cycle, if marks are recorded.
+  state.timeline.MarkCycleStart();
+
+#if HAVE_MLSL
+  if (state.cpu_operation == LibType::MLSL) {
+    // Complete the MLSL requests that finished since the last cycle.
+    mlsl_context.Progress(false);
   }
+#endif
+#if HAVE_MPI
+  if (mpi_context.async_collectives) {
+    // Complete the MPI collectives that finished since the last cycle.
+    mpi_context.Progress(false);
+  }
+#endif
 
   auto response_list =
       state.controller->ComputeResponseList(horovod_global.shut_down);
+  state.metrics.negotiation_time_us.Observe(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - cycle_start).count());
+
+  if (state.pipelined_negotiation) {
+    // Hand off to the execution thread and move on to the next cycle.
+    bool shutdown = response_list.shutdown();
+    bool sync_parameters = response_list.sync_parameters();
+    state.response_queue.Push(std::move(response_list));
+    if (sync_parameters) {
+      // Collectives read some of the parameters, so they change once the
+      // negotiated ones are done.
+      state.response_queue.WaitUntilDone();
+      state.controller->SynchronizeParameters();
+    }
+    return !shutdown;
+  }
 
   // Get tensor name and size data for autotuning.
-  int64_t total_tensor_size = 0;
   std::vector<std::string> tensor_names;
-  if (state.parameter_manager.IsAutoTuning()) {
-    total_tensor_size = horovod_global.tensor_queue.GetTensorDataForAutotuner(
-        response_list, tensor_names);
+  std::vector<int64_t> tensor_sizes;
+  if (state.parameter_manager.IsObserving()) {
+    horovod_global.tensor_queue.GetTensorDataForAutotuner(
+        response_list, tensor_names, tensor_sizes);
   }
 
   // Perform the collective operation. All nodes should end up performing
   // the same operation.
-  int rank = state.controller->GetRank();
-  for (auto& response : response_list.responses()) {
-    LOG(TRACE, rank) << "Performing " << response.tensor_names_string();
-    LOG(DEBUG, rank) << "Processing " << response.tensor_names().size()
-                     << " tensors";
-    PerformOperation(response);
-    LOG(TRACE, rank) << "Finished performing "
-                     << response.tensor_names_string();
+  PerformOperations(state, response_list);
+
+  bool should_sync = response_list.sync_parameters();
+  if (state.parameter_manager.IsObserving()) {
+    should_sync |= state.parameter_manager.Update(tensor_names, tensor_sizes);
+  }
+  if (should_sync) {
+    state.controller->SynchronizeParameters();
   }
 
-  if (state.parameter_manager.IsAutoTuning()) {
-    bool should_sync =
-        state.parameter_manager.Update(tensor_names, total_tensor_size);
+  return !response_list.shutdown();
+}
 
-    if (should_sync) {
-      state.controller->SynchronizeParameters();
+// Perform the negotiated collective operations in order when negotiation is
+// pipelined. Exits after the response list that signals shutdown.
+void ExecutionThreadLoop(HorovodGlobalState& state) {
+  auto cpus = HelperCpus(state);
+  if (!cpus.empty()) {
+    PinCurrentThread(cpus[0]);
+  }
+  while (true) {
+    ResponseList response_list;
+    state.response_queue.Pop(response_list);
+    PerformOperations(state, response_list);
+    state.response_queue.MarkDone();
+    if (response_list.shutdown()) {
+      break;
     }
   }
+}
 
-  return !response_list.shutdown();
+// Rebuild the communicators for the membership given by the environment,
+// keeping the fusion buffers, tuned parameters, timeline and operations, and
+// the response cache if it is the same on all ranks. Tensors enqueued before
+// the reset are aborted. Returns false if the reset failed, in which case the
+// background thread shuts down.
+bool ResetMembership(HorovodGlobalState& state) {
+  LOG(INFO, state.controller->GetRank()) << "Resetting Horovod membership";
+  try {
+    if (state.execution_thread.joinable()) {
+      ResponseList response_list;
+      response_list.set_shutdown(true);
+      state.response_queue.Push(std::move(response_list));
+      state.execution_thread.join();
+    }
+#if HAVE_MPI
+    if (mpi_context.async_collectives) {
+      mpi_context.Progress(true);
+    }
+#endif
+
+    std::vector<StatusCallback> callbacks;
+    state.tensor_queue.FinalizeTensorQueue(callbacks);
+    for (auto& cb : callbacks) {
+      cb(Status::Aborted("Horovod membership was reset."));
+    }
+
+#if HAVE_CUDA
+    cuda_context.ShutDownFinalizer();
+#endif
+
+#if HAVE_NCCL
+    // NCCL communicators span the ranks of the old membership and are
+    // created again on first use.
+    nccl_context.ShutDown();
+    int num_streams =
+        std::max(state.num_nccl_streams, state.urgent_nccl_stream + 1);
+    nccl_context.nccl_comms.resize(num_streams);
+    nccl_context.global_comms.resize(num_streams);
+    nccl_context.cross_comms.resize(num_streams);
+#endif
+
+    // Process sets name ranks of the old membership and are registered
+    // again by the frameworks.
+    state.process_sets.Clear();
+    state.shared_memory.Finalize();
+    InitTimer init_timer;
+#if HAVE_GLOO
+    gloo_context.Reset(ParseGlooIface());
+    init_timer.Step("gloo");
+#endif
+    int old_size = state.controller->GetSize();
+    state.controller->ResetMembership();
+    state.controller->Initialize();
+    init_timer.Step("controller");
+#if HAVE_NCCL
+    if (state.cuda_graph) {
+      nccl_context.InitCaptureComm(&state);
+      init_timer.Step("nccl_capture");
+    }
+#endif
+
+    bool shared_memory_disabled = false;
+    SetBoolFromEnv(HOROVOD_SHARED_MEMORY_DISABLE, shared_memory_disabled, true);
+    if (!shared_memory_disabled) {
+      state.shared_memory.Initialize(*state.controller);
+    }
+    init_timer.Step("shared_memory");
+
+    // Workers only agree on cache bits if their caches are the same, which
+    // is not the case when ranks have joined. Cached responses also hold the
+    // devices of all the ranks of the old membership, so they are dropped
+    // when its size changes.
+    uint64_t fingerprint = state.response_cache.fingerprint();
+    uint64_t root_fingerprint = fingerprint;
+    state.controller->Bcast(&root_fingerprint, sizeof(root_fingerprint), 0,
+                            Communicator::GLOBAL);
+    std::vector<long long> same_cache = {
+        fingerprint == root_fingerprint &&
+        old_size == state.controller->GetSize()};
+    state.controller->CrossRankBitwiseAnd(same_cache, 1);
+    if (!same_cache[0]) {
+      state.response_cache.clear();
+    }
+    init_timer.Finish(state);
+  } catch (const std::exception& e) {
+    LOG(ERROR) << "Horovod membership reset failed: " << e.what();
+    state.initialization_done = false;
+    state.reset_succeeded = false;
+    state.reset_requested = false;
+    return false;
+  }
+
+  if (state.pipelined_negotiation) {
+    state.execution_thread = std::thread(ExecutionThreadLoop, std::ref(state));
+  }
+
+  LOG(INFO, state.controller->GetRank())
+      << "Horovod membership reset to " << state.controller->GetSize()
+      << " processes";
+  state.reset_succeeded = true;
+  state.reset_requested = false;
+  return true;
 }
 
 // Start Horovod background thread. Ensure that this is
@@ -556,6 +1607,12 @@ void InitializeHorovodOnce(const int* ranks, int nranks) {
   if (!horovod_global.initialize_flag.test_and_set()) {
     horovod_global.control_operation = ParseControllerOpsFromEnv();
     horovod_global.cpu_operation = ParseCPUOpsFromEnv();
+    horovod_global.cpu_compression = ParseCPUCompressionFromEnv();
+    auto horovod_sparse_ratio = std::getenv(HOROVOD_SPARSE_ALLREDUCE_RATIO);
+    if (horovod_sparse_ratio != nullptr) {
+      horovod_global.sparse_allreduce_ratio =
+          std::strtod(horovod_sparse_ratio, nullptr);
+    }
 #if HAVE_MPI
     // Enable mpi is it's used either in cpu data transfer or controller
     if (horovod_global.cpu_operation == LibType::MPI ||
@@ -599,6 +1656,17 @@ void InitializeHorovodOnce(const int* ranks, int nranks) {
   LOG(DEBUG) << "Background thread init done";
 }
 
+// Copies at most buffer_size - 1 characters of text and a terminating null
+// into buffer, and returns the full length of text.
+int CopyToBuffer(const std::string& text, char* buffer, int buffer_size) {
+  if (buffer != nullptr && buffer_size > 0) {
+    auto length = std::min(text.size(), (size_t)buffer_size - 1);
+    std::memcpy(buffer, text.data(), length);
+    buffer[length] = '\0';
+  }
+  return (int)text.size();
+}
+
 } // namespace
 
 Status CheckInitialized() {
@@ -631,6 +1699,28 @@ void horovod_shutdown() {
   }
 }
 
+int horovod_reset() {
+  if (!horovod_global.initialization_done) {
+    return 0;
+  }
+  // Only Gloo can rendezvous with a new set of ranks.
+  bool supported = horovod_global.control_operation == LibType::GLOO;
+#if HAVE_MPI
+  supported = supported && !mpi_context.IsEnabled();
+#endif
+  if (!supported) {
+    LOG(ERROR) << "Resetting the membership requires the Gloo controller and "
+                  "Gloo CPU operations.";
+    return 0;
+  }
+
+  horovod_global.reset_requested = true;
+  while (horovod_global.reset_requested && !horovod_global.shut_down) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return horovod_global.reset_succeeded ? 1 : 0;
+}
+
 int horovod_rank() {
   if (!horovod_global.initialization_done) {
     return -1;
@@ -659,6 +1749,38 @@ int horovod_local_size() {
   return horovod_global.controller->GetLocalSize();
 }
 
+int horovod_add_process_set(const int* ranks, int nranks) {
+  if (!horovod_global.initialization_done) {
+    return -1;
+  }
+  return horovod_global.process_sets.Register(
+      std::vector<int>(ranks, ranks + nranks),
+      horovod_global.controller->GetRank(),
+      horovod_global.controller->GetSize());
+}
+
+int horovod_process_set_rank(int process_set_id) {
+  if (!horovod_global.initialization_done) {
+    return -1;
+  }
+  if (process_set_id == 0) {
+    return horovod_global.controller->GetRank();
+  }
+  auto process_set = horovod_global.process_sets.Get(process_set_id);
+  return process_set != nullptr ? process_set->rank : -1;
+}
+
+int horovod_process_set_size(int process_set_id) {
+  if (!horovod_global.initialization_done) {
+    return -1;
+  }
+  if (process_set_id == 0) {
+    return horovod_global.controller->GetSize();
+  }
+  auto process_set = horovod_global.process_sets.Get(process_set_id);
+  return process_set != nullptr ? process_set->Size() : -1;
+}
+
 int horovod_mpi_threads_supported() {
   if (!horovod_global.initialization_done) {
     return -1;
@@ -729,6 +1851,126 @@ bool horovod_mlsl_built() {
 #endif
 }
 
+int horovod_metrics(char* buffer, int buffer_size) {
+  if (!horovod_global.initialization_done) {
+    return -1;
+  }
+  return CopyToBuffer(horovod_global.metrics.Render(), buffer, buffer_size);
+}
+
+int horovod_get_stats(HorovodStats* stats, int max_stats) {
+  if (!horovod_global.initialization_done) {
+    return -1;
+  }
+  auto& metrics = horovod_global.metrics;
+  int count = 0;
+  auto add = [&](const std::string& name, const Histogram& time_us,
+                 uint64_t bytes) {
+    if (stats != nullptr && count < max_stats) {
+      auto& entry = stats[count];
+      std::memset(&entry, 0, sizeof(entry));
+      std::strncpy(entry.name, name.c_str(), sizeof(entry.name) - 1);
+      entry.count = time_us.Count();
+      entry.bytes = bytes;
+      entry.total_us = time_us.Sum();
+      entry.p50_us = time_us.Percentile(0.5);
+      entry.p90_us = time_us.Percentile(0.9);
+      entry.p99_us = time_us.Percentile(0.99);
+    }
+    ++count;
+  };
+  add("cycle", metrics.cycle_time_us, 0);
+  add("negotiation", metrics.negotiation_time_us, 0);
+  add("wait_for_data", metrics.wait_for_data_time_us, 0);
+  add("memcpy", metrics.memcpy_time_us, metrics.memcpy_bytes.Value());
+  add("collective", metrics.collective_time_us,
+      metrics.collective_bytes_total.Value());
+  int num_operations = metrics.num_operations.load(std::memory_order_acquire);
+  for (int i = 0; i < num_operations; ++i) {
+    auto& op = metrics.operations[i];
+    add(op.name, op.time_us, op.bytes.Value());
+  }
+  auto add_usage = [&](const std::string& name, uint64_t buffers,
+                       uint64_t bytes) {
+    if (stats != nullptr && count < max_stats) {
+      auto& entry = stats[count];
+      std::memset(&entry, 0, sizeof(entry));
+      std::strncpy(entry.name, name.c_str(), sizeof(entry.name) - 1);
+      entry.count = buffers;
+      entry.bytes = bytes;
+    }
+    ++count;
+  };
+  add_usage("fusion_buffers", horovod_global.fusion_buffer.AllocatedArenas(),
+            horovod_global.fusion_buffer.AllocatedBytes());
+#if HAVE_CUDA
+  add_usage("host_buffers", cuda_context.host_buffers.MappedBuffers(),
+            cuda_context.host_buffers.MappedBytes());
+#endif
+  return count;
+}
+
+int horovod_allreduce_ops(char* buffer, int buffer_size) {
+  if (!horovod_global.initialization_done) {
+    return -1;
+  }
+  std::string text;
+  for (auto& name : op_manager->AllreduceOpNames()) {
+    text += name + "\n";
+  }
+  return CopyToBuffer(text, buffer, buffer_size);
+}
+
+bool horovod_set_allreduce_op(int index) {
+  if (!horovod_global.initialization_done) {
+    return false;
+  }
+  return op_manager->SetAllreduceOp(index);
+}
+
+bool horovod_set_parameters(int64_t fusion_threshold_bytes,
+                            double cycle_time_ms, int cache_capacity,
+                            int hierarchical_allreduce,
+                            int hierarchical_allgather) {
+  if (!horovod_global.initialization_done ||
+      !horovod_global.controller->IsCoordinator()) {
+    return false;
+  }
+  ParameterManager::Overrides overrides;
+  overrides.tensor_fusion_threshold_bytes = fusion_threshold_bytes;
+  overrides.cycle_time_ms = cycle_time_ms;
+  overrides.cache_capacity = cache_capacity;
+  overrides.hierarchical_allreduce = hierarchical_allreduce;
+  overrides.hierarchical_allgather = hierarchical_allgather;
+  horovod_global.controller->SetParameterOverrides(overrides);
+  return true;
+}
+
+bool horovod_start_timeline(const char* file_name, bool mark_cycles) {
+  if (!horovod_global.initialization_done) {
+    return false;
+  }
+  horovod_global.timeline.SetMarkCycles(mark_cycles);
+  if (!horovod_global.timeline.StartRecording(file_name)) {
+    return false;
+  }
+  if (horovod_global.controller->IsCoordinator()) {
+    horovod_global.controller->RequestTimelineEnabled(true);
+  }
+  return true;
+}
+
+bool horovod_stop_timeline() {
+  if (!horovod_global.initialization_done) {
+    return false;
+  }
+  horovod_global.timeline.StopRecording();
+  if (horovod_global.controller->IsCoordinator()) {
+    horovod_global.controller->RequestTimelineEnabled(false);
+  }
+  return true;
+}
+
 }
 
 // Contexts and controller must be initialized and the background thread
@@ -738,13 +1980,30 @@ Status EnqueueTensorAllreduce(std::shared_ptr<OpContext> context,
                               std::shared_ptr<Tensor> output,
                               std::shared_ptr<ReadyEvent> ready_event,
                               const std::string name, const int device,
-                              StatusCallback callback) {
+                              StatusCallback callback, int32_t priority,
+                              double prescale_factor,
+                              double postscale_factor, ReduceOp reduce_op,
+                              int32_t process_set_id,
+                              Compression compression, bool accumulate) {
+  if (process_set_id != 0) {
+    auto process_set = horovod_global.process_sets.Get(process_set_id);
+    if (process_set == nullptr || process_set->rank < 0) {
+      return Status::InvalidArgument(
+          "Rank " + std::to_string(horovod_global.controller->GetRank()) +
+          " is not a member of process set " + std::to_string(process_set_id) +
+          ".");
+    }
+  }
+
   Request message;
   message.set_request_rank(horovod_global.controller->GetRank());
   message.set_tensor_name(name);
   message.set_tensor_type(tensor->dtype());
   message.set_device(device);
   message.set_request_type(Request::ALLREDUCE);
+  message.set_reduce_op(reduce_op);
+  message.set_process_set_id(process_set_id);
+  message.set_compression(compression);
   for (int i = 0; i < tensor->shape().dims(); ++i) {
     message.add_tensor_shape((int64_t)tensor->shape().dim_size(i));
   }
@@ -757,17 +2016,139 @@ Status EnqueueTensorAllreduce(std::shared_ptr<OpContext> context,
   e.ready_event = ready_event;
   e.device = device;
   e.callback = callback;
+  e.priority = priority;
+  e.prescale_factor = prescale_factor;
+  e.postscale_factor = postscale_factor;
+  e.reduce_op = reduce_op;
+  e.compression = compression;
+  e.process_set_id = process_set_id;
 
   if (horovod_global.shut_down) {
     return SHUT_DOWN_ERROR;
   }
-  Status status = horovod_global.tensor_queue.AddToTensorQueue(e, message);
+
+  // With gradient accumulation only the last of the accumulated steps of the
+  // tensors that opt in is negotiated, and allreduces the local sum. Urgent
+  // tensors are allreduced every step.
+  auto& tensor_queue = horovod_global.tensor_queue;
+  if (accumulate && tensor_queue.AccumulationSteps() > 1 &&
+      device == CPU_DEVICE_ID &&
+      reduce_op == ReduceOp::SUM &&
+      !horovod_global.controller->IsUrgent(Response::ALLREDUCE, e) &&
+      !tensor_queue.Accumulate(e)) {
+    callback(Status::OK());
+    return Status::OK();
+  }
+
+  Status status = tensor_queue.AddToTensorQueue(e, message);
   if (status.ok()) {
     LOG(TRACE, horovod_global.controller->GetRank()) << "Enqueued " << name;
   }
   return status;
 }
 
+// Contexts and controller must be initialized and the background thread
+// must be running before this function is called.
+Status EnqueueTensorAllreduces(
+    std::vector<std::shared_ptr<OpContext>>& contexts,
+    std::vector<std::shared_ptr<Tensor>>& tensors,
+    std::vector<std::shared_ptr<Tensor>>& outputs,
+    std::vector<std::shared_ptr<ReadyEvent>>& ready_events,
+    std::vector<std::string>& names, const std::string& group_name,
+    const int device, std::vector<StatusCallback>& callbacks,
+    int32_t priority, double prescale_factor, double postscale_factor,
+    ReduceOp reduce_op, Compression compression) {
+  if (tensors.empty()) {
+    return Status::InvalidArgument("Group " + group_name + " has no tensors.");
+  }
+  auto dtype = tensors[0]->dtype();
+  for (auto& tensor : tensors) {
+    if (tensor->dtype() != dtype) {
+      return Status::InvalidArgument(
+          "Tensors of group " + group_name + " must have the same type, got " +
+          DataType_Name(dtype) + " and " + DataType_Name(tensor->dtype()) +
+          ".");
+    }
+  }
+
+  // The group is checked across ranks by the type and the number of elements
+  // of each of its tensors.
+  Request message;
+  message.set_request_rank(horovod_global.controller->GetRank());
+  message.set_tensor_name(group_name);
+  message.set_tensor_type(dtype);
+  message.set_device(device);
+  message.set_request_type(Request::ALLREDUCE);
+  message.set_reduce_op(reduce_op);
+  message.set_compression(compression);
+  message.set_group(true);
+
+  std::vector<TensorTableEntry> entries(tensors.size());
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    message.add_tensor_shape(tensors[i]->shape().num_elements());
+
+    auto& e = entries[i];
+    e.tensor_name = names[i];
+    e.context = contexts[i];
+    e.tensor = tensors[i];
+    e.output = outputs[i];
+    e.ready_event = ready_events[i];
+    e.device = device;
+    e.callback = callbacks[i];
+    e.priority = priority;
+    e.prescale_factor = prescale_factor;
+    e.postscale_factor = postscale_factor;
+    e.reduce_op = reduce_op;
+    e.compression = compression;
+  }
+
+  if (horovod_global.shut_down) {
+    return SHUT_DOWN_ERROR;
+  }
+  Status status = horovod_global.tensor_queue.AddToTensorQueueGroup(entries,
+                                                                    message);
+  if (status.ok()) {
+    LOG(TRACE, horovod_global.controller->GetRank())
+        << "Enqueued group " << group_name << " of " << tensors.size()
+        << " tensors";
+  }
+  return status;
+}
+
+Status CapturableAllreduce(std::vector<std::shared_ptr<Tensor>>& tensors,
+                           std::vector<std::shared_ptr<Tensor>>& outputs,
+                           const int device, void* stream,
+                           double prescale_factor, double postscale_factor,
+                           ReduceOp reduce_op) {
+  Status status = CheckInitialized();
+  if (!status.ok() || tensors.empty()) {
+    return status;
+  }
+#if HAVE_NCCL
+  auto dtype = tensors[0]->dtype();
+  std::vector<TensorTableEntry> entries(tensors.size());
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    if (tensors[i]->dtype() != dtype) {
+      return Status::InvalidArgument(
+          "Tensors of a graph-capturable allreduce must have the same type, "
+          "got " + DataType_Name(dtype) + " and " +
+          DataType_Name(tensors[i]->dtype()) + ".");
+    }
+    auto& e = entries[i];
+    e.tensor = tensors[i];
+    e.output = outputs[i];
+    e.device = device;
+    e.prescale_factor = prescale_factor;
+    e.postscale_factor = postscale_factor;
+    e.reduce_op = reduce_op;
+  }
+  return nccl_context.CapturableAllreduce(entries, (cudaStream_t)stream);
+#else
+  return Status::PreconditionError(
+      "Graph-capturable allreduces require Horovod built with NCCL.");
+#endif
+}
+
 // Contexts and controller must be initialized and the background thread
 // must be running before this function is called.
 Status EnqueueTensorAllgather(std::shared_ptr<OpContext> context,
@@ -842,5 +2223,113 @@ Status EnqueueTensorBroadcast(std::shared_ptr<OpContext> context,
   return status;
 }
 
+// Contexts and controller must be initialized and the background thread
+// must be running before this function is called.
+Status EnqueueTensorReducescatter(std::shared_ptr<OpContext> context,
+                                  std::shared_ptr<Tensor> tensor,
+                                  std::shared_ptr<ReadyEvent> ready_event,
+                                  const std::string name, const int device,
+                                  StatusCallback callback) {
+  Request message;
+  message.set_request_rank(horovod_global.controller->GetRank());
+  message.set_tensor_name(name);
+  message.set_tensor_type(tensor->dtype());
+  message.set_device(device);
+  message.set_request_type(Request::REDUCESCATTER);
+  for (int i = 0; i < tensor->shape().dims(); ++i) {
+    message.add_tensor_shape((int64_t)tensor->shape().dim_size(i));
+  }
+
+  TensorTableEntry e;
+  e.tensor_name = name;
+  e.context = context;
+  e.tensor = tensor;
+  e.ready_event = ready_event;
+  e.device = device;
+  e.callback = callback;
+
+  if (horovod_global.shut_down) {
+    return SHUT_DOWN_ERROR;
+  }
+  Status status = horovod_global.tensor_queue.AddToTensorQueue(e, message);
+  if (status.ok()) {
+    LOG(TRACE, horovod_global.controller->GetRank()) << "Enqueued " << name;
+  }
+  return status;
+}
+
+// Contexts and controller must be initialized and the background thread
+// must be running before this function is called.
+Status EnqueueTensorAlltoall(std::shared_ptr<OpContext> context,
+                             std::shared_ptr<Tensor> tensor,
+                             const std::vector<int64_t>& splits,
+                             std::shared_ptr<ReadyEvent> ready_event,
+                             const std::string name, const int device,
+                             StatusCallback callback) {
+  Request message;
+  message.set_request_rank(horovod_global.controller->GetRank());
+  message.set_tensor_name(name);
+  message.set_tensor_type(tensor->dtype());
+  message.set_device(device);
+  message.set_request_type(Request::ALLTOALL);
+  message.set_splits(splits);
+  for (int i = 0; i < tensor->shape().dims(); ++i) {
+    message.add_tensor_shape((int64_t)tensor->shape().dim_size(i));
+  }
+
+  TensorTableEntry e;
+  e.tensor_name = name;
+  e.context = context;
+  e.tensor = tensor;
+  e.ready_event = ready_event;
+  e.device = device;
+  e.callback = callback;
+
+  if (horovod_global.shut_down) {
+    return SHUT_DOWN_ERROR;
+  }
+  Status status = horovod_global.tensor_queue.AddToTensorQueue(e, message);
+  if (status.ok()) {
+    LOG(TRACE, horovod_global.controller->GetRank()) << "Enqueued " << name;
+  }
+  return status;
+}
+
+// Contexts and controller must be initialized and the background thread
+// must be running before this function is called.
+Status EnqueueJoin(std::shared_ptr<OpContext> context, const int device,
+                   StatusCallback callback) {
+  // Zeros are allocated through the context when collectives need them.
+  // Check up front that it can, rather than fail the collective on all ranks.
+  if (device != CPU_DEVICE_ID) {
+    std::shared_ptr<Tensor> zeros;
+    Status status = context->AllocateZeros(1, HOROVOD_FLOAT32, &zeros);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+
+  Request message;
+  message.set_request_rank(horovod_global.controller->GetRank());
+  message.set_tensor_name(JOIN_TENSOR_NAME);
+  message.set_device(device);
+  message.set_request_type(Request::JOIN);
+
+  TensorTableEntry e;
+  e.tensor_name = JOIN_TENSOR_NAME;
+  e.context = context;
+  e.device = device;
+  e.callback = callback;
+
+  if (horovod_global.shut_down) {
+    return SHUT_DOWN_ERROR;
+  }
+  Status status = horovod_global.tensor_queue.AddToTensorQueue(e, message);
+  if (status.ok()) {
+    LOG(TRACE, horovod_global.controller->GetRank()) << "Joined";
+  }
+  return status;
+}
+
 } // namespace common
 } // namespace horovod
@@ -44,6 +44,11 @@ void horovod_init_comm(MPI_Comm comm);
 // C interface to shut down Horovod.
 void horovod_shutdown();
 
+// C interface to rebuild the communicators after a membership change, with
+// the ranks and sizes read from the environment again. Only supported with
+// Gloo. Returns 1 on success, 0 otherwise.
+int horovod_reset();
+
 // C interface to get index of current Horovod process.
 // Returns -1 if Horovod is not initialized.
 int horovod_rank();
@@ -60,6 +65,22 @@ int horovod_size();
 // Returns -1 if Horovod is not initialized.
 int horovod_local_size();
 
+// C interface to register the process set of the given ranks, for allreduces
+// among them that do not wait for the other ranks. All ranks must register
+// the same sets in the same order before any of them enqueues a tensor to
+// one. Returns the id of the set, the same if the ranks were registered
+// before, or -1 if Horovod is not initialized or the ranks are invalid.
+int horovod_add_process_set(const int* ranks, int nranks);
+
+// C interface to return the rank of this process within the process set, or
+// -1 if it is not a member, the set is not registered or Horovod is not
+// initialized.
+int horovod_process_set_rank(int process_set_id);
+
+// C interface to return the number of processes in the process set, or -1 if
+// the set is not registered or Horovod is not initialized.
+int horovod_process_set_size(int process_set_id);
+
 // C interface to return flag indicating whether MPI multi-threading is
 // supported. Returns -1 if Horovod is not initialized.
 int horovod_mpi_threads_supported();
@@ -85,6 +106,73 @@ bool horovod_ddl_built();
 // C interface to return flag indicating whether Horovod was compiled with MLSL support.
 bool horovod_mlsl_built();
 
+// C interface to render the runtime metrics in the Prometheus text format.
+// Copies at most buffer_size - 1 characters and a terminating null into
+// buffer, and returns the full length of the text. Returns -1 if Horovod is
+// not initialized.
+int horovod_metrics(char* buffer, int buffer_size);
+
+// Statistics of a phase of the background loop or of a collective operation
+// class, as filled by horovod_get_stats. Times are in microseconds.
+// Percentiles are upper bounds of histogram buckets, within an eighth of the
+// observed time for all but the negotiation phase.
+struct HorovodStats {
+  char name[64];
+  uint64_t count;
+  uint64_t bytes;
+  uint64_t total_us;
+  uint64_t p50_us;
+  uint64_t p90_us;
+  uint64_t p99_us;
+};
+
+// C interface to fill at most max_stats entries of stats with the cycle,
+// negotiation, wait_for_data, memcpy and collective phases, in that order,
+// followed by every collective operation class under its class name, and by
+// the memory held in fusion_buffers and, on GPU builds, in pinned
+// host_buffers, whose count is the number of buffers, bytes their current
+// size and times zero. Returns the number of entries available, or -1 if
+// Horovod is not initialized.
+int horovod_get_stats(HorovodStats* stats, int max_stats);
+
+// C interface to list the class names of the allreduce operations of this
+// build, one per line in the order they are tried. Copies into buffer like
+// horovod_metrics, and returns -1 if Horovod is not initialized.
+int horovod_allreduce_ops(char* buffer, int buffer_size);
+
+// C interface to run the following allreduces on the operation at the given
+// index of horovod_allreduce_ops only, or on the first enabled one again if
+// index is negative. Allreduces fail if the operation is not enabled for them.
+// All ranks must switch between the same collectives, with none of them in
+// flight. Returns false if Horovod is not initialized or index is out of
+// range.
+bool horovod_set_allreduce_op(int index);
+
+// C interface to set tuning parameters of all ranks at runtime, on the
+// coordinator (rank 0). Negative values leave a parameter unchanged, others
+// are fixed and no longer autotuned. They are sent to all ranks at the end of
+// the next cycle, once its collectives are done, so that every rank applies
+// them between the same collectives. Changing the cache capacity clears the
+// response cache. Returns false if Horovod is not initialized or this is not
+// the coordinator.
+bool horovod_set_parameters(int64_t fusion_threshold_bytes,
+                            double cycle_time_ms, int cache_capacity,
+                            int hierarchical_allreduce,
+                            int hierarchical_allgather);
+
+// C interface to start recording the timeline of this rank to a file at
+// runtime, overwriting it, or to switch to another file. Only tensors whose
+// negotiation or operation starts after this call are recorded. On the
+// coordinator, negotiations of cached tensors are recorded from the end of
+// the next cycle on. Returns false if Horovod is not initialized or the file
+// could not be opened.
+bool horovod_start_timeline(const char* file_name, bool mark_cycles);
+
+// C interface to stop recording the timeline of this rank, once the events
+// recorded so far are written out. Returns false if Horovod is not
+// initialized.
+bool horovod_stop_timeline();
+
 }
 
 Status EnqueueTensorAllreduce(std::shared_ptr<OpContext> context,
@@ -92,7 +180,42 @@ Status EnqueueTensorAllreduce(std::shared_ptr<OpContext> context,
                               std::shared_ptr<Tensor> output,
                               std::shared_ptr<ReadyEvent> ready_event,
                               const std::string name, const int device,
-                              StatusCallback callback);
+                              StatusCallback callback,
+                              int32_t priority = 0,
+                              double prescale_factor = 1.0,
+                              double postscale_factor = 1.0,
+                              ReduceOp reduce_op = ReduceOp::SUM,
+                              int32_t process_set_id = 0,
+                              Compression compression = Compression::NONE,
+                              bool accumulate = false);
+
+// Enqueues the allreduces of a named group of tensors of one type and device.
+// The group is negotiated as a single request, and its tensors are fused
+// together, in order and split only at the fusion threshold. Tensors used in
+// a group must not be enqueued on their own under the same names.
+Status EnqueueTensorAllreduces(
+    std::vector<std::shared_ptr<OpContext>>& contexts,
+    std::vector<std::shared_ptr<Tensor>>& tensors,
+    std::vector<std::shared_ptr<Tensor>>& outputs,
+    std::vector<std::shared_ptr<ReadyEvent>>& ready_events,
+    std::vector<std::string>& names, const std::string& group_name,
+    const int device, std::vector<StatusCallback>& callbacks,
+    int32_t priority = 0, double prescale_factor = 1.0,
+    double postscale_factor = 1.0, ReduceOp reduce_op = ReduceOp::SUM,
+    Compression compression = Compression::NONE);
+
+// Allreduces tensors of one type and GPU into the outputs on the given CUDA
+// stream, a cudaStream_t, from the calling thread, so that the collective can
+// be captured in a CUDA graph along with the framework's kernels. Requires
+// NCCL and HOROVOD_CUDA_GRAPH=1. The tensors are not negotiated: all ranks
+// must allreduce the same groups in the same order, as a static graph does,
+// and must run each group once before capturing it.
+Status CapturableAllreduce(std::vector<std::shared_ptr<Tensor>>& tensors,
+                           std::vector<std::shared_ptr<Tensor>>& outputs,
+                           const int device, void* stream,
+                           double prescale_factor = 1.0,
+                           double postscale_factor = 1.0,
+                           ReduceOp reduce_op = ReduceOp::SUM);
 
 Status EnqueueTensorAllgather(std::shared_ptr<OpContext> context,
                               std::shared_ptr<Tensor> tensor,
@@ -107,6 +230,31 @@ Status EnqueueTensorBroadcast(std::shared_ptr<OpContext> context,
                               const std::string name, const int device,
                               StatusCallback callback);
 
+// The output holds the rows of the summed tensor that belong to this rank.
+// Rows are split evenly, and the first dim0 % size ranks get one more row.
+Status EnqueueTensorReducescatter(std::shared_ptr<OpContext> context,
+                                  std::shared_ptr<Tensor> tensor,
+                                  std::shared_ptr<ReadyEvent> ready_event,
+                                  const std::string name, const int device,
+                                  StatusCallback callback);
+
+// Splits gives the number of first dimension rows sent to each rank, in rank
+// order. If it is empty, the rows are split evenly.
+Status EnqueueTensorAlltoall(std::shared_ptr<OpContext> context,
+                             std::shared_ptr<Tensor> tensor,
+                             const std::vector<int64_t>& splits,
+                             std::shared_ptr<ReadyEvent> ready_event,
+                             const std::string name, const int device,
+                             StatusCallback callback);
+
+// Declares that this rank has no more tensors to submit, e.g. because it ran
+// out of data. Until every rank joined, this rank takes part with zeros on
+// the device in the sum allreduces and broadcasts of the other ranks, which
+// must not use other collectives. The callback is called once all ranks
+// joined.
+Status EnqueueJoin(std::shared_ptr<OpContext> context, const int device,
+                   StatusCallback callback);
+
 } // namespace common
 } // namespace horovod
 
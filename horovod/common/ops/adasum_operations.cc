@@ -0,0 +1,473 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "adasum_operations.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "../half.h"
+
+#if __x86_64__
+#include <immintrin.h>
+#endif
+
+namespace horovod {
+namespace common {
+
+namespace {
+
+// Dot products and norms are accumulated in double, so that the coefficients
+// of large float tensors do not lose precision.
+template <typename T>
+void DotAndNormsScalar(const T* a, const T* b, int64_t n, double* out) {
+  double dot = 0.0;
+  double anormsq = 0.0;
+  double bnormsq = 0.0;
+  for (int64_t i = 0; i < n; ++i) {
+    double x = a[i];
+    double y = b[i];
+    dot += x * y;
+    anormsq += x * x;
+    bnormsq += y * y;
+  }
+  out[0] += dot;
+  out[1] += anormsq;
+  out[2] += bnormsq;
+}
+
+template <typename T>
+void ScaledAddScalar(T* a, double acoeff, const T* b, double bcoeff,
+                     int64_t n) {
+  for (int64_t i = 0; i < n; ++i) {
+    a[i] = (T)(acoeff * a[i] + bcoeff * b[i]);
+  }
+}
+
+#if __x86_64__
+__attribute__((target("avx2,fma")))
+inline double HorizontalSumAVX2(__m256d v) {
+  __m128d sum = _mm_add_pd(_mm256_castpd256_pd128(v),
+                           _mm256_extractf128_pd(v, 1));
+  return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+}
+
+// Two sets of accumulators hide the latency of the fused multiply-adds.
+__attribute__((target("avx2,fma")))
+void FloatDotAndNormsAVX2(const float* a, const float* b, int64_t n,
+                          double* out) {
+  __m256d dot0 = _mm256_setzero_pd(), dot1 = _mm256_setzero_pd();
+  __m256d anorm0 = _mm256_setzero_pd(), anorm1 = _mm256_setzero_pd();
+  __m256d bnorm0 = _mm256_setzero_pd(), bnorm1 = _mm256_setzero_pd();
+  int64_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256d x0 = _mm256_cvtps_pd(_mm_loadu_ps(a + i));
+    __m256d x1 = _mm256_cvtps_pd(_mm_loadu_ps(a + i + 4));
+    __m256d y0 = _mm256_cvtps_pd(_mm_loadu_ps(b + i));
+    __m256d y1 = _mm256_cvtps_pd(_mm_loadu_ps(b + i + 4));
+    dot0 = _mm256_fmadd_pd(x0, y0, dot0);
+    dot1 = _mm256_fmadd_pd(x1, y1, dot1);
+    anorm0 = _mm256_fmadd_pd(x0, x0, anorm0);
+    anorm1 = _mm256_fmadd_pd(x1, x1, anorm1);
+    bnorm0 = _mm256_fmadd_pd(y0, y0, bnorm0);
+    bnorm1 = _mm256_fmadd_pd(y1, y1, bnorm1);
+  }
+  out[0] += HorizontalSumAVX2(_mm256_add_pd(dot0, dot1));
+  out[1] += HorizontalSumAVX2(_mm256_add_pd(anorm0, anorm1));
+  out[2] += HorizontalSumAVX2(_mm256_add_pd(bnorm0, bnorm1));
+  DotAndNormsScalar(a + i, b + i, n - i, out);
+}
+
+__attribute__((target("avx2,fma")))
+void DoubleDotAndNormsAVX2(const double* a, const double* b, int64_t n,
+                           double* out) {
+  __m256d dot = _mm256_setzero_pd();
+  __m256d anorm = _mm256_setzero_pd();
+  __m256d bnorm = _mm256_setzero_pd();
+  int64_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256d x = _mm256_loadu_pd(a + i);
+    __m256d y = _mm256_loadu_pd(b + i);
+    dot = _mm256_fmadd_pd(x, y, dot);
+    anorm = _mm256_fmadd_pd(x, x, anorm);
+    bnorm = _mm256_fmadd_pd(y, y, bnorm);
+  }
+  out[0] += HorizontalSumAVX2(dot);
+  out[1] += HorizontalSumAVX2(anorm);
+  out[2] += HorizontalSumAVX2(bnorm);
+  DotAndNormsScalar(a + i, b + i, n - i, out);
+}
+
+__attribute__((target("avx2,fma")))
+void FloatScaledAddAVX2(float* a, double acoeff, const float* b,
+                        double bcoeff, int64_t n) {
+  __m256 va = _mm256_set1_ps((float)acoeff);
+  __m256 vb = _mm256_set1_ps((float)bcoeff);
+  int64_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 x = _mm256_loadu_ps(a + i);
+    __m256 y = _mm256_loadu_ps(b + i);
+    _mm256_storeu_ps(a + i, _mm256_fmadd_ps(x, va, _mm256_mul_ps(y, vb)));
+  }
+  ScaledAddScalar(a + i, acoeff, b + i, bcoeff, n - i);
+}
+
+__attribute__((target("avx2,fma")))
+void DoubleScaledAddAVX2(double* a, double acoeff, const double* b,
+                         double bcoeff, int64_t n) {
+  __m256d va = _mm256_set1_pd(acoeff);
+  __m256d vb = _mm256_set1_pd(bcoeff);
+  int64_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256d x = _mm256_loadu_pd(a + i);
+    __m256d y = _mm256_loadu_pd(b + i);
+    _mm256_storeu_pd(a + i, _mm256_fmadd_pd(x, va, _mm256_mul_pd(y, vb)));
+  }
+  ScaledAddScalar(a + i, acoeff, b + i, bcoeff, n - i);
+}
+#endif
+
+struct AdasumKernels {
+  void (*float_dot_and_norms)(const float*, const float*, int64_t, double*);
+  void (*double_dot_and_norms)(const double*, const double*, int64_t,
+                               double*);
+  void (*float_scaled_add)(float*, double, const float*, double, int64_t);
+  void (*double_scaled_add)(double*, double, const double*, double, int64_t);
+};
+
+AdasumKernels SelectKernels() {
+  AdasumKernels k = {&DotAndNormsScalar<float>, &DotAndNormsScalar<double>,
+                     &ScaledAddScalar<float>, &ScaledAddScalar<double>};
+#if __x86_64__
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    k = {&FloatDotAndNormsAVX2, &DoubleDotAndNormsAVX2, &FloatScaledAddAVX2,
+         &DoubleScaledAddAVX2};
+  }
+#endif
+  return k;
+}
+
+const AdasumKernels& Kernels() {
+  static const AdasumKernels kernels = SelectKernels();
+  return kernels;
+}
+
+// Half precision values are converted to float in blocks on the stack.
+constexpr int64_t HALF_BLOCK_ELEMENTS = 1024;
+
+using HalfToFloat = void (*)(const uint16_t*, float*, int64_t);
+using FloatToHalf = void (*)(const float*, uint16_t*, int64_t);
+
+void HalfDotAndNorms(const uint16_t* a, const uint16_t* b, int64_t n,
+                     double* out, HalfToFloat to_float) {
+  float x[HALF_BLOCK_ELEMENTS];
+  float y[HALF_BLOCK_ELEMENTS];
+  for (int64_t i = 0; i < n; i += HALF_BLOCK_ELEMENTS) {
+    int64_t count = std::min(HALF_BLOCK_ELEMENTS, n - i);
+    to_float(a + i, x, count);
+    to_float(b + i, y, count);
+    Kernels().float_dot_and_norms(x, y, count, out);
+  }
+}
+
+void HalfScaledAdd(uint16_t* a, double acoeff, const uint16_t* b,
+                   double bcoeff, int64_t n, HalfToFloat to_float,
+                   FloatToHalf from_float) {
+  float x[HALF_BLOCK_ELEMENTS];
+  float y[HALF_BLOCK_ELEMENTS];
+  for (int64_t i = 0; i < n; i += HALF_BLOCK_ELEMENTS) {
+    int64_t count = std::min(HALF_BLOCK_ELEMENTS, n - i);
+    to_float(a + i, x, count);
+    to_float(b + i, y, count);
+    Kernels().float_scaled_add(x, acoeff, y, bcoeff, count);
+    from_float(x, a + i, count);
+  }
+}
+
+void DotAndNorms(DataType dtype, const void* a, const void* b, int64_t n,
+                 double* out) {
+  switch (dtype) {
+  case HOROVOD_FLOAT16:
+    HalfDotAndNorms((const uint16_t*)a, (const uint16_t*)b, n, out,
+                    Float16ToFloat);
+    break;
+  case HOROVOD_BFLOAT16:
+    HalfDotAndNorms((const uint16_t*)a, (const uint16_t*)b, n, out,
+                    BFloat16ToFloat);
+    break;
+  case HOROVOD_FLOAT32:
+    Kernels().float_dot_and_norms((const float*)a, (const float*)b, n, out);
+    break;
+  case HOROVOD_FLOAT64:
+    Kernels().double_dot_and_norms((const double*)a, (const double*)b, n,
+                                   out);
+    break;
+  default:
+    throw std::logic_error("Adasum does not support type " +
+                           DataType_Name(dtype) + ".");
+  }
+}
+
+void ScaledAdd(DataType dtype, void* a, double acoeff, const void* b,
+               double bcoeff, int64_t n) {
+  switch (dtype) {
+  case HOROVOD_FLOAT16:
+    HalfScaledAdd((uint16_t*)a, acoeff, (const uint16_t*)b, bcoeff, n,
+                  Float16ToFloat, FloatToFloat16);
+    break;
+  case HOROVOD_BFLOAT16:
+    HalfScaledAdd((uint16_t*)a, acoeff, (const uint16_t*)b, bcoeff, n,
+                  BFloat16ToFloat, FloatToBFloat16);
+    break;
+  case HOROVOD_FLOAT32:
+    Kernels().float_scaled_add((float*)a, acoeff, (const float*)b, bcoeff, n);
+    break;
+  case HOROVOD_FLOAT64:
+    Kernels().double_scaled_add((double*)a, acoeff, (const double*)b, bcoeff,
+                                n);
+    break;
+  default:
+    throw std::logic_error("Adasum does not support type " +
+                           DataType_Name(dtype) + ".");
+  }
+}
+
+// Coefficient of a vector with the given squared norm. A zero vector
+// contributes nothing, and the other one is kept as is.
+double AdasumCoefficient(double dot, double normsq) {
+  return normsq > 0.0 ? 1.0 - dot / (2.0 * normsq) : 1.0;
+}
+
+void CheckMPI(int op, const char* name) {
+  if (op != MPI_SUCCESS) {
+    throw std::runtime_error(std::string(name) +
+                             " failed, see MPI output for details.");
+  }
+}
+
+} // namespace
+
+AdasumMPI::AdasumMPI(MPIContext* mpi_context, HorovodGlobalState* global_state)
+    : mpi_context_(mpi_context), global_state_(global_state) {}
+
+void AdasumMPI::AccumulateStats(const void* a, const void* b, int64_t begin,
+                                int64_t count, bool swap) {
+  auto& ends = *tensor_ends_;
+  int64_t first = buffer_offset_ + begin;
+  int64_t last = first + count;
+  size_t t = std::upper_bound(ends.begin(), ends.end(), first) - ends.begin();
+  for (; t < ends.size() && first < last; ++t) {
+    int64_t piece = std::min(ends[t], last) - first;
+    int64_t offset = (first - buffer_offset_ - begin) * element_size_;
+    double out[3] = {0.0, 0.0, 0.0};
+    DotAndNorms(dtype_, (const uint8_t*)a + offset, (const uint8_t*)b + offset,
+                piece, out);
+    stats_[3 * t] += out[0];
+    stats_[3 * t + (swap ? 2 : 1)] += out[1];
+    stats_[3 * t + (swap ? 1 : 2)] += out[2];
+    first += piece;
+  }
+}
+
+void AdasumMPI::Combine(void* a, const void* b, int64_t begin, int64_t count,
+                        bool swap) {
+  auto& ends = *tensor_ends_;
+  int64_t first = buffer_offset_ + begin;
+  int64_t last = first + count;
+  size_t t = std::upper_bound(ends.begin(), ends.end(), first) - ends.begin();
+  for (; t < ends.size() && first < last; ++t) {
+    int64_t piece = std::min(ends[t], last) - first;
+    int64_t offset = (first - buffer_offset_ - begin) * element_size_;
+    double dot = stats_[3 * t];
+    double lower_coeff = AdasumCoefficient(dot, stats_[3 * t + 1]);
+    double upper_coeff = AdasumCoefficient(dot, stats_[3 * t + 2]);
+    ScaledAdd(dtype_, (uint8_t*)a + offset, swap ? upper_coeff : lower_coeff,
+              (const uint8_t*)b + offset, swap ? lower_coeff : upper_coeff,
+              piece);
+    first += piece;
+  }
+}
+
+void AdasumMPI::ReduceStats(MPI_Comm comm, int rank, int distance,
+                            const Communicator* stats_comm) {
+  // Addition is commutative, so both partners of an exchange end up with the
+  // same bits, and the ranks of the group agree on the coefficients.
+  int count = (int)stats_.size();
+  stats_recv_.resize(stats_.size());
+  for (int mask = 1; mask <= distance; mask <<= 1) {
+    CheckMPI(MPI_Sendrecv(stats_.data(), count, MPI_DOUBLE, rank ^ mask, 0,
+                          stats_recv_.data(), count, MPI_DOUBLE, rank ^ mask,
+                          0, comm, MPI_STATUS_IGNORE),
+             "MPI_Sendrecv");
+    for (int i = 0; i < count; ++i) {
+      stats_[i] += stats_recv_[i];
+    }
+  }
+  if (stats_comm != nullptr) {
+    CheckMPI(MPI_Allreduce(MPI_IN_PLACE, stats_.data(), count, MPI_DOUBLE,
+                           MPI_SUM,
+                           mpi_context_->GetMPICommunicator(*stats_comm)),
+             "MPI_Allreduce");
+  }
+}
+
+void AdasumMPI::Allreduce(void* buffer, int64_t num_elements, DataType dtype,
+                          const std::vector<int64_t>& tensor_ends,
+                          int64_t buffer_offset, Communicator comm_id,
+                          const Communicator* stats_comm) {
+  auto comm = mpi_context_->GetMPICommunicator(comm_id);
+  auto datatype = mpi_context_->GetMPIDataType(dtype);
+  int rank;
+  int size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+
+  dtype_ = dtype;
+  element_size_ = mpi_context_->GetMPITypeSize(dtype);
+  buffer_offset_ = buffer_offset;
+  tensor_ends_ = &tensor_ends;
+  stats_.resize(3 * tensor_ends.size());
+  auto data = (uint8_t*)buffer;
+
+  int pof2 = 1;
+  while (pof2 * 2 <= size) {
+    pof2 *= 2;
+  }
+  int rem = size - pof2;
+
+  // Ranks beyond the largest power of two hand their buffer to a partner and
+  // wait for the result.
+  if (rank >= pof2) {
+    CheckMPI(MPI_Send(data, (int)num_elements, datatype, rank - pof2, 0, comm),
+             "MPI_Send");
+    CheckMPI(MPI_Recv(data, (int)num_elements, datatype, rank - pof2, 0, comm,
+                      MPI_STATUS_IGNORE),
+             "MPI_Recv");
+    return;
+  }
+
+  recv_buffer_.resize(
+      (rank < rem ? num_elements : num_elements / 2 + 1) * element_size_);
+  void* recv_data = recv_buffer_.data();
+
+  if (rank < rem) {
+    CheckMPI(MPI_Recv(recv_data, (int)num_elements, datatype, rank + pof2, 0,
+                      comm, MPI_STATUS_IGNORE),
+             "MPI_Recv");
+    std::fill(stats_.begin(), stats_.end(), 0.0);
+    AccumulateStats(data, recv_data, 0, num_elements, false);
+    ReduceStats(comm, rank, 0, stats_comm);
+    Combine(data, recv_data, 0, num_elements, false);
+  }
+
+  // Segment [begin, begin + count) of the buffer held before each level.
+  std::vector<std::pair<int64_t, int64_t>> segments;
+  int64_t begin = 0;
+  int64_t count = num_elements;
+  for (int distance = 1; distance < pof2; distance <<= 1) {
+    int partner = rank ^ distance;
+    bool lower = (rank & distance) == 0;
+    int64_t lower_count = count / 2;
+    int64_t keep_begin = lower ? begin : begin + lower_count;
+    int64_t keep_count = lower ? lower_count : count - lower_count;
+    int64_t send_begin = lower ? begin + lower_count : begin;
+    CheckMPI(MPI_Sendrecv(data + send_begin * element_size_,
+                          (int)(count - keep_count), datatype, partner, 0,
+                          recv_data, (int)keep_count, datatype, partner, 0,
+                          comm, MPI_STATUS_IGNORE),
+             "MPI_Sendrecv");
+
+    std::fill(stats_.begin(), stats_.end(), 0.0);
+    void* keep_data = data + keep_begin * element_size_;
+    AccumulateStats(keep_data, recv_data, keep_begin, keep_count, !lower);
+    ReduceStats(comm, rank, distance, stats_comm);
+    Combine(keep_data, recv_data, keep_begin, keep_count, !lower);
+
+    segments.emplace_back(begin, count);
+    begin = keep_begin;
+    count = keep_count;
+  }
+
+  // Gather the combined segments back, the partner holding the other half of
+  // the parent segment.
+  for (int level = (int)segments.size() - 1; level >= 0; --level) {
+    int partner = rank ^ (1 << level);
+    bool lower = (rank & (1 << level)) == 0;
+    auto& parent = segments[level];
+    int64_t partner_begin = lower ? parent.first + count : parent.first;
+    int64_t partner_count = parent.second - count;
+    CheckMPI(MPI_Sendrecv(data + begin * element_size_, (int)count, datatype,
+                          partner, 0, data + partner_begin * element_size_,
+                          (int)partner_count, datatype, partner, 0, comm,
+                          MPI_STATUS_IGNORE),
+             "MPI_Sendrecv");
+    begin = parent.first;
+    count = parent.second;
+  }
+
+  if (rank < rem) {
+    CheckMPI(MPI_Send(data, (int)num_elements, datatype, rank + pof2, 0, comm),
+             "MPI_Send");
+  }
+}
+
+std::vector<int64_t>
+AdasumTensorEnds(const std::vector<TensorTableEntry>& entries) {
+  std::vector<int64_t> ends;
+  ends.reserve(entries.size());
+  int64_t end = 0;
+  for (auto& e : entries) {
+    end += e.tensor->shape().num_elements();
+    ends.push_back(end);
+  }
+  return ends;
+}
+
+AdasumMPIAllreduce::AdasumMPIAllreduce(MPIContext* mpi_context,
+                                       HorovodGlobalState* global_state)
+    : MPIAllreduce(mpi_context, global_state),
+      adasum_(mpi_context, global_state) {}
+
+bool AdasumMPIAllreduce::Enabled(const ParameterManager& param_manager,
+                                 const std::vector<TensorTableEntry>& entries,
+                                 const Response& response) const {
+  return response.reduce_op() == ReduceOp::ADASUM &&
+         entries[0].device == CPU_DEVICE_ID;
+}
+
+bool AdasumMPIAllreduce::StartAllreduce(
+    std::vector<TensorTableEntry>& entries, const void* fused_input_data,
+    void* buffer_data, int64_t num_elements, DataType dtype, size_t buffer_len,
+    MPI_Request& request) {
+  return false;
+}
+
+void AdasumMPIAllreduce::DoAllreduce(std::vector<TensorTableEntry>& entries,
+                                     const void* fused_input_data,
+                                     void* buffer_data, int64_t num_elements,
+                                     DataType dtype, size_t buffer_len) {
+  // The combination is computed in place.
+  if (fused_input_data != buffer_data) {
+    std::memcpy(buffer_data, fused_input_data, buffer_len);
+  }
+  auto& timeline = global_state_->timeline;
+  timeline.ActivityStartAll(entries, ADASUM_ALLREDUCE);
+  adasum_.Allreduce(buffer_data, num_elements, dtype, AdasumTensorEnds(entries),
+                    0, Communicator::GLOBAL);
+  timeline.ActivityEndAll(entries);
+}
+
+} // namespace common
+} // namespace horovod
@@ -0,0 +1,123 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HOROVOD_ADASUM_OPERATIONS_H
+#define HOROVOD_ADASUM_OPERATIONS_H
+
+#include <vector>
+
+#include "mpi.h"
+
+#include "mpi_operations.h"
+
+namespace horovod {
+namespace common {
+
+// Combines two gradients a and b of one tensor into
+//   (1 - a.b / (2 |a|^2)) a + (1 - a.b / (2 |b|^2)) b,
+// which is their sum when they are orthogonal and their average when they are
+// equal, so that the result does not grow with the number of ranks.
+//
+// The ranks are combined by recursive vector halving: at every level each
+// rank pairs with the rank at distance 1, 2, 4, ..., keeps one half of its
+// current segment and receives the partner's data for that half. The dot
+// product and norms of the whole tensors are the sums of those of the
+// segments, which are allreduced over the group of ranks that combine the
+// same two vectors at that level. Segments are then gathered back in reverse
+// order. Ranks beyond the largest power of two first fold their buffer into a
+// partner and receive the result at the end.
+class AdasumMPI {
+public:
+  AdasumMPI(MPIContext* mpi_context, HorovodGlobalState* global_state);
+
+  // Combines buffer in place across the ranks of comm. The buffer holds
+  // num_elements values of dtype, which must be a floating point type, from
+  // element buffer_offset of a fused buffer in which tensor i ends at element
+  // tensor_ends[i]. Elements past the last tensor are padding and are left
+  // unchanged. With stats_comm set, the dot products and norms are also
+  // summed over the ranks of stats_comm, which hold the other elements of the
+  // fused buffer and take the same steps over comm.
+  void Allreduce(void* buffer, int64_t num_elements, DataType dtype,
+                 const std::vector<int64_t>& tensor_ends,
+                 int64_t buffer_offset, Communicator comm,
+                 const Communicator* stats_comm = nullptr);
+
+private:
+  // Adds the dot product of a and b and their squared norms over the
+  // elements [begin, begin + count) of the buffer to the statistics of the
+  // tensors they belong to, the norm of a first unless swap is set.
+  void AccumulateStats(const void* a, const void* b, int64_t begin,
+                       int64_t count, bool swap);
+
+  // Replaces a with the combination of a and b over the elements
+  // [begin, begin + count), a holding the vector of the lower ranks unless
+  // swap is set.
+  void Combine(void* a, const void* b, int64_t begin, int64_t count,
+               bool swap);
+
+  // Sums the statistics over the group of 2 * distance ranks of comm that
+  // rank belongs to, and over stats_comm if it is set.
+  void ReduceStats(MPI_Comm comm, int rank, int distance,
+                   const Communicator* stats_comm);
+
+  MPIContext* mpi_context_;
+  HorovodGlobalState* global_state_;
+
+  // State of the current Allreduce.
+  DataType dtype_;
+  int element_size_;
+  int64_t buffer_offset_;
+  const std::vector<int64_t>* tensor_ends_;
+
+  // Dot product and squared norms of the lower and upper vectors, per tensor.
+  std::vector<double> stats_;
+  std::vector<double> stats_recv_;
+
+  // Receives the partner's half in each exchange.
+  std::vector<uint8_t> recv_buffer_;
+};
+
+// Allreduces CPU tensors with the Adasum combination across all ranks.
+class AdasumMPIAllreduce : public MPIAllreduce {
+public:
+  AdasumMPIAllreduce(MPIContext* mpi_context,
+                     HorovodGlobalState* global_state);
+
+  bool Enabled(const ParameterManager& param_manager,
+               const std::vector<TensorTableEntry>& entries,
+               const Response& response) const override;
+
+protected:
+  void DoAllreduce(std::vector<TensorTableEntry>& entries,
+                   const void* fused_input_data, void* buffer_data,
+                   int64_t num_elements, DataType dtype,
+                   size_t buffer_len) override;
+
+  bool StartAllreduce(std::vector<TensorTableEntry>& entries,
+                      const void* fused_input_data, void* buffer_data,
+                      int64_t num_elements, DataType dtype, size_t buffer_len,
+                      MPI_Request& request) override;
+
+  AdasumMPI adasum_;
+};
+
+// Element index at which each entry ends in the fused buffer.
+std::vector<int64_t>
+AdasumTensorEnds(const std::vector<TensorTableEntry>& entries);
+
+} // namespace common
+} // namespace horovod
+
+#endif // HOROVOD_ADASUM_OPERATIONS_H
@@ -16,9 +16,114 @@
 
 #include "collective_operations.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+#include "../half.h"
+
 namespace horovod {
 namespace common {
 
+namespace {
+
+// Times a copy of host tensors into or out of a fusion buffer, for the
+// metrics. Copies of GPU tensors are asynchronous and not recorded.
+class MemcpyTimer {
+public:
+  MemcpyTimer(HorovodGlobalState* state,
+              const std::vector<TensorTableEntry>& entries)
+      : metrics_(entries[0].device == CPU_DEVICE_ID ? &state->metrics
+                                                     : nullptr),
+        start_(std::chrono::steady_clock::now()) {}
+
+  void Record(int64_t bytes) {
+    if (metrics_ != nullptr) {
+      metrics_->memcpy_time_us.Observe(
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              std::chrono::steady_clock::now() - start_).count());
+      metrics_->memcpy_bytes.Add(bytes);
+    }
+  }
+
+private:
+  Metrics* metrics_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+// Smallest number of bytes worth handing to a separate memcpy thread.
+#define PARALLEL_MEMCPY_MIN_BYTES (1 << 20)
+
+struct MemcpyRegion {
+  void* dst;
+  const void* src;
+  size_t size;
+};
+
+// Copies the regions, which are laid out back to back in the fusion buffer,
+// by splitting their total byte range evenly across the thread pool.
+void ParallelMemcpy(ThreadPool& pool, const std::vector<MemcpyRegion>& regions,
+                    size_t total_bytes) {
+  int num_tasks = (int)std::min<size_t>(
+      pool.num_threads() + 1,
+      std::max<size_t>(total_bytes / PARALLEL_MEMCPY_MIN_BYTES, 1));
+  size_t chunk = (total_bytes + num_tasks - 1) / num_tasks;
+
+  pool.ParallelFor(num_tasks, [&](int task) {
+    size_t begin = task * chunk;
+    size_t end = std::min(begin + chunk, total_bytes);
+    size_t offset = 0;
+    for (auto& r : regions) {
+      size_t lo = std::max(begin, offset);
+      size_t hi = std::min(end, offset + r.size);
+      if (lo < hi) {
+        std::memcpy((uint8_t*)r.dst + (lo - offset),
+                    (const uint8_t*)r.src + (lo - offset), hi - lo);
+      }
+      offset += r.size;
+      if (offset >= end) {
+        break;
+      }
+    }
+  });
+}
+
+// Number of float32 values scaled at a time on the stack when converting
+// between float32 and 16-bit types.
+#define SCALE_CHUNK_ELEMENTS 1024
+
+template <typename T>
+void ScaleValues(double factor, const T* input, T* output, int64_t n) {
+  for (int64_t i = 0; i < n; ++i) {
+    output[i] = (T)(input[i] * factor);
+  }
+}
+
+// Scales 16-bit floating point values through float32, chunk by chunk.
+template <typename ToFloat, typename FromFloat>
+void ScaleHalfValues(double factor, const uint16_t* input, uint16_t* output,
+                     int64_t n, ToFloat to_float, FromFloat from_float) {
+  float chunk[SCALE_CHUNK_ELEMENTS];
+  for (int64_t i = 0; i < n; i += SCALE_CHUNK_ELEMENTS) {
+    int64_t k = std::min<int64_t>(SCALE_CHUNK_ELEMENTS, n - i);
+    to_float(input + i, chunk, k);
+    ScaleValues(factor, chunk, chunk, k);
+    from_float(chunk, output + i, k);
+  }
+}
+
+// Number of elements in a slice of the tensor along its first dimension.
+int64_t SliceElements(const TensorShape& shape) {
+  int64_t elements = 1;
+  for (int i = 1; i < shape.dims(); ++i) {
+    elements *= shape.dim_size(i);
+  }
+  return elements;
+}
+
+} // namespace
+
 HorovodOp::HorovodOp(HorovodGlobalState* global_state)
     : global_state_(global_state) {}
 
@@ -30,13 +135,38 @@ int64_t HorovodOp::NumElements(std::vector<TensorTableEntry>& entries) {
   return num_elements;
 }
 
+std::shared_ptr<PersistentBuffer>
+HorovodOp::CurrentFusionBuffer(const TensorTableEntry& first_entry) const {
+  return global_state_->fusion_buffer.GetBuffer(
+      first_entry.device, first_entry.context->framework(),
+      global_state_->current_nccl_stream);
+}
+
 // Allreduce
 AllreduceOp::AllreduceOp(HorovodGlobalState* global_state)
     : HorovodOp(global_state) {}
 
+bool AllreduceOp::GetDirectBuffers(
+    const std::vector<TensorTableEntry>& entries, const void*& fused_input_data,
+    void*& buffer_data, size_t& buffer_len) const {
+  // Entries of a fused response always go through the fusion buffer, which
+  // lays them out in response order. Whether they happen to be contiguous in
+  // framework memory differs between ranks, and mixing layouts would reduce
+  // mismatched elements.
+  if (entries.size() != 1) {
+    return false;
+  }
+  auto& e = entries[0];
+  fused_input_data = e.tensor->data();
+  buffer_data = (void*)e.output->data();
+  buffer_len = (size_t)e.output->size();
+  return true;
+}
+
 void AllreduceOp::MemcpyInFusionBuffer(
     const std::vector<TensorTableEntry>& entries, const void*& fused_input_data,
     void*& buffer_data, size_t& buffer_len) {
+  MemcpyTimer timer(global_state_, entries);
   // Access the fusion buffer.
   auto& first_entry = entries[0];
   auto buffer = global_state_->fusion_buffer.GetBuffer(
@@ -44,13 +174,25 @@ void AllreduceOp::MemcpyInFusionBuffer(
   buffer_data = const_cast<void*>(buffer->AccessData(first_entry.context));
 
   int64_t offset = 0;
-  for (auto& e : entries) {
-    void* buffer_data_at_offset = (uint8_t*)buffer_data + offset;
-    MemcpyEntryInFusionBuffer(entries, e, buffer_data_at_offset);
-    offset += e.tensor->size();
+  if (UseParallelMemcpy(entries)) {
+    std::vector<MemcpyRegion> regions;
+    regions.reserve(entries.size());
+    for (auto& e : entries) {
+      regions.push_back({(uint8_t*)buffer_data + offset, e.tensor->data(),
+                         (size_t)e.tensor->size()});
+      offset += e.tensor->size();
+    }
+    ParallelMemcpy(global_state_->fusion_memcpy_pool, regions, (size_t)offset);
+  } else {
+    for (auto& e : entries) {
+      void* buffer_data_at_offset = (uint8_t*)buffer_data + offset;
+      MemcpyEntryInFusionBuffer(entries, e, buffer_data_at_offset);
+      offset += e.tensor->size();
+    }
   }
 
   buffer_len = (size_t)offset;
+  timer.Record(offset);
 
   // Set the input data to originate from the buffer.
   fused_input_data = buffer_data;
@@ -58,26 +200,210 @@ void AllreduceOp::MemcpyInFusionBuffer(
 
 void AllreduceOp::MemcpyOutFusionBuffer(
     const void* buffer_data, std::vector<TensorTableEntry>& entries) {
+  MemcpyTimer timer(global_state_, entries);
   int64_t offset = 0;
+  if (UseParallelMemcpy(entries)) {
+    std::vector<MemcpyRegion> regions;
+    regions.reserve(entries.size());
+    for (auto& e : entries) {
+      regions.push_back({(void*)e.output->data(),
+                         (const uint8_t*)buffer_data + offset,
+                         (size_t)e.tensor->size()});
+      offset += e.tensor->size();
+    }
+    ParallelMemcpy(global_state_->fusion_memcpy_pool, regions, (size_t)offset);
+    timer.Record(offset);
+    return;
+  }
+
   for (auto& e : entries) {
     void* buffer_data_at_offset = (uint8_t*)buffer_data + offset;
     MemcpyEntryOutFusionBuffer(entries, buffer_data_at_offset, e);
     offset += e.tensor->size();
   }
+  timer.Record(offset);
+}
+
+bool AllreduceOp::UseParallelMemcpy(
+    const std::vector<TensorTableEntry>& entries) const {
+  if (entries[0].device != CPU_DEVICE_ID ||
+      global_state_->fusion_memcpy_pool.num_threads() == 0 ||
+      entries[0].prescale_factor != 1.0 || entries[0].postscale_factor != 1.0) {
+    return false;
+  }
+  int64_t total_bytes = 0;
+  for (auto& e : entries) {
+    total_bytes += e.tensor->size();
+  }
+  return total_bytes >= 2 * PARALLEL_MEMCPY_MIN_BYTES;
+}
+
+bool AllreduceOp::UseLatencyOptimizedAllreduce(size_t buffer_len) const {
+  // With two ranks both exchange the buffer once.
+  return global_state_->controller->GetSize() > 2 &&
+         (int64_t)buffer_len <=
+             global_state_->parameter_manager.CPUAllreduceLatencyThresholdBytes();
+}
+
+void AllreduceOp::ScaleBuffer(double factor,
+                              const std::vector<TensorTableEntry>& entries,
+                              const void* input, void* output,
+                              int64_t num_elements) {
+  auto dtype = entries[0].tensor->dtype();
+  switch (dtype) {
+  case HOROVOD_UINT8:
+    ScaleValues(factor, (const uint8_t*)input, (uint8_t*)output, num_elements);
+    break;
+  case HOROVOD_INT8:
+    ScaleValues(factor, (const int8_t*)input, (int8_t*)output, num_elements);
+    break;
+  case HOROVOD_UINT16:
+    ScaleValues(factor, (const uint16_t*)input, (uint16_t*)output,
+                num_elements);
+    break;
+  case HOROVOD_INT16:
+    ScaleValues(factor, (const int16_t*)input, (int16_t*)output, num_elements);
+    break;
+  case HOROVOD_INT32:
+    ScaleValues(factor, (const int32_t*)input, (int32_t*)output, num_elements);
+    break;
+  case HOROVOD_INT64:
+    ScaleValues(factor, (const int64_t*)input, (int64_t*)output, num_elements);
+    break;
+  case HOROVOD_FLOAT16:
+    ScaleHalfValues(factor, (const uint16_t*)input, (uint16_t*)output,
+                    num_elements, Float16ToFloat, FloatToFloat16);
+    break;
+  case HOROVOD_BFLOAT16:
+    ScaleHalfValues(factor, (const uint16_t*)input, (uint16_t*)output,
+                    num_elements, BFloat16ToFloat, FloatToBFloat16);
+    break;
+  case HOROVOD_FLOAT32:
+    ScaleValues(factor, (const float*)input, (float*)output, num_elements);
+    break;
+  case HOROVOD_FLOAT64:
+    ScaleValues(factor, (const double*)input, (double*)output, num_elements);
+    break;
+  default:
+    throw std::logic_error("Type " + DataType_Name(dtype) +
+                           " cannot be scaled.");
+  }
+}
+
+void AllreduceOp::PrescaleDirectBuffers(
+    const std::vector<TensorTableEntry>& entries,
+    const void*& fused_input_data, void* buffer_data, int64_t num_elements) {
+  auto& first_entry = entries[0];
+  if (first_entry.prescale_factor != 1.0) {
+    ScaleBuffer(first_entry.prescale_factor, entries, fused_input_data,
+                buffer_data, num_elements);
+    fused_input_data = buffer_data;
+  }
+}
+
+void AllreduceOp::PostscaleDirectBuffers(
+    const std::vector<TensorTableEntry>& entries, void* buffer_data,
+    int64_t num_elements) {
+  auto& first_entry = entries[0];
+  if (first_entry.postscale_factor != 1.0) {
+    ScaleBuffer(first_entry.postscale_factor, entries, buffer_data,
+                buffer_data, num_elements);
+  }
+}
+
+DataType AllreduceOp::WireDataType(
+    const std::vector<TensorTableEntry>& entries) const {
+  auto& first_entry = entries[0];
+  if (first_entry.device == CPU_DEVICE_ID &&
+      first_entry.tensor->dtype() == HOROVOD_FLOAT32 &&
+      first_entry.reduce_op == ReduceOp::SUM) {
+    return global_state_->cpu_compression;
+  }
+  return first_entry.tensor->dtype();
+}
+
+void AllreduceOp::CompressInFusionBuffer(
+    const std::vector<TensorTableEntry>& entries, DataType wire_dtype,
+    void*& buffer_data, size_t& buffer_len) {
+  auto& first_entry = entries[0];
+  if (entries.size() > 1) {
+    // The compressed entries take half the bytes, so they fit the buffer.
+    auto buffer = global_state_->fusion_buffer.GetBuffer(
+        first_entry.device, first_entry.context->framework(),
+        global_state_->current_nccl_stream);
+    buffer_data = const_cast<void*>(buffer->AccessData(first_entry.context));
+  } else {
+    compression_buffer_.resize(
+        (size_t)first_entry.tensor->shape().num_elements());
+    buffer_data = compression_buffer_.data();
+  }
+
+  auto convert = wire_dtype == HOROVOD_BFLOAT16 ? FloatToBFloat16
+                                                : FloatToFloat16;
+  double factor = first_entry.prescale_factor;
+  auto out = (uint16_t*)buffer_data;
+  for (auto& e : entries) {
+    auto src = (const float*)e.tensor->data();
+    int64_t n = e.tensor->shape().num_elements();
+    if (factor == 1.0) {
+      convert(src, out, n);
+    } else {
+      float chunk[SCALE_CHUNK_ELEMENTS];
+      for (int64_t i = 0; i < n; i += SCALE_CHUNK_ELEMENTS) {
+        int64_t k = std::min<int64_t>(SCALE_CHUNK_ELEMENTS, n - i);
+        ScaleValues(factor, src + i, chunk, k);
+        convert(chunk, out + i, k);
+      }
+    }
+    out += n;
+  }
+  buffer_len = (size_t)((uint8_t*)out - (uint8_t*)buffer_data);
+}
+
+void AllreduceOp::DecompressOutFusionBuffer(
+    const void* buffer_data, DataType wire_dtype,
+    std::vector<TensorTableEntry>& entries) {
+  auto convert = wire_dtype == HOROVOD_BFLOAT16 ? BFloat16ToFloat
+                                                : Float16ToFloat;
+  double factor = entries[0].postscale_factor;
+  auto in = (const uint16_t*)buffer_data;
+  for (auto& e : entries) {
+    auto dst = (float*)e.output->data();
+    int64_t n = e.tensor->shape().num_elements();
+    // Scale each chunk while it is still in cache.
+    for (int64_t i = 0; i < n; i += SCALE_CHUNK_ELEMENTS) {
+      int64_t k = std::min<int64_t>(SCALE_CHUNK_ELEMENTS, n - i);
+      convert(in + i, dst + i, k);
+      if (factor != 1.0) {
+        ScaleValues(factor, dst + i, dst + i, k);
+      }
+    }
+    in += n;
+  }
 }
 
 void AllreduceOp::MemcpyEntryInFusionBuffer(
     const std::vector<TensorTableEntry>& entries, const TensorTableEntry& e,
     void* buffer_data_at_offset) {
-  std::memcpy(buffer_data_at_offset, e.tensor->data(),
-              (size_t)e.tensor->size());
+  if (e.prescale_factor != 1.0) {
+    ScaleBuffer(e.prescale_factor, entries, e.tensor->data(),
+                buffer_data_at_offset, e.tensor->shape().num_elements());
+  } else {
+    std::memcpy(buffer_data_at_offset, e.tensor->data(),
+                (size_t)e.tensor->size());
+  }
 }
 
 void AllreduceOp::MemcpyEntryOutFusionBuffer(
     const std::vector<TensorTableEntry>& entries,
     const void* buffer_data_at_offset, TensorTableEntry& e) {
-  std::memcpy((void*)e.output->data(), buffer_data_at_offset,
-              (size_t)e.tensor->size());
+  if (e.postscale_factor != 1.0) {
+    ScaleBuffer(e.postscale_factor, entries, buffer_data_at_offset,
+                (void*)e.output->data(), e.tensor->shape().num_elements());
+  } else {
+    std::memcpy((void*)e.output->data(), buffer_data_at_offset,
+                (size_t)e.tensor->size());
+  }
 }
 
 // Allgather
@@ -87,8 +413,9 @@ AllgatherOp::AllgatherOp(HorovodGlobalState* global_state)
 Status AllgatherOp::AllocateOutput(std::vector<TensorTableEntry>& entries,
                                    const Response& response,
                                    int64_t**& entry_component_sizes,
-                                   int*& recvcounts) {
+                                   int64_t*& recvcounts) {
   int global_size = global_state_->controller->GetSize();
+  const auto& tensor_sizes = response.tensor_sizes();
   for (size_t ec = 0; ec < entries.size(); ++ec) {
     auto& e = entries[ec];
     // Every tensor participating in Allgather operation may have different
@@ -98,17 +425,17 @@ Status AllgatherOp::AllocateOutput(std::vector<TensorTableEntry>& entries,
     for (int i = 1; i < e.tensor->shape().dims(); ++i) {
       single_slice_shape.AddDim(e.tensor->shape().dim_size(i));
     }
+    int64_t slice_elements = single_slice_shape.num_elements();
 
     // Copy tensor sizes from the response into a vector of int64_t
     // and compute total size.  This is size of first dimension.
     int64_t total_entry_dimension_size = 0;
-    const auto& tensor_sizes = response.tensor_sizes();
+    const int64_t* component_sizes = tensor_sizes.data() + ec * global_size;
+    int64_t* entry_sizes = entry_component_sizes[ec];
     for (int rc = 0; rc < global_size; ++rc) {
-      auto component_size = tensor_sizes[ec * global_size + rc];
-      total_entry_dimension_size += component_size;
-      recvcounts[rc] += component_size * single_slice_shape.num_elements();
-      entry_component_sizes[ec][rc] =
-          component_size * single_slice_shape.num_elements();
+      total_entry_dimension_size += component_sizes[rc];
+      entry_sizes[rc] = component_sizes[rc] * slice_elements;
+      recvcounts[rc] += entry_sizes[rc];
     }
 
     // Allgather output will have shape of:
@@ -126,77 +453,293 @@ Status AllgatherOp::AllocateOutput(std::vector<TensorTableEntry>& entries,
   return Status::OK();
 }
 
-void AllgatherOp::SetDisplacements(const int* recvcounts, int*& displcmnts) {
+void AllgatherOp::SetDisplacements(const int64_t* recvcounts,
+                                   int64_t*& displcmnts) {
   int global_size = global_state_->controller->GetSize();
+  int64_t displacement = 0;
   for (int rc = 0; rc < global_size; ++rc) {
-    if (rc == 0) {
-      displcmnts[rc] = 0;
-    } else {
-      displcmnts[rc] = displcmnts[rc - 1] + recvcounts[rc - 1];
-    }
+    displcmnts[rc] = displacement;
+    displacement += recvcounts[rc];
   }
 }
 
 void AllgatherOp::SetEntryComponentOffsets(
     const std::vector<TensorTableEntry>& entries,
-    const int64_t* const* entry_component_sizes, const int* recvcounts,
+    const int64_t* const* entry_component_sizes, const int64_t* recvcounts,
     int64_t**& entry_component_offsets) {
-  unsigned int rank_displacement = 0;
   int global_size = global_state_->controller->GetSize();
+  // The first entry starts at the displacement of each rank, and every
+  // other entry after the previous one. Rows are walked along the ranks so
+  // that the inner loops run over contiguous memory.
+  int64_t* first_offsets = entry_component_offsets[0];
+  int64_t rank_displacement = 0;
   for (int rc = 0; rc < global_size; ++rc) {
-    for (size_t ec = 0; ec < entries.size(); ++ec) {
-      if (ec == 0) {
-        entry_component_offsets[ec][rc] = rank_displacement;
-      } else {
-        entry_component_offsets[ec][rc] = entry_component_offsets[ec - 1][rc] +
-                                          entry_component_sizes[ec - 1][rc];
-      }
-    }
+    first_offsets[rc] = rank_displacement;
     rank_displacement += recvcounts[rc];
   }
+  for (size_t ec = 1; ec < entries.size(); ++ec) {
+    const int64_t* previous_offsets = entry_component_offsets[ec - 1];
+    const int64_t* previous_sizes = entry_component_sizes[ec - 1];
+    int64_t* offsets = entry_component_offsets[ec];
+    for (int rc = 0; rc < global_size; ++rc) {
+      offsets[rc] = previous_offsets[rc] + previous_sizes[rc];
+    }
+  }
+}
+
+void AllgatherOp::GetScratchArrays(size_t num_entries,
+                                   int64_t**& entry_component_sizes,
+                                   int64_t**& entry_component_offsets,
+                                   int64_t*& recvcounts,
+                                   int64_t*& displcmnts) {
+  size_t global_size = (size_t)global_state_->controller->GetSize();
+  size_t num_values = num_entries * global_size;
+  if (component_sizes_.size() < num_values) {
+    component_sizes_.resize(num_values);
+    component_offsets_.resize(num_values);
+  }
+  if (recvcounts_.size() < global_size) {
+    recvcounts_.resize(global_size);
+    displcmnts_.resize(global_size);
+  }
+  // Row pointers depend on the global size, which changes with membership.
+  component_size_rows_.resize(num_entries);
+  component_offset_rows_.resize(num_entries);
+  for (size_t ec = 0; ec < num_entries; ++ec) {
+    component_size_rows_[ec] = component_sizes_.data() + ec * global_size;
+    component_offset_rows_[ec] = component_offsets_.data() + ec * global_size;
+  }
+  std::fill(recvcounts_.begin(), recvcounts_.begin() + global_size, 0);
+
+  entry_component_sizes = component_size_rows_.data();
+  entry_component_offsets = component_offset_rows_.data();
+  recvcounts = recvcounts_.data();
+  displcmnts = displcmnts_.data();
 }
 
 void AllgatherOp::MemcpyInFusionBuffer(
-    const std::vector<TensorTableEntry>& entries, const int* displcmnts,
+    const std::vector<TensorTableEntry>& entries, const int64_t* displcmnts,
     int element_size, void*& buffer_data) {
+  MemcpyTimer timer(global_state_, entries);
   // Access the fusion buffer.
   auto& first_entry = entries[0];
   auto buffer = global_state_->fusion_buffer.GetBuffer(
       first_entry.device, first_entry.context->framework(), global_state_->current_nccl_stream);
   buffer_data = const_cast<void*>(buffer->AccessData(first_entry.context));
 
-  int64_t offset = displcmnts[global_state_->controller->GetRank()] * element_size;
+  int64_t start = displcmnts[global_state_->controller->GetRank()] * element_size;
+  int64_t offset = start;
   for (auto& e : entries) {
     void* buffer_data_at_offset = (uint8_t*)buffer_data + offset;
-    std::memcpy(buffer_data_at_offset, e.tensor->data(),
+    MemcpyEntry(buffer_data_at_offset, e.tensor->data(),
                 (size_t)e.tensor->size());
     offset += e.tensor->size();
   }
+  timer.Record(offset - start);
 }
 
 void AllgatherOp::MemcpyOutFusionBuffer(
     const int64_t* const* entry_component_offsets,
     const int64_t* const* entry_component_sizes, const void* buffer_data,
     int element_size, std::vector<TensorTableEntry>& entries) {
+  MemcpyTimer timer(global_state_, entries);
   // Copy memory out of the fusion buffer.
   int global_size = global_state_->controller->GetSize();
+  int64_t bytes = 0;
   for (size_t ec = 0; ec < entries.size(); ++ec) {
     auto& e = entries[ec];
     int64_t copy_offset = 0;
     for (int rc = 0; rc < global_size; ++rc) {
       int64_t entry_offset = entry_component_offsets[ec][rc] * element_size;
       int64_t entry_size = entry_component_sizes[ec][rc] * element_size;
-      std::memcpy((void*)((uint8_t*)e.output->data() + copy_offset),
+      MemcpyEntry((void*)((uint8_t*)e.output->data() + copy_offset),
                   (void*)((uint8_t*)buffer_data + entry_offset),
                   (size_t)entry_size);
       copy_offset += entry_size;
     }
+    bytes += copy_offset;
   }
+  timer.Record(bytes);
+}
+
+void AllgatherOp::MemcpyEntry(void* dst, const void* src, size_t size) {
+  std::memcpy(dst, src, size);
 }
 
 BroadcastOp::BroadcastOp(HorovodGlobalState* global_state)
     : HorovodOp(global_state) {}
 
+void BroadcastOp::MemcpyInFusionBuffer(
+    const std::vector<TensorTableEntry>& entries, void*& buffer_data,
+    size_t& buffer_len) {
+  MemcpyTimer timer(global_state_, entries);
+  // Access the fusion buffer.
+  auto& first_entry = entries[0];
+  auto buffer = global_state_->fusion_buffer.GetBuffer(
+      first_entry.device, first_entry.context->framework(), global_state_->current_nccl_stream);
+  buffer_data = const_cast<void*>(buffer->AccessData(first_entry.context));
+
+  bool is_root = global_state_->controller->GetRank() == first_entry.root_rank;
+  int64_t offset = 0;
+  for (auto& e : entries) {
+    if (is_root) {
+      MemcpyEntry((uint8_t*)buffer_data + offset, e.tensor->data(),
+                  (size_t)e.tensor->size());
+    }
+    offset += e.tensor->size();
+  }
+  buffer_len = (size_t)offset;
+  timer.Record(is_root ? offset : 0);
+}
+
+void BroadcastOp::MemcpyOutFusionBuffer(
+    const void* buffer_data, std::vector<TensorTableEntry>& entries) {
+  MemcpyTimer timer(global_state_, entries);
+  int64_t offset = 0;
+  for (auto& e : entries) {
+    MemcpyEntry((void*)e.output->data(),
+                (const uint8_t*)buffer_data + offset,
+                (size_t)e.tensor->size());
+    offset += e.tensor->size();
+  }
+  timer.Record(offset);
+}
+
+void BroadcastOp::MemcpyEntry(void* dst, const void* src, size_t size) {
+  std::memcpy(dst, src, size);
+}
+
+// Reducescatter
+ReducescatterOp::ReducescatterOp(HorovodGlobalState* global_state)
+    : HorovodOp(global_state) {}
+
+void ReducescatterOp::RowRange(int64_t num_rows, int rank, int size,
+                               int64_t& first_row, int64_t& rows) {
+  int64_t base = num_rows / size;
+  int64_t remainder = num_rows % size;
+  rows = base + (rank < remainder ? 1 : 0);
+  first_row = rank * base + std::min<int64_t>(rank, remainder);
+}
+
+Status ReducescatterOp::AllocateOutput(std::vector<TensorTableEntry>& entries,
+                                       std::vector<int>& recvcounts,
+                                       std::vector<int>& displcmnts) {
+  int rank = global_state_->controller->GetRank();
+  int size = global_state_->controller->GetSize();
+  recvcounts.assign(size, 0);
+  displcmnts.assign(size, 0);
+  for (auto& e : entries) {
+    auto& shape = e.tensor->shape();
+    int64_t slice_elements = SliceElements(shape);
+    for (int rc = 0; rc < size; ++rc) {
+      int64_t first_row, rows;
+      RowRange(shape.dim_size(0), rc, size, first_row, rows);
+      recvcounts[rc] += (int)(rows * slice_elements);
+    }
+
+    int64_t first_row, rows;
+    RowRange(shape.dim_size(0), rank, size, first_row, rows);
+    TensorShape output_shape;
+    output_shape.AddDim(rows);
+    for (int i = 1; i < shape.dims(); ++i) {
+      output_shape.AddDim(shape.dim_size(i));
+    }
+    Status status = e.context->AllocateOutput(output_shape, &e.output);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  for (int rc = 1; rc < size; ++rc) {
+    displcmnts[rc] = displcmnts[rc - 1] + recvcounts[rc - 1];
+  }
+  return Status::OK();
+}
+
+void ReducescatterOp::MemcpyInFusionBuffer(
+    const std::vector<TensorTableEntry>& entries, void*& buffer_data,
+    size_t& buffer_len) {
+  MemcpyTimer timer(global_state_, entries);
+  // Access the fusion buffer.
+  auto& first_entry = entries[0];
+  auto buffer = global_state_->fusion_buffer.GetBuffer(
+      first_entry.device, first_entry.context->framework(), global_state_->current_nccl_stream);
+  buffer_data = const_cast<void*>(buffer->AccessData(first_entry.context));
+
+  int size = global_state_->controller->GetSize();
+  int element_size =
+      global_state_->controller->GetTypeSize(first_entry.tensor->dtype());
+  int64_t offset = 0;
+  for (int rc = 0; rc < size; ++rc) {
+    for (auto& e : entries) {
+      auto& shape = e.tensor->shape();
+      int64_t row_size = SliceElements(shape) * element_size;
+      int64_t first_row, rows;
+      RowRange(shape.dim_size(0), rc, size, first_row, rows);
+      MemcpyEntry((uint8_t*)buffer_data + offset,
+                  (const uint8_t*)e.tensor->data() + first_row * row_size,
+                  (size_t)(rows * row_size));
+      offset += rows * row_size;
+    }
+  }
+  buffer_len = (size_t)offset;
+  timer.Record(offset);
+}
+
+void ReducescatterOp::MemcpyOutFusionBuffer(
+    const void* block_data, std::vector<TensorTableEntry>& entries) {
+  MemcpyTimer timer(global_state_, entries);
+  int64_t offset = 0;
+  for (auto& e : entries) {
+    MemcpyEntry((void*)e.output->data(), (const uint8_t*)block_data + offset,
+                (size_t)e.output->size());
+    offset += e.output->size();
+  }
+  timer.Record(offset);
+}
+
+void ReducescatterOp::MemcpyEntry(void* dst, const void* src, size_t size) {
+  std::memcpy(dst, src, size);
+}
+
+// Alltoall
+AlltoallOp::AlltoallOp(HorovodGlobalState* global_state)
+    : HorovodOp(global_state) {}
+
+Status AlltoallOp::AllocateOutput(TensorTableEntry& entry,
+                                  const Response& response,
+                                  std::vector<int>& sendcounts,
+                                  std::vector<int>& sdispls,
+                                  std::vector<int>& recvcounts,
+                                  std::vector<int>& rdispls) {
+  int rank = global_state_->controller->GetRank();
+  int size = global_state_->controller->GetSize();
+  auto& splits = response.tensor_sizes();
+  auto& shape = entry.tensor->shape();
+  int64_t slice_elements = SliceElements(shape);
+
+  sendcounts.assign(size, 0);
+  sdispls.assign(size, 0);
+  recvcounts.assign(size, 0);
+  rdispls.assign(size, 0);
+  int64_t recv_rows = 0;
+  for (int rc = 0; rc < size; ++rc) {
+    sendcounts[rc] = (int)(splits[(size_t)rank * size + rc] * slice_elements);
+    recvcounts[rc] = (int)(splits[(size_t)rc * size + rank] * slice_elements);
+    recv_rows += splits[(size_t)rc * size + rank];
+    if (rc > 0) {
+      sdispls[rc] = sdispls[rc - 1] + sendcounts[rc - 1];
+      rdispls[rc] = rdispls[rc - 1] + recvcounts[rc - 1];
+    }
+  }
+
+  TensorShape output_shape;
+  output_shape.AddDim(recv_rows);
+  for (int i = 1; i < shape.dims(); ++i) {
+    output_shape.AddDim(shape.dim_size(i));
+  }
+  return entry.context->AllocateOutput(output_shape, &entry.output);
+}
+
 ErrorOp::ErrorOp(HorovodGlobalState* global_state) : HorovodOp(global_state) {}
 
 Status ErrorOp::Execute(std::vector<TensorTableEntry>& entries,
@@ -38,6 +38,13 @@ public:
 protected:
   int64_t NumElements(std::vector<TensorTableEntry>& entries);
 
+  // Returns the fusion buffer the entries are packed into, so that a
+  // collective still in flight on it can be completed first. A collective
+  // left in flight holds on to it, which keeps its memory alive should the
+  // buffer manager release it in the meantime.
+  std::shared_ptr<PersistentBuffer>
+  CurrentFusionBuffer(const TensorTableEntry& first_entry) const;
+
   HorovodGlobalState* global_state_;
 };
 
@@ -54,7 +61,52 @@ public:
                        const std::vector<TensorTableEntry>& entries,
                        const Response& response) const = 0;
 
+  // Whether the operation makes its streams wait for the ready events of the
+  // entries when stream_wait_ready_events is set, instead of relying on the
+  // background thread to wait for them on the host.
+  virtual bool WaitsForReadyEvents() const { return false; }
+
 protected:
+  // Returns true if the entries can be reduced directly in framework memory,
+  // without going through the fusion buffer, and sets the input and output
+  // regions. This holds for single-entry responses only, which every rank
+  // decides the same way. Inputs and outputs may be the same buffers, which
+  // backends reduce in place without copying the input first.
+  virtual bool GetDirectBuffers(const std::vector<TensorTableEntry>& entries,
+                                const void*& fused_input_data,
+                                void*& buffer_data, size_t& buffer_len) const;
+
+  // Whether packing and unpacking of CPU entries should be split across the
+  // fusion memcpy thread pool. The pool copies with std::memcpy and bypasses
+  // MemcpyEntryInFusionBuffer and MemcpyEntryOutFusionBuffer, so it is not
+  // used for scaled entries.
+  bool UseParallelMemcpy(const std::vector<TensorTableEntry>& entries) const;
+
+  // Writes num_elements values of the type of the entries from input
+  // multiplied by factor to output, which may be the same buffer. Host memory
+  // unless overridden.
+  virtual void ScaleBuffer(double factor,
+                           const std::vector<TensorTableEntry>& entries,
+                           const void* input, void* output,
+                           int64_t num_elements);
+
+  // Entries reduced directly in framework memory are not packed, so their
+  // inputs are scaled into the outputs, which then become the input of an in
+  // place collective, and the outputs are scaled in place once reduced. The
+  // entries of a fused response share their scale factors.
+  void PrescaleDirectBuffers(const std::vector<TensorTableEntry>& entries,
+                             const void*& fused_input_data, void* buffer_data,
+                             int64_t num_elements);
+
+  void PostscaleDirectBuffers(const std::vector<TensorTableEntry>& entries,
+                              void* buffer_data, int64_t num_elements);
+
+  // Whether a CPU buffer of buffer_len bytes should be allreduced in a
+  // logarithmic number of steps rather than with the bandwidth optimal ring,
+  // following the latency threshold of the parameter manager. The size is the
+  // same on all ranks, so they all pick the same algorithm.
+  bool UseLatencyOptimizedAllreduce(size_t buffer_len) const;
+
   virtual void
   MemcpyInFusionBuffer(const std::vector<TensorTableEntry>& entries,
                        const void*& fused_input_data, void*& buffer_data,
@@ -68,10 +120,33 @@ protected:
                             const TensorTableEntry& e,
                             void* buffer_data_at_offset);
 
+  // Returns the type CPU float32 entries are compressed to on the wire when
+  // HOROVOD_CPU_COMPRESSION is set and they are summed, or their own type
+  // otherwise. Operations that reduce in the returned type pack the entries
+  // with CompressInFusionBuffer and unpack them with DecompressOutFusionBuffer
+  // when it differs.
+  DataType WireDataType(const std::vector<TensorTableEntry>& entries) const;
+
+  // Down-cast float32 entries to wire_dtype into the fusion buffer, or for a
+  // single entry, which has no fusion buffer, into compression_buffer_. The
+  // prescale factor is applied in float32 before rounding, so that scaling
+  // down keeps large gradients from overflowing float16.
+  void CompressInFusionBuffer(const std::vector<TensorTableEntry>& entries,
+                              DataType wire_dtype, void*& buffer_data,
+                              size_t& buffer_len);
+
+  // Up-cast the reduced wire_dtype values back to the float32 outputs and
+  // apply the postscale factor.
+  void DecompressOutFusionBuffer(const void* buffer_data, DataType wire_dtype,
+                                 std::vector<TensorTableEntry>& entries);
+
   virtual void
   MemcpyEntryOutFusionBuffer(const std::vector<TensorTableEntry>& entries,
                              const void* buffer_data_at_offset,
                              TensorTableEntry& e);
+
+private:
+  std::vector<uint16_t> compression_buffer_;
 };
 
 class AllgatherOp : public HorovodOp {
@@ -91,19 +166,20 @@ protected:
   virtual Status AllocateOutput(std::vector<TensorTableEntry>& entries,
                                 const Response& response,
                                 int64_t**& entry_component_sizes,
-                                int*& recvcounts);
+                                int64_t*& recvcounts);
 
-  virtual void SetDisplacements(const int* recvcounts, int*& displcmnts);
+  virtual void SetDisplacements(const int64_t* recvcounts,
+                                int64_t*& displcmnts);
 
   virtual void
   SetEntryComponentOffsets(const std::vector<TensorTableEntry>& entries,
                            const int64_t* const* entry_component_sizes,
-                           const int* recvcounts,
+                           const int64_t* recvcounts,
                            int64_t**& entry_component_offsets);
 
   virtual void
   MemcpyInFusionBuffer(const std::vector<TensorTableEntry>& entries,
-                       const int* displcmnts, int element_size,
+                       const int64_t* displcmnts, int element_size,
                        void*& buffer_data);
 
   virtual void
@@ -111,6 +187,27 @@ protected:
                         const int64_t* const* entry_component_sizes,
                         const void* buffer_data, int element_size,
                         std::vector<TensorTableEntry>& entries);
+
+  // Copies between buffers on the device of the entries, host memory unless
+  // overridden.
+  virtual void MemcpyEntry(void* dst, const void* src, size_t size);
+
+  // Points the arrays used to gather num_entries entries at storage kept
+  // across calls, grown to the largest number of entries and ranks seen so
+  // far. recvcounts is zeroed, the other arrays are filled in by
+  // AllocateOutput, SetDisplacements and SetEntryComponentOffsets.
+  void GetScratchArrays(size_t num_entries, int64_t**& entry_component_sizes,
+                        int64_t**& entry_component_offsets,
+                        int64_t*& recvcounts, int64_t*& displcmnts);
+
+private:
+  // Rows of the global size per entry, and pointers to them.
+  std::vector<int64_t> component_sizes_;
+  std::vector<int64_t> component_offsets_;
+  std::vector<int64_t*> component_size_rows_;
+  std::vector<int64_t*> component_offset_rows_;
+  std::vector<int64_t> recvcounts_;
+  std::vector<int64_t> displcmnts_;
 };
 
 class BroadcastOp : public HorovodOp {
@@ -125,6 +222,87 @@ public:
   virtual bool Enabled(const ParameterManager& param_manager,
                        const std::vector<TensorTableEntry>& entries,
                        const Response& response) const = 0;
+
+protected:
+  // Fused broadcasts of CPU tensors go through the fusion buffer. The root
+  // rank packs its tensors into it, other ranks only get the buffer to
+  // receive into.
+  virtual void MemcpyInFusionBuffer(const std::vector<TensorTableEntry>& entries,
+                                    void*& buffer_data, size_t& buffer_len);
+
+  // Unpack received data into the outputs. Not called on the root rank.
+  virtual void MemcpyOutFusionBuffer(const void* buffer_data,
+                                     std::vector<TensorTableEntry>& entries);
+
+  // Copies between buffers on the device of the entries, host memory unless
+  // overridden.
+  virtual void MemcpyEntry(void* dst, const void* src, size_t size);
+};
+
+class ReducescatterOp : public HorovodOp {
+public:
+  ReducescatterOp(HorovodGlobalState* global_state);
+
+  virtual ~ReducescatterOp() = default;
+
+  virtual Status Execute(std::vector<TensorTableEntry>& entries,
+                         const Response& response) = 0;
+
+  virtual bool Enabled(const ParameterManager& param_manager,
+                       const std::vector<TensorTableEntry>& entries,
+                       const Response& response) const = 0;
+
+protected:
+  // Rows of the first dimension reduced onto the given rank. Ranks get
+  // consecutive rows in rank order, and the first num_rows % size ranks get
+  // one row more than the others.
+  static void RowRange(int64_t num_rows, int rank, int size,
+                       int64_t& first_row, int64_t& rows);
+
+  // Allocates the output of every entry, and sets the number of elements
+  // reduced onto each rank, summed over the entries, and their offsets in the
+  // packed input. For a single entry the packed input is the tensor itself.
+  virtual Status AllocateOutput(std::vector<TensorTableEntry>& entries,
+                                std::vector<int>& recvcounts,
+                                std::vector<int>& displcmnts);
+
+  // Packs the entries rank by rank into the fusion buffer, so that the block
+  // reduced onto each rank holds its rows of all entries back to back.
+  virtual void MemcpyInFusionBuffer(const std::vector<TensorTableEntry>& entries,
+                                    void*& buffer_data, size_t& buffer_len);
+
+  // Unpacks the block reduced onto this rank into the outputs.
+  virtual void MemcpyOutFusionBuffer(const void* block_data,
+                                     std::vector<TensorTableEntry>& entries);
+
+  // Copies between buffers on the device of the entries, host memory unless
+  // overridden.
+  virtual void MemcpyEntry(void* dst, const void* src, size_t size);
+};
+
+class AlltoallOp : public HorovodOp {
+public:
+  AlltoallOp(HorovodGlobalState* global_state);
+
+  virtual ~AlltoallOp() = default;
+
+  virtual Status Execute(std::vector<TensorTableEntry>& entries,
+                         const Response& response) = 0;
+
+  virtual bool Enabled(const ParameterManager& param_manager,
+                       const std::vector<TensorTableEntry>& entries,
+                       const Response& response) const = 0;
+
+protected:
+  // Allocates the output of the entry, whose first dimension is the number of
+  // rows received from all ranks, and sets the number of elements sent to and
+  // received from each rank and their offsets. Alltoalls are not fused.
+  virtual Status AllocateOutput(TensorTableEntry& entry,
+                                const Response& response,
+                                std::vector<int>& sendcounts,
+                                std::vector<int>& sdispls,
+                                std::vector<int>& recvcounts,
+                                std::vector<int>& rdispls);
 };
 
 class ErrorOp : public HorovodOp {
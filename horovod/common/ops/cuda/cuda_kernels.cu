@@ -0,0 +1,222 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "cuda_kernels.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <cuda_fp16.h>
+#if CUDART_VERSION >= 11000
+#include <cuda_bf16.h>
+#endif
+
+namespace horovod {
+namespace common {
+
+#define BATCHED_D2D_THREADS 1024
+#define BATCHED_D2D_BLOCKS_PER_COPY 4
+#define SCALE_THREADS 512
+#define SCALE_MAX_BLOCKS 1024
+
+// Copy size bytes using loads and stores of type T. Both pointers must be
+// aligned to sizeof(T).
+template <typename T>
+__device__ void batched_memcpy_d(size_t idx, const void* in, void* out,
+                                 size_t size) {
+  const T* input = reinterpret_cast<const T*>(in);
+  T* output = reinterpret_cast<T*>(out);
+  const size_t num_elements = size / sizeof(T);
+  const size_t stride = (size_t)blockDim.x * BATCHED_D2D_BLOCKS_PER_COPY;
+  for (size_t i = idx; i < num_elements; i += stride) {
+    output[i] = input[i];
+  }
+
+  // Deal with any remaining bytes.
+  const size_t remainder = size % sizeof(T);
+  if (idx < remainder) {
+    const unsigned char* input_r =
+        reinterpret_cast<const unsigned char*>(input + num_elements);
+    unsigned char* output_r =
+        reinterpret_cast<unsigned char*>(output + num_elements);
+    output_r[idx] = input_r[idx];
+  }
+}
+
+// Every copy is served by BATCHED_D2D_BLOCKS_PER_COPY consecutive blocks.
+__global__ void batched_memcpy_k(BatchedD2DParams params) {
+  const int copy = blockIdx.x / BATCHED_D2D_BLOCKS_PER_COPY;
+  const size_t idx =
+      (size_t)blockDim.x * (blockIdx.x % BATCHED_D2D_BLOCKS_PER_COPY) +
+      threadIdx.x;
+  const void* input = params.in[copy];
+  void* output = params.out[copy];
+  const size_t size = params.sizes[copy];
+
+  // Use the widest loads and stores that both pointers are aligned for.
+  const size_t alignment =
+      reinterpret_cast<size_t>(input) | reinterpret_cast<size_t>(output);
+  if (alignment % 16 == 0) {
+    batched_memcpy_d<ulonglong2>(idx, input, output, size);
+  } else if (alignment % 8 == 0) {
+    batched_memcpy_d<unsigned long long>(idx, input, output, size);
+  } else if (alignment % 4 == 0) {
+    batched_memcpy_d<unsigned int>(idx, input, output, size);
+  } else if (alignment % 2 == 0) {
+    batched_memcpy_d<unsigned short>(idx, input, output, size);
+  } else {
+    batched_memcpy_d<unsigned char>(idx, input, output, size);
+  }
+}
+
+void BatchedD2DMemcpyCudaImpl(const BatchedD2DParams& params, int num_copies,
+                              cudaStream_t stream) {
+  const int num_blocks = num_copies * BATCHED_D2D_BLOCKS_PER_COPY;
+  batched_memcpy_k<<<num_blocks, BATCHED_D2D_THREADS, 0, stream>>>(params);
+}
+
+template <typename T, typename S>
+__device__ T scale_value(T value, S factor) {
+  return (T)(value * factor);
+}
+
+template <>
+__device__ __half scale_value<__half, float>(__half value, float factor) {
+  return __float2half(__half2float(value) * factor);
+}
+
+#if CUDART_VERSION >= 11000
+template <>
+__device__ __nv_bfloat16
+scale_value<__nv_bfloat16, float>(__nv_bfloat16 value, float factor) {
+  return __float2bfloat16(__bfloat162float(value) * factor);
+}
+#endif
+
+template <typename T, typename S>
+__global__ void batched_scaled_memcpy_k(BatchedD2DParams params, S factor) {
+  const int copy = blockIdx.x / BATCHED_D2D_BLOCKS_PER_COPY;
+  const size_t idx =
+      (size_t)blockDim.x * (blockIdx.x % BATCHED_D2D_BLOCKS_PER_COPY) +
+      threadIdx.x;
+  const T* input = reinterpret_cast<const T*>(params.in[copy]);
+  T* output = reinterpret_cast<T*>(params.out[copy]);
+  const size_t num_elements = params.sizes[copy] / sizeof(T);
+  const size_t stride = (size_t)blockDim.x * BATCHED_D2D_BLOCKS_PER_COPY;
+  for (size_t i = idx; i < num_elements; i += stride) {
+    output[i] = scale_value(input[i], factor);
+  }
+}
+
+template <typename T, typename S>
+__global__ void scale_buffer_k(const T* input, T* output, int64_t num_elements,
+                               S factor) {
+  const size_t stride = (size_t)blockDim.x * gridDim.x;
+  for (size_t i = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+       i < (size_t)num_elements; i += stride) {
+    output[i] = scale_value(input[i], factor);
+  }
+}
+
+// Kernel launches for one element type T, scaled in S.
+struct BatchedScaledD2DMemcpyLauncher {
+  const BatchedD2DParams& params;
+  int num_copies;
+  double factor;
+  cudaStream_t stream;
+
+  template <typename T, typename S> void Launch() const {
+    const int num_blocks = num_copies * BATCHED_D2D_BLOCKS_PER_COPY;
+    batched_scaled_memcpy_k<T, S>
+        <<<num_blocks, BATCHED_D2D_THREADS, 0, stream>>>(params, (S)factor);
+  }
+};
+
+struct ScaleBufferLauncher {
+  const void* input;
+  void* output;
+  int64_t num_elements;
+  double factor;
+  cudaStream_t stream;
+
+  template <typename T, typename S> void Launch() const {
+    const int num_blocks = (int)std::min<int64_t>(
+        (num_elements + SCALE_THREADS - 1) / SCALE_THREADS, SCALE_MAX_BLOCKS);
+    if (num_blocks == 0) {
+      return;
+    }
+    scale_buffer_k<T, S><<<num_blocks, SCALE_THREADS, 0, stream>>>(
+        reinterpret_cast<const T*>(input), reinterpret_cast<T*>(output),
+        num_elements, (S)factor);
+  }
+};
+
+// Launches with the element type of dtype. Values are scaled in float,
+// except for 32 and 64-bit integers and doubles which need double.
+template <typename L> void DispatchScaleType(DataType dtype, const L& launcher) {
+  switch (dtype) {
+  case HOROVOD_UINT8:
+    launcher.template Launch<uint8_t, float>();
+    break;
+  case HOROVOD_INT8:
+    launcher.template Launch<int8_t, float>();
+    break;
+  case HOROVOD_UINT16:
+    launcher.template Launch<uint16_t, float>();
+    break;
+  case HOROVOD_INT16:
+    launcher.template Launch<int16_t, float>();
+    break;
+  case HOROVOD_INT32:
+    launcher.template Launch<int32_t, double>();
+    break;
+  case HOROVOD_INT64:
+    launcher.template Launch<int64_t, double>();
+    break;
+  case HOROVOD_FLOAT16:
+    launcher.template Launch<__half, float>();
+    break;
+#if CUDART_VERSION >= 11000
+  case HOROVOD_BFLOAT16:
+    launcher.template Launch<__nv_bfloat16, float>();
+    break;
+#endif
+  case HOROVOD_FLOAT32:
+    launcher.template Launch<float, float>();
+    break;
+  case HOROVOD_FLOAT64:
+    launcher.template Launch<double, double>();
+    break;
+  default:
+    throw std::logic_error("Type " + DataType_Name(dtype) +
+                           " cannot be scaled on GPU.");
+  }
+}
+
+void BatchedScaledD2DMemcpyCudaImpl(const BatchedD2DParams& params,
+                                    int num_copies, double factor,
+                                    DataType dtype, cudaStream_t stream) {
+  DispatchScaleType(dtype, BatchedScaledD2DMemcpyLauncher{params, num_copies,
+                                                          factor, stream});
+}
+
+void ScaleBufferCudaImpl(const void* input, void* output, int64_t num_elements,
+                         double factor, DataType dtype, cudaStream_t stream) {
+  DispatchScaleType(dtype, ScaleBufferLauncher{input, output, num_elements,
+                                               factor, stream});
+}
+
+} // namespace common
+} // namespace horovod
@@ -0,0 +1,56 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HOROVOD_CUDA_KERNELS_H
+#define HOROVOD_CUDA_KERNELS_H
+
+#include <cuda_runtime.h>
+
+#include "../../message.h"
+
+namespace horovod {
+namespace common {
+
+// Maximum number of copies per batched memcpy launch. The parameters are
+// passed by value as a kernel argument, so they must fit in the 4 KB kernel
+// parameter space.
+#define BATCHED_D2D_CAPACITY 160
+
+struct BatchedD2DParams {
+  void* out[BATCHED_D2D_CAPACITY];
+  const void* in[BATCHED_D2D_CAPACITY];
+  size_t sizes[BATCHED_D2D_CAPACITY];
+};
+
+// Performs num_copies device-to-device memcpys described by params with a
+// single kernel launch on the given stream.
+void BatchedD2DMemcpyCudaImpl(const BatchedD2DParams& params, int num_copies,
+                              cudaStream_t stream);
+
+// Same as BatchedD2DMemcpyCudaImpl, but multiplies the copied values of dtype
+// by factor. The sizes are in bytes.
+void BatchedScaledD2DMemcpyCudaImpl(const BatchedD2DParams& params,
+                                    int num_copies, double factor,
+                                    DataType dtype, cudaStream_t stream);
+
+// Writes num_elements values of dtype from input multiplied by factor to
+// output, which may be the same buffer.
+void ScaleBufferCudaImpl(const void* input, void* output, int64_t num_elements,
+                         double factor, DataType dtype, cudaStream_t stream);
+
+} // namespace common
+} // namespace horovod
+
+#endif // HOROVOD_CUDA_KERNELS_H
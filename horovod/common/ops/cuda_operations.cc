@@ -16,25 +16,64 @@
 
 #include "cuda_operations.h"
 
-#include <thread>
+#include <algorithm>
+#include <chrono>
+
+#include "cuda/cuda_kernels.h"
+#include "../thread_pool.h"
+#include "../utils/huge_pages.h"
 
 namespace horovod {
 namespace common {
 
-cudaError_t CUDAContext::GetCudaEvent(cudaEvent_t* event) {
-  int device;
-  auto status = cudaGetDevice(&device);
-  if (status != cudaSuccess) {
-    return status;
+// Interval at which the finalizer thread polls events not reached yet.
+#define FINALIZER_POLL_INTERVAL_US 10
+
+// Events preallocated per NCCL stream on each device. An operation records
+// up to five with the timeline on, one otherwise, and a few operations per
+// stream are in flight at a time.
+#define CUDA_EVENTS_PER_STREAM 32
+
+cudaError_t CUDAEventPool::Initialize(size_t capacity) {
+  events_.resize(capacity);
+  in_use_.reset(new std::atomic_bool[capacity]);
+  for (size_t i = 0; i < capacity; ++i) {
+    auto status = cudaEventCreateWithFlags(&events_[i], cudaEventBlockingSync |
+                                                        cudaEventDisableTiming);
+    if (status != cudaSuccess) {
+      // The pool is dropped, so the events created so far are destroyed.
+      for (size_t j = 0; j < i; ++j) {
+        cudaEventDestroy(events_[j]);
+      }
+      events_.clear();
+      index_.clear();
+      return status;
+    }
+    in_use_[i] = false;
+    index_[events_[i]] = i;
+  }
+  return cudaSuccess;
+}
+
+cudaError_t CUDAEventPool::Get(cudaEvent_t* event) {
+  size_t capacity = events_.size();
+  size_t start = next_.fetch_add(1, std::memory_order_relaxed);
+  for (size_t i = 0; i < capacity; ++i) {
+    size_t slot = (start + i) % capacity;
+    bool expected = false;
+    if (!in_use_[slot].load(std::memory_order_relaxed) &&
+        in_use_[slot].compare_exchange_strong(expected, true,
+                                              std::memory_order_acquire)) {
+      *event = events_[slot];
+      return cudaSuccess;
+    }
   }
 
-  auto& mutex = cuda_events_mutex;
   {
-    std::lock_guard<std::mutex> guard(mutex);
-    auto& queue = cuda_events[device];
-    if (!queue.empty()) {
-      *event = queue.front();
-      queue.pop();
+    std::lock_guard<std::mutex> guard(overflow_mutex_);
+    if (!overflow_.empty()) {
+      *event = overflow_.front();
+      overflow_.pop();
       return cudaSuccess;
     }
   }
@@ -43,20 +82,71 @@ cudaError_t CUDAContext::GetCudaEvent(cudaEvent_t* event) {
                                          cudaEventDisableTiming);
 }
 
-cudaError_t CUDAContext::ReleaseCudaEvent(cudaEvent_t event) {
+void CUDAEventPool::Release(cudaEvent_t event) {
+  auto it = index_.find(event);
+  if (it != index_.end()) {
+    in_use_[it->second].store(false, std::memory_order_release);
+    return;
+  }
+
+  std::lock_guard<std::mutex> guard(overflow_mutex_);
+  overflow_.push(event);
+}
+
+void CUDAContext::InitializeEventPools(int num_streams) {
+  int device_count = 0;
+  if (cudaGetDeviceCount(&device_count) != cudaSuccess) {
+    device_count = 0;
+  }
+  event_pools.clear();
+  event_pools.resize(device_count);
+  event_pool_flags.reset(new std::once_flag[device_count]);
+  event_pool_status.assign(device_count, cudaSuccess);
+  event_pool_capacity = (size_t)num_streams * CUDA_EVENTS_PER_STREAM;
+}
+
+cudaError_t CUDAContext::GetCudaEvent(cudaEvent_t* event) {
   int device;
   auto status = cudaGetDevice(&device);
   if (status != cudaSuccess) {
     return status;
   }
 
-  auto& mutex = cuda_events_mutex;
-  {
-    std::lock_guard<std::mutex> guard(mutex);
-    auto& queue = cuda_events[device];
-    queue.push(event);
+  if (device >= (int)event_pools.size()) {
+    return cudaEventCreateWithFlags(event, cudaEventBlockingSync |
+                                           cudaEventDisableTiming);
   }
 
+  // A pool that failed to initialize is not kept, and its status is
+  // returned by all later calls for the device.
+  std::call_once(event_pool_flags[device], [this, device]() {
+    std::unique_ptr<CUDAEventPool> pool(new CUDAEventPool());
+    event_pool_status[device] = pool->Initialize(event_pool_capacity);
+    if (event_pool_status[device] != cudaSuccess) {
+      return;
+    }
+    event_pools[device] = std::move(pool);
+    for (int i = 0; i < (int)streams.size(); ++i) {
+      GetStream(i, device);
+    }
+  });
+  if (event_pool_status[device] != cudaSuccess) {
+    return event_pool_status[device];
+  }
+  return event_pools[device]->Get(event);
+}
+
+cudaError_t CUDAContext::ReleaseCudaEvent(cudaEvent_t event) {
+  int device;
+  auto status = cudaGetDevice(&device);
+  if (status != cudaSuccess) {
+    return status;
+  }
+
+  if (device >= (int)event_pools.size() || !event_pools[device]) {
+    return cudaEventDestroy(event);
+  }
+  event_pools[device]->Release(event);
   return cudaSuccess;
 }
 
@@ -66,6 +156,18 @@ void CUDAContext::ErrorCheck(std::string op_name, cudaError_t cuda_result) {
   }
 }
 
+cudaStream_t& CUDAContext::GetStream(int stream_index, int device) {
+  cudaStream_t& stream = streams[stream_index][device];
+  if (stream == nullptr) {
+    int greatest_priority;
+    ErrorCheck("cudaDeviceGetStreamPriorityRange",
+               cudaDeviceGetStreamPriorityRange(NULL, &greatest_priority));
+    ErrorCheck("cudaStreamCreateWithPriority",
+               cudaStreamCreateWithPriority(&stream, cudaStreamNonBlocking, greatest_priority));
+  }
+  return stream;
+}
+
 void CUDAContext::RecordEvent(std::queue<std::pair<std::string, cudaEvent_t>>& event_queue,
                               std::string name, cudaStream_t& stream) {
   cudaEvent_t event;
@@ -92,49 +194,578 @@ void CUDAContext::WaitForEvents(std::queue<std::pair<std::string, cudaEvent_t>>&
   }
 }
 
+HostBufferPool::~HostBufferPool() {
+  for (auto& buffer : sizes_) {
+    cudaHostUnregister(buffer.first);
+    FreeHugePages(buffer.first, buffer.second);
+  }
+}
+
+cudaError_t HostBufferPool::Acquire(size_t bytes, void** buffer) {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto it = free_.lower_bound(bytes);
+    if (it != free_.end()) {
+      *buffer = it->second;
+      free_.erase(it);
+      return cudaSuccess;
+    }
+  }
+
+  // Pinning pages is slow, so a buffer is pinned once, when it is mapped.
+  // The free buffers are all smaller than the new one, which takes their
+  // place, so they are unmapped rather than kept pinned as responses grow.
+  size_t mapped_bytes = std::max<size_t>(bytes, 1);
+  std::vector<std::pair<void*, size_t>> unmapped;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    for (auto& buffer : free_) {
+      unmapped.emplace_back(buffer.second, buffer.first);
+      sizes_.erase(buffer.second);
+      released_.erase(buffer.second);
+      mapped_bytes_ -= buffer.first;
+    }
+    free_.clear();
+  }
+  Unmap(unmapped);
+
+  void* addr = AllocateHugePages(mapped_bytes);
+  if (addr == nullptr) {
+    return cudaErrorMemoryAllocation;
+  }
+  auto status = cudaHostRegister(addr, mapped_bytes, cudaHostRegisterPortable);
+  if (status != cudaSuccess) {
+    FreeHugePages(addr, mapped_bytes);
+    return status;
+  }
+  std::lock_guard<std::mutex> guard(mutex_);
+  sizes_[addr] = mapped_bytes;
+  mapped_bytes_ += mapped_bytes;
+  *buffer = addr;
+  return cudaSuccess;
+}
+
+void HostBufferPool::Release(void* buffer) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  free_.emplace(sizes_.at(buffer), buffer);
+  released_[buffer] = cycle_;
+}
+
+void HostBufferPool::EndCycle(int64_t idle_cycles) {
+  std::vector<std::pair<void*, size_t>> unmapped;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    ++cycle_;
+    if (idle_cycles <= 0) {
+      return;
+    }
+    for (auto it = free_.begin(); it != free_.end();) {
+      if (cycle_ - released_[it->second] > idle_cycles) {
+        unmapped.emplace_back(it->second, it->first);
+        sizes_.erase(it->second);
+        released_.erase(it->second);
+        mapped_bytes_ -= it->first;
+        it = free_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  Unmap(unmapped);
+}
+
+size_t HostBufferPool::MappedBytes() {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return mapped_bytes_;
+}
+
+size_t HostBufferPool::MappedBuffers() {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return sizes_.size();
+}
+
+void HostBufferPool::Unmap(
+    const std::vector<std::pair<void*, size_t>>& buffers) {
+  for (auto& buffer : buffers) {
+    cudaHostUnregister(buffer.first);
+    FreeHugePages(buffer.first, buffer.second);
+  }
+}
+
+Status CUDAContext::FinalizeAsync(
+    std::queue<std::pair<std::string, cudaEvent_t>>& event_queue,
+    const std::vector<TensorTableEntry>& entries, cudaStream_t& stream,
+    Timeline& timeline, std::shared_ptr<PersistentBuffer> fusion_buffer,
+    void* host_buffer) {
+  // Use completion marker via event because it's faster than
+  // blocking cudaStreamSynchronize() in this thread.
+  RecordEvent(event_queue, "", stream);
+
+  PendingCompletion completion;
+  completion.entries = entries;
+  completion.device = entries[0].device;
+  completion.event_queue = std::move(event_queue);
+  completion.timeline = &timeline;
+  completion.fusion_buffer = std::move(fusion_buffer);
+  completion.host_buffer = host_buffer;
+  completion.activity_started = false;
+  event_queue = std::queue<std::pair<std::string, cudaEvent_t>>();
+
+  {
+    std::lock_guard<std::mutex> guard(finalizer_mutex_);
+    pending_completions_.push_back(std::move(completion));
+    if (!finalizer_thread_.joinable()) {
+      finalizer_thread_ = std::thread(&CUDAContext::FinalizerLoop, this);
+    }
+  }
+  finalizer_cond_.notify_one();
+
+  return Status::InProgress();
+}
+
+void CUDAContext::FinalizerLoop() {
+  if (finalizer_cpu >= 0) {
+    PinCurrentThread(finalizer_cpu);
+  }
+  std::list<PendingCompletion> in_flight;
+  int current_device = -1;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(finalizer_mutex_);
+      if (in_flight.empty()) {
+        finalizer_cond_.wait(lock, [this]() {
+          return finalizer_shut_down_ || !pending_completions_.empty();
+        });
+      }
+      in_flight.splice(in_flight.end(), pending_completions_);
+      if (in_flight.empty() && finalizer_shut_down_) {
+        return;
+      }
+    }
+
+    bool progress = false;
+    for (auto it = in_flight.begin(); it != in_flight.end();) {
+      auto& completion = *it;
+      if (completion.device != current_device) {
+        ErrorCheck("cudaSetDevice", cudaSetDevice(completion.device));
+        current_device = completion.device;
+      }
+
+      auto& event_queue = completion.event_queue;
+      while (!event_queue.empty()) {
+        std::string name;
+        cudaEvent_t event;
+        std::tie(name, event) = event_queue.front();
+        if (name != "" && !completion.activity_started) {
+          completion.timeline->ActivityStartAll(completion.entries, name);
+          completion.activity_started = true;
+        }
+        auto cuda_result = cudaEventQuery(event);
+        if (cuda_result == cudaErrorNotReady) {
+          break;
+        }
+        ErrorCheck("cudaEventQuery", cuda_result);
+        if (completion.activity_started) {
+          completion.timeline->ActivityEndAll(completion.entries);
+          completion.activity_started = false;
+        }
+        ErrorCheck("ReleaseCudaEvent", ReleaseCudaEvent(event));
+        event_queue.pop();
+        progress = true;
+      }
+
+      if (event_queue.empty()) {
+        if (completion.host_buffer != nullptr) {
+          host_buffers.Release(completion.host_buffer);
+        }
+        for (auto& e : completion.entries) {
+          completion.timeline->End(e.tensor_name, e.output);
+          e.callback(Status::OK());
+        }
+        it = in_flight.erase(it);
+      } else {
+        ++it;
+      }
+    }
+
+    if (!progress) {
+      std::this_thread::sleep_for(
+          std::chrono::microseconds(FINALIZER_POLL_INTERVAL_US));
+    }
+  }
+}
+
+void CUDAContext::ShutDownFinalizer() {
+  {
+    std::lock_guard<std::mutex> guard(finalizer_mutex_);
+    if (!finalizer_thread_.joinable()) {
+      return;
+    }
+    finalizer_shut_down_ = true;
+  }
+  finalizer_cond_.notify_one();
+  finalizer_thread_.join();
+
+  std::lock_guard<std::mutex> guard(finalizer_mutex_);
+  finalizer_shut_down_ = false;
+}
+
+int CUDAContext::PickStream(int64_t bytes, int num_streams, bool global) {
+  if ((int)stream_loads.size() < num_streams) {
+    stream_loads.resize(num_streams, 0);
+  }
+
+  int stream_index = -1;
+  for (int i = 1; i <= num_streams; ++i) {
+    int candidate = (last_stream + i) % num_streams;
+    if (stream_index < 0 ||
+        stream_loads[candidate] < stream_loads[stream_index]) {
+      stream_index = candidate;
+    }
+  }
+  if (!global) {
+    return stream_index;
+  }
+  stream_loads[stream_index] += bytes;
+
+  // Keep the loads relative to the least loaded stream so they stay small,
+  // and forget streams the autotuner stopped using.
+  auto min_load = *std::min_element(stream_loads.begin(),
+                                    stream_loads.begin() + num_streams);
+  for (int i = 0; i < (int)stream_loads.size(); ++i) {
+    stream_loads[i] = i < num_streams ? stream_loads[i] - min_load : 0;
+  }
+  last_stream = stream_index;
+  return stream_index;
+}
+
 CUDAAllreduce::CUDAAllreduce(CUDAContext* context,
                              HorovodGlobalState* global_state)
     : AllreduceOp(global_state), cuda_context_(context) {}
 
+CUDAAllreduce::~CUDAAllreduce() {
+  for (auto host_chunk : host_chunks_) {
+    if (host_chunk != nullptr) {
+      cuda_context_->host_buffers.Release(host_chunk);
+    }
+  }
+}
+
 bool CUDAAllreduce::Enabled(const ParameterManager& param_manager,
                             const std::vector<TensorTableEntry>& entries,
                             const Response& response) const {
   return entries[0].device != CPU_DEVICE_ID;
 }
 
+void CUDAAllreduce::MemcpyInFusionBuffer(
+    const std::vector<TensorTableEntry>& entries, const void*& fused_input_data,
+    void*& buffer_data, size_t& buffer_len) {
+  // Access the fusion buffer.
+  auto& first_entry = entries[0];
+  auto buffer = global_state_->fusion_buffer.GetBuffer(
+      first_entry.device, first_entry.context->framework(), global_state_->current_nccl_stream);
+  buffer_data = const_cast<void*>(buffer->AccessData(first_entry.context));
+
+  bool use_copy_stream = global_state_->fusion_buffer.NumSlots() > 1;
+  if (use_copy_stream) {
+    WaitForFusionSlot(buffer_data, first_entry.device);
+  }
+
+  if (!global_state_->batch_d2d_memcopies) {
+    AllreduceOp::MemcpyInFusionBuffer(entries, fused_input_data, buffer_data,
+                                      buffer_len);
+  } else {
+    auto& stream = PackStream(first_entry.device);
+
+    // Pack up to BATCHED_D2D_CAPACITY entries per kernel launch.
+    BatchedD2DParams d2d_params;
+    int64_t offset = 0;
+    int num_copies = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+      auto& e = entries[i];
+      d2d_params.out[num_copies] = (uint8_t*)buffer_data + offset;
+      d2d_params.in[num_copies] = e.tensor->data();
+      d2d_params.sizes[num_copies] = (size_t)e.tensor->size();
+      offset += e.tensor->size();
+      ++num_copies;
+
+      if (num_copies == BATCHED_D2D_CAPACITY || i == entries.size() - 1) {
+        if (first_entry.prescale_factor != 1.0) {
+          BatchedScaledD2DMemcpyCudaImpl(d2d_params, num_copies,
+                                         first_entry.prescale_factor,
+                                         first_entry.tensor->dtype(), stream);
+        } else {
+          BatchedD2DMemcpyCudaImpl(d2d_params, num_copies, stream);
+        }
+        cuda_context_->ErrorCheck("BatchedD2DMemcpyCudaImpl", cudaGetLastError());
+        num_copies = 0;
+      }
+    }
+
+    buffer_len = (size_t)offset;
+
+    // Set the input data to originate from the buffer.
+    fused_input_data = buffer_data;
+  }
+
+  if (use_copy_stream) {
+    WaitForPack(first_entry.device);
+  }
+}
+
+void CUDAAllreduce::MemcpyOutFusionBuffer(
+    const void* buffer_data, std::vector<TensorTableEntry>& entries) {
+  auto& first_entry = entries[0];
+  if (!global_state_->batch_d2d_memcopies) {
+    AllreduceOp::MemcpyOutFusionBuffer(buffer_data, entries);
+  } else {
+    auto& stream = cuda_context_->streams[global_state_->current_nccl_stream][first_entry.device];
+
+    // Unpack up to BATCHED_D2D_CAPACITY entries per kernel launch.
+    BatchedD2DParams d2d_params;
+    int64_t offset = 0;
+    int num_copies = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+      auto& e = entries[i];
+      d2d_params.out[num_copies] = (void*)e.output->data();
+      d2d_params.in[num_copies] = (const uint8_t*)buffer_data + offset;
+      d2d_params.sizes[num_copies] = (size_t)e.tensor->size();
+      offset += e.tensor->size();
+      ++num_copies;
+
+      if (num_copies == BATCHED_D2D_CAPACITY || i == entries.size() - 1) {
+        if (first_entry.postscale_factor != 1.0) {
+          BatchedScaledD2DMemcpyCudaImpl(d2d_params, num_copies,
+                                         first_entry.postscale_factor,
+                                         first_entry.tensor->dtype(), stream);
+        } else {
+          BatchedD2DMemcpyCudaImpl(d2d_params, num_copies, stream);
+        }
+        cuda_context_->ErrorCheck("BatchedD2DMemcpyCudaImpl", cudaGetLastError());
+        num_copies = 0;
+      }
+    }
+  }
+
+  if (global_state_->fusion_buffer.NumSlots() > 1) {
+    ReleaseFusionSlot(buffer_data, first_entry.device);
+  }
+}
+
 void CUDAAllreduce::MemcpyEntryInFusionBuffer(const std::vector<TensorTableEntry>& entries,
                                               const TensorTableEntry& e, void* buffer_data_at_offset) {
   auto& first_entry = entries[0];
+  if (e.prescale_factor != 1.0) {
+    ScaleBufferCudaImpl(e.tensor->data(), buffer_data_at_offset,
+                        e.tensor->shape().num_elements(), e.prescale_factor,
+                        e.tensor->dtype(), PackStream(first_entry.device));
+    cuda_context_->ErrorCheck("ScaleBufferCudaImpl", cudaGetLastError());
+    return;
+  }
   auto cuda_result = cudaMemcpyAsync(buffer_data_at_offset, e.tensor->data(),
                                      (size_t) e.tensor->size(), cudaMemcpyDeviceToDevice,
-                                     cuda_context_->streams[global_state_->current_nccl_stream][first_entry.device]);
+                                     PackStream(first_entry.device));
   cuda_context_->ErrorCheck("cudaMemcpyAsync", cuda_result);
 }
 
 void CUDAAllreduce::MemcpyEntryOutFusionBuffer(const std::vector<TensorTableEntry>& entries,
                                                const void* buffer_data_at_offset, TensorTableEntry& e) {
   auto& first_entry = entries[0];
+  auto& stream = cuda_context_->streams[global_state_->current_nccl_stream][first_entry.device];
+  if (e.postscale_factor != 1.0) {
+    ScaleBufferCudaImpl(buffer_data_at_offset, (void*) e.output->data(),
+                        e.tensor->shape().num_elements(), e.postscale_factor,
+                        e.tensor->dtype(), stream);
+    cuda_context_->ErrorCheck("ScaleBufferCudaImpl", cudaGetLastError());
+    return;
+  }
   auto cuda_result = cudaMemcpyAsync((void*) e.output->data(), buffer_data_at_offset,
                                      (size_t) e.tensor->size(), cudaMemcpyDeviceToDevice,
-                                     cuda_context_->streams[global_state_->current_nccl_stream][first_entry.device]);
+                                     stream);
   cuda_context_->ErrorCheck("cudaMemcpyAsync", cuda_result);
 }
 
+void CUDAAllreduce::ScaleBuffer(double factor, const std::vector<TensorTableEntry>& entries,
+                                const void* input, void* output, int64_t num_elements) {
+  auto& first_entry = entries[0];
+  ScaleBufferCudaImpl(input, output, num_elements, factor, first_entry.tensor->dtype(),
+                      cuda_context_->streams[global_state_->current_nccl_stream][first_entry.device]);
+  cuda_context_->ErrorCheck("ScaleBufferCudaImpl", cudaGetLastError());
+}
+
 void CUDAAllreduce::InitCUDA(const std::vector<TensorTableEntry>& entries) {
   auto& first_entry = entries[0];
   cuda_context_->ErrorCheck("cudaSetDevice", cudaSetDevice(first_entry.device));
 
   // Ensure stream is in the map before executing reduction.
-  cudaStream_t& stream = cuda_context_->streams[global_state_->current_nccl_stream][first_entry.device];
-  if (stream == nullptr) {
-    int greatest_priority;
-    cuda_context_->ErrorCheck("cudaDeviceGetStreamPriorityRange",
-                              cudaDeviceGetStreamPriorityRange(NULL, &greatest_priority));
-    cuda_context_->ErrorCheck("cudaStreamCreateWithPriority",
-                              cudaStreamCreateWithPriority(&stream, cudaStreamNonBlocking, greatest_priority));
+  cudaStream_t& stream =
+      cuda_context_->GetStream(global_state_->current_nccl_stream, first_entry.device);
+
+  if (global_state_->fusion_buffer.NumSlots() > 1) {
+    cudaStream_t& copy_stream =
+        cuda_context_->copy_streams[global_state_->current_nccl_stream][first_entry.device];
+    if (copy_stream == nullptr) {
+      cuda_context_->ErrorCheck("cudaStreamCreateWithFlags",
+                                cudaStreamCreateWithFlags(&copy_stream, cudaStreamNonBlocking));
+    }
+  }
+
+  // Order the collective and the packing after the computation producing the
+  // tensors. This is a no-op for events the background thread waited on.
+  if (global_state_->stream_wait_ready_events) {
+    for (auto& e : entries) {
+      if (e.ready_event == nullptr || e.ready_event->CudaEvent() == nullptr) {
+        continue;
+      }
+      cuda_context_->ErrorCheck("cudaStreamWaitEvent",
+                                cudaStreamWaitEvent(stream, e.ready_event->CudaEvent(), 0));
+      if (&PackStream(first_entry.device) != &stream) {
+        cuda_context_->ErrorCheck(
+            "cudaStreamWaitEvent",
+            cudaStreamWaitEvent(PackStream(first_entry.device), e.ready_event->CudaEvent(), 0));
+      }
+    }
+  }
+}
+
+cudaStream_t& CUDAAllreduce::PackStream(int device) {
+  if (global_state_->fusion_buffer.NumSlots() > 1) {
+    return cuda_context_->copy_streams[global_state_->current_nccl_stream][device];
+  }
+  return cuda_context_->streams[global_state_->current_nccl_stream][device];
+}
+
+void CUDAAllreduce::WaitForFusionSlot(const void* buffer_data, int device) {
+  auto it = cuda_context_->fusion_slot_events.find(buffer_data);
+  if (it != cuda_context_->fusion_slot_events.end()) {
+    cuda_context_->ErrorCheck("cudaStreamWaitEvent",
+                              cudaStreamWaitEvent(PackStream(device), it->second, 0));
+  }
+}
+
+void CUDAAllreduce::WaitForPack(int device) {
+  // The wait captures the event as recorded now, so the event can go back to
+  // the pool right away.
+  cudaEvent_t event;
+  cuda_context_->ErrorCheck("GetCudaEvent", cuda_context_->GetCudaEvent(&event));
+  cuda_context_->ErrorCheck("cudaEventRecord", cudaEventRecord(event, PackStream(device)));
+  cuda_context_->ErrorCheck(
+      "cudaStreamWaitEvent",
+      cudaStreamWaitEvent(cuda_context_->streams[global_state_->current_nccl_stream][device],
+                          event, 0));
+  cuda_context_->ErrorCheck("ReleaseCudaEvent", cuda_context_->ReleaseCudaEvent(event));
+}
+
+void CUDAAllreduce::ReleaseFusionSlot(const void* buffer_data, int device) {
+  cudaEvent_t& event = cuda_context_->fusion_slot_events[buffer_data];
+  if (event == nullptr) {
+    cuda_context_->ErrorCheck("GetCudaEvent", cuda_context_->GetCudaEvent(&event));
+  }
+  cuda_context_->ErrorCheck(
+      "cudaEventRecord",
+      cudaEventRecord(event, cuda_context_->streams[global_state_->current_nccl_stream][device]));
+}
+
+void CUDAAllreduce::StagedAllreduce(const std::vector<TensorTableEntry>& entries,
+                                    const void* fused_input_data,
+                                    void* buffer_data, int64_t num_elements) {
+  auto& first_entry = entries[0];
+  auto dtype = first_entry.tensor->dtype();
+  int element_size = global_state_->controller->GetTypeSize(dtype);
+  int64_t chunk_elements =
+      std::min(num_elements, std::max<int64_t>(
+          global_state_->cuda_staging_chunk_bytes / element_size, 1));
+  int64_t num_chunks = (num_elements + chunk_elements - 1) / chunk_elements;
+  size_t chunk_bytes = (size_t)(chunk_elements * element_size);
+
+  if (host_chunk_bytes_ < chunk_bytes) {
+    for (auto& host_chunk : host_chunks_) {
+      if (host_chunk != nullptr) {
+        cuda_context_->host_buffers.Release(host_chunk);
+      }
+      cuda_context_->ErrorCheck(
+          "HostBufferPool::Acquire",
+          cuda_context_->host_buffers.Acquire(chunk_bytes, &host_chunk));
+    }
+    host_chunk_bytes_ = chunk_bytes;
+  }
+
+  cudaStream_t& stream =
+      cuda_context_->streams[global_state_->current_nccl_stream][first_entry.device];
+  cudaStream_t& copy_stream =
+      cuda_context_->copy_streams[global_state_->current_nccl_stream][first_entry.device];
+  if (copy_stream == nullptr) {
+    cuda_context_->ErrorCheck("cudaStreamCreateWithFlags",
+                              cudaStreamCreateWithFlags(&copy_stream, cudaStreamNonBlocking));
+  }
+
+  // One event per host buffer, recorded once its chunk is on the host.
+  cudaEvent_t events[2];
+  for (auto& event : events) {
+    cuda_context_->ErrorCheck("GetCudaEvent", cuda_context_->GetCudaEvent(&event));
+  }
+
+  // Order the copies after packing of the fusion buffer and after the
+  // ready events the collective stream waits for.
+  cuda_context_->ErrorCheck("cudaEventRecord", cudaEventRecord(events[0], stream));
+  cuda_context_->ErrorCheck("cudaStreamWaitEvent",
+                            cudaStreamWaitEvent(copy_stream, events[0], 0));
+
+  auto chunk_count = [&](int64_t k) {
+    return std::min(chunk_elements, num_elements - k * chunk_elements);
+  };
+  auto copy_to_host = [&](int64_t k) {
+    cuda_context_->ErrorCheck(
+        "cudaMemcpyAsync",
+        cudaMemcpyAsync(host_chunks_[k % 2],
+                        (const uint8_t*)fused_input_data + k * chunk_bytes,
+                        (size_t)(chunk_count(k) * element_size),
+                        cudaMemcpyDeviceToHost, copy_stream));
+    cuda_context_->ErrorCheck("cudaEventRecord",
+                              cudaEventRecord(events[k % 2], copy_stream));
+  };
+
+  // Copying chunk k + 2 into a host buffer is queued behind copying chunk k
+  // out of it, so the stream order alone keeps the buffers from being reused
+  // too early.
+  copy_to_host(0);
+  if (num_chunks > 1) {
+    copy_to_host(1);
+  }
+  for (int64_t k = 0; k < num_chunks; ++k) {
+    void* host_chunk = host_chunks_[k % 2];
+    cuda_context_->ErrorCheck("cudaEventSynchronize",
+                              cudaEventSynchronize(events[k % 2]));
+
+    AllreduceHostChunk(entries, host_chunk, chunk_count(k));
+
+    cuda_context_->ErrorCheck(
+        "cudaMemcpyAsync",
+        cudaMemcpyAsync((uint8_t*)buffer_data + k * chunk_bytes, host_chunk,
+                        (size_t)(chunk_count(k) * element_size),
+                        cudaMemcpyHostToDevice, copy_stream));
+    if (k + 2 < num_chunks) {
+      copy_to_host(k + 2);
+    }
+  }
+
+  // Work queued on the collective stream, such as unpacking, waits for the
+  // last copy back.
+  cuda_context_->ErrorCheck("cudaEventRecord", cudaEventRecord(events[0], copy_stream));
+  cuda_context_->ErrorCheck("cudaStreamWaitEvent",
+                            cudaStreamWaitEvent(stream, events[0], 0));
+  for (auto& event : events) {
+    cuda_context_->ErrorCheck("ReleaseCudaEvent", cuda_context_->ReleaseCudaEvent(event));
   }
 }
 
+void CUDAAllreduce::AllreduceHostChunk(
+    const std::vector<TensorTableEntry>& entries, void* host_data,
+    int64_t num_elements) {
+  throw std::logic_error("Allreduce of GPU tensors is not staged through "
+                         "host memory by this operation.");
+}
+
 void CUDAAllreduce::InitCUDAQueue(const std::vector<TensorTableEntry>& entries, const Response& response) {
   event_queue_ = std::queue<std::pair<std::string, cudaEvent_t>>();
   stream_ = &cuda_context_->streams[global_state_->current_nccl_stream][entries[0].device];
@@ -146,45 +777,16 @@ void CUDAAllreduce::InitCUDAQueue(const std::vector<TensorTableEntry>& entries,
 }
 
 Status CUDAAllreduce::FinalizeCUDAQueue(const std::vector<TensorTableEntry>& entries) {
-  // Use completion marker via event because it's faster than
-  // blocking cudaStreamSynchronize() in this thread.
-  cuda_context_->RecordEvent(event_queue_, "", *stream_);
-
   auto& first_entry = entries[0];
-  void* host_buffer = host_buffer_;
-  auto& event_queue = event_queue_;
-  auto& timeline = global_state_->timeline;
-  auto& cuda_context = cuda_context_;
 
   // Claim a std::shared_ptr to the fusion buffer to prevent its memory from being reclaimed
   // during finalization.
   auto fusion_buffer = global_state_->fusion_buffer.GetBuffer(
       first_entry.device, first_entry.context->framework(), global_state_->current_nccl_stream);
 
-  // TODO: use thread pool or single thread for callbacks
-  std::thread finalizer_thread([entries, first_entry, host_buffer, fusion_buffer,
-                                event_queue, &timeline, &cuda_context]() mutable {
-    auto cuda_result = cudaSetDevice(first_entry.device);
-    cuda_context->ErrorCheck("cudaSetDevice", cuda_result);
-
-    cuda_context->WaitForEvents(event_queue, entries, timeline);
-    if (host_buffer != nullptr) {
-      free(host_buffer);
-    }
-
-    for (auto& e : entries) {
-      timeline.End(e.tensor_name, e.output);
-      e.callback(Status::OK());
-    }
-  });
-
-  finalizer_thread.detach();
-
-  // Update current stream
-  global_state_->current_nccl_stream = (global_state_->current_nccl_stream + 1) %
-                                  global_state_->num_nccl_streams;
-
-  return Status::InProgress();
+  return cuda_context_->FinalizeAsync(event_queue_, entries, *stream_,
+                                      global_state_->timeline, fusion_buffer,
+                                      host_buffer_);
 }
 
 } // namespace common
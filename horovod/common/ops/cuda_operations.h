@@ -17,7 +17,14 @@
 #ifndef HOROVOD_CUDA_OPERATIONS_H
 #define HOROVOD_CUDA_OPERATIONS_H
 
+#include <atomic>
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <queue>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -28,7 +35,85 @@
 namespace horovod {
 namespace common {
 
+// Events of one device, created together ahead of use. Getting and
+// releasing one takes a compare-and-swap on its flag instead of a mutex and
+// a driver call. Events beyond the capacity fall back to a mutex-guarded
+// queue, filled with events created on demand.
+class CUDAEventPool {
+public:
+  CUDAEventPool() = default;
+  CUDAEventPool(const CUDAEventPool&) = delete;
+  CUDAEventPool& operator=(const CUDAEventPool&) = delete;
+
+  // Creates capacity events on the current device, or none on failure.
+  cudaError_t Initialize(size_t capacity);
+
+  cudaError_t Get(cudaEvent_t* event);
+
+  void Release(cudaEvent_t event);
+
+private:
+  std::vector<cudaEvent_t> events_;
+  std::unique_ptr<std::atomic_bool[]> in_use_;
+  // Read-only after Initialize, so lookups need no lock.
+  std::unordered_map<cudaEvent_t, size_t> index_;
+  std::atomic<size_t> next_{0};
+
+  std::mutex overflow_mutex_;
+  std::queue<cudaEvent_t> overflow_;
+};
+
+// Host buffers on huge pages, pinned with cudaHostRegister once and kept for
+// later operations, for copies between the GPU and host memory that another
+// library sends from. Reusing the same pages also keeps them in the memory
+// registration cache of the MPI or InfiniBand library. Buffers are acquired
+// by the background thread and may be released by the finalizer thread.
+class HostBufferPool {
+public:
+  HostBufferPool() = default;
+  HostBufferPool(const HostBufferPool&) = delete;
+  HostBufferPool& operator=(const HostBufferPool&) = delete;
+
+  // Unregisters and unmaps all buffers.
+  ~HostBufferPool();
+
+  // Returns the smallest free buffer of at least bytes, or maps and pins a
+  // new one. The free buffers, which are all smaller, are then unmapped
+  // first, so that the pool does not keep one buffer of every size it grew
+  // through.
+  cudaError_t Acquire(size_t bytes, void** buffer);
+
+  void Release(void* buffer);
+
+  // Ends a cycle of the background loop, unmapping the buffers that have
+  // been free for more than idle_cycles cycles, unless it is zero.
+  void EndCycle(int64_t idle_cycles);
+
+  // Bytes and number of the buffers currently mapped.
+  size_t MappedBytes();
+  size_t MappedBuffers();
+
+private:
+  // Unregisters and unmaps free buffers removed from the pool.
+  static void Unmap(const std::vector<std::pair<void*, size_t>>& buffers);
+
+  std::mutex mutex_;
+  // Size of every buffer mapped, and the free ones by size.
+  std::unordered_map<void*, size_t> sizes_;
+  std::multimap<size_t, void*> free_;
+  // Cycle in which each free buffer was released.
+  std::unordered_map<void*, int64_t> released_;
+  size_t mapped_bytes_ = 0;
+  int64_t cycle_ = 0;
+};
+
 struct CUDAContext {
+  // Sizes the event pools of all devices for the number of NCCL streams. The
+  // pool of a device, and the collective streams on it, are created on its
+  // first event, since the devices in use are not known before the first
+  // response.
+  void InitializeEventPools(int num_streams);
+
   cudaError_t GetCudaEvent(cudaEvent_t* event);
 
   cudaError_t ReleaseCudaEvent(cudaEvent_t event);
@@ -49,17 +134,90 @@ struct CUDAContext {
   // TensorFlow stream, and must use our own stream.
   std::vector<std::unordered_map<int, cudaStream_t>> streams;
 
+  // Streams for copies that run alongside the collective stream, such as
+  // packing the next fusion buffer slot or host transfers of pipelined
+  // hierarchical allreduce.
+  std::vector<std::unordered_map<int, cudaStream_t>> copy_streams;
+
+  // Events recorded once a fusion buffer slot has been unpacked, keyed by the
+  // buffer address. Packing into the slot waits for them.
+  std::unordered_map<const void*, cudaEvent_t> fusion_slot_events;
+
   // We reuse CUDA events as it appears that their creation carries non-zero cost.
-  std::unordered_map<int, std::queue<cudaEvent_t>> cuda_events;
-  std::mutex cuda_events_mutex;
+  std::vector<std::unique_ptr<CUDAEventPool>> event_pools;
+  std::unique_ptr<std::once_flag[]> event_pool_flags;
+  // Result of initializing the pool of each device.
+  std::vector<cudaError_t> event_pool_status;
+  size_t event_pool_capacity = 0;
 
   void ErrorCheck(std::string op_name, cudaError_t cuda_result);
 
+  // Returns the collective stream of the given NCCL stream index on the
+  // device, creating it with the greatest priority on first use.
+  cudaStream_t& GetStream(int stream_index, int device);
+
   void RecordEvent(std::queue<std::pair<std::string, cudaEvent_t>>& event_queue, std::string name,
                    cudaStream_t& stream);
 
   void WaitForEvents(std::queue<std::pair<std::string, cudaEvent_t>>& event_queue,
                      const std::vector<TensorTableEntry>& entries, Timeline& timeline);
+
+  // Records a completion marker on the stream and hands the entries to the
+  // finalizer thread, which completes them once the events in the queue have
+  // been reached. Holding fusion_buffer keeps its memory alive until then,
+  // and host_buffer, acquired from host_buffers, is released unless it is
+  // null. Returns Status::InProgress().
+  Status FinalizeAsync(std::queue<std::pair<std::string, cudaEvent_t>>& event_queue,
+                       const std::vector<TensorTableEntry>& entries,
+                       cudaStream_t& stream, Timeline& timeline,
+                       std::shared_ptr<PersistentBuffer> fusion_buffer,
+                       void* host_buffer);
+
+  // Picks the NCCL stream of a response moving the given number of bytes:
+  // the stream with the fewest bytes assigned so far, looking from the one
+  // after the last pick so that equal sizes go round-robin. The choice only
+  // depends on the sequence of responses, which all ranks see in the same
+  // order, so every rank runs the response on the communicator of the same
+  // stream. Only the members of a process set see its responses, so those
+  // are picked without being recorded (global false), leaving the loads the
+  // same on all ranks.
+  int PickStream(int64_t bytes, int num_streams, bool global);
+
+  // Bytes assigned to each NCCL stream, relative to the least loaded one.
+  std::vector<int64_t> stream_loads;
+  int last_stream = -1;
+
+  HostBufferPool host_buffers;
+
+  // CPU the finalizer thread is pinned to, unless negative.
+  int finalizer_cpu = -1;
+
+  // Completes everything handed to the finalizer thread and stops it. The
+  // thread starts again with the next FinalizeAsync.
+  void ShutDownFinalizer();
+
+private:
+  struct PendingCompletion {
+    std::vector<TensorTableEntry> entries;
+    int device;
+    std::queue<std::pair<std::string, cudaEvent_t>> event_queue;
+    Timeline* timeline;
+    std::shared_ptr<PersistentBuffer> fusion_buffer;
+    void* host_buffer;
+    // Whether the timeline activity of the first event in the queue started.
+    bool activity_started;
+  };
+
+  // Polls the events of all pending completions, so that an operation on a
+  // fast stream is not completed behind one on a slow stream. Timeline
+  // activities end when their event is reached.
+  void FinalizerLoop();
+
+  std::list<PendingCompletion> pending_completions_;
+  std::mutex finalizer_mutex_;
+  std::condition_variable finalizer_cond_;
+  std::thread finalizer_thread_;
+  bool finalizer_shut_down_ = false;
 };
 
 class CUDAAllreduce : public AllreduceOp {
@@ -67,19 +225,59 @@ public:
   CUDAAllreduce(CUDAContext* context,
                 HorovodGlobalState* global_state);
 
+  virtual ~CUDAAllreduce();
+
   bool Enabled(const ParameterManager& param_manager,
                const std::vector<TensorTableEntry>& entries,
                const Response& response) const override;
 
 protected:
+  void MemcpyInFusionBuffer(const std::vector<TensorTableEntry>& entries,
+                            const void*& fused_input_data, void*& buffer_data,
+                            size_t& buffer_len) override;
+
+  void MemcpyOutFusionBuffer(const void* buffer_data,
+                             std::vector<TensorTableEntry>& entries) override;
+
   void MemcpyEntryInFusionBuffer(const std::vector<TensorTableEntry>& entries,
                                  const TensorTableEntry& e, void* buffer_data_at_offset) override;
 
   void MemcpyEntryOutFusionBuffer(const std::vector<TensorTableEntry>& entries,
                                   const void* buffer_data_at_offset, TensorTableEntry& e) override;
 
+  // Scales on the collective stream.
+  void ScaleBuffer(double factor, const std::vector<TensorTableEntry>& entries,
+                   const void* input, void* output, int64_t num_elements) override;
+
   void InitCUDA(const std::vector<TensorTableEntry>& entries);
 
+  // Stream used to pack the fusion buffer: a dedicated copy stream when there
+  // are several fusion buffer slots, the collective stream otherwise.
+  cudaStream_t& PackStream(int device);
+
+  // Makes the copy stream wait until the fusion buffer slot has been unpacked
+  // by the operation that used it last.
+  void WaitForFusionSlot(const void* buffer_data, int device);
+
+  // Makes the collective stream wait for packing on the copy stream.
+  void WaitForPack(int device);
+
+  // Marks the fusion buffer slot free once unpacking on the collective stream
+  // is done.
+  void ReleaseFusionSlot(const void* buffer_data, int device);
+
+  // Allreduces a GPU buffer through pinned host memory, for libraries that
+  // cannot access device memory. The buffer is copied to and from the host
+  // in chunks on the copy stream, so that the allreduce of one chunk by
+  // AllreduceHostChunk overlaps the copies of the chunks before and after it.
+  void StagedAllreduce(const std::vector<TensorTableEntry>& entries,
+                       const void* fused_input_data, void* buffer_data,
+                       int64_t num_elements);
+
+  // Allreduces a chunk of a staged allreduce in place in host memory.
+  virtual void AllreduceHostChunk(const std::vector<TensorTableEntry>& entries,
+                                  void* host_data, int64_t num_elements);
+
   void InitCUDAQueue(const std::vector<TensorTableEntry>& entries, const Response& response);
 
   Status FinalizeCUDAQueue(const std::vector<TensorTableEntry>& entries);
@@ -99,6 +297,13 @@ protected:
   void* host_buffer_;
 
   struct CUDAContext* cuda_context_;
+
+private:
+  // Pinned host buffers the chunks of staged allreduces go through in turn,
+  // acquired from the host buffer pool when they grow and kept for later
+  // allreduces.
+  void* host_chunks_[2] = {nullptr, nullptr};
+  size_t host_chunk_bytes_ = 0;
 };
 
 } // namespace common
@@ -16,11 +16,19 @@
 
 #include "ddl_operations.h"
 
+#include "cuda/cuda_kernels.h"
+
 namespace horovod {
 namespace common {
 
+// Fused buffers larger than this are packed and allreduced in chunks of at
+// least this size.
+#define DDL_CHUNK_BYTES (16 * 1024 * 1024)
+
 DDL_Type GetDDLDataType(const std::shared_ptr<Tensor> tensor) {
   switch (tensor->dtype()) {
+    case HOROVOD_FLOAT16:
+      return DDL_TYPE_HALF;
     case HOROVOD_FLOAT32:
       return DDL_TYPE_FLOAT;
     default:
@@ -38,6 +46,12 @@ DDLAllreduce::DDLAllreduce(DDLContext* ddl_context,
 Status DDLAllreduce::Execute(std::vector<TensorTableEntry>& entries, const Response& response) {
   auto& first_entry = entries[0];
 
+  if (response.reduce_op() != ReduceOp::SUM) {
+    return Status::PreconditionError(
+        ReduceOp_Name(response.reduce_op()) +
+        " allreduce is not supported in DDL mode.");
+  }
+
   InitCUDA(entries);
   InitCUDAQueue(entries, response);
 
@@ -49,39 +63,54 @@ Status DDLAllreduce::Execute(std::vector<TensorTableEntry>& entries, const Respo
   const void* fused_input_data;
   void* buffer_data;
   size_t buffer_len;
+  int64_t num_elements = NumElements(entries);
+  DDL_Type ddl_data_type = GetDDLDataType(first_entry.tensor);
 
-  // Copy memory into the fusion buffer.
-  if (entries.size() > 1) {
-    MemcpyInFusionBuffer(entries, fused_input_data, buffer_data, buffer_len);
+  // Large fused responses are pipelined through the fusion buffer. The
+  // choice only depends on the response, so that all ranks make it alike.
+  int64_t fused_bytes =
+      num_elements *
+      global_state_->controller->GetTypeSize(first_entry.tensor->dtype());
+  if (entries.size() > 1 && fused_bytes > 2 * DDL_CHUNK_BYTES) {
+    PipelinedAllreduce(entries, buffer_data, ddl_data_type);
+    cuda_context_->WaitForEvents(event_queue_, entries, timeline);
 
+    MemcpyOutFusionBuffer(buffer_data, entries);
     if (timeline.Initialized()) {
-      cuda_context_->RecordEvent(event_queue_, MEMCPY_IN_FUSION_BUFFER, *stream_);
+      cuda_context_->RecordEvent(event_queue_, MEMCPY_OUT_FUSION_BUFFER, *stream_);
     }
-  } else {
-    fused_input_data = first_entry.tensor->data();
-    buffer_data = (void*) first_entry.output->data();
-    buffer_len = (size_t) first_entry.output->size();
+    return FinalizeCUDAQueue(entries);
   }
 
-  int64_t num_elements = 0;
-  for (auto& e : entries) {
-    num_elements += e.tensor->shape().num_elements();
+  // Copy memory into the fusion buffer, unless the entries can be reduced
+  // directly.
+  bool use_fusion_buffer =
+      !GetDirectBuffers(entries, fused_input_data, buffer_data, buffer_len);
+  if (use_fusion_buffer) {
+    MemcpyInFusionBuffer(entries, fused_input_data, buffer_data, buffer_len);
+
+    if (timeline.Initialized()) {
+      cuda_context_->RecordEvent(event_queue_, MEMCPY_IN_FUSION_BUFFER, *stream_);
+    }
   }
 
   // Do allreduce.
-  if (entries.size() == 1) {
+  if (!use_fusion_buffer) {
+    PrescaleDirectBuffers(entries, fused_input_data, buffer_data, num_elements);
+
     // Copy input buffer content to output buffer
     // because DDL only supports in-place allreduce
-    auto cuda_result = cudaMemcpyAsync(buffer_data, fused_input_data, buffer_len,
-                                       cudaMemcpyDeviceToDevice, *stream_);
-    cuda_context_->ErrorCheck("cudaMemcpyAsync", cuda_result);
+    if (fused_input_data != buffer_data) {
+      auto cuda_result = cudaMemcpyAsync(buffer_data, fused_input_data, buffer_len,
+                                         cudaMemcpyDeviceToDevice, *stream_);
+      cuda_context_->ErrorCheck("cudaMemcpyAsync", cuda_result);
+    }
     cuda_context_->RecordEvent(event_queue_, MEMCPY_IN_FUSION_BUFFER, *stream_);
   }
 
   // Synchronize.
   cuda_context_->WaitForEvents(event_queue_, entries, timeline);
 
-  DDL_Type ddl_data_type = GetDDLDataType(first_entry.tensor);
   auto ddl_result = ddl_allreduce(buffer_data, (size_t) num_elements, ddl_data_type,
                                   DDL_OP_SUM);
   if (ddl_result != DDL_SUCCESS) {
@@ -89,17 +118,108 @@ Status DDLAllreduce::Execute(std::vector<TensorTableEntry>& entries, const Respo
   }
 
   // Copy memory out of the fusion buffer.
-  if (entries.size() > 1) {
+  if (use_fusion_buffer) {
     MemcpyOutFusionBuffer(buffer_data, entries);
 
     if (timeline.Initialized()) {
       cuda_context_->RecordEvent(event_queue_, MEMCPY_OUT_FUSION_BUFFER, *stream_);
     }
+  } else {
+    PostscaleDirectBuffers(entries, buffer_data, num_elements);
   }
 
   return FinalizeCUDAQueue(entries);
 }
 
+void DDLAllreduce::PipelinedAllreduce(
+    const std::vector<TensorTableEntry>& entries, void*& buffer_data,
+    DDL_Type ddl_data_type) {
+  auto& first_entry = entries[0];
+  auto buffer = global_state_->fusion_buffer.GetBuffer(
+      first_entry.device, first_entry.context->framework(),
+      global_state_->current_nccl_stream);
+  buffer_data = const_cast<void*>(buffer->AccessData(first_entry.context));
+
+  bool use_copy_stream = global_state_->fusion_buffer.NumSlots() > 1;
+  if (use_copy_stream) {
+    WaitForFusionSlot(buffer_data, first_entry.device);
+  }
+  auto& stream = PackStream(first_entry.device);
+  int element_size =
+      global_state_->controller->GetTypeSize(first_entry.tensor->dtype());
+
+  // Enqueue the copies of all chunks, each followed by an event that the
+  // allreduce of the chunk waits for. The chunks end on entry boundaries,
+  // which are the same on all ranks.
+  std::vector<std::pair<int64_t, int64_t>> chunks;
+  std::vector<cudaEvent_t> chunk_events;
+  BatchedD2DParams d2d_params;
+  int num_copies = 0;
+  int64_t offset = 0;
+  int64_t chunk_offset = 0;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    auto& e = entries[i];
+    void* buffer_data_at_offset = (uint8_t*)buffer_data + offset;
+    if (global_state_->batch_d2d_memcopies) {
+      d2d_params.out[num_copies] = buffer_data_at_offset;
+      d2d_params.in[num_copies] = e.tensor->data();
+      d2d_params.sizes[num_copies] = (size_t)e.tensor->size();
+      ++num_copies;
+    } else {
+      MemcpyEntryInFusionBuffer(entries, e, buffer_data_at_offset);
+    }
+    offset += e.tensor->size();
+
+    bool end_of_chunk = offset - chunk_offset >= DDL_CHUNK_BYTES ||
+                        i == entries.size() - 1;
+    if (num_copies > 0 &&
+        (num_copies == BATCHED_D2D_CAPACITY || end_of_chunk)) {
+      if (first_entry.prescale_factor != 1.0) {
+        BatchedScaledD2DMemcpyCudaImpl(d2d_params, num_copies,
+                                       first_entry.prescale_factor,
+                                       first_entry.tensor->dtype(), stream);
+      } else {
+        BatchedD2DMemcpyCudaImpl(d2d_params, num_copies, stream);
+      }
+      cuda_context_->ErrorCheck("BatchedD2DMemcpyCudaImpl", cudaGetLastError());
+      num_copies = 0;
+    }
+    if (end_of_chunk) {
+      cudaEvent_t event;
+      cuda_context_->ErrorCheck("GetCudaEvent",
+                                cuda_context_->GetCudaEvent(&event));
+      cuda_context_->ErrorCheck("cudaEventRecord",
+                                cudaEventRecord(event, stream));
+      chunks.emplace_back(chunk_offset, offset - chunk_offset);
+      chunk_events.push_back(event);
+      chunk_offset = offset;
+    }
+  }
+
+  if (use_copy_stream) {
+    WaitForPack(first_entry.device);
+  }
+  if (global_state_->timeline.Initialized()) {
+    cuda_context_->RecordEvent(event_queue_, MEMCPY_IN_FUSION_BUFFER, *stream_);
+  }
+
+  // DDL returns once the chunk is reduced, so the copies of the next chunks
+  // run on the GPU in the meantime.
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    cuda_context_->ErrorCheck("cudaEventSynchronize",
+                              cudaEventSynchronize(chunk_events[i]));
+    cuda_context_->ErrorCheck("ReleaseCudaEvent",
+                              cuda_context_->ReleaseCudaEvent(chunk_events[i]));
+    auto ddl_result =
+        ddl_allreduce((uint8_t*)buffer_data + chunks[i].first,
+                      (size_t)(chunks[i].second / element_size),
+                      ddl_data_type, DDL_OP_SUM);
+    if (ddl_result != DDL_SUCCESS) {
+      throw std::logic_error("ddl_allreduce failed.");
+    }
+  }
+}
+
 void DDLAllreduce::DDLInit(DDLContext* ddl_context, CUDAContext* cuda_context) {
   auto ddl_options = std::getenv("DDL_OPTIONS");
   if (ddl_options == nullptr) {
@@ -39,6 +39,11 @@ public:
   static void DDLInit(DDLContext* ddl_context, CUDAContext* cuda_context);
 
 protected:
+  // Packs the fusion buffer in chunks of whole entries, and allreduces each
+  // chunk as soon as it is packed while the next ones are copied.
+  void PipelinedAllreduce(const std::vector<TensorTableEntry>& entries,
+                          void*& buffer_data, DDL_Type ddl_data_type);
+
   DDLContext* ddl_context_;
 };
 
@@ -0,0 +1,91 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "gloo_cuda_operations.h"
+
+namespace horovod {
+namespace common {
+
+GlooCUDAAllreduce::GlooCUDAAllreduce(GlooContext* gloo_context,
+                                     CUDAContext* cuda_context,
+                                     HorovodGlobalState* global_state)
+    : CUDAAllreduce(cuda_context, global_state),
+      gloo_context_(gloo_context) {}
+
+Status GlooCUDAAllreduce::Execute(std::vector<TensorTableEntry>& entries,
+                                  const Response& response) {
+  auto& first_entry = entries[0];
+
+  InitCUDA(entries);
+
+  const void* fused_input_data;
+  void* buffer_data;
+  size_t buffer_len;
+  int64_t num_elements = NumElements(entries);
+
+  // Copy memory into the fusion buffer, unless the entries can be reduced
+  // directly. The copies to the host are ordered after packing on the GPU.
+  auto& timeline = global_state_->timeline;
+  bool use_fusion_buffer =
+      !GetDirectBuffers(entries, fused_input_data, buffer_data, buffer_len);
+  if (use_fusion_buffer) {
+    timeline.ActivityStartAll(entries, MEMCPY_IN_FUSION_BUFFER);
+    MemcpyInFusionBuffer(entries, fused_input_data, buffer_data, buffer_len);
+    timeline.ActivityEndAll(entries);
+  } else if (first_entry.prescale_factor != 1.0) {
+    PrescaleDirectBuffers(entries, fused_input_data, buffer_data, num_elements);
+  }
+
+  // Do allreduce.
+  timeline.ActivityStartAll(entries, GLOO_ALLREDUCE);
+  StagedAllreduce(entries, fused_input_data, buffer_data, num_elements);
+  timeline.ActivityEndAll(entries);
+
+  // Copy memory out of the fusion buffer.
+  if (use_fusion_buffer) {
+    timeline.ActivityStartAll(entries, MEMCPY_OUT_FUSION_BUFFER);
+    MemcpyOutFusionBuffer(buffer_data, entries);
+    timeline.ActivityEndAll(entries);
+  } else if (first_entry.postscale_factor != 1.0) {
+    PostscaleDirectBuffers(entries, buffer_data, num_elements);
+  }
+
+  auto cuda_result = cudaStreamSynchronize(
+      cuda_context_->streams[global_state_->current_nccl_stream]
+                            [first_entry.device]);
+  cuda_context_->ErrorCheck("cudaStreamSynchronize", cuda_result);
+
+  return Status::OK();
+}
+
+void GlooCUDAAllreduce::AllreduceHostChunk(
+    const std::vector<TensorTableEntry>& entries, void* host_data,
+    int64_t num_elements) {
+  IGlooAlgorithms* gloo_algos = GetAlgorithmsForType(
+      entries[0].tensor->dtype(), gloo_context_, entries[0].reduce_op);
+  bool latency_optimized = UseLatencyOptimizedAllreduce(
+      (size_t)num_elements * gloo_algos->ElementSize());
+  auto process_set = global_state_->process_sets.Get(entries[0].process_set_id);
+  if (process_set != nullptr) {
+    gloo_algos->Allreduce(
+        gloo_context_->GetProcessSetContext(process_set.get()), host_data,
+        (int)num_elements, latency_optimized);
+  } else {
+    gloo_algos->Allreduce(host_data, (int)num_elements, latency_optimized);
+  }
+}
+
+} // namespace common
+} // namespace horovod
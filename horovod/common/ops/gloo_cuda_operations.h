@@ -0,0 +1,46 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HOROVOD_GLOO_CUDA_OPERATIONS_H
+#define HOROVOD_GLOO_CUDA_OPERATIONS_H
+
+#include "cuda_operations.h"
+#include "gloo_operations.h"
+
+namespace horovod {
+namespace common {
+
+// Allreduces GPU tensors with Gloo for builds without NCCL. The fusion buffer
+// is packed on the GPU and staged through pinned host memory in chunks, so
+// that the Gloo allreduce of one chunk overlaps the copies of the others.
+class GlooCUDAAllreduce : public CUDAAllreduce {
+public:
+  GlooCUDAAllreduce(GlooContext* gloo_context, CUDAContext* cuda_context,
+                    HorovodGlobalState* global_state);
+
+  Status Execute(std::vector<TensorTableEntry>& entries,
+                 const Response& response) override;
+
+protected:
+  void AllreduceHostChunk(const std::vector<TensorTableEntry>& entries,
+                          void* host_data, int64_t num_elements) override;
+
+  GlooContext* gloo_context_;
+};
+
+} // namespace common
+} // namespace horovod
+
+#endif // HOROVOD_GLOO_CUDA_OPERATIONS_H
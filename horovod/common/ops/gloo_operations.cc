@@ -15,94 +15,416 @@
 
 #include "gloo_operations.h"
 
+#include <future>
+#include <type_traits>
+#include <typeinfo>
+
 #include "gloo/allgather.h"
 #include "gloo/allgatherv.h"
 #include "gloo/allreduce.h"
+#include "gloo/allreduce_halving_doubling.h"
+#include "gloo/allreduce_ring.h"
+#include "gloo/alltoallv.h"
 #include "gloo/broadcast.h"
 #include "gloo/math.h"
+#include "gloo/reduce.h"
 #include "gloo/types.h"
 
 #include "../common.h"
 #include "../global_state.h"
+#include "../half.h"
 
 namespace horovod {
 namespace common {
 
+namespace {
+
+template <typename T>
+IGlooAlgorithms* CachedAlgorithms(GlooContext* gloo_context,
+                                  ReduceOp reduce_op) {
+  // One instance per reduction, indexed by the value of ReduceOp.
+  static GlooContext* const bound_context = gloo_context;
+  static GlooAlgorithms<T> algorithms[] = {
+      GlooAlgorithms<T>(gloo_context, ReduceOp::SUM),
+      GlooAlgorithms<T>(gloo_context, ReduceOp::ADASUM),
+      GlooAlgorithms<T>(gloo_context, ReduceOp::MIN),
+      GlooAlgorithms<T>(gloo_context, ReduceOp::MAX),
+      GlooAlgorithms<T>(gloo_context, ReduceOp::PRODUCT)};
+  if (gloo_context != bound_context) {
+    throw std::logic_error("Gloo algorithms are bound to another context.");
+  }
+  auto index = (size_t)reduce_op;
+  if (index >= sizeof(algorithms) / sizeof(algorithms[0])) {
+    throw std::logic_error("Reduction " + ReduceOp_Name(reduce_op) +
+                           " is not supported in Gloo mode.");
+  }
+  return &algorithms[index];
+}
+
+} // namespace
+
 IGlooAlgorithms* GetAlgorithmsForType(DataType dtype,
-                                      GlooContext* gloo_context) {
+                                      GlooContext* gloo_context,
+                                      ReduceOp reduce_op) {
   switch (dtype) {
   case HOROVOD_UINT8:
-    return new GlooAlgorithms<u_int8_t>(gloo_context);
+    return CachedAlgorithms<u_int8_t>(gloo_context, reduce_op);
   case HOROVOD_INT8:
-    return new GlooAlgorithms<int8_t>(gloo_context);
+    return CachedAlgorithms<int8_t>(gloo_context, reduce_op);
   case HOROVOD_UINT16:
-    return new GlooAlgorithms<u_int16_t>(gloo_context);
+    return CachedAlgorithms<u_int16_t>(gloo_context, reduce_op);
   case HOROVOD_INT16:
-    return new GlooAlgorithms<int16_t>(gloo_context);
+    return CachedAlgorithms<int16_t>(gloo_context, reduce_op);
   case HOROVOD_INT32:
-    return new GlooAlgorithms<int32_t>(gloo_context);
+    return CachedAlgorithms<int32_t>(gloo_context, reduce_op);
   case HOROVOD_INT64:
-    return new GlooAlgorithms<int64_t>(gloo_context);
+    return CachedAlgorithms<int64_t>(gloo_context, reduce_op);
   case HOROVOD_FLOAT16:
-    return new GlooAlgorithms<gloo::float16>(gloo_context);
+    return CachedAlgorithms<gloo::float16>(gloo_context, reduce_op);
   case HOROVOD_FLOAT32:
-    return new GlooAlgorithms<float>(gloo_context);
+    return CachedAlgorithms<float>(gloo_context, reduce_op);
   case HOROVOD_FLOAT64:
-    return new GlooAlgorithms<double>(gloo_context);
+    return CachedAlgorithms<double>(gloo_context, reduce_op);
   case HOROVOD_BOOL:
-    return new GlooAlgorithms<bool>(gloo_context);
+    return CachedAlgorithms<bool>(gloo_context, reduce_op);
+  case HOROVOD_BFLOAT16:
+    return CachedAlgorithms<GlooBFloat16>(gloo_context, reduce_op);
   default:
     throw std::logic_error("Type " + DataType_Name(dtype) +
                            " is not supported in Gloo mode.");
   }
 }
 
+// Reduction functions used by Gloo allreduce, c = a op b. Half precision
+// types use the kernels shared with MPI instead of those of gloo.
+template <typename T, ReduceOp reduce_op> struct GlooReduction {
+  static void Apply(void* c, const void* a, const void* b, size_t n) {
+    switch (reduce_op) {
+    case ReduceOp::MIN:
+      ::gloo::min<T>(c, a, b, n);
+      break;
+    case ReduceOp::MAX:
+      ::gloo::max<T>(c, a, b, n);
+      break;
+    case ReduceOp::PRODUCT:
+      ::gloo::product<T>(c, a, b, n);
+      break;
+    default:
+      ::gloo::sum<T>(c, a, b, n);
+    }
+  }
+};
+
+template <ReduceOp reduce_op>
+struct GlooReduction<gloo::float16, reduce_op> {
+  static void Apply(void* c, const void* a, const void* b, size_t n) {
+    Float16Reduce(reduce_op, (const uint16_t*)a, (const uint16_t*)b,
+                  (uint16_t*)c, (int64_t)n);
+  }
+};
+
+template <ReduceOp reduce_op> struct GlooReduction<GlooBFloat16, reduce_op> {
+  static void Apply(void* c, const void* a, const void* b, size_t n) {
+    BFloat16Reduce(reduce_op, (const uint16_t*)a, (const uint16_t*)b,
+                   (uint16_t*)c, (int64_t)n);
+  }
+};
+
+using GlooReduceFunction = void (*)(void*, const void*, const void*, size_t);
+
 template <typename T>
-GlooAlgorithms<T>::GlooAlgorithms(GlooContext* gloo_context)
-    : gloo_context_(gloo_context) {}
+GlooReduceFunction GetReduceFunction(ReduceOp reduce_op) {
+  switch (reduce_op) {
+  case ReduceOp::SUM:
+    return &GlooReduction<T, ReduceOp::SUM>::Apply;
+  case ReduceOp::MIN:
+    return &GlooReduction<T, ReduceOp::MIN>::Apply;
+  case ReduceOp::MAX:
+    return &GlooReduction<T, ReduceOp::MAX>::Apply;
+  case ReduceOp::PRODUCT:
+    return &GlooReduction<T, ReduceOp::PRODUCT>::Apply;
+  default:
+    throw std::logic_error("Reduction " + ReduceOp_Name(reduce_op) +
+                           " is not supported in Gloo mode.");
+  }
+}
 
+// Sets the algorithm and reduction of opts and runs the allreduce.
 template <typename T>
-void GlooAlgorithms<T>::Allreduce(void* buffer_data, int num_elements) {
-  if (gloo_context_->ctx->size == 1) {
+void RunAllreduce(gloo::AllreduceOptions& opts, ReduceOp reduce_op,
+                  bool latency_optimized) {
+  opts.setAlgorithm(latency_optimized
+                        ? gloo::AllreduceOptions::Algorithm::BCUBE
+                        : gloo::AllreduceOptions::Algorithm::RING);
+
+  GlooReduceFunction func = GetReduceFunction<T>(reduce_op);
+  opts.setReduceFunction(gloo::AllreduceOptions::Func(func));
+
+  gloo::allreduce(opts);
+}
+
+// Types that the ring allreduce of registered buffers reduces with the
+// kernels of gloo.
+template <typename T> struct VerbsReducible : std::false_type {};
+template <> struct VerbsReducible<float> : std::true_type {};
+template <> struct VerbsReducible<double> : std::true_type {};
+template <> struct VerbsReducible<int32_t> : std::true_type {};
+template <> struct VerbsReducible<int64_t> : std::true_type {};
+template <> struct VerbsReducible<gloo::float16> : std::true_type {};
+
+template <typename T>
+std::unique_ptr<gloo::Algorithm>
+CreateVerbsAllreduce(const std::shared_ptr<gloo::Context>& ctx, void* data,
+                     int num_elements, ReduceOp reduce_op,
+                     bool latency_optimized, std::true_type) {
+  const gloo::ReductionFunction<T>* fn;
+  switch (reduce_op) {
+  case ReduceOp::MIN:
+    fn = gloo::ReductionFunction<T>::min;
+    break;
+  case ReduceOp::MAX:
+    fn = gloo::ReductionFunction<T>::max;
+    break;
+  case ReduceOp::PRODUCT:
+    fn = gloo::ReductionFunction<T>::product;
+    break;
+  default:
+    fn = gloo::ReductionFunction<T>::sum;
+  }
+  std::vector<T*> ptrs = {static_cast<T*>(data)};
+  if (latency_optimized) {
+    return std::unique_ptr<gloo::Algorithm>(
+        new gloo::AllreduceHalvingDoubling<T>(ctx, ptrs, num_elements, fn));
+  }
+  return std::unique_ptr<gloo::Algorithm>(
+      new gloo::AllreduceRing<T>(ctx, ptrs, num_elements, fn));
+}
+
+template <typename T>
+std::unique_ptr<gloo::Algorithm>
+CreateVerbsAllreduce(const std::shared_ptr<gloo::Context>& ctx, void* data,
+                     int num_elements, ReduceOp reduce_op,
+                     bool latency_optimized, std::false_type) {
+  return nullptr;
+}
+
+template <typename T>
+GlooAlgorithms<T>::GlooAlgorithms(GlooContext* gloo_context,
+                                  ReduceOp reduce_op)
+    : gloo_context_(gloo_context), reduce_op_(reduce_op) {}
+
+template <typename T>
+void GlooAlgorithms<T>::Allreduce(void* buffer_data, int num_elements,
+                                  bool latency_optimized) {
+  auto& rails = gloo_context_->rail_ctxs;
+  if (rails.empty() || latency_optimized ||
+      (int64_t)num_elements * (int64_t)sizeof(T) <
+          gloo_context_->stripe_threshold_bytes ||
+      (VerbsReducible<T>::value &&
+       gloo_context_->GetVerbsContext(gloo_context_->ctx) != nullptr)) {
+    Allreduce(gloo_context_->ctx, buffer_data, num_elements,
+              latency_optimized);
+    return;
+  }
+
+  // Each rail reduces its slice of the buffer on its own thread while ctx
+  // reduces the first one.
+  auto counts = gloo_context_->StripeCounts(num_elements);
+  std::vector<std::future<void>> slices;
+  auto data = static_cast<T*>(buffer_data) + counts[0];
+  for (size_t i = 0; i < rails.size(); ++i) {
+    int count = (int)counts[i + 1];
+    if (count > 0) {
+      auto rail = rails[i];
+      slices.push_back(std::async(std::launch::async, [this, rail, data,
+                                                       count]() {
+        Allreduce(rail, data, count, false);
+      }));
+    }
+    data += count;
+  }
+  if (counts[0] > 0) {
+    Allreduce(gloo_context_->ctx, buffer_data, (int)counts[0], false);
+  }
+  for (auto& slice : slices) {
+    slice.get();
+  }
+}
+
+template <typename T>
+void GlooAlgorithms<T>::Allreduce(const std::shared_ptr<gloo::Context>& ctx,
+                                  void* buffer_data, int num_elements,
+                                  bool latency_optimized) {
+  if (ctx->size == 1) {
+    return;
+  }
+
+  // Over ibverbs, the buffer is copied through the staging buffer the
+  // algorithm is registered on.
+  auto verbs = gloo_context_->GetVerbsContext(ctx);
+  if (verbs != nullptr && VerbsReducible<T>::value && num_elements > 0) {
+    size_t bytes = (size_t)num_elements * sizeof(T);
+    auto& algorithm = verbs->Registered(
+        GlooVerbsContext::Key(num_elements, typeid(T).hash_code(),
+                              (int)reduce_op_, latency_optimized),
+        bytes, [&](void* data) {
+          return CreateVerbsAllreduce<T>(verbs->context, data, num_elements,
+                                         reduce_op_, latency_optimized,
+                                         VerbsReducible<T>());
+        });
+    std::memcpy(verbs->data(), buffer_data, bytes);
+    algorithm.run();
+    std::memcpy(buffer_data, verbs->data(), bytes);
     return;
   }
 
-  gloo::AllreduceOptions opts(gloo_context_->ctx);
+  gloo::AllreduceOptions opts(ctx);
   opts.setOutput<T>(static_cast<T*>(buffer_data), (size_t) num_elements);
+  RunAllreduce<T>(opts, reduce_op_, latency_optimized);
+}
 
-  void (*func)(void*, const void*, const void*, size_t) = &::gloo::sum<T>;
-  opts.setReduceFunction(gloo::AllreduceOptions::Func(func));
+template <typename T>
+void GlooAlgorithms<T>::Allreduce(const void* input_data, void* buffer_data,
+                                  int num_elements, bool latency_optimized) {
+  // Striped and ibverbs allreduces only reduce in place.
+  auto& ctx = gloo_context_->ctx;
+  bool striped = !gloo_context_->rail_ctxs.empty() && !latency_optimized &&
+                 (int64_t)num_elements * (int64_t)sizeof(T) >=
+                     gloo_context_->stripe_threshold_bytes;
+  bool verbs = VerbsReducible<T>::value &&
+               gloo_context_->GetVerbsContext(ctx) != nullptr;
+  if (input_data == buffer_data || ctx->size == 1 || striped || verbs) {
+    if (input_data != buffer_data) {
+      std::memcpy(buffer_data, input_data, (size_t)num_elements * sizeof(T));
+    }
+    Allreduce(buffer_data, num_elements, latency_optimized);
+    return;
+  }
 
-  gloo::allreduce(opts);
+  gloo::AllreduceOptions opts(ctx);
+  opts.setInput<T>(static_cast<T*>(const_cast<void*>(input_data)),
+                   (size_t) num_elements);
+  opts.setOutput<T>(static_cast<T*>(buffer_data), (size_t) num_elements);
+  RunAllreduce<T>(opts, reduce_op_, latency_optimized);
 }
 
 template <typename T>
 void GlooAlgorithms<T>::Allgather(void* buffer_data, void* buffer_out,
-                                  int* recvcounts, int* displcmnts) {
+                                  int64_t* recvcounts, int64_t* displcmnts) {
   if (gloo_context_->ctx->size == 1) {
     return;
   }
 
   // create count index
-  std::vector<size_t> counts(recvcounts, recvcounts + gloo_context_->ctx->size);
+  int size = gloo_context_->ctx->size;
+  int rank = gloo_context_->ctx->rank;
+  std::vector<size_t> counts(recvcounts, recvcounts + size);
+
+  auto& rails = gloo_context_->rail_ctxs;
+  int64_t total = 0;
+  for (auto count : counts) {
+    total += (int64_t)count;
+  }
+  if (rails.empty() ||
+      total * (int64_t)sizeof(T) < gloo_context_->stripe_threshold_bytes) {
+    gloo::AllgathervOptions opts(gloo_context_->ctx);
+    opts.setInput<T>(static_cast<T*>(buffer_data) + displcmnts[rank],
+                     counts[rank]);
+    opts.setOutput<T>(static_cast<T*>(buffer_out), counts);
+
+    gloo::allgatherv(opts);
+    return;
+  }
+
+  // The block of each rank is split between ctx and the rails. Each of them
+  // gathers its slices of all blocks into a scratch buffer on its own
+  // thread, and the slices are copied into place once all are done.
+  size_t num_stripes = rails.size() + 1;
+  std::vector<std::vector<size_t>> stripe_counts(
+      num_stripes, std::vector<size_t>(size));
+  std::vector<std::vector<int64_t>> stripe_offsets(
+      num_stripes, std::vector<int64_t>(size));
+  for (int i = 0; i < size; ++i) {
+    auto block_counts = gloo_context_->StripeCounts((int64_t)counts[i]);
+    int64_t offset = displcmnts[i];
+    for (size_t s = 0; s < num_stripes; ++s) {
+      stripe_counts[s][i] = (size_t)block_counts[s];
+      stripe_offsets[s][i] = offset;
+      offset += block_counts[s];
+    }
+  }
+
+  auto& buffers = gloo_context_->stripe_buffers;
+  buffers.resize(num_stripes);
+  auto gather = [&](size_t s) {
+    size_t stripe_total = 0;
+    for (auto count : stripe_counts[s]) {
+      stripe_total += count;
+    }
+    buffers[s].resize(stripe_total * sizeof(T));
+    if (stripe_total == 0) {
+      return;
+    }
+    gloo::AllgathervOptions opts(s == 0 ? gloo_context_->ctx : rails[s - 1]);
+    opts.setInput<T>(static_cast<T*>(buffer_data) + stripe_offsets[s][rank],
+                     stripe_counts[s][rank]);
+    opts.setOutput<T>(reinterpret_cast<T*>(buffers[s].data()),
+                      stripe_counts[s]);
+    gloo::allgatherv(opts);
+  };
+  std::vector<std::future<void>> stripes;
+  for (size_t s = 1; s < num_stripes; ++s) {
+    stripes.push_back(std::async(std::launch::async, gather, s));
+  }
+  gather(0);
+  for (auto& stripe : stripes) {
+    stripe.get();
+  }
+
+  for (size_t s = 0; s < num_stripes; ++s) {
+    auto stripe_data = buffers[s].data();
+    for (int i = 0; i < size; ++i) {
+      size_t bytes = stripe_counts[s][i] * sizeof(T);
+      std::memcpy(static_cast<T*>(buffer_out) + stripe_offsets[s][i],
+                  stripe_data, bytes);
+      stripe_data += bytes;
+    }
+  }
+}
+
+template <typename T>
+void GlooAlgorithms<T>::Reduce(const std::shared_ptr<gloo::Context>& ctx,
+                               void* buffer_data, int num_elements,
+                               int root_rank) {
+  if (ctx->size == 1) {
+    return;
+  }
+
+  gloo::ReduceOptions opts(ctx);
+  opts.setRoot(root_rank);
+  opts.setOutput<T>(static_cast<T*>(buffer_data), (size_t) num_elements);
 
-  gloo::AllgathervOptions opts(gloo_context_->ctx);
-  opts.setInput<T>(static_cast<T*>(buffer_data) +
-                       displcmnts[gloo_context_->ctx->rank],
-                   counts[gloo_context_->ctx->rank]);
-  opts.setOutput<T>(static_cast<T*>(buffer_out), counts);
+  GlooReduceFunction func = GetReduceFunction<T>(reduce_op_);
+  opts.setReduceFunction(gloo::ReduceOptions::Func(func));
 
-  gloo::allgatherv(opts);
+  gloo::reduce(opts);
 }
 
 template <typename T>
 void GlooAlgorithms<T>::Broadcast(void* buffer_data, int num_elements,
                                   int root_rank) {
-  if (gloo_context_->ctx->size == 1) {
+  Broadcast(gloo_context_->ctx, buffer_data, num_elements, root_rank);
+}
+
+template <typename T>
+void GlooAlgorithms<T>::Broadcast(const std::shared_ptr<gloo::Context>& ctx,
+                                  void* buffer_data, int num_elements,
+                                  int root_rank) {
+  if (ctx->size == 1) {
     return;
   }
 
-  gloo::BroadcastOptions opts(gloo_context_->ctx);
+  gloo::BroadcastOptions opts(ctx);
   opts.setRoot(root_rank);
   opts.setOutput<T>(static_cast<T*>(buffer_data), (size_t) num_elements);
   gloo::broadcast(opts);
@@ -120,46 +442,203 @@ Status GlooAllreduce::Execute(std::vector<TensorTableEntry>& entries,
                               const Response& response) {
   auto& first_entry = entries[0];
 
+  const void* fused_input_data;
   void* buffer_data;
+  size_t buffer_len;
   int num_elements = (int)NumElements(entries);
 
-  // Copy memory into the fusion buffer.
+  // Copy memory into the fusion buffer, compressing it if requested, unless
+  // the entries can be reduced directly.
   auto& timeline = global_state_->timeline;
-  if (entries.size() > 1) {
+  DataType dtype = WireDataType(entries);
+  bool compress = dtype != first_entry.tensor->dtype();
+  bool use_fusion_buffer =
+      compress ||
+      !GetDirectBuffers(entries, fused_input_data, buffer_data, buffer_len);
+  if (compress) {
+    timeline.ActivityStartAll(entries, MEMCPY_IN_FUSION_BUFFER);
+    CompressInFusionBuffer(entries, dtype, buffer_data, buffer_len);
+    timeline.ActivityEndAll(entries);
+  } else if (use_fusion_buffer) {
     timeline.ActivityStartAll(entries, MEMCPY_IN_FUSION_BUFFER);
-    const void* fused_input_data;
-    size_t buffer_len;
     MemcpyInFusionBuffer(entries, fused_input_data, buffer_data, buffer_len);
     timeline.ActivityEndAll(entries);
   } else {
-    buffer_data = (void*)first_entry.output->data();
-    std::memcpy(buffer_data, first_entry.tensor->data(),
-                (size_t)first_entry.tensor->size());
+    // A single tensor is reduced straight from its input into its output.
+    PrescaleDirectBuffers(entries, fused_input_data, buffer_data, num_elements);
   }
 
   // Do allreduce.
-  timeline.ActivityStartAll(entries, GLOO_ALLREDUCE);
-  std::unique_ptr<IGlooAlgorithms> gloo_algos(
-      GetAlgorithmsForType(first_entry.tensor->dtype(), gloo_context_));
-  gloo_algos->Allreduce(buffer_data, num_elements);
-  timeline.ActivityEndAll(entries);
+  if (compress) {
+    fused_input_data = buffer_data;
+  }
+  DoAllreduce(entries, fused_input_data, buffer_data, num_elements, dtype,
+              buffer_len);
 
   // Copy memory out of the fusion buffer.
-  if (entries.size() > 1) {
+  if (compress) {
+    timeline.ActivityStartAll(entries, MEMCPY_OUT_FUSION_BUFFER);
+    DecompressOutFusionBuffer(buffer_data, dtype, entries);
+    timeline.ActivityEndAll(entries);
+  } else if (use_fusion_buffer) {
     timeline.ActivityStartAll(entries, MEMCPY_OUT_FUSION_BUFFER);
     MemcpyOutFusionBuffer(buffer_data, entries);
     timeline.ActivityEndAll(entries);
+  } else {
+    PostscaleDirectBuffers(entries, buffer_data, num_elements);
   }
 
   return Status::OK();
 }
 
+void GlooAllreduce::DoAllreduce(std::vector<TensorTableEntry>& entries,
+                                const void* fused_input_data,
+                                void* buffer_data, int num_elements,
+                                DataType dtype, size_t buffer_len) {
+  auto& timeline = global_state_->timeline;
+  timeline.ActivityStartAll(entries, GLOO_ALLREDUCE);
+  IGlooAlgorithms* gloo_algos =
+      GetAlgorithmsForType(dtype, gloo_context_, entries[0].reduce_op);
+  auto process_set = global_state_->process_sets.Get(entries[0].process_set_id);
+  if (process_set != nullptr) {
+    // Process sets reduce in place over their own context, without rails.
+    if (fused_input_data != buffer_data) {
+      std::memcpy(buffer_data, fused_input_data, buffer_len);
+    }
+    gloo_algos->Allreduce(
+        gloo_context_->GetProcessSetContext(process_set.get()), buffer_data,
+        num_elements, UseLatencyOptimizedAllreduce(buffer_len));
+  } else {
+    gloo_algos->Allreduce(fused_input_data, buffer_data, num_elements,
+                          UseLatencyOptimizedAllreduce(buffer_len));
+  }
+  timeline.ActivityEndAll(entries);
+}
+
 bool GlooAllreduce::Enabled(const ParameterManager& param_manager,
                             const std::vector<TensorTableEntry>& entries,
                             const Response& response) const {
   return true;
 }
 
+GlooHierarchicalAllreduce::GlooHierarchicalAllreduce(
+    GlooContext* gloo_context, HorovodGlobalState* global_state)
+    : GlooAllreduce(gloo_context, global_state) {}
+
+void GlooHierarchicalAllreduce::DoAllreduce(
+    std::vector<TensorTableEntry>& entries, const void* fused_input_data,
+    void* buffer_data, int num_elements, DataType dtype, size_t buffer_len) {
+  // Gloo reduces and broadcasts in place.
+  if (fused_input_data != buffer_data) {
+    std::memcpy(buffer_data, fused_input_data, buffer_len);
+  }
+
+  // Local rank 0 reduces the node's data, allreduces it with the other nodes
+  // and broadcasts it back, so that each node sends its data once.
+  auto& timeline = global_state_->timeline;
+  IGlooAlgorithms* gloo_algos =
+      GetAlgorithmsForType(dtype, gloo_context_, entries[0].reduce_op);
+
+  // The node's data is only summed in shared memory.
+  auto& shared_memory = global_state_->shared_memory;
+  bool use_shared_memory =
+      shared_memory.IsEnabled() && entries[0].reduce_op == ReduceOp::SUM;
+  if (use_shared_memory) {
+    // Each local rank allreduces the block it reduced in shared memory with
+    // the same local rank of the other nodes. With nodes of different sizes,
+    // only the local ranks that every node has own a block.
+    timeline.ActivityStartAll(entries, SHARED_MEMORY_ALLREDUCE);
+    shared_memory.Allreduce(
+        buffer_data, num_elements, dtype,
+        [&](void* block, int64_t count) {
+          gloo_algos->Allreduce(gloo_context_->GetGlooContext(CROSS), block,
+                                (int)count,
+                                UseLatencyOptimizedAllreduce(
+                                    (size_t)count * gloo_algos->ElementSize()));
+        },
+        global_state_->controller->GetMinLocalSize());
+    timeline.ActivityEndAll(entries);
+    return;
+  }
+
+  // Only local rank 0 of each node connects the cross-node context.
+  auto local_ctx = gloo_context_->GetGlooContext(LOCAL);
+  timeline.ActivityStartAll(entries, GLOO_REDUCE);
+  gloo_algos->Reduce(local_ctx, buffer_data, num_elements, 0);
+  timeline.ActivityEndAll(entries);
+
+  if (local_ctx->rank == 0) {
+    timeline.ActivityStartAll(entries, GLOO_ALLREDUCE);
+    gloo_algos->Allreduce(gloo_context_->GetGlooContext(CROSS), buffer_data,
+                          num_elements,
+                          UseLatencyOptimizedAllreduce(buffer_len));
+    timeline.ActivityEndAll(entries);
+  }
+
+  timeline.ActivityStartAll(entries, GLOO_BCAST);
+  gloo_algos->Broadcast(local_ctx, buffer_data, num_elements, 0);
+  timeline.ActivityEndAll(entries);
+}
+
+bool GlooHierarchicalAllreduce::Enabled(
+    const ParameterManager& param_manager,
+    const std::vector<TensorTableEntry>& entries,
+    const Response& response) const {
+  return param_manager.HierarchicalAllreduce() &&
+         gloo_context_->ctx != nullptr;
+}
+
+GlooSparseAllreduce::GlooSparseAllreduce(GlooContext* gloo_context,
+                                         HorovodGlobalState* global_state)
+    : SparseAllreduce(global_state), gloo_context_(gloo_context) {}
+
+void GlooSparseAllreduce::Allgather(const SparseElement* sendbuf,
+                                    SparseElement* recvbuf, int count) {
+  if (gloo_context_->ctx->size == 1) {
+    std::memcpy(recvbuf, sendbuf, count * sizeof(SparseElement));
+    return;
+  }
+
+  gloo::AllgatherOptions opts(gloo_context_->ctx);
+  opts.setInput<uint8_t>((uint8_t*)sendbuf, count * sizeof(SparseElement));
+  opts.setOutput<uint8_t>((uint8_t*)recvbuf, gloo_context_->ctx->size * count *
+                                                 sizeof(SparseElement));
+  gloo::allgather(opts);
+}
+
+GlooQuantizedAllreduce::GlooQuantizedAllreduce(
+    GlooContext* gloo_context, HorovodGlobalState* global_state)
+    : QuantizedAllreduce(global_state), gloo_context_(gloo_context) {}
+
+void GlooQuantizedAllreduce::Alltoall(const uint8_t* sendbuf,
+                                      uint8_t* recvbuf, int bytes) {
+  int size = gloo_context_->ctx->size;
+  if (size == 1) {
+    std::memcpy(recvbuf, sendbuf, (size_t)bytes);
+    return;
+  }
+
+  std::vector<int64_t> counts((size_t)size, (int64_t)bytes);
+  gloo::AlltoallvOptions opts(gloo_context_->ctx);
+  opts.setInput<uint8_t>((uint8_t*)sendbuf, counts);
+  opts.setOutput<uint8_t>(recvbuf, counts);
+  gloo::alltoallv(opts);
+}
+
+void GlooQuantizedAllreduce::Allgather(const uint8_t* sendbuf,
+                                       uint8_t* recvbuf, int bytes) {
+  int size = gloo_context_->ctx->size;
+  if (size == 1) {
+    std::memcpy(recvbuf, sendbuf, (size_t)bytes);
+    return;
+  }
+
+  gloo::AllgatherOptions opts(gloo_context_->ctx);
+  opts.setInput<uint8_t>((uint8_t*)sendbuf, (size_t)bytes);
+  opts.setOutput<uint8_t>(recvbuf, (size_t)size * bytes);
+  gloo::allgather(opts);
+}
+
 GlooAllgather::GlooAllgather(GlooContext* gloo_context,
                              HorovodGlobalState* global_state)
     : AllgatherOp(global_state), gloo_context_(gloo_context) {}
@@ -174,21 +653,14 @@ Status GlooAllgather::Execute(std::vector<TensorTableEntry>& entries,
                               const Response& response) {
   auto& timeline = global_state_->timeline;
 
-  // Sizes of subcomponents of each entry from all ranks
-  auto** entry_component_sizes = new int64_t*[entries.size()];
-
-  // Offset of each subcomponent of every entry in the final buffer after
-  // allgatherv
-  auto** entry_component_offsets = new int64_t*[entries.size()];
-
-  int global_size = global_state_->controller->GetSize();
-  auto* recvcounts = new int[global_size]();
-  auto* displcmnts = new int[global_size]();
-
-  for (size_t ec = 0; ec < entries.size(); ++ec) {
-    entry_component_sizes[ec] = new int64_t[global_size]();
-    entry_component_offsets[ec] = new int64_t[global_size]();
-  }
+  // Sizes of subcomponents of each entry from all ranks, and their offsets
+  // in the final buffer after allgatherv.
+  int64_t** entry_component_sizes;
+  int64_t** entry_component_offsets;
+  int64_t* recvcounts;
+  int64_t* displcmnts;
+  GetScratchArrays(entries.size(), entry_component_sizes,
+                   entry_component_offsets, recvcounts, displcmnts);
 
   auto& first_entry = entries[0];
 
@@ -204,8 +676,8 @@ Status GlooAllgather::Execute(std::vector<TensorTableEntry>& entries,
   SetEntryComponentOffsets(entries, entry_component_sizes, recvcounts,
                            entry_component_offsets);
 
-  std::unique_ptr<IGlooAlgorithms> gloo_algos(
-      GetAlgorithmsForType(first_entry.tensor->dtype(), gloo_context_));
+  IGlooAlgorithms* gloo_algos =
+      GetAlgorithmsForType(first_entry.tensor->dtype(), gloo_context_);
   int element_size = gloo_algos->ElementSize();
 
   void* sendbuf = nullptr;
@@ -220,7 +692,7 @@ Status GlooAllgather::Execute(std::vector<TensorTableEntry>& entries,
     // need to move input data to its corresponding location in the output
     sendbuf = (void*)first_entry.tensor->data();
     buffer_data = (void*)first_entry.output->data();
-    int buffer_offset = displcmnts[gloo_context_->ctx->rank] * element_size;
+    int64_t buffer_offset = displcmnts[gloo_context_->ctx->rank] * element_size;
     std::memcpy((uint8_t*)buffer_data + buffer_offset, sendbuf,
                 (size_t)first_entry.tensor->size());
     sendbuf = buffer_data;
@@ -239,16 +711,6 @@ Status GlooAllgather::Execute(std::vector<TensorTableEntry>& entries,
     timeline.ActivityEndAll(entries);
   }
 
-  delete[] recvcounts;
-  delete[] displcmnts;
-
-  for (size_t ec = 0; ec < entries.size(); ++ec) {
-    delete[] entry_component_sizes[ec];
-    delete[] entry_component_offsets[ec];
-  }
-  delete[] entry_component_sizes;
-  delete[] entry_component_offsets;
-
   return Status::OK();
 }
 
@@ -258,26 +720,37 @@ GlooBroadcast::GlooBroadcast(GlooContext* gloo_context,
 
 Status GlooBroadcast::Execute(std::vector<TensorTableEntry>& entries,
                               const Response& response) {
-  assert(entries.size() == 1);
-  auto e = entries[0];
+  auto& first_entry = entries[0];
+  bool is_root = global_state_->controller->GetRank() == first_entry.root_rank;
 
   // On root rank, MPI_Bcast sends data, on other ranks it receives data.
   // for gloo broadcast, only output needs to be set if inplace
 
   void* data_ptr;
-  if (global_state_->controller->GetRank() == e.root_rank) {
-    data_ptr = (void*)e.tensor->data();
+  if (entries.size() > 1) {
+    size_t buffer_len;
+    global_state_->timeline.ActivityStartAll(entries, MEMCPY_IN_FUSION_BUFFER);
+    MemcpyInFusionBuffer(entries, data_ptr, buffer_len);
+    global_state_->timeline.ActivityEndAll(entries);
+  } else if (is_root) {
+    data_ptr = (void*)first_entry.tensor->data();
   } else {
-    data_ptr = (void*)e.output->data();
+    data_ptr = (void*)first_entry.output->data();
   }
 
   global_state_->timeline.ActivityStartAll(entries, GLOO_BCAST);
-  std::unique_ptr<IGlooAlgorithms> gloo_algos(
-      GetAlgorithmsForType(e.tensor->dtype(), gloo_context_));
-  gloo_algos->Broadcast(data_ptr, (int)e.tensor->shape().num_elements(),
-                        e.root_rank);
+  IGlooAlgorithms* gloo_algos =
+      GetAlgorithmsForType(first_entry.tensor->dtype(), gloo_context_);
+  gloo_algos->Broadcast(data_ptr, (int)NumElements(entries),
+                        first_entry.root_rank);
   global_state_->timeline.ActivityEndAll(entries);
 
+  if (entries.size() > 1 && !is_root) {
+    global_state_->timeline.ActivityStartAll(entries, MEMCPY_OUT_FUSION_BUFFER);
+    MemcpyOutFusionBuffer(data_ptr, entries);
+    global_state_->timeline.ActivityEndAll(entries);
+  }
+
   return Status::OK();
 }
 
@@ -287,5 +760,112 @@ bool GlooBroadcast::Enabled(const ParameterManager& param_manager,
   return true;
 }
 
+GlooReducescatter::GlooReducescatter(GlooContext* gloo_context,
+                                     HorovodGlobalState* global_state)
+    : ReducescatterOp(global_state), gloo_context_(gloo_context) {}
+
+Status GlooReducescatter::Execute(std::vector<TensorTableEntry>& entries,
+                                  const Response& response) {
+  auto& timeline = global_state_->timeline;
+  auto& first_entry = entries[0];
+
+  std::vector<int> recvcounts;
+  std::vector<int> displcmnts;
+  timeline.ActivityStartAll(entries, ALLOCATE_OUTPUT);
+  Status status = AllocateOutput(entries, recvcounts, displcmnts);
+  if (!status.ok()) {
+    return status;
+  }
+  timeline.ActivityEndAll(entries);
+
+  // A single tensor is reduced from its input into reduce_buffer_.
+  void* buffer_data;
+  const void* input_data;
+  if (entries.size() > 1) {
+    size_t buffer_len;
+    timeline.ActivityStartAll(entries, MEMCPY_IN_FUSION_BUFFER);
+    MemcpyInFusionBuffer(entries, buffer_data, buffer_len);
+    timeline.ActivityEndAll(entries);
+    input_data = buffer_data;
+  } else {
+    reduce_buffer_.resize((size_t)first_entry.tensor->size());
+    buffer_data = reduce_buffer_.data();
+    input_data = first_entry.tensor->data();
+  }
+
+  // The new Gloo API has no reduce-scatter, so the packed input is
+  // allreduced and this rank keeps its block, which is still at its offset.
+  timeline.ActivityStartAll(entries, GLOO_REDUCESCATTER);
+  IGlooAlgorithms* gloo_algos =
+      GetAlgorithmsForType(first_entry.tensor->dtype(), gloo_context_);
+  gloo_algos->Allreduce(input_data, buffer_data, (int)NumElements(entries),
+                        false);
+  timeline.ActivityEndAll(entries);
+
+  timeline.ActivityStartAll(entries, MEMCPY_OUT_FUSION_BUFFER);
+  int rank = global_state_->controller->GetRank();
+  MemcpyOutFusionBuffer((uint8_t*)buffer_data +
+                            (int64_t)displcmnts[rank] * gloo_algos->ElementSize(),
+                        entries);
+  timeline.ActivityEndAll(entries);
+
+  return Status::OK();
+}
+
+bool GlooReducescatter::Enabled(const ParameterManager& param_manager,
+                                const std::vector<TensorTableEntry>& entries,
+                                const Response& response) const {
+  return true;
+}
+
+GlooAlltoall::GlooAlltoall(GlooContext* gloo_context,
+                           HorovodGlobalState* global_state)
+    : AlltoallOp(global_state), gloo_context_(gloo_context) {}
+
+Status GlooAlltoall::Execute(std::vector<TensorTableEntry>& entries,
+                             const Response& response) {
+  auto& timeline = global_state_->timeline;
+  auto& e = entries[0];
+
+  std::vector<int> sendcounts, sdispls, recvcounts, rdispls;
+  timeline.ActivityStartAll(entries, ALLOCATE_OUTPUT);
+  Status status =
+      AllocateOutput(e, response, sendcounts, sdispls, recvcounts, rdispls);
+  if (!status.ok()) {
+    return status;
+  }
+  timeline.ActivityEndAll(entries);
+
+  timeline.ActivityStartAll(entries, GLOO_ALLTOALL);
+  if (gloo_context_->ctx->size == 1) {
+    std::memcpy((void*)e.output->data(), e.tensor->data(),
+                (size_t)e.tensor->size());
+  } else {
+    // Exchange bytes, so that any data type is supported.
+    int element_size =
+        global_state_->controller->GetTypeSize(e.tensor->dtype());
+    std::vector<int64_t> send_bytes(sendcounts.begin(), sendcounts.end());
+    std::vector<int64_t> recv_bytes(recvcounts.begin(), recvcounts.end());
+    for (size_t rc = 0; rc < send_bytes.size(); ++rc) {
+      send_bytes[rc] *= element_size;
+      recv_bytes[rc] *= element_size;
+    }
+
+    gloo::AlltoallvOptions opts(gloo_context_->ctx);
+    opts.setInput<uint8_t>((uint8_t*)e.tensor->data(), send_bytes);
+    opts.setOutput<uint8_t>((uint8_t*)e.output->data(), recv_bytes);
+    gloo::alltoallv(opts);
+  }
+  timeline.ActivityEndAll(entries);
+
+  return Status::OK();
+}
+
+bool GlooAlltoall::Enabled(const ParameterManager& param_manager,
+                           const std::vector<TensorTableEntry>& entries,
+                           const Response& response) const {
+  return true;
+}
+
 } // namespace common
 } // namespace horovod
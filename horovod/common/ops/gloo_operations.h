@@ -17,17 +17,46 @@
 #define HOROVOD_GLOO_OPERATIONS_H
 
 #include "collective_operations.h"
+#include "quantized_operations.h"
+#include "sparse_operations.h"
 #include "../gloo/gloo_context.h"
 
 namespace horovod {
 namespace common {
 
+// Element type of bfloat16 tensors, which Gloo has no type for.
+struct GlooBFloat16 {
+  uint16_t bits;
+};
+
 class IGlooAlgorithms {
 public:
-  virtual void Allreduce(void* buffer_data, int num_elements) = 0;
+  // Allreduces in place with the ring, or with bcube, which takes a
+  // logarithmic number of steps, when latency_optimized is set.
+  virtual void Allreduce(void* buffer_data, int num_elements,
+                         bool latency_optimized) = 0;
+
+  // Allreduces input_data into buffer_data, which may be the same buffer.
+  // Gloo reduces the input into the output as it goes, which saves copying
+  // it there first.
+  virtual void Allreduce(const void* input_data, void* buffer_data,
+                         int num_elements, bool latency_optimized) = 0;
+
+  // Variants over the given context, e.g. the local or cross one, rather
+  // than the global one.
+  virtual void Allreduce(const std::shared_ptr<gloo::Context>& ctx,
+                         void* buffer_data, int num_elements,
+                         bool latency_optimized) = 0;
+
+  virtual void Reduce(const std::shared_ptr<gloo::Context>& ctx,
+                      void* buffer_data, int num_elements, int root_rank) = 0;
+
+  virtual void Broadcast(const std::shared_ptr<gloo::Context>& ctx,
+                         void* buffer_data, int num_elements,
+                         int root_rank) = 0;
 
-  virtual void Allgather(void* buffer_data, void* buffer_out, int* recvcounts,
-                         int* displcmnts) = 0;
+  virtual void Allgather(void* buffer_data, void* buffer_out,
+                         int64_t* recvcounts, int64_t* displcmnts) = 0;
 
   virtual void Broadcast(void* buffer_data, int num_elements,
                          int root_rank) = 0;
@@ -35,16 +64,38 @@ public:
   virtual int ElementSize() const = 0;
 };
 
+// Returns the algorithms for tensors of dtype from a table built on first
+// use, so that dispatching a collective does not allocate. The table is
+// bound to the first gloo_context it is called with.
+IGlooAlgorithms* GetAlgorithmsForType(DataType dtype,
+                                      GlooContext* gloo_context,
+                                      ReduceOp reduce_op = ReduceOp::SUM);
+
 template <typename T> class GlooAlgorithms : public IGlooAlgorithms {
 public:
-  GlooAlgorithms(GlooContext* gloo_context);
+  // Reductions combine the values of the ranks with reduce_op.
+  GlooAlgorithms(GlooContext* gloo_context,
+                 ReduceOp reduce_op = ReduceOp::SUM);
 
   ~GlooAlgorithms() = default;
 
-  void Allreduce(void* buffer_data, int num_elements) override;
+  void Allreduce(void* buffer_data, int num_elements,
+                 bool latency_optimized) override;
+
+  void Allreduce(const void* input_data, void* buffer_data, int num_elements,
+                 bool latency_optimized) override;
+
+  void Allreduce(const std::shared_ptr<gloo::Context>& ctx, void* buffer_data,
+                 int num_elements, bool latency_optimized) override;
+
+  void Reduce(const std::shared_ptr<gloo::Context>& ctx, void* buffer_data,
+              int num_elements, int root_rank) override;
+
+  void Broadcast(const std::shared_ptr<gloo::Context>& ctx, void* buffer_data,
+                 int num_elements, int root_rank) override;
 
-  void Allgather(void* buffer_data, void* buffer_out, int* recvcounts,
-                 int* displcmnts) override;
+  void Allgather(void* buffer_data, void* buffer_out, int64_t* recvcounts,
+                 int64_t* displcmnts) override;
 
   void Broadcast(void* buffer_data, int num_elements, int root_rank) override;
 
@@ -52,6 +103,7 @@ public:
 
 private:
   GlooContext* gloo_context_;
+  ReduceOp reduce_op_;
 };
 
 class GlooAllreduce : public AllreduceOp {
@@ -68,6 +120,59 @@ public:
                const Response& response) const override;
 
 protected:
+  // Allreduces fused_input_data into buffer_data, which is the same buffer
+  // unless a single tensor is reduced directly into its output.
+  virtual void DoAllreduce(std::vector<TensorTableEntry>& entries,
+                           const void* fused_input_data, void* buffer_data,
+                           int num_elements, DataType dtype,
+                           size_t buffer_len);
+
+  GlooContext* gloo_context_;
+};
+
+// Allreduces in two levels: a reduce onto local rank 0 of each node, an
+// allreduce among them over the cross context, and a broadcast within each
+// node, so that each node sends its data once instead of once per local rank.
+// With the shared memory arena, the local ranks of homogeneous clusters
+// instead each reduce a block in shared memory and allreduce it across nodes.
+class GlooHierarchicalAllreduce : public GlooAllreduce {
+public:
+  GlooHierarchicalAllreduce(GlooContext* gloo_context,
+                            HorovodGlobalState* global_state);
+
+  bool Enabled(const ParameterManager& param_manager,
+               const std::vector<TensorTableEntry>& entries,
+               const Response& response) const override;
+
+protected:
+  void DoAllreduce(std::vector<TensorTableEntry>& entries,
+                   const void* fused_input_data, void* buffer_data,
+                   int num_elements, DataType dtype,
+                   size_t buffer_len) override;
+};
+
+class GlooSparseAllreduce : public SparseAllreduce {
+public:
+  GlooSparseAllreduce(GlooContext* gloo_context,
+                      HorovodGlobalState* global_state);
+
+protected:
+  void Allgather(const SparseElement* sendbuf, SparseElement* recvbuf,
+                 int count) override;
+
+  GlooContext* gloo_context_;
+};
+
+class GlooQuantizedAllreduce : public QuantizedAllreduce {
+public:
+  GlooQuantizedAllreduce(GlooContext* gloo_context,
+                         HorovodGlobalState* global_state);
+
+protected:
+  void Alltoall(const uint8_t* sendbuf, uint8_t* recvbuf, int bytes) override;
+
+  void Allgather(const uint8_t* sendbuf, uint8_t* recvbuf, int bytes) override;
+
   GlooContext* gloo_context_;
 };
 
@@ -101,6 +206,41 @@ protected:
   GlooContext* gloo_context_;
 };
 
+class GlooReducescatter : public ReducescatterOp {
+public:
+  GlooReducescatter(GlooContext* gloo_context,
+                    HorovodGlobalState* global_state);
+
+  Status Execute(std::vector<TensorTableEntry>& entries,
+                 const Response& response) override;
+
+  bool Enabled(const ParameterManager& param_manager,
+               const std::vector<TensorTableEntry>& entries,
+               const Response& response) const override;
+
+protected:
+  GlooContext* gloo_context_;
+
+private:
+  // Output of the allreduce of a single tensor.
+  std::vector<uint8_t> reduce_buffer_;
+};
+
+class GlooAlltoall : public AlltoallOp {
+public:
+  GlooAlltoall(GlooContext* gloo_context, HorovodGlobalState* global_state);
+
+  Status Execute(std::vector<TensorTableEntry>& entries,
+                 const Response& response) override;
+
+  bool Enabled(const ParameterManager& param_manager,
+               const std::vector<TensorTableEntry>& entries,
+               const Response& response) const override;
+
+protected:
+  GlooContext* gloo_context_;
+};
+
 } // namespace common
 } // namespace horovod
 
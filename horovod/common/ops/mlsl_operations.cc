@@ -79,6 +79,7 @@ void MLSLContext::Setup(int size) {
 }
 
 void MLSLContext::Finalize() {
+  Progress(true);
   dist->Barrier(MLSL::GT_GLOBAL);
   LOG(DEBUG) << "Background thread comm destroy";
 
@@ -89,51 +90,144 @@ void MLSLContext::Finalize() {
   MLSL::Environment::GetEnv().Finalize();
 }
 
+void MLSLContext::Enqueue(MLSL::CommReq* req,
+                          const std::vector<TensorTableEntry>& entries,
+                          std::shared_ptr<PersistentBuffer> buffer,
+                          std::function<void()> on_complete,
+                          std::string error_message, Timeline& timeline) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  while (in_flight_.size() >= MLSL_MAX_IN_FLIGHT) {
+    Complete(in_flight_.front(), true);
+    in_flight_.pop_front();
+  }
+  in_flight_.push_back({req, entries, std::move(buffer),
+                        std::move(on_complete), std::move(error_message),
+                        &timeline});
+}
+
+void MLSLContext::Progress(bool wait) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  for (auto it = in_flight_.begin(); it != in_flight_.end();) {
+    if (Complete(*it, wait)) {
+      it = in_flight_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void MLSLContext::WaitForBuffer(
+    const std::shared_ptr<PersistentBuffer>& buffer) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  for (auto it = in_flight_.begin(); it != in_flight_.end();) {
+    if (it->buffer == buffer) {
+      Complete(*it, true);
+      it = in_flight_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+bool MLSLContext::Complete(InFlightRequest& request, bool wait) {
+  Status status = Status::OK();
+  try {
+    if (wait) {
+      MLSL::Environment::GetEnv().Wait(request.req);
+    } else if (!MLSL::Environment::GetEnv().Test(request.req)) {
+      return false;
+    }
+  } catch (...) {
+    status = Status::UnknownError(request.error_message);
+  }
+  auto& timeline = *request.timeline;
+  timeline.ActivityEndAll(request.entries);
+
+  if (status.ok() && request.on_complete) {
+    try {
+      request.on_complete();
+    } catch (const std::exception& ex) {
+      status = Status::UnknownError(ex.what());
+    }
+  }
+
+  for (auto& e : request.entries) {
+    timeline.End(e.tensor_name, status.ok() ? e.output : nullptr);
+    e.callback(status);
+  }
+  return true;
+}
+
 MLSLAllreduce::MLSLAllreduce(MLSLContext* mlsl_context, HorovodGlobalState* global_state)
     : AllreduceOp(global_state), mlsl_context_(mlsl_context) {}
 
 Status MLSLAllreduce::Execute(std::vector<TensorTableEntry>& entries, const Response& response) {
   auto& first_entry = entries[0];
 
+  MLSL::ReductionType reduction_type;
+  switch (response.reduce_op()) {
+  case ReduceOp::SUM:
+    reduction_type = MLSL::RT_SUM;
+    break;
+  case ReduceOp::MIN:
+    reduction_type = MLSL::RT_MIN;
+    break;
+  case ReduceOp::MAX:
+    reduction_type = MLSL::RT_MAX;
+    break;
+  default:
+    return Status::PreconditionError(
+        ReduceOp_Name(response.reduce_op()) +
+        " allreduce is not supported in MLSL mode.");
+  }
+
+  // Complete the requests that finished while this response was negotiated.
+  mlsl_context_->Progress(false);
+
+  const void* fused_input_data;
   void* buffer_data;
   size_t buffer_len;
   int64_t num_elements = NumElements(entries);
 
-  // Copy memory into the fusion buffer.
+  // Copy memory into the fusion buffer, unless the entries can be reduced
+  // directly.
   auto& timeline = global_state_->timeline;
-  if (entries.size() > 1) {
+  bool use_fusion_buffer =
+      !GetDirectBuffers(entries, fused_input_data, buffer_data, buffer_len);
+  std::shared_ptr<PersistentBuffer> fusion_buffer;
+  if (use_fusion_buffer) {
+    fusion_buffer = CurrentFusionBuffer(first_entry);
+    mlsl_context_->WaitForBuffer(fusion_buffer);
     timeline.ActivityStartAll(entries, MEMCPY_IN_FUSION_BUFFER);
-    const void* fused_input_data;
     MemcpyInFusionBuffer(entries, fused_input_data, buffer_data, buffer_len);
     timeline.ActivityEndAll(entries);
   } else {
-    buffer_data = (void*) first_entry.output->data();
-    buffer_len = (size_t) first_entry.output->size();
+    PrescaleDirectBuffers(entries, fused_input_data, buffer_data, num_elements);
   }
 
-  // Do allreduce.
+  // Start the allreduce, the entries are completed once it is done.
   timeline.ActivityStartAll(entries, MLSL_ALLREDUCE);
-  const void* sendbuf = entries.size() > 1 || first_entry.tensor->data() == first_entry.output->data()
-                        ? buffer_data : first_entry.tensor->data();
+  const void* sendbuf = fused_input_data;
   auto mlsl_req = mlsl_context_->dist->AllReduce((void*)sendbuf, buffer_data, num_elements,
                                                  GetMLSLDataType(first_entry.tensor),
-                                                 MLSL::RT_SUM, MLSL::GT_DATA);
-
-  try {
-      MLSL::Environment::GetEnv().Wait(mlsl_req);
-  } catch (...) {
-      throw std::logic_error("MLSL_Allreduce failed.");
-  }
-  timeline.ActivityEndAll(entries);
-
-  // Copy memory out of the fusion buffer.
-  if (entries.size() > 1) {
-    timeline.ActivityStartAll(entries, MEMCPY_OUT_FUSION_BUFFER);
-    MemcpyOutFusionBuffer(buffer_data, entries);
-    timeline.ActivityEndAll(entries);
-  }
+                                                 reduction_type, MLSL::GT_DATA);
+
+  auto on_complete = [this, entries, buffer_data, num_elements,
+                      use_fusion_buffer]() mutable {
+    // Copy memory out of the fusion buffer.
+    if (use_fusion_buffer) {
+      auto& timeline = global_state_->timeline;
+      timeline.ActivityStartAll(entries, MEMCPY_OUT_FUSION_BUFFER);
+      MemcpyOutFusionBuffer(buffer_data, entries);
+      timeline.ActivityEndAll(entries);
+    } else {
+      PostscaleDirectBuffers(entries, buffer_data, num_elements);
+    }
+  };
+  mlsl_context_->Enqueue(mlsl_req, entries, fusion_buffer, on_complete,
+                         "MLSL_Allreduce failed.", timeline);
 
-  return Status::OK();
+  return Status::InProgress();
 }
 
 bool MLSLAllreduce::Enabled(const ParameterManager& param_manager,
@@ -166,21 +260,14 @@ bool MLSLAllgather::Enabled(const ParameterManager& param_manager,
 Status MLSLAllgather::Execute(std::vector<TensorTableEntry>& entries, const Response& response) {
   auto& timeline = global_state_->timeline;
 
-  // Sizes of subcomponents of each entry from all ranks
-  auto** entry_component_sizes = new int64_t* [entries.size()];
-
-  // Offset of each subcomponent of every entry in the final buffer after
-  // allgatherv
-  auto** entry_component_offsets = new int64_t* [entries.size()];
-
-  int global_size = global_state_->controller->GetSize();
-  auto* recvcounts = new int[global_size]();
-  auto* displcmnts = new int[global_size]();
-
-  for (size_t ec = 0; ec < entries.size(); ++ec) {
-    entry_component_sizes[ec] = new int64_t[global_size]();
-    entry_component_offsets[ec] = new int64_t[global_size]();
-  }
+  // Sizes of subcomponents of each entry from all ranks, and their offsets
+  // in the final buffer after allgatherv.
+  int64_t** entry_component_sizes;
+  int64_t** entry_component_offsets;
+  int64_t* recvcounts;
+  int64_t* displcmnts;
+  GetScratchArrays(entries.size(), entry_component_sizes,
+                   entry_component_offsets, recvcounts, displcmnts);
 
   auto& first_entry = entries[0];
 
@@ -196,11 +283,17 @@ Status MLSLAllgather::Execute(std::vector<TensorTableEntry>& entries, const Resp
 
   int element_size = global_state_->controller->GetTypeSize(first_entry.tensor->dtype());
 
+  // Complete the requests that finished while this response was negotiated.
+  mlsl_context_->Progress(false);
+
   const void* sendbuf = nullptr;
   void* buffer_data;
+  std::shared_ptr<PersistentBuffer> fusion_buffer;
   int64_t total_num_elements = NumElements(entries);
 
   if (entries.size() > 1) {
+    fusion_buffer = CurrentFusionBuffer(first_entry);
+    mlsl_context_->WaitForBuffer(fusion_buffer);
     timeline.ActivityStartAll(entries, MEMCPY_IN_FUSION_BUFFER);
     MemcpyInFusionBuffer(entries, displcmnts, element_size, buffer_data);
     timeline.ActivityEndAll(entries);
@@ -209,73 +302,101 @@ Status MLSLAllgather::Execute(std::vector<TensorTableEntry>& entries, const Resp
     buffer_data = (void*) first_entry.output->data();
   }
 
-  auto* rcounts = new uint64_t[global_size]();
-  for (unsigned int rc = 0; rc < global_size; rc++) {
-    rcounts[rc] = recvcounts[rc] * element_size;
+  // The receive counts and the offsets of the entries in the gathered buffer
+  // are used until the request completes, so they are owned by it rather
+  // than kept in the scratch arrays reused by the next allgather.
+  int global_size = global_state_->controller->GetSize();
+  auto rcounts = std::make_shared<std::vector<uint64_t>>(global_size);
+  for (int rc = 0; rc < global_size; rc++) {
+    (*rcounts)[rc] = recvcounts[rc] * element_size;
+  }
+  std::vector<int64_t> component_offsets;
+  std::vector<int64_t> component_sizes;
+  if (entries.size() > 1) {
+    for (size_t ec = 0; ec < entries.size(); ++ec) {
+      component_offsets.insert(component_offsets.end(),
+                               entry_component_offsets[ec],
+                               entry_component_offsets[ec] + global_size);
+      component_sizes.insert(component_sizes.end(), entry_component_sizes[ec],
+                             entry_component_sizes[ec] + global_size);
+    }
   }
 
-  global_state_->timeline.ActivityStartAll(entries, MLSL_ALLGATHER);
+  // Start the allgather, the entries are completed once it is done.
+  timeline.ActivityStartAll(entries, MLSL_ALLGATHER);
   auto mlsl_req = mlsl_context_->dist->AllGatherv(sendbuf != nullptr ? (void*)sendbuf : buffer_data,
                                                   total_num_elements * element_size,
-                                                  buffer_data, rcounts,
+                                                  buffer_data, rcounts->data(),
                                                   MLSL::DT_BYTE, MLSL::GT_DATA);
-  try {
-      MLSL::Environment::GetEnv().Wait(mlsl_req);
-  } catch (...) {
-      throw std::logic_error("MLSL_Allgather failed.");
-  }
-  global_state_->timeline.ActivityEndAll(entries);
 
-  if (entries.size() > 1) {
-    timeline.ActivityStartAll(entries, MEMCPY_OUT_FUSION_BUFFER);
-    MemcpyOutFusionBuffer(entry_component_offsets, entry_component_sizes,
-                          buffer_data, element_size, entries);
-    timeline.ActivityEndAll(entries);
-  }
-
-  delete[] rcounts;
-  delete[] recvcounts;
-  delete[] displcmnts;
-
-  for (size_t ec = 0; ec < entries.size(); ++ec) {
-    delete[] entry_component_sizes[ec];
-    delete[] entry_component_offsets[ec];
-  }
-  delete[] entry_component_sizes;
-  delete[] entry_component_offsets;
+  auto on_complete = [this, entries, buffer_data, element_size, global_size,
+                      rcounts, component_offsets, component_sizes]() mutable {
+    if (entries.size() > 1) {
+      std::vector<const int64_t*> offset_rows;
+      std::vector<const int64_t*> size_rows;
+      for (size_t ec = 0; ec < entries.size(); ++ec) {
+        offset_rows.push_back(component_offsets.data() + ec * global_size);
+        size_rows.push_back(component_sizes.data() + ec * global_size);
+      }
+      auto& timeline = global_state_->timeline;
+      timeline.ActivityStartAll(entries, MEMCPY_OUT_FUSION_BUFFER);
+      MemcpyOutFusionBuffer(offset_rows.data(), size_rows.data(), buffer_data,
+                            element_size, entries);
+      timeline.ActivityEndAll(entries);
+    }
+  };
+  mlsl_context_->Enqueue(mlsl_req, entries, fusion_buffer, on_complete,
+                         "MLSL_Allgather failed.", timeline);
 
-  return Status::OK();
+  return Status::InProgress();
 }
 
 MLSLBroadcast::MLSLBroadcast(MLSLContext* mlsl_context, HorovodGlobalState* global_state)
     : BroadcastOp(global_state), mlsl_context_(mlsl_context) {}
 
 Status MLSLBroadcast::Execute(std::vector<TensorTableEntry>& entries, const Response& response) {
-  assert(entries.size() == 1);
-  auto e = entries[0];
+  auto& first_entry = entries[0];
+  bool is_root = global_state_->controller->GetRank() == first_entry.root_rank;
+
+  // Complete the requests that finished while this response was negotiated.
+  mlsl_context_->Progress(false);
 
   // On root rank, MLSL_Bcast sends data, on other ranks it receives data.
+  auto& timeline = global_state_->timeline;
   void* data_ptr;
   size_t size;
-  if (global_state_->controller->GetRank() == e.root_rank) {
-    data_ptr = (void*) e.tensor->data();
-    size = e.tensor->size();
+  std::shared_ptr<PersistentBuffer> fusion_buffer;
+  if (entries.size() > 1) {
+    fusion_buffer = CurrentFusionBuffer(first_entry);
+    mlsl_context_->WaitForBuffer(fusion_buffer);
+    timeline.ActivityStartAll(entries, MEMCPY_IN_FUSION_BUFFER);
+    MemcpyInFusionBuffer(entries, data_ptr, size);
+    timeline.ActivityEndAll(entries);
+  } else if (is_root) {
+    data_ptr = (void*) first_entry.tensor->data();
+    size = first_entry.tensor->size();
   } else {
-    data_ptr = (void*) e.output->data();
-    size = e.output->size();
+    data_ptr = (void*) first_entry.output->data();
+    size = first_entry.output->size();
   }
 
-  global_state_->timeline.ActivityStartAll(entries, MLSL_BCAST);
+  // Start the broadcast, the entries are completed once it is done.
+  timeline.ActivityStartAll(entries, MLSL_BCAST);
   auto mlsl_req = mlsl_context_->dist->Bcast(data_ptr, size, MLSL::DT_BYTE,
-                                             e.root_rank, MLSL::GT_DATA);
-  try {
-      MLSL::Environment::GetEnv().Wait(mlsl_req);
-  } catch (...) {
-      throw std::logic_error("MLSL_Bcast failed.");
-  }
-  global_state_->timeline.ActivityEndAll(entries);
+                                             first_entry.root_rank, MLSL::GT_DATA);
+
+  auto on_complete = [this, entries, data_ptr, is_root]() mutable {
+    if (entries.size() > 1 && !is_root) {
+      auto& timeline = global_state_->timeline;
+      timeline.ActivityStartAll(entries, MEMCPY_OUT_FUSION_BUFFER);
+      MemcpyOutFusionBuffer(data_ptr, entries);
+      timeline.ActivityEndAll(entries);
+    }
+  };
+  mlsl_context_->Enqueue(mlsl_req, entries, fusion_buffer, on_complete,
+                         "MLSL_Bcast failed.", timeline);
 
-  return Status::OK();
+  return Status::InProgress();
 }
 
 bool MLSLBroadcast::Enabled(const ParameterManager& param_manager,
@@ -18,7 +18,10 @@
 #ifndef HOROVOD_MLSL_OPERATIONS_H
 #define HOROVOD_MLSL_OPERATIONS_H
 
+#include <deque>
+#include <functional>
 #include <iostream>
+#include <mutex>
 #include <pthread.h>
 
 #include "mlsl.hpp"
@@ -30,6 +33,9 @@
 namespace horovod {
 namespace common {
 
+// Maximum number of MLSL requests left in flight before waiting for the oldest.
+#define MLSL_MAX_IN_FLIGHT 8
+
 struct MLSLContext {
   MLSL::Distribution *dist;
 
@@ -38,6 +44,41 @@ struct MLSLContext {
   void Setup(int size);
 
   void Finalize();
+
+  // Leaves the request issued for the entries in flight. Once it is done,
+  // on_complete runs, e.g. to copy the outputs out of the fusion buffer, and
+  // the entries are completed. buffer is the fusion buffer used by the
+  // request, or null, and is kept alive until it completes.
+  void Enqueue(MLSL::CommReq* req, const std::vector<TensorTableEntry>& entries,
+               std::shared_ptr<PersistentBuffer> buffer,
+               std::function<void()> on_complete, std::string error_message,
+               Timeline& timeline);
+
+  // Completes the requests that are done, or with wait all of them.
+  void Progress(bool wait);
+
+  // Completes the requests still using the given fusion buffer, before it is
+  // overwritten.
+  void WaitForBuffer(const std::shared_ptr<PersistentBuffer>& buffer);
+
+private:
+  struct InFlightRequest {
+    MLSL::CommReq* req;
+    std::vector<TensorTableEntry> entries;
+    std::shared_ptr<PersistentBuffer> buffer;
+    std::function<void()> on_complete;
+    std::string error_message;
+    Timeline* timeline;
+  };
+
+  // Completes the request, waiting for it if wait is true. Returns false if
+  // it is not done yet.
+  bool Complete(InFlightRequest& request, bool wait);
+
+  // Requests in the order they were issued. Operations may run on the
+  // execution thread while the background thread makes progress.
+  std::deque<InFlightRequest> in_flight_;
+  std::mutex mutex_;
 };
 
 class MLSLAllreduce : public AllreduceOp {
@@ -30,42 +30,63 @@ Status MPI_CUDAAllreduce::Execute(std::vector<TensorTableEntry>& entries, const
 
   InitCUDA(entries);
 
+  const void* fused_input_data;
   void* buffer_data;
   size_t buffer_len;
   int64_t num_elements = NumElements(entries);
 
-  // Copy memory into the fusion buffer.
+  // Copy memory into the fusion buffer, unless the entries can be reduced
+  // directly.
   auto& timeline = global_state_->timeline;
-  if (entries.size() > 1) {
+  bool staged = !mpi_context_->IsCUDAAware();
+  bool use_fusion_buffer =
+      !GetDirectBuffers(entries, fused_input_data, buffer_data, buffer_len);
+  if (use_fusion_buffer) {
     timeline.ActivityStartAll(entries, MEMCPY_IN_FUSION_BUFFER);
-    const void* fused_input_data;
     MemcpyInFusionBuffer(entries, fused_input_data, buffer_data, buffer_len);
 
-    auto cuda_result = cudaStreamSynchronize(cuda_context_->streams[global_state_->current_nccl_stream][entries[0].device]);
-    cuda_context_->ErrorCheck("cudaStreamSynchronize", cuda_result);
+    // Staged copies are ordered after packing on the GPU instead.
+    if (!staged) {
+      auto cuda_result = cudaStreamSynchronize(cuda_context_->streams[global_state_->current_nccl_stream][entries[0].device]);
+      cuda_context_->ErrorCheck("cudaStreamSynchronize", cuda_result);
+    }
 
     timeline.ActivityEndAll(entries);
-  } else {
-    buffer_data = (void*) first_entry.output->data();
-    buffer_len = (size_t) first_entry.output->size();
+  } else if (first_entry.prescale_factor != 1.0) {
+    PrescaleDirectBuffers(entries, fused_input_data, buffer_data, num_elements);
+
+    if (!staged) {
+      auto cuda_result = cudaStreamSynchronize(cuda_context_->streams[global_state_->current_nccl_stream][entries[0].device]);
+      cuda_context_->ErrorCheck("cudaStreamSynchronize", cuda_result);
+    }
   }
 
   // Do allreduce.
   timeline.ActivityStartAll(entries, MPI_ALLREDUCE);
-  const void* sendbuf = entries.size() > 1 || first_entry.tensor->data() == first_entry.output->data()
-                        ? MPI_IN_PLACE : first_entry.tensor->data();
-  int op = MPI_Allreduce(sendbuf, buffer_data,
-                         (int) num_elements,
-                         mpi_context_->GetMPIDataType(first_entry.tensor),
-                         mpi_context_->GetMPISumOp(first_entry.tensor->dtype()),
-                         mpi_context_->GetMPICommunicator(Communicator::GLOBAL));
-  if (op != MPI_SUCCESS) {
-    throw std::runtime_error("MPI_Allreduce failed, see MPI output for details.");
+  if (staged) {
+    StagedAllreduce(entries, fused_input_data, buffer_data, num_elements);
+
+    // Without a fusion buffer to unpack, the output is final once copied back.
+    if (!use_fusion_buffer) {
+      auto cuda_result = cudaStreamSynchronize(cuda_context_->streams[global_state_->current_nccl_stream][entries[0].device]);
+      cuda_context_->ErrorCheck("cudaStreamSynchronize", cuda_result);
+    }
+  } else {
+    const void* sendbuf = fused_input_data == buffer_data
+                          ? MPI_IN_PLACE : fused_input_data;
+    int op = MPILargeAllreduce(sendbuf, buffer_data, num_elements,
+                               mpi_context_->GetMPIDataType(first_entry.tensor),
+                               mpi_context_->GetMPIOp(first_entry.tensor->dtype(),
+                                                      first_entry.reduce_op),
+                               ProcessSetCommunicator(entries));
+    if (op != MPI_SUCCESS) {
+      throw std::runtime_error("MPI_Allreduce failed, see MPI output for details.");
+    }
   }
   timeline.ActivityEndAll(entries);
 
   // Copy memory out of the fusion buffer.
-  if (entries.size() > 1) {
+  if (use_fusion_buffer) {
     timeline.ActivityStartAll(entries, MEMCPY_OUT_FUSION_BUFFER);
     MemcpyOutFusionBuffer(buffer_data, entries);
 
@@ -73,10 +94,34 @@ Status MPI_CUDAAllreduce::Execute(std::vector<TensorTableEntry>& entries, const
     cuda_context_->ErrorCheck("cudaStreamSynchronize", cuda_result);
 
     timeline.ActivityEndAll(entries);
+  } else if (first_entry.postscale_factor != 1.0) {
+    PostscaleDirectBuffers(entries, buffer_data, num_elements);
+
+    auto cuda_result = cudaStreamSynchronize(cuda_context_->streams[global_state_->current_nccl_stream][entries[0].device]);
+    cuda_context_->ErrorCheck("cudaStreamSynchronize", cuda_result);
   }
 
   return Status::OK();
 }
 
+void MPI_CUDAAllreduce::AllreduceHostChunk(
+    const std::vector<TensorTableEntry>& entries, void* host_data,
+    int64_t num_elements) {
+  auto dtype = entries[0].tensor->dtype();
+  int op = MPI_Allreduce(MPI_IN_PLACE, host_data, (int) num_elements,
+                         mpi_context_->GetMPIDataType(dtype),
+                         mpi_context_->GetMPIOp(dtype, entries[0].reduce_op),
+                         ProcessSetCommunicator(entries));
+  if (op != MPI_SUCCESS) {
+    throw std::runtime_error("MPI_Allreduce failed, see MPI output for details.");
+  }
+}
+
+MPI_Comm MPI_CUDAAllreduce::ProcessSetCommunicator(
+    const std::vector<TensorTableEntry>& entries) {
+  auto process_set = global_state_->process_sets.Get(entries[0].process_set_id);
+  return mpi_context_->GetProcessSetCommunicator(process_set.get());
+}
+
 } // namespace common
 } // namespace horovod
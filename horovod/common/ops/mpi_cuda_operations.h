@@ -26,11 +26,16 @@ namespace common {
 class MPI_CUDAAllreduce : public CUDAAllreduce {
 public:
   MPI_CUDAAllreduce(MPIContext* mpi_context, CUDAContext* cuda_context, HorovodGlobalState* global_state);
-  virtual ~MPI_CUDAAllreduce()=default;
 
   Status Execute(std::vector<TensorTableEntry>& entries, const Response& response) override;
 
 protected:
+  void AllreduceHostChunk(const std::vector<TensorTableEntry>& entries,
+                          void* host_data, int64_t num_elements) override;
+
+  // Communicator of the process set of the entries.
+  MPI_Comm ProcessSetCommunicator(const std::vector<TensorTableEntry>& entries);
+
   MPIContext* mpi_context_;
 };
 
@@ -16,53 +16,369 @@
 
 #include "mpi_operations.h"
 
+#include <algorithm>
+#include <climits>
+
+#include "../utils/huge_pages.h"
+
 namespace horovod {
 namespace common {
 
+namespace {
+
+void CheckMPI(int op, const char* name) {
+  if (op != MPI_SUCCESS) {
+    throw std::runtime_error(std::string(name) +
+                             " failed, see MPI output for details.");
+  }
+}
+
+// Number of ranks left over beyond the largest power of two not above size.
+int RanksBeyondPowerOfTwo(int size, int& pof2) {
+  pof2 = 1;
+  while (pof2 * 2 <= size) {
+    pof2 *= 2;
+  }
+  return size - pof2;
+}
+
+// Folds the first 2 * rem ranks in pairs, even ones handing their buffer to
+// the next odd one, which reduces it into its own. Returns the rank among
+// the remaining power of two, or -1 if the rank handed its buffer off and
+// waits for UnfoldRanks.
+int FoldRanks(MPI_Comm comm, int rank, int rem, void* buffer_data,
+              void* recv_data, int num_elements, MPI_Datatype datatype,
+              MPI_Op mpi_op) {
+  if (rank >= 2 * rem) {
+    return rank - rem;
+  }
+  if (rank % 2 == 0) {
+    CheckMPI(MPI_Send(buffer_data, num_elements, datatype, rank + 1, 0, comm),
+             "MPI_Send");
+    return -1;
+  }
+  CheckMPI(MPI_Recv(recv_data, num_elements, datatype, rank - 1, 0, comm,
+                    MPI_STATUS_IGNORE),
+           "MPI_Recv");
+  CheckMPI(MPI_Reduce_local(recv_data, buffer_data, num_elements, datatype,
+                            mpi_op),
+           "MPI_Reduce_local");
+  return rank / 2;
+}
+
+// Rank in the communicator of a rank among the power of two left by
+// FoldRanks.
+int FoldedPeer(int new_peer, int rem) {
+  return new_peer < rem ? new_peer * 2 + 1 : new_peer + rem;
+}
+
+// Hands the result back to the ranks FoldRanks folded.
+void UnfoldRanks(MPI_Comm comm, int rank, int rem, void* buffer_data,
+                 int num_elements, MPI_Datatype datatype) {
+  if (rank >= 2 * rem) {
+    return;
+  }
+  if (rank % 2 == 1) {
+    CheckMPI(MPI_Send(buffer_data, num_elements, datatype, rank - 1, 0, comm),
+             "MPI_Send");
+  } else {
+    CheckMPI(MPI_Recv(buffer_data, num_elements, datatype, rank + 1, 0, comm,
+                      MPI_STATUS_IGNORE),
+             "MPI_Recv");
+  }
+}
+
+} // namespace
+
 MPIAllreduce::MPIAllreduce(MPIContext* mpi_context, HorovodGlobalState* global_state)
     : AllreduceOp(global_state), mpi_context_(mpi_context) {}
 
 Status MPIAllreduce::Execute(std::vector<TensorTableEntry>& entries, const Response& response) {
   auto& first_entry = entries[0];
+  bool async = mpi_context_->async_collectives;
+  if (async) {
+    // Complete the collectives that finished while this response was
+    // negotiated.
+    mpi_context_->Progress(false);
+  }
 
+  const void* fused_input_data;
   void* buffer_data;
   size_t buffer_len;
   int64_t num_elements = NumElements(entries);
 
-  // Copy memory into the fusion buffer.
+  // Copy memory into the fusion buffer, compressing it if requested, unless
+  // the entries can be reduced directly.
   auto& timeline = global_state_->timeline;
-  if (entries.size() > 1) {
+  DataType dtype = WireDataType(entries);
+  bool compress = dtype != first_entry.tensor->dtype();
+  bool use_fusion_buffer =
+      compress || UsePersistentAllreduce(entries) ||
+      !GetDirectBuffers(entries, fused_input_data, buffer_data, buffer_len);
+  std::shared_ptr<PersistentBuffer> fusion_buffer;
+  if (use_fusion_buffer && async) {
+    fusion_buffer = CurrentFusionBuffer(first_entry);
+    mpi_context_->WaitForBuffer(fusion_buffer);
+  }
+  if (compress) {
+    timeline.ActivityStartAll(entries, MEMCPY_IN_FUSION_BUFFER);
+    CompressInFusionBuffer(entries, dtype, buffer_data, buffer_len);
+    fused_input_data = buffer_data;
+    timeline.ActivityEndAll(entries);
+  } else if (use_fusion_buffer) {
     timeline.ActivityStartAll(entries, MEMCPY_IN_FUSION_BUFFER);
-    const void* fused_input_data;
     MemcpyInFusionBuffer(entries, fused_input_data, buffer_data, buffer_len);
     timeline.ActivityEndAll(entries);
   } else {
-    buffer_data = (void*) first_entry.output->data();
-    buffer_len = (size_t) first_entry.output->size();
+    PrescaleDirectBuffers(entries, fused_input_data, buffer_data, num_elements);
+  }
+
+  // Copy memory out of the fusion buffer.
+  auto copy_out = [this, buffer_data, dtype, compress, use_fusion_buffer,
+                   num_elements](std::vector<TensorTableEntry>& entries) {
+    auto& timeline = global_state_->timeline;
+    if (compress) {
+      timeline.ActivityStartAll(entries, MEMCPY_OUT_FUSION_BUFFER);
+      DecompressOutFusionBuffer(buffer_data, dtype, entries);
+      timeline.ActivityEndAll(entries);
+    } else if (use_fusion_buffer) {
+      timeline.ActivityStartAll(entries, MEMCPY_OUT_FUSION_BUFFER);
+      MemcpyOutFusionBuffer(buffer_data, entries);
+      timeline.ActivityEndAll(entries);
+    } else {
+      PostscaleDirectBuffers(entries, buffer_data, num_elements);
+    }
+  };
+
+  // Start the allreduce without waiting for it if possible, the entries are
+  // then completed once it is done.
+  MPI_Request request;
+  if (async && StartAllreduce(entries, fused_input_data, buffer_data,
+                              num_elements, dtype, buffer_len, request)) {
+    auto on_complete = [copy_out, entries]() mutable { copy_out(entries); };
+    mpi_context_->Enqueue(request, entries, fusion_buffer, on_complete,
+                          "MPI_Allreduce failed, see MPI output for details.",
+                          timeline);
+    return Status::InProgress();
   }
 
   // Do allreduce.
+  DoAllreduce(entries, fused_input_data, buffer_data, num_elements, dtype,
+              buffer_len);
+  copy_out(entries);
+
+  return Status::OK();
+}
+
+void MPIAllreduce::DoAllreduce(std::vector<TensorTableEntry>& entries,
+                               const void* fused_input_data, void* buffer_data,
+                               int64_t num_elements, DataType dtype,
+                               size_t buffer_len) {
+  // Small buffers are latency bound, and are reduced in fewer steps than the
+  // ring or tree the MPI library may pick for them.
+  auto& timeline = global_state_->timeline;
   timeline.ActivityStartAll(entries, MPI_ALLREDUCE);
-  const void* sendbuf = entries.size() > 1 || first_entry.tensor->data() == first_entry.output->data()
-                        ? MPI_IN_PLACE : first_entry.tensor->data();
-  int op = MPI_Allreduce(sendbuf, buffer_data,
-                         (int) num_elements,
-                         mpi_context_->GetMPIDataType(first_entry.tensor),
-                         mpi_context_->GetMPISumOp(first_entry.tensor->dtype()),
-                         mpi_context_->GetMPICommunicator(Communicator::GLOBAL));
-  if (op != MPI_SUCCESS) {
-    throw std::runtime_error("MPI_Allreduce failed, see MPI output for details.");
+  auto comm = ProcessSetCommunicator(entries);
+  if (UseLatencyOptimizedAllreduce(buffer_len)) {
+    if (fused_input_data != buffer_data) {
+      std::memcpy(buffer_data, fused_input_data, buffer_len);
+    }
+    RecursiveDoublingAllreduce(comm, buffer_data, (int) num_elements, dtype,
+                               entries[0].reduce_op, buffer_len);
+  } else if (UseFixedTreeAllreduce(entries)) {
+    // Both trees give the same bits for each element, so neither the
+    // threshold nor where the element sits in the buffer changes the result.
+    if (fused_input_data != buffer_data) {
+      std::memcpy(buffer_data, fused_input_data, buffer_len);
+    }
+    int64_t element_size =
+        (int64_t)buffer_len / std::max<int64_t>(num_elements, 1);
+    for (int64_t offset = 0; offset < num_elements; offset += INT_MAX) {
+      auto count = (int)std::min<int64_t>(num_elements - offset, INT_MAX);
+      FixedTreeAllreduce(comm, (uint8_t*)buffer_data + offset * element_size,
+                         count, dtype, entries[0].reduce_op,
+                         (size_t)count * element_size);
+    }
+  } else if (UsePersistentAllreduce(entries)) {
+    int op = mpi_context_->PersistentAllreduce(
+        buffer_data, num_elements, mpi_context_->GetMPIDataType(dtype),
+        mpi_context_->GetMPIOp(dtype, entries[0].reduce_op), comm,
+        global_state_->fusion_buffer.Generation(entries[0].device));
+    if (op != MPI_SUCCESS) {
+      throw std::runtime_error("MPI_Allreduce failed, see MPI output for details.");
+    }
+  } else {
+    const void* sendbuf = fused_input_data == buffer_data
+                          ? MPI_IN_PLACE : fused_input_data;
+    int op = MPILargeAllreduce(sendbuf, buffer_data, num_elements,
+                               mpi_context_->GetMPIDataType(dtype),
+                               mpi_context_->GetMPIOp(dtype, entries[0].reduce_op),
+                               comm);
+    if (op != MPI_SUCCESS) {
+      throw std::runtime_error("MPI_Allreduce failed, see MPI output for details.");
+    }
   }
   timeline.ActivityEndAll(entries);
+}
 
-  // Copy memory out of the fusion buffer.
-  if (entries.size() > 1) {
-    timeline.ActivityStartAll(entries, MEMCPY_OUT_FUSION_BUFFER);
-    MemcpyOutFusionBuffer(buffer_data, entries);
-    timeline.ActivityEndAll(entries);
+bool MPIAllreduce::StartAllreduce(std::vector<TensorTableEntry>& entries,
+                                  const void* fused_input_data,
+                                  void* buffer_data, int64_t num_elements,
+                                  DataType dtype, size_t buffer_len,
+                                  MPI_Request& request) {
+  if (UseLatencyOptimizedAllreduce(buffer_len) ||
+      UseFixedTreeAllreduce(entries) || num_elements > INT_MAX) {
+    return false;
   }
 
-  return Status::OK();
+  global_state_->timeline.ActivityStartAll(entries, MPI_ALLREDUCE);
+  auto datatype = mpi_context_->GetMPIDataType(dtype);
+  auto op = mpi_context_->GetMPIOp(dtype, entries[0].reduce_op);
+  auto comm = ProcessSetCommunicator(entries);
+  int result;
+  if (UsePersistentAllreduce(entries)) {
+    result = mpi_context_->StartPersistentAllreduce(
+        buffer_data, (int)num_elements, datatype, op, comm,
+        global_state_->fusion_buffer.Generation(entries[0].device), request);
+  } else {
+    const void* sendbuf = fused_input_data == buffer_data
+                          ? MPI_IN_PLACE : fused_input_data;
+    result = MPI_Iallreduce(sendbuf, buffer_data, (int)num_elements, datatype,
+                            op, comm, &request);
+  }
+  if (result != MPI_SUCCESS) {
+    throw std::runtime_error("MPI_Iallreduce failed, see MPI output for details.");
+  }
+  return true;
+}
+
+MPI_Comm MPIAllreduce::ProcessSetCommunicator(
+    const std::vector<TensorTableEntry>& entries) {
+  auto process_set = global_state_->process_sets.Get(entries[0].process_set_id);
+  return mpi_context_->GetProcessSetCommunicator(process_set.get());
+}
+
+bool MPIAllreduce::UsePersistentAllreduce(
+    const std::vector<TensorTableEntry>& entries) const {
+  // Single entries are reduced directly in framework memory, so only fused
+  // responses use the persistent requests on the fusion buffer.
+  return mpi_context_->persistent_collectives && entries.size() > 1 &&
+         !UseFixedTreeAllreduce(entries);
+}
+
+bool MPIAllreduce::UseFixedTreeAllreduce(
+    const std::vector<TensorTableEntry>& entries) const {
+  return global_state_->deterministic_allreduce &&
+         entries[0].device == CPU_DEVICE_ID;
+}
+
+void MPIAllreduce::RecursiveDoublingAllreduce(MPI_Comm comm, void* buffer_data,
+                                              int num_elements, DataType dtype,
+                                              ReduceOp reduce_op,
+                                              size_t buffer_len) {
+  auto datatype = mpi_context_->GetMPIDataType(dtype);
+  auto mpi_op = mpi_context_->GetMPIOp(dtype, reduce_op);
+  int rank;
+  int size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+  recv_buffer_.resize(buffer_len);
+  void* recv_data = recv_buffer_.data();
+
+  int pof2;
+  int rem = RanksBeyondPowerOfTwo(size, pof2);
+  int new_rank = FoldRanks(comm, rank, rem, buffer_data, recv_data,
+                           num_elements, datatype, mpi_op);
+
+  // The reductions are commutative, so both partners of an exchange end up
+  // with the same bits.
+  if (new_rank != -1) {
+    for (int mask = 1; mask < pof2; mask <<= 1) {
+      int peer = FoldedPeer(new_rank ^ mask, rem);
+      CheckMPI(MPI_Sendrecv(buffer_data, num_elements, datatype, peer, 0,
+                            recv_data, num_elements, datatype, peer, 0, comm,
+                            MPI_STATUS_IGNORE),
+               "MPI_Sendrecv");
+      CheckMPI(MPI_Reduce_local(recv_data, buffer_data, num_elements,
+                                datatype, mpi_op),
+               "MPI_Reduce_local");
+    }
+  }
+
+  UnfoldRanks(comm, rank, rem, buffer_data, num_elements, datatype);
+}
+
+void MPIAllreduce::FixedTreeAllreduce(MPI_Comm comm, void* buffer_data,
+                                      int num_elements, DataType dtype,
+                                      ReduceOp reduce_op, size_t buffer_len) {
+  auto datatype = mpi_context_->GetMPIDataType(dtype);
+  auto mpi_op = mpi_context_->GetMPIOp(dtype, reduce_op);
+  int rank;
+  int size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+  size_t element_size = buffer_len / std::max(num_elements, 1);
+  auto data = (uint8_t*)buffer_data;
+  recv_buffer_.resize(buffer_len);
+  void* recv_data = recv_buffer_.data();
+
+  // Fold the first 2 * rem ranks in pairs as RecursiveDoublingAllreduce does.
+  int pof2;
+  int rem = RanksBeyondPowerOfTwo(size, pof2);
+  int new_rank = FoldRanks(comm, rank, rem, buffer_data, recv_data,
+                           num_elements, datatype, mpi_op);
+
+  if (new_rank != -1) {
+    // Exchanging with the partners in the same order as recursive doubling
+    // sums each element over the same tree, only the half being reduced
+    // shrinks at every step: the rank keeps the lower half if its bit is 0.
+    std::vector<int> begins;
+    std::vector<int> ends;
+    std::vector<bool> kept_lower;
+    int begin = 0;
+    int end = num_elements;
+    for (int mask = 1; mask < pof2; mask <<= 1) {
+      int peer = FoldedPeer(new_rank ^ mask, rem);
+      int mid = begin + (end - begin) / 2;
+      bool keep_lower = (new_rank & mask) == 0;
+      int keep_begin = keep_lower ? begin : mid;
+      int keep_end = keep_lower ? mid : end;
+      int send_begin = keep_lower ? mid : begin;
+      int send_end = keep_lower ? end : mid;
+      CheckMPI(MPI_Sendrecv(data + send_begin * element_size,
+                            send_end - send_begin, datatype, peer, 0,
+                            recv_data, keep_end - keep_begin, datatype, peer,
+                            0, comm, MPI_STATUS_IGNORE),
+               "MPI_Sendrecv");
+      CheckMPI(MPI_Reduce_local(recv_data, data + keep_begin * element_size,
+                                keep_end - keep_begin, datatype, mpi_op),
+               "MPI_Reduce_local");
+      begins.push_back(begin);
+      ends.push_back(end);
+      kept_lower.push_back(keep_lower);
+      begin = keep_begin;
+      end = keep_end;
+    }
+
+    // Gather the reduced parts back in reverse order, each exchange doubling
+    // the part of the buffer that is complete.
+    for (int mask = pof2 >> 1, step = (int)begins.size() - 1; mask > 0;
+         mask >>= 1, --step) {
+      int peer = FoldedPeer(new_rank ^ mask, rem);
+      int peer_begin = kept_lower[step] ? end : begins[step];
+      int peer_end = kept_lower[step] ? ends[step] : begin;
+      CheckMPI(MPI_Sendrecv(data + begin * element_size, end - begin,
+                            datatype, peer, 0,
+                            data + peer_begin * element_size,
+                            peer_end - peer_begin, datatype, peer, 0, comm,
+                            MPI_STATUS_IGNORE),
+               "MPI_Sendrecv");
+      begin = begins[step];
+      end = ends[step];
+    }
+  }
+
+  UnfoldRanks(comm, rank, rem, buffer_data, num_elements, datatype);
 }
 
 bool MPIAllreduce::Enabled(const ParameterManager& param_manager,
@@ -71,6 +387,175 @@ bool MPIAllreduce::Enabled(const ParameterManager& param_manager,
   return true;
 }
 
+MPIHierarchicalAllreduce::MPIHierarchicalAllreduce(
+    MPIContext* mpi_context, HorovodGlobalState* global_state)
+    : MPIAllreduce(mpi_context, global_state) {}
+
+void MPIHierarchicalAllreduce::DoAllreduce(
+    std::vector<TensorTableEntry>& entries, const void* fused_input_data,
+    void* buffer_data, int64_t num_elements, DataType dtype,
+    size_t buffer_len) {
+  auto& timeline = global_state_->timeline;
+  auto datatype = mpi_context_->GetMPIDataType(dtype);
+  auto reduce_op = entries[0].reduce_op;
+  auto mpi_op = mpi_context_->GetMPIOp(dtype, reduce_op);
+  auto local_comm = mpi_context_->GetMPICommunicator(Communicator::LOCAL);
+  auto cross_comm = mpi_context_->GetMPICommunicator(Communicator::CROSS);
+  int local_rank = global_state_->controller->GetLocalRank();
+  int local_size = global_state_->controller->GetLocalSize();
+
+  auto check = [](int op, const char* name) {
+    if (op != MPI_SUCCESS) {
+      throw std::runtime_error(std::string(name) +
+                               " failed, see MPI output for details.");
+    }
+  };
+
+  if (fused_input_data != buffer_data) {
+    std::memcpy(buffer_data, fused_input_data, buffer_len);
+  }
+
+  // The node's data is only summed in shared memory.
+  auto& shared_memory = global_state_->shared_memory;
+  // Only the local ranks that every node has are paired across all nodes, so
+  // with nodes of different sizes the others own no block.
+  int num_blocks = global_state_->controller->GetMinLocalSize();
+  if (shared_memory.IsEnabled() && reduce_op == ReduceOp::SUM) {
+    // Each local rank allreduces the block it reduced in shared memory with
+    // the same local rank of the other nodes.
+    timeline.ActivityStartAll(entries, SHARED_MEMORY_ALLREDUCE);
+    shared_memory.Allreduce(
+        buffer_data, num_elements, dtype,
+        [&](void* block, int64_t count) {
+          check(MPILargeAllreduce(MPI_IN_PLACE, block, count, datatype,
+                                  mpi_op, cross_comm),
+                "MPI_Allreduce");
+        },
+        num_blocks);
+    timeline.ActivityEndAll(entries);
+    return;
+  }
+
+  // Blocks are reduce-scattered with int counts, so larger buffers take the
+  // path through local rank 0.
+  if (num_blocks == 1 || num_elements / num_blocks + 1 > INT_MAX) {
+    // Local rank 0 reduces the node's data, allreduces it with the other
+    // nodes and broadcasts it back.
+    timeline.ActivityStartAll(entries, MPI_REDUCE);
+    check(MPILargeReduce(local_rank == 0 ? MPI_IN_PLACE : buffer_data,
+                         buffer_data, num_elements, datatype, mpi_op, 0,
+                         local_comm),
+          "MPI_Reduce");
+    timeline.ActivityEndAll(entries);
+
+    if (local_rank == 0) {
+      timeline.ActivityStartAll(entries, MPI_ALLREDUCE);
+      check(MPILargeAllreduce(MPI_IN_PLACE, buffer_data, num_elements,
+                              datatype, mpi_op, cross_comm),
+            "MPI_Allreduce");
+      timeline.ActivityEndAll(entries);
+    }
+
+    timeline.ActivityStartAll(entries, MPI_BCAST);
+    check(MPILargeBcast(buffer_data, num_elements, datatype, 0, local_comm),
+          "MPI_Bcast");
+    timeline.ActivityEndAll(entries);
+    return;
+  }
+
+  // Like NCCLHierarchicalAllreduce, each local rank reduces a block of the
+  // node's data, allreduces it with the same local rank of the other nodes,
+  // so that all of them use the network, and the blocks are gathered back.
+  std::vector<int> counts(local_size, 0);
+  std::vector<int> displcmnts(local_size, 0);
+  int64_t offset = 0;
+  for (int i = 0; i < local_size; ++i) {
+    if (i < num_blocks) {
+      counts[i] = (int)(num_elements / num_blocks +
+                        (i < num_elements % num_blocks ? 1 : 0));
+    }
+    displcmnts[i] = (int)offset;
+    offset += counts[i];
+  }
+  int element_size = mpi_context_->GetMPITypeSize(dtype);
+  block_buffer_.resize((size_t)counts[local_rank] * element_size);
+
+  timeline.ActivityStartAll(entries, MPI_REDUCESCATTER);
+  check(MPI_Reduce_scatter(buffer_data, block_buffer_.data(), counts.data(),
+                           datatype, mpi_op, local_comm),
+        "MPI_Reduce_scatter");
+  timeline.ActivityEndAll(entries);
+
+  if (local_rank < num_blocks) {
+    timeline.ActivityStartAll(entries, MPI_ALLREDUCE);
+    check(MPI_Allreduce(MPI_IN_PLACE, block_buffer_.data(), counts[local_rank],
+                        datatype, mpi_op, cross_comm),
+          "MPI_Allreduce");
+    timeline.ActivityEndAll(entries);
+  }
+
+  timeline.ActivityStartAll(entries, MPI_ALLGATHER);
+  check(MPI_Allgatherv(block_buffer_.data(), counts[local_rank], datatype,
+                       buffer_data, counts.data(), displcmnts.data(), datatype,
+                       local_comm),
+        "MPI_Allgatherv");
+  timeline.ActivityEndAll(entries);
+}
+
+bool MPIHierarchicalAllreduce::StartAllreduce(
+    std::vector<TensorTableEntry>& entries, const void* fused_input_data,
+    void* buffer_data, int64_t num_elements, DataType dtype, size_t buffer_len,
+    MPI_Request& request) {
+  return false;
+}
+
+bool MPIHierarchicalAllreduce::Enabled(
+    const ParameterManager& param_manager,
+    const std::vector<TensorTableEntry>& entries,
+    const Response& response) const {
+  // Which local rank reduces an element depends on the buffer layout, so
+  // the flat allreduce is used in deterministic mode.
+  return entries[0].device == CPU_DEVICE_ID &&
+         param_manager.HierarchicalAllreduce() &&
+         !global_state_->deterministic_allreduce;
+}
+
+MPISparseAllreduce::MPISparseAllreduce(MPIContext* mpi_context,
+                                       HorovodGlobalState* global_state)
+    : SparseAllreduce(global_state), mpi_context_(mpi_context) {}
+
+void MPISparseAllreduce::Allgather(const SparseElement* sendbuf,
+                                   SparseElement* recvbuf, int count) {
+  int bytes = count * (int)sizeof(SparseElement);
+  int op = MPI_Allgather(sendbuf, bytes, MPI_BYTE, recvbuf, bytes, MPI_BYTE,
+                         mpi_context_->GetMPICommunicator(Communicator::GLOBAL));
+  if (op != MPI_SUCCESS) {
+    throw std::runtime_error("MPI_Allgather failed, see MPI output for details.");
+  }
+}
+
+MPIQuantizedAllreduce::MPIQuantizedAllreduce(MPIContext* mpi_context,
+                                             HorovodGlobalState* global_state)
+    : QuantizedAllreduce(global_state), mpi_context_(mpi_context) {}
+
+void MPIQuantizedAllreduce::Alltoall(const uint8_t* sendbuf, uint8_t* recvbuf,
+                                     int bytes) {
+  int op = MPI_Alltoall(sendbuf, bytes, MPI_BYTE, recvbuf, bytes, MPI_BYTE,
+                        mpi_context_->GetMPICommunicator(Communicator::GLOBAL));
+  if (op != MPI_SUCCESS) {
+    throw std::runtime_error("MPI_Alltoall failed, see MPI output for details.");
+  }
+}
+
+void MPIQuantizedAllreduce::Allgather(const uint8_t* sendbuf, uint8_t* recvbuf,
+                                      int bytes) {
+  int op = MPI_Allgather(sendbuf, bytes, MPI_BYTE, recvbuf, bytes, MPI_BYTE,
+                         mpi_context_->GetMPICommunicator(Communicator::GLOBAL));
+  if (op != MPI_SUCCESS) {
+    throw std::runtime_error("MPI_Allgather failed, see MPI output for details.");
+  }
+}
+
 MPIAllgather::MPIAllgather(MPIContext* mpi_context, HorovodGlobalState* global_state)
     : AllgatherOp(global_state), mpi_context_(mpi_context) {}
 
@@ -83,21 +568,14 @@ bool MPIAllgather::Enabled(const ParameterManager& param_manager,
 Status MPIAllgather::Execute(std::vector<TensorTableEntry>& entries, const Response& response) {
   auto& timeline = global_state_->timeline;
 
-  // Sizes of subcomponents of each entry from all ranks
-  auto** entry_component_sizes = new int64_t* [entries.size()];
-
-  // Offset of each subcomponent of every entry in the final buffer after
-  // allgatherv
-  auto** entry_component_offsets = new int64_t* [entries.size()];
-
-  int global_size = global_state_->controller->GetSize();
-  auto* recvcounts = new int[global_size]();
-  auto* displcmnts = new int[global_size]();
-
-  for (size_t ec = 0; ec < entries.size(); ++ec) {
-    entry_component_sizes[ec] = new int64_t[global_size]();
-    entry_component_offsets[ec] = new int64_t[global_size]();
-  }
+  // Sizes of subcomponents of each entry from all ranks, and their offsets
+  // in the final buffer after allgatherv.
+  int64_t** entry_component_sizes;
+  int64_t** entry_component_offsets;
+  int64_t* recvcounts;
+  int64_t* displcmnts;
+  GetScratchArrays(entries.size(), entry_component_sizes,
+                   entry_component_offsets, recvcounts, displcmnts);
 
   auto& first_entry = entries[0];
 
@@ -112,12 +590,28 @@ Status MPIAllgather::Execute(std::vector<TensorTableEntry>& entries, const Respo
   SetEntryComponentOffsets(entries, entry_component_sizes, recvcounts, entry_component_offsets);
 
   int element_size = mpi_context_->GetMPITypeSize(first_entry.tensor->dtype());
+  int global_size = global_state_->controller->GetSize();
+  int64_t total_num_elements = NumElements(entries);
+
+  // Start the allgather without waiting for it if all counts fit the regular
+  // call, the same on all ranks.
+  bool async = mpi_context_->async_collectives &&
+               total_num_elements <= INT_MAX &&
+               displcmnts[global_size - 1] + recvcounts[global_size - 1] <=
+                   INT_MAX;
+  if (mpi_context_->async_collectives) {
+    mpi_context_->Progress(false);
+  }
 
   const void* sendbuf = nullptr;
   void* buffer_data;
-  int64_t total_num_elements = NumElements(entries);
+  std::shared_ptr<PersistentBuffer> fusion_buffer;
 
   if (entries.size() > 1) {
+    if (async) {
+      fusion_buffer = CurrentFusionBuffer(first_entry);
+      mpi_context_->WaitForBuffer(fusion_buffer);
+    }
     timeline.ActivityStartAll(entries, MEMCPY_IN_FUSION_BUFFER);
     MemcpyInFusionBuffer(entries, displcmnts, element_size, buffer_data);
     timeline.ActivityEndAll(entries);
@@ -128,14 +622,66 @@ Status MPIAllgather::Execute(std::vector<TensorTableEntry>& entries, const Respo
 
   global_state_->timeline.ActivityStartAll(entries, MPI_ALLGATHER);
   auto dtype = mpi_context_->GetMPIDataType(first_entry.tensor->dtype());
-  int op = MPI_Allgatherv(sendbuf != nullptr ? sendbuf : MPI_IN_PLACE,
-                          (int) total_num_elements,
-                          dtype,
-                          buffer_data,
-                          recvcounts,
-                          displcmnts,
-                          dtype,
-                          mpi_context_->GetMPICommunicator(Communicator::GLOBAL));
+  auto comm = mpi_context_->GetMPICommunicator(Communicator::GLOBAL);
+  if (async) {
+    // The counts and the offsets of the entries in the gathered buffer are
+    // used until the allgather completes, so they are owned by it rather
+    // than kept in the scratch arrays reused by the next allgather.
+    auto counts = std::make_shared<std::vector<int>>(recvcounts,
+                                                     recvcounts + global_size);
+    auto displs = std::make_shared<std::vector<int>>(displcmnts,
+                                                     displcmnts + global_size);
+    std::vector<int64_t> component_offsets;
+    std::vector<int64_t> component_sizes;
+    if (entries.size() > 1) {
+      for (size_t ec = 0; ec < entries.size(); ++ec) {
+        component_offsets.insert(component_offsets.end(),
+                                 entry_component_offsets[ec],
+                                 entry_component_offsets[ec] + global_size);
+        component_sizes.insert(component_sizes.end(), entry_component_sizes[ec],
+                               entry_component_sizes[ec] + global_size);
+      }
+    }
+
+    MPI_Request request;
+    int op = MPI_Iallgatherv(sendbuf != nullptr ? sendbuf : MPI_IN_PLACE,
+                             (int)total_num_elements, dtype, buffer_data,
+                             counts->data(), displs->data(), dtype, comm,
+                             &request);
+    if (op != MPI_SUCCESS) {
+      throw std::runtime_error("MPI_Iallgatherv failed, see MPI output for details.");
+    }
+
+    auto on_complete = [this, entries, buffer_data, element_size, global_size,
+                        counts, displs, component_offsets,
+                        component_sizes]() mutable {
+      if (entries.size() > 1) {
+        std::vector<const int64_t*> offset_rows;
+        std::vector<const int64_t*> size_rows;
+        for (size_t ec = 0; ec < entries.size(); ++ec) {
+          offset_rows.push_back(component_offsets.data() + ec * global_size);
+          size_rows.push_back(component_sizes.data() + ec * global_size);
+        }
+        auto& timeline = global_state_->timeline;
+        timeline.ActivityStartAll(entries, MEMCPY_OUT_FUSION_BUFFER);
+        MemcpyOutFusionBuffer(offset_rows.data(), size_rows.data(),
+                              buffer_data, element_size, entries);
+        timeline.ActivityEndAll(entries);
+      }
+    };
+    mpi_context_->Enqueue(request, entries, fusion_buffer, on_complete,
+                          "MPI_Allgatherv failed, see MPI output for details.",
+                          timeline);
+    return Status::InProgress();
+  }
+
+  int op = MPILargeAllgatherv(sendbuf != nullptr ? sendbuf : MPI_IN_PLACE,
+                              total_num_elements,
+                              dtype,
+                              buffer_data,
+                              recvcounts,
+                              displcmnts,
+                              comm);
   if (op != MPI_SUCCESS) {
     throw std::runtime_error("MPI_Allgatherv failed, see MPI output for details.");
   }
@@ -148,16 +694,6 @@ Status MPIAllgather::Execute(std::vector<TensorTableEntry>& entries, const Respo
     timeline.ActivityEndAll(entries);
   }
 
-  delete[] recvcounts;
-  delete[] displcmnts;
-
-  for (size_t ec = 0; ec < entries.size(); ++ec) {
-    delete[] entry_component_sizes[ec];
-    delete[] entry_component_offsets[ec];
-  }
-  delete[] entry_component_sizes;
-  delete[] entry_component_offsets;
-
   return Status::OK();
 }
 
@@ -168,21 +704,14 @@ MPIHierarchicalAllgather::MPIHierarchicalAllgather(MPIContext* mpi_context,
 Status MPIHierarchicalAllgather::Execute(std::vector<TensorTableEntry>& entries, const Response& response) {
   auto& timeline = global_state_->timeline;
 
-  // Sizes of subcomponents of each entry from all ranks
-  auto** entry_component_sizes = new int64_t* [entries.size()];
-
-  // Offset of each subcomponent of every entry in the final buffer after
-  // allgatherv
-  auto** entry_component_offsets = new int64_t* [entries.size()];
-
-  int global_size = global_state_->controller->GetSize();
-  auto* recvcounts = new int[global_size]();
-  auto* displcmnts = new int[global_size]();
-
-  for (size_t ec = 0; ec < entries.size(); ++ec) {
-    entry_component_sizes[ec] = new int64_t[global_size]();
-    entry_component_offsets[ec] = new int64_t[global_size]();
-  }
+  // Sizes of subcomponents of each entry from all ranks, and their offsets
+  // in the final buffer after allgatherv.
+  int64_t** entry_component_sizes;
+  int64_t** entry_component_offsets;
+  int64_t* recvcounts;
+  int64_t* displcmnts;
+  GetScratchArrays(entries.size(), entry_component_sizes,
+                   entry_component_offsets, recvcounts, displcmnts);
 
   auto& first_entry = entries[0];
 
@@ -198,12 +727,106 @@ Status MPIHierarchicalAllgather::Execute(std::vector<TensorTableEntry>& entries,
 
   int element_size = mpi_context_->GetMPITypeSize(first_entry.tensor->dtype());
 
+  int global_size = global_state_->controller->GetSize();
   int64_t total_size = displcmnts[global_size - 1] +
                        recvcounts[global_size - 1];
 
-  // If shared buffer is not initialized or is not large enough, reallocate
+  // Compute the cross-node allgather displacements and recvcounts of the
+  // blocks this rank gathers from all nodes.
+  auto& controller = *global_state_->controller;
+  int local_rank = controller.GetLocalRank();
+  int cross_size = controller.GetCrossSize();
+  cross_recvcounts_.assign(cross_size, 0);
+  cross_displcmnts_.assign(cross_size, 0);
+  int64_t* cross_recvcounts = cross_recvcounts_.data();
+  int64_t* cross_displcmnts = cross_displcmnts_.data();
+
+  int num_leaders;
+  if (controller.IsHomogeneous()) {
+    // Each local rank gathers the data of the same local rank of all nodes.
+    // The cross-node communicator may be ordered by rack rather than by
+    // global rank.
+    num_leaders = controller.GetLocalSize();
+    auto& cross_comm_ranks = controller.GetCrossCommRanks();
+    for (int i = 0; i < cross_size; ++i) {
+      cross_recvcounts[i] = recvcounts[cross_comm_ranks[i]];
+      cross_displcmnts[i] = displcmnts[cross_comm_ranks[i]];
+    }
+  } else {
+    // The data of each node is split in blocks between the local ranks that
+    // every node has, which gather the same block of all nodes, rather than
+    // local rank 0 sending all of it.
+    num_leaders = controller.GetMinLocalSize();
+    if (local_rank < num_leaders) {
+      int offset = 0;
+      for (int i = 0; i < cross_size; ++i) {
+        int local_size = controller.GetLocalSizeAtCrossRank(i);
+        int64_t node_count = 0;
+        for (int j = offset; j < offset + local_size; ++j) {
+          node_count += recvcounts[j];
+        }
+        int64_t extra = node_count % num_leaders;
+        cross_recvcounts[i] =
+            node_count / num_leaders + (local_rank < extra ? 1 : 0);
+        cross_displcmnts[i] = displcmnts[offset] +
+                              local_rank * (node_count / num_leaders) +
+                              std::min<int64_t>(local_rank, extra);
+        offset += local_size;
+      }
+    }
+  }
+
+  int rank = controller.GetRank();
+  auto copy_in = [&](void* shared_buffer) {
+    timeline.ActivityStartAll(entries, MEMCPY_IN_SHARED_BUFFER);
+    for (size_t ec = 0; ec < entries.size(); ++ec) {
+      auto& e = entries[ec];
+      void* shared_buffer_at_offset =
+          (uint8_t*) shared_buffer +
+          entry_component_offsets[ec][rank] * element_size;
+
+      // CPU copy to shared buffer
+      memcpy(shared_buffer_at_offset, e.tensor->data(),
+             (size_t) (entry_component_sizes[ec][rank] * element_size));
+    }
+    timeline.ActivityEndAll(entries);
+  };
+  auto cross_allgather = [&](void* shared_buffer) {
+    timeline.ActivityStartAll(entries, MPI_CROSS_ALLGATHER);
+    int op = MPILargeAllgatherv(MPI_IN_PLACE,
+                                0,
+                                mpi_context_->GetMPIDataType(first_entry.tensor->dtype()),
+                                shared_buffer,
+                                cross_recvcounts,
+                                cross_displcmnts,
+                                mpi_context_->GetMPICommunicator(Communicator::CROSS));
+    if (op != MPI_SUCCESS) {
+      throw std::runtime_error("MPI_Allgatherv failed, see MPI output for details.");
+    }
+    timeline.ActivityEndAll(entries);
+  };
+  auto copy_out = [&](const void* shared_buffer) {
+    timeline.ActivityStartAll(entries, MEMCPY_OUT_FUSION_BUFFER);
+    MemcpyOutFusionBuffer(entry_component_offsets, entry_component_sizes,
+                          shared_buffer, element_size, entries);
+    timeline.ActivityEndAll(entries);
+  };
+
+  // Use the shared memory arena of the node if it is mapped, in which the
+  // ranks synchronize through their progress counters.
   int64_t total_size_in_bytes = total_size * element_size;
+  auto& shared_memory = global_state_->shared_memory;
+  if (shared_memory.IsEnabled()) {
+    shared_memory.Allgather((size_t)total_size_in_bytes, copy_in,
+                            cross_allgather, num_leaders, copy_out);
+    return Status::OK();
+  }
+
+  // Otherwise use an MPI shared window, kept across calls. If it is not
+  // initialized or is not large enough, reallocate it with room to grow.
   if (global_state_->shared_buffer == nullptr || global_state_->shared_buffer_size < total_size_in_bytes) {
+    int64_t window_bytes =
+        std::max(total_size_in_bytes, 2 * global_state_->shared_buffer_size);
     if (global_state_->shared_buffer != nullptr) {
       MPI_Win_fence(0, mpi_context_->window);
       MPI_Win_free(&mpi_context_->window);
@@ -212,14 +835,14 @@ Status MPIHierarchicalAllgather::Execute(std::vector<TensorTableEntry>& entries,
 
     // Allocate shared memory, give each rank their respective pointer
     timeline.ActivityStartAll(entries, ALLOCATE_SHARED_BUFFER);
-    int64_t window_size = global_state_->controller->GetLocalRank() == 0 ? total_size_in_bytes : 0;
+    int64_t window_size = local_rank == 0 ? window_bytes : 0;
     MPI_Win_allocate_shared(window_size,
                             element_size,
                             MPI_INFO_NULL,
                             mpi_context_->GetMPICommunicator(Communicator::LOCAL),
                             &global_state_->shared_buffer,
                             &mpi_context_->window);
-    if (global_state_->controller->GetLocalRank() != 0) {
+    if (local_rank != 0) {
       int disp_unit;
       MPI_Aint winsize;
       MPI_Win_shared_query(mpi_context_->window,
@@ -228,81 +851,24 @@ Status MPIHierarchicalAllgather::Execute(std::vector<TensorTableEntry>& entries,
                            &disp_unit,
                            &global_state_->shared_buffer);
     }
-    global_state_->shared_buffer_size = total_size_in_bytes;
-    timeline.ActivityEndAll(entries);
-  }
-
-  // Compute cross-node allgather displacements and recvcounts for
-  // homogeneous/parallelized case
-  int cross_size = global_state_->controller->GetCrossSize();
-  int local_size = global_state_->controller->GetLocalSize();
-  int local_rank = global_state_->controller->GetLocalRank();
-  auto* cross_recvcounts = new int[cross_size]();
-  auto* cross_displcmnts = new int[cross_size]();
-
-  if (global_state_->controller->IsHomogeneous()) {
-    for (int i = 0; i < global_state_->controller->GetCrossSize(); ++i) {
-      cross_recvcounts[i] = recvcounts[local_size * i + local_rank];
-      cross_displcmnts[i] = displcmnts[local_size * i + local_rank];
-    }
-  } else if (global_state_->controller->GetLocalRank() == 0) {
-    // In this case local rank 0 will allgather with all local data
-    int offset = 0;
-    for (int i = 0; i < cross_size; ++i) {
-      for (int j = offset; j < offset + global_state_->controller->GetLocalSizeAtCrossRank(i);
-           ++j) {
-        cross_recvcounts[i] += recvcounts[j];
-      }
-      cross_displcmnts[i] = displcmnts[offset];
-      offset += global_state_->controller->GetLocalSizeAtCrossRank(i);
+    // The window lives in shared memory, which gets transparent huge pages
+    // where the system enables them for shared memory.
+    if (local_rank == 0) {
+      AdviseHugePages(global_state_->shared_buffer, (size_t)window_bytes);
     }
+    global_state_->shared_buffer_size = window_bytes;
+    timeline.ActivityEndAll(entries);
   }
+  void* shared_buffer = global_state_->shared_buffer;
 
-  timeline.ActivityStartAll(entries, MEMCPY_IN_SHARED_BUFFER);
-
-  int rank = global_state_->controller->GetRank();
-  for (size_t ec = 0; ec < entries.size(); ++ec) {
-    auto& e = entries[ec];
-    void* shared_buffer_at_offset =
-        (uint8_t*) global_state_->shared_buffer +
-        entry_component_offsets[ec][rank] * element_size;
-
-    // CPU copy to shared buffer
-    memcpy(shared_buffer_at_offset, e.tensor->data(),
-           (size_t) (entry_component_sizes[ec][rank] * element_size));
-  }
+  copy_in(shared_buffer);
   Barrier();
-  timeline.ActivityEndAll(entries);
-
-  // Perform the cross-node allgather. If the cluster is homogeneous all
-  // local ranks participate, otherwise local rank 0 handles all data
-  global_state_->timeline.ActivityStartAll(entries, MPI_CROSS_ALLGATHER);
-  if (global_state_->controller->IsHomogeneous() || global_state_->controller->GetLocalRank() == 0) {
-    int op = MPI_Allgatherv(MPI_IN_PLACE,
-                            0,
-                            MPI_DATATYPE_NULL,
-                            global_state_->shared_buffer,
-                            cross_recvcounts,
-                            cross_displcmnts,
-                            mpi_context_->GetMPIDataType(first_entry.tensor->dtype()),
-                            mpi_context_->GetMPICommunicator(Communicator::CROSS));
-    if (op != MPI_SUCCESS) {
-      throw std::runtime_error("MPI_Allgatherv failed, see MPI output for details.");
-    }
+  if (local_rank < num_leaders) {
+    cross_allgather(shared_buffer);
   }
   Barrier();
-  global_state_->timeline.ActivityEndAll(entries);
-
-  // Copy memory out of the fusion buffer.
-  timeline.ActivityStartAll(entries, MEMCPY_OUT_FUSION_BUFFER);
-  MemcpyOutFusionBuffer(entry_component_offsets, entry_component_sizes,
-                        global_state_->shared_buffer, element_size, entries);
+  copy_out(shared_buffer);
   Barrier();
-  timeline.ActivityEndAll(entries);
-
-  // Free the buffers
-  delete[] cross_displcmnts;
-  delete[] cross_recvcounts;
 
   return Status::OK();
 }
@@ -314,7 +880,8 @@ bool MPIHierarchicalAllgather::Enabled(const ParameterManager& param_manager,
 }
 
 void MPIHierarchicalAllgather::Barrier() {
-  int op = MPI_Barrier(mpi_context_->GetMPICommunicator(Communicator::GLOBAL));
+  // The shared window only needs the ranks of the node to synchronize.
+  int op = MPI_Barrier(mpi_context_->GetMPICommunicator(Communicator::LOCAL));
   if (op != MPI_SUCCESS) {
     throw std::runtime_error("MPI_Barrier failed, see MPI output for details.");
   }
@@ -324,27 +891,69 @@ MPIBroadcast::MPIBroadcast(MPIContext* mpi_context, HorovodGlobalState* global_s
     : BroadcastOp(global_state), mpi_context_(mpi_context) {}
 
 Status MPIBroadcast::Execute(std::vector<TensorTableEntry>& entries, const Response& response) {
-  assert(entries.size() == 1);
-  auto e = entries[0];
+  auto& first_entry = entries[0];
+  bool is_root = global_state_->controller->GetRank() == first_entry.root_rank;
+
+  bool async = mpi_context_->async_collectives;
+  if (async) {
+    mpi_context_->Progress(false);
+  }
 
   // On root rank, MPI_Bcast sends data, on other ranks it receives data.
   void* data_ptr;
-  if (global_state_->controller->GetRank() == e.root_rank) {
-    data_ptr = (void*) e.tensor->data();
+  std::shared_ptr<PersistentBuffer> fusion_buffer;
+  if (entries.size() > 1) {
+    if (async) {
+      fusion_buffer = CurrentFusionBuffer(first_entry);
+      mpi_context_->WaitForBuffer(fusion_buffer);
+    }
+    size_t buffer_len;
+    global_state_->timeline.ActivityStartAll(entries, MEMCPY_IN_FUSION_BUFFER);
+    MemcpyInFusionBuffer(entries, data_ptr, buffer_len);
+    global_state_->timeline.ActivityEndAll(entries);
+  } else if (is_root) {
+    data_ptr = (void*) first_entry.tensor->data();
   } else {
-    data_ptr = (void*) e.output->data();
+    data_ptr = (void*) first_entry.output->data();
   }
 
   global_state_->timeline.ActivityStartAll(entries, MPI_BCAST);
+  auto copy_out = [this, data_ptr, is_root](std::vector<TensorTableEntry>& entries) {
+    if (entries.size() > 1 && !is_root) {
+      global_state_->timeline.ActivityStartAll(entries, MEMCPY_OUT_FUSION_BUFFER);
+      MemcpyOutFusionBuffer(data_ptr, entries);
+      global_state_->timeline.ActivityEndAll(entries);
+    }
+  };
+
+  if (async) {
+    MPI_Request request;
+    int op = MPI_Ibcast(data_ptr,
+                        (int) NumElements(entries),
+                        mpi_context_->GetMPIDataType(first_entry.tensor->dtype()),
+                        first_entry.root_rank,
+                        mpi_context_->GetMPICommunicator(Communicator::GLOBAL),
+                        &request);
+    if (op != MPI_SUCCESS) {
+      throw std::runtime_error("MPI_Ibcast failed, see MPI output for details.");
+    }
+    auto on_complete = [copy_out, entries]() mutable { copy_out(entries); };
+    mpi_context_->Enqueue(request, entries, fusion_buffer, on_complete,
+                          "MPI_Broadcast failed, see MPI output for details.",
+                          global_state_->timeline);
+    return Status::InProgress();
+  }
+
   int op = MPI_Bcast(data_ptr,
-                     (int) e.tensor->shape().num_elements(),
-                     mpi_context_->GetMPIDataType(e.tensor->dtype()),
-                     e.root_rank,
+                     (int) NumElements(entries),
+                     mpi_context_->GetMPIDataType(first_entry.tensor->dtype()),
+                     first_entry.root_rank,
                      mpi_context_->GetMPICommunicator(Communicator::GLOBAL));
   if (op != MPI_SUCCESS) {
     throw std::runtime_error("MPI_Broadcast failed, see MPI output for details.");
   }
   global_state_->timeline.ActivityEndAll(entries);
+  copy_out(entries);
 
   return Status::OK();
 }
@@ -355,5 +964,231 @@ bool MPIBroadcast::Enabled(const ParameterManager& param_manager,
   return true;
 }
 
+MPIPipelinedBroadcast::MPIPipelinedBroadcast(MPIContext* mpi_context,
+                                             HorovodGlobalState* global_state)
+    : MPIBroadcast(mpi_context, global_state) {}
+
+Status MPIPipelinedBroadcast::Execute(std::vector<TensorTableEntry>& entries,
+                                      const Response& response) {
+  auto& timeline = global_state_->timeline;
+  auto& controller = *global_state_->controller;
+  auto& first_entry = entries[0];
+  int rank = controller.GetRank();
+  bool is_root = rank == first_entry.root_rank;
+
+  auto check = [](int op, const char* name) {
+    if (op != MPI_SUCCESS) {
+      throw std::runtime_error(std::string(name) +
+                               " failed, see MPI output for details.");
+    }
+  };
+
+  if (rank_locations_.empty()) {
+    int location[2] = {controller.GetLocalRank(), controller.GetCrossRank()};
+    rank_locations_.resize(2 * (size_t)controller.GetSize());
+    check(MPI_Allgather(location, 2, MPI_INT, rank_locations_.data(), 2,
+                        MPI_INT,
+                        mpi_context_->GetMPICommunicator(Communicator::GLOBAL)),
+          "MPI_Allgather");
+  }
+
+  if (mpi_context_->async_collectives) {
+    mpi_context_->Progress(false);
+  }
+  void* data_ptr;
+  if (entries.size() > 1) {
+    if (mpi_context_->async_collectives) {
+      mpi_context_->WaitForBuffer(CurrentFusionBuffer(first_entry));
+    }
+    size_t buffer_len;
+    timeline.ActivityStartAll(entries, MEMCPY_IN_FUSION_BUFFER);
+    MemcpyInFusionBuffer(entries, data_ptr, buffer_len);
+    timeline.ActivityEndAll(entries);
+  } else if (is_root) {
+    data_ptr = (void*)first_entry.tensor->data();
+  } else {
+    data_ptr = (void*)first_entry.output->data();
+  }
+
+  int64_t bytes = 0;
+  for (auto& e : entries) {
+    bytes += e.tensor->size();
+  }
+  int64_t chunk_bytes = global_state_->broadcast_chunk_bytes;
+  int64_t num_chunks = (bytes + chunk_bytes - 1) / chunk_bytes;
+
+  // Position of this node in the chain, which starts at the root's node.
+  int root_local_rank = rank_locations_[2 * first_entry.root_rank];
+  int root_cross_rank = rank_locations_[2 * first_entry.root_rank + 1];
+  int cross_size = controller.GetCrossSize();
+  int position =
+      (controller.GetCrossRank() - root_cross_rank + cross_size) % cross_size;
+  bool is_relay = controller.GetLocalRank() == root_local_rank;
+  auto cross_comm = mpi_context_->GetMPICommunicator(Communicator::CROSS);
+  auto local_comm = mpi_context_->GetMPICommunicator(Communicator::LOCAL);
+  int prev = (controller.GetCrossRank() - 1 + cross_size) % cross_size;
+  int next = (controller.GetCrossRank() + 1) % cross_size;
+  bool has_prev = is_relay && position > 0;
+  bool has_next = is_relay && position < cross_size - 1;
+
+  timeline.ActivityStartAll(entries, MPI_PIPELINED_BCAST);
+  // Chunks are received in the order they are sent, so all receives are
+  // posted up front and the next chunks arrive while one is fanned out.
+  auto data = (uint8_t*)data_ptr;
+  std::vector<MPI_Request> recv_requests;
+  std::vector<MPI_Request> send_requests;
+  for (int64_t c = 0; has_prev && c < num_chunks; ++c) {
+    int64_t offset = c * chunk_bytes;
+    MPI_Request request;
+    check(MPI_Irecv(data + offset, (int)std::min(chunk_bytes, bytes - offset),
+                    MPI_BYTE, prev, 0, cross_comm, &request),
+          "MPI_Irecv");
+    recv_requests.push_back(request);
+  }
+  auto& shared_memory = global_state_->shared_memory;
+  for (int64_t c = 0; c < num_chunks; ++c) {
+    int64_t offset = c * chunk_bytes;
+    int count = (int)std::min(chunk_bytes, bytes - offset);
+    if (has_prev) {
+      check(MPI_Wait(&recv_requests[c], MPI_STATUS_IGNORE), "MPI_Wait");
+    }
+    if (has_next) {
+      MPI_Request request;
+      check(MPI_Isend(data + offset, count, MPI_BYTE, next, 0, cross_comm,
+                      &request),
+            "MPI_Isend");
+      send_requests.push_back(request);
+    }
+    if (shared_memory.IsEnabled()) {
+      shared_memory.Broadcast(data + offset, (size_t)count, root_local_rank);
+    } else if (controller.GetLocalSize() > 1) {
+      check(MPI_Bcast(data + offset, count, MPI_BYTE, root_local_rank,
+                      local_comm),
+            "MPI_Bcast");
+    }
+  }
+  check(MPI_Waitall((int)send_requests.size(), send_requests.data(),
+                    MPI_STATUSES_IGNORE),
+        "MPI_Waitall");
+  timeline.ActivityEndAll(entries);
+
+  if (entries.size() > 1 && !is_root) {
+    timeline.ActivityStartAll(entries, MEMCPY_OUT_FUSION_BUFFER);
+    MemcpyOutFusionBuffer(data_ptr, entries);
+    timeline.ActivityEndAll(entries);
+  }
+
+  return Status::OK();
+}
+
+bool MPIPipelinedBroadcast::Enabled(
+    const ParameterManager& param_manager,
+    const std::vector<TensorTableEntry>& entries,
+    const Response& response) const {
+  // The chain needs a relay with the root's local rank on every node, and
+  // only pays off for buffers of several chunks.
+  int64_t chunk_bytes = global_state_->broadcast_chunk_bytes;
+  if (chunk_bytes <= 0 || entries[0].device != CPU_DEVICE_ID ||
+      !global_state_->controller->IsHomogeneous() ||
+      global_state_->controller->GetCrossSize() < 2) {
+    return false;
+  }
+  int64_t bytes = 0;
+  for (auto& e : entries) {
+    bytes += e.tensor->size();
+  }
+  return bytes >= BROADCAST_PIPELINE_CHUNKS * chunk_bytes;
+}
+
+MPIReducescatter::MPIReducescatter(MPIContext* mpi_context, HorovodGlobalState* global_state)
+    : ReducescatterOp(global_state), mpi_context_(mpi_context) {}
+
+Status MPIReducescatter::Execute(std::vector<TensorTableEntry>& entries, const Response& response) {
+  auto& timeline = global_state_->timeline;
+  auto& first_entry = entries[0];
+
+  std::vector<int> recvcounts;
+  std::vector<int> displcmnts;
+  timeline.ActivityStartAll(entries, ALLOCATE_OUTPUT);
+  Status status = AllocateOutput(entries, recvcounts, displcmnts);
+  if (!status.ok()) {
+    return status;
+  }
+  timeline.ActivityEndAll(entries);
+
+  // A single tensor is already laid out rank by rank. In place, the block
+  // reduced onto this rank is written to the start of the fusion buffer.
+  const void* sendbuf = MPI_IN_PLACE;
+  void* buffer_data;
+  if (entries.size() > 1) {
+    size_t buffer_len;
+    timeline.ActivityStartAll(entries, MEMCPY_IN_FUSION_BUFFER);
+    MemcpyInFusionBuffer(entries, buffer_data, buffer_len);
+    timeline.ActivityEndAll(entries);
+  } else {
+    sendbuf = first_entry.tensor->data();
+    buffer_data = (void*) first_entry.output->data();
+  }
+
+  timeline.ActivityStartAll(entries, MPI_REDUCESCATTER);
+  auto dtype = first_entry.tensor->dtype();
+  int op = MPI_Reduce_scatter(sendbuf, buffer_data, recvcounts.data(),
+                              mpi_context_->GetMPIDataType(dtype),
+                              mpi_context_->GetMPISumOp(dtype),
+                              mpi_context_->GetMPICommunicator(Communicator::GLOBAL));
+  if (op != MPI_SUCCESS) {
+    throw std::runtime_error("MPI_Reduce_scatter failed, see MPI output for details.");
+  }
+  timeline.ActivityEndAll(entries);
+
+  if (entries.size() > 1) {
+    timeline.ActivityStartAll(entries, MEMCPY_OUT_FUSION_BUFFER);
+    MemcpyOutFusionBuffer(buffer_data, entries);
+    timeline.ActivityEndAll(entries);
+  }
+
+  return Status::OK();
+}
+
+bool MPIReducescatter::Enabled(const ParameterManager& param_manager,
+                               const std::vector<TensorTableEntry>& entries,
+                               const Response& response) const {
+  return true;
+}
+
+MPIAlltoall::MPIAlltoall(MPIContext* mpi_context, HorovodGlobalState* global_state)
+    : AlltoallOp(global_state), mpi_context_(mpi_context) {}
+
+Status MPIAlltoall::Execute(std::vector<TensorTableEntry>& entries, const Response& response) {
+  auto& timeline = global_state_->timeline;
+  auto& e = entries[0];
+
+  std::vector<int> sendcounts, sdispls, recvcounts, rdispls;
+  timeline.ActivityStartAll(entries, ALLOCATE_OUTPUT);
+  Status status = AllocateOutput(e, response, sendcounts, sdispls, recvcounts, rdispls);
+  if (!status.ok()) {
+    return status;
+  }
+  timeline.ActivityEndAll(entries);
+
+  timeline.ActivityStartAll(entries, MPI_ALLTOALL);
+  auto dtype = mpi_context_->GetMPIDataType(e.tensor->dtype());
+  int op = MPI_Alltoallv(e.tensor->data(), sendcounts.data(), sdispls.data(), dtype,
+                         (void*) e.output->data(), recvcounts.data(), rdispls.data(), dtype,
+                         mpi_context_->GetMPICommunicator(Communicator::GLOBAL));
+  if (op != MPI_SUCCESS) {
+    throw std::runtime_error("MPI_Alltoallv failed, see MPI output for details.");
+  }
+  timeline.ActivityEndAll(entries);
+
+  return Status::OK();
+}
+
+bool MPIAlltoall::Enabled(const ParameterManager& param_manager,
+                          const std::vector<TensorTableEntry>& entries,
+                          const Response& response) const {
+  return true;
+}
+
 } // namespace common
 } // namespace horovod
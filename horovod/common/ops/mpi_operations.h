@@ -22,6 +22,8 @@
 #include "mpi.h"
 
 #include "collective_operations.h"
+#include "quantized_operations.h"
+#include "sparse_operations.h"
 #include "../common.h"
 #include "../global_state.h"
 #include "../mpi/mpi_context.h"
@@ -42,6 +44,107 @@ public:
                const Response& response) const override;
 
 protected:
+  // Allreduces the packed entries from fused_input_data into buffer_data,
+  // which may be the same buffer.
+  virtual void DoAllreduce(std::vector<TensorTableEntry>& entries,
+                           const void* fused_input_data, void* buffer_data,
+                           int64_t num_elements, DataType dtype,
+                           size_t buffer_len);
+
+  // Starts the allreduce of DoAllreduce without waiting for it and sets
+  // request, or returns false if it has to be done blocking. The choice must
+  // be the same on all ranks, as blocking and non-blocking collectives do not
+  // match each other.
+  virtual bool StartAllreduce(std::vector<TensorTableEntry>& entries,
+                              const void* fused_input_data, void* buffer_data,
+                              int64_t num_elements, DataType dtype,
+                              size_t buffer_len, MPI_Request& request);
+
+  // Communicator of the process set of the entries.
+  MPI_Comm ProcessSetCommunicator(const std::vector<TensorTableEntry>& entries);
+
+  MPIContext* mpi_context_;
+
+private:
+  // Whether the fused entries are allreduced in the fusion buffer with a
+  // persistent request. The same on all ranks, as persistent and regular
+  // collectives do not match each other.
+  bool UsePersistentAllreduce(const std::vector<TensorTableEntry>& entries) const;
+
+  // Allreduces buffer_data in place in log2(size) pairwise exchanges, folding
+  // the ranks beyond the largest power of two into their neighbours first.
+  void RecursiveDoublingAllreduce(MPI_Comm comm, void* buffer_data,
+                                  int num_elements, DataType dtype,
+                                  ReduceOp reduce_op, size_t buffer_len);
+
+  // Whether the entries are reduced in the fixed tree of
+  // RecursiveDoublingAllreduce whatever the buffer size, for results that do
+  // not depend on the fusion layout or the MPI library.
+  bool UseFixedTreeAllreduce(const std::vector<TensorTableEntry>& entries) const;
+
+  // Allreduces buffer_data in place in the same tree as
+  // RecursiveDoublingAllreduce, but scatters the halves of the buffer in
+  // log2(size) exchanges and gathers them back, so each rank sends about
+  // twice the buffer rather than log2(size) times.
+  void FixedTreeAllreduce(MPI_Comm comm, void* buffer_data, int num_elements,
+                          DataType dtype, ReduceOp reduce_op,
+                          size_t buffer_len);
+
+  // Receives the partner's buffer in each exchange.
+  std::vector<uint8_t> recv_buffer_;
+};
+
+// Allreduces CPU tensors in two levels: within each node through the shared
+// memory arena, or over the LOCAL communicator if it is not mapped, and across
+// nodes over the CROSS communicator, so that each node sends its data once
+// instead of once per local rank.
+class MPIHierarchicalAllreduce : public MPIAllreduce {
+public:
+  MPIHierarchicalAllreduce(MPIContext* mpi_context,
+                           HorovodGlobalState* global_state);
+
+  bool Enabled(const ParameterManager& param_manager,
+               const std::vector<TensorTableEntry>& entries,
+               const Response& response) const override;
+
+protected:
+  void DoAllreduce(std::vector<TensorTableEntry>& entries,
+                   const void* fused_input_data, void* buffer_data,
+                   int64_t num_elements, DataType dtype,
+                   size_t buffer_len) override;
+
+  bool StartAllreduce(std::vector<TensorTableEntry>& entries,
+                      const void* fused_input_data, void* buffer_data,
+                      int64_t num_elements, DataType dtype, size_t buffer_len,
+                      MPI_Request& request) override;
+
+private:
+  // Block of the node's data reduced by this local rank.
+  std::vector<uint8_t> block_buffer_;
+};
+
+class MPISparseAllreduce : public SparseAllreduce {
+public:
+  MPISparseAllreduce(MPIContext* mpi_context,
+                     HorovodGlobalState* global_state);
+
+protected:
+  void Allgather(const SparseElement* sendbuf, SparseElement* recvbuf,
+                 int count) override;
+
+  MPIContext* mpi_context_;
+};
+
+class MPIQuantizedAllreduce : public QuantizedAllreduce {
+public:
+  MPIQuantizedAllreduce(MPIContext* mpi_context,
+                        HorovodGlobalState* global_state);
+
+protected:
+  void Alltoall(const uint8_t* sendbuf, uint8_t* recvbuf, int bytes) override;
+
+  void Allgather(const uint8_t* sendbuf, uint8_t* recvbuf, int bytes) override;
+
   MPIContext* mpi_context_;
 };
 
@@ -71,6 +174,10 @@ public:
 
 private:
   void Barrier();
+
+  // Counts and displacements of the cross-node allgather, kept across calls.
+  std::vector<int64_t> cross_recvcounts_;
+  std::vector<int64_t> cross_displcmnts_;
 };
 
 class MPIBroadcast : public BroadcastOp {
@@ -87,6 +194,60 @@ protected:
   MPIContext* mpi_context_;
 };
 
+// Smallest number of chunks of a pipelined broadcast.
+const int64_t BROADCAST_PIPELINE_CHUNKS = 16;
+
+// Broadcast of large host buffers in chunks of broadcast_chunk_bytes. The
+// ranks with the local rank of the root relay the chunks along a chain of
+// nodes starting at the root's, each one forwarding a chunk as soon as it
+// arrived and fanning it out to its node, through the shared memory arena if
+// it is mapped. The time of the broadcast is then that of sending the buffer
+// once plus one chunk per node, instead of growing with the number of nodes.
+class MPIPipelinedBroadcast : public MPIBroadcast {
+public:
+  MPIPipelinedBroadcast(MPIContext* mpi_context,
+                        HorovodGlobalState* global_state);
+
+  Status Execute(std::vector<TensorTableEntry>& entries,
+                 const Response& response) override;
+
+  bool Enabled(const ParameterManager& param_manager,
+               const std::vector<TensorTableEntry>& entries,
+               const Response& response) const override;
+
+private:
+  // Local and cross rank of every rank, gathered on the first call.
+  std::vector<int> rank_locations_;
+};
+
+class MPIReducescatter : public ReducescatterOp {
+public:
+  MPIReducescatter(MPIContext* mpi_context, HorovodGlobalState* global_state);
+
+  Status Execute(std::vector<TensorTableEntry>& entries, const Response& response) override;
+
+  bool Enabled(const ParameterManager& param_manager,
+               const std::vector<TensorTableEntry>& entries,
+               const Response& response) const override;
+
+protected:
+  MPIContext* mpi_context_;
+};
+
+class MPIAlltoall : public AlltoallOp {
+public:
+  MPIAlltoall(MPIContext* mpi_context, HorovodGlobalState* global_state);
+
+  Status Execute(std::vector<TensorTableEntry>& entries, const Response& response) override;
+
+  bool Enabled(const ParameterManager& param_manager,
+               const std::vector<TensorTableEntry>& entries,
+               const Response& response) const override;
+
+protected:
+  MPIContext* mpi_context_;
+};
+
 } // namespace common
 } // namespace horovod
 
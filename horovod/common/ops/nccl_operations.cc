@@ -16,9 +16,78 @@
 
 #include "nccl_operations.h"
 
+#include <algorithm>
+#include <cmath>
+
+#include "../logging.h"
+#include "cuda/cuda_kernels.h"
+
 namespace horovod {
 namespace common {
 
+namespace {
+
+// NCCL streams the background thread picks from: the configured or tuned
+// number of streams, and the stream reserved for urgent allreduces.
+std::vector<int> StreamsInUse(const HorovodGlobalState* global_state) {
+  std::vector<int> streams;
+  for (int i = 0; i < global_state->parameter_manager.NumNCCLStreams(); ++i) {
+    streams.push_back(i);
+  }
+  if (global_state->urgent_nccl_stream >= 0) {
+    streams.push_back(global_state->urgent_nccl_stream);
+  }
+  return streams;
+}
+
+// Devices of all ranks when every rank drives the GPU of its local rank, or
+// the only GPU it sees, and the ranks of each node are consecutive. Returns
+// false on all ranks if the layout does not hold on some of them.
+bool LocalRankDevices(HorovodGlobalState* global_state,
+                      std::vector<int32_t>& devices) {
+  auto& controller = global_state->controller;
+  int size = controller->GetSize();
+  int local_size = controller->GetLocalSize();
+
+  int device_count = 0;
+  if (cudaGetDeviceCount(&device_count) != cudaSuccess) {
+    device_count = 0;
+  }
+
+  // The device of every rank follows from its global rank only if the ranks
+  // of each node are consecutive.
+  bool consecutive = controller->IsHomogeneous();
+  auto& local_comm_ranks = controller->GetLocalCommRanks();
+  for (int i = 0; i < (int)local_comm_ranks.size(); ++i) {
+    consecutive &= local_comm_ranks[i] == local_comm_ranks[0] + i &&
+                   local_comm_ranks[0] % local_size == 0;
+  }
+
+  std::vector<long long> layout{(consecutive ? 1LL : 0LL) |
+                                (device_count == 1 ? 2LL : 0LL) |
+                                (device_count >= local_size ? 4LL : 0LL)};
+  controller->CrossRankBitwiseAnd(layout, 1);
+  if ((layout[0] & 1LL) == 0 || (layout[0] & 6LL) == 0) {
+    return false;
+  }
+
+  bool one_device = (layout[0] & 2LL) != 0;
+  devices.resize(size);
+  for (int r = 0; r < size; ++r) {
+    devices[r] = one_device ? 0 : r % local_size;
+  }
+  return true;
+}
+
+void CudaCheck(const char* name, cudaError_t result) {
+  if (result != cudaSuccess) {
+    throw std::logic_error(std::string(name) + " failed: " +
+                           cudaGetErrorString(result));
+  }
+}
+
+} // namespace
+
 ncclDataType_t GetNCCLDataType(const std::shared_ptr<Tensor> tensor) {
   switch (tensor->dtype()) {
     case HOROVOD_INT32:
@@ -31,12 +100,32 @@ ncclDataType_t GetNCCLDataType(const std::shared_ptr<Tensor> tensor) {
       return ncclFloat32;
     case HOROVOD_FLOAT64:
       return ncclFloat64;
+#if NCCL_VERSION_CODE >= 21000
+    case HOROVOD_BFLOAT16:
+      return ncclBfloat16;
+#endif
     default:
       throw std::logic_error("Type " + DataType_Name(tensor->dtype()) +
                              " is not supported in NCCL mode.");
   }
 }
 
+ncclRedOp_t GetNCCLRedOp(ReduceOp reduce_op) {
+  switch (reduce_op) {
+    case ReduceOp::SUM:
+      return ncclSum;
+    case ReduceOp::MIN:
+      return ncclMin;
+    case ReduceOp::MAX:
+      return ncclMax;
+    case ReduceOp::PRODUCT:
+      return ncclProd;
+    default:
+      throw std::logic_error("Reduction " + ReduceOp_Name(reduce_op) +
+                             " is not supported in NCCL mode.");
+  }
+}
+
 void NCCLContext::ErrorCheck(std::string op_name, ncclResult_t nccl_result) {
   if (nccl_result != ncclSuccess) {
     throw std::logic_error(std::string(op_name) + " failed: " + ncclGetErrorString(nccl_result));
@@ -50,6 +139,353 @@ void NCCLContext::ShutDown(){
     }
   }
   nccl_comms.clear();
+  for (auto& comms : global_comms) {
+    for (auto& entry : comms) {
+      ncclCommDestroy(entry.second);
+    }
+  }
+  global_comms.clear();
+  for (auto& comms : cross_comms) {
+    for (auto& entry : comms) {
+      ncclCommDestroy(entry.second);
+    }
+  }
+  cross_comms.clear();
+  std::lock_guard<std::mutex> guard(capture_mutex);
+  if (capture_comm != nullptr) {
+    ncclCommDestroy(capture_comm);
+    capture_comm = nullptr;
+    capture_device = -1;
+  }
+  if (capture_buffer != nullptr) {
+    cudaFree(capture_buffer);
+    capture_buffer = nullptr;
+    capture_buffer_bytes = 0;
+  }
+}
+
+void NCCLContext::InitComms(
+    std::vector<std::unordered_map<std::vector<int32_t>, ncclComm_t>>& comms,
+    HorovodGlobalState* global_state,
+    const std::vector<TensorTableEntry>& entries,
+    const std::vector<int32_t>& devices, int nccl_rank, int nccl_size,
+    Communicator nccl_id_bcast_comm, const std::vector<int>& streams) {
+  auto& timeline = global_state->timeline;
+  timeline.ActivityStartAll(entries, INIT_NCCL);
+
+  std::vector<ncclUniqueId> nccl_ids(streams.size());
+  if (nccl_rank == 0) {
+    for (auto& nccl_id : nccl_ids) {
+      ErrorCheck("ncclGetUniqueId", ncclGetUniqueId(&nccl_id));
+    }
+  }
+
+  global_state->controller->Bcast((void*)nccl_ids.data(),
+                                  nccl_ids.size() * sizeof(ncclUniqueId), 0,
+                                  nccl_id_bcast_comm);
+
+  std::vector<ncclComm_t> new_nccl_comms(streams.size());
+  ErrorCheck("ncclGroupStart", ncclGroupStart());
+  for (size_t i = 0; i < streams.size(); ++i) {
+    ErrorCheck("ncclCommInitRank",
+               ncclCommInitRank(&new_nccl_comms[i], nccl_size, nccl_ids[i],
+                                nccl_rank));
+  }
+  ErrorCheck("ncclGroupEnd", ncclGroupEnd());
+  for (size_t i = 0; i < streams.size(); ++i) {
+    comms[streams[i]][devices] = new_nccl_comms[i];
+  }
+
+  // Barrier helps NCCL to synchronize after initialization and avoid
+  // deadlock that we've been seeing without it.
+  global_state->controller->Barrier(Communicator::GLOBAL);
+
+  timeline.ActivityEndAll(entries);
+}
+
+#if NCCL_VERSION_CODE >= 21800
+void NCCLContext::SplitComms(
+    std::vector<std::unordered_map<std::vector<int32_t>, ncclComm_t>>& comms,
+    HorovodGlobalState* global_state,
+    const std::vector<TensorTableEntry>& entries,
+    const std::vector<int32_t>& devices, int color, int key,
+    const std::vector<int>& streams) {
+  auto& timeline = global_state->timeline;
+  timeline.ActivityStartAll(entries, INIT_NCCL);
+
+  std::vector<ncclComm_t> new_nccl_comms(streams.size());
+  ErrorCheck("ncclGroupStart", ncclGroupStart());
+  for (size_t i = 0; i < streams.size(); ++i) {
+    ErrorCheck("ncclCommSplit",
+               ncclCommSplit(global_comms[streams[i]].at(devices), color, key,
+                             &new_nccl_comms[i], nullptr));
+  }
+  ErrorCheck("ncclGroupEnd", ncclGroupEnd());
+  for (size_t i = 0; i < streams.size(); ++i) {
+    comms[streams[i]][devices] = new_nccl_comms[i];
+  }
+
+  timeline.ActivityEndAll(entries);
+}
+#endif
+
+ncclComm_t& NCCLContext::GetGlobalComm(HorovodGlobalState* global_state,
+                                       const std::vector<TensorTableEntry>& entries,
+                                       const std::vector<int32_t>& devices) {
+  auto& comms = global_comms[global_state->current_nccl_stream];
+  auto it = comms.find(devices);
+  if (it == comms.end()) {
+    InitComms(global_comms, global_state, entries, devices,
+              global_state->controller->GetRank(),
+              global_state->controller->GetSize(), Communicator::GLOBAL,
+              {global_state->current_nccl_stream});
+    it = comms.find(devices);
+  }
+  return it->second;
+}
+
+ncclComm_t& NCCLContext::GetLocalComm(HorovodGlobalState* global_state,
+                                      const std::vector<TensorTableEntry>& entries,
+                                      const std::vector<int32_t>& devices) {
+  auto& controller = global_state->controller;
+  // Communicators are found by the devices of all ranks rather than by those
+  // of the node, so that all ranks miss together: both the split and the
+  // initialization are collective over all ranks.
+  auto& comms = nccl_comms[global_state->current_nccl_stream];
+  auto it = comms.find(devices);
+  if (it == comms.end()) {
+#if NCCL_VERSION_CODE >= 21800
+    // All ranks run the same responses, so they agree on whether the global
+    // communicators exist.
+    auto& global = global_comms[global_state->current_nccl_stream];
+    if (global.find(devices) != global.end()) {
+      SplitComms(nccl_comms, global_state, entries, devices,
+                 controller->GetCrossRank(), controller->GetLocalRank(),
+                 {global_state->current_nccl_stream});
+    } else
+#endif
+    {
+      InitComms(nccl_comms, global_state, entries, devices,
+                controller->GetLocalRank(), controller->GetLocalSize(),
+                Communicator::LOCAL, {global_state->current_nccl_stream});
+    }
+    it = comms.find(devices);
+  }
+  return it->second;
+}
+
+ncclComm_t& NCCLContext::GetCrossComm(HorovodGlobalState* global_state,
+                                      const std::vector<TensorTableEntry>& entries,
+                                      const std::vector<int32_t>& devices) {
+  auto& controller = global_state->controller;
+  // Found by the devices of all ranks for the same reason as in GetLocalComm.
+  auto& comms = cross_comms[global_state->current_nccl_stream];
+  auto it = comms.find(devices);
+  if (it == comms.end()) {
+#if NCCL_VERSION_CODE >= 21800
+    auto& global = global_comms[global_state->current_nccl_stream];
+    if (global.find(devices) != global.end()) {
+      SplitComms(cross_comms, global_state, entries, devices,
+                 controller->GetLocalRank(), controller->GetCrossRank(),
+                 {global_state->current_nccl_stream});
+    } else
+#endif
+    {
+      InitComms(cross_comms, global_state, entries, devices,
+                controller->GetCrossRank(), controller->GetCrossSize(),
+                Communicator::CROSS, {global_state->current_nccl_stream});
+    }
+    it = comms.find(devices);
+  }
+  return it->second;
+}
+
+void NCCLContext::InitGlobalCommsEagerly(HorovodGlobalState* global_state) {
+  int rank = global_state->controller->GetRank();
+  std::vector<int32_t> devices;
+  if (!LocalRankDevices(global_state, devices)) {
+    LOG(WARNING, rank) << "Ranks do not use the GPU of their local rank, "
+                          "NCCL communicators are created on first use.";
+    return;
+  }
+
+  auto cuda_result = cudaSetDevice(devices[rank]);
+  if (cuda_result != cudaSuccess) {
+    throw std::logic_error(std::string("cudaSetDevice failed: ") +
+                           cudaGetErrorString(cuda_result));
+  }
+  std::vector<TensorTableEntry> entries;
+  InitComms(global_comms, global_state, entries, devices, rank,
+            global_state->controller->GetSize(), Communicator::GLOBAL,
+            StreamsInUse(global_state));
+}
+
+bool NCCLContext::HasGlobalComms(const HorovodGlobalState* global_state,
+                                 const std::vector<int32_t>& devices) const {
+  for (int stream : StreamsInUse(global_state)) {
+    if (stream >= (int)global_comms.size() ||
+        global_comms[stream].find(devices) == global_comms[stream].end()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void NCCLContext::InitCaptureComm(HorovodGlobalState* global_state) {
+  // The communicator of a previous membership is destroyed first, even if
+  // no new one is created.
+  std::lock_guard<std::mutex> guard(capture_mutex);
+  if (capture_comm != nullptr) {
+    ncclCommDestroy(capture_comm);
+    capture_comm = nullptr;
+    capture_device = -1;
+  }
+
+  int rank = global_state->controller->GetRank();
+  std::vector<int32_t> devices;
+  if (!LocalRankDevices(global_state, devices)) {
+    LOG(WARNING, rank) << "Ranks do not use the GPU of their local rank, "
+                          "graph-capturable allreduces are disabled.";
+    return;
+  }
+
+  auto cuda_result = cudaSetDevice(devices[rank]);
+  if (cuda_result != cudaSuccess) {
+    throw std::logic_error(std::string("cudaSetDevice failed: ") +
+                           cudaGetErrorString(cuda_result));
+  }
+  std::vector<std::unordered_map<std::vector<int32_t>, ncclComm_t>> comms(1);
+  std::vector<TensorTableEntry> entries;
+  InitComms(comms, global_state, entries, devices, rank,
+            global_state->controller->GetSize(), Communicator::GLOBAL, {0});
+  capture_comm = comms[0][devices];
+  capture_device = devices[rank];
+}
+
+Status NCCLContext::CapturableAllreduce(std::vector<TensorTableEntry>& entries,
+                                        cudaStream_t stream) {
+  std::lock_guard<std::mutex> guard(capture_mutex);
+  auto& first_entry = entries[0];
+  if (capture_comm == nullptr) {
+    return Status::PreconditionError(
+        "Graph-capturable allreduces require HOROVOD_CUDA_GRAPH=1 and every "
+        "rank driving the GPU of its local rank.");
+  }
+  if (first_entry.device != capture_device) {
+    return Status::InvalidArgument(
+        "Graph-capturable allreduces run on GPU " +
+        std::to_string(capture_device) + ", not on " +
+        (first_entry.device == CPU_DEVICE_ID
+             ? std::string("the CPU")
+             : "GPU " + std::to_string(first_entry.device)) +
+        ".");
+  }
+
+  // The caller's current device is left as it was.
+  int restore_device = capture_device;
+  if (cudaGetDevice(&restore_device) != cudaSuccess) {
+    restore_device = capture_device;
+  }
+  Status status;
+  try {
+    CudaCheck("cudaSetDevice", cudaSetDevice(capture_device));
+    status = CapturableAllreduceOnDevice(entries, stream);
+  } catch (const std::exception& ex) {
+    status = Status::UnknownError(ex.what());
+  }
+  cudaSetDevice(restore_device);
+  return status;
+}
+
+Status NCCLContext::CapturableAllreduceOnDevice(
+    std::vector<TensorTableEntry>& entries, cudaStream_t stream) {
+  auto& first_entry = entries[0];
+  auto dtype = first_entry.tensor->dtype();
+  auto nccl_dtype = GetNCCLDataType(first_entry.tensor);
+  auto op = GetNCCLRedOp(first_entry.reduce_op);
+
+  // A single tensor is reduced into its output directly.
+  if (entries.size() == 1) {
+    const void* input = first_entry.tensor->data();
+    void* output = (void*)first_entry.output->data();
+    int64_t num_elements = first_entry.tensor->shape().num_elements();
+    if (first_entry.prescale_factor != 1.0) {
+      ScaleBufferCudaImpl(input, output, num_elements,
+                          first_entry.prescale_factor, dtype, stream);
+      CudaCheck("ScaleBufferCudaImpl", cudaGetLastError());
+      input = output;
+    }
+    ErrorCheck("ncclAllReduce",
+               ncclAllReduce(input, output, (size_t)num_elements, nccl_dtype,
+                             op, capture_comm, stream));
+    if (first_entry.postscale_factor != 1.0) {
+      ScaleBufferCudaImpl(output, output, num_elements,
+                          first_entry.postscale_factor, dtype, stream);
+      CudaCheck("ScaleBufferCudaImpl", cudaGetLastError());
+    }
+    return Status::OK();
+  }
+
+  size_t buffer_len = 0;
+  int64_t num_elements = 0;
+  for (auto& e : entries) {
+    buffer_len += (size_t)e.tensor->size();
+    num_elements += e.tensor->shape().num_elements();
+  }
+  if (buffer_len > capture_buffer_bytes) {
+    cudaStreamCaptureStatus capture_status;
+    CudaCheck("cudaStreamIsCapturing",
+              cudaStreamIsCapturing(stream, &capture_status));
+    if (capture_status != cudaStreamCaptureStatusNone) {
+      return Status::PreconditionError(
+          "The buffer of graph-capturable allreduces can only grow outside "
+          "of capture, allreduce the tensors once before capturing them.");
+    }
+    // Freeing waits for the work still using the old buffer.
+    if (capture_buffer != nullptr) {
+      CudaCheck("cudaFree", cudaFree(capture_buffer));
+      capture_buffer = nullptr;
+      capture_buffer_bytes = 0;
+    }
+    CudaCheck("cudaMalloc", cudaMalloc(&capture_buffer, buffer_len));
+    capture_buffer_bytes = buffer_len;
+  }
+
+  // Pack and unpack up to BATCHED_D2D_CAPACITY entries per kernel launch, on
+  // the caller's stream like the allreduce.
+  auto batched_copies = [&](bool pack, double factor) {
+    BatchedD2DParams d2d_params;
+    int64_t offset = 0;
+    int num_copies = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+      auto& e = entries[i];
+      uint8_t* buffer_at_offset = (uint8_t*)capture_buffer + offset;
+      d2d_params.out[num_copies] =
+          pack ? (void*)buffer_at_offset : (void*)e.output->data();
+      d2d_params.in[num_copies] =
+          pack ? e.tensor->data() : (const void*)buffer_at_offset;
+      d2d_params.sizes[num_copies] = (size_t)e.tensor->size();
+      offset += e.tensor->size();
+      ++num_copies;
+
+      if (num_copies == BATCHED_D2D_CAPACITY || i == entries.size() - 1) {
+        if (factor != 1.0) {
+          BatchedScaledD2DMemcpyCudaImpl(d2d_params, num_copies, factor, dtype,
+                                         stream);
+        } else {
+          BatchedD2DMemcpyCudaImpl(d2d_params, num_copies, stream);
+        }
+        CudaCheck("BatchedD2DMemcpyCudaImpl", cudaGetLastError());
+        num_copies = 0;
+      }
+    }
+  };
+  batched_copies(true, first_entry.prescale_factor);
+  ErrorCheck("ncclAllReduce",
+             ncclAllReduce(capture_buffer, capture_buffer, (size_t)num_elements,
+                           nccl_dtype, op, capture_comm, stream));
+  batched_copies(false, first_entry.postscale_factor);
+  return Status::OK();
 }
 
 Status NCCLAllreduce::Execute(std::vector<TensorTableEntry>& entries,
@@ -57,35 +493,44 @@ Status NCCLAllreduce::Execute(std::vector<TensorTableEntry>& entries,
   auto& first_entry = entries[0];
 
   InitCUDA(entries);
-  InitNCCLComm(entries, response.devices());
+  InitNCCLComm(entries, response);
   InitCUDAQueue(entries, response);
 
   const void* fused_input_data;
   void* buffer_data;
   size_t buffer_len;
 
-  // Copy memory into the fusion buffer.
-  if (entries.size() > 1) {
+  // Averages are computed by NCCL when it supports it. The entries are then
+  // unpacked without postscaling.
+  ncclRedOp_t op = GetNCCLRedOp(first_entry.reduce_op);
+#if NCCL_VERSION_CODE >= 21000
+  if (UseNCCLAvg(entries)) {
+    op = ncclAvg;
+    for (auto& e : entries) {
+      e.postscale_factor = 1.0;
+    }
+  }
+#endif
+
+  // Copy memory into the fusion buffer, unless the entries can be reduced
+  // directly.
+  int64_t num_elements = NumElements(entries);
+  bool use_fusion_buffer =
+      !GetDirectBuffers(entries, fused_input_data, buffer_data, buffer_len);
+  if (use_fusion_buffer) {
     MemcpyInFusionBuffer(entries, fused_input_data, buffer_data, buffer_len);
 
     if (global_state_->timeline.Initialized()) {
       cuda_context_->RecordEvent(event_queue_, MEMCPY_IN_FUSION_BUFFER, *stream_);
     }
   } else {
-    fused_input_data = first_entry.tensor->data();
-    buffer_data = (void*) first_entry.output->data();
-    buffer_len = (size_t) first_entry.output->size();
-  }
-
-  int64_t num_elements = 0;
-  for (auto& e : entries) {
-    num_elements += e.tensor->shape().num_elements();
+    PrescaleDirectBuffers(entries, fused_input_data, buffer_data, num_elements);
   }
 
   // Do allreduce.
   auto nccl_result = ncclAllReduce(fused_input_data, buffer_data,
                                    (size_t) num_elements,
-                                   GetNCCLDataType(first_entry.tensor), ncclSum,
+                                   GetNCCLDataType(first_entry.tensor), op,
                                    *nccl_comm_, *stream_);
   nccl_context_->ErrorCheck("ncclAllReduce", nccl_result);
   if (global_state_->timeline.Initialized()) {
@@ -93,57 +538,494 @@ Status NCCLAllreduce::Execute(std::vector<TensorTableEntry>& entries,
   }
 
   // Copy memory out of the fusion buffer.
-  if (entries.size() > 1) {
+  if (use_fusion_buffer) {
     MemcpyOutFusionBuffer(buffer_data, entries);
 
     if (global_state_->timeline.Initialized()) {
       cuda_context_->RecordEvent(event_queue_, MEMCPY_OUT_FUSION_BUFFER, *stream_);
     }
+  } else {
+    PostscaleDirectBuffers(entries, buffer_data, num_elements);
   }
 
   return FinalizeCUDAQueue(entries);
 }
 
+bool NCCLAllreduce::UseNCCLAvg(
+    const std::vector<TensorTableEntry>& entries) const {
+  auto& first_entry = entries[0];
+  auto dtype = first_entry.tensor->dtype();
+  double size = global_state_->controller->GetSize();
+  return first_entry.reduce_op == ReduceOp::SUM &&
+         first_entry.prescale_factor == 1.0 &&
+         std::abs(first_entry.postscale_factor * size - 1.0) < 1e-9 &&
+         (dtype == HOROVOD_FLOAT16 || dtype == HOROVOD_BFLOAT16 ||
+          dtype == HOROVOD_FLOAT32 || dtype == HOROVOD_FLOAT64);
+}
+
 void NCCLAllreduce::InitNCCLComm(const std::vector<TensorTableEntry>& entries,
-                                 const std::vector<int32_t>& nccl_device_map) {
-  // Ensure NCCL communicator is in the map before executing reduction.
-  ncclComm_t& nccl_comm = nccl_context_->nccl_comms[global_state_->current_nccl_stream][nccl_device_map];
-  if (nccl_comm == nullptr) {
-    auto& timeline = global_state_->timeline;
-    timeline.ActivityStartAll(entries, INIT_NCCL);
+                                 const Response& response) {
+  // Flat allreduce shares the global communicators of the other operations.
+  nccl_comm_ =
+      &nccl_context_->GetGlobalComm(global_state_, entries, response.devices());
+}
+
+Status NCCLReducescatter::Execute(std::vector<TensorTableEntry>& entries,
+                                  const Response& response) {
+  auto& timeline = global_state_->timeline;
+  auto& first_entry = entries[0];
 
-    int nccl_rank, nccl_size;
-    Communicator nccl_id_bcast_comm;
-    PopulateNCCLCommStrategy(nccl_rank, nccl_size, nccl_id_bcast_comm);
+  cuda_context_->ErrorCheck("cudaSetDevice", cudaSetDevice(first_entry.device));
+  stream_ = &cuda_context_->GetStream(global_state_->current_nccl_stream,
+                                      first_entry.device);
+  auto& nccl_comm = nccl_context_->GetGlobalComm(global_state_, entries, response.devices());
 
-    ncclUniqueId nccl_id;
-    if (nccl_rank == 0) {
-      nccl_context_->ErrorCheck("ncclGetUniqueId", ncclGetUniqueId(&nccl_id));
+  std::vector<int> recvcounts;
+  std::vector<int> displcmnts;
+  timeline.ActivityStartAll(entries, ALLOCATE_OUTPUT);
+  Status status = AllocateOutput(entries, recvcounts, displcmnts);
+  if (!status.ok()) {
+    return status;
+  }
+  timeline.ActivityEndAll(entries);
+
+  int rank = global_state_->controller->GetRank();
+  int size = global_state_->controller->GetSize();
+  int element_size =
+      global_state_->controller->GetTypeSize(first_entry.tensor->dtype());
+
+  // Fused entries are reduced in place, into the block of this rank.
+  const void* sendbuf;
+  void* recvbuf;
+  if (entries.size() > 1) {
+    void* buffer_data;
+    size_t buffer_len;
+    MemcpyInFusionBuffer(entries, buffer_data, buffer_len);
+    sendbuf = buffer_data;
+    recvbuf = (uint8_t*)buffer_data + (int64_t)displcmnts[rank] * element_size;
+  } else {
+    sendbuf = first_entry.tensor->data();
+    recvbuf = (void*)first_entry.output->data();
+  }
+
+  std::queue<std::pair<std::string, cudaEvent_t>> event_queue;
+  if (timeline.Initialized()) {
+    cuda_context_->RecordEvent(event_queue, QUEUE, *stream_);
+  }
+
+  auto nccl_data_type = GetNCCLDataType(first_entry.tensor);
+  bool even = std::all_of(recvcounts.begin(), recvcounts.end(),
+                          [&](int count) { return count == recvcounts[0]; });
+  if (even) {
+    nccl_context_->ErrorCheck(
+        "ncclReduceScatter",
+        ncclReduceScatter(sendbuf, recvbuf, (size_t)recvcounts[0],
+                          nccl_data_type, ncclSum, nccl_comm, *stream_));
+  } else {
+    // ncclReduceScatter needs equal blocks, so uneven blocks are reduced onto
+    // their rank with one grouped reduce each.
+    nccl_context_->ErrorCheck("ncclGroupStart", ncclGroupStart());
+    for (int rc = 0; rc < size; ++rc) {
+      nccl_context_->ErrorCheck(
+          "ncclReduce",
+          ncclReduce((const uint8_t*)sendbuf + (int64_t)displcmnts[rc] * element_size,
+                     recvbuf, (size_t)recvcounts[rc], nccl_data_type, ncclSum,
+                     rc, nccl_comm, *stream_));
     }
+    nccl_context_->ErrorCheck("ncclGroupEnd", ncclGroupEnd());
+  }
+  if (timeline.Initialized()) {
+    cuda_context_->RecordEvent(event_queue, NCCL_REDUCESCATTER, *stream_);
+  }
+
+  std::shared_ptr<PersistentBuffer> fusion_buffer;
+  if (entries.size() > 1) {
+    MemcpyOutFusionBuffer(recvbuf, entries);
+    if (timeline.Initialized()) {
+      cuda_context_->RecordEvent(event_queue, MEMCPY_OUT_FUSION_BUFFER, *stream_);
+    }
+    fusion_buffer = global_state_->fusion_buffer.GetBuffer(
+        first_entry.device, first_entry.context->framework(),
+        global_state_->current_nccl_stream);
+  }
 
-    global_state_->controller->Bcast((void*)&nccl_id, sizeof(nccl_id), 0,
-                                     nccl_id_bcast_comm);
+  return cuda_context_->FinalizeAsync(event_queue, entries, *stream_, timeline,
+                                      fusion_buffer, nullptr);
+}
 
-    ncclComm_t new_nccl_comm;
-    auto nccl_result = ncclCommInitRank(&new_nccl_comm, nccl_size, nccl_id, nccl_rank);
-    nccl_context_->ErrorCheck("ncclCommInitRank", nccl_result);
-    nccl_comm = new_nccl_comm;
+bool NCCLReducescatter::Enabled(const ParameterManager& param_manager,
+                                const std::vector<TensorTableEntry>& entries,
+                                const Response& response) const {
+  return entries[0].device != CPU_DEVICE_ID;
+}
 
-    // Barrier helps NCCL to synchronize after initialization and avoid
-    // deadlock that we've been seeing without it.
-    global_state_->controller->Barrier(Communicator::GLOBAL);
+void NCCLReducescatter::MemcpyEntry(void* dst, const void* src, size_t size) {
+  cuda_context_->ErrorCheck(
+      "cudaMemcpyAsync",
+      cudaMemcpyAsync(dst, src, size, cudaMemcpyDeviceToDevice, *stream_));
+}
 
-    timeline.ActivityEndAll(entries);
+Status NCCLAllgather::Execute(std::vector<TensorTableEntry>& entries,
+                              const Response& response) {
+  auto& timeline = global_state_->timeline;
+  auto& first_entry = entries[0];
+
+  cuda_context_->ErrorCheck("cudaSetDevice", cudaSetDevice(first_entry.device));
+  stream_ = &cuda_context_->GetStream(global_state_->current_nccl_stream,
+                                      first_entry.device);
+  auto& nccl_comm = nccl_context_->GetGlobalComm(global_state_, entries, response.devices());
+
+  int rank = global_state_->controller->GetRank();
+  int size = global_state_->controller->GetSize();
+
+  int64_t** entry_component_sizes;
+  int64_t** entry_component_offsets;
+  int64_t* recvcounts;
+  int64_t* displcmnts;
+  GetScratchArrays(entries.size(), entry_component_sizes,
+                   entry_component_offsets, recvcounts, displcmnts);
+
+  timeline.ActivityStartAll(entries, ALLOCATE_OUTPUT);
+  Status status =
+      AllocateOutput(entries, response, entry_component_sizes, recvcounts);
+  if (!status.ok()) {
+    return status;
+  }
+  timeline.ActivityEndAll(entries);
+
+  SetDisplacements(recvcounts, displcmnts);
+  SetEntryComponentOffsets(entries, entry_component_sizes, recvcounts,
+                           entry_component_offsets);
+
+  int element_size =
+      global_state_->controller->GetTypeSize(first_entry.tensor->dtype());
+
+  std::queue<std::pair<std::string, cudaEvent_t>> event_queue;
+  if (timeline.Initialized()) {
+    cuda_context_->RecordEvent(event_queue, QUEUE, *stream_);
   }
 
-  nccl_comm_ = &nccl_comm;
+  // Fused entries are gathered in place, from the block of this rank.
+  const void* sendbuf;
+  void* buffer_data;
+  if (entries.size() > 1) {
+    MemcpyInFusionBuffer(entries, displcmnts, element_size, buffer_data);
+    sendbuf = (uint8_t*)buffer_data + (int64_t)displcmnts[rank] * element_size;
+    if (timeline.Initialized()) {
+      cuda_context_->RecordEvent(event_queue, MEMCPY_IN_FUSION_BUFFER, *stream_);
+    }
+  } else {
+    sendbuf = first_entry.tensor->data();
+    buffer_data = (void*)first_entry.output->data();
+  }
+
+  // Exchange bytes, so that any data type is supported.
+  bool even = std::all_of(recvcounts, recvcounts + size,
+                          [&](int64_t count) { return count == recvcounts[0]; });
+  if (even) {
+    nccl_context_->ErrorCheck(
+        "ncclAllGather",
+        ncclAllGather(sendbuf, buffer_data,
+                      (size_t)recvcounts[0] * element_size, ncclInt8,
+                      nccl_comm, *stream_));
+  } else {
+    nccl_context_->ErrorCheck("ncclGroupStart", ncclGroupStart());
+    for (int rc = 0; rc < size; ++rc) {
+      nccl_context_->ErrorCheck(
+          "ncclBroadcast",
+          ncclBroadcast(sendbuf,
+                        (uint8_t*)buffer_data +
+                            (int64_t)displcmnts[rc] * element_size,
+                        (size_t)recvcounts[rc] * element_size, ncclInt8, rc,
+                        nccl_comm, *stream_));
+    }
+    nccl_context_->ErrorCheck("ncclGroupEnd", ncclGroupEnd());
+  }
+  if (timeline.Initialized()) {
+    cuda_context_->RecordEvent(event_queue, NCCL_ALLGATHER, *stream_);
+  }
+
+  std::shared_ptr<PersistentBuffer> fusion_buffer;
+  if (entries.size() > 1) {
+    MemcpyOutFusionBuffer(entry_component_offsets, entry_component_sizes,
+                          buffer_data, element_size, entries);
+    if (timeline.Initialized()) {
+      cuda_context_->RecordEvent(event_queue, MEMCPY_OUT_FUSION_BUFFER, *stream_);
+    }
+    fusion_buffer = global_state_->fusion_buffer.GetBuffer(
+        first_entry.device, first_entry.context->framework(),
+        global_state_->current_nccl_stream);
+  }
+
+  return cuda_context_->FinalizeAsync(event_queue, entries, *stream_, timeline,
+                                      fusion_buffer, nullptr);
+}
+
+bool NCCLAllgather::Enabled(const ParameterManager& param_manager,
+                            const std::vector<TensorTableEntry>& entries,
+                            const Response& response) const {
+  return entries[0].device != CPU_DEVICE_ID;
+}
+
+void NCCLAllgather::MemcpyEntry(void* dst, const void* src, size_t size) {
+  cuda_context_->ErrorCheck(
+      "cudaMemcpyAsync",
+      cudaMemcpyAsync(dst, src, size, cudaMemcpyDeviceToDevice, *stream_));
+}
+
+Status NCCLHierarchicalAllgather::Execute(std::vector<TensorTableEntry>& entries,
+                                          const Response& response) {
+  auto& timeline = global_state_->timeline;
+  auto& first_entry = entries[0];
+  auto& controller = global_state_->controller;
+
+  cuda_context_->ErrorCheck("cudaSetDevice", cudaSetDevice(first_entry.device));
+  stream_ = &cuda_context_->GetStream(global_state_->current_nccl_stream,
+                                      first_entry.device);
+  auto& local_comm =
+      nccl_context_->GetLocalComm(global_state_, entries, response.devices());
+  auto& cross_comm =
+      nccl_context_->GetCrossComm(global_state_, entries, response.devices());
+
+  int rank = controller->GetRank();
+  int size = controller->GetSize();
+
+  int64_t** entry_component_sizes;
+  int64_t** entry_component_offsets;
+  int64_t* recvcounts;
+  int64_t* displcmnts;
+  GetScratchArrays(entries.size(), entry_component_sizes,
+                   entry_component_offsets, recvcounts, displcmnts);
+
+  timeline.ActivityStartAll(entries, ALLOCATE_OUTPUT);
+  Status status =
+      AllocateOutput(entries, response, entry_component_sizes, recvcounts);
+  if (!status.ok()) {
+    return status;
+  }
+  timeline.ActivityEndAll(entries);
+
+  SetDisplacements(recvcounts, displcmnts);
+  SetEntryComponentOffsets(entries, entry_component_sizes, recvcounts,
+                           entry_component_offsets);
+
+  int element_size = controller->GetTypeSize(first_entry.tensor->dtype());
+
+  std::queue<std::pair<std::string, cudaEvent_t>> event_queue;
+  if (timeline.Initialized()) {
+    cuda_context_->RecordEvent(event_queue, QUEUE, *stream_);
+  }
+
+  const void* sendbuf;
+  void* buffer_data;
+  if (entries.size() > 1) {
+    MemcpyInFusionBuffer(entries, displcmnts, element_size, buffer_data);
+    sendbuf = (uint8_t*)buffer_data + (int64_t)displcmnts[rank] * element_size;
+    if (timeline.Initialized()) {
+      cuda_context_->RecordEvent(event_queue, MEMCPY_IN_FUSION_BUFFER, *stream_);
+    }
+  } else {
+    sendbuf = first_entry.tensor->data();
+    buffer_data = (void*)first_entry.output->data();
+  }
+
+  // Gather the blocks of the ranks with the same local rank on all nodes,
+  // with one broadcast per node since blocks may differ in size.
+  auto& cross_comm_ranks = controller->GetCrossCommRanks();
+  nccl_context_->ErrorCheck("ncclGroupStart", ncclGroupStart());
+  for (int cr = 0; cr < (int)cross_comm_ranks.size(); ++cr) {
+    int rc = cross_comm_ranks[cr];
+    nccl_context_->ErrorCheck(
+        "ncclBroadcast",
+        ncclBroadcast(sendbuf,
+                      (uint8_t*)buffer_data +
+                          (int64_t)displcmnts[rc] * element_size,
+                      (size_t)recvcounts[rc] * element_size, ncclInt8, cr,
+                      cross_comm, *stream_));
+  }
+  nccl_context_->ErrorCheck("ncclGroupEnd", ncclGroupEnd());
+  if (timeline.Initialized()) {
+    cuda_context_->RecordEvent(event_queue, NCCL_CROSS_ALLGATHER, *stream_);
+  }
+
+  // Every block is now on the rank of its local rank on each node, which
+  // broadcasts it in place to the rest of the node.
+  auto& local_ranks = controller->GetLocalRanks();
+  nccl_context_->ErrorCheck("ncclGroupStart", ncclGroupStart());
+  for (int rc = 0; rc < size; ++rc) {
+    auto block = (uint8_t*)buffer_data + (int64_t)displcmnts[rc] * element_size;
+    nccl_context_->ErrorCheck(
+        "ncclBroadcast",
+        ncclBroadcast(block, block, (size_t)recvcounts[rc] * element_size,
+                      ncclInt8, local_ranks[rc], local_comm, *stream_));
+  }
+  nccl_context_->ErrorCheck("ncclGroupEnd", ncclGroupEnd());
+  if (timeline.Initialized()) {
+    cuda_context_->RecordEvent(event_queue, NCCL_BCAST, *stream_);
+  }
+
+  std::shared_ptr<PersistentBuffer> fusion_buffer;
+  if (entries.size() > 1) {
+    MemcpyOutFusionBuffer(entry_component_offsets, entry_component_sizes,
+                          buffer_data, element_size, entries);
+    if (timeline.Initialized()) {
+      cuda_context_->RecordEvent(event_queue, MEMCPY_OUT_FUSION_BUFFER, *stream_);
+    }
+    fusion_buffer = global_state_->fusion_buffer.GetBuffer(
+        first_entry.device, first_entry.context->framework(),
+        global_state_->current_nccl_stream);
+  }
+
+  return cuda_context_->FinalizeAsync(event_queue, entries, *stream_, timeline,
+                                      fusion_buffer, nullptr);
+}
+
+bool NCCLHierarchicalAllgather::Enabled(
+    const ParameterManager& param_manager,
+    const std::vector<TensorTableEntry>& entries,
+    const Response& response) const {
+  if (!NCCLAllgather::Enabled(param_manager, entries, response)) {
+    return false;
+  }
+  auto& controller = global_state_->controller;
+  return param_manager.HierarchicalAllgather() && controller->IsHomogeneous() &&
+         controller->GetLocalSize() > 1 && controller->GetCrossSize() > 1;
+}
+
+Status NCCLBroadcast::Execute(std::vector<TensorTableEntry>& entries,
+                              const Response& response) {
+  auto& timeline = global_state_->timeline;
+  auto& first_entry = entries[0];
+
+  cuda_context_->ErrorCheck("cudaSetDevice", cudaSetDevice(first_entry.device));
+  stream_ = &cuda_context_->GetStream(global_state_->current_nccl_stream,
+                                      first_entry.device);
+  auto& nccl_comm = nccl_context_->GetGlobalComm(global_state_, entries, response.devices());
+
+  bool is_root = global_state_->controller->GetRank() == first_entry.root_rank;
+
+  std::queue<std::pair<std::string, cudaEvent_t>> event_queue;
+  if (timeline.Initialized()) {
+    cuda_context_->RecordEvent(event_queue, QUEUE, *stream_);
+  }
+
+  // Fused entries are broadcast in place in the fusion buffer. A single
+  // entry is sent from the tensor of the root rank into the outputs.
+  const void* sendbuf;
+  void* recvbuf;
+  size_t buffer_len;
+  if (entries.size() > 1) {
+    void* buffer_data;
+    MemcpyInFusionBuffer(entries, buffer_data, buffer_len);
+    sendbuf = buffer_data;
+    recvbuf = buffer_data;
+    if (is_root && timeline.Initialized()) {
+      cuda_context_->RecordEvent(event_queue, MEMCPY_IN_FUSION_BUFFER, *stream_);
+    }
+  } else {
+    sendbuf = first_entry.tensor->data();
+    recvbuf = (void*)first_entry.output->data();
+    buffer_len = (size_t)first_entry.tensor->size();
+  }
+
+  // Broadcast bytes, so that any data type is supported.
+  nccl_context_->ErrorCheck(
+      "ncclBroadcast", ncclBroadcast(sendbuf, recvbuf, buffer_len, ncclInt8,
+                                     first_entry.root_rank, nccl_comm, *stream_));
+  if (timeline.Initialized()) {
+    cuda_context_->RecordEvent(event_queue, NCCL_BCAST, *stream_);
+  }
+
+  std::shared_ptr<PersistentBuffer> fusion_buffer;
+  if (entries.size() > 1) {
+    if (!is_root) {
+      MemcpyOutFusionBuffer(recvbuf, entries);
+      if (timeline.Initialized()) {
+        cuda_context_->RecordEvent(event_queue, MEMCPY_OUT_FUSION_BUFFER, *stream_);
+      }
+    }
+    fusion_buffer = global_state_->fusion_buffer.GetBuffer(
+        first_entry.device, first_entry.context->framework(),
+        global_state_->current_nccl_stream);
+  }
+
+  return cuda_context_->FinalizeAsync(event_queue, entries, *stream_, timeline,
+                                      fusion_buffer, nullptr);
+}
+
+bool NCCLBroadcast::Enabled(const ParameterManager& param_manager,
+                            const std::vector<TensorTableEntry>& entries,
+                            const Response& response) const {
+  return entries[0].device != CPU_DEVICE_ID;
+}
+
+void NCCLBroadcast::MemcpyEntry(void* dst, const void* src, size_t size) {
+  cuda_context_->ErrorCheck(
+      "cudaMemcpyAsync",
+      cudaMemcpyAsync(dst, src, size, cudaMemcpyDeviceToDevice, *stream_));
+}
+
+Status NCCLAlltoall::Execute(std::vector<TensorTableEntry>& entries,
+                             const Response& response) {
+#if NCCL_VERSION_CODE >= 2700
+  auto& timeline = global_state_->timeline;
+  auto& e = entries[0];
+
+  cuda_context_->ErrorCheck("cudaSetDevice", cudaSetDevice(e.device));
+  auto& stream =
+      cuda_context_->GetStream(global_state_->current_nccl_stream, e.device);
+  auto& nccl_comm = nccl_context_->GetGlobalComm(global_state_, entries, response.devices());
+
+  std::vector<int> sendcounts, sdispls, recvcounts, rdispls;
+  timeline.ActivityStartAll(entries, ALLOCATE_OUTPUT);
+  Status status =
+      AllocateOutput(e, response, sendcounts, sdispls, recvcounts, rdispls);
+  if (!status.ok()) {
+    return status;
+  }
+  timeline.ActivityEndAll(entries);
+
+  // Exchange bytes, so that any data type is supported.
+  int64_t element_size = global_state_->controller->GetTypeSize(e.tensor->dtype());
+  auto sendbuf = (const uint8_t*)e.tensor->data();
+  auto recvbuf = (uint8_t*)e.output->data();
+
+  std::queue<std::pair<std::string, cudaEvent_t>> event_queue;
+  if (timeline.Initialized()) {
+    cuda_context_->RecordEvent(event_queue, QUEUE, stream);
+  }
+
+  nccl_context_->ErrorCheck("ncclGroupStart", ncclGroupStart());
+  for (int rc = 0; rc < global_state_->controller->GetSize(); ++rc) {
+    nccl_context_->ErrorCheck(
+        "ncclSend", ncclSend(sendbuf + sdispls[rc] * element_size,
+                             (size_t)(sendcounts[rc] * element_size), ncclInt8,
+                             rc, nccl_comm, stream));
+    nccl_context_->ErrorCheck(
+        "ncclRecv", ncclRecv(recvbuf + rdispls[rc] * element_size,
+                             (size_t)(recvcounts[rc] * element_size), ncclInt8,
+                             rc, nccl_comm, stream));
+  }
+  nccl_context_->ErrorCheck("ncclGroupEnd", ncclGroupEnd());
+  if (timeline.Initialized()) {
+    cuda_context_->RecordEvent(event_queue, NCCL_ALLTOALL, stream);
+  }
+
+  return cuda_context_->FinalizeAsync(event_queue, entries, stream, timeline,
+                                      nullptr, nullptr);
+#else
+  throw std::logic_error("NCCL alltoall requires NCCL 2.7 or later.");
+#endif
 }
 
-void NCCLAllreduce::PopulateNCCLCommStrategy(int& nccl_rank, int& nccl_size,
-                                             Communicator& nccl_id_bcast_comm) {
-  nccl_rank = global_state_->controller->GetRank();
-  nccl_size = global_state_->controller->GetSize();
-  nccl_id_bcast_comm = Communicator::GLOBAL;
+bool NCCLAlltoall::Enabled(const ParameterManager& param_manager,
+                           const std::vector<TensorTableEntry>& entries,
+                           const Response& response) const {
+#if NCCL_VERSION_CODE >= 2700
+  return entries[0].device != CPU_DEVICE_ID;
+#else
+  return false;
+#endif
 }
 
 #if HAVE_MPI
@@ -152,38 +1034,27 @@ NCCLHierarchicalAllreduce::Execute(std::vector<TensorTableEntry>& entries,
                                    const Response& response) {
   auto& first_entry = entries[0];
 
-  // Determine GPU IDs of the devices participating in this communicator.
-  std::vector<int32_t> nccl_device_map;
-  nccl_device_map.reserve(
-      global_state_->controller->GetLocalCommRanks().size());
-  for (int rank : global_state_->controller->GetLocalCommRanks()) {
-    nccl_device_map.push_back(response.devices()[rank]);
-  }
-
   InitCUDA(entries);
-  InitNCCLComm(entries, nccl_device_map);
+  InitNCCLComm(entries, response);
   InitCUDAQueue(entries, response);
 
   const void* fused_input_data;
   void* buffer_data;
   size_t buffer_len;
 
-  // Copy memory into the fusion buffer.
-  if (entries.size() > 1) {
+  // Copy memory into the fusion buffer, unless the entries can be reduced
+  // directly.
+  int64_t num_elements = NumElements(entries);
+  bool use_fusion_buffer =
+      !GetDirectBuffers(entries, fused_input_data, buffer_data, buffer_len);
+  if (use_fusion_buffer) {
     MemcpyInFusionBuffer(entries, fused_input_data, buffer_data, buffer_len);
 
     if (global_state_->timeline.Initialized()) {
       cuda_context_->RecordEvent(event_queue_, MEMCPY_IN_FUSION_BUFFER, *stream_);
     }
   } else {
-    fused_input_data = first_entry.tensor->data();
-    buffer_data = (void*) first_entry.output->data();
-    buffer_len = (size_t) first_entry.output->size();
-  }
-
-  int64_t num_elements = 0;
-  for (auto& e : entries) {
-    num_elements += e.tensor->shape().num_elements();
+    PrescaleDirectBuffers(entries, fused_input_data, buffer_data, num_elements);
   }
 
   // Do allreduce.
@@ -191,53 +1062,56 @@ NCCLHierarchicalAllreduce::Execute(std::vector<TensorTableEntry>& entries,
   int local_size = global_state_->controller->GetLocalSize();
   int local_rank = global_state_->controller->GetLocalRank();
 
-  // If cluster is homogeneous and we are using fusion buffer, include
-  // dummy elements from the buffer (if necessary) to make sure the data
-  // is divisible by local_size. This is always possible since we
-  // set the fusion buffer size divisible by local_size.
-  if (global_state_->controller->IsHomogeneous() && entries.size() > 1) {
+  int shards = CrossShards();
+
+  // If we are using fusion buffer, include dummy elements from the buffer
+  // (if necessary) to make sure the data is divisible by the number of
+  // shards. This is always possible since we set the fusion buffer size
+  // divisible by the smallest local size.
+  if (use_fusion_buffer &&
+      (global_state_->controller->IsHomogeneous() || shards > 1)) {
     // Making sure the number of elements is divisible by
     // FUSION_BUFFER_ATOMIC_UNIT for improved performance
-    int div = local_size * FUSION_BUFFER_ATOMIC_UNIT;
+    int div = shards * FUSION_BUFFER_ATOMIC_UNIT;
     num_elements = ((num_elements + div - 1) / div) * div;
     buffer_len = num_elements * element_size;
   }
 
-  // Split the elements into two groups: num_elements_per_rank*local_size,
+  // Split the elements into two groups: num_elements_per_rank*shards,
   // and num_elements_remaining. Cross-node reduction for the first group
-  // is done by all local_rank's in parallel, while for the second group
-  // it it is only done by the root_rank. If the cluster is not
-  // homogeneous first group is zero, and root_rank is 0.
+  // is done by the first shards local_rank's in parallel, while for the
+  // second group it is only done by the root_rank.
 
-  // Homogeneous case:
+  // Homogeneous case (shards == local_size):
   // For the part of data divisible by local_size, perform NCCL
   // ReduceScatter - Parallelized MPI Allreduce - NCCL Allgather. For the
   // non-divisible part (if any), do NCCL Reduce (at rank local_size-1),
   // MPI Allreduce (across rank (local_size-1)'s), and NCCL Bcast
 
-  int64_t num_elements_per_rank = global_state_->controller->IsHomogeneous()
-                                      ? num_elements / local_size
-                                      : 0;
+  // Heterogeneous case (shards < local_size):
+  // Only the local ranks below the smallest local size exist on every node,
+  // so each of them gets a shard with a grouped NCCL Reduce, allreduces it
+  // across nodes and sends it back with a grouped NCCL Bcast.
+  bool scatter = shards == local_size;
+
+  int64_t num_elements_per_rank = num_elements / shards;
 
   size_t buffer_len_per_rank = element_size * num_elements_per_rank;
 
   void* buffer_data_at_rank_offset =
       (uint8_t*)buffer_data + buffer_len_per_rank * local_rank;
 
-  int64_t num_elements_remaining = global_state_->controller->IsHomogeneous()
-                                       ? num_elements % local_size
-                                       : num_elements;
+  int64_t num_elements_remaining = num_elements % shards;
 
   size_t buffer_len_remaining = element_size * num_elements_remaining;
 
   void* buffer_data_remainder =
-      (uint8_t*)buffer_data + buffer_len_per_rank * local_size;
+      (uint8_t*)buffer_data + buffer_len_per_rank * shards;
 
   void* fused_input_data_remainder =
-      (uint8_t*)fused_input_data + buffer_len_per_rank * local_size;
+      (uint8_t*)fused_input_data + buffer_len_per_rank * shards;
 
-  int root_rank =
-      global_state_->controller->IsHomogeneous() ? local_size - 1 : 0;
+  int root_rank = shards - 1;
   bool is_root_rank = local_rank == root_rank;
 
   int64_t total_num_elements =
@@ -248,16 +1122,61 @@ NCCLHierarchicalAllreduce::Execute(std::vector<TensorTableEntry>& entries,
                                  : buffer_len_per_rank;
 
   auto& timeline = global_state_->timeline;
-  if (num_elements_per_rank > 0) {
+
+  // Split the cross-node phase into chunks of FUSION_BUFFER_ATOMIC_UNIT
+  // multiples if requested and if there are at least two of them.
+  int64_t chunk_bytes =
+      global_state_->parameter_manager.HierarchicalAllreduceChunkBytes();
+  int64_t chunk_elements_per_rank =
+      std::max<int64_t>(chunk_bytes / (element_size * local_size) /
+                            FUSION_BUFFER_ATOMIC_UNIT * FUSION_BUFFER_ATOMIC_UNIT,
+                        FUSION_BUFFER_ATOMIC_UNIT);
+  if (PipelineCrossAllreduce(response) && scatter && chunk_bytes > 0 &&
+      num_elements_remaining == 0 &&
+      num_elements_per_rank > chunk_elements_per_rank) {
+    PipelinedAllreduce(entries, fused_input_data, buffer_data,
+                       num_elements_per_rank, chunk_elements_per_rank,
+                       element_size);
+
+    // Copy memory out of the fusion buffer.
+    if (use_fusion_buffer) {
+      MemcpyOutFusionBuffer(buffer_data, entries);
+
+      if (global_state_->timeline.Initialized()) {
+        cuda_context_->RecordEvent(event_queue_, MEMCPY_OUT_FUSION_BUFFER, *stream_);
+      }
+    } else {
+      PostscaleDirectBuffers(entries, buffer_data, num_elements);
+    }
+
+    return FinalizeCUDAQueue(entries);
+  }
+
+  if (num_elements_per_rank > 0 && scatter) {
     auto nccl_result = ncclReduceScatter(fused_input_data,
                                          buffer_data_at_rank_offset,
                                          (size_t) num_elements_per_rank,
                                          GetNCCLDataType(first_entry.tensor),
-                                         ncclSum, *nccl_comm_, *stream_);
+                                         LocalRedOp(first_entry),
+                                         *nccl_comm_, *stream_);
     nccl_context_->ErrorCheck("ncclReduceScatter", nccl_result);
     if (global_state_->timeline.Initialized()) {
       cuda_context_->RecordEvent(event_queue_, NCCL_REDUCESCATTER, *stream_);
     }
+  } else if (num_elements_per_rank > 0) {
+    nccl_context_->ErrorCheck("ncclGroupStart", ncclGroupStart());
+    for (int shard = 0; shard < shards; ++shard) {
+      auto nccl_result = ncclReduce(
+          (const uint8_t*)fused_input_data + buffer_len_per_rank * shard,
+          (uint8_t*)buffer_data + buffer_len_per_rank * shard,
+          (size_t) num_elements_per_rank, GetNCCLDataType(first_entry.tensor),
+          LocalRedOp(first_entry), shard, *nccl_comm_, *stream_);
+      nccl_context_->ErrorCheck("ncclReduce", nccl_result);
+    }
+    nccl_context_->ErrorCheck("ncclGroupEnd", ncclGroupEnd());
+    if (global_state_->timeline.Initialized()) {
+      cuda_context_->RecordEvent(event_queue_, NCCL_REDUCE, *stream_);
+    }
   }
 
   if (num_elements_remaining > 0) {
@@ -266,7 +1185,8 @@ NCCLHierarchicalAllreduce::Execute(std::vector<TensorTableEntry>& entries,
     auto nccl_result = ncclReduce(fused_input_data_remainder,
                                   buffer_data_remainder,
                                   (size_t) num_elements_remaining,
-                                  GetNCCLDataType(first_entry.tensor), ncclSum,
+                                  GetNCCLDataType(first_entry.tensor),
+                                  LocalRedOp(first_entry),
                                   root_rank, *nccl_comm_, *stream_);
     nccl_context_->ErrorCheck("ncclReduce", nccl_result);
     if (global_state_->timeline.Initialized()) {
@@ -274,35 +1194,29 @@ NCCLHierarchicalAllreduce::Execute(std::vector<TensorTableEntry>& entries,
     }
   }
 
-  if (global_state_->controller->IsHomogeneous() || is_root_rank) {
-    // cudaHostAlloc is significantly slower than malloc.  Pre-allocating
-    // a buffer is not safe since the tensor can be arbitrarily large.
-    host_buffer_ = malloc(total_buffer_len);
+  if (local_rank < shards) {
+    // The buffer goes back to the pool once the finalizer thread is done.
+    cuda_context_->ErrorCheck(
+        "HostBufferPool::Acquire",
+        cuda_context_->host_buffers.Acquire(total_buffer_len, &host_buffer_));
 
     // Synchronize.
     cuda_context_->WaitForEvents(event_queue_, entries, timeline);
 
-    // According to https://docs.nvidia.com/cuda/cuda-runtime-api/
-    // api-sync-behavior.html#api-sync-behavior__memcpy-async,
-    // cudaMemcpyAsync is synchronous with respect to the host, so we
-    // memcpy (effectively) synchronously to generate an accurate timeline
+    // Copies to pinned memory are asynchronous with respect to the host, so
+    // wait for the copy before MPI reads the buffer. This also keeps the
+    // timeline accurate.
     timeline.ActivityStartAll(entries, MEMCPY_IN_HOST_BUFFER);
     cuda_context_->ErrorCheck("cudaMemcpyAsync",
                               cudaMemcpyAsync(host_buffer_, buffer_data_at_rank_offset,
                                               total_buffer_len, cudaMemcpyDeviceToHost,
                                               *stream_));
+    cuda_context_->ErrorCheck("cudaStreamSynchronize",
+                              cudaStreamSynchronize(*stream_));
     timeline.ActivityEndAll(entries);
 
-    timeline.ActivityStartAll(entries, MPI_ALLREDUCE);
-    int op = MPI_Allreduce(MPI_IN_PLACE, host_buffer_,
-                           (int) total_num_elements,
-                           mpi_context_->GetMPIDataType(first_entry.tensor),
-                           mpi_context_->GetMPISumOp(first_entry.tensor->dtype()),
-                           mpi_context_->GetMPICommunicator(Communicator::CROSS));
-    if (op != MPI_SUCCESS) {
-      throw std::runtime_error("MPI_Allreduce failed, see MPI output for details.");
-    }
-    timeline.ActivityEndAll(entries);
+    CrossAllreduce(entries, host_buffer_, total_num_elements,
+                   num_elements_per_rank * local_rank);
 
     timeline.ActivityStartAll(entries, MEMCPY_OUT_HOST_BUFFER);
     cuda_context_->ErrorCheck("cudaMemcpyAsync",
@@ -312,7 +1226,7 @@ NCCLHierarchicalAllreduce::Execute(std::vector<TensorTableEntry>& entries,
     timeline.ActivityEndAll(entries);
   }
 
-  if (num_elements_per_rank > 0) {
+  if (num_elements_per_rank > 0 && scatter) {
     nccl_context_->ErrorCheck("ncclAllGather",
                               ncclAllGather(buffer_data_at_rank_offset, buffer_data,
                                             (size_t) num_elements_per_rank,
@@ -321,6 +1235,20 @@ NCCLHierarchicalAllreduce::Execute(std::vector<TensorTableEntry>& entries,
     if (global_state_->timeline.Initialized()) {
       cuda_context_->RecordEvent(event_queue_, NCCL_ALLGATHER, *stream_);
     }
+  } else if (num_elements_per_rank > 0) {
+    nccl_context_->ErrorCheck("ncclGroupStart", ncclGroupStart());
+    for (int shard = 0; shard < shards; ++shard) {
+      nccl_context_->ErrorCheck(
+          "ncclBcast",
+          ncclBcast((uint8_t*)buffer_data + buffer_len_per_rank * shard,
+                    (size_t) num_elements_per_rank,
+                    GetNCCLDataType(first_entry.tensor), shard, *nccl_comm_,
+                    *stream_));
+    }
+    nccl_context_->ErrorCheck("ncclGroupEnd", ncclGroupEnd());
+    if (global_state_->timeline.Initialized()) {
+      cuda_context_->RecordEvent(event_queue_, NCCL_BCAST, *stream_);
+    }
   }
   if (num_elements_remaining > 0) {
     nccl_context_->ErrorCheck("ncclBcast",
@@ -334,17 +1262,157 @@ NCCLHierarchicalAllreduce::Execute(std::vector<TensorTableEntry>& entries,
   }
 
   // Copy memory out of the fusion buffer.
-  if (entries.size() > 1) {
+  if (use_fusion_buffer) {
     MemcpyOutFusionBuffer(buffer_data, entries);
 
     if (global_state_->timeline.Initialized()) {
       cuda_context_->RecordEvent(event_queue_, MEMCPY_OUT_FUSION_BUFFER, *stream_);
     }
+  } else {
+    PostscaleDirectBuffers(entries, buffer_data, num_elements);
   }
 
   return FinalizeCUDAQueue(entries);
 }
 
+void NCCLHierarchicalAllreduce::CrossAllreduce(
+    const std::vector<TensorTableEntry>& entries, void* host_data,
+    int64_t num_elements, int64_t element_offset) {
+  auto& first_entry = entries[0];
+  auto& timeline = global_state_->timeline;
+  timeline.ActivityStartAll(entries, MPI_ALLREDUCE);
+  int op = MPILargeAllreduce(MPI_IN_PLACE, host_data, num_elements,
+                             mpi_context_->GetMPIDataType(first_entry.tensor),
+                             mpi_context_->GetMPIOp(first_entry.tensor->dtype(),
+                                                    first_entry.reduce_op),
+                             mpi_context_->GetMPICommunicator(Communicator::CROSS));
+  if (op != MPI_SUCCESS) {
+    throw std::runtime_error("MPI_Allreduce failed, see MPI output for details.");
+  }
+  timeline.ActivityEndAll(entries);
+}
+
+bool NCCLHierarchicalAllreduce::PipelineCrossAllreduce(
+    const Response& response) const {
+  return true;
+}
+
+int NCCLHierarchicalAllreduce::CrossShards() const {
+  auto& controller = global_state_->controller;
+  return controller->IsHomogeneous() ? controller->GetLocalSize()
+                                     : controller->GetMinLocalSize();
+}
+
+ncclRedOp_t NCCLHierarchicalAllreduce::LocalRedOp(
+    const TensorTableEntry& first_entry) const {
+  return GetNCCLRedOp(first_entry.reduce_op);
+}
+
+void NCCLHierarchicalAllreduce::PipelinedAllreduce(
+    const std::vector<TensorTableEntry>& entries, const void* fused_input_data,
+    void* buffer_data, int64_t num_elements_per_rank,
+    int64_t chunk_elements_per_rank, int element_size) {
+  auto& first_entry = entries[0];
+  auto& timeline = global_state_->timeline;
+  int local_size = global_state_->controller->GetLocalSize();
+  int local_rank = global_state_->controller->GetLocalRank();
+  auto nccl_data_type = GetNCCLDataType(first_entry.tensor);
+
+  // Host transfers run on a separate stream so that they do not wait behind
+  // the NCCL operations queued for later chunks.
+  cudaStream_t& copy_stream =
+      cuda_context_->copy_streams[global_state_->current_nccl_stream][first_entry.device];
+  if (copy_stream == nullptr) {
+    cuda_context_->ErrorCheck("cudaStreamCreateWithFlags",
+                              cudaStreamCreateWithFlags(&copy_stream, cudaStreamNonBlocking));
+  }
+
+  int64_t num_chunks =
+      (num_elements_per_rank + chunk_elements_per_rank - 1) / chunk_elements_per_rank;
+  cuda_context_->ErrorCheck(
+      "HostBufferPool::Acquire",
+      cuda_context_->host_buffers.Acquire(element_size * num_elements_per_rank,
+                                          &host_buffer_));
+
+  // Synchronize, so that the host activities below do not interleave with
+  // the ones recorded so far.
+  cuda_context_->WaitForEvents(event_queue_, entries, timeline);
+
+  // Chunk k covers elements [k * chunk_elements_per_rank, ...) of every
+  // rank's shard, which are laid out consecutively in the buffer.
+  auto chunk_elements = [&](int64_t k) {
+    return std::min(chunk_elements_per_rank,
+                    num_elements_per_rank - k * chunk_elements_per_rank);
+  };
+  auto chunk_offset = [&](int64_t k) {
+    return k * chunk_elements_per_rank * local_size * element_size;
+  };
+
+  // Queue all reduce-scatters up front, the GPU works through them while
+  // the host is busy with the network transfers.
+  std::vector<cudaEvent_t> chunk_events((size_t)num_chunks);
+  for (int64_t k = 0; k < num_chunks; ++k) {
+    int64_t count = chunk_elements(k);
+    nccl_context_->ErrorCheck(
+        "ncclReduceScatter",
+        ncclReduceScatter((uint8_t*)fused_input_data + chunk_offset(k),
+                          (uint8_t*)buffer_data + chunk_offset(k) +
+                              count * local_rank * element_size,
+                          (size_t)count, nccl_data_type,
+                          LocalRedOp(first_entry), *nccl_comm_,
+                          *stream_));
+    cuda_context_->ErrorCheck("GetCudaEvent",
+                              cuda_context_->GetCudaEvent(&chunk_events[k]));
+    cuda_context_->ErrorCheck("cudaEventRecord",
+                              cudaEventRecord(chunk_events[k], *stream_));
+  }
+
+  timeline.ActivityStartAll(entries, MPI_ALLREDUCE);
+  for (int64_t k = 0; k < num_chunks; ++k) {
+    int64_t count = chunk_elements(k);
+    size_t chunk_len = count * element_size;
+    void* chunk_data = (uint8_t*)buffer_data + chunk_offset(k);
+    void* shard_data = (uint8_t*)chunk_data + chunk_len * local_rank;
+    void* host_data = (uint8_t*)host_buffer_ + k * chunk_elements_per_rank * element_size;
+
+    cuda_context_->ErrorCheck("cudaStreamWaitEvent",
+                              cudaStreamWaitEvent(copy_stream, chunk_events[k], 0));
+    cuda_context_->ErrorCheck("cudaMemcpyAsync",
+                              cudaMemcpyAsync(host_data, shard_data, chunk_len,
+                                              cudaMemcpyDeviceToHost, copy_stream));
+    cuda_context_->ErrorCheck("cudaStreamSynchronize",
+                              cudaStreamSynchronize(copy_stream));
+
+    int op = MPILargeAllreduce(MPI_IN_PLACE, host_data, count,
+                               mpi_context_->GetMPIDataType(first_entry.tensor),
+                               mpi_context_->GetMPIOp(first_entry.tensor->dtype(),
+                                                      first_entry.reduce_op),
+                               mpi_context_->GetMPICommunicator(Communicator::CROSS));
+    if (op != MPI_SUCCESS) {
+      throw std::runtime_error("MPI_Allreduce failed, see MPI output for details.");
+    }
+
+    // The event is reused to order the allgather after the copy back.
+    cuda_context_->ErrorCheck("cudaMemcpyAsync",
+                              cudaMemcpyAsync(shard_data, host_data, chunk_len,
+                                              cudaMemcpyHostToDevice, copy_stream));
+    cuda_context_->ErrorCheck("cudaEventRecord",
+                              cudaEventRecord(chunk_events[k], copy_stream));
+    cuda_context_->ErrorCheck("cudaStreamWaitEvent",
+                              cudaStreamWaitEvent(*stream_, chunk_events[k], 0));
+    nccl_context_->ErrorCheck("ncclAllGather",
+                              ncclAllGather(shard_data, chunk_data, (size_t) count,
+                                            nccl_data_type, *nccl_comm_, *stream_));
+    cuda_context_->ErrorCheck("ReleaseCudaEvent",
+                              cuda_context_->ReleaseCudaEvent(chunk_events[k]));
+  }
+  timeline.ActivityEndAll(entries);
+
+  if (global_state_->timeline.Initialized()) {
+    cuda_context_->RecordEvent(event_queue_, NCCL_ALLGATHER, *stream_);
+  }
+}
+
 bool NCCLHierarchicalAllreduce::Enabled(const ParameterManager& param_manager,
                                         const std::vector<TensorTableEntry>& entries,
                                         const Response& response) const {
@@ -354,11 +1422,60 @@ bool NCCLHierarchicalAllreduce::Enabled(const ParameterManager& param_manager,
   return param_manager.HierarchicalAllreduce();
 }
 
-void NCCLHierarchicalAllreduce::PopulateNCCLCommStrategy(int& nccl_rank, int& nccl_size,
-                                                         Communicator& nccl_id_bcast_comm) {
-  nccl_rank = global_state_->controller->GetLocalRank();
-  nccl_size = global_state_->controller->GetLocalSize();
-  nccl_id_bcast_comm = Communicator::LOCAL;
+void NCCLHierarchicalAllreduce::InitNCCLComm(
+    const std::vector<TensorTableEntry>& entries, const Response& response) {
+  nccl_comm_ =
+      &nccl_context_->GetLocalComm(global_state_, entries, response.devices());
+}
+
+AdasumNCCLHierarchicalAllreduce::AdasumNCCLHierarchicalAllreduce(
+    NCCLContext* nccl_context, MPIContext* mpi_context,
+    CUDAContext* cuda_context, HorovodGlobalState* global_state)
+    : NCCLHierarchicalAllreduce(nccl_context, mpi_context, cuda_context,
+                                global_state),
+      adasum_(mpi_context, global_state) {}
+
+bool AdasumNCCLHierarchicalAllreduce::Enabled(
+    const ParameterManager& param_manager,
+    const std::vector<TensorTableEntry>& entries,
+    const Response& response) const {
+  return response.reduce_op() == ReduceOp::ADASUM &&
+         NCCLAllreduce::Enabled(param_manager, entries, response);
+}
+
+void AdasumNCCLHierarchicalAllreduce::CrossAllreduce(
+    const std::vector<TensorTableEntry>& entries, void* host_data,
+    int64_t num_elements, int64_t element_offset) {
+  // On a homogeneous cluster every local rank holds a shard of the node sum,
+  // and the coefficients of each tensor come from its norms over all shards.
+  auto& controller = global_state_->controller;
+  Communicator local = Communicator::LOCAL;
+  bool sharded = controller->IsHomogeneous() && controller->GetLocalSize() > 1;
+
+  auto& timeline = global_state_->timeline;
+  timeline.ActivityStartAll(entries, ADASUM_ALLREDUCE);
+  adasum_.Allreduce(host_data, num_elements, entries[0].tensor->dtype(),
+                    AdasumTensorEnds(entries), element_offset,
+                    Communicator::CROSS, sharded ? &local : nullptr);
+  timeline.ActivityEndAll(entries);
+}
+
+bool AdasumNCCLHierarchicalAllreduce::PipelineCrossAllreduce(
+    const Response& response) const {
+  // Chunks would be combined with coefficients of their own.
+  return false;
+}
+
+int AdasumNCCLHierarchicalAllreduce::CrossShards() const {
+  // The norms of the shards are combined over the local communicator, which
+  // the local ranks without a shard would not join.
+  auto& controller = global_state_->controller;
+  return controller->IsHomogeneous() ? controller->GetLocalSize() : 1;
+}
+
+ncclRedOp_t AdasumNCCLHierarchicalAllreduce::LocalRedOp(
+    const TensorTableEntry& first_entry) const {
+  return ncclSum;
 }
 #endif
 } // namespace common
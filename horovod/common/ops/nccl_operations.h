@@ -17,10 +17,13 @@
 #ifndef HOROVOD_NCCL_OPERATIONS_H
 #define HOROVOD_NCCL_OPERATIONS_H
 
+#include <mutex>
+
 #include <nccl.h>
 
 #if HAVE_MPI
 #include "../mpi/mpi_context.h"
+#include "adasum_operations.h"
 #endif
 
 #include "cuda_operations.h"
@@ -29,12 +32,109 @@ namespace horovod {
 namespace common {
 
 ncclDataType_t GetNCCLDataType(const std::shared_ptr<Tensor> tensor);
+ncclRedOp_t GetNCCLRedOp(ReduceOp reduce_op);
 
 struct NCCLContext {
+  // Node-local communicators of hierarchical allreduce, keyed by the devices
+  // of all ranks, one map per NCCL stream.
   std::vector<std::unordered_map<std::vector<int32_t>, ncclComm_t>> nccl_comms;
 
+  // Communicators spanning all ranks, keyed by the devices of all ranks, one
+  // map per NCCL stream.
+  std::vector<std::unordered_map<std::vector<int32_t>, ncclComm_t>> global_comms;
+
+  // Communicators between the ranks of the same local rank on all nodes,
+  // keyed by the devices of all ranks, one map per NCCL stream.
+  std::vector<std::unordered_map<std::vector<int32_t>, ncclComm_t>> cross_comms;
+
   void ErrorCheck(std::string op_name, ncclResult_t nccl_result);
 
+  // Creates the communicators of the given NCCL streams for the devices at
+  // once. The unique IDs are broadcast from nccl_rank zero over
+  // nccl_id_bcast_comm in a single message and the communicators are
+  // initialized in one NCCL group, so that several streams cost one
+  // initialization.
+  void InitComms(
+      std::vector<std::unordered_map<std::vector<int32_t>, ncclComm_t>>& comms,
+      HorovodGlobalState* global_state,
+      const std::vector<TensorTableEntry>& entries,
+      const std::vector<int32_t>& devices, int nccl_rank, int nccl_size,
+      Communicator nccl_id_bcast_comm, const std::vector<int>& streams);
+
+#if NCCL_VERSION_CODE >= 21800
+  // Derives the communicators of the given NCCL streams for the devices of
+  // all ranks by splitting their global communicators, which must exist,
+  // instead of bootstrapping new ones.
+  void SplitComms(
+      std::vector<std::unordered_map<std::vector<int32_t>, ncclComm_t>>& comms,
+      HorovodGlobalState* global_state,
+      const std::vector<TensorTableEntry>& entries,
+      const std::vector<int32_t>& devices, int color, int key,
+      const std::vector<int>& streams);
+#endif
+
+  // Whether the communicators spanning all ranks exist for the devices on
+  // every NCCL stream the background thread may pick.
+  bool HasGlobalComms(const HorovodGlobalState* global_state,
+                      const std::vector<int32_t>& devices) const;
+
+  // Returns the communicator spanning all ranks for the devices of the
+  // response on the current NCCL stream, creating it on first use. All ranks
+  // pick the same streams, so they create the communicators of a stream
+  // together once it comes into use.
+  ncclComm_t& GetGlobalComm(HorovodGlobalState* global_state,
+                            const std::vector<TensorTableEntry>& entries,
+                            const std::vector<int32_t>& devices);
+
+  // Returns the node-local and the cross-node communicator for the devices
+  // of all ranks on the current NCCL stream, creating it on first use. With NCCL 2.18 and later they are split from the global
+  // communicator when that one exists.
+  ncclComm_t& GetLocalComm(HorovodGlobalState* global_state,
+                           const std::vector<TensorTableEntry>& entries,
+                           const std::vector<int32_t>& devices);
+  ncclComm_t& GetCrossComm(HorovodGlobalState* global_state,
+                           const std::vector<TensorTableEntry>& entries,
+                           const std::vector<int32_t>& devices);
+
+  // Creates the global communicators of the NCCL streams in use at start-up,
+  // those of streams the autotuner adds later being created on first use,
+  // for the common layout where
+  // every rank drives the GPU of its local rank, or the only GPU it sees, so
+  // that the first step does not stall on initialization. Does nothing with a
+  // warning when the layout does not hold on all ranks.
+  void InitGlobalCommsEagerly(HorovodGlobalState* global_state);
+
+  // Creates capture_comm over the devices that InitGlobalCommsEagerly would
+  // use, with a warning if the layout does not hold.
+  void InitCaptureComm(HorovodGlobalState* global_state);
+
+  // Allreduces the tensors of the entries into their outputs on stream, from
+  // the calling thread and over capture_comm. Entries are packed into
+  // capture_buffer with the batched kernels when there are several. Only
+  // device work is enqueued, so the calls can be captured in a CUDA graph.
+  // There is no negotiation: all ranks must make the same calls in the same
+  // order. The buffer only grows outside of capture, so the first call for
+  // a group of tensors must not be captured.
+  Status CapturableAllreduce(std::vector<TensorTableEntry>& entries,
+                             cudaStream_t stream);
+
+  // Body of CapturableAllreduce, with capture_device current.
+  Status CapturableAllreduceOnDevice(std::vector<TensorTableEntry>& entries,
+                                     cudaStream_t stream);
+
+  // Communicator of the graph-capturable allreduces, separate from those of
+  // the background thread so that both can run at the same time, and the
+  // device it was created for, or -1.
+  ncclComm_t capture_comm = nullptr;
+  int capture_device = -1;
+
+  // Fusion buffer of the graph-capturable allreduces on capture_device. It
+  // stays at the same address, which captured graphs refer to, unless a
+  // larger group is allreduced outside of capture.
+  void* capture_buffer = nullptr;
+  size_t capture_buffer_bytes = 0;
+  std::mutex capture_mutex;
+
   void ShutDown();
 };
 
@@ -48,17 +148,130 @@ public:
   Status Execute(std::vector<TensorTableEntry>& entries,
                  const Response& response) override;
 
+  bool WaitsForReadyEvents() const override { return true; }
+
 protected:
-  void InitNCCLComm(const std::vector<TensorTableEntry>& entries,
-                    const std::vector<int32_t>& nccl_device_map);
+  // Sets nccl_comm_ to the communicator used for the response.
+  virtual void InitNCCLComm(const std::vector<TensorTableEntry>& entries,
+                            const Response& response);
 
-  virtual void PopulateNCCLCommStrategy(int& nccl_rank, int& nccl_size,
-                                        Communicator& nccl_id_bcast_comm);
+  // Whether the scale factors of the entries average floating point values,
+  // which ncclAvg does within the collective.
+  bool UseNCCLAvg(const std::vector<TensorTableEntry>& entries) const;
 
   NCCLContext* nccl_context_;
   ncclComm_t* nccl_comm_;
 };
 
+class NCCLReducescatter : public ReducescatterOp {
+public:
+  NCCLReducescatter(NCCLContext* nccl_context, CUDAContext* cuda_context,
+                    HorovodGlobalState* global_state)
+      : ReducescatterOp(global_state), nccl_context_(nccl_context),
+        cuda_context_(cuda_context){};
+
+  Status Execute(std::vector<TensorTableEntry>& entries,
+                 const Response& response) override;
+
+  bool Enabled(const ParameterManager& param_manager,
+               const std::vector<TensorTableEntry>& entries,
+               const Response& response) const override;
+
+protected:
+  void MemcpyEntry(void* dst, const void* src, size_t size) override;
+
+  NCCLContext* nccl_context_;
+  CUDAContext* cuda_context_;
+  cudaStream_t* stream_;
+};
+
+// Gathers with ncclAllGather when all ranks send the same number of
+// elements, and with one grouped ncclBroadcast per rank otherwise, since
+// ncclAllGather needs equal blocks.
+class NCCLAllgather : public AllgatherOp {
+public:
+  NCCLAllgather(NCCLContext* nccl_context, CUDAContext* cuda_context,
+                HorovodGlobalState* global_state)
+      : AllgatherOp(global_state), nccl_context_(nccl_context),
+        cuda_context_(cuda_context){};
+
+  Status Execute(std::vector<TensorTableEntry>& entries,
+                 const Response& response) override;
+
+  bool Enabled(const ParameterManager& param_manager,
+               const std::vector<TensorTableEntry>& entries,
+               const Response& response) const override;
+
+protected:
+  void MemcpyEntry(void* dst, const void* src, size_t size) override;
+
+  NCCLContext* nccl_context_;
+  CUDAContext* cuda_context_;
+  cudaStream_t* stream_;
+};
+
+// Gathers GPU tensors in two steps on a homogeneous cluster. Each local rank
+// first gathers the blocks of the same local rank of all nodes over the
+// cross-node communicator, and then broadcasts them to the other ranks of its
+// node. Every block crosses the network once per node, over the NICs of all
+// local ranks, and is copied between the GPUs of a node by NCCL.
+class NCCLHierarchicalAllgather : public NCCLAllgather {
+public:
+  NCCLHierarchicalAllgather(NCCLContext* nccl_context,
+                            CUDAContext* cuda_context,
+                            HorovodGlobalState* global_state)
+      : NCCLAllgather(nccl_context, cuda_context, global_state){};
+
+  Status Execute(std::vector<TensorTableEntry>& entries,
+                 const Response& response) override;
+
+  bool Enabled(const ParameterManager& param_manager,
+               const std::vector<TensorTableEntry>& entries,
+               const Response& response) const override;
+};
+
+class NCCLBroadcast : public BroadcastOp {
+public:
+  NCCLBroadcast(NCCLContext* nccl_context, CUDAContext* cuda_context,
+                HorovodGlobalState* global_state)
+      : BroadcastOp(global_state), nccl_context_(nccl_context),
+        cuda_context_(cuda_context){};
+
+  Status Execute(std::vector<TensorTableEntry>& entries,
+                 const Response& response) override;
+
+  bool Enabled(const ParameterManager& param_manager,
+               const std::vector<TensorTableEntry>& entries,
+               const Response& response) const override;
+
+protected:
+  void MemcpyEntry(void* dst, const void* src, size_t size) override;
+
+  NCCLContext* nccl_context_;
+  CUDAContext* cuda_context_;
+  cudaStream_t* stream_;
+};
+
+// Requires point-to-point send and receive, available since NCCL 2.7.
+class NCCLAlltoall : public AlltoallOp {
+public:
+  NCCLAlltoall(NCCLContext* nccl_context, CUDAContext* cuda_context,
+               HorovodGlobalState* global_state)
+      : AlltoallOp(global_state), nccl_context_(nccl_context),
+        cuda_context_(cuda_context){};
+
+  Status Execute(std::vector<TensorTableEntry>& entries,
+                 const Response& response) override;
+
+  bool Enabled(const ParameterManager& param_manager,
+               const std::vector<TensorTableEntry>& entries,
+               const Response& response) const override;
+
+protected:
+  NCCLContext* nccl_context_;
+  CUDAContext* cuda_context_;
+};
+
 #if HAVE_MPI
 class NCCLHierarchicalAllreduce : public NCCLAllreduce {
 public:
@@ -75,12 +288,70 @@ public:
                const std::vector<TensorTableEntry>& entries,
                const Response& response) const override;
 
+protected:
+  // Allreduces the num_elements values at host_data, which start at element
+  // element_offset of the buffer, across nodes over the CROSS communicator.
+  virtual void CrossAllreduce(const std::vector<TensorTableEntry>& entries,
+                              void* host_data, int64_t num_elements,
+                              int64_t element_offset);
+
+  // Whether the cross-node phase may be split into chunks.
+  virtual bool PipelineCrossAllreduce(const Response& response) const;
+
+  // Number of local ranks that each allreduce a shard of the node's data
+  // across nodes: all of them on a homogeneous cluster, and the ones below
+  // the smallest local size, which every node has, otherwise.
+  virtual int CrossShards() const;
+
+  // Reduction of the node-local NCCL phases.
+  virtual ncclRedOp_t LocalRedOp(const TensorTableEntry& first_entry) const;
+
 private:
-  void PopulateNCCLCommStrategy(int& nccl_rank, int& nccl_size,
-                                Communicator& nccl_id_bcast_comm) override;
+  // Uses the node-local communicator for the devices of the local ranks.
+  void InitNCCLComm(const std::vector<TensorTableEntry>& entries,
+                    const Response& response) override;
+
+  // Performs ReduceScatter, cross-node MPI_Allreduce and Allgather chunk by
+  // chunk, so that the network transfer of one chunk overlaps with the NCCL
+  // phases of the neighbouring chunks. Only used when the number of elements
+  // is divisible by local_size.
+  void PipelinedAllreduce(const std::vector<TensorTableEntry>& entries,
+                          const void* fused_input_data, void* buffer_data,
+                          int64_t num_elements_per_rank,
+                          int64_t chunk_elements_per_rank, int element_size);
 
   MPIContext* mpi_context_;
 };
+
+// Allreduces GPU tensors with Adasum on top of the hierarchical allreduce:
+// the tensors are summed within each node with NCCL, and the node sums are
+// combined across nodes with Adasum on the host copy of the shards.
+class AdasumNCCLHierarchicalAllreduce : public NCCLHierarchicalAllreduce {
+public:
+  AdasumNCCLHierarchicalAllreduce(NCCLContext* nccl_context,
+                                  MPIContext* mpi_context,
+                                  CUDAContext* cuda_context,
+                                  HorovodGlobalState* global_state);
+
+  bool Enabled(const ParameterManager& param_manager,
+               const std::vector<TensorTableEntry>& entries,
+               const Response& response) const override;
+
+protected:
+  void CrossAllreduce(const std::vector<TensorTableEntry>& entries,
+                      void* host_data, int64_t num_elements,
+                      int64_t element_offset) override;
+
+  bool PipelineCrossAllreduce(const Response& response) const override;
+
+  int CrossShards() const override;
+
+  // Adasum is only applied across nodes, the ranks of a node are summed.
+  ncclRedOp_t LocalRedOp(const TensorTableEntry& first_entry) const override;
+
+private:
+  AdasumMPI adasum_;
+};
 #endif
 
 } // namespace common
@@ -15,27 +15,166 @@
 
 #include "operation_manager.h"
 
+#include <chrono>
+#include <cxxabi.h>
+#include <cstdlib>
+#include <typeinfo>
+
 namespace horovod {
 namespace common {
 
+namespace {
+
+// Class name of op, without the namespace, which is the same for all of them.
+std::string OperationName(const HorovodOp& op) {
+  const char* mangled = typeid(op).name();
+  int status = 0;
+  char* demangled = abi::__cxa_demangle(mangled, nullptr, nullptr, &status);
+  std::string name = status == 0 ? demangled : mangled;
+  std::free(demangled);
+  auto pos = name.rfind("::");
+  return pos == std::string::npos ? name : name.substr(pos + 2);
+}
+
+} // namespace
+
 OperationManager::OperationManager(ParameterManager* param_manager,
+                                   Metrics* metrics,
                                    std::vector<std::shared_ptr<AllreduceOp>> allreduce_ops,
+                                   std::vector<std::shared_ptr<AllreduceOp>> adasum_ops,
                                    std::vector<std::shared_ptr<AllgatherOp>> allgather_ops,
                                    std::vector<std::shared_ptr<BroadcastOp>> broadcast_ops,
+                                   std::vector<std::shared_ptr<ReducescatterOp>> reducescatter_ops,
+                                   std::vector<std::shared_ptr<AlltoallOp>> alltoall_ops,
+                                   std::vector<std::shared_ptr<AllreduceOp>> process_set_ops,
                                    std::shared_ptr<ErrorOp> error_op)
     : param_manager_(param_manager),
       allreduce_ops_(std::move(allreduce_ops)),
+      adasum_ops_(std::move(adasum_ops)),
       allgather_ops_(std::move(allgather_ops)),
       broadcast_ops_(std::move(broadcast_ops)),
-      error_op_(std::move(error_op)) {}
+      reducescatter_ops_(std::move(reducescatter_ops)),
+      alltoall_ops_(std::move(alltoall_ops)),
+      process_set_ops_(std::move(process_set_ops)),
+      error_op_(std::move(error_op)) {
+  if (metrics == nullptr) {
+    return;
+  }
+  for (auto& op : allreduce_ops_) {
+    AddMetrics(metrics, *op);
+  }
+  for (auto& op : adasum_ops_) {
+    AddMetrics(metrics, *op);
+  }
+  for (auto& op : allgather_ops_) {
+    AddMetrics(metrics, *op);
+  }
+  for (auto& op : broadcast_ops_) {
+    AddMetrics(metrics, *op);
+  }
+  for (auto& op : reducescatter_ops_) {
+    AddMetrics(metrics, *op);
+  }
+  for (auto& op : alltoall_ops_) {
+    AddMetrics(metrics, *op);
+  }
+  for (auto& op : process_set_ops_) {
+    AddMetrics(metrics, *op);
+  }
+}
 
-Status OperationManager::ExecuteAllreduce(std::vector<TensorTableEntry>& entries,
-                                          const Response& response) const {
+void OperationManager::AddMetrics(Metrics* metrics, const HorovodOp& op) {
+  auto op_metrics = metrics->AddOperation(OperationName(op));
+  if (op_metrics != nullptr) {
+    op_metrics_[&op] = op_metrics;
+  }
+}
+
+Status OperationManager::Execute(HorovodOp& op,
+                                 std::vector<TensorTableEntry>& entries,
+                                 const Response& response) const {
+  auto it = op_metrics_.find(&op);
+  if (it == op_metrics_.end()) {
+    return op.Execute(entries, response);
+  }
+  auto start = std::chrono::steady_clock::now();
+  auto status = op.Execute(entries, response);
+  auto& op_metrics = *it->second;
+  op_metrics.time_us.Observe(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start).count());
+  int64_t bytes = 0;
+  for (auto& e : entries) {
+    bytes += e.tensor->size();
+  }
+  op_metrics.bytes.Add(bytes);
+  return status;
+}
+
+AllreduceOp*
+OperationManager::SelectAllreduce(const std::vector<TensorTableEntry>& entries,
+                                  const Response& response,
+                                  int forced) const {
+  if (response.process_set_id() != 0) {
+    if (response.reduce_op() != ReduceOp::ADASUM) {
+      for (auto& op : process_set_ops_) {
+        if (op->Enabled(*param_manager_, entries, response)) {
+          return op.get();
+        }
+      }
+    }
+    return nullptr;
+  }
+  if (response.reduce_op() == ReduceOp::ADASUM) {
+    for (auto& op : adasum_ops_) {
+      if (op->Enabled(*param_manager_, entries, response)) {
+        return op.get();
+      }
+    }
+    return nullptr;
+  }
+  if (forced >= 0) {
+    auto& op = allreduce_ops_[forced];
+    return op->Enabled(*param_manager_, entries, response) ? op.get()
+                                                           : nullptr;
+  }
   for (auto& op : allreduce_ops_) {
     if (op->Enabled(*param_manager_, entries, response)) {
-      return op->Execute(entries, response);
+      return op.get();
     }
   }
+  return nullptr;
+}
+
+bool OperationManager::AllreduceWaitsForReadyEvents(
+    const std::vector<TensorTableEntry>& entries,
+    const Response& response) const {
+  auto op = SelectAllreduce(entries, response,
+                            forced_allreduce_op_.load(std::memory_order_relaxed));
+  return op != nullptr && op->WaitsForReadyEvents();
+}
+
+Status OperationManager::ExecuteAllreduce(std::vector<TensorTableEntry>& entries,
+                                          const Response& response) const {
+  int forced = forced_allreduce_op_.load(std::memory_order_relaxed);
+  auto op = SelectAllreduce(entries, response, forced);
+  if (op != nullptr) {
+    return Execute(*op, entries, response);
+  }
+  if (response.process_set_id() != 0) {
+    return Status::PreconditionError(
+        "Allreduce within a process set requires MPI or Gloo, and does not "
+        "support Adasum.");
+  }
+  if (response.reduce_op() == ReduceOp::ADASUM) {
+    return Status::PreconditionError(
+        "Adasum allreduce requires MPI, and NCCL for GPU tensors.");
+  }
+  if (forced >= 0) {
+    return Status::PreconditionError(
+        "Allreduce operation " + AllreduceOpNames()[forced] +
+        " is not enabled for tensor " + entries[0].tensor_name + ".");
+  }
   throw std::logic_error("No Allreduce operation enabled");
 }
 
@@ -43,7 +182,7 @@ Status OperationManager::ExecuteAllgather(std::vector<TensorTableEntry>& entries
                                           const Response& response) const {
   for (auto& op : allgather_ops_) {
     if (op->Enabled(*param_manager_, entries, response)) {
-      return op->Execute(entries, response);
+      return Execute(*op, entries, response);
     }
   }
   throw std::logic_error("No Allgather operation enabled");
@@ -53,12 +192,32 @@ Status OperationManager::ExecuteBroadcast(std::vector<TensorTableEntry>& entries
                                           const Response& response) const {
   for (auto& op : broadcast_ops_) {
     if (op->Enabled(*param_manager_, entries, response)) {
-      return op->Execute(entries, response);
+      return Execute(*op, entries, response);
     }
   }
   throw std::logic_error("No Broadcast operation enabled");
 }
 
+Status OperationManager::ExecuteReducescatter(std::vector<TensorTableEntry>& entries,
+                                              const Response& response) const {
+  for (auto& op : reducescatter_ops_) {
+    if (op->Enabled(*param_manager_, entries, response)) {
+      return Execute(*op, entries, response);
+    }
+  }
+  throw std::logic_error("No Reducescatter operation enabled");
+}
+
+Status OperationManager::ExecuteAlltoall(std::vector<TensorTableEntry>& entries,
+                                         const Response& response) const {
+  for (auto& op : alltoall_ops_) {
+    if (op->Enabled(*param_manager_, entries, response)) {
+      return Execute(*op, entries, response);
+    }
+  }
+  throw std::logic_error("No Alltoall operation enabled");
+}
+
 Status OperationManager::ExecuteError(std::vector<TensorTableEntry>& entries,
                                       const Response& response) const {
   return error_op_->Execute(entries, response);
@@ -72,6 +231,10 @@ Status OperationManager::ExecuteOperation(std::vector<TensorTableEntry>& entries
     return ExecuteAllgather(entries, response);
   } else if (response.response_type() == Response::BROADCAST) {
     return ExecuteBroadcast(entries, response);
+  } else if (response.response_type() == Response::REDUCESCATTER) {
+    return ExecuteReducescatter(entries, response);
+  } else if (response.response_type() == Response::ALLTOALL) {
+    return ExecuteAlltoall(entries, response);
   } else if (response.response_type() == Response::ERROR) {
     return ExecuteError(entries, response);
   } else {
@@ -79,5 +242,21 @@ Status OperationManager::ExecuteOperation(std::vector<TensorTableEntry>& entries
   }
 }
 
+std::vector<std::string> OperationManager::AllreduceOpNames() const {
+  std::vector<std::string> names;
+  for (auto& op : allreduce_ops_) {
+    names.push_back(OperationName(*op));
+  }
+  return names;
+}
+
+bool OperationManager::SetAllreduceOp(int index) {
+  if (index >= (int)allreduce_ops_.size()) {
+    return false;
+  }
+  forced_allreduce_op_ = index < 0 ? -1 : index;
+  return true;
+}
+
 } // namespace common
 } // namespace horovod
@@ -16,7 +16,12 @@
 #ifndef HOROVOD_OPERATION_MANAGER_H
 #define HOROVOD_OPERATION_MANAGER_H
 
+#include <atomic>
+#include <string>
+#include <unordered_map>
+
 #include "collective_operations.h"
+#include "../metrics.h"
 #include "../parameter_manager.h"
 
 namespace horovod {
@@ -24,31 +29,83 @@ namespace common {
 
 class OperationManager {
 public:
-  OperationManager(ParameterManager* param_manager,
+  // Executions of every operation are recorded in metrics, if not null.
+  OperationManager(ParameterManager* param_manager, Metrics* metrics,
                    std::vector<std::shared_ptr<AllreduceOp>> allreduce_ops,
+                   std::vector<std::shared_ptr<AllreduceOp>> adasum_ops,
                    std::vector<std::shared_ptr<AllgatherOp>> allgather_ops,
                    std::vector<std::shared_ptr<BroadcastOp>> broadcast_ops,
+                   std::vector<std::shared_ptr<ReducescatterOp>> reducescatter_ops,
+                   std::vector<std::shared_ptr<AlltoallOp>> alltoall_ops,
+                   std::vector<std::shared_ptr<AllreduceOp>> process_set_ops,
                    std::shared_ptr<ErrorOp> error_op);
 
   virtual ~OperationManager() = default;
 
+  // Adasum allreduces only run on the operations registered for it, and fail
+  // if none of them is enabled for the entries. Allreduces within process
+  // sets only run on the operations registered for them.
   Status ExecuteAllreduce(std::vector<TensorTableEntry>& entries, const Response& response) const;
 
   Status ExecuteAllgather(std::vector<TensorTableEntry>& entries, const Response& response) const;
 
   Status ExecuteBroadcast(std::vector<TensorTableEntry>& entries, const Response& response) const;
 
+  Status ExecuteReducescatter(std::vector<TensorTableEntry>& entries, const Response& response) const;
+
+  Status ExecuteAlltoall(std::vector<TensorTableEntry>& entries, const Response& response) const;
+
   Status ExecuteError(std::vector<TensorTableEntry>& entries, const Response& response) const;
 
   Status ExecuteOperation(std::vector<TensorTableEntry>& entries, const Response& response) const;
 
+  // Class names of the registered allreduce operations, in the order they are
+  // tried.
+  std::vector<std::string> AllreduceOpNames() const;
+
+  // Runs allreduces other than Adasum only on the registered operation at the
+  // given index, and fails them if it is not enabled for the entries. A
+  // negative index restores the first enabled operation. Returns false if the
+  // index is out of range.
+  bool SetAllreduceOp(int index);
+
+  // Whether the allreduce operation that would run the entries orders its
+  // device work after their ready events itself, so that the background
+  // thread does not have to wait for them.
+  bool AllreduceWaitsForReadyEvents(const std::vector<TensorTableEntry>& entries,
+                                    const Response& response) const;
+
+  // Whether allreduces run on an operation set with SetAllreduceOp.
+  bool AllreduceOpForced() const {
+    return forced_allreduce_op_.load(std::memory_order_relaxed) >= 0;
+  }
+
 private:
+  // The allreduce operation for the entries, given the index of the forced
+  // one or a negative value, or null if none is enabled for them.
+  AllreduceOp* SelectAllreduce(const std::vector<TensorTableEntry>& entries,
+                               const Response& response, int forced) const;
+
+  // Executes op and records its time and bytes.
+  Status Execute(HorovodOp& op, std::vector<TensorTableEntry>& entries,
+                 const Response& response) const;
+
+  void AddMetrics(Metrics* metrics, const HorovodOp& op);
+
   ParameterManager* param_manager_;
 
   std::vector<std::shared_ptr<AllreduceOp>> allreduce_ops_;
+  std::vector<std::shared_ptr<AllreduceOp>> adasum_ops_;
   std::vector<std::shared_ptr<AllgatherOp>> allgather_ops_;
   std::vector<std::shared_ptr<BroadcastOp>> broadcast_ops_;
+  std::vector<std::shared_ptr<ReducescatterOp>> reducescatter_ops_;
+  std::vector<std::shared_ptr<AlltoallOp>> alltoall_ops_;
+  std::vector<std::shared_ptr<AllreduceOp>> process_set_ops_;
   std::shared_ptr<ErrorOp> error_op_;
+
+  std::atomic_int forced_allreduce_op_{-1};
+
+  std::unordered_map<const HorovodOp*, OperationMetrics*> op_metrics_;
 };
 
 } // namespace common
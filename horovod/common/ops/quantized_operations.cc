@@ -0,0 +1,257 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "quantized_operations.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace horovod {
+namespace common {
+
+namespace {
+
+// Largest quantized magnitude for the number of bits. Values are symmetric
+// around zero, so INT4 uses -7 to 7.
+int Levels(int bits) { return (1 << (bits - 1)) - 1; }
+
+// Bytes of a chunk: its scale followed by its quantized values.
+int64_t ChunkBytes(int bits) {
+  return (int64_t)sizeof(float) + QUANTIZATION_CHUNK * bits / 8;
+}
+
+} // namespace
+
+QuantizedAllreduce::QuantizedAllreduce(HorovodGlobalState* global_state)
+    : AllreduceOp(global_state) {}
+
+QuantizedAllreduce::Layout
+QuantizedAllreduce::GetLayout(Compression compression, int64_t n) const {
+  Layout layout;
+  layout.bits = compression == Compression::INT4 ? 4 : 8;
+  int64_t size = global_state_->controller->GetSize();
+  int64_t chunks = (n + size * QUANTIZATION_CHUNK - 1) /
+                   (size * QUANTIZATION_CHUNK);
+  layout.segment_values = chunks * QUANTIZATION_CHUNK;
+  layout.segment_bytes = chunks * ChunkBytes(layout.bits);
+  return layout;
+}
+
+bool QuantizedAllreduce::Enabled(const ParameterManager& param_manager,
+                                 const std::vector<TensorTableEntry>& entries,
+                                 const Response& response) const {
+  auto& first_entry = entries[0];
+  // Stochastic rounding depends on the fusion layout, so the allreduce is
+  // not compressed in deterministic mode.
+  if (response.compression() == Compression::NONE ||
+      global_state_->deterministic_allreduce ||
+      first_entry.device != CPU_DEVICE_ID ||
+      first_entry.tensor->dtype() != HOROVOD_FLOAT32 ||
+      response.reduce_op() != ReduceOp::SUM) {
+    return false;
+  }
+
+  // Segments are padded to whole chunks, so small tensors on many ranks are
+  // cheaper to send as they are. The decision only depends on the shapes, so
+  // every rank makes the same one.
+  int64_t n = 0;
+  for (auto& e : entries) {
+    n += e.tensor->shape().num_elements();
+  }
+  auto layout = GetLayout(response.compression(), n);
+  int64_t size = global_state_->controller->GetSize();
+  return size * layout.segment_bytes < n * (int64_t)sizeof(float) &&
+         size * layout.segment_bytes <= std::numeric_limits<int>::max();
+}
+
+void QuantizedAllreduce::Quantize(const float* input, int64_t n, int bits,
+                                  uint8_t* output) {
+  // Random numbers are drawn up front, so that the loops over values have no
+  // dependencies between iterations and are vectorized by the compiler.
+  uniform_.resize((size_t)QUANTIZATION_CHUNK);
+  float levels = (float)Levels(bits);
+  for (int64_t chunk = 0; chunk < n; chunk += QUANTIZATION_CHUNK) {
+    auto x = input + chunk;
+    float max_abs = 0;
+    for (int64_t i = 0; i < QUANTIZATION_CHUNK; ++i) {
+      max_abs = std::max(max_abs, std::abs(x[i]));
+    }
+    std::memcpy(output, &max_abs, sizeof(float));
+    output += sizeof(float);
+    float inverse = max_abs > 0 ? levels / max_abs : 0;
+
+    for (int64_t i = 0; i < QUANTIZATION_CHUNK; ++i) {
+      // xorshift64*, keeping 24 bits for a float in [0, 1).
+      random_state_ ^= random_state_ >> 12;
+      random_state_ ^= random_state_ << 25;
+      random_state_ ^= random_state_ >> 27;
+      uniform_[i] =
+          (float)((random_state_ * 0x2545F4914F6CDD1DULL) >> 40) / 16777216.0f;
+    }
+
+    // Rounding down after adding a uniform number rounds up with the
+    // probability of the fractional part, so the quantization is unbiased.
+    if (bits == 8) {
+      auto q = (int8_t*)output;
+      for (int64_t i = 0; i < QUANTIZATION_CHUNK; ++i) {
+        float v = std::floor(x[i] * inverse + uniform_[i]);
+        q[i] = (int8_t)std::min(std::max(v, -levels), levels);
+      }
+    } else {
+      // Two values per byte, biased to be unsigned, low nibble first.
+      for (int64_t i = 0; i < QUANTIZATION_CHUNK; i += 2) {
+        float v0 = std::floor(x[i] * inverse + uniform_[i]);
+        float v1 = std::floor(x[i + 1] * inverse + uniform_[i + 1]);
+        auto q0 = (int)std::min(std::max(v0, -levels), levels) + 8;
+        auto q1 = (int)std::min(std::max(v1, -levels), levels) + 8;
+        output[i / 2] = (uint8_t)(q0 | (q1 << 4));
+      }
+    }
+    output += QUANTIZATION_CHUNK * bits / 8;
+  }
+}
+
+void QuantizedAllreduce::Dequantize(const uint8_t* input, int64_t n, int bits,
+                                    float* output, bool accumulate) {
+  float levels = (float)Levels(bits);
+  for (int64_t chunk = 0; chunk < n; chunk += QUANTIZATION_CHUNK) {
+    float max_abs;
+    std::memcpy(&max_abs, input, sizeof(float));
+    input += sizeof(float);
+    float step = max_abs / levels;
+    auto y = output + chunk;
+    if (bits == 8) {
+      auto q = (const int8_t*)input;
+      if (accumulate) {
+        for (int64_t i = 0; i < QUANTIZATION_CHUNK; ++i) {
+          y[i] += (float)q[i] * step;
+        }
+      } else {
+        for (int64_t i = 0; i < QUANTIZATION_CHUNK; ++i) {
+          y[i] = (float)q[i] * step;
+        }
+      }
+    } else {
+      for (int64_t i = 0; i < QUANTIZATION_CHUNK; i += 2) {
+        float v0 = (float)((int)(input[i / 2] & 0xF) - 8) * step;
+        float v1 = (float)((int)(input[i / 2] >> 4) - 8) * step;
+        y[i] = accumulate ? y[i] + v0 : v0;
+        y[i + 1] = accumulate ? y[i + 1] + v1 : v1;
+      }
+    }
+    input += QUANTIZATION_CHUNK * bits / 8;
+  }
+}
+
+Status QuantizedAllreduce::Execute(std::vector<TensorTableEntry>& entries,
+                                   const Response& response) {
+  auto& timeline = global_state_->timeline;
+  int64_t n = NumElements(entries);
+  int64_t size = global_state_->controller->GetSize();
+  int64_t rank = global_state_->controller->GetRank();
+  auto layout = GetLayout(response.compression(), n);
+  int64_t padded = size * layout.segment_values;
+  if (random_state_ == 0) {
+    random_state_ = 0x9E3779B97F4A7C15ULL * (uint64_t)(rank + 1);
+  }
+
+  if (++executions_ % RESIDUAL_IDLE_EXECUTIONS == 0) {
+    for (auto it = residuals_.begin(); it != residuals_.end();) {
+      if (executions_ - it->second.last_used > RESIDUAL_IDLE_EXECUTIONS) {
+        it = residuals_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  // Add the residuals of the previous step to the fused gradient, quantize
+  // it and keep what the quantization lost for the next step.
+  timeline.ActivityStartAll(entries, MEMCPY_IN_FUSION_BUFFER);
+  values_.assign((size_t)padded, 0.0f);
+  int64_t offset = 0;
+  for (auto& e : entries) {
+    int64_t num_elements = e.tensor->shape().num_elements();
+    auto& entry = residuals_[e.tensor_name];
+    entry.last_used = executions_;
+    auto& residual = entry.values;
+    residual.resize((size_t)num_elements, 0.0f);
+    auto input = (const float*)e.tensor->data();
+    auto prescale = (float)e.prescale_factor;
+    auto values = values_.data() + offset;
+    for (int64_t i = 0; i < num_elements; ++i) {
+      values[i] = input[i] * prescale + residual[i];
+    }
+    offset += num_elements;
+  }
+  send_.resize((size_t)(size * layout.segment_bytes));
+  Quantize(values_.data(), padded, layout.bits, send_.data());
+  dequantized_.resize((size_t)padded);
+  Dequantize(send_.data(), padded, layout.bits, dequantized_.data(), false);
+  offset = 0;
+  for (auto& e : entries) {
+    int64_t num_elements = e.tensor->shape().num_elements();
+    auto residual = residuals_[e.tensor_name].values.data();
+    for (int64_t i = 0; i < num_elements; ++i) {
+      residual[i] = values_[offset + i] - dequantized_[offset + i];
+    }
+    offset += num_elements;
+  }
+  timeline.ActivityEndAll(entries);
+
+  // Segment r of every rank goes to rank r.
+  timeline.ActivityStartAll(entries, QUANTIZED_ALLTOALL);
+  recv_.resize(send_.size());
+  Alltoall(send_.data(), recv_.data(), (int)layout.segment_bytes);
+  timeline.ActivityEndAll(entries);
+
+  // Sum the segments received in float32 and quantize the sum into the
+  // slot of this rank, which the allgather sends from.
+  timeline.ActivityStartAll(entries, QUANTIZED_REDUCE);
+  auto sum = dequantized_.data();
+  for (int64_t r = 0; r < size; ++r) {
+    Dequantize(recv_.data() + r * layout.segment_bytes, layout.segment_values,
+               layout.bits, sum, r > 0);
+  }
+  Quantize(sum, layout.segment_values, layout.bits,
+           send_.data() + rank * layout.segment_bytes);
+  timeline.ActivityEndAll(entries);
+
+  timeline.ActivityStartAll(entries, QUANTIZED_ALLGATHER);
+  Allgather(send_.data() + rank * layout.segment_bytes, recv_.data(),
+            (int)layout.segment_bytes);
+  timeline.ActivityEndAll(entries);
+
+  timeline.ActivityStartAll(entries, MEMCPY_OUT_FUSION_BUFFER);
+  Dequantize(recv_.data(), padded, layout.bits, values_.data(), false);
+  offset = 0;
+  for (auto& e : entries) {
+    int64_t num_elements = e.tensor->shape().num_elements();
+    auto output = (float*)e.output->data();
+    auto postscale = (float)e.postscale_factor;
+    for (int64_t i = 0; i < num_elements; ++i) {
+      output[i] = values_[offset + i] * postscale;
+    }
+    offset += num_elements;
+  }
+  timeline.ActivityEndAll(entries);
+
+  return Status::OK();
+}
+
+} // namespace common
+} // namespace horovod
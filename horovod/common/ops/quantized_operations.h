@@ -0,0 +1,104 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HOROVOD_QUANTIZED_OPERATIONS_H
+#define HOROVOD_QUANTIZED_OPERATIONS_H
+
+#include <unordered_map>
+#include <vector>
+
+#include "collective_operations.h"
+
+namespace horovod {
+namespace common {
+
+// Number of values sharing a scale in quantized allreduces.
+const int64_t QUANTIZATION_CHUNK = 512;
+
+// Allreduce of float32 tensors in host memory whose requests ask for INT8 or
+// INT4 compression. The fused gradient, plus the error of its quantization in
+// the previous step (error feedback), is quantized in chunks of
+// QUANTIZATION_CHUNK values that share a float32 scale, with stochastic
+// rounding. Each rank is sent the quantized values of its segment by all
+// ranks (reduce-scatter), sums them in float32, quantizes the sum again and
+// sends it to all ranks (allgather), so that every value is quantized once
+// per exchange.
+class QuantizedAllreduce : public AllreduceOp {
+public:
+  QuantizedAllreduce(HorovodGlobalState* global_state);
+
+  virtual ~QuantizedAllreduce() = default;
+
+  Status Execute(std::vector<TensorTableEntry>& entries,
+                 const Response& response) override;
+
+  bool Enabled(const ParameterManager& param_manager,
+               const std::vector<TensorTableEntry>& entries,
+               const Response& response) const override;
+
+protected:
+  // Sends the bytes of sendbuf at offset r * bytes to rank r, and receives
+  // the bytes of rank r at offset r * bytes of recvbuf.
+  virtual void Alltoall(const uint8_t* sendbuf, uint8_t* recvbuf,
+                        int bytes) = 0;
+
+  // Gathers bytes from every rank into recvbuf, in rank order.
+  virtual void Allgather(const uint8_t* sendbuf, uint8_t* recvbuf,
+                         int bytes) = 0;
+
+private:
+  // Layout of n fused values split in one segment per rank.
+  struct Layout {
+    int bits;
+    int64_t segment_values;
+    int64_t segment_bytes;
+  };
+
+  Layout GetLayout(Compression compression, int64_t n) const;
+
+  // Quantizes n values, a multiple of the chunk size, into output.
+  void Quantize(const float* input, int64_t n, int bits, uint8_t* output);
+
+  // Dequantizes n values and adds them to output, or overwrites it.
+  static void Dequantize(const uint8_t* input, int64_t n, int bits,
+                         float* output, bool accumulate);
+
+  // Error feedback residuals, keyed by tensor name, and the execution that
+  // last used them. Residuals of tensors not reduced over the last
+  // RESIDUAL_IDLE_EXECUTIONS executions are dropped, so that tensors that
+  // are gone, e.g. of a previous model, do not hold on to memory.
+  struct Residual {
+    std::vector<float> values;
+    uint64_t last_used = 0;
+  };
+  static constexpr uint64_t RESIDUAL_IDLE_EXECUTIONS = 1000;
+  std::unordered_map<std::string, Residual> residuals_;
+  uint64_t executions_ = 0;
+
+  // State of the random numbers of stochastic rounding, seeded by rank.
+  uint64_t random_state_ = 0;
+
+  // Scratch buffers reused across calls.
+  std::vector<float> values_;
+  std::vector<float> dequantized_;
+  std::vector<float> uniform_;
+  std::vector<uint8_t> send_;
+  std::vector<uint8_t> recv_;
+};
+
+} // namespace common
+} // namespace horovod
+
+#endif // HOROVOD_QUANTIZED_OPERATIONS_H
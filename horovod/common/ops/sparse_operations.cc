@@ -0,0 +1,156 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "sparse_operations.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace horovod {
+namespace common {
+
+SparseAllreduce::SparseAllreduce(HorovodGlobalState* global_state)
+    : AllreduceOp(global_state) {}
+
+int64_t SparseAllreduce::NumSelected(int64_t n) const {
+  auto k = (int64_t)std::ceil(global_state_->sparse_allreduce_ratio * n);
+  return std::max<int64_t>(std::min(k, n), 1);
+}
+
+bool SparseAllreduce::Enabled(const ParameterManager& param_manager,
+                              const std::vector<TensorTableEntry>& entries,
+                              const Response& response) const {
+  auto& first_entry = entries[0];
+  // The selected elements depend on the fusion layout, so the allreduce is
+  // dense in deterministic mode.
+  if (global_state_->sparse_allreduce_ratio <= 0 ||
+      global_state_->deterministic_allreduce ||
+      first_entry.device != CPU_DEVICE_ID ||
+      first_entry.tensor->dtype() != HOROVOD_FLOAT32 ||
+      response.reduce_op() != ReduceOp::SUM) {
+    return false;
+  }
+
+  // Pairs take twice the bytes of the values, so sparsifying only pays off
+  // when less than half of them are sent. The pairs a rank sends must fit in
+  // the int byte count of the allgather. The decision only depends on the
+  // shapes, so every rank makes the same one.
+  int64_t n = 0;
+  for (auto& e : entries) {
+    n += e.tensor->shape().num_elements();
+  }
+  if (n > std::numeric_limits<int32_t>::max()) {
+    return false;
+  }
+  int64_t k = NumSelected(n);
+  return 2 * k < n && k * (int64_t)sizeof(SparseElement) <=
+                          std::numeric_limits<int32_t>::max();
+}
+
+Status SparseAllreduce::Execute(std::vector<TensorTableEntry>& entries,
+                                const Response& response) {
+  auto& timeline = global_state_->timeline;
+  int64_t n = NumElements(entries);
+  int64_t k = NumSelected(n);
+
+  if (++executions_ % RESIDUAL_IDLE_EXECUTIONS == 0) {
+    for (auto it = residuals_.begin(); it != residuals_.end();) {
+      if (executions_ - it->second.last_used > RESIDUAL_IDLE_EXECUTIONS) {
+        it = residuals_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  // Add the residuals of the previous step to the fused gradient.
+  timeline.ActivityStartAll(entries, MEMCPY_IN_FUSION_BUFFER);
+  dense_.resize((size_t)n);
+  int64_t offset = 0;
+  for (auto& e : entries) {
+    int64_t num_elements = e.tensor->shape().num_elements();
+    auto& entry = residuals_[e.tensor_name];
+    entry.last_used = executions_;
+    auto& residual = entry.values;
+    residual.resize((size_t)num_elements, 0.0f);
+    auto input = (const float*)e.tensor->data();
+    auto prescale = (float)e.prescale_factor;
+    for (int64_t i = 0; i < num_elements; ++i) {
+      dense_[offset + i] = input[i] * prescale + residual[i];
+    }
+    offset += num_elements;
+  }
+
+  // Select the k elements of largest magnitude.
+  order_.resize((size_t)n);
+  for (int64_t i = 0; i < n; ++i) {
+    order_[i] = (int32_t)i;
+  }
+  std::nth_element(order_.begin(), order_.begin() + (k - 1), order_.end(),
+                   [this](int32_t a, int32_t b) {
+                     return std::abs(dense_[a]) > std::abs(dense_[b]);
+                   });
+  selected_.resize((size_t)k);
+  for (int64_t i = 0; i < k; ++i) {
+    int32_t index = order_[i];
+    selected_[i] = {index, dense_[index]};
+    dense_[index] = 0;
+  }
+
+  // What was not sent is carried over to the next step.
+  offset = 0;
+  for (auto& e : entries) {
+    int64_t num_elements = e.tensor->shape().num_elements();
+    std::memcpy(residuals_[e.tensor_name].values.data(),
+                dense_.data() + offset, (size_t)num_elements * sizeof(float));
+    offset += num_elements;
+  }
+  timeline.ActivityEndAll(entries);
+
+  timeline.ActivityStartAll(entries, SPARSE_ALLGATHER);
+  gathered_.resize((size_t)(k * global_state_->controller->GetSize()));
+  Allgather(selected_.data(), gathered_.data(), (int)k);
+  timeline.ActivityEndAll(entries);
+
+  // Scatter-add the elements of all ranks into the outputs.
+  timeline.ActivityStartAll(entries, MEMCPY_OUT_FUSION_BUFFER);
+  std::fill(dense_.begin(), dense_.end(), 0.0f);
+  for (auto& element : gathered_) {
+    dense_[element.index] += element.value;
+  }
+  offset = 0;
+  for (auto& e : entries) {
+    int64_t num_elements = e.tensor->shape().num_elements();
+    if (e.postscale_factor != 1.0) {
+      auto output = (float*)e.output->data();
+      auto postscale = (float)e.postscale_factor;
+      for (int64_t i = 0; i < num_elements; ++i) {
+        output[i] = dense_[offset + i] * postscale;
+      }
+    } else {
+      std::memcpy((void*)e.output->data(), dense_.data() + offset,
+                  (size_t)num_elements * sizeof(float));
+    }
+    offset += num_elements;
+  }
+  timeline.ActivityEndAll(entries);
+
+  return Status::OK();
+}
+
+} // namespace common
+} // namespace horovod
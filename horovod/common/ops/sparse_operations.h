@@ -0,0 +1,81 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HOROVOD_SPARSE_OPERATIONS_H
+#define HOROVOD_SPARSE_OPERATIONS_H
+
+#include <unordered_map>
+#include <vector>
+
+#include "collective_operations.h"
+
+namespace horovod {
+namespace common {
+
+// Top-k sparsified allreduce of float32 tensors in host memory. Each rank
+// keeps the largest sparse_allreduce_ratio fraction of the fused gradient by
+// magnitude, exchanges them as (index, value) pairs with an allgather and
+// sums them into the outputs. The entries that are not sent are added to the
+// gradient of the tensor in the next step (error feedback).
+class SparseAllreduce : public AllreduceOp {
+public:
+  SparseAllreduce(HorovodGlobalState* global_state);
+
+  virtual ~SparseAllreduce() = default;
+
+  Status Execute(std::vector<TensorTableEntry>& entries,
+                 const Response& response) override;
+
+  bool Enabled(const ParameterManager& param_manager,
+               const std::vector<TensorTableEntry>& entries,
+               const Response& response) const override;
+
+protected:
+  struct SparseElement {
+    int32_t index;
+    float value;
+  };
+
+  // Gathers count elements from every rank into recvbuf, in rank order.
+  virtual void Allgather(const SparseElement* sendbuf, SparseElement* recvbuf,
+                         int count) = 0;
+
+  // Number of elements each rank sends for n fused elements.
+  int64_t NumSelected(int64_t n) const;
+
+private:
+  // Error feedback residuals, keyed by tensor name, and the execution that
+  // last used them. Residuals of tensors not reduced over the last
+  // RESIDUAL_IDLE_EXECUTIONS executions are dropped, as in
+  // QuantizedAllreduce.
+  struct Residual {
+    std::vector<float> values;
+    uint64_t last_used = 0;
+  };
+  static constexpr uint64_t RESIDUAL_IDLE_EXECUTIONS = 1000;
+  std::unordered_map<std::string, Residual> residuals_;
+  uint64_t executions_ = 0;
+
+  // Scratch buffers reused across calls.
+  std::vector<float> dense_;
+  std::vector<int32_t> order_;
+  std::vector<SparseElement> selected_;
+  std::vector<SparseElement> gathered_;
+};
+
+} // namespace common
+} // namespace horovod
+
+#endif // HOROVOD_SPARSE_OPERATIONS_H
@@ -63,7 +63,7 @@ void BayesianOptimization::AddSample(const Eigen::VectorXd& x, double y) {
   y_samples_.push_back(y);
 }
 
-VectorXd BayesianOptimization::NextSample(bool normalize) {
+VectorXd BayesianOptimization::NextSample(bool normalize, const VectorXd* pending) {
   double mu = 0.0;
   double sigma = 1.0;
   if (normalize && y_samples_.size() >= 3) {
@@ -71,12 +71,13 @@ VectorXd BayesianOptimization::NextSample(bool normalize) {
   }
 
   // Matrices are immutable and must be regenerated each time a new sample is added.
-  MatrixXd x_sample(x_samples_.size(), d_);
+  size_t n = x_samples_.size() + (pending != nullptr ? 1 : 0);
+  MatrixXd x_sample(n, d_);
   for (unsigned int i = 0; i < x_samples_.size(); ++i) {
     x_sample.row(i) = x_samples_[i];
   }
 
-  MatrixXd y_sample(y_samples_.size(), 1);
+  MatrixXd y_sample(n, 1);
   for (unsigned int i = 0; i < y_samples_.size(); ++i) {
     double norm_score = (y_samples_[i] - mu) / sigma;
 
@@ -85,6 +86,11 @@ VectorXd BayesianOptimization::NextSample(bool normalize) {
     y_sample.row(i) = y_i;
   }
 
+  if (pending != nullptr) {
+    x_sample.row(n - 1) = *pending;
+    y_sample(n - 1, 0) = y_samples_.empty() ? 0.0 : y_sample.topRows(n - 1).mean();
+  }
+
   // Generate the posterior distribution for the GP given the observed data.
   gpr_.Fit(&x_sample, &y_sample);
 
@@ -98,15 +104,24 @@ void BayesianOptimization::Clear() {
 }
 
 VectorXd BayesianOptimization::ProposeLocation(const MatrixXd& x_sample, const MatrixXd& y_sample, int n_restarts) {
-  // Objective function we wish to minimize, the negative acquisition function.
-  auto f = [&](const VectorXd& x) {
-    return -ExpectedImprovement(x.transpose(), x_sample)[0];
-  };
+  // Compute sufficient statistics for the observed locations, which do not depend on the proposed one.
+  // Needed for noise-based model, otherwise use y_sample.maxCoeff().
+  // See also section 2.4 in https://arxiv.org/pdf/1012.2599.pdf:
+  // Eric Brochu, Vlad M. Cora, Nando de Freitas,
+  // A Tutorial on Bayesian Optimization of Expensive Cost Functions
+  VectorXd mu_sample;
+  gpr_.Predict(x_sample, mu_sample);
+  double mu_sample_opt = mu_sample.maxCoeff();
 
-  // Minimization routine. To approximate bounded LBFGS, we set to infinity the value of any input outside of bound.
+  // Minimization routine for the negative acquisition function. To approximate bounded LBFGS, we set to
+  // infinity the value of any input outside of bound.
   auto min_obj = [&](const VectorXd& x, VectorXd& grad) {
-    double fx = CheckBounds(x) ? f(x) : std::numeric_limits<double>::max();
-    GaussianProcessRegressor::ApproxFPrime(x, f, fx, grad);
+    if (!CheckBounds(x)) {
+      grad.setZero();
+      return std::numeric_limits<double>::max();
+    }
+    double fx = -ExpectedImprovement(x, mu_sample_opt, grad);
+    grad = -grad;
     return fx;
   };
 
@@ -142,21 +157,17 @@ VectorXd BayesianOptimization::ProposeLocation(const MatrixXd& x_sample, const M
   return x_next;
 }
 
-VectorXd BayesianOptimization::ExpectedImprovement(const MatrixXd& x, const MatrixXd& x_sample) {
-  // Compute sufficient statistics for the proposed locations.
-  Eigen::VectorXd mu;
-  Eigen::VectorXd sigma;
-  gpr_.Predict(x, mu, &sigma);
-
-  // Compute sufficient statistics for the observed locations.
-  Eigen::VectorXd mu_sample;
-  gpr_.Predict(x_sample, mu_sample);
-
-  // Needed for noise-based model, otherwise use y_sample.maxCoeff().
-  // See also section 2.4 in https://arxiv.org/pdf/1012.2599.pdf:
-  // Eric Brochu, Vlad M. Cora, Nando de Freitas,
-  // A Tutorial on Bayesian Optimization of Expensive Cost Functions
-  double mu_sample_opt = mu_sample.maxCoeff();
+double BayesianOptimization::ExpectedImprovement(const VectorXd& x, double mu_sample_opt, VectorXd& grad) {
+  // Compute sufficient statistics for the proposed location and their gradients.
+  double mu;
+  double sigma;
+  VectorXd mu_grad;
+  VectorXd sigma_grad;
+  gpr_.PredictGradient(x, mu, sigma, mu_grad, sigma_grad);
+  if (sigma == 0) {
+    grad.setZero();
+    return 0.0;
+  }
 
   // Probability density function of the standard normal distribution.
   auto pdf = [](double x) {
@@ -172,13 +183,13 @@ VectorXd BayesianOptimization::ExpectedImprovement(const MatrixXd& x, const Matr
   // in more exploration. With higher values of xi_, the importance of improvements predicted by the
   // underlying GP posterior mean mu_sample_opt decreases relative to the importance of improvements
   // in regions of high prediction uncertainty, as indicated by large values of variable sigma.
-  Eigen::VectorXd imp = mu.array() - mu_sample_opt - xi_;
-  VectorXd z = imp.array() / sigma.array();
+  double imp = mu - mu_sample_opt - xi_;
+  double z = imp / sigma;
 
-  // The first term of the summation is the exploitation term, the second the exploration term.
-  VectorXd ei = imp.cwiseProduct(z.unaryExpr(cdf)) + sigma.cwiseProduct(z.unaryExpr(pdf));
-  ei = (sigma.array() != 0).select(ei, 0.0);
-  return ei;
+  // The first term of the summation is the exploitation term, the second the exploration term. As
+  // d(pdf(z))/dz = -z * pdf(z), the terms in dz/dx cancel out in the gradient.
+  grad = cdf(z) * mu_grad + pdf(z) * sigma_grad;
+  return imp * cdf(z) + sigma * pdf(z);
 }
 
 bool BayesianOptimization::CheckBounds(const Eigen::VectorXd& x) {
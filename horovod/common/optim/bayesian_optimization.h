@@ -62,9 +62,16 @@ public:
   //  y: Evaluated objective value at x.
   void AddSample(const Eigen::VectorXd& x, double y);
 
+  // Returns the number of samples added since the last Clear.
+  inline size_t NumSamples() const { return y_samples_.size(); };
+
   // Provides the next sample point to evaluate subject to maximizing the
   // expected improvement of the target acquisition function.
-  Eigen::VectorXd NextSample(bool normalize=true);
+  //
+  // If given, pending is a point that is still being evaluated. It is assumed to score the mean of
+  // the samples (the "constant liar" of asynchronous Bayesian optimization), which moves the
+  // proposal away from it before its value is known.
+  Eigen::VectorXd NextSample(bool normalize=true, const Eigen::VectorXd* pending=nullptr);
 
   // Reset the state of the optimizer by clearing all samples.
   void Clear();
@@ -82,15 +89,16 @@ private:
   Eigen::VectorXd ProposeLocation(
       const Eigen::MatrixXd& x_sample, const Eigen::MatrixXd& y_sample, int n_restarts=25);
 
-  // Computes the Expected Improvement at points X based on existing samples X_sample and Y_sample
-  // using a Gaussian process surrogate model fitted to the samples.
+  // Computes the Expected Improvement at point x using a Gaussian process surrogate model fitted to
+  // the samples, and its gradient with respect to x.
   //
   // Args:
-  //  x: Proposed points at which EI shall be computed (m x d).
-  //  x_sample: Sample locations observed (n x d).
+  //  x: Proposed point at which EI shall be computed (d x 1).
+  //  mu_sample_opt: Largest mean predicted at the observed sample locations.
+  //  grad: Gradient of the EI at x (d x 1).
   //
-  // Returns: Expected improvements at points X.
-  Eigen::VectorXd ExpectedImprovement(const Eigen::MatrixXd& x, const Eigen::MatrixXd& x_sample);
+  // Returns: Expected improvement at point x.
+  double ExpectedImprovement(const Eigen::VectorXd& x, double mu_sample_opt, Eigen::VectorXd& grad);
 
   // Returns true if all elements of the vector are within the respective bounds for its dimension.
   bool CheckBounds(const Eigen::VectorXd& x);
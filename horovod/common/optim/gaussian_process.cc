@@ -17,6 +17,7 @@
 
 #include "gaussian_process.h"
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 
@@ -53,39 +54,47 @@ void GaussianProcessRegressor::Fit(MatrixXd* x_train, MatrixXd* y_train) {
   };
 
   // f(x): the objective function to be minimized by our optimizer.
-  // Computes the negative log-likelihood for training data x_train and y_train and given noise level.
+  // Computes the negative log-likelihood for training data x_train and y_train and given noise level,
+  // along with its gradient with respect to the kernel parameters (length, sigma_f), which is
+  // 0.5 * tr((K^-1 - a * a^T) * dK/dtheta) with a = K^-1 * y (GPML, equation 5.9).
+  int64_t m = x_train_->rows();
   double a2 = alpha_ * alpha_;
-  double d3 = 0.5 * x_train_->rows() * std::log(2 * M_PI);
-  auto f = [&, a2, d3](const VectorXd& x) {
-    int64_t m = x_train_->rows();
-    MatrixXd k = Kernel(*x_train_, *x_train_, x[0], x[1]) + (a2 * MatrixXd::Identity(m, m));
-    MatrixXd k_inv = k.inverse();
-
-    // Compute determinant via Cholesky decomposition
-    MatrixXd l = k.llt().matrixL().toDenseMatrix();
+  double d3 = 0.5 * m * std::log(2 * M_PI);
+  MatrixXd sqdist = SquaredDistance(*x_train_, *x_train_);
+  MatrixXd identity = MatrixXd::Identity(m, m);
+  auto f = [&, a2, d3](const VectorXd& x, VectorXd& grad) {
+    MatrixXd k_f = Kernel(*x_train_, *x_train_, x[0], x[1]);
+    MatrixXd k = k_f + (a2 * identity);
+
+    // Compute determinant and inverse via Cholesky decomposition
+    Eigen::LLT<MatrixXd> llt(k);
+    MatrixXd k_inv = llt.solve(identity);
+    VectorXd a = k_inv * y_train_->col(0);
+    MatrixXd l = llt.matrixL().toDenseMatrix();
     double d1 = l.diagonal().unaryExpr(ln).sum();
-    MatrixXd d2 = 0.5 * (y_train_->transpose() * (k_inv * (*y_train_)));
-    MatrixXd cov = d2.array() + (d1 + d3);
+    double d2 = 0.5 * y_train_->col(0).dot(a);
 
-    return cov(0, 0);
+    // dK/dlength = K_f * sqdist / length^3 and dK/dsigma_f = 2 * K_f / sigma_f element-wise.
+    MatrixXd w = k_inv - a * a.transpose();
+    grad[0] = 0.5 * w.cwiseProduct(k_f.cwiseProduct(sqdist)).sum() / (x[0] * x[0] * x[0]);
+    grad[1] = w.cwiseProduct(k_f).sum() / x[1];
+
+    return d2 + d1 + d3;
   };
 
-  // We wish to minimize the negative log-likelihood of f(x) above by evaluating it at a given point, then
-  // empirically approximating the derivative to follow the gradient downwards.
+  // We wish to minimize the negative log-likelihood of f(x) above by evaluating it at a given point
+  // and following its gradient downwards.
   double f_min = std::numeric_limits<double>::max();
   VectorXd x_min;
   auto nll_fn = [&](const VectorXd& x, VectorXd& grad) {
-    // f(x) computed at the current point x
-    double fx = f(x);
+    // f(x) computed at the current point x, which updates the gradient vector in place
+    double fx = f(x, grad);
 
     // Update the best value observed so far, if x is a valid point
     if (!isnan(x) && fx < f_min) {
       f_min = fx;
       x_min = x;
     }
-
-    // Update the gradient vector in place and return the f(x) value computed
-    ApproxFPrime(x, f, fx, grad);
     return fx;
   };
 
@@ -109,19 +118,46 @@ void GaussianProcessRegressor::Fit(MatrixXd* x_train, MatrixXd* y_train) {
     length_ = x_min[0];
     sigma_f_ = x_min[1];
   }
+
+  // Predictions all use the kernel matrix of the fitted parameters.
+  MatrixXd k = Kernel(*x_train_, *x_train_, length_, sigma_f_) + (a2 * identity);
+  k_inv_ = k.inverse();
+  weights_ = k_inv_ * y_train_->col(0);
 }
 
 void GaussianProcessRegressor::Predict(const MatrixXd& x, VectorXd& mu, VectorXd* sigma) const {
-  MatrixXd cov;
-  PosteriorPrediction(x, *x_train_, *y_train_, mu, cov, length_, sigma_f_, alpha_);
+  // Same as PosteriorPrediction with the fitted parameters, reusing the inverse kernel matrix.
+  MatrixXd k_s = Kernel(*x_train_, x, length_, sigma_f_);
+  mu = k_s.transpose() * weights_;
 
   // Only compute standard deviation if it was requested
   if (sigma != nullptr) {
-    // Extract the standard deviation from the covariance matrix
+    // Extract the standard deviation from the diagonal of the covariance matrix
     auto sqrt = [](double x) {
       return std::sqrt(x);
     };
-    *sigma = cov.diagonal().unaryExpr(sqrt);
+    VectorXd var = ((sigma_f_ * sigma_f_ + 1e-8) -
+                    k_s.cwiseProduct(k_inv_ * k_s).colwise().sum().transpose().array()).matrix();
+    *sigma = var.unaryExpr(sqrt);
+  }
+}
+
+void GaussianProcessRegressor::PredictGradient(const VectorXd& x, double& mu, double& sigma,
+                                               VectorXd& mu_grad, VectorXd& sigma_grad) const {
+  VectorXd k_s = Kernel(*x_train_, x.transpose(), length_, sigma_f_).col(0);
+  VectorXd v = k_inv_ * k_s;
+  mu = k_s.dot(weights_);
+  double var = sigma_f_ * sigma_f_ + 1e-8 - k_s.dot(v);
+  sigma = std::sqrt(std::max(var, 0.0));
+
+  // The kernel of x and training point x_i has gradient k(x, x_i) * (x_i - x) / length^2.
+  MatrixXd diff = x_train_->rowwise() - x.transpose();
+  MatrixXd dk = (diff.array().colwise() * k_s.array()).matrix() / (length_ * length_);
+  mu_grad = dk.transpose() * weights_;
+  if (sigma > 0) {
+    sigma_grad = -(dk.transpose() * v) / sigma;
+  } else {
+    sigma_grad = VectorXd::Zero(x.size());
   }
 }
 
@@ -147,26 +183,10 @@ void GaussianProcessRegressor::PosteriorPrediction(
   cov_s = k_ss - (k_s.transpose() * k_inv) * k_s;
 }
 
-void GaussianProcessRegressor::ApproxFPrime(const VectorXd& x, const std::function<double(const VectorXd&)>& f,
-                                            double f0, VectorXd& grad, double epsilon) {
-  VectorXd ei = VectorXd::Zero(x.size());
-  for (int k = 0; k < x.size(); ++k) {
-    ei[k] = 1.0;
-    VectorXd d = epsilon * ei;
-    grad[k] = (f(x + d) - f0) / d[k];
-    ei[k] = 0.0;
-  }
-}
-
 MatrixXd GaussianProcessRegressor::Kernel(const MatrixXd& x1, const MatrixXd& x2,
                                           double l, double sigma_f) const {
   // Squared Exponential Kernel, also known as the Gaussian or RBF Kernel.
-  auto x1_vec = x1.cwiseProduct(x1).rowwise().sum();
-  auto x2_vec = x2.cwiseProduct(x2).rowwise().sum();
-  auto x1_x2 = x1_vec.replicate(1, x2_vec.size()).rowwise() + x2_vec.transpose();
-
-  auto& dot = x1 * x2.transpose();
-  auto sqdist = x1_x2 - (dot.array() * 2).matrix();
+  MatrixXd sqdist = SquaredDistance(x1, x2);
 
   // The length parameter l controls the smoothness of the function and sigma_f the vertical variation. We use
   // the same l for all input dimensions (isotropic kernel).
@@ -179,5 +199,14 @@ MatrixXd GaussianProcessRegressor::Kernel(const MatrixXd& x1, const MatrixXd& x2
   return sqdist.unaryExpr(op);
 }
 
+MatrixXd GaussianProcessRegressor::SquaredDistance(const MatrixXd& x1, const MatrixXd& x2) {
+  auto x1_vec = x1.cwiseProduct(x1).rowwise().sum();
+  auto x2_vec = x2.cwiseProduct(x2).rowwise().sum();
+  auto x1_x2 = x1_vec.replicate(1, x2_vec.size()).rowwise() + x2_vec.transpose();
+
+  auto& dot = x1 * x2.transpose();
+  return x1_x2 - (dot.array() * 2).matrix();
+}
+
 } // namespace common
 } // namespace horovod
@@ -63,6 +63,11 @@ public:
   // Evaluate mean and (optional) variance at a point.
   void Predict(const Eigen::MatrixXd& x, Eigen::VectorXd& mu, Eigen::VectorXd* sigma=nullptr) const;
 
+  // Evaluate mean and standard deviation at a single point x (d x 1), along with their gradients
+  // with respect to x.
+  void PredictGradient(const Eigen::VectorXd& x, double& mu, double& sigma,
+                       Eigen::VectorXd& mu_grad, Eigen::VectorXd& sigma_grad) const;
+
   // Computes the suffifient statistics of the GP posterior predictive distribution
   // from m training data X_train and Y_train and n new inputs X_s.
   //
@@ -79,10 +84,6 @@ public:
                            Eigen::VectorXd& mu_s, Eigen::MatrixXd& cov_s,
                            double l=1.0, double sigma_f=1.0, double sigma_y=1e-8) const;
 
-  // Finite-difference approximation of the gradient of a scalar function.
-  static void ApproxFPrime(const Eigen::VectorXd& x, const std::function<double(const Eigen::VectorXd&)>& f,
-                           double f0, Eigen::VectorXd& grad, double epsilon=1e-8);
-
   // Isotropic squared exponential kernel.
   // Computes a covariance matrix from points in X1 and X2.
   //
@@ -94,6 +95,9 @@ public:
   Eigen::MatrixXd Kernel(const Eigen::MatrixXd& x1, const Eigen::MatrixXd& x2, double l=1.0, double sigma_f=1.0) const;
 
 private:
+  // Squared euclidean distances between the points in X1 and X2 (m x n).
+  static Eigen::MatrixXd SquaredDistance(const Eigen::MatrixXd& x1, const Eigen::MatrixXd& x2);
+
   // Kernel parameter for noise. Higher values make more coarse approximations which avoids overfitting to noisy data.
   double alpha_;
 
@@ -109,6 +113,11 @@ private:
   // These pointers are not owned.
   Eigen::MatrixXd* x_train_;
   Eigen::MatrixXd* y_train_;
+
+  // Inverse of the kernel matrix of the training data and its product with the training targets,
+  // which every prediction after a fit uses.
+  Eigen::MatrixXd k_inv_;
+  Eigen::VectorXd weights_;
 };
 
 } // namespace common
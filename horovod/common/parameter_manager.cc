@@ -18,6 +18,7 @@
 #include <algorithm>
 #include <cmath>
 #include <limits>
+#include <sstream>
 
 #include "logging.h"
 
@@ -29,36 +30,64 @@ namespace common {
 #define BAYES_OPT_MAX_SAMPLES 20
 #define GAUSSIAN_PROCESS_NOISE 0.8
 
-Eigen::VectorXd CreateVector(double x1, double x2) {
-  Eigen::VectorXd v(2);
-  v(0) = x1;
-  v(1) = x2;
+// Continuous mode: a sample is considered a drift if it scores this fraction
+// below the baseline, and DRIFT_SAMPLES drifts in a row start a local search
+// over LOCAL_SEARCH_RADIUS of each range around the best values.
+#define DRIFT_TOLERANCE 0.1
+#define DRIFT_SAMPLES 3
+#define BASELINE_DECAY 0.9
+#define LOCAL_SEARCH_RADIUS 0.125
+#define LOCAL_SEARCH_MAX_SAMPLES 6
+
+// Number of samples tuned after warm starting from a profile, and number of
+// observations kept per profile key.
+#define WARM_START_SAMPLES 6
+#define PROFILE_MAX_OBSERVATIONS 64
+
+#define PARAMETER_COLUMNS "hierarchical_allreduce,hierarchical_allgather,cache_capacity,num_nccl_streams,cycle_time_ms,tensor_fusion_threshold,hierarchical_allreduce_chunk,cpu_allreduce_latency_threshold"
+
+Eigen::VectorXd CreateVector(std::initializer_list<double> values) {
+  Eigen::VectorXd v(values.size());
+  int i = 0;
+  for (double x : values) {
+    v(i++) = x;
+  }
   return v;
 }
 
 // ParameterManager
 ParameterManager::ParameterManager() :
-    hierarchical_allreduce_(CategoricalParameter<bool>(std::vector<bool>{false, true})),
-    hierarchical_allgather_(CategoricalParameter<bool>(std::vector<bool>{false, true})),
-    cache_enabled_(CategoricalParameter<bool>(std::vector<bool>{false, true})),
+    // Variables are listed in the order of BayesianVariable, which is also the order of the test
+    // point values.
     joint_params_(BayesianParameter(
       std::vector<BayesianVariableConfig>{
         { BayesianVariable::fusion_buffer_threshold_mb, std::pair<double, double>(0, 64) },
-        { BayesianVariable::cycle_time_ms, std::pair<double, double>(1, 100) }
+        { BayesianVariable::cycle_time_ms, std::pair<double, double>(1, 100) },
+        { BayesianVariable::hierarchical_allreduce_enabled, std::pair<double, double>(0, 1) },
+        { BayesianVariable::hierarchical_allgather_enabled, std::pair<double, double>(0, 1) },
+        { BayesianVariable::cache_capacity_k, std::pair<double, double>(0, 4) },
+        { BayesianVariable::nccl_streams, std::pair<double, double>(1, 1) },
+        { BayesianVariable::hierarchical_allreduce_chunk_mb, std::pair<double, double>(0, 64) },
+        { BayesianVariable::cpu_allreduce_latency_threshold_kb, std::pair<double, double>(0, 256) }
       }, std::vector<Eigen::VectorXd>{
-        CreateVector(4, 5),
-        CreateVector(32, 50),
-        CreateVector(16, 25),
-        CreateVector(8, 10)
+        CreateVector({4, 5, 0, 0, 1, 1, 0, 64}),
+        CreateVector({32, 50, 1, 0, 1, 2, 8, 0}),
+        CreateVector({16, 25, 0, 1, 0, 1, 0, 256}),
+        CreateVector({8, 10, 1, 1, 2, 2, 4, 16})
       })),
-    parameter_chain_(std::vector<ITunableParameter*>{&joint_params_, &hierarchical_allreduce_, &hierarchical_allgather_,
-                                                     &cache_enabled_}),
+    parameter_chain_(std::vector<ITunableParameter*>{&joint_params_}),
     active_(false),
     warmup_remaining_(WARMUPS),
+    continuous_(false),
+    baseline_score_(0),
+    drift_samples_(0),
     sample_(0),
     rank_(-1),
     root_rank_(0),
-    writing_(false) {
+    writing_(false),
+    profile_loaded_(false),
+    size_histogram_(64, 0),
+    memory_weight_(0) {
   Reset();
 }
 
@@ -67,46 +96,155 @@ void ParameterManager::Initialize(int32_t rank, int32_t root_rank,
   rank_ = rank;
   root_rank_ = root_rank;
   if (rank_ == root_rank) {
-    LOG(INFO) << "Autotuner: Tunable params [hierarchical_allreduce,hierarchical_allgather,cache_enabled,cycle_time_ms,tensor_fusion_threshold] score";
+    LOG(INFO) << "Autotuner: Tunable params [" PARAMETER_COLUMNS "] score";
   }
   if (rank_ == root_rank && !file_name.empty()) {
     file_.open(file_name, std::ios::out | std::ios::trunc);
     if (file_.good()) {
-      file_ << "hierarchical_allreduce,hierarchical_allgather,cache_enabled,cycle_time_ms,tensor_fusion_threshold,score" << std::endl;
+      file_ << PARAMETER_COLUMNS ",score" << std::endl;
       writing_ = true;
     }
   }
 }
 
+void ParameterManager::SetProfile(const std::string& file_name,
+                                  const std::string& key) {
+  // The observations are loaded once warmup has seen the tensors.
+  profile_file_ = file_name;
+  profile_key_ = key;
+}
+
+void ParameterManager::LoadProfile() {
+  profile_loaded_ = true;
+  for (size_t i = 0; i < size_histogram_.size(); ++i) {
+    if (size_histogram_[i] > 0) {
+      profile_key_ += ";2^" + std::to_string(i) + "=" + std::to_string(size_histogram_[i]);
+    }
+  }
+  sized_tensors_.clear();
+
+  // Only the coordinator tunes.
+  if (rank_ != root_rank_) {
+    return;
+  }
+
+  std::vector<std::pair<Eigen::VectorXd, double>> observations;
+  std::ifstream file(profile_file_);
+  std::string line;
+  while (std::getline(file, line)) {
+    // Each line is the key followed by scored parameters, in the order of the log columns.
+    std::istringstream fields(line);
+    std::string field;
+    if (!std::getline(fields, field, ',') || field != profile_key_) {
+      continue;
+    }
+
+    std::vector<double> v;
+    while (std::getline(fields, field, ',')) {
+      v.push_back(std::strtod(field.c_str(), nullptr));
+    }
+    if (v.size() != 9) {
+      LOG(WARNING) << "Autotuner: Ignoring malformed line of " << profile_file_ << ": " << line;
+      continue;
+    }
+
+    observations.emplace_back(
+        CreateVector({v[5], v[4], v[0], v[1], v[2] / 1024, v[3], v[6], v[7]}), v[8]);
+    observations_.push_back(line.substr(profile_key_.size() + 1));
+  }
+
+  if (!observations.empty()) {
+    LOG(INFO) << "Autotuner: Starting from " << observations.size()
+              << " observations of " << profile_key_ << " in " << profile_file_;
+    joint_params_.WarmStart(observations);
+  }
+}
+
+void ParameterManager::SetMemoryWeight(double weight) {
+  memory_weight_ = weight;
+}
+
 void ParameterManager::SetAutoTuning(bool active) {
   if (active != active_) {
     warmup_remaining_ = WARMUPS;
+    baseline_score_ = 0;
+    drift_samples_ = 0;
   }
   active_ = active;
 };
 
+void ParameterManager::SetContinuous(bool continuous) {
+  continuous_ = continuous;
+}
+
 bool ParameterManager::HierarchicalAllreduce() const {
-  return active_ ? hierarchical_allreduce_.Value() : hierarchical_allreduce_.BestValue();
+  double v = active_ ?
+      joint_params_.Value(hierarchical_allreduce_enabled) :
+      joint_params_.BestValue(hierarchical_allreduce_enabled);
+  return v >= 0.5;
 }
 
 void ParameterManager::SetHierarchicalAllreduce(bool value, bool fixed) {
-  hierarchical_allreduce_.SetValue(value, fixed);
+  joint_params_.SetValue(hierarchical_allreduce_enabled, value ? 1 : 0, fixed);
 }
 
 bool ParameterManager::HierarchicalAllgather() const {
-  return active_ ? hierarchical_allgather_.Value() : hierarchical_allgather_.BestValue();
+  double v = active_ ?
+      joint_params_.Value(hierarchical_allgather_enabled) :
+      joint_params_.BestValue(hierarchical_allgather_enabled);
+  return v >= 0.5;
 }
 
 void ParameterManager::SetHierarchicalAllgather(bool value, bool fixed) {
-  hierarchical_allgather_.SetValue(value, fixed);
+  joint_params_.SetValue(hierarchical_allgather_enabled, value ? 1 : 0, fixed);
 }
 
-bool ParameterManager::CacheEnabled() const {
-  return active_ ? cache_enabled_.Value() : cache_enabled_.BestValue();
+int32_t ParameterManager::CacheCapacity() const {
+  double k = active_ ?
+      joint_params_.Value(cache_capacity_k) :
+      joint_params_.BestValue(cache_capacity_k);
+  return int32_t(std::round(k * 1024));
 };
 
-void ParameterManager::SetCacheEnabled(bool enabled, bool fixed) {
-  cache_enabled_.SetValue(enabled, fixed);
+void ParameterManager::SetCacheCapacity(int32_t capacity, bool fixed) {
+  joint_params_.SetValue(cache_capacity_k, double(capacity) / 1024, fixed);
+}
+
+int32_t ParameterManager::NumNCCLStreams() const {
+  double n = active_ ?
+      joint_params_.Value(nccl_streams) :
+      joint_params_.BestValue(nccl_streams);
+  return std::max(1, int32_t(std::round(n)));
+}
+
+void ParameterManager::SetNumNCCLStreams(int32_t num_streams, bool fixed) {
+  joint_params_.SetValue(nccl_streams, num_streams, fixed);
+}
+
+void ParameterManager::SetMaxNumNCCLStreams(int32_t max_streams) {
+  joint_params_.SetBounds(nccl_streams, std::pair<double, double>(1, max_streams));
+}
+
+int64_t ParameterManager::HierarchicalAllreduceChunkBytes() const {
+  double b = active_ ?
+      joint_params_.Value(hierarchical_allreduce_chunk_mb) :
+      joint_params_.BestValue(hierarchical_allreduce_chunk_mb);
+  return int64_t(b * 1024 * 1024);
+}
+
+void ParameterManager::SetHierarchicalAllreduceChunkBytes(int64_t chunk_bytes, bool fixed) {
+  joint_params_.SetValue(hierarchical_allreduce_chunk_mb, double(chunk_bytes) / (1024 * 1024), fixed);
+}
+
+int64_t ParameterManager::CPUAllreduceLatencyThresholdBytes() const {
+  double kb = active_ ?
+      joint_params_.Value(cpu_allreduce_latency_threshold_kb) :
+      joint_params_.BestValue(cpu_allreduce_latency_threshold_kb);
+  return int64_t(kb * 1024);
+}
+
+void ParameterManager::SetCPUAllreduceLatencyThresholdBytes(int64_t threshold, bool fixed) {
+  joint_params_.SetValue(cpu_allreduce_latency_threshold_kb, double(threshold) / 1024, fixed);
 }
 
 int64_t ParameterManager::TensorFusionThresholdBytes() const {
@@ -134,11 +272,24 @@ void ParameterManager::SetCycleTimeMs(double value, bool fixed) {
 /// \param bytes Total size of the tensors.
 /// \return Whether the new parameters need to be broadcasted.
 bool ParameterManager::Update(const std::vector<std::string>& tensor_names,
-                              int64_t bytes) {
-  if (!active_) {
+                              const std::vector<int64_t>& tensor_sizes) {
+  if (!active_ && !continuous_) {
     return false;
   }
 
+  int64_t bytes = 0;
+  for (size_t i = 0; i < tensor_sizes.size(); ++i) {
+    bytes += tensor_sizes[i];
+    if (!profile_file_.empty() && !profile_loaded_ &&
+        sized_tensors_.insert(tensor_names[i]).second) {
+      int bucket = 0;
+      while (bucket < 63 && (int64_t(1) << (bucket + 1)) <= tensor_sizes[i]) {
+        ++bucket;
+      }
+      ++size_histogram_[bucket];
+    }
+  }
+
   for (const std::string& tensor_name : tensor_names) {
     int32_t cycle = tensor_counts_[tensor_name]++;
     if (cycle >= (sample_ + 1) * CYCLES_PER_SAMPLE) {
@@ -157,8 +308,8 @@ bool ParameterManager::Update(const std::vector<std::string>& tensor_names,
 
   if (sample_ >= SAMPLES) {
     std::sort(scores_, scores_ + SAMPLES);
-    double med_score = scores_[SAMPLES / 2];
-    return Tune(med_score);
+    double med_score = scores_[SAMPLES / 2] / MemoryPenalty();
+    return active_ ? Tune(med_score) : Monitor(med_score);
   }
 
   return false;
@@ -174,6 +325,13 @@ bool ParameterManager::Tune(double score) {
     if (rank_ == root_rank_) {
       LOG(INFO) << "Autotuner: Warming up (" << warmup_remaining_ << " remaining)";
     }
+
+    if (warmup_remaining_ == 0 && !profile_file_.empty() && !profile_loaded_) {
+      // Every rank saw the same tensors, so they agree to synchronize the
+      // parameters the coordinator starts from.
+      LoadProfile();
+      return true;
+    }
   } else {
     // Log the last parameter values before updating.
     LogParameters(score);
@@ -196,6 +354,7 @@ bool ParameterManager::Tune(double score) {
       if (finished_tuning) {
         SetAutoTuning(false);
         LogBestParameters();
+        SaveProfile();
       }
     }
 
@@ -208,36 +367,67 @@ bool ParameterManager::Tune(double score) {
   return false;
 }
 
-ParameterManager::Params ParameterManager::GetParams() {
-  Params params;
-  if (active_) {
-    // We're actively tuning, so send the current value.
-    params.hierarchical_allreduce = hierarchical_allreduce_.Value();
-    params.hierarchical_allgather = hierarchical_allgather_.Value();
-    params.cache_enabled = cache_enabled_.Value();
-    params.tensor_fusion_threshold = joint_params_.Value(fusion_buffer_threshold_mb);
-    params.cycle_time = joint_params_.Value(cycle_time_ms);
-  } else {
-    // Tuning has completed, so send the best value.
-    params.hierarchical_allreduce = hierarchical_allreduce_.BestValue();
-    params.hierarchical_allgather = hierarchical_allgather_.BestValue();
-    params.cache_enabled = cache_enabled_.BestValue();
-    params.tensor_fusion_threshold = joint_params_.BestValue(fusion_buffer_threshold_mb);
-    params.cycle_time = joint_params_.BestValue(cycle_time_ms);
+/// Watch the score of the best parameters for a persistent drop.
+/// \param score The score for current timestamp
+/// \return Whether the parameter should be broadcast to other ranks.
+bool ParameterManager::Monitor(double score) {
+  // Only the coordinator decides when to tune again. As every rank counts
+  // samples the same way, all of them synchronize after each sample so that
+  // workers pick up the decision.
+  if (rank_ == root_rank_) {
+    if (baseline_score_ == 0) {
+      baseline_score_ = score;
+    } else if (score < baseline_score_ * (1 - DRIFT_TOLERANCE)) {
+      ++drift_samples_;
+      LOG(DEBUG) << "Autotuner: Score " << score << " below baseline "
+                 << baseline_score_ << " (" << drift_samples_ << "/"
+                 << DRIFT_SAMPLES << ")";
+    } else {
+      drift_samples_ = 0;
+      baseline_score_ =
+          BASELINE_DECAY * baseline_score_ + (1 - BASELINE_DECAY) * score;
+    }
+
+    if (drift_samples_ >= DRIFT_SAMPLES) {
+      LOG(INFO) << "Autotuner: Score dropped from " << baseline_score_
+                << " to " << score << ", tuning around the best parameters";
+      for (auto* param : parameter_chain_) {
+        param->BeginLocalSearch();
+      }
+      SetAutoTuning(true);
+    }
   }
 
+  return true;
+}
+
+ParameterManager::Params ParameterManager::GetParams() {
+  // While tuning the accessors return the current values, otherwise the best
+  // ones.
+  Params params;
+  params.hierarchical_allreduce = HierarchicalAllreduce();
+  params.hierarchical_allgather = HierarchicalAllgather();
+  params.cache_capacity = CacheCapacity();
+  params.num_nccl_streams = NumNCCLStreams();
+  params.tensor_fusion_threshold = double(TensorFusionThresholdBytes()) / (1024 * 1024);
+  params.cycle_time = CycleTimeMs();
+  params.hierarchical_allreduce_chunk = double(HierarchicalAllreduceChunkBytes()) / (1024 * 1024);
+  params.cpu_allreduce_latency_threshold = double(CPUAllreduceLatencyThresholdBytes()) / 1024;
   params.active = active_;
 
   return params;
 }
 
 void ParameterManager::SetParams(const Params& newParams) {
-  hierarchical_allreduce_.SetValue(newParams.hierarchical_allreduce, true);
-  hierarchical_allgather_.SetValue(newParams.hierarchical_allgather, true);
-  cache_enabled_.SetValue(newParams.cache_enabled, true);
+  SetHierarchicalAllreduce(newParams.hierarchical_allreduce, true);
+  SetHierarchicalAllgather(newParams.hierarchical_allgather, true);
+  SetCacheCapacity(newParams.cache_capacity, true);
+  SetNumNCCLStreams(newParams.num_nccl_streams, true);
   joint_params_.SetValue(fusion_buffer_threshold_mb, newParams.tensor_fusion_threshold, true);
   joint_params_.SetValue(cycle_time_ms, newParams.cycle_time, true);
-  active_ = newParams.active;
+  joint_params_.SetValue(hierarchical_allreduce_chunk_mb, newParams.hierarchical_allreduce_chunk, true);
+  joint_params_.SetValue(cpu_allreduce_latency_threshold_kb, newParams.cpu_allreduce_latency_threshold, true);
+  SetAutoTuning(newParams.active);
 }
 
 void ParameterManager::Reset() {
@@ -249,44 +439,89 @@ void ParameterManager::Reset() {
 
 void ParameterManager::LogParameters(double score) {
   if (rank_ == root_rank_) {
-    LOG(INFO) << "Autotuner: ["
-              << hierarchical_allreduce_.Value() << ", "
-              << hierarchical_allgather_.Value() << ", "
-              << cache_enabled_.Value() << ", "
-              << joint_params_.Value(cycle_time_ms) << " ms, "
-              << joint_params_.Value(fusion_buffer_threshold_mb) << " mb] "
-              << score;
+    std::string values = FormatParameters(false);
+    LOG(INFO) << "Autotuner: [" << values << "] " << score;
     if (writing_ && file_.good()) {
-      file_ << hierarchical_allreduce_.Value() << ","
-            << hierarchical_allgather_.Value() << ","
-            << cache_enabled_.Value() << ","
-            << joint_params_.Value(cycle_time_ms) << ","
-            << joint_params_.Value(fusion_buffer_threshold_mb) << ","
-            << score
-            << std::endl;
+      file_ << values << "," << score << std::endl;
+    }
+    if (!profile_file_.empty()) {
+      std::ostringstream observation;
+      observation << values << "," << score;
+      observations_.push_back(observation.str());
     }
   }
 }
 
 void ParameterManager::LogBestParameters() {
   if (rank_ == root_rank_) {
-    LOG(INFO) << "Autotuner: Best params ["
-              << hierarchical_allreduce_.BestValue() << ", "
-              << hierarchical_allgather_.BestValue() << ", "
-              << cache_enabled_.BestValue() << ", "
-              << joint_params_.BestValue(cycle_time_ms) << " ms, "
-              << joint_params_.BestValue(fusion_buffer_threshold_mb) << " mb] "
-              << hierarchical_allreduce_.BestScore();
+    std::string values = FormatParameters(true);
+    LOG(INFO) << "Autotuner: Best params [" << values << "] "
+              << joint_params_.BestScore();
     if (writing_ && file_.good()) {
-      file_ << hierarchical_allreduce_.BestValue() << ","
-            << hierarchical_allgather_.BestValue() << ","
-            << cache_enabled_.BestValue() << ","
-            << joint_params_.BestValue(cycle_time_ms) << ","
-            << joint_params_.BestValue(fusion_buffer_threshold_mb) << ","
-            << hierarchical_allreduce_.BestScore()
-            << std::endl;
+      file_ << values << "," << joint_params_.BestScore() << std::endl;
+    }
+  }
+}
+
+void ParameterManager::SaveProfile() {
+  if (rank_ != root_rank_ || profile_file_.empty()) {
+    return;
+  }
+
+  // Keep the observations of other keys.
+  std::vector<std::string> lines;
+  {
+    std::ifstream file(profile_file_);
+    std::string line;
+    while (std::getline(file, line)) {
+      if (!line.empty() && line.compare(0, profile_key_.size() + 1, profile_key_ + ",") != 0) {
+        lines.push_back(line);
+      }
     }
   }
+  if (lines.empty()) {
+    lines.push_back("key," PARAMETER_COLUMNS ",score");
+  }
+
+  // Only keep the most recent observations of this key.
+  if (observations_.size() > PROFILE_MAX_OBSERVATIONS) {
+    observations_.erase(observations_.begin(),
+                        observations_.end() - PROFILE_MAX_OBSERVATIONS);
+  }
+
+  std::ofstream file(profile_file_, std::ios::out | std::ios::trunc);
+  for (auto& line : lines) {
+    file << line << std::endl;
+  }
+  for (auto& observation : observations_) {
+    file << profile_key_ << "," << observation << std::endl;
+  }
+  if (!file.good()) {
+    LOG(WARNING) << "Autotuner: Failed to save the observations to " << profile_file_;
+  }
+}
+
+double ParameterManager::MemoryPenalty() const {
+  double gigabytes = double(TensorFusionThresholdBytes()) * NumNCCLStreams() /
+                     (1024 * 1024 * 1024);
+  return 1 + memory_weight_ * gigabytes;
+}
+
+std::string ParameterManager::FormatParameters(bool best) const {
+  auto value = [&](BayesianVariable variable) {
+    return best ? joint_params_.BestValue(variable) : joint_params_.Value(variable);
+  };
+
+  std::ostringstream out;
+  out << (value(hierarchical_allreduce_enabled) >= 0.5) << ","
+      << (value(hierarchical_allgather_enabled) >= 0.5) << ","
+      << int32_t(std::round(value(cache_capacity_k) * 1024)) << ","
+      << std::max(1, int32_t(std::round(value(nccl_streams)))) << ","
+      << value(cycle_time_ms) << ","
+      << value(fusion_buffer_threshold_mb) << ","
+      << value(hierarchical_allreduce_chunk_mb) << ","
+      << value(cpu_allreduce_latency_threshold_kb);
+  return out.str();
 }
 
 // TunableParameter
@@ -324,6 +559,17 @@ void ParameterManager::TunableParameter<T>::UpdateBestValue(double score) {
   }
 }
 
+template <class T>
+void ParameterManager::TunableParameter<T>::BeginLocalSearch() {
+  // Scores observed before the drift are stale, so the best value has to be
+  // found again.
+  value_ = best_value_;
+  best_score_ = 0;
+  if (tunable_) {
+    OnBeginLocalSearch();
+  }
+}
+
 template <class T>
 void ParameterManager::TunableParameter<T>::SetValue(T value, bool fixed) {
   best_value_ = value;
@@ -362,32 +608,6 @@ void ParameterManager::TunableParameter<T>::CompleteTuning() {
   ResetState();
 }
 
-// CategoricalParameter
-template <class T>
-ParameterManager::CategoricalParameter<T>::CategoricalParameter(std::vector<T> values) :
-    TunableParameter<T>(values[0]),
-    values_(values) {
-  ResetState();
-}
-
-template <class T>
-void ParameterManager::CategoricalParameter<T>::OnTune(double score, T& value) {
-  ++index_;
-  if (index_ < values_.size()) {
-    value = values_[index_];
-  }
-}
-
-template <class T>
-bool ParameterManager::CategoricalParameter<T>::IsDoneTuning() const {
-  return index_ >= values_.size();
-}
-
-template <class T>
-void ParameterManager::CategoricalParameter<T>::ResetState() {
-  index_ = 0;
-}
-
 // BayesianParameter
 ParameterManager::BayesianParameter::BayesianParameter(
     std::vector<BayesianVariableConfig> variables,
@@ -395,7 +615,8 @@ ParameterManager::BayesianParameter::BayesianParameter(
     TunableParameter<Eigen::VectorXd>(test_points[0]),
     variables_(variables),
     test_points_(test_points),
-    iteration_(0) {
+    iteration_(0),
+    local_search_(false) {
   ResetBayes();
   Reinitialize(FilterTestPoint(0));
   ResetState();
@@ -441,27 +662,134 @@ double ParameterManager::BayesianParameter::BestValue(BayesianVariable variable)
   return TunableParameter::BestValue()(index_.at(variable));
 }
 
+void ParameterManager::BayesianParameter::SetBounds(BayesianVariable variable,
+                                                    std::pair<double, double> bounds) {
+  for (auto& var : variables_) {
+    if (var.variable == variable) {
+      var.bounds = bounds;
+    }
+  }
+  ResetBayes();
+
+  // Move current values into the new range.
+  Eigen::VectorXd value = TunableParameter::Value();
+  Eigen::VectorXd best_value = TunableParameter::BestValue();
+  auto index = index_.find(variable);
+  if (index != index_.end()) {
+    value(index->second) = std::min(std::max(value(index->second), bounds.first), bounds.second);
+    best_value(index->second) = std::min(std::max(best_value(index->second), bounds.first), bounds.second);
+    TunableParameter::SetCurrentValue(value);
+    TunableParameter::SetBestValue(best_value);
+  }
+}
+
+void ParameterManager::BayesianParameter::WarmStart(
+    const std::vector<std::pair<Eigen::VectorXd, double>>& observations) {
+  if (!TunableParameter::IsTunable() || observations.empty()) {
+    return;
+  }
+
+  // The observations act as a prior of the Gaussian process.
+  size_t best = 0;
+  for (size_t i = 0; i < observations.size(); ++i) {
+    bayes_->AddSample(FilterPoint(observations[i].first), observations[i].second);
+    if (observations[i].second > observations[best].second) {
+      best = i;
+    }
+  }
+  Reinitialize(FilterPoint(observations[best].first));
+
+  // Skip the test points and most of the samples.
+  iteration_ = std::max<uint32_t>(BAYES_OPT_MAX_SAMPLES - WARM_START_SAMPLES,
+                                  test_points_.size());
+  ProposeAsync(TunableParameter::Value());
+}
+
 void ParameterManager::BayesianParameter::OnTune(double score, Eigen::VectorXd& value) {
+  // The proposal was computed while value was scored, without its score.
+  Eigen::VectorXd proposal;
+  bool proposed = TakeProposal(proposal);
   bayes_->AddSample(value, score);
 
   ++iteration_;
-  if (iteration_ < test_points_.size()) {
+  if (!local_search_ && iteration_ < test_points_.size()) {
     value = FilterTestPoint(iteration_);
+  } else if (proposed) {
+    value = proposal;
   } else {
     value = bayes_->NextSample();
   }
+
+  // Start on the sample after this one, unless it is a test point or tuning ends before it.
+  uint32_t max_samples =
+      local_search_ ? LOCAL_SEARCH_MAX_SAMPLES : BAYES_OPT_MAX_SAMPLES;
+  if (iteration_ < max_samples &&
+      (local_search_ || iteration_ + 1 >= test_points_.size())) {
+    ProposeAsync(value);
+  }
 }
 
 bool ParameterManager::BayesianParameter::IsDoneTuning() const {
-  return iteration_ > BAYES_OPT_MAX_SAMPLES;
+  return iteration_ >
+         (local_search_ ? LOCAL_SEARCH_MAX_SAMPLES : BAYES_OPT_MAX_SAMPLES);
+}
+
+void ParameterManager::BayesianParameter::ProposeAsync(const Eigen::VectorXd& pending) {
+  BayesianOptimization* bayes = bayes_.get();
+  proposal_ = std::async(std::launch::async, [bayes, pending]() {
+    return bayes->NextSample(true, &pending);
+  });
+}
+
+bool ParameterManager::BayesianParameter::TakeProposal(Eigen::VectorXd& value) {
+  if (!proposal_.valid()) {
+    return false;
+  }
+  if (proposal_.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+    LOG(DEBUG) << "Autotuner: Waiting for the next sample";
+  }
+  value = proposal_.get();
+  return true;
 }
 
 void ParameterManager::BayesianParameter::ResetState() {
+  Eigen::VectorXd unused;
+  TakeProposal(unused);
   iteration_ = 0;
-  bayes_->Clear();
+  if (local_search_) {
+    // Restore the full search space.
+    local_search_ = false;
+    ResetBayes();
+  } else {
+    bayes_->Clear();
+  }
+}
+
+void ParameterManager::BayesianParameter::OnBeginLocalSearch() {
+  // Start from the best value, and only search a box around it.
+  Eigen::VectorXd unused;
+  TakeProposal(unused);
+  const Eigen::VectorXd& best = TunableParameter::BestValue();
+  std::vector<std::pair<double, double>> bounds;
+  for (auto var : variables_) {
+    auto index = index_.find(var.variable);
+    if (index == index_.end()) {
+      continue;
+    }
+    double radius = (var.bounds.second - var.bounds.first) * LOCAL_SEARCH_RADIUS;
+    double center = best(index->second);
+    bounds.emplace_back(std::max(var.bounds.first, center - radius),
+                        std::min(var.bounds.second, center + radius));
+  }
+
+  bayes_.reset(new BayesianOptimization(bounds, GAUSSIAN_PROCESS_NOISE));
+  iteration_ = 0;
+  local_search_ = true;
 }
 
 void ParameterManager::BayesianParameter::ResetBayes() {
+  Eigen::VectorXd unused;
+  TakeProposal(unused);
   index_.clear();
 
   std::vector<std::pair<double, double>> bounds;
@@ -478,14 +806,19 @@ void ParameterManager::BayesianParameter::ResetBayes() {
 }
 
 Eigen::VectorXd ParameterManager::BayesianParameter::FilterTestPoint(int i) {
-  Eigen::VectorXd& test_point = test_points_[i];
+  return FilterPoint(test_points_[i]);
+}
+
+Eigen::VectorXd ParameterManager::BayesianParameter::FilterPoint(const Eigen::VectorXd& test_point) {
   Eigen::VectorXd filtered_point(test_point.size() - fixed_values_.size());
 
   int k = 0;
   for (int j = 0; j < test_point.size(); ++j) {
     BayesianVariable variable = variables_[j].variable;
     if (fixed_values_.find(variable) == fixed_values_.end()) {
-      filtered_point(k) = test_point(j);
+      // Keep test points within bounds narrowed by SetBounds.
+      filtered_point(k) = std::min(std::max(test_point(j), variables_[j].bounds.first),
+                                   variables_[j].bounds.second);
       ++k;
     }
   }
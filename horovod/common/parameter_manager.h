@@ -18,9 +18,11 @@
 
 #include <chrono>
 #include <fstream>
+#include <future>
 #include <iostream>
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include <Eigen/Core>
@@ -31,14 +33,21 @@ namespace horovod {
 namespace common {
 
 // ParameterManager encapsulates the various tunable "knobs" in Horovod including the cycle time
-// between iterations of the background thread, and the size of the fusion buffer.
+// between iterations of the background thread, the size of the fusion buffer, the hierarchical
+// modes, the response cache capacity, the number of NCCL streams and the size up to which CPU
+// allreduce uses a latency optimized algorithm.
 //
 // During the early training batches, the auto-tuning feature (if enabled) will try various
 // combinations of parameters in search of the combination that yields the highest throughput
-// in units of bytes processed per second.
+// in units of bytes processed per second, optionally penalized by the host memory it uses.
 //
 // Once the auto-tuner has converged to find the highest scoring combination of parameters, the tuning
-// will end and the returned values will always be equal to the best scoring.
+// will end and the returned values will always be equal to the best scoring. In continuous mode, the
+// manager keeps scoring the best parameters, and when the throughput drops persistently (e.g., the
+// workload or the cluster changed) it tunes again in the neighbourhood of the best parameters.
+//
+// The Bayesian optimization computes each sample on a worker thread while the previous one is
+// scored, so that the background loop of the coordinator does not stall on it.
 class ParameterManager {
 public:
   ParameterManager();
@@ -47,6 +56,15 @@ public:
   // Initializes this manager if auto tuning was requested.
   void Initialize(int32_t rank, int32_t root_rank, const std::string& file_name);
 
+  // Saves the scored parameters to file_name once tuning completes, keyed by the given key (e.g.,
+  // the cluster topology) and the histogram of the tensor sizes seen while warming up. Later
+  // tuning with the same key starts from these observations rather than from scratch.
+  void SetProfile(const std::string& file_name, const std::string& key);
+
+  // Weight of the memory taken by fusion buffers (one per NCCL stream) in the score, which is
+  // divided by 1 + weight * gigabytes. Zero only scores throughput.
+  void SetMemoryWeight(double weight);
+
   // Starts or stop the auto tuning procedure.
   void SetAutoTuning(bool active);
 
@@ -55,6 +73,16 @@ public:
     return active_;
   }
 
+  // Keeps monitoring the score once tuning completed, and tunes again around the best parameters
+  // when it drifts.
+  void SetContinuous(bool continuous);
+
+  // Returns true if Update needs to observe the processed tensors, i.e., while tuning or while
+  // monitoring for drift in continuous mode.
+  inline bool IsObserving() const {
+    return active_ || continuous_;
+  }
+
   // Do hierarchical allreduce.
   bool HierarchicalAllreduce() const;
   void SetHierarchicalAllreduce(bool value, bool fixed=false);
@@ -73,31 +101,59 @@ public:
   double CycleTimeMs() const;
   void SetCycleTimeMs(double cycle_time_ms, bool fixed=false);
 
-  // Enable response caching.
-  bool CacheEnabled() const;
-  void SetCacheEnabled (bool enabled, bool fixed=false);
+  // Capacity of the response cache, zero disables caching.
+  int32_t CacheCapacity() const;
+  void SetCacheCapacity(int32_t capacity, bool fixed=false);
+
+  // Number of NCCL streams collectives are issued on in turn, at most max_streams when tuned.
+  int32_t NumNCCLStreams() const;
+  void SetNumNCCLStreams(int32_t num_streams, bool fixed=false);
+  void SetMaxNumNCCLStreams(int32_t max_streams);
+
+  // Size of the chunks the cross-node phase of hierarchical allreduce is pipelined in, zero
+  // disables chunking.
+  int64_t HierarchicalAllreduceChunkBytes() const;
+  void SetHierarchicalAllreduceChunkBytes(int64_t chunk_bytes, bool fixed=false);
+
+  // Size up to which MPI and Gloo allreduce of CPU buffers take a logarithmic number of steps
+  // (recursive doubling, bcube) rather than the bandwidth optimal ring, zero always uses the ring.
+  int64_t CPUAllreduceLatencyThresholdBytes() const;
+  void SetCPUAllreduceLatencyThresholdBytes(int64_t threshold, bool fixed=false);
 
   // Observes that the given tensors have been processed (e.g., allreduced) over the given number of microseconds.
   //
   // Args:
   //  tensor_names: The names of the tensors that have been processed.
-  //  bytes: The number of bytes that were processed per worker.
+  //  tensor_sizes: The number of bytes of each tensor that were processed per worker.
   //
   // Return:
   //  Whether the parameters need to be broadcasted to all ranks.
-  bool Update(const std::vector<std::string>& tensor_names, int64_t bytes);
+  bool Update(const std::vector<std::string>& tensor_names, const std::vector<int64_t>& tensor_sizes);
 
   struct Params {
     bool hierarchical_allreduce;
     bool hierarchical_allgather;
-    bool cache_enabled;
+    int32_t cache_capacity;
+    int32_t num_nccl_streams;
     double tensor_fusion_threshold;
     double cycle_time;
+    double hierarchical_allreduce_chunk;
+    double cpu_allreduce_latency_threshold;
     bool active;
   };
 
   Params GetParams();
 
+  // Values set at runtime through horovod_set_parameters. Negative values
+  // leave the current ones unchanged.
+  struct Overrides {
+    int64_t tensor_fusion_threshold_bytes = -1;
+    double cycle_time_ms = -1;
+    int32_t cache_capacity = -1;
+    int hierarchical_allreduce = -1;
+    int hierarchical_allgather = -1;
+  };
+
   // Using given params to update its own params.
   void SetParams(const Params& newParams);
 
@@ -108,10 +164,28 @@ private:
   // Adjusts the parameter values based on the last observed score.
   bool Tune(double score);
 
+  // Compares the last observed score of the best parameters to the baseline, and starts a local
+  // search once the score dropped for several samples in a row.
+  bool Monitor(double score);
+
   // Outputs parameter values and writes results to a log file (if provided).
   void LogParameters(double score);
   void LogBestParameters();
 
+  // Completes the profile key with the tensor size histogram, and warm starts from the
+  // observations saved for it in profile_file_, if any.
+  void LoadProfile();
+
+  // Replaces the observations of the profile key in profile_file_ with the previous and the
+  // current ones.
+  void SaveProfile();
+
+  // Factor the score is divided by for the memory taken by the current parameters.
+  double MemoryPenalty() const;
+
+  // Comma separated values of the current or best parameters, in the order of the log columns.
+  std::string FormatParameters(bool best) const;
+
   // Interface used to represent a parameter (or group of parameters) being tuned.
   class ITunableParameter {
   public:
@@ -119,6 +193,9 @@ private:
     virtual void UpdateBestValue(double score) = 0;
     virtual double BestScore() const = 0;
     virtual bool IsTunable() const = 0;
+
+    // Restarts tuning from the best value, only exploring values close to it.
+    virtual void BeginLocalSearch() = 0;
   };
 
   // Abstract base class used to implement hierarchical parameter tuning.
@@ -128,6 +205,7 @@ private:
     TunableParameter(T initial_value);
     bool Tune(double score, double* best_score) override;
     void UpdateBestValue(double score) override;
+    void BeginLocalSearch() override;
 
     void SetValue(T value, bool fixed);
     inline T Value() const { return value_; };
@@ -150,6 +228,7 @@ private:
     virtual void OnTune(double score, T& value) = 0;
     virtual bool IsDoneTuning() const = 0;
     virtual void ResetState() = 0;
+    virtual void OnBeginLocalSearch() = 0;
 
     T initial_value_;
     T value_;
@@ -160,23 +239,18 @@ private:
     bool tunable_;
   };
 
-  // A parameter that optimizes over a finite set of discrete values to be tried sequentially.
-  template <class T>
-  class CategoricalParameter : public TunableParameter<T> {
-  public:
-    CategoricalParameter(std::vector<T> values);
-
-  private:
-    void OnTune(double score, T& value);
-    bool IsDoneTuning() const;
-    void ResetState();
-
-    std::vector<T> values_;
-    uint32_t index_;
+  // Flags are searched over [0, 1] and enabled from 0.5, counts are rounded.
+  enum BayesianVariable {
+    fusion_buffer_threshold_mb,
+    cycle_time_ms,
+    hierarchical_allreduce_enabled,
+    hierarchical_allgather_enabled,
+    cache_capacity_k,
+    nccl_streams,
+    hierarchical_allreduce_chunk_mb,
+    cpu_allreduce_latency_threshold_kb
   };
 
-  enum BayesianVariable { fusion_buffer_threshold_mb, cycle_time_ms };
-
   struct BayesianVariableConfig {
     BayesianVariable variable;
     std::pair<double, double> bounds;
@@ -191,17 +265,35 @@ private:
     double Value(BayesianVariable variable) const;
     double BestValue(BayesianVariable variable) const;
 
+    // Limits the search range of a variable that is not fixed.
+    void SetBounds(BayesianVariable variable, std::pair<double, double> bounds);
+
+    // Adds observations (with a value for every variable) of an earlier tuning to the optimizer,
+    // and continues from the best of them with fewer samples and no test points.
+    void WarmStart(const std::vector<std::pair<Eigen::VectorXd, double>>& observations);
+
   private:
     void OnTune(double score, Eigen::VectorXd& value);
     bool IsDoneTuning() const;
     void ResetState();
+    void OnBeginLocalSearch();
     void ResetBayes();
+
+    // Starts computing the sample that follows pending, the value about to be scored, on a worker
+    // thread, so that the Gaussian process fit and the acquisition search run while the training
+    // loop goes on.
+    void ProposeAsync(const Eigen::VectorXd& pending);
+
+    // Waits for the sample being computed, if any, and returns whether there was one.
+    bool TakeProposal(Eigen::VectorXd& value);
     Eigen::VectorXd FilterTestPoint(int i);
+    Eigen::VectorXd FilterPoint(const Eigen::VectorXd& point);
     Eigen::VectorXd Remove(const Eigen::VectorXd& v, int index);
 
     std::vector<BayesianVariableConfig> variables_;
     std::vector<Eigen::VectorXd> test_points_;
     uint32_t iteration_;
+    bool local_search_;
 
     struct EnumClassHash {
       template <typename T>
@@ -210,20 +302,23 @@ private:
       }
     };
 
+    // Only the worker uses bayes_ while a proposal is pending.
     std::unique_ptr<BayesianOptimization> bayes_;
+    std::future<Eigen::VectorXd> proposal_;
     std::unordered_map<BayesianVariable, double, EnumClassHash> fixed_values_;
     std::unordered_map<BayesianVariable, int32_t, EnumClassHash> index_;
   };
 
-  CategoricalParameter<bool> hierarchical_allreduce_;
-  CategoricalParameter<bool> hierarchical_allgather_;
-  CategoricalParameter<bool> cache_enabled_;
   BayesianParameter joint_params_;
 
   std::vector<ITunableParameter*> parameter_chain_;
   bool active_;
   int32_t warmup_remaining_;
 
+  bool continuous_;
+  double baseline_score_;
+  int32_t drift_samples_;
+
   static constexpr int SAMPLES = 5;
   double scores_[SAMPLES];
   int32_t sample_;
@@ -237,6 +332,17 @@ private:
   std::ofstream file_;
   bool writing_;
 
+  std::string profile_file_;
+  std::string profile_key_;
+  bool profile_loaded_;
+  // Distinct tensors seen until the profile is loaded, and their count per power of two size.
+  std::unordered_set<std::string> sized_tensors_;
+  std::vector<int32_t> size_histogram_;
+  // Lines of the profile file for profile_key_: loaded ones followed by the ones scored since.
+  std::vector<std::string> observations_;
+
+  double memory_weight_;
+
 };
 
 } // namespace common
@@ -0,0 +1,67 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "process_set.h"
+
+#include <algorithm>
+
+namespace horovod {
+namespace common {
+
+bool ProcessSet::IsMember(int global_rank) const {
+  return std::binary_search(ranks.begin(), ranks.end(), global_rank);
+}
+
+int32_t ProcessSetTable::Register(std::vector<int> ranks, int global_rank,
+                                  int global_size) {
+  std::sort(ranks.begin(), ranks.end());
+  if (ranks.empty() || ranks.front() < 0 || ranks.back() >= global_size ||
+      std::adjacent_find(ranks.begin(), ranks.end()) != ranks.end()) {
+    return -1;
+  }
+
+  std::lock_guard<std::mutex> guard(mutex_);
+  for (auto& it : sets_) {
+    if (it.second->ranks == ranks) {
+      return it.first;
+    }
+  }
+
+  auto set = std::make_shared<ProcessSet>();
+  set->id = next_id_++;
+  set->ranks = std::move(ranks);
+  auto pos = std::lower_bound(set->ranks.begin(), set->ranks.end(),
+                              global_rank);
+  if (pos != set->ranks.end() && *pos == global_rank) {
+    set->rank = (int)(pos - set->ranks.begin());
+  }
+  sets_[set->id] = set;
+  return set->id;
+}
+
+std::shared_ptr<const ProcessSet> ProcessSetTable::Get(int32_t id) const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto it = sets_.find(id);
+  return it == sets_.end() ? nullptr : it->second;
+}
+
+void ProcessSetTable::Clear() {
+  std::lock_guard<std::mutex> guard(mutex_);
+  sets_.clear();
+  next_id_ = 1;
+}
+
+} // namespace common
+} // namespace horovod
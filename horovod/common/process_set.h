@@ -0,0 +1,68 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HOROVOD_PROCESS_SET_H
+#define HOROVOD_PROCESS_SET_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace horovod {
+namespace common {
+
+// A subset of the global ranks that reduces tensors among itself. Tensors of
+// different sets are negotiated in the same cycle, but counted, fused and
+// executed per set, so disjoint sets make progress concurrently.
+struct ProcessSet {
+  // Identifier shared by all ranks; 0 is reserved for the global set.
+  int32_t id = 0;
+  // Sorted global ranks of the members.
+  std::vector<int> ranks;
+  // Rank of this process within the set, or -1 if it is not a member.
+  int rank = -1;
+
+  int Size() const { return (int)ranks.size(); }
+  bool IsMember(int global_rank) const;
+};
+
+// Process sets registered on this rank. Every rank must register the same
+// sets in the same order so that the ids agree.
+class ProcessSetTable {
+public:
+  // Registers the set of the given global ranks and returns its id, or the
+  // id of an already registered set with the same ranks. Returns -1 if the
+  // ranks are empty, out of range or duplicated.
+  int32_t Register(std::vector<int> ranks, int global_rank, int global_size);
+
+  // Returns the set with the given id, or nullptr if it is not registered.
+  std::shared_ptr<const ProcessSet> Get(int32_t id) const;
+
+  void Clear();
+
+private:
+  mutable std::mutex mutex_;
+
+  std::unordered_map<int32_t, std::shared_ptr<const ProcessSet>> sets_;
+
+  int32_t next_id_ = 1;
+};
+
+} // namespace common
+} // namespace horovod
+
+#endif // HOROVOD_PROCESS_SET_H
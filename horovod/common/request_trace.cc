@@ -0,0 +1,79 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "request_trace.h"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+namespace horovod {
+namespace common {
+
+namespace {
+
+const char TRACE_MAGIC[] = "HVDREQT1";
+const size_t TRACE_MAGIC_LENGTH = sizeof(TRACE_MAGIC) - 1;
+
+} // namespace
+
+RequestTraceWriter::RequestTraceWriter(const std::string& file_name)
+    : file_(file_name, std::ios::binary | std::ios::trunc) {
+  if (!file_) {
+    throw std::runtime_error("Could not create request trace " + file_name +
+                             ".");
+  }
+  file_.write(TRACE_MAGIC, TRACE_MAGIC_LENGTH);
+}
+
+void RequestTraceWriter::WriteCycle(const RequestList& request_list) {
+  RequestList::SerializeToString(request_list, buffer_);
+  auto length = (uint32_t)buffer_.size();
+  unsigned char header[4] = {
+      (unsigned char)length, (unsigned char)(length >> 8),
+      (unsigned char)(length >> 16), (unsigned char)(length >> 24)};
+  file_.write(reinterpret_cast<const char*>(header), sizeof(header));
+  file_.write(buffer_.data(), buffer_.size());
+}
+
+RequestTraceReader::RequestTraceReader(const std::string& file_name)
+    : file_(file_name, std::ios::binary) {
+  char magic[TRACE_MAGIC_LENGTH];
+  if (!file_ || !file_.read(magic, TRACE_MAGIC_LENGTH) ||
+      std::memcmp(magic, TRACE_MAGIC, TRACE_MAGIC_LENGTH) != 0) {
+    throw std::runtime_error("Could not read request trace " + file_name +
+                             ".");
+  }
+}
+
+bool RequestTraceReader::ReadCycle(RequestList& request_list) {
+  unsigned char header[4];
+  if (!file_.read(reinterpret_cast<char*>(header), sizeof(header))) {
+    return false;
+  }
+  uint32_t length = (uint32_t)header[0] | ((uint32_t)header[1] << 8) |
+                    ((uint32_t)header[2] << 16) | ((uint32_t)header[3] << 24);
+  buffer_.resize(length);
+  if (!file_.read(&buffer_[0], length)) {
+    return false;
+  }
+  request_list = RequestList();
+  RequestList::ParseFromBytes(request_list,
+                              reinterpret_cast<const uint8_t*>(buffer_.data()));
+  return true;
+}
+
+} // namespace common
+} // namespace horovod
@@ -0,0 +1,63 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HOROVOD_REQUEST_TRACE_H
+#define HOROVOD_REQUEST_TRACE_H
+
+#include <fstream>
+#include <string>
+
+#include "message.h"
+
+namespace horovod {
+namespace common {
+
+// Trace of the requests a rank submits, one record per negotiation cycle
+// with the requests that entered its tensor queue since the previous cycle,
+// so that the control plane of a job can be replayed offline. A trace file
+// starts with a magic string, followed for every cycle by the length of the
+// request list as a little endian 32-bit integer and the request list in its
+// wire format.
+class RequestTraceWriter {
+public:
+  // Throws std::runtime_error if the file cannot be created.
+  explicit RequestTraceWriter(const std::string& file_name);
+
+  void WriteCycle(const RequestList& request_list);
+
+private:
+  std::ofstream file_;
+  std::string buffer_;
+};
+
+class RequestTraceReader {
+public:
+  // Throws std::runtime_error if the file cannot be opened or is not a
+  // request trace.
+  explicit RequestTraceReader(const std::string& file_name);
+
+  // Reads the requests of the next cycle, and returns false at the end of
+  // the trace.
+  bool ReadCycle(RequestList& request_list);
+
+private:
+  std::ifstream file_;
+  std::string buffer_;
+};
+
+} // namespace common
+} // namespace horovod
+
+#endif // HOROVOD_REQUEST_TRACE_H
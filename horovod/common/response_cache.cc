@@ -15,8 +15,11 @@
 
 #include "response_cache.h"
 
+#include <algorithm>
 #include <climits>
 #include <cstring>
+#include <functional>
+#include <stdexcept>
 
 #include "controller.h"
 #include "logging.h"
@@ -27,36 +30,236 @@ namespace common {
 
 void ResponseCache::clear() {
   bits_outdated_ = false;
-  cache_.clear();
-  cache_iters_.clear();
-  tensor_name_to_bit_.clear();
+  ++generation_;
+  for (auto& entry : entries_) {
+    if (entry.in_use) {
+      released_tensor_ids_.push_back(entry.params.tensor_id);
+    }
+  }
+  entries_.clear();
+  size_ = 0;
+  lru_newest_ = -1;
+  lru_oldest_ = -1;
+  free_bits_.clear();
+  for (auto& slot : name_table_) {
+    slot = NameSlot();
+  }
+  tensor_id_to_bit_.clear();
+  start_window();
+}
+
+void ResponseCache::start_window() {
+  ++window_;
+  window_bits_ = 0;
 }
 
 void ResponseCache::set_capacity(uint32_t capacity) {
   // Clear cache in case set_capacity is called multiple times if autotuning.
-  // Only clear if capacity is modified.
+  // Only clear if capacity is modified. Entries keep their bits when the
+  // cache grows, so the ranks growing it together keep agreeing on them.
+  bool grow = capacity > capacity_ && capacity_ > 0;
   if (capacity != capacity_) {
-    this->clear();
+    if (!grow) {
+      this->clear();
+    }
+    evicted_names_.clear();
+    reput_after_eviction_ = 0;
   }
 
   capacity_ = capacity;
-  cache_iters_.reserve(capacity);
+  entries_.reserve(capacity);
+  free_bits_.reserve(capacity);
+
+  size_t table_size = 16;
+  while (table_size < 2 * (size_t)capacity) {
+    table_size *= 2;
+  }
+  if (table_size != name_table_.size()) {
+    name_table_.assign(table_size, NameSlot());
+    for (size_t bit = 0; bit < entries_.size(); ++bit) {
+      if (entries_[bit].in_use) {
+        insert_name(entries_[bit].response.tensor_names()[0], (uint32_t)bit);
+      }
+    }
+  }
 }
 
 uint32_t ResponseCache::capacity() const { return capacity_; }
 
-size_t ResponseCache::num_active_bits() const { return cache_iters_.size(); }
+size_t ResponseCache::num_active_bits() const { return entries_.size(); }
+
+size_t ResponseCache::find_name_slot(const std::string& tensor_name,
+                                     size_t hash) const {
+  size_t mask = name_table_.size() - 1;
+  size_t i = hash & mask;
+  while (name_table_[i].cache_bit >= 0) {
+    if (name_table_[i].hash == hash &&
+        entries_[name_table_[i].cache_bit].response.tensor_names()[0] ==
+            tensor_name) {
+      break;
+    }
+    i = (i + 1) & mask;
+  }
+  return i;
+}
+
+bool ResponseCache::find_name(const std::string& tensor_name,
+                              uint32_t& cache_bit) const {
+  if (size_ == 0) {
+    return false;
+  }
+  auto& slot = name_table_[find_name_slot(
+      tensor_name, std::hash<std::string>()(tensor_name))];
+  if (slot.cache_bit < 0) {
+    return false;
+  }
+  cache_bit = (uint32_t)slot.cache_bit;
+  return true;
+}
+
+void ResponseCache::insert_name(const std::string& tensor_name,
+                                uint32_t cache_bit) {
+  size_t hash = std::hash<std::string>()(tensor_name);
+  auto& slot = name_table_[find_name_slot(tensor_name, hash)];
+  slot.hash = hash;
+  slot.cache_bit = (int32_t)cache_bit;
+}
+
+void ResponseCache::erase_name(const std::string& tensor_name) {
+  size_t mask = name_table_.size() - 1;
+  size_t i = find_name_slot(tensor_name, std::hash<std::string>()(tensor_name));
+  if (name_table_[i].cache_bit < 0) {
+    return;
+  }
+  // Shift back the following slots of the probe sequence that would no
+  // longer be reachable, so that no tombstones are needed.
+  size_t j = i;
+  while (true) {
+    j = (j + 1) & mask;
+    if (name_table_[j].cache_bit < 0) {
+      break;
+    }
+    // The slot at j stays if its home slot lies cyclically in (i, j].
+    size_t home = name_table_[j].hash & mask;
+    if (i <= j ? (i < home && home <= j) : (i < home || home <= j)) {
+      continue;
+    }
+    name_table_[i] = name_table_[j];
+    i = j;
+  }
+  name_table_[i] = NameSlot();
+}
+
+bool ResponseCache::find_cache_bit(const Request& message,
+                                   uint32_t& cache_bit) const {
+  // Every cached entry has its tensor ID set, so the ID table is
+  // authoritative for requests that carry one.
+  if (message.tensor_id() >= 0) {
+    if ((size_t)message.tensor_id() >= tensor_id_to_bit_.size() ||
+        tensor_id_to_bit_[message.tensor_id()] < 0) {
+      return false;
+    }
+    cache_bit = (uint32_t)tensor_id_to_bit_[message.tensor_id()];
+    return true;
+  }
+
+  return find_name(message.tensor_name(), cache_bit);
+}
+
+void ResponseCache::set_tensor_id_bit(int32_t tensor_id, int32_t cache_bit) {
+  if (tensor_id < 0) {
+    return;
+  }
+  if ((size_t)tensor_id >= tensor_id_to_bit_.size()) {
+    tensor_id_to_bit_.resize(tensor_id + 1, -1);
+  }
+  tensor_id_to_bit_[tensor_id] = cache_bit;
+}
+
+void ResponseCache::lru_unlink(int32_t cache_bit) {
+  auto& entry = entries_[cache_bit];
+  if (entry.newer >= 0) {
+    entries_[entry.newer].older = entry.older;
+  } else {
+    lru_newest_ = entry.older;
+  }
+  if (entry.older >= 0) {
+    entries_[entry.older].newer = entry.newer;
+  } else {
+    lru_oldest_ = entry.newer;
+  }
+  entry.newer = -1;
+  entry.older = -1;
+}
+
+void ResponseCache::lru_push_front(int32_t cache_bit) {
+  auto& entry = entries_[cache_bit];
+  if (entry.window != window_) {
+    entry.window = window_;
+    ++window_bits_;
+  }
+  entry.newer = -1;
+  entry.older = lru_newest_;
+  if (lru_newest_ >= 0) {
+    entries_[lru_newest_].newer = cache_bit;
+  } else {
+    lru_oldest_ = cache_bit;
+  }
+  lru_newest_ = cache_bit;
+}
+
+uint32_t ResponseCache::allocate_bit() {
+  if (!free_bits_.empty()) {
+    std::pop_heap(free_bits_.begin(), free_bits_.end(),
+                  std::greater<uint32_t>());
+    uint32_t cache_bit = free_bits_.back();
+    free_bits_.pop_back();
+    if (cache_bit < entries_.size()) {
+      return cache_bit;
+    }
+    // The lowest free bit was dropped by update_cache_bits, so are all
+    // others.
+    free_bits_.clear();
+  }
+  entries_.emplace_back();
+  return (uint32_t)(entries_.size() - 1);
+}
+
+void ResponseCache::release_bit(uint32_t cache_bit) {
+  auto& entry = entries_[cache_bit];
+  lru_unlink(cache_bit);
+  erase_name(entry.response.tensor_names()[0]);
+  set_tensor_id_bit(entry.params.tensor_id, -1);
+  released_tensor_ids_.push_back(entry.params.tensor_id);
+  entry.in_use = false;
+  --size_;
+  ++generation_;
+}
+
+ResponseCache::CacheState
+ResponseCache::compare_params(uint32_t cache_bit,
+                              const TensorParams& params) const {
+  auto& cache_params = entries_[cache_bit].params;
+  return (cache_params.device == params.device &&
+          cache_params.dtype == params.dtype &&
+          cache_params.shape == params.shape &&
+          cache_params.reduce_op == params.reduce_op &&
+          cache_params.compression == params.compression)
+             ? CacheState::HIT
+             : CacheState::INVALID;
+}
 
 ResponseCache::CacheState ResponseCache::cached(const Request& message) const {
-  auto it = tensor_name_to_bit_.find(message.tensor_name());
-  if (it != tensor_name_to_bit_.end()) {
+  uint32_t cache_bit;
+  if (find_cache_bit(message, cache_bit)) {
     // If entry associated with this request already exists in cache, check
     // if tensor parameters match. If not, return that entry is invalid.
-    uint32_t cache_bit = it->second;
-    auto& cache_params = std::get<1>(*cache_iters_[cache_bit]);
+    auto& cache_params = entries_[cache_bit].params;
     return (cache_params.device == message.device() &&
             cache_params.dtype == message.tensor_type() &&
-            cache_params.shape == message.tensor_shape())
+            cache_params.shape == message.tensor_shape() &&
+            cache_params.reduce_op == message.reduce_op() &&
+            cache_params.compression == message.compression())
                ? CacheState::HIT
                : CacheState::INVALID;
   } else {
@@ -68,82 +271,85 @@ ResponseCache::CacheState
 ResponseCache::cached(const Response& response,
                       const TensorParams& params) const {
   assert(response.tensor_names().size() == 1);
-  auto it = tensor_name_to_bit_.find(response.tensor_names()[0]);
-  if (it != tensor_name_to_bit_.end()) {
+  uint32_t cache_bit;
+  if (find_name(response.tensor_names()[0], cache_bit)) {
     // If entry associated with this response already exists in cache, check
     // if tensor parameters match. If not, return that entry is invalid.
-    uint32_t cache_bit = it->second;
-    auto& cache_params = std::get<1>(*cache_iters_[cache_bit]);
-    return (cache_params.device == params.device &&
-            cache_params.dtype == params.dtype &&
-            cache_params.shape == params.shape)
-               ? CacheState::HIT
-               : CacheState::INVALID;
+    return compare_params(cache_bit, params);
   } else {
     return CacheState::MISS;
   }
 }
 
 void ResponseCache::put_(const Response& response, TensorParams& params) {
-  // Note: This method invalidates all previously returned cache bit positions.
+  // Note: This method reuses the cache bit of an evicted entry.
 
   uint32_t cache_bit;
-  auto cache_state = this->cached(response, params);
+  bool found = find_name(response.tensor_names()[0], cache_bit);
 
   // Disallow caching name-conflicted responses here. Invalid cache entries
   // must be removed prior to caching new entries.
-  if (cache_state == CacheState::INVALID) {
+  if (found && compare_params(cache_bit, params) == CacheState::INVALID) {
     throw std::logic_error(
         "Trying to overwrite cached response with existing name. "
         "This is not allowed.");
   }
 
-  if (this->cached(response, params) == CacheState::HIT) {
-    // If entry already exists, move entry to front of cache_
-    // (most recently used) and update iterator in cache_iters_
-    // at the existing cache bit position.
-    cache_bit = tensor_name_to_bit_[response.tensor_names()[0]];
-    auto it = cache_iters_[cache_bit];
-    cache_.push_front(std::move(*it));
-    cache_.erase(it);
-  } else if (cache_.size() == capacity_) {
-    if (print_warning_) {
+  if (found) {
+    // If entry already exists, move it to the front of the LRU list (most
+    // recently used). It keeps its cache bit, and its entry already holds
+    // the tensor ID.
+    lru_unlink(cache_bit);
+    lru_push_front(cache_bit);
+    released_tensor_ids_.push_back(params.tensor_id);
+    return;
+  }
+
+  auto& tensor_name = response.tensor_names()[0];
+  if (evicted_names_.erase(std::hash<std::string>()(tensor_name)) > 0) {
+    ++reput_after_eviction_;
+  }
+
+  if (size_ == capacity_) {
+    if (print_warning_ && capacity_ >= max_capacity_) {
       std::stringstream message;
       message << "A response has been evicted from cache which may indicate "
                  "reduced performance. Better performance may be obtained by "
                  "disabling caching (HOROVOD_CACHE_CAPACITY=0) or increasing "
-                 "the cache capacity (HOROVOD_CACHE_CAPACITY>"
+                 "the cache capacity ("
+              << (max_capacity_ > 0 ? "HOROVOD_CACHE_CAPACITY_MAX>"
+                                    : "HOROVOD_CACHE_CAPACITY>")
               << std::to_string(capacity_) << ").";
       LOG(WARNING) << message.str();
       print_warning_ = false;
     }
-    // If this is a new entry but cache is at capacity, evict entry at
-    // the back of cache_ (least recently used) and add new entry to front
-    // of cache_. New entry inherits cache bit position from evicted entry
-    // and sets iterator in cache_iters_ accordingly.
-    auto& entry = cache_.back().first;
-    cache_bit = tensor_name_to_bit_[entry.tensor_names()[0]];
-    tensor_name_to_bit_.erase(entry.tensor_names()[0]);
-    cache_.pop_back();
-    cache_.push_front(std::make_pair(response, std::move(params)));
+    // If this is a new entry but cache is at capacity, evict the least
+    // recently used entry. The new entry inherits its cache bit.
+    cache_bit = (uint32_t)lru_oldest_;
+    if (evicted_names_.size() >= capacity_) {
+      evicted_names_.clear();
+    }
+    evicted_names_.insert(std::hash<std::string>()(
+        entries_[cache_bit].response.tensor_names()[0]));
+    release_bit(cache_bit);
   } else {
-    // New entry added to front of cache_. Entry is associated with
-    // the next available position in cache_iters_ vector.
-    cache_bit = cache_iters_.size();
-    cache_iters_.resize(cache_bit + 1);
-    cache_.push_front(std::make_pair(response, std::move(params)));
+    // New entry gets the lowest unused cache bit.
+    cache_bit = allocate_bit();
   }
 
-  cache_iters_[cache_bit] = cache_.begin();
-  tensor_name_to_bit_[response.tensor_names()[0]] = cache_bit;
-
-  // Cache is mutated, mark that bit assignments are stale.
-  bits_outdated_ = true;
+  auto& entry = entries_[cache_bit];
+  entry.response = response;
+  entry.params = std::move(params);
+  entry.in_use = true;
+  ++size_;
+  lru_push_front(cache_bit);
+  insert_name(entry.response.tensor_names()[0], cache_bit);
+  set_tensor_id_bit(entry.params.tensor_id, cache_bit);
+  ++generation_;
 }
 
 void ResponseCache::put(const Response& response, TensorQueue& tensor_queue) {
-  // Note: This method invalidates all previously returned cache bit positions
-  // if evictions occur.
+  // Note: This method reuses the cache bits of evicted entries.
 
   if (capacity_ == 0) {
     return;
@@ -151,12 +357,26 @@ void ResponseCache::put(const Response& response, TensorQueue& tensor_queue) {
 
   // If response is fused, split back into individual responses
   if (response.tensor_names().size() > 1) {
-    for (auto& name : response.tensor_names()) {
+    // Fused allgathers hold the sizes of every rank for each tensor in turn.
+    bool is_allgather =
+        response.response_type() == Response::ResponseType::ALLGATHER;
+    size_t sizes_per_tensor =
+        response.tensor_sizes().size() / response.tensor_names().size();
+    for (size_t i = 0; i < response.tensor_names().size(); ++i) {
+      auto& name = response.tensor_names()[i];
       Response new_response;
       new_response.add_tensor_name(name);
       new_response.set_response_type(response.response_type());
       new_response.set_devices(response.devices());
-      new_response.set_tensor_sizes(response.tensor_sizes());
+      if (is_allgather) {
+        auto sizes = response.tensor_sizes().begin() + i * sizes_per_tensor;
+        new_response.set_tensor_sizes(
+            std::vector<int64_t>(sizes, sizes + sizes_per_tensor));
+      } else {
+        new_response.set_tensor_sizes(response.tensor_sizes());
+      }
+      new_response.set_reduce_op(response.reduce_op());
+      new_response.set_compression(response.compression());
 
       // Populate tensor parameters from tensor_queue entry
       const auto& tensor_entry = tensor_queue.GetTensorEntry(name);
@@ -164,6 +384,9 @@ void ResponseCache::put(const Response& response, TensorQueue& tensor_queue) {
       params.device = tensor_entry.device;
       params.dtype = tensor_entry.tensor->dtype();
       params.shape = tensor_entry.tensor->shape().to_vector();
+      params.reduce_op = tensor_entry.reduce_op;
+      params.compression = tensor_entry.compression;
+      params.tensor_id = tensor_queue.AcquireTensorId(name);
 
       this->put_(new_response, params);
     }
@@ -174,99 +397,180 @@ void ResponseCache::put(const Response& response, TensorQueue& tensor_queue) {
     params.device = tensor_entry.device;
     params.dtype = tensor_entry.tensor->dtype();
     params.shape = tensor_entry.tensor->shape().to_vector();
+    params.reduce_op = tensor_entry.reduce_op;
+    params.compression = tensor_entry.compression;
+    params.tensor_id = tensor_queue.AcquireTensorId(response.tensor_names()[0]);
 
     this->put_(response, params);
   }
 }
 
 const Response& ResponseCache::get_response(uint32_t cache_bit) {
-  assert(cache_bit < cache_iters_.size());
+  assert(cache_bit < entries_.size() && entries_[cache_bit].in_use);
 
-  // Access entry from iterator at cache_bit position. Entry
-  // is moved to front of cache and iterator at the cache_bit
-  // position is updated.
-  auto it = cache_iters_[cache_bit];
-  cache_.push_front(std::move(*it));
-  cache_.erase(it);
-  cache_iters_[cache_bit] = cache_.begin();
-
-  // Cache is mutated, mark that bit assignments are stale.
-  bits_outdated_ = true;
-
-  return cache_.front().first;
+  // Access entry at cache_bit position and move it to the front of the LRU
+  // list.
+  lru_unlink(cache_bit);
+  lru_push_front(cache_bit);
+  return entries_[cache_bit].response;
 }
 
 const Response& ResponseCache::peek_response(uint32_t cache_bit) const {
-  assert(cache_bit < cache_iters_.size());
-  return std::get<0>(*cache_iters_[cache_bit]);
+  assert(cache_bit < entries_.size() && entries_[cache_bit].in_use);
+  return entries_[cache_bit].response;
 }
 
 uint32_t ResponseCache::peek_cache_bit(const Request& message) const {
   assert(this->cached(message));
-  return tensor_name_to_bit_.at(message.tensor_name());
+  uint32_t cache_bit = 0;
+  find_cache_bit(message, cache_bit);
+  return cache_bit;
 }
 
 uint32_t ResponseCache::peek_cache_bit(const std::string& tensor_name) const {
-  return tensor_name_to_bit_.at(tensor_name);
+  uint32_t cache_bit;
+  if (!find_name(tensor_name, cache_bit)) {
+    throw std::out_of_range("Tensor " + tensor_name + " is not cached.");
+  }
+  return cache_bit;
 }
 
 void ResponseCache::erase_response(uint32_t cache_bit) {
-  assert(cache_bit < cache_iters_.size());
-
-  // Erase entry from iterator at cache_bit position and set
-  // iterator at cache_bit position to a null value.
-  // We do not resize/compact cache_iters_ vector here to preserve
-  // cache bit positions of existing entries. cache_iters_ is resized
-  // and cache bit posiions are reset *only* when update_cache_bits
-  // function is called.
-  auto it = cache_iters_[cache_bit];
-  tensor_name_to_bit_.erase(it->first.tensor_names()[0]);
-  cache_.erase(it);
-
-  cache_iters_[cache_bit] = cache_.end();
-
-  // Cache is mutated, mark that bit assignments are stale.
+  assert(cache_bit < entries_.size() && entries_[cache_bit].in_use);
+
+  // The cache bit is not reused by another entry before the next put, and
+  // unused bits are only dropped from the end of the bit range when
+  // update_cache_bits is called, so bit positions of other entries are
+  // preserved.
+  release_bit(cache_bit);
+  free_bits_.push_back(cache_bit);
+  std::push_heap(free_bits_.begin(), free_bits_.end(),
+                 std::greater<uint32_t>());
+
+  // Unused bits may be left at the end of the bit range.
   bits_outdated_ = true;
 }
 
 void ResponseCache::update_cache_bits() {
-  // Note: This method invalidates all previously returned cache bit positions.
-
-  // If bit assignments are not stale, do nothing.
+  // If no entries were erased, do nothing.
   if (!bits_outdated_) {
     return;
   }
 
-  // Iterate over current cache_ list and reassign cache bits by current
-  // position. This is done by updating iterators in cache_iters_ vector
-  // and tensor name to cache bit pairings in tensor_name_to_bit_ map.
-  // Cache bits are assigned to least recently used get lower indices.
-  auto it = --cache_.end();
-  for (int i = 0; i < (int)cache_.size(); ++i) {
-    cache_iters_[i] = it;
-    tensor_name_to_bit_[it->first.tensor_names()[0]] = i;
-    --it;
+  // Shrink the bit range to the last entry in use. The free bits dropped
+  // here are discarded by allocate_bit.
+  while (!entries_.empty() && !entries_.back().in_use) {
+    entries_.pop_back();
   }
 
-  // Erased entries may result in unused positions in cache_iters_ vector.
-  // Resize to contain only valid bit positions.
-  cache_iters_.resize(cache_.size());
-
   bits_outdated_ = false;
 }
 
+void ResponseCache::release_tensor_ids(TensorQueue& tensor_queue) {
+  if (released_tensor_ids_.empty()) {
+    return;
+  }
+  tensor_queue.ReleaseTensorIds(released_tensor_ids_);
+  released_tensor_ids_.clear();
+}
+
+uint64_t ResponseCache::fingerprint() const {
+  // FNV-1a over the fields that make up a cache entry.
+  uint64_t hash = 14695981039346656037ULL;
+  auto add = [&hash](const void* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+      hash = (hash ^ ((const uint8_t*)data)[i]) * 1099511628211ULL;
+    }
+  };
+  uint64_t num_entries = size_;
+  add(&num_entries, sizeof(num_entries));
+  for (uint32_t cache_bit = 0; cache_bit < entries_.size(); ++cache_bit) {
+    const auto& entry = entries_[cache_bit];
+    if (!entry.in_use) {
+      continue;
+    }
+    const auto& response = entry.response;
+    const auto& params = entry.params;
+    const auto& name = response.tensor_names()[0];
+    add(&cache_bit, sizeof(cache_bit));
+    add(name.data(), name.size() + 1);
+    auto response_type = (int32_t)response.response_type();
+    add(&response_type, sizeof(response_type));
+    uint64_t num_devices = response.devices().size();
+    add(&num_devices, sizeof(num_devices));
+    add(response.devices().data(),
+        response.devices().size() * sizeof(response.devices()[0]));
+    // Allgathers are cached with the first dimension of every rank.
+    add(response.tensor_sizes().data(),
+        response.tensor_sizes().size() * sizeof(int64_t));
+    // Only values that are the same on all ranks are hashed: the device of
+    // the entry is the local one of this rank, and so is the first dimension
+    // of an allgathered tensor.
+    add(&params.dtype, sizeof(params.dtype));
+    size_t first_dim =
+        response.response_type() == Response::ALLGATHER ? 1 : 0;
+    if (params.shape.size() > first_dim) {
+      add(params.shape.data() + first_dim,
+          (params.shape.size() - first_dim) * sizeof(int64_t));
+    }
+    add(&params.reduce_op, sizeof(params.reduce_op));
+    add(&params.compression, sizeof(params.compression));
+  }
+  return hash;
+}
+
+namespace {
+
+const int BITS_PER_WORD = sizeof(long long) * CHAR_BIT;
+
+inline void SetBit(std::vector<long long>& bitvector, uint32_t bit) {
+  bitvector[bit / BITS_PER_WORD] |= (1ull << (bit % BITS_PER_WORD));
+}
+
+inline bool TestBit(const std::vector<long long>& bitvector, uint32_t bit) {
+  return ((unsigned long long)bitvector[bit / BITS_PER_WORD] >>
+          (bit % BITS_PER_WORD)) & 1ull;
+}
+
+// Append the positions of bits set in words, minus NUM_STATUS_BITS, in
+// ascending order.
+void ExtractBits(const long long* words, int count,
+                 std::vector<uint32_t>& bits) {
+  size_t num_bits = 0;
+  for (int i = 0; i < count; ++i) {
+    num_bits += __builtin_popcountll(words[i]);
+  }
+  bits.reserve(bits.size() + num_bits);
+  for (int i = 0; i < count; ++i) {
+    unsigned long long ll = words[i];
+    while (ll) {
+      int shifted_bit = i * BITS_PER_WORD + __builtin_ctzll(ll);
+      bits.push_back(shifted_bit - NUM_STATUS_BITS);
+      ll &= ll - 1;
+    }
+  }
+}
+
+} // namespace
+
 CacheCoordinator::CacheCoordinator(size_t num_active_bits) {
   num_active_bits_ = num_active_bits;
+  count_ = (num_active_bits_ + NUM_STATUS_BITS + BITS_PER_WORD - 1) /
+           BITS_PER_WORD;
+  bitvector_.resize(count_, 0);
+  invalid_bitvector_.resize(count_, 0);
 }
 
 void CacheCoordinator::record_hit(uint32_t bit) {
   assert(!synced_);
-  cache_hits_.insert(bit);
+  assert(bit < num_active_bits_);
+  SetBit(bitvector_, bit + NUM_STATUS_BITS);
 }
 
 void CacheCoordinator::record_invalid_bit(uint32_t bit) {
   assert(!synced_);
-  invalid_bits_.insert(bit);
+  assert(bit < num_active_bits_);
+  SetBit(invalid_bitvector_, bit + NUM_STATUS_BITS);
   invalid_in_queue_ = true;
 }
 
@@ -280,21 +584,26 @@ void CacheCoordinator::set_uncached_in_queue(bool uncached_in_queue) {
   uncached_in_queue_ = uncached_in_queue;
 }
 
-const std::set<uint32_t>& CacheCoordinator::cache_hits() const {
+const std::vector<uint32_t>& CacheCoordinator::cache_hits() const {
   assert(synced_);
   return cache_hits_;
 }
 
-const std::set<uint32_t>& CacheCoordinator::invalid_bits() const {
+const std::vector<uint32_t>& CacheCoordinator::invalid_bits() const {
   assert(synced_);
   return invalid_bits_;
 }
 
-const std::set<uint32_t>& CacheCoordinator::timeline_bits() const {
+const std::vector<uint32_t>& CacheCoordinator::timeline_bits() const {
   assert(synced_);
   return timeline_bits_;
 }
 
+bool CacheCoordinator::is_cache_hit(uint32_t bit) const {
+  assert(synced_);
+  return bit < num_active_bits_ && TestBit(bitvector_, bit + NUM_STATUS_BITS);
+}
+
 bool CacheCoordinator::should_shut_down() const {
   assert(synced_);
   return should_shut_down_;
@@ -305,129 +614,83 @@ bool CacheCoordinator::uncached_in_queue() const {
   return uncached_in_queue_;
 }
 
-void CacheCoordinator::sync(std::shared_ptr<Controller> controller,
-                            bool timeline_enabled) {
-  assert(!synced_);
-
-  // Resize and initialize bit vector.
-  int nbits = num_active_bits_ + NUM_STATUS_BITS;
-  int count = (nbits + sizeof(long long) * CHAR_BIT - 1) /
-              (sizeof(long long) * CHAR_BIT);
-
-  // Allocate extended bit vector for timeline handling if required.
-  int fullcount = count;
-  if (timeline_enabled) {
-    fullcount *= 2;
-  }
-
-  bitvector_.resize(fullcount);
-  std::memset(&bitvector_[0], 0, count * sizeof(long long));
-  if (timeline_enabled) {
-    std::memset(&bitvector_[count], -1, count * sizeof(long long));
+std::vector<long long> CacheCoordinator::local_bitvector() const {
+  // Invalid bits are removed from the cache hit set, and reserved status
+  // bits are set for the states this worker does not have.
+  std::vector<long long> bitvector(bitvector_);
+  for (int i = 0; i < count_; ++i) {
+    bitvector[i] &= ~invalid_bitvector_[i];
   }
-
-  // Set reserved status bits for additional states.
   if (!should_shut_down_) {
-    bitvector_[0] |= (1ull << StatusBit::SHOULD_SHUT_DOWN);
+    bitvector[0] |= (1ll << StatusBit::SHOULD_SHUT_DOWN);
   }
   if (!uncached_in_queue_) {
-    bitvector_[0] |= (1ull << StatusBit::UNCACHED_IN_QUEUE);
+    bitvector[0] |= (1ll << StatusBit::UNCACHED_IN_QUEUE);
   }
   if (!invalid_in_queue_) {
-    bitvector_[0] |= (1ull << StatusBit::INVALID_IN_QUEUE);
+    bitvector[0] |= (1ll << StatusBit::INVALID_IN_QUEUE);
   }
+  return bitvector;
+}
 
-  // Before communication, remove any invalid bits from cache hit set.
-  for (auto bit : invalid_bits_) {
-    cache_hits_.erase(bit);
-  }
+void CacheCoordinator::sync(std::shared_ptr<Controller> controller,
+                            bool timeline_enabled) {
+  assert(!synced_);
+  const long long status_mask = (1ll << NUM_STATUS_BITS) - 1;
+
+  bitvector_ = local_bitvector();
 
-  // For each cache hit on this worker, flip associated bit in bit vector.
-  for (auto bit : cache_hits_) {
-    int shifted_bit = bit + NUM_STATUS_BITS;
-    int shift = shifted_bit / (sizeof(long long) * CHAR_BIT);
-    bitvector_[shift] |=
-        (1ull << (shifted_bit % (sizeof(long long) * CHAR_BIT)));
-    if (timeline_enabled) {
-      // Set corresponding bit in extended section for timeline if needed.
-      bitvector_[count + shift] ^=
-          (1ull << (shifted_bit % (sizeof(long long) * CHAR_BIT)));
+  // Allocate extended bit vector for timeline handling if required. The
+  // extended section holds the complement of the cache hits, so that the
+  // AND operation yields bits with a cache hit on *any* worker.
+  int fullcount = count_;
+  if (timeline_enabled) {
+    fullcount *= 2;
+    bitvector_.resize(fullcount);
+    for (int i = 0; i < count_; ++i) {
+      bitvector_[count_ + i] = ~bitvector_[i];
     }
+    bitvector_[count_] |= status_mask;
   }
 
   // Global AND operation to get intersected bit array.
   controller->CrossRankBitwiseAnd(bitvector_, fullcount);
 
-  // Search for flipped bits to populate common cache hit set. There will never
-  // be invalid bits in this set.
-  cache_hits_.clear();
-  for (int i = 0; i < count; ++i) {
-    int shift = i * sizeof(long long) * CHAR_BIT;
-    long long ll = bitvector_[i];
-    while (ll) {
-      int idx = __builtin_ffsll(ll);
-      int shifted_bit = shift + idx - 1;
-      cache_hits_.insert(shifted_bit - NUM_STATUS_BITS);
-      ll &= ~(1ull << (idx - 1));
-    }
-  }
-
-  // Set states from reserved status bits
-  if (!cache_hits_.erase(StatusBit::SHOULD_SHUT_DOWN - NUM_STATUS_BITS)) {
+  // Set states from reserved status bits and clear them, so that only cache
+  // bits remain in the bit vector.
+  if (!(bitvector_[0] & (1ll << StatusBit::SHOULD_SHUT_DOWN))) {
     should_shut_down_ = true;
   }
-  if (!cache_hits_.erase(StatusBit::UNCACHED_IN_QUEUE - NUM_STATUS_BITS)) {
+  if (!(bitvector_[0] & (1ll << StatusBit::UNCACHED_IN_QUEUE))) {
     uncached_in_queue_ = true;
   }
-  if (!cache_hits_.erase(StatusBit::INVALID_IN_QUEUE - NUM_STATUS_BITS)) {
+  if (!(bitvector_[0] & (1ll << StatusBit::INVALID_IN_QUEUE))) {
     invalid_in_queue_ = true;
   }
+  bitvector_[0] &= ~status_mask;
+
+  // Search for set bits to populate common cache hit set. There will never
+  // be invalid bits in this set.
+  ExtractBits(bitvector_.data(), count_, cache_hits_);
 
   // If any worker has invalid cache entries, communicate invalid bits across
   // workers using a second bit-wise allreduce operation.
   if (invalid_in_queue_) {
-    std::memset(&bitvector_[0], 0, count * sizeof(long long));
-    for (auto bit : invalid_bits_) {
-      int shift = bit / (sizeof(long long) * CHAR_BIT);
-      bitvector_[shift] |= (1ull << (bit % (sizeof(long long) * CHAR_BIT)));
-    }
-
     // Global OR operation to get common invalid bits.
-    controller->CrossRankBitwiseOr(bitvector_, count);
-    // Search for flipped bits to populate common invalid bit set.
-    invalid_bits_.clear();
-    for (int i = 0; i < count; ++i) {
-      int shift = i * sizeof(long long) * CHAR_BIT;
-      long long ll = bitvector_[i];
-      while (ll) {
-        int idx = __builtin_ffsll(ll);
-        int bit = shift + idx - 1;
-        invalid_bits_.insert(bit);
-        ll &= ~(1ull << (idx - 1));
-      }
-    }
+    controller->CrossRankBitwiseOr(invalid_bitvector_, count_);
+    ExtractBits(invalid_bitvector_.data(), count_, invalid_bits_);
   }
 
   if (timeline_enabled) {
     // For timeline, add bits with cache hits on *any* worker to
-    // timeline bit set to mark start of negotiation phase. This
-    // information is encoded in an extended section of the bit vector
-    // from [count, 2*count]
-    for (int i = 0; i < count; ++i) {
-      int shift = i * sizeof(long long) * CHAR_BIT;
-      long long ll = ~bitvector_[count + i];
-      while (ll) {
-        int idx = __builtin_ffsll(ll);
-        int shifted_bit = shift + idx - 1;
-        // Only add valid bits to set here. Timeline handling for
-        // invalid bits will proceed to the non-bypass coordination path.
-        if (invalid_bits_.find(shifted_bit - NUM_STATUS_BITS) ==
-            invalid_bits_.end()) {
-          timeline_bits_.insert(shifted_bit - NUM_STATUS_BITS);
-        }
-        ll &= ~(1ull << (idx - 1));
-      }
+    // timeline bit set to mark start of negotiation phase. Only add valid
+    // bits to set here. Timeline handling for invalid bits will proceed to
+    // the non-bypass coordination path.
+    for (int i = 0; i < count_; ++i) {
+      bitvector_[count_ + i] = ~bitvector_[count_ + i] & ~invalid_bitvector_[i];
     }
+    ExtractBits(bitvector_.data() + count_, count_, timeline_bits_);
+    bitvector_.resize(count_);
   }
 
   synced_ = true;
@@ -17,9 +17,9 @@
 #define HOROVOD_RESPONSE_CACHE_H
 
 #include <cassert>
-#include <list>
 #include <set>
-#include <unordered_map>
+#include <string>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -39,9 +39,18 @@ struct TensorParams {
   DataType dtype;
   std::vector<int64_t> shape;
   int32_t device;
+  ReduceOp reduce_op = ReduceOp::SUM;
+  Compression compression = Compression::NONE;
+  // Interned tensor name ID, held by the cache entry. Not compared for
+  // collisions.
+  int32_t tensor_id = -1;
 };
 
-// LRU cache of Responses
+// LRU cache of Responses. Entries are stored flat, indexed by their cache
+// bit, which stays the same for as long as the entry is cached. The LRU order
+// is a list linked through the entries, and tensor names are looked up in an
+// open-addressed table, both sized with the capacity, so that lookups, hits
+// and evictions do not allocate.
 class ResponseCache {
 public:
   ResponseCache() = default;
@@ -51,12 +60,31 @@ public:
 
   void clear();
 
+  // Growing the capacity keeps the cached entries and their bits, other
+  // changes clear the cache.
   void set_capacity(uint32_t capacity);
 
   uint32_t capacity() const;
 
+  // Capacity the cache may grow to. Evictions are only warned about once it
+  // is reached.
+  void set_max_capacity(uint32_t max_capacity) { max_capacity_ = max_capacity; }
+
   size_t num_active_bits() const;
 
+  // Number of entries in use.
+  uint32_t size() const { return size_; }
+
+  // Number of responses put again after having been evicted, since the last
+  // change of capacity. Misses of a working set larger than the capacity.
+  uint64_t reput_after_eviction() const { return reput_after_eviction_; }
+
+  // Number of distinct cache bits hit or put since the last call to
+  // start_window, or since the cache was cleared.
+  uint32_t window_bits() const { return window_bits_; }
+
+  void start_window();
+
   CacheState cached(const Request& message) const;
 
   CacheState cached(const Response& response, const TensorParams& params) const;
@@ -73,26 +101,117 @@ public:
 
   void erase_response(uint32_t cache_bit);
 
+  // Drops the unused bits at the end of the bit range left by erased
+  // entries. Bits of cached entries are not changed.
   void update_cache_bits();
 
+  // Drops the holds on the tensor IDs of entries evicted or erased since the
+  // last call, so that the tensor queue can reuse them.
+  void release_tensor_ids(TensorQueue& tensor_queue);
+
+  // Incremented whenever a cache bit is assigned to another response, but
+  // not when entries only move in the LRU order. Responses of the same cache
+  // bits under the same generation are the same.
+  uint64_t generation() const { return generation_; }
+
+  // Hash of the cached responses, their parameters and their bits in cache
+  // bit order, which is the same across hosts. Workers whose caches have the
+  // same fingerprint can keep using them together.
+  uint64_t fingerprint() const;
+
 private:
+  struct Entry {
+    Response response;
+    TensorParams params;
+    // Neighbours in the LRU list, towards the most and least recently used
+    // entries, -1 at the ends.
+    int32_t newer = -1;
+    int32_t older = -1;
+    bool in_use = false;
+    // Last window the bit was hit or put in.
+    uint64_t window = 0;
+  };
+
+  struct NameSlot {
+    size_t hash = 0;
+    // Cache bit of the entry, -1 if the slot is empty.
+    int32_t cache_bit = -1;
+  };
+
   void put_(const Response& response, TensorParams& params);
 
+  // Finds the cache bit of the request, through its tensor ID if assigned.
+  bool find_cache_bit(const Request& message, uint32_t& cache_bit) const;
+
+  void set_tensor_id_bit(int32_t tensor_id, int32_t cache_bit);
+
+  // Lowest unused cache bit, appended to the bit range if there is none.
+  uint32_t allocate_bit();
+
+  // Removes the entry at cache_bit from the LRU list and name table.
+  void release_bit(uint32_t cache_bit);
+
+  void lru_unlink(int32_t cache_bit);
+
+  void lru_push_front(int32_t cache_bit);
+
+  // Position of tensor_name in name_table_, or of the empty slot that ends
+  // its probe sequence.
+  size_t find_name_slot(const std::string& tensor_name, size_t hash) const;
+
+  bool find_name(const std::string& tensor_name, uint32_t& cache_bit) const;
+
+  void insert_name(const std::string& tensor_name, uint32_t cache_bit);
+
+  void erase_name(const std::string& tensor_name);
+
+  CacheState compare_params(uint32_t cache_bit,
+                            const TensorParams& params) const;
+
   uint32_t capacity_ = 0;
 
-  // List containing cached entries. Each entry in the cache is a pair
-  // of a Response and a TensorParams struct.
-  std::list<std::pair<Response, TensorParams>> cache_;
+  // Cache entries indexed by cache bit, including unused bits of erased
+  // entries that have not been reused yet.
+  std::vector<Entry> entries_;
+
+  // Number of entries in use.
+  uint32_t size_ = 0;
 
-  // Vector of iterators to cache entries. Indexed by cache bit.
-  std::vector<std::list<std::pair<Response, TensorParams>>::iterator>
-      cache_iters_;
+  // Most and least recently used entries, -1 if the cache is empty.
+  int32_t lru_newest_ = -1;
+  int32_t lru_oldest_ = -1;
 
-  // Lookup table mapping tensor names to assigned cache bits.
-  std::unordered_map<std::string, uint32_t> tensor_name_to_bit_;
+  // Min-heap of unused cache bits. Bits past the end of entries_ are left
+  // over from update_cache_bits and are discarded when reached.
+  std::vector<uint32_t> free_bits_;
+
+  // Linear probing table mapping tensor names to cache bits, with at least
+  // twice as many slots as the capacity and a power of two in size.
+  std::vector<NameSlot> name_table_;
+
+  // Cache bits indexed by interned tensor ID, -1 if not cached. Spares
+  // hashing tensor names for requests coming from the local tensor queue.
+  std::vector<int32_t> tensor_id_to_bit_;
+
+  // Tensor IDs held by entries since dropped, released to the tensor queue
+  // by release_tensor_ids.
+  std::vector<int32_t> released_tensor_ids_;
 
   bool bits_outdated_ = false;
 
+  uint64_t generation_ = 0;
+
+  uint32_t max_capacity_ = 0;
+
+  // Name hashes of the entries evicted since the last change of capacity,
+  // at most as many as the capacity.
+  std::unordered_set<size_t> evicted_names_;
+
+  uint64_t reput_after_eviction_ = 0;
+
+  uint64_t window_ = 1;
+  uint32_t window_bits_ = 0;
+
   bool print_warning_ = true;
 };
 
@@ -111,11 +230,15 @@ public:
 
   void set_uncached_in_queue(bool uncached_in_queue);
 
-  const std::set<uint32_t>& cache_hits() const;
+  // Bit sets below are sorted in ascending bit order.
+  const std::vector<uint32_t>& cache_hits() const;
+
+  const std::vector<uint32_t>& invalid_bits() const;
 
-  const std::set<uint32_t>& invalid_bits() const;
+  const std::vector<uint32_t>& timeline_bits() const;
 
-  const std::set<uint32_t>& timeline_bits() const;
+  // Whether the bit is a common cache hit across workers.
+  bool is_cache_hit(uint32_t bit) const;
 
   bool should_shut_down() const;
 
@@ -124,6 +247,14 @@ public:
   // Method to sync state and bit sets across workers.
   void sync(std::shared_ptr<Controller> controller, bool timeline_enabled);
 
+  // Bit vectors this worker contributes to the bitwise AND and OR of sync(),
+  // before they are synced, so that other workers can be simulated.
+  std::vector<long long> local_bitvector() const;
+
+  const std::vector<long long>& local_invalid_bitvector() const {
+    return invalid_bitvector_;
+  }
+
 private:
   enum StatusBit {
     SHOULD_SHUT_DOWN = 0,
@@ -135,18 +266,20 @@ private:
   // bitvector identically across workers.
   size_t num_active_bits_;
 
-  // Set of cache hit bits. After sync(), contains only common
-  // cache hit bits across workers.
-  std::set<uint32_t> cache_hits_;
+  // Number of words in a bit vector holding status bits followed by
+  // num_active_bits_ cache bits.
+  int count_;
 
-  // Set of invalid bits. After sync(), contains only common
-  // invalid bits across workers.
-  std::set<uint32_t> invalid_bits_;
+  // Common cache hit bits across workers, extracted by sync().
+  std::vector<uint32_t> cache_hits_;
 
-  // Set of bits for timeline handling. After sync(), contains bits
-  // where at least one worker recorded a cache hit. This indicates
-  // that the timeline negotion phase should be started/continued.
-  std::set<uint32_t> timeline_bits_;
+  // Common invalid bits across workers, extracted by sync().
+  std::vector<uint32_t> invalid_bits_;
+
+  // Bits for timeline handling. After sync(), contains bits where at least
+  // one worker recorded a cache hit. This indicates that the timeline
+  // negotion phase should be started/continued.
+  std::vector<uint32_t> timeline_bits_;
 
   // States used externally in cycle loop.
   bool should_shut_down_ = false;
@@ -156,8 +289,13 @@ private:
   // to sync invalid bits.
   bool invalid_in_queue_ = false;
 
+  // Dense cache hit bits, offset by NUM_STATUS_BITS. Bits are recorded here
+  // directly and intersected across workers in place.
   std::vector<long long> bitvector_;
 
+  // Dense invalid bits, offset by NUM_STATUS_BITS like bitvector_.
+  std::vector<long long> invalid_bitvector_;
+
   bool synced_ = false;
 };
 
@@ -0,0 +1,55 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "response_queue.h"
+
+namespace horovod {
+namespace common {
+
+void ResponseListQueue::Push(ResponseList&& response_list) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_full_.wait(lock, [this] { return queue_.size() < capacity_; });
+    queue_.push_back(std::move(response_list));
+    ++pushed_;
+  }
+  not_empty_.notify_one();
+}
+
+void ResponseListQueue::Pop(ResponseList& response_list) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [this] { return !queue_.empty(); });
+    response_list = std::move(queue_.front());
+    queue_.pop_front();
+  }
+  not_full_.notify_one();
+}
+
+void ResponseListQueue::MarkDone() {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    ++done_;
+  }
+  all_done_.notify_all();
+}
+
+void ResponseListQueue::WaitUntilDone() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  all_done_.wait(lock, [this] { return done_ == pushed_; });
+}
+
+} // namespace common
+} // namespace horovod
@@ -0,0 +1,69 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HOROVOD_RESPONSE_QUEUE_H
+#define HOROVOD_RESPONSE_QUEUE_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+#include "message.h"
+
+namespace horovod {
+namespace common {
+
+// Bounded queue handing negotiated response lists from the negotiation
+// thread to the execution thread when pipelined negotiation is enabled.
+class ResponseListQueue {
+public:
+  ResponseListQueue() = default;
+  ResponseListQueue(const ResponseListQueue&) = delete;
+
+  // Block while the queue is full, then append the response list.
+  void Push(ResponseList&& response_list);
+
+  // Block until a response list is available, then remove it from the queue.
+  void Pop(ResponseList& response_list);
+
+  // Called by the execution thread once it performed a popped response list.
+  void MarkDone();
+
+  // Block until every response list pushed so far has been performed.
+  void WaitUntilDone();
+
+private:
+  std::deque<ResponseList> queue_;
+
+  // Maximum number of negotiated cycles waiting to be executed.
+  size_t capacity_ = 2;
+
+  std::mutex mutex_;
+
+  std::condition_variable not_empty_;
+
+  std::condition_variable not_full_;
+
+  // Response lists pushed and performed so far.
+  uint64_t pushed_ = 0;
+  uint64_t done_ = 0;
+
+  std::condition_variable all_done_;
+};
+
+} // namespace common
+} // namespace horovod
+
+#endif // HOROVOD_RESPONSE_QUEUE_H
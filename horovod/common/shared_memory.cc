@@ -0,0 +1,423 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "shared_memory.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "controller.h"
+#include "half.h"
+#include "logging.h"
+#include "utils/huge_pages.h"
+
+namespace horovod {
+namespace common {
+
+namespace {
+
+// Largest amount of data each rank contributes to a round of the reduce and
+// broadcast protocols, which bounds the data segment they need.
+constexpr size_t MAX_SLOT_BYTES = 8 * 1024 * 1024;
+
+// Number of polls of a counter before yielding the core.
+constexpr int SPINS_BEFORE_YIELD = 1024;
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+              "Shared memory counters need lock free 64-bit atomics.");
+
+size_t RoundUp(size_t bytes, size_t alignment) {
+  return (bytes + alignment - 1) / alignment * alignment;
+}
+
+template <typename T> void Sum(void* dst, const void* src, int64_t n) {
+  auto* d = static_cast<T*>(dst);
+  auto* s = static_cast<const T*>(src);
+  for (int64_t i = 0; i < n; ++i) {
+    d[i] += s[i];
+  }
+}
+
+void SumInto(DataType dtype, void* dst, const void* src, int64_t n) {
+  switch (dtype) {
+  case HOROVOD_UINT8:
+    Sum<uint8_t>(dst, src, n);
+    break;
+  case HOROVOD_INT8:
+    Sum<int8_t>(dst, src, n);
+    break;
+  case HOROVOD_UINT16:
+    Sum<uint16_t>(dst, src, n);
+    break;
+  case HOROVOD_INT16:
+    Sum<int16_t>(dst, src, n);
+    break;
+  case HOROVOD_INT32:
+    Sum<int32_t>(dst, src, n);
+    break;
+  case HOROVOD_INT64:
+    Sum<int64_t>(dst, src, n);
+    break;
+  case HOROVOD_FLOAT16:
+    Float16Sum((const uint16_t*)src, (const uint16_t*)dst, (uint16_t*)dst, n);
+    break;
+  case HOROVOD_BFLOAT16:
+    BFloat16Sum((const uint16_t*)src, (const uint16_t*)dst, (uint16_t*)dst, n);
+    break;
+  case HOROVOD_FLOAT32:
+    Sum<float>(dst, src, n);
+    break;
+  case HOROVOD_FLOAT64:
+    Sum<double>(dst, src, n);
+    break;
+  default:
+    throw std::logic_error("Type " + DataType_Name(dtype) +
+                           " is not supported in shared memory allreduce.");
+  }
+}
+
+int ElementSize(DataType dtype) {
+  switch (dtype) {
+  case HOROVOD_UINT8:
+  case HOROVOD_INT8:
+  case HOROVOD_BOOL:
+    return 1;
+  case HOROVOD_UINT16:
+  case HOROVOD_INT16:
+  case HOROVOD_FLOAT16:
+  case HOROVOD_BFLOAT16:
+    return 2;
+  case HOROVOD_INT32:
+  case HOROVOD_FLOAT32:
+    return 4;
+  default:
+    return 8;
+  }
+}
+
+// Block of count elements reduced by the given rank in a round.
+void BlockRange(int64_t count, int rank, int size, int64_t& first,
+                int64_t& length) {
+  int64_t base = count / size;
+  int64_t extra = count % size;
+  first = rank * base + std::min<int64_t>(rank, extra);
+  length = base + (rank < extra ? 1 : 0);
+}
+
+} // namespace
+
+SharedMemoryArena::~SharedMemoryArena() { Finalize(); }
+
+std::string SharedMemoryArena::SegmentName(const std::string& suffix) const {
+  return "/horovod." + std::to_string(job_id_) + "." + suffix;
+}
+
+void* SharedMemoryArena::Map(const std::string& name, size_t bytes,
+                             bool create) {
+  int fd = create ? shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600)
+                  : shm_open(name.c_str(), O_RDWR, 0600);
+  if (fd < 0) {
+    return nullptr;
+  }
+  bool ok = true;
+  if (create) {
+#ifdef __linux__
+    // Reserve the pages now, so that a full /dev/shm fails here rather than
+    // with SIGBUS at first touch.
+    ok = posix_fallocate(fd, 0, (off_t)bytes) == 0;
+#else
+    ok = ftruncate(fd, (off_t)bytes) == 0;
+#endif
+  }
+  void* addr = nullptr;
+  if (ok) {
+    addr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+      addr = nullptr;
+    } else {
+      AdviseHugePages(addr, bytes);
+    }
+  }
+  close(fd);
+  if (addr == nullptr && create) {
+    shm_unlink(name.c_str());
+  }
+  return addr;
+}
+
+void SharedMemoryArena::Initialize(Controller& controller) {
+  local_rank_ = controller.GetLocalRank();
+  local_size_ = controller.GetLocalSize();
+
+  // Segments are named after the process id of local rank 0.
+  job_id_ = (int64_t)getpid();
+  controller.Bcast(&job_id_, sizeof(job_id_), 0, Communicator::LOCAL);
+
+  control_bytes_ = RoundUp(sizeof(ControlBlock) +
+                               sizeof(Counter) * (NUM_STEPS * local_size_ - 1),
+                           4096);
+  bool ok = local_size_ > 1;
+  if (ok && local_rank_ == 0) {
+    control_ = (ControlBlock*)Map(SegmentName("ctl"), control_bytes_, true);
+    ok = control_ != nullptr;
+    if (ok) {
+      // Fresh pages are zero, which is the initial value of every counter.
+      control_->data_generation.store(0);
+      control_->data_bytes.store(0);
+    }
+  }
+  controller.Barrier(Communicator::LOCAL);
+  if (ok && local_rank_ != 0) {
+    control_ = (ControlBlock*)Map(SegmentName("ctl"), control_bytes_, false);
+    ok = control_ != nullptr;
+  }
+
+  // All ranks of a node enable the arena or none does, so that they take the
+  // same code paths in collectives. Single rank nodes have nothing to share.
+  std::vector<long long> bitvector{ok || local_size_ == 1 ? 1 : 0};
+  controller.CrossRankBitwiseAnd(bitvector, 1);
+  controller.Barrier(Communicator::LOCAL);
+  if (local_rank_ == 0 && control_ != nullptr) {
+    // The mappings stay valid, and nothing is left behind if the job dies.
+    shm_unlink(SegmentName("ctl").c_str());
+  }
+
+  enabled_ = bitvector[0] != 0 && local_size_ > 1;
+  if (!enabled_) {
+    if (bitvector[0] == 0 && local_rank_ == 0) {
+      LOG(WARNING) << "Failed to map the shared memory arena, CPU collectives "
+                      "within nodes fall back to MPI or Gloo.";
+    }
+    Finalize();
+    return;
+  }
+  LOG(DEBUG) << "Shared memory arena initialized for " << local_size_
+             << " local ranks.";
+}
+
+void SharedMemoryArena::Finalize() {
+  if (data_ != nullptr) {
+    munmap(data_, data_bytes_);
+    data_ = nullptr;
+    data_bytes_ = 0;
+  }
+  if (control_ != nullptr) {
+    munmap(control_, control_bytes_);
+    control_ = nullptr;
+  }
+  enabled_ = false;
+}
+
+SharedMemoryArena::Counter& SharedMemoryArena::GetCounter(Step step,
+                                                          int local_rank) {
+  return control_->counters[step * local_size_ + local_rank];
+}
+
+void SharedMemoryArena::Publish(Step step, uint64_t value) {
+  GetCounter(step, local_rank_).value.store(value, std::memory_order_release);
+}
+
+void SharedMemoryArena::WaitFor(Step step, int local_rank, uint64_t value) {
+  auto& counter = GetCounter(step, local_rank).value;
+  int spins = 0;
+  while (counter.load(std::memory_order_acquire) < value) {
+    if (++spins == SPINS_BEFORE_YIELD) {
+      std::this_thread::yield();
+      spins = 0;
+    }
+  }
+}
+
+void SharedMemoryArena::WaitAll(Step step, uint64_t value) {
+  for (int r = 0; r < local_size_; ++r) {
+    WaitFor(step, r, value);
+  }
+}
+
+void SharedMemoryArena::Barrier() {
+  ++barrier_;
+  Publish(BARRIER, barrier_);
+  WaitAll(BARRIER, barrier_);
+}
+
+void SharedMemoryArena::Reserve(size_t bytes) {
+  if (bytes <= data_bytes_) {
+    return;
+  }
+  size_t new_bytes = RoundUp(std::max(bytes, 2 * data_bytes_), 4096);
+  ++data_generation_;
+  std::string name = SegmentName("data." + std::to_string(data_generation_));
+
+  void* new_data = nullptr;
+  if (local_rank_ == 0) {
+    new_data = Map(name, new_bytes, true);
+    control_->data_bytes.store(new_bytes);
+    control_->data_generation.store(new_data != nullptr ? data_generation_
+                                                        : -data_generation_,
+                                    std::memory_order_release);
+  } else {
+    int spins = 0;
+    while (std::abs(control_->data_generation.load(
+               std::memory_order_acquire)) < data_generation_) {
+      if (++spins == SPINS_BEFORE_YIELD) {
+        std::this_thread::yield();
+        spins = 0;
+      }
+    }
+    if (control_->data_generation.load() > 0) {
+      new_data = Map(name, new_bytes, false);
+    }
+  }
+  if (new_data == nullptr) {
+    throw std::runtime_error("Failed to map " + std::to_string(new_bytes) +
+                             " bytes of shared memory, consider a larger "
+                             "/dev/shm.");
+  }
+
+  if (data_ != nullptr) {
+    munmap(data_, data_bytes_);
+  }
+  data_ = new_data;
+  data_bytes_ = new_bytes;
+
+  Barrier();
+  if (local_rank_ == 0) {
+    shm_unlink(name.c_str());
+  }
+}
+
+void SharedMemoryArena::Allreduce(
+    void* buffer_data, int64_t num_elements, DataType dtype,
+    const std::function<void(void*, int64_t)>& block_op, int num_blocks) {
+  if (num_blocks <= 0 || num_blocks > local_size_) {
+    num_blocks = local_size_;
+  }
+  bool owns_block = local_rank_ < num_blocks;
+  int element_size = ElementSize(dtype);
+  size_t slot_bytes =
+      RoundUp(std::min((size_t)num_elements * element_size, MAX_SLOT_BYTES),
+              64);
+  Reserve(slot_bytes * local_size_);
+  int64_t slot_elements = (int64_t)(slot_bytes / element_size);
+  auto slot = [&](int r) { return (uint8_t*)data_ + r * slot_bytes; };
+
+  int64_t offset = 0;
+  do {
+    int64_t count = std::min(slot_elements, num_elements - offset);
+    auto* chunk = (uint8_t*)buffer_data + offset * element_size;
+    ++round_;
+
+    // Other ranks may still be copying out of this slot in the last round.
+    WaitAll(CONSUMED, round_ - 1);
+    std::memcpy(slot(local_rank_), chunk, (size_t)count * element_size);
+    Publish(ARRIVED, round_);
+    WaitAll(ARRIVED, round_);
+
+    // Only this rank touches its block of every slot, so it accumulates the
+    // block in its own slot.
+    int64_t first, length;
+    if (owns_block) {
+      BlockRange(count, local_rank_, num_blocks, first, length);
+      auto* block = slot(local_rank_) + first * element_size;
+      for (int r = 0; r < local_size_; ++r) {
+        if (r != local_rank_ && length > 0) {
+          SumInto(dtype, block, slot(r) + first * element_size, length);
+        }
+      }
+      if (block_op) {
+        block_op(block, length);
+      }
+    }
+    Publish(REDUCED, round_);
+    WaitAll(REDUCED, round_);
+
+    for (int r = 0; r < num_blocks; ++r) {
+      BlockRange(count, r, num_blocks, first, length);
+      std::memcpy(chunk + first * element_size,
+                  slot(r) + first * element_size,
+                  (size_t)length * element_size);
+    }
+    Publish(CONSUMED, round_);
+    offset += count;
+  } while (offset < num_elements);
+
+  // Leave the arena unused for the next collective.
+  WaitAll(CONSUMED, round_);
+}
+
+void SharedMemoryArena::Broadcast(void* buffer_data, size_t bytes,
+                                  int root_local_rank) {
+  size_t chunk_bytes = RoundUp(std::min(bytes, MAX_SLOT_BYTES), 64);
+  Reserve(chunk_bytes);
+
+  size_t offset = 0;
+  do {
+    size_t count = std::min(chunk_bytes, bytes - offset);
+    auto* chunk = (uint8_t*)buffer_data + offset;
+    ++round_;
+
+    if (local_rank_ == root_local_rank) {
+      WaitAll(CONSUMED, round_ - 1);
+      std::memcpy(data_, chunk, count);
+      Publish(ARRIVED, round_);
+    } else {
+      WaitFor(ARRIVED, root_local_rank, round_);
+      std::memcpy(chunk, data_, count);
+    }
+    Publish(CONSUMED, round_);
+    offset += count;
+  } while (offset < bytes);
+
+  WaitAll(CONSUMED, round_);
+}
+
+void SharedMemoryArena::Allgather(
+    size_t bytes, const std::function<void(void*)>& copy_in,
+    const std::function<void(void*)>& leader_op, int num_leaders,
+    const std::function<void(const void*)>& copy_out) {
+  if (num_leaders <= 0 || num_leaders > local_size_) {
+    num_leaders = local_size_;
+  }
+  Reserve(bytes);
+  ++round_;
+
+  // Other ranks may still be copying out of the segment in the last round.
+  WaitAll(CONSUMED, round_ - 1);
+  copy_in(data_);
+  Publish(ARRIVED, round_);
+
+  if (local_rank_ < num_leaders) {
+    WaitAll(ARRIVED, round_);
+    if (leader_op) {
+      leader_op(data_);
+    }
+  }
+  Publish(REDUCED, round_);
+  for (int r = 0; r < num_leaders; ++r) {
+    WaitFor(REDUCED, r, round_);
+  }
+
+  copy_out(data_);
+  Publish(CONSUMED, round_);
+}
+
+} // namespace common
+} // namespace horovod
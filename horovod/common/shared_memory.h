@@ -0,0 +1,133 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HOROVOD_SHARED_MEMORY_H
+#define HOROVOD_SHARED_MEMORY_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "common.h"
+
+namespace horovod {
+namespace common {
+
+class Controller;
+
+// POSIX shared memory mapped by all ranks of a node, through which CPU
+// collectives exchange data at memory bandwidth instead of going through the
+// loopback of the MPI or Gloo transport.
+//
+// The arena consists of a fixed control segment holding one progress counter
+// per local rank and protocol step, and a data segment that grows on demand.
+// Ranks synchronize by publishing their counters and spinning on the others',
+// without locks. All methods but IsEnabled are collective over the ranks of
+// the node, which must call them in the same order with the same sizes.
+class SharedMemoryArena {
+public:
+  SharedMemoryArena() = default;
+  SharedMemoryArena(const SharedMemoryArena&) = delete;
+  ~SharedMemoryArena();
+
+  // Maps the arena for the LOCAL communicator of the controller. Collective
+  // over all ranks, which either all enable the arena or all leave it
+  // disabled, e.g. on single rank nodes or when /dev/shm is too small.
+  void Initialize(Controller& controller);
+
+  void Finalize();
+
+  bool IsEnabled() const { return enabled_; }
+
+  // Grows the data segment to at least bytes.
+  void Reserve(size_t bytes);
+
+  void* Data() const { return data_; }
+
+  // Waits until all ranks of the node reached the barrier.
+  void Barrier();
+
+  // Sums num_elements of dtype in buffer_data over the ranks of the node,
+  // leaving the sum in buffer_data on all of them. The buffer is processed in
+  // rounds in which each of the first num_blocks ranks, all of them if 0,
+  // reduces one block. If given, block_op is called by these ranks on their
+  // reduced block before it is shared, e.g. to allreduce it across nodes.
+  void Allreduce(void* buffer_data, int64_t num_elements, DataType dtype,
+                 const std::function<void(void*, int64_t)>& block_op = nullptr,
+                 int num_blocks = 0);
+
+  // Copies bytes of buffer_data on root_local_rank to the other ranks of the
+  // node.
+  void Broadcast(void* buffer_data, size_t bytes, int root_local_rank);
+
+  // Assembles bytes of data in the data segment. Each rank writes its part
+  // with copy_in, then each of the first num_leaders ranks, all of them if 0,
+  // calls leader_op on the segment, e.g. to allgather a block of it across
+  // nodes, and copy_out is called on all ranks once the leaders are done.
+  // Ranks only wait on each other's counters, and the segment is not written
+  // again before all ranks copied out of it.
+  void Allgather(size_t bytes, const std::function<void(void*)>& copy_in,
+                 const std::function<void(void*)>& leader_op, int num_leaders,
+                 const std::function<void(const void*)>& copy_out);
+
+private:
+  struct alignas(64) Counter {
+    std::atomic<uint64_t> value;
+  };
+
+  // Counters of the protocol steps, one per local rank.
+  enum Step { ARRIVED = 0, REDUCED = 1, CONSUMED = 2, BARRIER = 3, NUM_STEPS };
+
+  struct ControlBlock {
+    // Generation of the data segment last created by local rank 0, or its
+    // negation if creating it failed.
+    std::atomic<int64_t> data_generation;
+    std::atomic<uint64_t> data_bytes;
+    Counter counters[1];
+  };
+
+  Counter& GetCounter(Step step, int local_rank);
+  void Publish(Step step, uint64_t value);
+  void WaitAll(Step step, uint64_t value);
+  void WaitFor(Step step, int local_rank, uint64_t value);
+
+  // Creates (on local rank 0) or opens the named segment and maps it.
+  void* Map(const std::string& name, size_t bytes, bool create);
+
+  std::string SegmentName(const std::string& suffix) const;
+
+  bool enabled_ = false;
+  int local_rank_ = 0;
+  int local_size_ = 1;
+  int64_t job_id_ = 0;
+
+  ControlBlock* control_ = nullptr;
+  size_t control_bytes_ = 0;
+
+  void* data_ = nullptr;
+  size_t data_bytes_ = 0;
+  int64_t data_generation_ = 0;
+
+  // Rounds of the reduce and broadcast protocols, and barriers, completed by
+  // this rank. They advance identically on all ranks of the node.
+  uint64_t round_ = 0;
+  uint64_t barrier_ = 0;
+};
+
+} // namespace common
+} // namespace horovod
+
+#endif // HOROVOD_SHARED_MEMORY_H
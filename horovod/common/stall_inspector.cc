@@ -15,6 +15,7 @@
 
 #include "stall_inspector.h"
 
+#include <algorithm>
 #include <map>
 #include <unordered_set>
 
@@ -38,26 +39,24 @@ bool StallInspector::CheckForStalledTensors(int global_size) {
     stall_shutdown_time = std::chrono::seconds(0);
   }
 
-  for (auto& m : uncached_tensor_table) {
-    auto tensor_name = m.first;
-    std::vector<int>& ranks = std::get<0>(m.second);
-    std::chrono::steady_clock::time_point start_at = std::get<1>(m.second);
-    auto lag = now - start_at;
-
-    if (lag > stall_warning_time) {
-      std::unordered_set<int32_t> ready_ranks;
-      for (auto rank : ranks) {
-        ready_ranks.insert(rank);
+  AdvanceWheel();
+  stalled_tensor_count_ = static_cast<int>(stalled_tensors_.size());
+  for (auto& tensor_name : stalled_tensors_) {
+    auto& tensor = uncached_tensor_table.at(tensor_name);
+    bool shut_down = stall_shutdown_time > std::chrono::seconds(0) &&
+                     now - tensor.start_at > stall_shutdown_time;
+    for (int32_t rank = 0; rank < global_size; ++rank) {
+      uint64_t word = tensor.ready_ranks[rank / 64];
+      if (word == ~0ULL) {
+        // Skip to the next word.
+        rank |= 63;
+        continue;
       }
-
-      for (int32_t rank = 0; rank < global_size; ++rank) {
-        if (ready_ranks.find(rank) == ready_ranks.end()) {
-          missing_ranks[rank].insert(tensor_name);
-          if (stall_shutdown_time > std::chrono::seconds(0) &&
-              lag > stall_shutdown_time) {
-            shutdown_ranks.insert(rank);
-            should_shut_down = true;
-          }
+      if ((word & (1ULL << (rank % 64))) == 0) {
+        missing_ranks[rank].insert(tensor_name);
+        if (shut_down) {
+          shutdown_ranks.insert(rank);
+          should_shut_down = true;
         }
       }
     }
@@ -125,21 +124,97 @@ void StallInspector::InvalidateStalledCachedTensors(
   }
 }
 
-void StallInspector::RecordUncachedTensorStart(const std::string& tensor_name,
-                                               int rank, int global_size) {
+void StallInspector::AdvanceWheel() {
+  int64_t tick = Tick(std::chrono::steady_clock::now());
+  // Every slot has been visited once after that many ticks.
+  int64_t first_tick = std::max(wheel_tick_ + 1, tick - WHEEL_SLOTS + 1);
+  for (int64_t t = first_tick; t <= tick; ++t) {
+    auto& slot = wheel_[t % WHEEL_SLOTS];
+    size_t kept = 0;
+    for (auto& entry : slot) {
+      auto it = uncached_tensor_table.find(entry.tensor_name);
+      if (it == uncached_tensor_table.end() ||
+          it->second.start_at != entry.start_at) {
+        continue;
+      }
+      if (entry.expire_tick <= tick) {
+        stalled_tensors_.insert(entry.tensor_name);
+      } else {
+        slot[kept++] = std::move(entry);
+      }
+    }
+    slot.resize(kept);
+  }
+  wheel_tick_ = std::max(wheel_tick_, tick);
+}
+
+int64_t
+StallInspector::Tick(std::chrono::steady_clock::time_point time) const {
+  return std::chrono::duration_cast<std::chrono::seconds>(time - wheel_epoch_)
+      .count();
+}
+
+void StallInspector::RecordUncachedTensorStart(
+    const std::string& tensor_name, int rank, int global_size,
+    const std::vector<int>* members) {
   auto table_iter = uncached_tensor_table.find(tensor_name);
   if (table_iter == uncached_tensor_table.end()) {
-    std::vector<int> ranks = {rank};
-    ranks.reserve(static_cast<unsigned long>(global_size));
-    auto now = std::chrono::steady_clock::now();
-    uncached_tensor_table.emplace(tensor_name,
-                                  std::make_tuple(std::move(ranks), now));
-  } else {
-    std::vector<int>& ranks = std::get<0>(table_iter->second);
-    ranks.push_back(rank);
+    UncachedTensor tensor;
+    tensor.ready_ranks.resize((global_size + 63) / 64);
+    if (members != nullptr) {
+      for (int r = 0; r < global_size; ++r) {
+        if (!std::binary_search(members->begin(), members->end(), r)) {
+          tensor.ready_ranks[r / 64] |= 1ULL << (r % 64);
+          ++tensor.ready_count;
+        }
+      }
+    }
+    tensor.start_at = std::chrono::steady_clock::now();
+    if (perform_stall_check) {
+      // Round up, so that the tensor is not reported before its time.
+      int64_t expire_tick =
+          Tick(tensor.start_at) + stall_warning_time_seconds + 1;
+      wheel_[expire_tick % WHEEL_SLOTS].push_back(
+          WheelEntry{tensor_name, tensor.start_at, expire_tick});
+    }
+    table_iter =
+        uncached_tensor_table.emplace(tensor_name, std::move(tensor)).first;
+  }
+
+  auto& tensor = table_iter->second;
+  uint64_t bit = 1ULL << (rank % 64);
+  if ((tensor.ready_ranks[rank / 64] & bit) == 0) {
+    tensor.ready_ranks[rank / 64] |= bit;
+    if (++tensor.ready_count == global_size) {
+      if (last_arrival_counts_.size() < static_cast<size_t>(global_size)) {
+        last_arrival_counts_.resize(global_size);
+      }
+      ++last_arrival_counts_[rank];
+    }
   }
 }
 
+std::vector<std::pair<int32_t, uint64_t>>
+StallInspector::GetStragglers(int count) const {
+  std::vector<std::pair<int32_t, uint64_t>> stragglers;
+  for (size_t rank = 0; rank < last_arrival_counts_.size(); ++rank) {
+    if (last_arrival_counts_[rank] > 0) {
+      stragglers.emplace_back(static_cast<int32_t>(rank),
+                              last_arrival_counts_[rank]);
+    }
+  }
+  count = std::min(count, static_cast<int>(stragglers.size()));
+  std::partial_sort(stragglers.begin(), stragglers.begin() + count,
+                    stragglers.end(),
+                    [](const std::pair<int32_t, uint64_t>& a,
+                       const std::pair<int32_t, uint64_t>& b) {
+                      return a.second > b.second ||
+                             (a.second == b.second && a.first < b.first);
+                    });
+  stragglers.resize(count);
+  return stragglers;
+}
+
 void StallInspector::RecordCachedTensorStart(const std::string& tensor_name) {
   if (perform_stall_check &&
       cached_tensor_table.find(tensor_name) == cached_tensor_table.end()) {
@@ -154,7 +229,10 @@ void StallInspector::RemoveCachedTensor(const std::string& tensor_name) {
 }
 
 void StallInspector::RemoveUncachedTensor(const std::string& tensor_name) {
-  uncached_tensor_table.erase(tensor_name);
+  // The wheel entry, if any, is dropped when its slot is next visited.
+  if (uncached_tensor_table.erase(tensor_name) > 0) {
+    stalled_tensors_.erase(tensor_name);
+  }
 }
 
 bool StallInspector::ShouldPerformCheck() {
@@ -163,6 +241,17 @@ bool StallInspector::ShouldPerformCheck() {
              std::chrono::seconds(stall_warning_time_seconds);
 }
 
+void StallInspector::Clear() {
+  cached_tensor_table.clear();
+  uncached_tensor_table.clear();
+  for (auto& slot : wheel_) {
+    slot.clear();
+  }
+  stalled_tensors_.clear();
+  stalled_tensor_count_ = 0;
+  last_arrival_counts_.clear();
+}
+
 void StallInspector::UpdateCheckTime() {
   last_stall_check = std::chrono::steady_clock::now();
 }
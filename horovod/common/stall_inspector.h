@@ -19,6 +19,9 @@
 #include <chrono>
 #include <iostream>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "response_cache.h"
 
@@ -36,8 +39,14 @@ public:
 
   // Report Tensors that were submitted to be reduced, gathered or broadcasted by
   // some ranks but not others and are waiting for long time to get processed.
+  // Only the tensors already found stalled by the timing wheel are visited.
   bool CheckForStalledTensors(int global_size);
 
+  // Move the uncached tensors whose warning time has passed since the last
+  // call to the stalled set. Cheap enough to be called every cycle, it visits
+  // at most the wheel slots of the elapsed seconds.
+  void AdvanceWheel();
+
   // Invalidate cached tensors that have been pending for a long time.
   void InvalidateStalledCachedTensors(CacheCoordinator& cache_coordinator);
 
@@ -45,8 +54,11 @@ public:
   void RecordCachedTensorStart(const std::string& tensor_name);
 
   // Record initial time for an uncached tensor is encountered in queue.
+  // members are the sorted ranks of the process set of the tensor, or null
+  // for all ranks; the other ranks are never reported as missing.
   void RecordUncachedTensorStart(const std::string& tensor_name, int rank,
-                                 int global_size);
+                                 int global_size,
+                                 const std::vector<int>* members = nullptr);
 
   // Remove timing entry if cached or marked invalid.
   void RemoveCachedTensor(const std::string& tensor_name);
@@ -60,6 +72,16 @@ public:
   // Update last check time.
   void UpdateCheckTime();
 
+  // Forget the tensors seen so far, whose ranks may no longer exist.
+  void Clear();
+
+  // Number of tensors found stalled by the last check.
+  int GetStalledTensorCount() const { return stalled_tensor_count_; }
+
+  // Up to count ranks whose request most often was the last one needed to
+  // negotiate an uncached tensor, with their counts, most frequent first.
+  std::vector<std::pair<int32_t, uint64_t>> GetStragglers(int count) const;
+
   void SetPerformStallCheck(bool value);
   void SetStallWarningTimeSeconds(int value);
   void SetStallShutdownTimeSeconds(int value);
@@ -84,12 +106,43 @@ protected:
   std::unordered_map<std::string, std::chrono::steady_clock::time_point>
       cached_tensor_table;
 
-  // Initial time that tensors are seen in the normal message queue. The value
-  // consists of a list of ready ranks and the starting point.
-  std::unordered_map<
-      std::string,
-      std::tuple<std::vector<int>, std::chrono::steady_clock::time_point>>
-      uncached_tensor_table;
+  // Ranks that submitted a tensor seen in the normal message queue, as a
+  // bitmap of 64 ranks per word, and the time the first one did.
+  struct UncachedTensor {
+    std::vector<uint64_t> ready_ranks;
+    int ready_count = 0;
+    std::chrono::steady_clock::time_point start_at;
+  };
+
+  std::unordered_map<std::string, UncachedTensor> uncached_tensor_table;
+
+  // Timing wheel of one second slots over the uncached tensors. A tensor is
+  // filed under the second its warning time expires, and slots are wrapped
+  // around, so an entry is only moved once that second has passed. Entries
+  // of tensors removed or recorded again since are dropped when their slot
+  // is visited, recognized by a start time that no longer matches the table.
+  struct WheelEntry {
+    std::string tensor_name;
+    std::chrono::steady_clock::time_point start_at;
+    int64_t expire_tick;
+  };
+
+  static constexpr int WHEEL_SLOTS = 64;
+
+  int64_t Tick(std::chrono::steady_clock::time_point time) const;
+
+  std::vector<WheelEntry> wheel_[WHEEL_SLOTS];
+  std::chrono::steady_clock::time_point wheel_epoch_ =
+      std::chrono::steady_clock::now();
+  int64_t wheel_tick_ = 0;
+
+  // Uncached tensors pending for longer than the warning time.
+  std::unordered_set<std::string> stalled_tensors_;
+
+  int stalled_tensor_count_ = 0;
+
+  // Number of uncached tensors whose negotiation was completed by each rank.
+  std::vector<uint64_t> last_arrival_counts_;
 
   // Outside dependencies
   ResponseCache& response_cache_;
@@ -16,54 +16,383 @@
 #include "tensor_queue.h"
 
 #include <assert.h>
+#include <cstring>
 
+#include "half.h"
 #include "logging.h"
 
 namespace horovod {
 namespace common {
 
+namespace {
+
+template <typename T>
+void SumValues(const T* a, const T* b, T* out, int64_t n) {
+  for (int64_t i = 0; i < n; ++i) {
+    out[i] = a[i] + b[i];
+  }
+}
+
+// Sums n elements of a and b into out, which may alias a.
+void SumBuffers(DataType dtype, const void* a, const void* b, void* out,
+                int64_t n) {
+  switch (dtype) {
+  case HOROVOD_UINT8:
+    SumValues((const uint8_t*)a, (const uint8_t*)b, (uint8_t*)out, n);
+    break;
+  case HOROVOD_INT8:
+    SumValues((const int8_t*)a, (const int8_t*)b, (int8_t*)out, n);
+    break;
+  case HOROVOD_UINT16:
+    SumValues((const uint16_t*)a, (const uint16_t*)b, (uint16_t*)out, n);
+    break;
+  case HOROVOD_INT16:
+    SumValues((const int16_t*)a, (const int16_t*)b, (int16_t*)out, n);
+    break;
+  case HOROVOD_INT32:
+    SumValues((const int32_t*)a, (const int32_t*)b, (int32_t*)out, n);
+    break;
+  case HOROVOD_INT64:
+    SumValues((const int64_t*)a, (const int64_t*)b, (int64_t*)out, n);
+    break;
+  case HOROVOD_FLOAT16:
+    Float16Sum((const uint16_t*)a, (const uint16_t*)b, (uint16_t*)out, n);
+    break;
+  case HOROVOD_BFLOAT16:
+    BFloat16Sum((const uint16_t*)a, (const uint16_t*)b, (uint16_t*)out, n);
+    break;
+  case HOROVOD_FLOAT32:
+    SumValues((const float*)a, (const float*)b, (float*)out, n);
+    break;
+  case HOROVOD_FLOAT64:
+    SumValues((const double*)a, (const double*)b, (double*)out, n);
+    break;
+  default:
+    throw std::logic_error("Type " + DataType_Name(dtype) +
+                           " cannot be accumulated.");
+  }
+}
+
+int64_t ElementSize(DataType dtype) {
+  switch (dtype) {
+  case HOROVOD_UINT8:
+  case HOROVOD_INT8:
+  case HOROVOD_BOOL:
+  case HOROVOD_BYTE:
+    return 1;
+  case HOROVOD_UINT16:
+  case HOROVOD_INT16:
+  case HOROVOD_FLOAT16:
+  case HOROVOD_BFLOAT16:
+    return 2;
+  case HOROVOD_INT32:
+  case HOROVOD_FLOAT32:
+    return 4;
+  default:
+    return 8;
+  }
+}
+
+// Tensor of zeros in host memory standing in for the submission of a rank
+// left out of a partial allreduce, or of a rank that joined.
+class HostTensor : public Tensor {
+public:
+  HostTensor(DataType dtype, const TensorShape& shape, int64_t size)
+      : dtype_(dtype), shape_(shape), buffer_((size_t)size, 0) {}
+
+  const DataType dtype() const override { return dtype_; }
+  const TensorShape shape() const override { return shape_; }
+  const void* data() const override { return buffer_.data(); }
+  int64_t size() const override { return (int64_t)buffer_.size(); }
+
+private:
+  DataType dtype_;
+  TensorShape shape_;
+  std::vector<uint8_t> buffer_;
+};
+
+class HostPersistentBuffer : public PersistentBuffer {
+public:
+  explicit HostPersistentBuffer(int64_t size) : buffer_((size_t)size) {}
+
+  const void* AccessData(std::shared_ptr<OpContext> context) const override {
+    return buffer_.data();
+  }
+
+private:
+  std::vector<uint8_t> buffer_;
+};
+
+// Context of the entries standing in for a rank left out of a partial
+// allreduce. It reports the framework of the rank's own submissions, so that
+// they share the fusion buffer.
+class HostOpContext : public OpContext {
+public:
+  explicit HostOpContext(Framework framework) : framework_(framework) {}
+
+  Status AllocatePersistent(int64_t size,
+                            std::shared_ptr<PersistentBuffer>* tensor) override {
+    *tensor = std::make_shared<HostPersistentBuffer>(size);
+    return Status::OK();
+  }
+
+  Status AllocateOutput(TensorShape shape,
+                        std::shared_ptr<Tensor>* tensor) override {
+    return Status::PreconditionError(
+        "Outputs are not allocated for ranks left out of an allreduce.");
+  }
+
+  Framework framework() const override { return framework_; }
+
+private:
+  Framework framework_;
+};
+
+} // namespace
+
+TensorQueue::~TensorQueue() {
+  auto node = pending_.exchange(nullptr);
+  while (node != nullptr) {
+    auto next = node->next;
+    delete node;
+    node = next;
+  }
+}
+
+TensorQueue::NameShard&
+TensorQueue::GetNameShard(const std::string& tensor_name) {
+  return name_shards_[std::hash<std::string>()(tensor_name) % NAME_SHARDS];
+}
+
+void TensorQueue::ReleaseName(const std::string& tensor_name) {
+  auto& shard = GetNameShard(tensor_name);
+  std::lock_guard<std::mutex> guard(shard.mutex);
+  shard.names.erase(tensor_name);
+}
+
 // Add a TensorTableEntry as well as its message to the queue.
 Status TensorQueue::AddToTensorQueue(TensorTableEntry& e, Request& message) {
-  std::lock_guard<std::mutex> guard(mutex_);
-  if (tensor_table_.find(e.tensor_name) != tensor_table_.end()) {
-    return DUPLICATE_NAME_ERROR;
+  {
+    auto& shard = GetNameShard(e.tensor_name);
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    if (!shard.names.insert(e.tensor_name).second) {
+      return DUPLICATE_NAME_ERROR;
+    }
   }
-  tensor_table_.emplace(e.tensor_name, std::move(e));
-  message_queue_.push(message);
+
+  auto node = new PendingTensor();
+  node->entry = std::move(e);
+  node->message = std::move(message);
+  PushPendingTensor(node);
   return Status::OK();
 }
 
+Status TensorQueue::AddToTensorQueueGroup(std::vector<TensorTableEntry>& entries,
+                                          Request& message) {
+  // Reserve the names of the group and of its tensors, or none of them.
+  std::vector<std::string> names;
+  names.reserve(entries.size() + 1);
+  names.push_back(message.tensor_name());
+  for (auto& e : entries) {
+    names.push_back(e.tensor_name);
+  }
+  for (size_t i = 0; i < names.size(); ++i) {
+    bool inserted;
+    {
+      auto& shard = GetNameShard(names[i]);
+      std::lock_guard<std::mutex> guard(shard.mutex);
+      inserted = shard.names.insert(names[i]).second;
+    }
+    if (!inserted) {
+      for (size_t j = 0; j < i; ++j) {
+        ReleaseName(names[j]);
+      }
+      return DUPLICATE_NAME_ERROR;
+    }
+  }
+
+  // Entries are pushed in order, so the background thread never sees the
+  // message of the group before all of its tensors.
+  for (size_t i = 0; i < entries.size(); ++i) {
+    auto node = new PendingTensor();
+    node->entry = std::move(entries[i]);
+    node->entry.group_name = message.tensor_name();
+    if (i == entries.size() - 1) {
+      node->message = std::move(message);
+      node->group_tensor_names.assign(names.begin() + 1, names.end());
+    } else {
+      node->has_message = false;
+    }
+    PushPendingTensor(node);
+  }
+  return Status::OK();
+}
+
+void TensorQueue::PushPendingTensor(PendingTensor* node) {
+  node->next = pending_.load(std::memory_order_relaxed);
+  while (!pending_.compare_exchange_weak(node->next, node)) {
+  }
+
+  // Pairs with the store to waiting_ in WaitForNewMessages: either the
+  // waiter sees the new tensor or we see the waiter.
+  if (waiting_.load()) {
+    std::lock_guard<std::mutex> guard(wait_mutex_);
+    cond_.notify_one();
+  }
+}
+
+bool TensorQueue::GetGroupTensorNames(
+    const std::string& group_name,
+    std::vector<std::string>& tensor_names) const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto it = groups_.find(group_name);
+  if (it == groups_.end()) {
+    return false;
+  }
+  tensor_names = it->second.tensor_names;
+  return true;
+}
+
+void TensorQueue::DrainPendingTensors() {
+  auto node = pending_.exchange(nullptr, std::memory_order_acquire);
+
+  // Reverse the stack to recover submission order.
+  PendingTensor* head = nullptr;
+  while (node != nullptr) {
+    auto next = node->next;
+    node->next = head;
+    head = node;
+    node = next;
+  }
+
+  while (head != nullptr) {
+    auto& name = head->entry.tensor_name;
+    if (head->has_message) {
+      auto& message_name = head->message.tensor_name();
+      int32_t tensor_id = InternTensorName(message_name);
+      head->message.set_tensor_id(tensor_id);
+      head->entry.tensor_id = tensor_id;
+      if ((size_t)tensor_id >= fusion_attributes_.size()) {
+        fusion_attributes_.resize(tensor_id + 1);
+      }
+      auto& attributes = fusion_attributes_[tensor_id];
+      auto& entry = head->entry;
+      if (attributes.priority != entry.priority ||
+          attributes.prescale_factor != entry.prescale_factor ||
+          attributes.postscale_factor != entry.postscale_factor) {
+        attributes.priority = entry.priority;
+        attributes.prescale_factor = entry.prescale_factor;
+        attributes.postscale_factor = entry.postscale_factor;
+        ++fusion_attributes_version_;
+      }
+      if (!head->entry.group_name.empty()) {
+        size_t size = head->group_tensor_names.size();
+        groups_[message_name] = {std::move(head->group_tensor_names), size};
+      }
+      message_queue_.push(std::move(head->message));
+    }
+    tensor_table_.emplace(name, std::move(head->entry));
+    auto next = head->next;
+    delete head;
+    head = next;
+  }
+}
+
+uint64_t TensorQueue::FusionAttributesVersion() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return fusion_attributes_version_;
+}
+
+int32_t TensorQueue::AcquireTensorId(const std::string& tensor_name) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return InternTensorName(tensor_name);
+}
+
+void TensorQueue::ReleaseTensorIds(const std::vector<int32_t>& tensor_ids) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  for (auto tensor_id : tensor_ids) {
+    ReleaseTensorId(tensor_id);
+  }
+}
+
+int32_t TensorQueue::InternTensorName(const std::string& tensor_name) {
+  auto it = tensor_ids_.find(tensor_name);
+  if (it != tensor_ids_.end()) {
+    ++tensor_id_holders_[it->second];
+    return it->second;
+  }
+  int32_t tensor_id;
+  if (!free_tensor_ids_.empty()) {
+    tensor_id = free_tensor_ids_.back();
+    free_tensor_ids_.pop_back();
+    tensor_id_names_[tensor_id] = tensor_name;
+  } else {
+    tensor_id = (int32_t)tensor_id_names_.size();
+    tensor_id_names_.push_back(tensor_name);
+    tensor_id_holders_.push_back(0);
+  }
+  tensor_id_holders_[tensor_id] = 1;
+  tensor_ids_.emplace(tensor_name, tensor_id);
+  return tensor_id;
+}
+
+void TensorQueue::ReleaseTensorId(int32_t tensor_id) {
+  if (tensor_id < 0 || --tensor_id_holders_[tensor_id] > 0) {
+    return;
+  }
+  tensor_ids_.erase(tensor_id_names_[tensor_id]);
+  tensor_id_names_[tensor_id].clear();
+  free_tensor_ids_.push_back(tensor_id);
+}
+
 // Put callbacks for each tensor in the callback buffer and clear tensor queue
 void TensorQueue::FinalizeTensorQueue(
     std::vector<StatusCallback>& callbacks_buffer) {
   std::lock_guard<std::mutex> guard(mutex_);
+  DrainPendingTensors();
   for (auto& e : tensor_table_) {
     callbacks_buffer.emplace_back(e.second.callback);
+    ReleaseName(e.first);
+    ReleaseTensorId(e.second.tensor_id);
   }
   tensor_table_.clear();
+  for (auto& group : groups_) {
+    ReleaseName(group.first);
+  }
+  groups_.clear();
   while (!message_queue_.empty()) {
     message_queue_.pop();
   }
+
+  std::lock_guard<std::mutex> stale_guard(stale_mutex_);
+  for (auto& stale : stale_tensors_) {
+    for (auto& e : stale.second.late_entries) {
+      callbacks_buffer.emplace_back(e.callback);
+    }
+  }
+  stale_tensors_.clear();
 }
 
 // Helper function to get list of allreduced tensor names and total size for
 // use with the autotuner.
-int64_t
+void
 TensorQueue::GetTensorDataForAutotuner(const ResponseList& response_list,
-                                       std::vector<std::string>& tensor_names) {
-  int64_t total_tensor_size = 0;
+                                       std::vector<std::string>& tensor_names,
+                                       std::vector<int64_t>& tensor_sizes) {
   for (auto& response : response_list.responses()) {
     if (response.response_type() == Response::ResponseType::ALLREDUCE) {
       for (auto& tensor_name : response.tensor_names()) {
+        // Tensors of partial allreduces this rank was left out of are not
+        // in the table.
+        auto iter = tensor_table_.find(tensor_name);
+        if (iter == tensor_table_.end()) {
+          continue;
+        }
         tensor_names.push_back(tensor_name);
-        LOG(TRACE) << "Looking for tensor with name " << tensor_name;
-        auto& entry = tensor_table_.at(tensor_name);
-        LOG(TRACE) << "Found tensor with name " << tensor_name;
-        total_tensor_size += entry.tensor->size();
+        tensor_sizes.push_back(iter->second.tensor->size());
       }
     }
   }
-  return total_tensor_size;
 }
 
 // Parse tensor names from response and generate a vector of corresponding
@@ -83,12 +412,27 @@ void TensorQueue::GetTensorEntriesFromResponse(
       assert(response.response_type() == Response::ALLREDUCE ||
              response.response_type() == Response::ALLGATHER ||
              response.response_type() == Response::BROADCAST ||
+             response.response_type() == Response::REDUCESCATTER ||
+             response.response_type() == Response::ALLTOALL ||
+             response.response_type() == Response::JOIN ||
              response.response_type() == Response::ERROR);
 
+      // The group is done once all of its tensors are taken out.
+      auto& group_name = iter->second.group_name;
+      if (!group_name.empty()) {
+        auto group = groups_.find(group_name);
+        if (group != groups_.end() && --group->second.remaining == 0) {
+          groups_.erase(group);
+          ReleaseName(group_name);
+        }
+      }
+
+      ReleaseTensorId(iter->second.tensor_id);
       entries.push_back(std::move(iter->second));
 
       // Clear the tensor table of this tensor.
       tensor_table_.erase(iter);
+      ReleaseName(name);
     }
   }
 }
@@ -103,15 +447,33 @@ TensorQueue::GetTensorEntry(const std::string& tensor_name) const{
   return iter;
 }
 
+bool TensorQueue::HasTensor(const std::string& tensor_name) const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return tensor_table_.find(tensor_name) != tensor_table_.end();
+}
+
 // Pop out all the messages from the queue
 void TensorQueue::PopMessagesFromQueue(
-    std::deque<Request>& message_queue_buffer) {
-  std::lock_guard<std::mutex> guard(mutex_);
-  while (!message_queue_.empty()) {
-    Request message = message_queue_.front();
-    message_queue_.pop();
-    message_queue_buffer.push_back(std::move(message));
+    std::deque<Request>& message_queue_buffer, RequestList* new_messages) {
+  std::vector<LateCompletion> completed;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    // Submitted tensors are drained behind the messages pushed back.
+    size_t pushed_back = message_queue_.size();
+    DrainPendingTensors();
+    for (size_t i = 0; !message_queue_.empty(); ++i) {
+      Request message = std::move(message_queue_.front());
+      message_queue_.pop();
+      if (new_messages != nullptr && i >= pushed_back) {
+        new_messages->add_request(message);
+      }
+      if (staleness_enabled_ && TakeLateTensor(message, completed)) {
+        continue;
+      }
+      message_queue_buffer.push_back(std::move(message));
+    }
   }
+  CompleteLateTensors(completed);
 }
 
 // Push a message to massage queue
@@ -120,5 +482,263 @@ void TensorQueue::PushMessageToQueue(Request& message) {
   message_queue_.push(std::move(message));
 }
 
+// Wait for a new tensor to be enqueued. Messages pushed back by the
+// controller for the next cycle do not count as new.
+bool TensorQueue::WaitForNewMessages(
+    std::chrono::steady_clock::time_point deadline) {
+  if (pending_.load() != nullptr) {
+    return true;
+  }
+  std::unique_lock<std::mutex> lock(wait_mutex_);
+  waiting_ = true;
+  bool woken = cond_.wait_until(
+      lock, deadline, [this] { return pending_.load() != nullptr; });
+  waiting_ = false;
+  return woken;
+}
+
+bool TensorQueue::Accumulate(TensorTableEntry& e) {
+  auto dtype = e.tensor->dtype();
+  if (dtype == HOROVOD_BOOL || dtype == HOROVOD_BYTE) {
+    return true;
+  }
+  auto size = e.tensor->size();
+  auto input = (const uint8_t*)e.tensor->data();
+  auto output = (uint8_t*)e.output->data();
+  int64_t n = e.tensor->shape().num_elements();
+
+  std::lock_guard<std::mutex> guard(accumulators_mutex_);
+  auto& acc = accumulators_[e.tensor_name];
+  if (acc.steps > 0 && (acc.dtype != dtype || (int64_t)acc.buffer.size() != size)) {
+    LOG(WARNING) << "Tensor " << e.tensor_name
+                 << " changed type or shape while accumulating, dropping the "
+                 << acc.steps << " accumulated steps.";
+    acc.steps = 0;
+  }
+
+  if (acc.steps + 1 == accumulation_steps_) {
+    // Last step, the sum goes to the output.
+    if (acc.steps == 0) {
+      if (output != input) {
+        std::memmove(output, input, (size_t)size);
+      }
+    } else {
+      SumBuffers(dtype, acc.buffer.data(), input, output, n);
+    }
+    acc.steps = 0;
+    e.tensor = e.output;
+    return true;
+  }
+
+  if (acc.steps == 0) {
+    acc.dtype = dtype;
+    acc.buffer.assign(input, input + size);
+  } else {
+    SumBuffers(dtype, acc.buffer.data(), input, acc.buffer.data(), n);
+  }
+  ++acc.steps;
+  if (output != input) {
+    std::memcpy(output, input, (size_t)size);
+  }
+  return false;
+}
+
+void TensorQueue::MarkLate(const std::vector<std::string>& tensor_names) {
+  std::lock_guard<std::mutex> guard(stale_mutex_);
+  for (auto& name : tensor_names) {
+    ++stale_tensors_[name].missed;
+  }
+}
+
+bool TensorQueue::TakeLateTensor(const Request& message,
+                                 std::vector<LateCompletion>& completed) {
+  // Groups are negotiated under the group name, which is not in the table.
+  auto iter = tensor_table_.find(message.tensor_name());
+  if (message.request_type() != Request::ALLREDUCE ||
+      iter == tensor_table_.end()) {
+    return false;
+  }
+  auto& e = iter->second;
+  if (e.device != CPU_DEVICE_ID || e.reduce_op != ReduceOp::SUM ||
+      !e.group_name.empty()) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> guard(stale_mutex_);
+  auto& stale = stale_tensors_[e.tensor_name];
+  auto dtype = e.tensor->dtype();
+  if (stale.missed == 0) {
+    stale.dtype = dtype;
+    stale.shape = e.tensor->shape();
+    stale.framework = e.context->framework();
+    stale.postscale_factor = e.postscale_factor;
+    return false;
+  }
+
+  --stale.missed;
+  ReleaseTensorId(e.tensor_id);
+  e.tensor_id = -1;
+  auto input = (const uint8_t*)e.tensor->data();
+  if (stale.late_sum.empty()) {
+    stale.late_sum.assign(input, input + e.tensor->size());
+  } else if ((int64_t)stale.late_sum.size() == e.tensor->size()) {
+    SumBuffers(dtype, stale.late_sum.data(), input, stale.late_sum.data(),
+               e.tensor->shape().num_elements());
+  }
+  stale.late_entries.push_back(std::move(e));
+  tensor_table_.erase(iter);
+  ReleaseName(message.tensor_name());
+  MatchLateTensors(stale, completed);
+  return true;
+}
+
+void TensorQueue::MatchLateTensors(StaleTensor& stale,
+                                   std::vector<LateCompletion>& completed) {
+  while (!stale.late_entries.empty() && !stale.results.empty()) {
+    completed.emplace_back(std::move(stale.late_entries.front()),
+                           std::move(stale.results.front()));
+    stale.late_entries.pop_front();
+    stale.results.pop_front();
+  }
+}
+
+void TensorQueue::CompleteLateTensors(std::vector<LateCompletion>& completed) {
+  for (auto& item : completed) {
+    auto& e = item.first;
+    auto& result = item.second;
+    if (result.status.ok()) {
+      std::memcpy((void*)e.output->data(), result.output->data(),
+                  (size_t)std::min(e.output->size(), result.output->size()));
+    }
+    e.callback(result.status);
+  }
+}
+
+Status TensorQueue::GetStaleEntries(const Response& response,
+                                    std::vector<TensorTableEntry>& entries) {
+  std::lock_guard<std::mutex> guard(stale_mutex_);
+  // The coordinator sends the number of elements of every tensor, so that
+  // the zeros match the tensors of the ranks present.
+  auto dtype = response.tensor_type();
+  auto& names = response.tensor_names();
+  if (response.tensor_sizes().size() != names.size()) {
+    return Status::PreconditionError(
+        "Response carries " + std::to_string(response.tensor_sizes().size()) +
+        " tensor sizes for " + std::to_string(names.size()) + " tensors.");
+  }
+  entries.reserve(names.size());
+  for (size_t i = 0; i < names.size(); ++i) {
+    auto& name = names[i];
+    // The coordinator only leaves out ranks that submitted the tensor before.
+    auto iter = stale_tensors_.find(name);
+    if (iter == stale_tensors_.end()) {
+      return Status::PreconditionError("Left out of the partial allreduce of " +
+                                       name + ", which was never submitted.");
+    }
+    auto& stale = iter->second;
+
+    int64_t num_elements = response.tensor_sizes()[i];
+    TensorShape shape;
+    if (stale.dtype == dtype && stale.shape.num_elements() == num_elements) {
+      shape = stale.shape;
+    } else {
+      shape.AddDim(num_elements);
+    }
+    auto tensor = std::make_shared<HostTensor>(
+        dtype, shape, num_elements * ElementSize(dtype));
+    TensorTableEntry e;
+    e.tensor_name = name;
+    e.context = std::make_shared<HostOpContext>(stale.framework);
+    e.tensor = tensor;
+    e.output = tensor;
+    e.device = CPU_DEVICE_ID;
+    e.postscale_factor = stale.postscale_factor;
+    e.reduce_op = response.reduce_op();
+    e.callback = [this, name, tensor](const Status& status) {
+      std::vector<LateCompletion> completed;
+      {
+        std::lock_guard<std::mutex> guard(stale_mutex_);
+        auto& stale = stale_tensors_[name];
+        stale.results.push_back({status, tensor});
+        MatchLateTensors(stale, completed);
+      }
+      CompleteLateTensors(completed);
+    };
+    entries.push_back(std::move(e));
+  }
+  return Status::OK();
+}
+
+void TensorQueue::FoldLateTensors(std::vector<TensorTableEntry>& entries) {
+  std::lock_guard<std::mutex> guard(stale_mutex_);
+  for (auto& e : entries) {
+    auto iter = stale_tensors_.find(e.tensor_name);
+    if (iter == stale_tensors_.end() || iter->second.late_sum.empty()) {
+      continue;
+    }
+    auto& stale = iter->second;
+    auto dtype = e.tensor->dtype();
+    if (dtype == stale.dtype &&
+        (int64_t)stale.late_sum.size() == e.tensor->size()) {
+      SumBuffers(dtype, e.tensor->data(), stale.late_sum.data(),
+                 (void*)e.output->data(), e.tensor->shape().num_elements());
+      e.tensor = e.output;
+    } else {
+      LOG(WARNING) << "Tensor " << e.tensor_name
+                   << " changed type or shape, dropping its late "
+                      "submissions.";
+    }
+    stale.late_sum.clear();
+  }
+}
+
+Status TensorQueue::GetJoinedEntries(const Response& response,
+                                     std::vector<TensorTableEntry>& entries) {
+  std::shared_ptr<OpContext> context;
+  int device;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto& join = tensor_table_.at(JOIN_TENSOR_NAME);
+    context = join.context;
+    device = join.device;
+  }
+
+  // The coordinator sends the number of elements of every tensor, since this
+  // rank has none of its own.
+  auto dtype = response.tensor_type();
+  auto& names = response.tensor_names();
+  if (response.tensor_sizes().size() != names.size()) {
+    return Status::PreconditionError(
+        "Response carries " + std::to_string(response.tensor_sizes().size()) +
+        " tensor sizes for " + std::to_string(names.size()) + " tensors.");
+  }
+  entries.reserve(names.size());
+  for (size_t i = 0; i < names.size(); ++i) {
+    int64_t num_elements = response.tensor_sizes()[i];
+    std::shared_ptr<Tensor> tensor;
+    if (device == CPU_DEVICE_ID) {
+      TensorShape shape;
+      shape.AddDim(num_elements);
+      tensor = std::make_shared<HostTensor>(dtype, shape,
+                                            num_elements * ElementSize(dtype));
+    } else {
+      Status status = context->AllocateZeros(num_elements, dtype, &tensor);
+      if (!status.ok()) {
+        return status;
+      }
+    }
+    TensorTableEntry e;
+    e.tensor_name = names[i];
+    e.context = context;
+    e.tensor = tensor;
+    e.output = tensor;
+    e.device = device;
+    e.reduce_op = response.reduce_op();
+    e.callback = [](const Status& status) {};
+    entries.push_back(std::move(e));
+  }
+  return Status::OK();
+}
+
 } // namespace common
-} // namespace horovod
\ No newline at end of file
+} // namespace horovod
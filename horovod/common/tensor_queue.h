@@ -16,9 +16,14 @@
 #ifndef HOROVOD_TENSOR_QUEUE_H
 #define HOROVOD_TENSOR_QUEUE_H
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <iostream>
 #include <mutex>
 #include <queue>
+#include <unordered_set>
 
 #include "common.h"
 
@@ -29,32 +34,243 @@ class TensorQueue {
 public:
   TensorQueue() = default;
   TensorQueue(const TensorQueue&) = delete;
+  ~TensorQueue();
+
+  // Safe to call from any number of framework threads. Submission does not
+  // take the lock shared with the background thread; the tensor is handed
+  // over through a lock-free list and moved into the tensor table on the
+  // next PopMessagesFromQueue.
   Status AddToTensorQueue(TensorTableEntry& e, Request& message);
 
+  // Adds the entries of a group, whose names must be unique like the names of
+  // the entries, with the single message negotiating all of them.
+  Status AddToTensorQueueGroup(std::vector<TensorTableEntry>& entries,
+                               Request& message);
+
+  // Sets the names of the tensors of the group in enqueue order, and returns
+  // false if no such group is waiting.
+  bool GetGroupTensorNames(const std::string& group_name,
+                           std::vector<std::string>& tensor_names) const;
+
   void FinalizeTensorQueue(std::vector<StatusCallback>& callbacks_buffer);
 
-  int64_t GetTensorDataForAutotuner(const ResponseList& response_list,
-                                    std::vector<std::string>& tensor_names);
+  // Appends the names and sizes of the allreduced tensors of the responses.
+  void GetTensorDataForAutotuner(const ResponseList& response_list,
+                                 std::vector<std::string>& tensor_names,
+                                 std::vector<int64_t>& tensor_sizes);
 
   void GetTensorEntriesFromResponse(Response& response,
                                     std::vector<TensorTableEntry>& entries);
 
   const TensorTableEntry& GetTensorEntry(const std::string& tensor_name) const;
 
-  void PopMessagesFromQueue(std::deque<Request>& message_queue_buffer);
+  // Whether a tensor of the given name is in the tensor table.
+  bool HasTensor(const std::string& tensor_name) const;
+
+  // Returns the interned ID of the tensor name and holds it for the caller,
+  // assigning a free one if the name is not interned.
+  int32_t AcquireTensorId(const std::string& tensor_name);
+
+  // Drops holds taken by AcquireTensorId. An ID no longer held by anyone is
+  // reused for another name.
+  void ReleaseTensorIds(const std::vector<int32_t>& tensor_ids);
+
+  // Appends the messages to negotiate this cycle to message_queue_buffer. If
+  // new_messages is set, the messages of tensors submitted since the last
+  // call, as opposed to messages pushed back for another cycle, are also
+  // added to it.
+  void PopMessagesFromQueue(std::deque<Request>& message_queue_buffer,
+                            RequestList* new_messages = nullptr);
+
+  // Incremented whenever a tensor is submitted with another priority or
+  // other scale factors than the last time its name was submitted, which
+  // may change how it is fused with others.
+  uint64_t FusionAttributesVersion() const;
 
   void PushMessageToQueue(Request& message);
 
+  // Block until a new tensor is enqueued or the deadline is reached. Returns
+  // true if woken up by a new tensor.
+  bool WaitForNewMessages(std::chrono::steady_clock::time_point deadline);
+
+  // Whether a tensor was enqueued and not popped yet, without blocking.
+  bool HasNewMessages() const { return pending_.load() != nullptr; }
+
+  // Gradient accumulation: sum allreduces of tensors in host memory locally
+  // over this many submissions of their name before allreducing the sum.
+  void SetAccumulationSteps(int steps) { accumulation_steps_ = steps; }
+
+  int AccumulationSteps() const { return accumulation_steps_; }
+
+  // Adds the tensor of the entry to the accumulator of its name. On the last
+  // of the accumulated steps the sum is written to the output, which the
+  // entry then allreduces in place, and true is returned. Otherwise the
+  // output holds the local tensor and the entry is done.
+  bool Accumulate(TensorTableEntry& e);
+
+  // Bounded staleness, see Controller::SetStaleness. The tensors of single
+  // allreduces in host memory are remembered as they are negotiated, so that
+  // this rank can take part in the allreduces it is left out of.
+  void SetStalenessEnabled(bool value) { staleness_enabled_ = value; }
+
+  bool StalenessEnabled() const { return staleness_enabled_; }
+
+  // Records that this rank was left out of partial allreduces of the tensors.
+  // Their late submissions are not negotiated, but completed with the results
+  // of these allreduces and summed into the next allreduce of their name.
+  void MarkLate(const std::vector<std::string>& tensor_names);
+
+  // Sets entries of zeros for the tensors of a partial allreduce this rank
+  // was left out of, sized by the response. Their results are kept for the
+  // late submissions. Fails if the response lacks the sizes, or this rank
+  // never submitted one of the tensors.
+  Status GetStaleEntries(const Response& response,
+                         std::vector<TensorTableEntry>& entries);
+
+  // Sums the late submissions of the tensors of the entries into their
+  // inputs.
+  void FoldLateTensors(std::vector<TensorTableEntry>& entries);
+
+  // Sets entries of zeros on the device this rank joined with, see
+  // EnqueueJoin, for the tensors of a response this rank takes part in
+  // without having submitted them. Must only be called while the join entry
+  // is in the tensor table.
+  Status GetJoinedEntries(const Response& response,
+                          std::vector<TensorTableEntry>& entries);
+
 protected:
+  // Tensor submitted by a framework thread and not yet moved into the tensor
+  // table by the background thread.
+  struct PendingTensor {
+    TensorTableEntry entry;
+    Request message;
+    // Only the last tensor of a group carries a message, with the names of
+    // all tensors of the group.
+    bool has_message = true;
+    std::vector<std::string> group_tensor_names;
+    PendingTensor* next = nullptr;
+  };
+
+  // Pushes a submitted tensor onto the pending list.
+  void PushPendingTensor(PendingTensor* node);
+
+  // Move submitted tensors into the tensor table and message queue in
+  // submission order. Must be called with mutex_ held.
+  void DrainPendingTensors();
+
+  // Names of tensors that were submitted and are not yet taken out by
+  // GetTensorEntriesFromResponse, used to reject duplicates at submission.
+  // Striped so that threads submitting different tensors rarely contend.
+  static constexpr int NAME_SHARDS = 16;
+  struct NameShard {
+    std::mutex mutex;
+    std::unordered_set<std::string> names;
+  };
+  NameShard& GetNameShard(const std::string& tensor_name);
+  void ReleaseName(const std::string& tensor_name);
+  NameShard name_shards_[NAME_SHARDS];
+
+  // Lock-free stack of submitted tensors, most recent first.
+  std::atomic<PendingTensor*> pending_{nullptr};
+
   // Tensors waiting to be allreduced or allgathered.
   std::unordered_map<std::string, TensorTableEntry> tensor_table_;
 
+  // Groups with tensors in the tensor table, and the number of them not yet
+  // taken out by GetTensorEntriesFromResponse.
+  struct Group {
+    std::vector<std::string> tensor_names;
+    size_t remaining;
+  };
+  std::unordered_map<std::string, Group> groups_;
+
+  // Interned tensor names, keyed by name. An ID is held by the queued tensor
+  // that carries it and by the response cache entry of the name, and is freed
+  // once neither does, so that generated names, e.g. those made from handles,
+  // do not accumulate.
+  std::unordered_map<std::string, int32_t> tensor_ids_;
+  // Name and number of holders of each ID, and IDs not assigned to a name.
+  std::vector<std::string> tensor_id_names_;
+  std::vector<int32_t> tensor_id_holders_;
+  std::vector<int32_t> free_tensor_ids_;
+
+  // Priority and scale factors a tensor was last submitted with, indexed by
+  // tensor ID.
+  struct FusionAttributes {
+    int32_t priority = 0;
+    double prescale_factor = 1.0;
+    double postscale_factor = 1.0;
+  };
+  std::vector<FusionAttributes> fusion_attributes_;
+  uint64_t fusion_attributes_version_ = 0;
+
+  // Must be called with mutex_ held.
+  int32_t InternTensorName(const std::string& tensor_name);
+  void ReleaseTensorId(int32_t tensor_id);
+
   // Queue of MPI requests waiting to be sent to the coordinator node.
   std::queue<Request> message_queue_;
 
-  // A mutex that needs to be used whenever operations on message queue are
-  // done.
+  // Guards the tensor table and message queue. Only taken by the background
+  // threads (negotiation and, when pipelined, execution).
   mutable std::mutex mutex_;
+
+  // Local sums of the tensors being accumulated, keyed by name. Taken by the
+  // framework threads submitting them.
+  struct Accumulator {
+    DataType dtype;
+    std::vector<uint8_t> buffer;
+    int steps = 0;
+  };
+  std::unordered_map<std::string, Accumulator> accumulators_;
+  std::mutex accumulators_mutex_;
+  int accumulation_steps_ = 1;
+
+  // Tensors allreduced with bounded staleness, keyed by name: the type, shape
+  // and attributes of the last submission, the number of partial allreduces
+  // this rank was left out of whose late submissions have not been taken out
+  // of the queue yet, the results of these allreduces and the late
+  // submissions waiting for them, and the sum of the late submissions not
+  // yet folded into an allreduce.
+  struct StaleResult {
+    Status status;
+    std::shared_ptr<Tensor> output;
+  };
+  struct StaleTensor {
+    DataType dtype = HOROVOD_FLOAT32;
+    TensorShape shape;
+    Framework framework = Framework::TENSORFLOW;
+    double postscale_factor = 1.0;
+    int missed = 0;
+    std::deque<StaleResult> results;
+    std::deque<TensorTableEntry> late_entries;
+    std::vector<uint8_t> late_sum;
+  };
+  using LateCompletion = std::pair<TensorTableEntry, StaleResult>;
+
+  // Called with mutex_ held for each message taken out of the queue. Returns
+  // true if it is the late submission of a tensor, which is then taken out
+  // of the tensor table and not negotiated.
+  bool TakeLateTensor(const Request& message,
+                      std::vector<LateCompletion>& completed);
+
+  // Pairs late submissions with results, oldest first. Called with
+  // stale_mutex_ held.
+  void MatchLateTensors(StaleTensor& stale,
+                        std::vector<LateCompletion>& completed);
+
+  // Copies the results to the outputs of the late submissions and calls
+  // their callbacks. Called without locks held.
+  void CompleteLateTensors(std::vector<LateCompletion>& completed);
+
+  std::unordered_map<std::string, StaleTensor> stale_tensors_;
+  std::mutex stale_mutex_;
+  bool staleness_enabled_ = false;
+
+  // Signaled when a tensor is submitted while the background thread waits.
+  std::mutex wait_mutex_;
+  std::condition_variable cond_;
+  std::atomic_bool waiting_{false};
 };
 
 } // namespace common
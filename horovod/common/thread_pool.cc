@@ -0,0 +1,207 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "thread_pool.h"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace horovod {
+namespace common {
+
+namespace {
+
+// Memory policy constants from <numaif.h>, so that libnuma is not required.
+#define HOROVOD_MPOL_PREFERRED 1
+#define HOROVOD_MPOL_MF_MOVE (1 << 1)
+
+} // namespace
+
+ThreadPool::~ThreadPool() { Shutdown(); }
+
+void ThreadPool::Create(int num_threads, int numa_node) {
+  Create(num_threads,
+         numa_node >= 0 ? GetNumaNodeCpus(numa_node) : std::vector<int>());
+}
+
+void ThreadPool::Create(int num_threads, const std::vector<int>& cpus) {
+  Shutdown();
+  shut_down_ = false;
+
+  for (int i = 0; i < num_threads; ++i) {
+    int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+    workers_.emplace_back([this, i, cpu]() {
+      if (cpu >= 0) {
+        PinCurrentThread(cpu);
+      }
+      WorkerLoop(i);
+    });
+  }
+}
+
+void ThreadPool::Shutdown() {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    shut_down_ = true;
+  }
+  work_cond_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+  workers_.clear();
+}
+
+void ThreadPool::ParallelFor(int num_tasks,
+                             const std::function<void(int)>& fn) {
+  if (workers_.empty() || num_tasks <= 1) {
+    for (int i = 0; i < num_tasks; ++i) {
+      fn(i);
+    }
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  fn_ = &fn;
+  num_tasks_ = num_tasks;
+  next_task_ = 0;
+  pending_tasks_ = num_tasks;
+  ++generation_;
+  work_cond_.notify_all();
+
+  // The calling thread takes its share of the work as well.
+  RunTasks(lock);
+  done_cond_.wait(lock, [this]() { return pending_tasks_ == 0; });
+  fn_ = nullptr;
+}
+
+void ThreadPool::RunAlongside(const std::function<void()>& fn,
+                              const std::function<void()>& caller_fn) {
+  if (workers_.empty()) {
+    fn();
+    caller_fn();
+    return;
+  }
+
+  std::function<void(int)> task = [&fn](int) { fn(); };
+  std::unique_lock<std::mutex> lock(mutex_);
+  fn_ = &task;
+  num_tasks_ = 1;
+  next_task_ = 0;
+  pending_tasks_ = 1;
+  ++generation_;
+  work_cond_.notify_one();
+  lock.unlock();
+
+  // Unlike ParallelFor, the calling thread does not take the task.
+  caller_fn();
+  lock.lock();
+  done_cond_.wait(lock, [this]() { return pending_tasks_ == 0; });
+  fn_ = nullptr;
+}
+
+void ThreadPool::WorkerLoop(int worker_id) {
+  uint64_t seen_generation = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    work_cond_.wait(lock, [this, &seen_generation]() {
+      return shut_down_ || generation_ != seen_generation;
+    });
+    if (shut_down_) {
+      return;
+    }
+    seen_generation = generation_;
+    RunTasks(lock);
+  }
+}
+
+void ThreadPool::RunTasks(std::unique_lock<std::mutex>& lock) {
+  while (next_task_ < num_tasks_) {
+    int task = next_task_++;
+    auto fn = fn_;
+    lock.unlock();
+    (*fn)(task);
+    lock.lock();
+    if (--pending_tasks_ == 0) {
+      done_cond_.notify_all();
+    }
+  }
+}
+
+std::vector<int> ParseCpuList(const std::string& list) {
+  std::vector<int> cpus;
+  std::istringstream list_stream(list);
+  std::string range;
+  while (std::getline(list_stream, range, ',')) {
+    std::istringstream range_stream(range);
+    int first = -1, last = -1;
+    char dash;
+    range_stream >> first;
+    if (!(range_stream >> dash >> last)) {
+      last = first;
+    }
+    for (int cpu = first; cpu >= 0 && cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+std::vector<int> GetNumaNodeCpus(int numa_node) {
+  std::ifstream cpulist("/sys/devices/system/node/node" +
+                        std::to_string(numa_node) + "/cpulist");
+  std::string list;
+  std::getline(cpulist, list);
+  return ParseCpuList(list);
+}
+
+bool PinCurrentThread(int cpu) {
+#if defined(__linux__)
+  if (cpu < 0 || cpu >= CPU_SETSIZE) {
+    return false;
+  }
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  CPU_SET(cpu, &cpuset);
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) == 0;
+#else
+  return false;
+#endif
+}
+
+bool BindToNumaNode(void* data, size_t size, int numa_node) {
+#if defined(__linux__) && defined(SYS_mbind)
+  auto page_size = (uintptr_t)sysconf(_SC_PAGESIZE);
+  auto begin = ((uintptr_t)data + page_size - 1) & ~(page_size - 1);
+  auto end = ((uintptr_t)data + size) & ~(page_size - 1);
+  if (numa_node < 0 || numa_node >= 64 || end <= begin) {
+    return false;
+  }
+  unsigned long nodemask = 1ul << numa_node;
+  return syscall(SYS_mbind, (void*)begin, end - begin, HOROVOD_MPOL_PREFERRED,
+                 &nodemask, sizeof(nodemask) * 8, HOROVOD_MPOL_MF_MOVE) == 0;
+#else
+  return false;
+#endif
+}
+
+} // namespace common
+} // namespace horovod
@@ -0,0 +1,105 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HOROVOD_THREAD_POOL_H
+#define HOROVOD_THREAD_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace horovod {
+namespace common {
+
+// Fixed-size pool of worker threads used to split memory copies of large
+// fusion buffers across cores.
+class ThreadPool {
+public:
+  ThreadPool() = default;
+  ThreadPool(const ThreadPool&) = delete;
+  ~ThreadPool();
+
+  // Starts num_threads workers. If numa_node is non-negative, the workers are
+  // pinned to the CPUs of that NUMA node.
+  void Create(int num_threads, int numa_node);
+
+  // Starts num_threads workers, pinned to the given CPUs in turn unless the
+  // list is empty.
+  void Create(int num_threads, const std::vector<int>& cpus);
+
+  // Stops and joins all workers.
+  void Shutdown();
+
+  // Number of workers, the calling thread excluded.
+  int num_threads() const { return (int)workers_.size(); }
+
+  // Runs fn(i) for every i in [0, num_tasks) on the workers and the calling
+  // thread, and returns once all tasks are done.
+  void ParallelFor(int num_tasks, const std::function<void(int)>& fn);
+
+  // Runs fn on a worker while the calling thread runs caller_fn, and returns
+  // once both are done. Without workers, the calling thread runs both.
+  void RunAlongside(const std::function<void()>& fn,
+                    const std::function<void()>& caller_fn);
+
+private:
+  void WorkerLoop(int worker_id);
+
+  // Runs tasks of the current batch until none are left.
+  void RunTasks(std::unique_lock<std::mutex>& lock);
+
+  std::vector<std::thread> workers_;
+
+  std::mutex mutex_;
+
+  std::condition_variable work_cond_;
+
+  std::condition_variable done_cond_;
+
+  // Incremented every time a new batch of tasks is posted.
+  uint64_t generation_ = 0;
+
+  const std::function<void(int)>* fn_ = nullptr;
+
+  int num_tasks_ = 0;
+
+  int next_task_ = 0;
+
+  int pending_tasks_ = 0;
+
+  bool shut_down_ = false;
+};
+
+// Parses a list of CPUs such as "0-7,16-23".
+std::vector<int> ParseCpuList(const std::string& list);
+
+// Returns the CPUs of the given NUMA node, or an empty list if unknown.
+std::vector<int> GetNumaNodeCpus(int numa_node);
+
+// Pins the calling thread to the given CPU. Returns false if it could not
+// be pinned.
+bool PinCurrentThread(int cpu);
+
+// Moves the pages fully contained in [data, data + size) to the given NUMA
+// node. Returns false if the pages could not be moved.
+bool BindToNumaNode(void* data, size_t size, int numa_node);
+
+} // namespace common
+} // namespace horovod
+
+#endif // HOROVOD_THREAD_POOL_H
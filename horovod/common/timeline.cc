@@ -15,8 +15,10 @@
 
 #include "timeline.h"
 
+#include <algorithm>
 #include <cassert>
 #include <chrono>
+#include <cstring>
 #include <sstream>
 #include <thread>
 
@@ -25,26 +27,110 @@
 namespace horovod {
 namespace common {
 
-void TimelineWriter::Initialize(std::string file_name) {
-  file_.open(file_name, std::ios::out | std::ios::trunc);
+namespace {
+
+// Binary records are written out once this many bytes are batched, or when
+// the record queue runs empty.
+constexpr size_t TIMELINE_WRITE_BUFFER_SIZE = 1 << 20;
+
+// Records each producer thread can enqueue before it waits for the writer.
+constexpr size_t TIMELINE_QUEUE_CAPACITY = 1 << 16;
+
+} // namespace
+
+TimelineWriter::~TimelineWriter() { Shutdown(); }
+
+void TimelineWriter::Initialize(std::string file_name, bool binary) {
+  Shutdown();
+  binary_ = binary;
+  auto mode = std::ios::out | std::ios::trunc;
+  if (binary) {
+    mode |= std::ios::binary;
+  }
+  file_.open(file_name, mode);
   if (file_.good()) {
-    // Initialize the timeline with '[' character.
-    file_ << "[\n";
+    tensor_table_.clear();
+    names_written_.clear();
+    write_buffer_.clear();
+    session_++;
+    if (binary) {
+      file_.write(TIMELINE_BINARY_MAGIC, std::strlen(TIMELINE_BINARY_MAGIC));
+      write_buffer_.reserve(TIMELINE_WRITE_BUFFER_SIZE);
+    } else {
+      // Initialize the timeline with '[' character.
+      file_ << "[\n";
+    }
+    stopping_ = false;
     healthy_ = true;
 
     // Spawn writer thread.
-    std::thread writer_thread(&TimelineWriter::WriterLoop, this);
-    writer_thread.detach();
+    writer_thread_ = std::thread(binary ? &TimelineWriter::BinaryWriterLoop
+                                        : &TimelineWriter::WriterLoop,
+                                 this);
   } else {
     LOG(ERROR) << "Error opening the Horovod Timeline file " << file_name
                << ", will not write a timeline.";
   }
 }
 
+void TimelineWriter::Shutdown() {
+  if (!writer_thread_.joinable()) {
+    return;
+  }
+  stopping_ = true;
+  writer_thread_.join();
+  healthy_ = false;
+  file_.close();
+}
+
+TimelineWriter::ProducerQueue& TimelineWriter::GetProducerQueue() {
+  // Queues of the calling thread by format, cached without locking.
+  struct Cache {
+    const TimelineWriter* writer;
+    ProducerQueue* queues[2];
+  };
+  static thread_local Cache cache{nullptr, {nullptr, nullptr}};
+  if (cache.writer != this) {
+    cache = Cache{this, {nullptr, nullptr}};
+  }
+
+  bool binary = binary_;
+  auto& queue = cache.queues[binary ? 1 : 0];
+  if (queue == nullptr) {
+    std::unique_ptr<ProducerQueue> new_queue(new ProducerQueue());
+    if (binary) {
+      new_queue->binary_records.reset(
+          new boost::lockfree::spsc_queue<QueuedBinaryRecord>(
+              TIMELINE_QUEUE_CAPACITY));
+    } else {
+      new_queue->records.reset(new boost::lockfree::spsc_queue<TimelineRecord>(
+          TIMELINE_QUEUE_CAPACITY));
+    }
+    queue = new_queue.get();
+    std::lock_guard<std::mutex> guard(queues_mutex_);
+    queues_.push_back(std::move(new_queue));
+    num_queues_ = queues_.size();
+  }
+  return *queue;
+}
+
 void TimelineWriter::EnqueueWriteEvent(const std::string& tensor_name,
                                        char phase, const std::string& op_name,
                                        const std::string& args,
                                        long ts_micros) {
+  auto& queue = GetProducerQueue();
+  if (queue.binary_records != nullptr) {
+    BinaryTimelineRecord r{};
+    r.ts_micros = ts_micros;
+    r.name_id = InternName(queue, tensor_name);
+    r.op_id = op_name.empty() ? -1 : InternName(queue, op_name);
+    r.args_id = args.empty() ? -1 : InternName(queue, args);
+    r.type = BinaryTimelineRecordType::BINARY_EVENT;
+    r.phase = phase;
+    EnqueueBinaryRecord(queue, r);
+    return;
+  }
+
   TimelineRecord r{};
   r.type = TimelineRecordType::EVENT;
   r.tensor_name = tensor_name;
@@ -52,22 +138,161 @@ void TimelineWriter::EnqueueWriteEvent(const std::string& tensor_name,
   r.op_name = op_name;
   r.args = args;
   r.ts_micros = ts_micros;
+  r.session = session_;
 
-  while (healthy_ && !record_queue_.push(r))
+  while (healthy_ && !queue.records->push(r))
     ;
 }
 
 void TimelineWriter::EnqueueWriteMarker(const std::string& name,
                                         long ts_micros) {
+  auto& queue = GetProducerQueue();
+  if (queue.binary_records != nullptr) {
+    BinaryTimelineRecord r{};
+    r.ts_micros = ts_micros;
+    r.name_id = InternName(queue, name);
+    r.op_id = -1;
+    r.args_id = -1;
+    r.type = BinaryTimelineRecordType::BINARY_MARKER;
+    EnqueueBinaryRecord(queue, r);
+    return;
+  }
+
   TimelineRecord r{};
   r.type = TimelineRecordType::MARKER;
   r.marker_name = name;
   r.ts_micros = ts_micros;
+  r.session = session_;
 
-  while (healthy_ && !record_queue_.push(r))
+  while (healthy_ && !queue.records->push(r))
     ;
 }
 
+int32_t TimelineWriter::InternName(ProducerQueue& queue,
+                                   const std::string& name) {
+  auto it = queue.name_ids.find(name);
+  if (it != queue.name_ids.end()) {
+    return it->second;
+  }
+
+  int32_t name_id;
+  {
+    std::lock_guard<std::mutex> guard(names_mutex_);
+    auto global_it = name_ids_.find(name);
+    if (global_it != name_ids_.end()) {
+      name_id = global_it->second;
+    } else {
+      name_id = (int32_t)names_.size();
+      names_.emplace_back(name, 0, std::min(name.size(), (size_t)UINT16_MAX));
+      name_ids_.emplace(name, name_id);
+    }
+  }
+  queue.name_ids.emplace(name, name_id);
+  return name_id;
+}
+
+void TimelineWriter::EnqueueBinaryRecord(ProducerQueue& queue,
+                                         const BinaryTimelineRecord& r) {
+  QueuedBinaryRecord queued{r, session_};
+  while (healthy_ && !queue.binary_records->push(queued))
+    ;
+}
+
+void TimelineWriter::DoWriteName(int32_t name_id) {
+  if (name_id < 0 || ((size_t)name_id < names_written_.size() &&
+                      names_written_[name_id])) {
+    return;
+  }
+
+  std::string name;
+  {
+    std::lock_guard<std::mutex> guard(names_mutex_);
+    name = names_[name_id];
+  }
+  BinaryTimelineRecord r{};
+  r.name_id = name_id;
+  r.op_id = -1;
+  r.args_id = -1;
+  r.type = BinaryTimelineRecordType::BINARY_NAME;
+  r.length = (uint16_t)name.size();
+  auto bytes = reinterpret_cast<const char*>(&r);
+  write_buffer_.insert(write_buffer_.end(), bytes, bytes + sizeof(r));
+  write_buffer_.insert(write_buffer_.end(), name.begin(), name.end());
+  if ((size_t)name_id >= names_written_.size()) {
+    names_written_.resize(name_id + 1);
+  }
+  names_written_[name_id] = true;
+}
+
+void TimelineWriter::DoWriteBinaryRecord(const BinaryTimelineRecord& r) {
+  // Define the names before the first record of the file that uses them.
+  DoWriteName(r.name_id);
+  DoWriteName(r.op_id);
+  DoWriteName(r.args_id);
+  auto bytes = reinterpret_cast<const char*>(&r);
+  write_buffer_.insert(write_buffer_.end(), bytes, bytes + sizeof(r));
+}
+
+bool TimelineWriter::DrainQueues() {
+  if (writer_queues_.size() != num_queues_) {
+    std::lock_guard<std::mutex> guard(queues_mutex_);
+    writer_queues_.clear();
+    for (auto& queue : queues_) {
+      writer_queues_.push_back(queue.get());
+    }
+  }
+
+  // Records of earlier sessions left in the queues are dropped.
+  uint32_t session = session_;
+  bool wrote = false;
+  for (auto queue : writer_queues_) {
+    if (queue->binary_records != nullptr) {
+      if (!binary_) {
+        continue;
+      }
+      QueuedBinaryRecord r;
+      while (healthy_ && queue->binary_records->pop(r)) {
+        wrote = true;
+        if (r.session == session) {
+          DoWriteBinaryRecord(r.record);
+        }
+        if (write_buffer_.size() >= TIMELINE_WRITE_BUFFER_SIZE) {
+          break;
+        }
+      }
+      continue;
+    }
+
+    if (binary_) {
+      continue;
+    }
+    while (healthy_ && !queue->records->empty()) {
+      auto& r = queue->records->front();
+      wrote = true;
+      if (r.session == session) {
+        switch (r.type) {
+        case TimelineRecordType::EVENT:
+          DoWriteEvent(r);
+          break;
+        case TimelineRecordType::MARKER:
+          DoWriteMarker(r);
+          break;
+        default:
+          throw std::logic_error("Unknown event type provided.");
+        }
+      }
+      queue->records->pop();
+
+      if (!file_.good()) {
+        LOG(ERROR) << "Error writing to the Horovod Timeline after it was "
+                      "successfully opened, will stop writing the timeline.";
+        healthy_ = false;
+      }
+    }
+  }
+  return wrote;
+}
+
 void TimelineWriter::DoWriteEvent(const TimelineRecord& r) {
   assert(r.type == TimelineRecordType::EVENT);
 
@@ -120,20 +345,30 @@ void TimelineWriter::DoWriteMarker(const TimelineRecord& r) {
 
 void TimelineWriter::WriterLoop() {
   while (healthy_) {
-    while (healthy_ && !record_queue_.empty()) {
-      auto& r = record_queue_.front();
-      switch (r.type) {
-      case TimelineRecordType::EVENT:
-        DoWriteEvent(r);
-        break;
-      case TimelineRecordType::MARKER:
-        DoWriteMarker(r);
+    // Records enqueued before Shutdown are written out before the thread
+    // stops.
+    bool stopping = stopping_;
+    if (!DrainQueues()) {
+      if (stopping) {
+        file_.flush();
         break;
-      default:
-        throw std::logic_error("Unknown event type provided.");
       }
-      record_queue_.pop();
 
+      // Allow scheduler to schedule other work for this core.
+      std::this_thread::yield();
+    }
+  }
+}
+
+void TimelineWriter::BinaryWriterLoop() {
+  while (healthy_) {
+    bool stopping = stopping_;
+    bool wrote = DrainQueues();
+
+    if (!write_buffer_.empty()) {
+      file_.write(write_buffer_.data(), write_buffer_.size());
+      file_.flush();
+      write_buffer_.clear();
       if (!file_.good()) {
         LOG(ERROR) << "Error writing to the Horovod Timeline after it was "
                       "successfully opened, will stop writing the timeline.";
@@ -141,21 +376,19 @@ void TimelineWriter::WriterLoop() {
       }
     }
 
-    // Allow scheduler to schedule other work for this core.
-    std::this_thread::yield();
-  }
-}
+    if (!wrote) {
+      if (stopping) {
+        break;
+      }
 
-void Timeline::Initialize(std::string file_name, unsigned int horovod_size) {
-  if (initialized_) {
-    return;
+      // Allow scheduler to schedule other work for this core.
+      std::this_thread::yield();
+    }
   }
+}
 
-  // Start the writer.
-  writer_.Initialize(std::move(file_name));
-
-  // Initialize if we were able to open the file successfully.
-  initialized_ = writer_.IsHealthy();
+void Timeline::Initialize(unsigned int horovod_size, bool binary) {
+  binary_ = binary;
 
   // Pre-initialize the string representation for each rank.
   rank_strings_ = std::vector<std::string>(horovod_size);
@@ -164,12 +397,74 @@ void Timeline::Initialize(std::string file_name, unsigned int horovod_size) {
   }
 }
 
+bool Timeline::StartRecording(const std::string& file_name) {
+  std::lock_guard<std::mutex> guard(recording_mutex_);
+  initialized_ = false;
+  writer_.Shutdown();
+
+  // Tensors in flight when an earlier recording stopped are left out.
+  for (auto& shard : shards_) {
+    std::lock_guard<std::mutex> shard_guard(shard.mutex);
+    shard.tensor_states.clear();
+  }
+
+  // Start the writer, and record if we were able to open the file.
+  writer_.Initialize(file_name, binary_);
+  initialized_ = writer_.IsHealthy();
+  return initialized_;
+}
+
+void Timeline::StopRecording() {
+  std::lock_guard<std::mutex> guard(recording_mutex_);
+  initialized_ = false;
+  writer_.Shutdown();
+}
+
+void Timeline::SetSampling(int sample_cycles,
+                           const std::string& tensor_pattern) {
+  sample_cycles_ = std::max(sample_cycles, 1);
+  filter_tensors_ = !tensor_pattern.empty();
+  if (filter_tensors_) {
+    tensor_pattern_ = std::regex(tensor_pattern);
+  }
+  for (auto& shard : shards_) {
+    std::lock_guard<std::mutex> shard_guard(shard.mutex);
+    shard.selected.clear();
+  }
+}
+
+Timeline::Shard& Timeline::GetShard(const std::string& tensor_name) {
+  return shards_[std::hash<std::string>()(tensor_name) % NUM_SHARDS];
+}
+
+bool Timeline::Sample(Shard& shard, const std::string& tensor_name) {
+  if (cycle_ % sample_cycles_ != 0) {
+    return false;
+  }
+  if (!filter_tensors_) {
+    return true;
+  }
+  auto it = shard.selected.find(tensor_name);
+  if (it == shard.selected.end()) {
+    it = shard.selected
+             .emplace(tensor_name,
+                      std::regex_search(tensor_name, tensor_pattern_))
+             .first;
+  }
+  return it->second;
+}
+
 long Timeline::TimeSinceStartMicros() const {
   auto now = std::chrono::steady_clock::now();
   auto ts = now - start_time_;
   return std::chrono::duration_cast<std::chrono::microseconds>(ts).count();
 }
 
+void Timeline::SetTimeSinceStartMicros(long ts_micros) {
+  start_time_ = std::chrono::steady_clock::now() -
+                std::chrono::microseconds(ts_micros);
+}
+
 // Write event to the Horovod Timeline file.
 void Timeline::WriteEvent(const std::string& tensor_name, const char phase,
                           const std::string& op_name, const std::string& args) {
@@ -188,22 +483,28 @@ void Timeline::NegotiateStart(const std::string& tensor_name,
     return;
   }
 
-  std::lock_guard<std::recursive_mutex> guard(mutex_);
+  auto& shard = GetShard(tensor_name);
+  std::lock_guard<std::mutex> guard(shard.mutex);
   // Note: Need to enable repeated calls to this routine during negotiate
   // phase. Repeated calls can occur if a cached response initiates the
   // negotiation phase, either due to multiple cycles with cache misses on
   // some worker, or if the response is evicted from the cache before
   // completion and its handling proceeds to the default communication path.
   // First call takes precedence.
-  if (tensor_states_[tensor_name] == TimelineState::NEGOTIATING) {
+  auto& state = shard.tensor_states[tensor_name];
+  if (state == TimelineState::NEGOTIATING ||
+      state == TimelineState::SKIPPED) {
     return;
   }
 
-  assert(tensor_states_[tensor_name] == TimelineState::UNKNOWN);
+  if (!Sample(shard, tensor_name)) {
+    state = TimelineState::SKIPPED;
+    return;
+  }
   auto event_category =
       "NEGOTIATE_" + Request::RequestType_Name(request_type);
   WriteEvent(tensor_name, 'B', event_category);
-  tensor_states_[tensor_name] = TimelineState::NEGOTIATING;
+  state = TimelineState::NEGOTIATING;
 }
 
 void Timeline::NegotiateRankReady(const std::string& tensor_name,
@@ -212,9 +513,13 @@ void Timeline::NegotiateRankReady(const std::string& tensor_name,
     return;
   }
 
-  std::lock_guard<std::recursive_mutex> guard(mutex_);
-  assert(tensor_states_[tensor_name] == TimelineState::NEGOTIATING);
-  WriteEvent(tensor_name, 'X', rank_strings_[rank]);
+  auto& shard = GetShard(tensor_name);
+  std::lock_guard<std::mutex> guard(shard.mutex);
+  auto it = shard.tensor_states.find(tensor_name);
+  if (it != shard.tensor_states.end() &&
+      it->second == TimelineState::NEGOTIATING) {
+    WriteEvent(tensor_name, 'X', rank_strings_[rank]);
+  }
 }
 
 void Timeline::NegotiateEnd(const std::string& tensor_name) {
@@ -222,10 +527,14 @@ void Timeline::NegotiateEnd(const std::string& tensor_name) {
     return;
   }
 
-  std::lock_guard<std::recursive_mutex> guard(mutex_);
-  assert(tensor_states_[tensor_name] == TimelineState::NEGOTIATING);
-  WriteEvent(tensor_name, 'E');
-  tensor_states_.erase(tensor_name);
+  auto& shard = GetShard(tensor_name);
+  std::lock_guard<std::mutex> guard(shard.mutex);
+  auto it = shard.tensor_states.find(tensor_name);
+  if (it != shard.tensor_states.end() &&
+      it->second == TimelineState::NEGOTIATING) {
+    WriteEvent(tensor_name, 'E');
+    it->second = TimelineState::NEGOTIATED;
+  }
 }
 
 void Timeline::Start(const std::string& tensor_name,
@@ -234,11 +543,20 @@ void Timeline::Start(const std::string& tensor_name,
     return;
   }
 
-  std::lock_guard<std::recursive_mutex> guard(mutex_);
-  assert(tensor_states_[tensor_name] == TimelineState::UNKNOWN);
+  auto& shard = GetShard(tensor_name);
+  std::lock_guard<std::mutex> guard(shard.mutex);
+  // The operation of a tensor is recorded if its negotiation was.
+  auto& state = shard.tensor_states[tensor_name];
+  if (state == TimelineState::SKIPPED) {
+    return;
+  }
+  if (state != TimelineState::NEGOTIATED && !Sample(shard, tensor_name)) {
+    state = TimelineState::SKIPPED;
+    return;
+  }
   auto event_category = Response::ResponseType_Name(response_type);
   WriteEvent(tensor_name, 'B', event_category);
-  tensor_states_[tensor_name] = TimelineState::TOP_LEVEL;
+  state = TimelineState::TOP_LEVEL;
 }
 
 void Timeline::ActivityStartAll(const std::vector<TensorTableEntry>& entries,
@@ -254,10 +572,14 @@ void Timeline::ActivityStart(const std::string& tensor_name,
     return;
   }
 
-  std::lock_guard<std::recursive_mutex> guard(mutex_);
-  assert(tensor_states_[tensor_name] == TimelineState::TOP_LEVEL);
-  WriteEvent(tensor_name, 'B', activity);
-  tensor_states_[tensor_name] = TimelineState::ACTIVITY;
+  auto& shard = GetShard(tensor_name);
+  std::lock_guard<std::mutex> guard(shard.mutex);
+  auto it = shard.tensor_states.find(tensor_name);
+  if (it != shard.tensor_states.end() &&
+      it->second == TimelineState::TOP_LEVEL) {
+    WriteEvent(tensor_name, 'B', activity);
+    it->second = TimelineState::ACTIVITY;
+  }
 }
 
 void Timeline::ActivityEndAll(const std::vector<TensorTableEntry>& entries) {
@@ -271,10 +593,18 @@ void Timeline::ActivityEnd(const std::string& tensor_name) {
     return;
   }
 
-  std::lock_guard<std::recursive_mutex> guard(mutex_);
-  assert(tensor_states_[tensor_name] == TimelineState::ACTIVITY);
-  WriteEvent(tensor_name, 'E');
-  tensor_states_[tensor_name] = TimelineState::TOP_LEVEL;
+  auto& shard = GetShard(tensor_name);
+  std::lock_guard<std::mutex> guard(shard.mutex);
+  ActivityEnd(shard, tensor_name);
+}
+
+void Timeline::ActivityEnd(Shard& shard, const std::string& tensor_name) {
+  auto it = shard.tensor_states.find(tensor_name);
+  if (it != shard.tensor_states.end() &&
+      it->second == TimelineState::ACTIVITY) {
+    WriteEvent(tensor_name, 'E');
+    it->second = TimelineState::TOP_LEVEL;
+  }
 }
 
 void Timeline::End(const std::string& tensor_name,
@@ -283,27 +613,35 @@ void Timeline::End(const std::string& tensor_name,
     return;
   }
 
-  std::lock_guard<std::recursive_mutex> guard(mutex_);
+  auto& shard = GetShard(tensor_name);
+  std::lock_guard<std::mutex> guard(shard.mutex);
+  auto it = shard.tensor_states.find(tensor_name);
+  if (it == shard.tensor_states.end()) {
+    return;
+  }
 
   // Pop out of current state, if applicable.
-  if (tensor_states_[tensor_name] == TimelineState::ACTIVITY) {
-    ActivityEnd(tensor_name);
-  }
+  ActivityEnd(shard, tensor_name);
 
-  std::stringstream args;
-  if (tensor != nullptr) {
-    args << "\"dtype\": \"" << DataType_Name(tensor->dtype()) << "\"";
-    args << ", \"shape\": \"" << tensor->shape().DebugString() << "\"";
+  if (it->second == TimelineState::TOP_LEVEL) {
+    std::stringstream args;
+    if (tensor != nullptr) {
+      args << "\"dtype\": \"" << DataType_Name(tensor->dtype()) << "\"";
+      args << ", \"shape\": \"" << tensor->shape().DebugString() << "\"";
+    }
+    WriteEvent(tensor_name, 'E', "", args.str());
+  } else if (it->second == TimelineState::NEGOTIATING) {
+    WriteEvent(tensor_name, 'E');
   }
-  WriteEvent(tensor_name, 'E', "", args.str());
+  shard.tensor_states.erase(it);
 }
 
 void Timeline::MarkCycleStart() {
-  if (!initialized_) {
+  auto cycle = ++cycle_;
+  if (!initialized_ || !mark_cycles_ || cycle % sample_cycles_ != 0) {
     return;
   }
 
-  std::lock_guard<std::recursive_mutex> guard(mutex_);
   WriteMarker("CYCLE_START");
 }
 
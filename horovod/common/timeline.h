@@ -18,9 +18,13 @@
 
 #include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <mutex>
+#include <regex>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -42,11 +46,49 @@ struct TimelineRecord {
   std::string args;
   std::string marker_name;
   long ts_micros;
+  // Recording session the record belongs to.
+  uint32_t session;
 };
 
+// Binary timeline format, converted to Chrome Tracing JSON offline with
+// `python -m horovod.common.timeline`. The file starts with
+// TIMELINE_BINARY_MAGIC followed by fixed-size little-endian records.
+// Strings are interned: a NAME record defines an id before its first use and
+// is followed by `length` bytes of the string. Ids of -1 mean no string.
+#define TIMELINE_BINARY_MAGIC "HVDTL001"
+
+enum BinaryTimelineRecordType : uint8_t {
+  BINARY_EVENT = 0,
+  BINARY_MARKER = 1,
+  BINARY_NAME = 2
+};
+
+struct BinaryTimelineRecord {
+  int64_t ts_micros;
+  // Tensor name for events, marker name for markers, or the id being defined
+  // by a NAME record.
+  int32_t name_id;
+  int32_t op_id;
+  int32_t args_id;
+  uint8_t type;
+  char phase;
+  uint16_t length;
+};
+
+static_assert(sizeof(BinaryTimelineRecord) == 24,
+              "BinaryTimelineRecord must match the converter layout");
+
+// Writes the records of a recording session to a file on its own thread.
+// Every producer thread enqueues to a queue of its own, so producers never
+// wait for each other. A writer can be shut down and initialized again with
+// another file; records enqueued for an earlier session are dropped.
 class TimelineWriter {
 public:
-  void Initialize(std::string file_name);
+  ~TimelineWriter();
+  void Initialize(std::string file_name, bool binary = false);
+  // Writes out the records enqueued so far, closes the file and stops the
+  // writer thread.
+  void Shutdown();
   inline bool IsHealthy() const { return healthy_; }
   void EnqueueWriteEvent(const std::string& tensor_name, char phase,
                          const std::string& op_name, const std::string& args,
@@ -54,34 +96,113 @@ public:
   void EnqueueWriteMarker(const std::string& name, long ts_micros);
 
 private:
+  struct QueuedBinaryRecord {
+    BinaryTimelineRecord record;
+    uint32_t session;
+  };
+
+  // Records of one producer thread, only pushed to by that thread. Queues
+  // are never freed before the writer, so that a thread can keep using its
+  // queue across sessions.
+  struct ProducerQueue {
+    std::unique_ptr<boost::lockfree::spsc_queue<TimelineRecord>> records;
+    std::unique_ptr<boost::lockfree::spsc_queue<QueuedBinaryRecord>>
+        binary_records;
+    // Ids of the strings this thread interned, so that only new strings
+    // take the names mutex.
+    std::unordered_map<std::string, int32_t> name_ids;
+  };
+
+  // Returns the queue of the calling thread for the current format.
+  ProducerQueue& GetProducerQueue();
+
   void DoWriteEvent(const TimelineRecord& r);
   void DoWriteMarker(const TimelineRecord& r);
   void WriterLoop();
 
+  // Binary format. Strings are interned by the producers, and their NAME
+  // records written by the writer thread before the first record of the
+  // session that uses them.
+  int32_t InternName(ProducerQueue& queue, const std::string& name);
+  void EnqueueBinaryRecord(ProducerQueue& queue,
+                           const BinaryTimelineRecord& r);
+  void DoWriteName(int32_t name_id);
+  void DoWriteBinaryRecord(const BinaryTimelineRecord& r);
+  void BinaryWriterLoop();
+
+  // Drains the queues of all producers, and returns whether any record was
+  // written.
+  bool DrainQueues();
+
   // Are we healthy?
   std::atomic_bool healthy_{false};
 
+  // Set to stop the writer thread once the queues are drained.
+  std::atomic_bool stopping_{false};
+
+  std::thread writer_thread_;
+
+  // Session of the records to write, incremented on every Initialize.
+  std::atomic<uint32_t> session_{0};
+
   // Timeline file.
   std::ofstream file_;
 
-  // Timeline record queue.
-  boost::lockfree::spsc_queue<TimelineRecord,
-                              boost::lockfree::capacity<1048576>>
-      record_queue_;
+  // Queues of all producer threads, and a copy owned by the writer thread
+  // that is refreshed when producers register.
+  std::mutex queues_mutex_;
+  std::vector<std::unique_ptr<ProducerQueue>> queues_;
+  std::atomic<size_t> num_queues_{0};
+  std::vector<ProducerQueue*> writer_queues_;
 
   // Mapping of tensor names to indexes. It is used to reduce size of the
   // timeline file.
   std::unordered_map<std::string, int> tensor_table_;
+
+  // Whether to write the binary format.
+  std::atomic_bool binary_{false};
+
+  // Interned strings of the binary format by id, shared by all sessions,
+  // and whether the current session defined them.
+  std::unordered_map<std::string, int32_t> name_ids_;
+  std::vector<std::string> names_;
+  std::mutex names_mutex_;
+  std::vector<bool> names_written_;
+
+  // Records are batched here and written out in large chunks.
+  std::vector<char> write_buffer_;
 };
 
-enum TimelineState { UNKNOWN, NEGOTIATING, TOP_LEVEL, ACTIVITY };
+// Tensors are UNKNOWN until their first event of a recording session, and
+// SKIPPED until their end when sampling leaves them out.
+enum TimelineState {
+  UNKNOWN,
+  NEGOTIATING,
+  NEGOTIATED,
+  TOP_LEVEL,
+  ACTIVITY,
+  SKIPPED
+};
 
 // Writes timeline in Chrome Tracing format. Timeline spec is from:
 // https://github.com/catapult-project/catapult/tree/master/tracing
+//
+// Recording can be started and stopped at any time, from any thread. Events
+// of tensors whose negotiation or operation began before recording started
+// are left out, as are tensors left out by sampling.
 class Timeline {
 public:
-  void Initialize(std::string file_name, unsigned int horovod_size);
+  void Initialize(unsigned int horovod_size, bool binary = false);
+  // Starts recording to the file, overwriting it. Returns false if the file
+  // could not be opened.
+  bool StartRecording(const std::string& file_name);
+  void StopRecording();
   inline bool Initialized() const { return initialized_; }
+  // Only records tensors whose negotiation or operation starts in one of
+  // every sample_cycles cycles and, unless empty, whose name matches the
+  // ECMAScript regular expression.
+  void SetSampling(int sample_cycles, const std::string& tensor_pattern);
+  void SetMarkCycles(bool value) { mark_cycles_ = value; }
   void NegotiateStart(const std::string& tensor_name,
                       Request::RequestType request_type);
   void NegotiateRankReady(const std::string& tensor_name, int rank);
@@ -95,18 +216,46 @@ public:
   void ActivityEndAll(const std::vector<TensorTableEntry>& entries);
   void ActivityEnd(const std::string& tensor_name);
   void End(const std::string& tensor_name, std::shared_ptr<Tensor> tensor);
+  // Called by the background thread at the start of every cycle.
   void MarkCycleStart();
 
-private:
   long TimeSinceStartMicros() const;
+
+  // Shift the start time so that the time since start is now the given
+  // value, e.g. to align the clocks of per-rank timelines.
+  void SetTimeSinceStartMicros(long ts_micros);
+
+private:
+  // Tensor states are sharded by name, so that threads recording events of
+  // different tensors rarely contend.
+  struct Shard {
+    std::mutex mutex;
+    std::unordered_map<std::string, TimelineState> tensor_states;
+    // Whether tensor names match the sampling pattern.
+    std::unordered_map<std::string, bool> selected;
+  };
+  static constexpr int NUM_SHARDS = 16;
+
+  Shard& GetShard(const std::string& tensor_name);
+
+  // Whether a tensor whose negotiation or operation starts now is recorded.
+  // Called with the shard of the tensor locked.
+  bool Sample(Shard& shard, const std::string& tensor_name);
+
+  void ActivityEnd(Shard& shard, const std::string& tensor_name);
+
   void WriteEvent(const std::string& tensor_name, char phase,
                   const std::string& op_name = "",
                   const std::string& args = "");
   void WriteMarker(const std::string& name);
 
-  // Boolean flag indicating whether Timeline was initialized (and thus should
-  // be recorded).
-  bool initialized_ = false;
+  // Boolean flag indicating whether the timeline is recording.
+  std::atomic_bool initialized_{false};
+
+  // Serializes starting and stopping the recording.
+  std::mutex recording_mutex_;
+
+  bool binary_ = false;
 
   // Timeline writer.
   TimelineWriter writer_;
@@ -114,11 +263,17 @@ private:
   // Time point when Horovod was started.
   std::chrono::steady_clock::time_point start_time_;
 
-  // A mutex that guards timeline state from concurrent access.
-  std::recursive_mutex mutex_;
+  Shard shards_[NUM_SHARDS];
+
+  // Sampling, set before recording starts.
+  int sample_cycles_ = 1;
+  bool filter_tensors_ = false;
+  std::regex tensor_pattern_;
+
+  std::atomic_bool mark_cycles_{false};
 
-  // Current state of each tensor in the timeline.
-  std::unordered_map<std::string, TimelineState> tensor_states_;
+  // Number of cycles so far.
+  std::atomic<uint64_t> cycle_{0};
 
   // Map of ranks to their string representations.
   // std::to_string() is very slow.
@@ -0,0 +1,176 @@
+# Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Converts binary Horovod timelines (HOROVOD_TIMELINE_BINARY=1) to the Chrome
+Tracing JSON format, and merges per-rank timeline shards
+(HOROVOD_TIMELINE_ALL_RANKS=1).
+
+Usage:
+    python -m horovod.common.timeline timeline.bin timeline.json
+    python -m horovod.common.timeline --merge timeline.bin.* timeline.json
+"""
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+import argparse
+import json
+import struct
+
+# Must match TIMELINE_BINARY_MAGIC and BinaryTimelineRecord in timeline.h.
+MAGIC = b'HVDTL001'
+RECORD = struct.Struct('<qiiiBcH')
+
+EVENT = 0
+MARKER = 1
+NAME = 2
+
+
+def read_binary_timeline(path):
+    """Yields (record_type, ts_micros, name, phase, op_name, args) for each
+    event and marker of a binary timeline. Strings that are not set are
+    empty."""
+    names = {}
+    with open(path, 'rb') as f:
+        if f.read(len(MAGIC)) != MAGIC:
+            raise ValueError('%s is not a binary Horovod timeline' % path)
+        while True:
+            data = f.read(RECORD.size)
+            if len(data) < RECORD.size:
+                # The last record may be partially written.
+                break
+            ts, name_id, op_id, args_id, record_type, phase, length = \
+                RECORD.unpack(data)
+            if record_type == NAME:
+                name = f.read(length)
+                if len(name) < length:
+                    break
+                names[name_id] = name.decode('utf-8', 'replace')
+                continue
+            yield (record_type, ts, names.get(name_id, ''),
+                   phase.decode('latin-1'), names.get(op_id, ''),
+                   names.get(args_id, ''))
+
+
+def read_json_timeline(path):
+    """Yields the same tuples as read_binary_timeline for a JSON timeline. The
+    timeline may be incomplete, e.g. still being written."""
+    with open(path, 'r') as f:
+        text = f.read().rstrip()
+    if text.endswith(']'):
+        text = text[:-1].rstrip()
+    events = json.loads(text.rstrip(',') + ']')
+
+    pid_names = {}
+    for event in events:
+        phase = event['ph']
+        if phase == 'M':
+            if event['name'] == 'process_name':
+                pid_names[event['pid']] = event['args']['name']
+        elif phase == 'i':
+            yield (MARKER, event['ts'], event['name'], phase, '', '')
+        else:
+            args = json.dumps(event['args'])[1:-1] if 'args' in event else ''
+            yield (EVENT, event['ts'], pid_names.get(event['pid'], ''), phase,
+                   event.get('name', ''), args)
+
+
+def read_timeline(path):
+    """Reads a binary or JSON timeline."""
+    with open(path, 'rb') as f:
+        binary = f.read(len(MAGIC)) == MAGIC
+    return read_binary_timeline(path) if binary else read_json_timeline(path)
+
+
+def _write_json(shards, out):
+    # Mirrors the JSON written by TimelineWriter: tensors are modeled as
+    # processes, registered on first use. When merging, each shard becomes a
+    # thread of every tensor process.
+    tensor_pids = {}
+    out.write('[\n')
+    for tid, records in shards:
+        thread = ', "tid": %d' % tid if tid is not None else ''
+        threads_named = set()
+        for record_type, ts, name, phase, op_name, args in records:
+            if record_type == MARKER:
+                out.write('{"ph": "i", "name": "%s", "ts": %d%s, "s": "g"},\n' %
+                          (name, ts, thread))
+                continue
+
+            pid = tensor_pids.get(name)
+            if pid is None:
+                pid = len(tensor_pids) + 1
+                tensor_pids[name] = pid
+                out.write('{"name": "process_name", "ph": "M", "pid": %d, '
+                          '"args": {"name": "%s"}},\n' % (pid, name))
+                out.write('{"name": "process_sort_index", "ph": "M", "pid": %d, '
+                          '"args": {"sort_index": %d}},\n' % (pid, pid))
+            if tid is not None and pid not in threads_named:
+                threads_named.add(pid)
+                out.write('{"name": "thread_name", "ph": "M", "pid": %d%s, '
+                          '"args": {"name": "rank %d"}},\n' % (pid, thread, tid))
+
+            event = '{"ph": "%s"' % phase
+            if phase != 'E':
+                event += ', "name": "%s"' % op_name
+            event += ', "ts": %d, "pid": %d%s' % (ts, pid, thread)
+            if phase == 'X':
+                event += ', "dur": 0'
+            if args:
+                event += ', "args": {%s}' % args
+            out.write(event + '},\n')
+
+
+def _shard_rank(path, index):
+    # Shards are written to <HOROVOD_TIMELINE>.<rank>.
+    suffix = path.rsplit('.', 1)[-1]
+    return int(suffix) if suffix.isdigit() else index
+
+
+def convert(binary_path, json_path):
+    """Converts the binary timeline at binary_path to Chrome Tracing JSON."""
+    with open(json_path, 'w') as out:
+        _write_json([(None, read_binary_timeline(binary_path))], out)
+
+
+def merge(shard_paths, json_path):
+    """Merges per-rank timeline shards (HOROVOD_TIMELINE_ALL_RANKS=1), binary
+    or JSON, into one Chrome Tracing JSON file with a thread per rank."""
+    shards = [(_shard_rank(path, i), read_timeline(path))
+              for i, path in enumerate(shard_paths)]
+    shards.sort(key=lambda shard: shard[0])
+    with open(json_path, 'w') as out:
+        _write_json(shards, out)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Convert a binary Horovod timeline, or merge per-rank '
+                    'timeline shards, to Chrome Tracing JSON.')
+    parser.add_argument('--merge', action='store_true',
+                        help='merge the given per-rank timeline shards')
+    parser.add_argument('inputs', nargs='+', help='timeline file(s) to read')
+    parser.add_argument('output', help='JSON timeline file to write')
+    args = parser.parse_args()
+    if args.merge:
+        merge(args.inputs, args.output)
+    elif len(args.inputs) == 1:
+        convert(args.inputs[0], args.output)
+    else:
+        parser.error('pass --merge to merge more than one timeline')
+
+
+if __name__ == '__main__':
+    main()
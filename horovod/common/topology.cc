@@ -0,0 +1,86 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "topology.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+#include <unistd.h>
+
+#include "common.h"
+
+namespace horovod {
+namespace common {
+
+std::string DiscoverRackId() {
+  auto rack_id = std::getenv(HOROVOD_RACK_ID);
+  if (rack_id != nullptr && rack_id[0] != '\0') {
+    return rack_id;
+  }
+
+  auto topology_file = std::getenv(HOROVOD_TOPOLOGY_FILE);
+  if (topology_file == nullptr) {
+    return "";
+  }
+  char buffer[256] = {0};
+  if (gethostname(buffer, sizeof(buffer) - 1) != 0) {
+    return "";
+  }
+  std::string hostname(buffer);
+  auto short_hostname = hostname.substr(0, hostname.find('.'));
+
+  std::ifstream file(topology_file);
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream fields(line);
+    std::string host, rack;
+    if (!(fields >> host >> rack) || host[0] == '#') {
+      continue;
+    }
+    if (host == hostname || host == short_hostname) {
+      return rack;
+    }
+  }
+  return "";
+}
+
+std::vector<int> RackRingOrder(const std::vector<uint64_t>& racks) {
+  // Members of each rack, in the order racks first appear.
+  std::unordered_map<uint64_t, size_t> rack_index;
+  std::vector<std::vector<int>> members;
+  for (int i = 0; i < (int)racks.size(); ++i) {
+    auto it = rack_index.find(racks[i]);
+    if (it == rack_index.end()) {
+      it = rack_index.emplace(racks[i], members.size()).first;
+      members.emplace_back();
+    }
+    members[it->second].push_back(i);
+  }
+
+  std::vector<int> order(racks.size());
+  int position = 0;
+  for (auto& rack_members : members) {
+    for (int member : rack_members) {
+      order[member] = position++;
+    }
+  }
+  return order;
+}
+
+} // namespace common
+} // namespace horovod
@@ -0,0 +1,47 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HOROVOD_TOPOLOGY_H
+#define HOROVOD_TOPOLOGY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace horovod {
+namespace common {
+
+// Rack of this host, from HOROVOD_RACK_ID, or else from the line of
+// HOROVOD_TOPOLOGY_FILE that starts with its host name, given either in full
+// or up to the first dot:
+//
+//   # host  rack
+//   node01  rack-a
+//   node02  rack-b
+//
+// Empty if neither names a rack for this host.
+std::string DiscoverRackId();
+
+// Position of every member of a ring along which the members of each rack are
+// adjacent, so that the ring crosses each rack boundary once. racks holds the
+// rack of every member in its current order. Racks follow the order in which
+// they first appear and members keep their order within a rack, so the first
+// member stays first.
+std::vector<int> RackRingOrder(const std::vector<uint64_t>& racks);
+
+} // namespace common
+} // namespace horovod
+
+#endif // HOROVOD_TOPOLOGY_H
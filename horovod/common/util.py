@@ -22,6 +22,54 @@ import sysconfig
 
 EXTENSIONS = ['tensorflow', 'torch', 'mxnet']
 
+# Reductions that can be passed as the `op` argument of allreduce instead of
+# `average`. Adasum combines the tensors of the processes with the adaptive
+# summation rule, which neither grows with the number of processes like a sum
+# nor is scaled down like an average. Min, Max and Product are elementwise.
+Average = 'average'
+Sum = 'sum'
+Adasum = 'adasum'
+Min = 'min'
+Max = 'max'
+Product = 'product'
+
+# Values of the ReduceOp enum of the Horovod core.
+REDUCE_OP_SUM = 0
+REDUCE_OP_ADASUM = 1
+_REDUCE_OPS = {Sum: REDUCE_OP_SUM, Adasum: REDUCE_OP_ADASUM, Min: 2, Max: 3,
+               Product: 4}
+
+
+def get_reduce_op(average, op):
+    """Returns the average flag and the core reduction selected by `op`, or by
+    `average` if `op` is not set."""
+    if op is None:
+        return average, REDUCE_OP_SUM
+    if op == Average:
+        return True, REDUCE_OP_SUM
+    if op not in _REDUCE_OPS:
+        raise ValueError('Unknown reduction %s, expected one of Average, Sum, '
+                         'Adasum, Min, Max or Product.' % op)
+    return False, _REDUCE_OPS[op]
+
+
+# Quantizations that can be passed as the `quantization` argument of allreduce
+# to send float32 tensors in host memory as 8 or 4-bit integers with a scale
+# per chunk, with stochastic rounding and error feedback.
+Int8 = 'int8'
+Int4 = 'int4'
+
+# Values of the Compression enum of the Horovod core.
+_COMPRESSIONS = {None: 0, Int8: 1, Int4: 2}
+
+
+def get_compression(quantization):
+    """Returns the core compression selected by `quantization`."""
+    if quantization not in _COMPRESSIONS:
+        raise ValueError('Unknown quantization %s, expected None, Int8 or '
+                         'Int4.' % quantization)
+    return _COMPRESSIONS[quantization]
+
 
 def get_ext_suffix():
     """Determine library extension for various versions of Python."""
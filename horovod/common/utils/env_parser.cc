@@ -108,6 +108,27 @@ LibType ParseControllerOpsFromEnv() {
   return controller;
 }
 
+DataType ParseCPUCompressionFromEnv() {
+  DataType compression = HOROVOD_FLOAT32;
+  const char* user_compression = std::getenv(HOROVOD_CPU_COMPRESSION);
+  if (user_compression != nullptr) {
+    if (strcasecmp(user_compression, "fp16") == 0) {
+      compression = HOROVOD_FLOAT16;
+    } else if (strcasecmp(user_compression, "bf16") == 0) {
+      compression = HOROVOD_BFLOAT16;
+    } else if (strcasecmp(user_compression, "none") != 0) {
+      throw std::runtime_error("Unsupported CPU compression type, only fp16, "
+                               "bf16 and none are supported");
+    }
+  }
+
+  if (compression != HOROVOD_FLOAT32) {
+    LOG(DEBUG) << "Using " << DataType_Name(compression)
+               << " to allreduce float32 tensors on CPU.";
+  }
+  return compression;
+}
+
 const char* ParseGlooIface() {
   const char* gloo_iface = std::getenv(HOROVOD_GLOO_IFACE);
   if (gloo_iface == nullptr) {
@@ -18,6 +18,7 @@
 
 #include <iostream>
 
+#include "../message.h"
 #include "../stall_inspector.h"
 
 namespace horovod {
@@ -31,6 +32,8 @@ LibType ParseCPUOpsFromEnv();
 
 LibType ParseControllerOpsFromEnv();
 
+DataType ParseCPUCompressionFromEnv();
+
 const char* ParseGlooIface();
 
 void ParseStallInspectorFromEnv(StallInspector& stall_inspector);
@@ -0,0 +1,97 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ============================================================================
+
+#include "huge_pages.h"
+
+#include <cstdint>
+
+#include <sys/mman.h>
+
+namespace horovod {
+namespace common {
+
+namespace {
+
+const size_t GIGANTIC_PAGE_BYTES = (size_t)1 << 30;
+
+size_t RoundUp(size_t bytes, size_t alignment) {
+  return (bytes + alignment - 1) / alignment * alignment;
+}
+
+void* Map(size_t bytes, int flags) {
+  void* addr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+  return addr == MAP_FAILED ? nullptr : addr;
+}
+
+} // namespace
+
+void* AllocateHugePages(size_t& bytes) {
+  void* addr = nullptr;
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+  // hugetlbfs pools are empty unless the administrator reserved pages, in
+  // which case the mapping fails right away.
+  if (bytes >= GIGANTIC_PAGE_BYTES) {
+    size_t gigantic_bytes = RoundUp(bytes, GIGANTIC_PAGE_BYTES);
+    addr = Map(gigantic_bytes, MAP_HUGETLB | (30 << MAP_HUGE_SHIFT));
+    if (addr != nullptr) {
+      bytes = gigantic_bytes;
+      return addr;
+    }
+  }
+#endif
+  bytes = RoundUp(bytes, HUGE_PAGE_BYTES);
+#ifdef MAP_HUGETLB
+  addr = Map(bytes, MAP_HUGETLB);
+  if (addr != nullptr) {
+    return addr;
+  }
+#endif
+  // Map one huge page more, so that the buffer can start on a huge page
+  // boundary, and give the rest back.
+  size_t padded_bytes = bytes + HUGE_PAGE_BYTES;
+  auto padded = (uint8_t*)Map(padded_bytes, 0);
+  if (padded == nullptr) {
+    return nullptr;
+  }
+  auto aligned = (uint8_t*)RoundUp((size_t)padded, HUGE_PAGE_BYTES);
+  if (aligned > padded) {
+    munmap(padded, aligned - padded);
+  }
+  if (aligned + bytes < padded + padded_bytes) {
+    munmap(aligned + bytes, padded + padded_bytes - (aligned + bytes));
+  }
+  AdviseHugePages(aligned, bytes);
+  return aligned;
+}
+
+void FreeHugePages(void* addr, size_t bytes) {
+  if (addr != nullptr) {
+    munmap(addr, bytes);
+  }
+}
+
+void AdviseHugePages(void* addr, size_t bytes) {
+#ifdef MADV_HUGEPAGE
+  auto begin = RoundUp((size_t)addr, HUGE_PAGE_BYTES);
+  auto end = ((size_t)addr + bytes) / HUGE_PAGE_BYTES * HUGE_PAGE_BYTES;
+  if (end > begin) {
+    madvise((void*)begin, end - begin, MADV_HUGEPAGE);
+  }
+#endif
+}
+
+} // namespace common
+} // namespace horovod
@@ -0,0 +1,45 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ============================================================================
+
+#ifndef HOROVOD_HUGE_PAGES_H
+#define HOROVOD_HUGE_PAGES_H
+
+#include <cstddef>
+
+namespace horovod {
+namespace common {
+
+// Size of the huge pages host buffers are aligned and rounded up to.
+const size_t HUGE_PAGE_BYTES = (size_t)2 << 20;
+
+// Maps anonymous memory of at least bytes, backed by huge pages where the
+// system has them: 1 GB pages for buffers of a gigabyte or more and 2 MB
+// pages otherwise, when the hugetlbfs pools have free pages, else transparent
+// huge pages. Sets bytes to the size mapped, a multiple of HUGE_PAGE_BYTES.
+// Returns nullptr if the memory cannot be mapped.
+void* AllocateHugePages(size_t& bytes);
+
+// Unmaps memory returned by AllocateHugePages with the size it set.
+void FreeHugePages(void* addr, size_t bytes);
+
+// Asks for the huge pages within the range of an existing mapping to be
+// backed by transparent huge pages. Does nothing where they are not
+// supported.
+void AdviseHugePages(void* addr, size_t bytes);
+
+} // namespace common
+} // namespace horovod
+
+#endif // HOROVOD_HUGE_PAGES_H
@@ -44,11 +44,13 @@ enum DataType {
   DataType_HOROVOD_FLOAT32 = 7,
   DataType_HOROVOD_FLOAT64 = 8,
   DataType_HOROVOD_BOOL = 9,
+  DataType_HOROVOD_BYTE = 10,
+  DataType_HOROVOD_BFLOAT16 = 11,
   DataType_MIN = DataType_HOROVOD_UINT8,
-  DataType_MAX = DataType_HOROVOD_BOOL
+  DataType_MAX = DataType_HOROVOD_BFLOAT16
 };
 
-inline const DataType (&EnumValuesDataType())[10] {
+inline const DataType (&EnumValuesDataType())[12] {
   static const DataType values[] = {
     DataType_HOROVOD_UINT8,
     DataType_HOROVOD_INT8,
@@ -59,7 +61,9 @@ inline const DataType (&EnumValuesDataType())[10] {
     DataType_HOROVOD_FLOAT16,
     DataType_HOROVOD_FLOAT32,
     DataType_HOROVOD_FLOAT64,
-    DataType_HOROVOD_BOOL
+    DataType_HOROVOD_BOOL,
+    DataType_HOROVOD_BYTE,
+    DataType_HOROVOD_BFLOAT16
   };
   return values;
 }
@@ -76,13 +80,15 @@ inline const char * const *EnumNamesDataType() {
     "HOROVOD_FLOAT32",
     "HOROVOD_FLOAT64",
     "HOROVOD_BOOL",
+    "HOROVOD_BYTE",
+    "HOROVOD_BFLOAT16",
     nullptr
   };
   return names;
 }
 
 inline const char *EnumNameDataType(DataType e) {
-  if (e < DataType_HOROVOD_UINT8 || e > DataType_HOROVOD_BOOL) return "";
+  if (e < DataType_HOROVOD_UINT8 || e > DataType_HOROVOD_BFLOAT16) return "";
   const size_t index = static_cast<int>(e);
   return EnumNamesDataType()[index];
 }
@@ -91,15 +97,21 @@ enum RequestType {
   RequestType_ALLREDUCE = 0,
   RequestType_ALLGATHER = 1,
   RequestType_BROADCAST = 2,
+  RequestType_REDUCESCATTER = 3,
+  RequestType_ALLTOALL = 4,
+  RequestType_JOIN = 5,
   RequestType_MIN = RequestType_ALLREDUCE,
-  RequestType_MAX = RequestType_BROADCAST
+  RequestType_MAX = RequestType_JOIN
 };
 
-inline const RequestType (&EnumValuesRequestType())[3] {
+inline const RequestType (&EnumValuesRequestType())[6] {
   static const RequestType values[] = {
     RequestType_ALLREDUCE,
     RequestType_ALLGATHER,
-    RequestType_BROADCAST
+    RequestType_BROADCAST,
+    RequestType_REDUCESCATTER,
+    RequestType_ALLTOALL,
+    RequestType_JOIN
   };
   return values;
 }
@@ -109,32 +121,113 @@ inline const char * const *EnumNamesRequestType() {
     "ALLREDUCE",
     "ALLGATHER",
     "BROADCAST",
+    "REDUCESCATTER",
+    "ALLTOALL",
+    "JOIN",
     nullptr
   };
   return names;
 }
 
 inline const char *EnumNameRequestType(RequestType e) {
-  if (e < RequestType_ALLREDUCE || e > RequestType_BROADCAST) return "";
+  if (e < RequestType_ALLREDUCE || e > RequestType_JOIN) return "";
   const size_t index = static_cast<int>(e);
   return EnumNamesRequestType()[index];
 }
 
+enum ReduceOp {
+  ReduceOp_SUM = 0,
+  ReduceOp_ADASUM = 1,
+  ReduceOp_MINIMUM = 2,
+  ReduceOp_MAXIMUM = 3,
+  ReduceOp_PRODUCT = 4,
+  ReduceOp_MIN = ReduceOp_SUM,
+  ReduceOp_MAX = ReduceOp_PRODUCT
+};
+
+inline const ReduceOp (&EnumValuesReduceOp())[5] {
+  static const ReduceOp values[] = {
+    ReduceOp_SUM,
+    ReduceOp_ADASUM,
+    ReduceOp_MINIMUM,
+    ReduceOp_MAXIMUM,
+    ReduceOp_PRODUCT
+  };
+  return values;
+}
+
+inline const char * const *EnumNamesReduceOp() {
+  static const char * const names[] = {
+    "SUM",
+    "ADASUM",
+    "MINIMUM",
+    "MAXIMUM",
+    "PRODUCT",
+    nullptr
+  };
+  return names;
+}
+
+inline const char *EnumNameReduceOp(ReduceOp e) {
+  if (e < ReduceOp_SUM || e > ReduceOp_PRODUCT) return "";
+  const size_t index = static_cast<int>(e);
+  return EnumNamesReduceOp()[index];
+}
+
+enum Compression {
+  Compression_NONE = 0,
+  Compression_INT8 = 1,
+  Compression_INT4 = 2,
+  Compression_MIN = Compression_NONE,
+  Compression_MAX = Compression_INT4
+};
+
+inline const Compression (&EnumValuesCompression())[3] {
+  static const Compression values[] = {
+    Compression_NONE,
+    Compression_INT8,
+    Compression_INT4
+  };
+  return values;
+}
+
+inline const char * const *EnumNamesCompression() {
+  static const char * const names[] = {
+    "NONE",
+    "INT8",
+    "INT4",
+    nullptr
+  };
+  return names;
+}
+
+inline const char *EnumNameCompression(Compression e) {
+  if (e < Compression_NONE || e > Compression_INT4) return "";
+  const size_t index = static_cast<int>(e);
+  return EnumNamesCompression()[index];
+}
+
 enum ResponseType {
   ResponseType_ALLREDUCE = 0,
   ResponseType_ALLGATHER = 1,
   ResponseType_BROADCAST = 2,
   ResponseType_ERROR = 3,
+  ResponseType_REDUCESCATTER = 4,
+  ResponseType_ALLTOALL = 5,
+  ResponseType_JOIN = 6,
   ResponseType_MIN = ResponseType_ALLREDUCE,
-  ResponseType_MAX = ResponseType_ERROR
+  ResponseType_MAX = ResponseType_JOIN
 };
 
-inline const ResponseType (&EnumValuesResponseType())[4] {
+inline const ResponseType (&EnumValuesResponseType())[7] {
   static const ResponseType values[] = {
     ResponseType_ALLREDUCE,
     ResponseType_ALLGATHER,
     ResponseType_BROADCAST,
-    ResponseType_ERROR
+    ResponseType_ERROR,
+    ResponseType_REDUCESCATTER,
+    ResponseType_ALLTOALL,
+    ResponseType_JOIN
   };
   return values;
 }
@@ -145,13 +238,16 @@ inline const char * const *EnumNamesResponseType() {
     "ALLGATHER",
     "BROADCAST",
     "ERROR",
+    "REDUCESCATTER",
+    "ALLTOALL",
+    "JOIN",
     nullptr
   };
   return names;
 }
 
 inline const char *EnumNameResponseType(ResponseType e) {
-  if (e < ResponseType_ALLREDUCE || e > ResponseType_ERROR) return "";
+  if (e < ResponseType_ALLREDUCE || e > ResponseType_JOIN) return "";
   const size_t index = static_cast<int>(e);
   return EnumNamesResponseType()[index];
 }
@@ -164,7 +260,12 @@ struct Request FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
     VT_TENSOR_NAME = 10,
     VT_ROOT_RANK = 12,
     VT_DEVICE = 14,
-    VT_TENSOR_SHAPE = 16
+    VT_TENSOR_SHAPE = 16,
+    VT_SPLITS = 18,
+    VT_REDUCE_OP = 20,
+    VT_PROCESS_SET_ID = 22,
+    VT_COMPRESSION = 24,
+    VT_GROUP = 26
   };
   int32_t request_rank() const {
     return GetField<int32_t>(VT_REQUEST_RANK, 0);
@@ -187,6 +288,21 @@ struct Request FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
   const flatbuffers::Vector<int64_t> *tensor_shape() const {
     return GetPointer<const flatbuffers::Vector<int64_t> *>(VT_TENSOR_SHAPE);
   }
+  const flatbuffers::Vector<int64_t> *splits() const {
+    return GetPointer<const flatbuffers::Vector<int64_t> *>(VT_SPLITS);
+  }
+  ReduceOp reduce_op() const {
+    return static_cast<ReduceOp>(GetField<int8_t>(VT_REDUCE_OP, 0));
+  }
+  int32_t process_set_id() const {
+    return GetField<int32_t>(VT_PROCESS_SET_ID, 0);
+  }
+  Compression compression() const {
+    return static_cast<Compression>(GetField<int8_t>(VT_COMPRESSION, 0));
+  }
+  bool group() const {
+    return GetField<uint8_t>(VT_GROUP, 0) != 0;
+  }
   bool Verify(flatbuffers::Verifier &verifier) const {
     return VerifyTableStart(verifier) &&
            VerifyField<int32_t>(verifier, VT_REQUEST_RANK) &&
@@ -198,6 +314,12 @@ struct Request FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
            VerifyField<int32_t>(verifier, VT_DEVICE) &&
            VerifyOffset(verifier, VT_TENSOR_SHAPE) &&
            verifier.VerifyVector(tensor_shape()) &&
+           VerifyOffset(verifier, VT_SPLITS) &&
+           verifier.VerifyVector(splits()) &&
+           VerifyField<int8_t>(verifier, VT_REDUCE_OP) &&
+           VerifyField<int32_t>(verifier, VT_PROCESS_SET_ID) &&
+           VerifyField<int8_t>(verifier, VT_COMPRESSION) &&
+           VerifyField<uint8_t>(verifier, VT_GROUP) &&
            verifier.EndTable();
   }
 };
@@ -226,6 +348,21 @@ struct RequestBuilder {
   void add_tensor_shape(flatbuffers::Offset<flatbuffers::Vector<int64_t>> tensor_shape) {
     fbb_.AddOffset(Request::VT_TENSOR_SHAPE, tensor_shape);
   }
+  void add_splits(flatbuffers::Offset<flatbuffers::Vector<int64_t>> splits) {
+    fbb_.AddOffset(Request::VT_SPLITS, splits);
+  }
+  void add_reduce_op(ReduceOp reduce_op) {
+    fbb_.AddElement<int8_t>(Request::VT_REDUCE_OP, static_cast<int8_t>(reduce_op), 0);
+  }
+  void add_process_set_id(int32_t process_set_id) {
+    fbb_.AddElement<int32_t>(Request::VT_PROCESS_SET_ID, process_set_id, 0);
+  }
+  void add_compression(Compression compression) {
+    fbb_.AddElement<int8_t>(Request::VT_COMPRESSION, static_cast<int8_t>(compression), 0);
+  }
+  void add_group(bool group) {
+    fbb_.AddElement<uint8_t>(Request::VT_GROUP, static_cast<uint8_t>(group), 0);
+  }
   explicit RequestBuilder(flatbuffers::FlatBufferBuilder &_fbb)
         : fbb_(_fbb) {
     start_ = fbb_.StartTable();
@@ -246,13 +383,23 @@ inline flatbuffers::Offset<Request> CreateRequest(
     flatbuffers::Offset<flatbuffers::String> tensor_name = 0,
     int32_t root_rank = 0,
     int32_t device = 0,
-    flatbuffers::Offset<flatbuffers::Vector<int64_t>> tensor_shape = 0) {
+    flatbuffers::Offset<flatbuffers::Vector<int64_t>> tensor_shape = 0,
+    flatbuffers::Offset<flatbuffers::Vector<int64_t>> splits = 0,
+    ReduceOp reduce_op = ReduceOp_SUM,
+    int32_t process_set_id = 0,
+    Compression compression = Compression_NONE,
+    bool group = false) {
   RequestBuilder builder_(_fbb);
+  builder_.add_process_set_id(process_set_id);
+  builder_.add_splits(splits);
   builder_.add_tensor_shape(tensor_shape);
   builder_.add_device(device);
   builder_.add_root_rank(root_rank);
   builder_.add_tensor_name(tensor_name);
   builder_.add_request_rank(request_rank);
+  builder_.add_group(group);
+  builder_.add_compression(compression);
+  builder_.add_reduce_op(reduce_op);
   builder_.add_tensor_type(tensor_type);
   builder_.add_request_type(request_type);
   return builder_.Finish();
@@ -266,9 +413,15 @@ inline flatbuffers::Offset<Request> CreateRequestDirect(
     const char *tensor_name = nullptr,
     int32_t root_rank = 0,
     int32_t device = 0,
-    const std::vector<int64_t> *tensor_shape = nullptr) {
+    const std::vector<int64_t> *tensor_shape = nullptr,
+    const std::vector<int64_t> *splits = nullptr,
+    ReduceOp reduce_op = ReduceOp_SUM,
+    int32_t process_set_id = 0,
+    Compression compression = Compression_NONE,
+    bool group = false) {
   auto tensor_name__ = tensor_name ? _fbb.CreateString(tensor_name) : 0;
   auto tensor_shape__ = tensor_shape ? _fbb.CreateVector<int64_t>(*tensor_shape) : 0;
+  auto splits__ = splits ? _fbb.CreateVector<int64_t>(*splits) : 0;
   return horovod::common::wire::CreateRequest(
       _fbb,
       request_rank,
@@ -277,7 +430,12 @@ inline flatbuffers::Offset<Request> CreateRequestDirect(
       tensor_name__,
       root_rank,
       device,
-      tensor_shape__);
+      tensor_shape__,
+      splits__,
+      reduce_op,
+      process_set_id,
+      compression,
+      group);
 }
 
 struct RequestList FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
@@ -349,7 +507,14 @@ struct Response FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
     VT_TENSOR_NAMES = 6,
     VT_ERROR_MESSAGE = 8,
     VT_DEVICES = 10,
-    VT_TENSOR_SIZES = 12
+    VT_TENSOR_SIZES = 12,
+    VT_REDUCE_OP = 14,
+    VT_ABSENT_RANKS = 16,
+    VT_CONTRIBUTIONS = 18,
+    VT_PROCESS_SET_ID = 20,
+    VT_COMPRESSION = 22,
+    VT_TENSOR_TYPE = 24,
+    VT_JOINED = 26
   };
   ResponseType response_type() const {
     return static_cast<ResponseType>(GetField<int8_t>(VT_RESPONSE_TYPE, 0));
@@ -366,6 +531,27 @@ struct Response FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
   const flatbuffers::Vector<int64_t> *tensor_sizes() const {
     return GetPointer<const flatbuffers::Vector<int64_t> *>(VT_TENSOR_SIZES);
   }
+  ReduceOp reduce_op() const {
+    return static_cast<ReduceOp>(GetField<int8_t>(VT_REDUCE_OP, 0));
+  }
+  const flatbuffers::Vector<int32_t> *absent_ranks() const {
+    return GetPointer<const flatbuffers::Vector<int32_t> *>(VT_ABSENT_RANKS);
+  }
+  int32_t contributions() const {
+    return GetField<int32_t>(VT_CONTRIBUTIONS, 0);
+  }
+  int32_t process_set_id() const {
+    return GetField<int32_t>(VT_PROCESS_SET_ID, 0);
+  }
+  Compression compression() const {
+    return static_cast<Compression>(GetField<int8_t>(VT_COMPRESSION, 0));
+  }
+  DataType tensor_type() const {
+    return static_cast<DataType>(GetField<int8_t>(VT_TENSOR_TYPE, 0));
+  }
+  bool joined() const {
+    return GetField<uint8_t>(VT_JOINED, 0) != 0;
+  }
   bool Verify(flatbuffers::Verifier &verifier) const {
     return VerifyTableStart(verifier) &&
            VerifyField<int8_t>(verifier, VT_RESPONSE_TYPE) &&
@@ -378,6 +564,14 @@ struct Response FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
            verifier.VerifyVector(devices()) &&
            VerifyOffset(verifier, VT_TENSOR_SIZES) &&
            verifier.VerifyVector(tensor_sizes()) &&
+           VerifyField<int8_t>(verifier, VT_REDUCE_OP) &&
+           VerifyOffset(verifier, VT_ABSENT_RANKS) &&
+           verifier.VerifyVector(absent_ranks()) &&
+           VerifyField<int32_t>(verifier, VT_CONTRIBUTIONS) &&
+           VerifyField<int32_t>(verifier, VT_PROCESS_SET_ID) &&
+           VerifyField<int8_t>(verifier, VT_COMPRESSION) &&
+           VerifyField<int8_t>(verifier, VT_TENSOR_TYPE) &&
+           VerifyField<uint8_t>(verifier, VT_JOINED) &&
            verifier.EndTable();
   }
 };
@@ -400,6 +594,27 @@ struct ResponseBuilder {
   void add_tensor_sizes(flatbuffers::Offset<flatbuffers::Vector<int64_t>> tensor_sizes) {
     fbb_.AddOffset(Response::VT_TENSOR_SIZES, tensor_sizes);
   }
+  void add_reduce_op(ReduceOp reduce_op) {
+    fbb_.AddElement<int8_t>(Response::VT_REDUCE_OP, static_cast<int8_t>(reduce_op), 0);
+  }
+  void add_absent_ranks(flatbuffers::Offset<flatbuffers::Vector<int32_t>> absent_ranks) {
+    fbb_.AddOffset(Response::VT_ABSENT_RANKS, absent_ranks);
+  }
+  void add_contributions(int32_t contributions) {
+    fbb_.AddElement<int32_t>(Response::VT_CONTRIBUTIONS, contributions, 0);
+  }
+  void add_process_set_id(int32_t process_set_id) {
+    fbb_.AddElement<int32_t>(Response::VT_PROCESS_SET_ID, process_set_id, 0);
+  }
+  void add_compression(Compression compression) {
+    fbb_.AddElement<int8_t>(Response::VT_COMPRESSION, static_cast<int8_t>(compression), 0);
+  }
+  void add_tensor_type(DataType tensor_type) {
+    fbb_.AddElement<int8_t>(Response::VT_TENSOR_TYPE, static_cast<int8_t>(tensor_type), 0);
+  }
+  void add_joined(bool joined) {
+    fbb_.AddElement<uint8_t>(Response::VT_JOINED, static_cast<uint8_t>(joined), 0);
+  }
   explicit ResponseBuilder(flatbuffers::FlatBufferBuilder &_fbb)
         : fbb_(_fbb) {
     start_ = fbb_.StartTable();
@@ -418,12 +633,26 @@ inline flatbuffers::Offset<Response> CreateResponse(
     flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>>> tensor_names = 0,
     flatbuffers::Offset<flatbuffers::String> error_message = 0,
     flatbuffers::Offset<flatbuffers::Vector<int32_t>> devices = 0,
-    flatbuffers::Offset<flatbuffers::Vector<int64_t>> tensor_sizes = 0) {
+    flatbuffers::Offset<flatbuffers::Vector<int64_t>> tensor_sizes = 0,
+    ReduceOp reduce_op = ReduceOp_SUM,
+    flatbuffers::Offset<flatbuffers::Vector<int32_t>> absent_ranks = 0,
+    int32_t contributions = 0,
+    int32_t process_set_id = 0,
+    Compression compression = Compression_NONE,
+    DataType tensor_type = DataType_HOROVOD_UINT8,
+    bool joined = false) {
   ResponseBuilder builder_(_fbb);
+  builder_.add_process_set_id(process_set_id);
+  builder_.add_contributions(contributions);
+  builder_.add_absent_ranks(absent_ranks);
   builder_.add_tensor_sizes(tensor_sizes);
   builder_.add_devices(devices);
   builder_.add_error_message(error_message);
   builder_.add_tensor_names(tensor_names);
+  builder_.add_joined(joined);
+  builder_.add_tensor_type(tensor_type);
+  builder_.add_compression(compression);
+  builder_.add_reduce_op(reduce_op);
   builder_.add_response_type(response_type);
   return builder_.Finish();
 }
@@ -434,24 +663,40 @@ inline flatbuffers::Offset<Response> CreateResponseDirect(
     const std::vector<flatbuffers::Offset<flatbuffers::String>> *tensor_names = nullptr,
     const char *error_message = nullptr,
     const std::vector<int32_t> *devices = nullptr,
-    const std::vector<int64_t> *tensor_sizes = nullptr) {
+    const std::vector<int64_t> *tensor_sizes = nullptr,
+    ReduceOp reduce_op = ReduceOp_SUM,
+    const std::vector<int32_t> *absent_ranks = nullptr,
+    int32_t contributions = 0,
+    int32_t process_set_id = 0,
+    Compression compression = Compression_NONE,
+    DataType tensor_type = DataType_HOROVOD_UINT8,
+    bool joined = false) {
   auto tensor_names__ = tensor_names ? _fbb.CreateVector<flatbuffers::Offset<flatbuffers::String>>(*tensor_names) : 0;
   auto error_message__ = error_message ? _fbb.CreateString(error_message) : 0;
   auto devices__ = devices ? _fbb.CreateVector<int32_t>(*devices) : 0;
   auto tensor_sizes__ = tensor_sizes ? _fbb.CreateVector<int64_t>(*tensor_sizes) : 0;
+  auto absent_ranks__ = absent_ranks ? _fbb.CreateVector<int32_t>(*absent_ranks) : 0;
   return horovod::common::wire::CreateResponse(
       _fbb,
       response_type,
       tensor_names__,
       error_message__,
       devices__,
-      tensor_sizes__);
+      tensor_sizes__,
+      reduce_op,
+      absent_ranks__,
+      contributions,
+      process_set_id,
+      compression,
+      tensor_type,
+      joined);
 }
 
 struct ResponseList FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
   enum FlatBuffersVTableOffset FLATBUFFERS_VTABLE_UNDERLYING_TYPE {
     VT_RESPONSES = 4,
-    VT_SHUTDOWN = 6
+    VT_SHUTDOWN = 6,
+    VT_SYNC_PARAMETERS = 8
   };
   const flatbuffers::Vector<flatbuffers::Offset<Response>> *responses() const {
     return GetPointer<const flatbuffers::Vector<flatbuffers::Offset<Response>> *>(VT_RESPONSES);
@@ -459,12 +704,16 @@ struct ResponseList FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
   bool shutdown() const {
     return GetField<uint8_t>(VT_SHUTDOWN, 0) != 0;
   }
+  bool sync_parameters() const {
+    return GetField<uint8_t>(VT_SYNC_PARAMETERS, 0) != 0;
+  }
   bool Verify(flatbuffers::Verifier &verifier) const {
     return VerifyTableStart(verifier) &&
            VerifyOffset(verifier, VT_RESPONSES) &&
            verifier.VerifyVector(responses()) &&
            verifier.VerifyVectorOfTables(responses()) &&
            VerifyField<uint8_t>(verifier, VT_SHUTDOWN) &&
+           VerifyField<uint8_t>(verifier, VT_SYNC_PARAMETERS) &&
            verifier.EndTable();
   }
 };
@@ -478,6 +727,9 @@ struct ResponseListBuilder {
   void add_shutdown(bool shutdown) {
     fbb_.AddElement<uint8_t>(ResponseList::VT_SHUTDOWN, static_cast<uint8_t>(shutdown), 0);
   }
+  void add_sync_parameters(bool sync_parameters) {
+    fbb_.AddElement<uint8_t>(ResponseList::VT_SYNC_PARAMETERS, static_cast<uint8_t>(sync_parameters), 0);
+  }
   explicit ResponseListBuilder(flatbuffers::FlatBufferBuilder &_fbb)
         : fbb_(_fbb) {
     start_ = fbb_.StartTable();
@@ -493,9 +745,11 @@ struct ResponseListBuilder {
 inline flatbuffers::Offset<ResponseList> CreateResponseList(
     flatbuffers::FlatBufferBuilder &_fbb,
     flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<Response>>> responses = 0,
-    bool shutdown = false) {
+    bool shutdown = false,
+    bool sync_parameters = false) {
   ResponseListBuilder builder_(_fbb);
   builder_.add_responses(responses);
+  builder_.add_sync_parameters(sync_parameters);
   builder_.add_shutdown(shutdown);
   return builder_.Finish();
 }
@@ -503,12 +757,14 @@ inline flatbuffers::Offset<ResponseList> CreateResponseList(
 inline flatbuffers::Offset<ResponseList> CreateResponseListDirect(
     flatbuffers::FlatBufferBuilder &_fbb,
     const std::vector<flatbuffers::Offset<Response>> *responses = nullptr,
-    bool shutdown = false) {
+    bool shutdown = false,
+    bool sync_parameters = false) {
   auto responses__ = responses ? _fbb.CreateVector<flatbuffers::Offset<Response>>(*responses) : 0;
   return horovod::common::wire::CreateResponseList(
       _fbb,
       responses__,
-      shutdown);
+      shutdown,
+      sync_parameters);
 }
 
 }  // namespace wire
@@ -18,6 +18,7 @@ import keras.backend as K
 
 from horovod.tensorflow import init
 from horovod.tensorflow import shutdown
+from horovod.tensorflow import reset
 from horovod.tensorflow import size
 from horovod.tensorflow import local_size
 from horovod.tensorflow import rank
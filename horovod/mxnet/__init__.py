@@ -24,12 +24,17 @@ check_extension('horovod.mxnet', 'HOROVOD_WITH_MXNET',
 
 from horovod.mxnet.mpi_ops import allgather
 from horovod.mxnet.mpi_ops import allreduce, allreduce_
+from horovod.mxnet.mpi_ops import grouped_allreduce, grouped_allreduce_
 from horovod.mxnet.mpi_ops import broadcast, broadcast_
-from horovod.mxnet.mpi_ops import init, shutdown
+from horovod.mxnet.mpi_ops import init, shutdown, reset
 from horovod.mxnet.mpi_ops import size, local_size, rank, local_rank
 from horovod.mxnet.mpi_ops import mpi_threads_supported, mpi_enabled, mpi_built
 from horovod.mxnet.mpi_ops import gloo_enabled, gloo_built
 from horovod.mxnet.mpi_ops import nccl_built, ddl_built, mlsl_built
+from horovod.mxnet.mpi_ops import metrics
+from horovod.mxnet.mpi_ops import stats
+from horovod.mxnet.mpi_ops import set_parameters
+from horovod.mxnet.mpi_ops import start_timeline, stop_timeline
 
 import mxnet as mx
 import types
@@ -83,7 +88,7 @@ class DistributedOptimizer(mx.optimizer.Optimizer):
 # 2. DistributedTrainer performs allreduce(summation) and average
 #    while Trainer only performs allreduce(summation).
 class DistributedTrainer(mx.gluon.Trainer):
-    def __init__(self, params, optimizer, optimizer_params=None):
+    def __init__(self, params, optimizer, optimizer_params=None, grouped=False):
         if isinstance(optimizer, DistributedOptimizer):
             optimizer = optimizer._optimizer
             warnings.warn("DistributedTrainer does not take DistributedOptimizer "
@@ -97,12 +102,26 @@ class DistributedTrainer(mx.gluon.Trainer):
         # average in allreduce, has better performance. 
         self._scale /= size()
 
+        # With grouped, the gradients of each type and context are pushed to
+        # the engine as one operation and negotiated as one group.
+        self._grouped = grouped
+
     def _allreduce_grads(self):
         # sort needed for Python < 3.6 is not guaranteed
-        for i, param in enumerate(sorted(self._params, key=lambda p: p.name)):
-            if param.grad_req != 'null':
-                allreduce_(param.list_grad()[0], average=False,
-                           name=str(i), priority=-i)
+        params = [param for param in sorted(self._params, key=lambda p: p.name)
+                  if param.grad_req != 'null']
+        if self._grouped:
+            groups = {}
+            for param in params:
+                grad = param.list_grad()[0]
+                groups.setdefault((str(grad.dtype), str(grad.context)), []).append(grad)
+            for i, key in enumerate(sorted(groups)):
+                grouped_allreduce_(groups[key], average=False,
+                                   name='group.%d' % i)
+            return
+        for i, param in enumerate(params):
+            allreduce_(param.list_grad()[0], average=False,
+                       name=str(i), priority=-i)
 
 
 # Wrapper to inject Horovod broadcast after parameter initialization
@@ -14,6 +14,7 @@
 // =============================================================================
 
 #include <atomic>
+#include <mutex>
 
 #include "../common/operations.h"
 #include "cuda_util.h"
@@ -140,6 +141,139 @@ inline void PushHorovodOperation(OperationType op_type, NDArray* input,
   }
 }
 
+// Calls the engine completion callback once all the tensors of a group are
+// done, with the first error if any.
+class GroupCompletion {
+public:
+  GroupCompletion(CallbackOnComplete on_complete, int num_tensors)
+      : on_complete_(on_complete), remaining_(num_tensors) {}
+
+  void Done(const Status& status) {
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      if (!status.ok() && status_.ok()) {
+        status_ = status;
+      }
+    }
+    if (remaining_.fetch_sub(1) == 1) {
+      InvokeCompleteCallback(on_complete_, status_);
+    }
+  }
+
+private:
+  CallbackOnComplete on_complete_;
+  std::atomic_int remaining_;
+  std::mutex mutex_;
+  Status status_;
+};
+
+void DoHorovodGroupedAllreduce(void*, void* on_complete_ptr, void* param) {
+  ThrowIfError(common::CheckInitialized());
+
+  auto on_complete = *static_cast<CallbackOnComplete*>(on_complete_ptr);
+  auto ops_param = static_cast<MpiGroupedOpsParam*>(param);
+  auto staged = !ops_param->cpu_tensors.empty();
+  auto num_tensors = staged ? ops_param->cpu_tensors.size()
+                            : ops_param->inputs.size();
+  auto device = staged ? CPU_DEVICE_ID
+                       : TensorUtil::GetDevice(ops_param->inputs[0]);
+
+  std::vector<std::shared_ptr<OpContext>> hvd_contexts;
+  std::vector<std::shared_ptr<Tensor>> hvd_tensors;
+  std::vector<std::shared_ptr<Tensor>> hvd_outputs;
+  std::vector<std::string> names;
+  for (size_t i = 0; i < num_tensors; ++i) {
+    if (staged) {
+      auto& hvd_cpu_buffer = ops_param->cpu_tensors[i];
+      hvd_contexts.push_back(std::make_shared<MXOpContext<NDArray>>(
+          CPU_DEVICE_ID, hvd_cpu_buffer->tensor()));
+      hvd_tensors.push_back(hvd_cpu_buffer);
+      hvd_outputs.push_back(hvd_cpu_buffer);
+    } else {
+      auto output = ops_param->outputs[i];
+      hvd_contexts.push_back(
+          std::make_shared<MXOpContext<NDArray>>(device, output));
+      hvd_tensors.push_back(
+          std::make_shared<MXTensor<NDArray>>(ops_param->inputs[i]));
+      hvd_outputs.push_back(std::make_shared<MXTensor<NDArray>>(output));
+    }
+    names.push_back(ops_param->op_name + "." + std::to_string(i));
+  }
+  // The engine runs the operation once all the inputs are ready, so there
+  // are no ready events to wait for.
+  std::vector<std::shared_ptr<common::ReadyEvent>> ready_events(num_tensors,
+                                                                nullptr);
+  auto completion = std::make_shared<GroupCompletion>(on_complete, num_tensors);
+  std::vector<StatusCallback> callbacks(
+      num_tensors,
+      [completion](const Status& status) { completion->Done(status); });
+
+  auto enqueue_result = EnqueueTensorAllreduces(
+      hvd_contexts, hvd_tensors, hvd_outputs, ready_events, names,
+      ops_param->op_name, device, callbacks, 0, 1.0,
+      ops_param->postscale_factor);
+  ThrowIfError(enqueue_result);
+}
+
+// Pushes the allreduce of all the tensors as one engine operation, which reads
+// the inputs and writes the outputs, and enqueues them as one group.
+inline void PushHorovodGroupedAllreduce(NDArray** inputs, NDArray** outputs,
+                                        int num_tensors, const char* name,
+                                        double postscale_factor,
+                                        int priority) {
+  auto op_name = GetOpName("horovod_grouped_allreduce", name);
+  std::vector<NDArray*> input_arrays(inputs, inputs + num_tensors);
+  std::vector<NDArray*> output_arrays(outputs, outputs + num_tensors);
+  std::vector<::mxnet::Engine::VarHandle> input_vars;
+  std::vector<::mxnet::Engine::VarHandle> output_vars;
+  for (int i = 0; i < num_tensors; ++i) {
+    if (inputs[i]->var() != outputs[i]->var()) {
+      input_vars.push_back(inputs[i]->var());
+    }
+    output_vars.push_back(outputs[i]->var());
+  }
+  auto ops_param = new MpiGroupedOpsParam(
+      std::move(input_arrays), std::move(output_arrays), {}, op_name,
+      postscale_factor);
+  MXEnginePushAsync(DoHorovodGroupedAllreduce, ops_param,
+                    DeleteMpiGroupedOpsParam, &MX_EXEC_CTX,
+                    input_vars.empty() ? nullptr : input_vars.data(),
+                    (int)input_vars.size(), output_vars.data(),
+                    (int)output_vars.size(), &MX_FUNC_PROP, priority,
+                    ALLREDUCE_OP_TYPE_NAME);
+}
+
+#if HAVE_CUDA
+// Without GPU allreduce the group is staged through CPU buffers, copied from
+// and back to the GPU by engine operations before and after the allreduce.
+inline void PushHorovodGroupedAllreduceCudaOnCPU(NDArray** inputs,
+                                                 NDArray** outputs,
+                                                 int num_tensors,
+                                                 const char* name,
+                                                 double postscale_factor,
+                                                 int priority) {
+  auto op_name = GetOpName("horovod_grouped_allreduce", name);
+  std::vector<MXTensorSharedPtr> cpu_buffers;
+  std::vector<::mxnet::Engine::VarHandle> cpu_vars;
+  for (int i = 0; i < num_tensors; ++i) {
+    auto hvd_cpu_buffer = std::make_shared<MXTemporaryBuffer<NDArray>>(
+        CPU_DEVICE_ID, inputs[i]->dtype());
+    TensorUtil::AsyncCopyCudaToCPU(inputs[i], hvd_cpu_buffer->tensor());
+    cpu_vars.push_back(hvd_cpu_buffer->tensor()->var());
+    cpu_buffers.push_back(hvd_cpu_buffer);
+  }
+  auto ops_param = new MpiGroupedOpsParam({}, {}, cpu_buffers, op_name,
+                                          postscale_factor);
+  MXEnginePushAsync(DoHorovodGroupedAllreduce, ops_param,
+                    DeleteMpiGroupedOpsParam, &MX_EXEC_CTX, nullptr, 0,
+                    cpu_vars.data(), (int)cpu_vars.size(), &MX_FUNC_PROP,
+                    priority, ALLREDUCE_OP_TYPE_NAME);
+  for (int i = 0; i < num_tensors; ++i) {
+    TensorUtil::AsyncCopyCPUToCuda(cpu_buffers[i]->tensor(), outputs[i]);
+  }
+}
+#endif
+
 #if HAVE_CUDA
 void DoHorovodOperationCudaOnCPU(void*, void* on_complete_ptr, void* param) {
   ThrowIfError(common::CheckInitialized());
@@ -232,6 +366,50 @@ extern "C" int horovod_mxnet_allreduce_async(NDArray* input, NDArray* output,
   MX_API_END();
 }
 
+extern "C" int horovod_mxnet_grouped_allreduce_async(NDArray** inputs,
+                                                     NDArray** outputs,
+                                                     int num_tensors,
+                                                     const char* name,
+                                                     bool average,
+                                                     int priority) {
+  MX_API_BEGIN();
+
+  if (num_tensors < 1) {
+    throw std::invalid_argument(
+        "A grouped allreduce needs at least one tensor.");
+  }
+  // Floating point averages are computed while the reduced values are
+  // unpacked, integer ones keep the rounding of the division.
+  auto dtype = inputs[0]->dtype();
+  auto average_in_postscale =
+      average && (dtype == mshadow::kFloat16 || dtype == mshadow::kFloat32 ||
+                  dtype == mshadow::kFloat64);
+  double postscale_factor =
+      average_in_postscale ? 1.0 / horovod_size() : 1.0;
+
+#if HAVE_CUDA && !HOROVOD_GPU_ALLREDUCE
+  if (inputs[0]->ctx().dev_mask() == cpu::kDevMask &&
+      outputs[0]->ctx().dev_mask() == cpu::kDevMask) {
+    PushHorovodGroupedAllreduce(inputs, outputs, num_tensors, name,
+                                postscale_factor, priority);
+  } else {
+    PushHorovodGroupedAllreduceCudaOnCPU(inputs, outputs, num_tensors, name,
+                                         postscale_factor, priority);
+  }
+#else
+  PushHorovodGroupedAllreduce(inputs, outputs, num_tensors, name,
+                              postscale_factor, priority);
+#endif
+
+  if (average && !average_in_postscale) {
+    for (int i = 0; i < num_tensors; ++i) {
+      *outputs[i] /= horovod_size();
+    }
+  }
+
+  MX_API_END();
+}
+
 extern "C" int horovod_mxnet_allgather_async(NDArray* input, NDArray* output,
                                              const char* name, int priority) {
   MX_API_BEGIN();
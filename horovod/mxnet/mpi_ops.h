@@ -16,6 +16,9 @@
 #ifndef HOROVOD_MXNET_MPI_OPS_H
 #define HOROVOD_MXNET_MPI_OPS_H
 
+#include <string>
+#include <vector>
+
 #include <mxnet/base.h>
 #include <mxnet/c_api.h>
 #include <mxnet/c_api_error.h>
@@ -69,9 +72,40 @@ void DeleteMpiOpsParam(void* param) {
   delete ops_param;
 }
 
+// Parameters of a grouped allreduce, pushed as a single engine operation.
+struct MpiGroupedOpsParam {
+  std::vector<NDArray*> inputs;
+  std::vector<NDArray*> outputs;
+  std::vector<MXTensorSharedPtr> cpu_tensors;
+  std::string op_name;
+  double postscale_factor;
+
+  MpiGroupedOpsParam(std::vector<NDArray*> inputs,
+                     std::vector<NDArray*> outputs,
+                     std::vector<MXTensorSharedPtr> cpu_tensors,
+                     const std::string& op_name, double postscale_factor)
+      : inputs(std::move(inputs)),
+        outputs(std::move(outputs)),
+        cpu_tensors(std::move(cpu_tensors)),
+        op_name(op_name),
+        postscale_factor(postscale_factor) {
+  }
+};
+
+void DeleteMpiGroupedOpsParam(void* param) {
+  auto ops_param = static_cast<MpiGroupedOpsParam*>(param);
+  delete ops_param;
+}
+
 extern "C" int horovod_mxnet_allreduce_async(NDArray* input, NDArray* output,
                                              const char* name, bool average,
                                              int priority);
+extern "C" int horovod_mxnet_grouped_allreduce_async(NDArray** inputs,
+                                                     NDArray** outputs,
+                                                     int num_tensors,
+                                                     const char* name,
+                                                     bool average,
+                                                     int priority);
 extern "C" int horovod_mxnet_allgather_async(NDArray* input, NDArray* output,
                                              const char* name, int priority);
 extern "C" int horovod_mxnet_broadcast_async(NDArray* input, NDArray* output,
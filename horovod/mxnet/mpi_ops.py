@@ -31,6 +31,7 @@ _basics = _HorovodBasics(__file__, 'mpi_lib')
 # import basic methods
 init = _basics.init
 shutdown = _basics.shutdown
+reset = _basics.reset
 size = _basics.size
 local_size = _basics.local_size
 rank = _basics.rank
@@ -43,6 +44,11 @@ gloo_built = _basics.gloo_built
 nccl_built = _basics.nccl_built
 ddl_built = _basics.ddl_built
 mlsl_built = _basics.mlsl_built
+metrics = _basics.metrics
+stats = _basics.stats
+set_parameters = _basics.set_parameters
+start_timeline = _basics.start_timeline
+stop_timeline = _basics.stop_timeline
 
 dll_path = os.path.join(os.path.dirname(__file__),
                         'mpi_lib' + get_ext_suffix())
@@ -126,6 +132,67 @@ def allreduce_(tensor, average=True, name=None, priority=0):
     return tensor
 
 
+def _grouped_allreduce(tensors, outputs, average, name, priority):
+    if len(tensors) == 0:
+        raise ValueError('grouped allreduce needs at least one tensor.')
+    num_tensors = len(tensors)
+    c_in = (ctypes.c_void_p * num_tensors)(*[t.handle for t in tensors])
+    c_out = (ctypes.c_void_p * num_tensors)(*[o.handle for o in outputs])
+    c_name = c_str(name) if isinstance(name, string_types) else name
+    check_call(MPI_MXNET_LIB_CTYPES.horovod_mxnet_grouped_allreduce_async(
+        c_in, c_out, ctypes.c_int(num_tensors), c_name, ctypes.c_bool(average),
+        ctypes.c_int(priority)))
+
+
+def grouped_allreduce(tensors, average=True, name=None, priority=0):
+    """
+    A function that performs averaging or summation of a list of input tensors
+    over all the Horovod processes. The input tensors are not modified.
+
+    The tensors are pushed to the engine as a single operation, negotiated as a
+    single group keyed by the name and fused together. The tensors must have
+    the same type and context, and the number of tensors and their shapes must
+    be the same on all Horovod processes for a given name.
+
+    Arguments:
+        tensors: A list of tensors to average and sum.
+        average: A flag indicating whether to compute average or summation,
+                 defaults to average.
+        name: A name of the group.
+        priority: The priority of this operation. Higher priority operations
+                  are likely to be executed before other operations.
+
+    Returns:
+        A list of tensors of the same shapes and type as `tensors`, averaged or
+        summed across all processes.
+    """
+    outputs = [mx.nd.zeros(shape=tensor.shape, ctx=tensor.context,
+                           dtype=tensor.dtype) for tensor in tensors]
+    _grouped_allreduce(tensors, outputs, average, name, priority)
+    return outputs
+
+
+def grouped_allreduce_(tensors, average=True, name=None, priority=0):
+    """
+    A function that performs in-place averaging or summation of a list of input
+    tensors over all the Horovod processes, pushed to the engine as a single
+    operation and negotiated as a single group.
+
+    Arguments:
+        tensors: A list of tensors to average and sum.
+        average: A flag indicating whether to compute average or summation,
+                 defaults to average.
+        name: A name of the group.
+        priority: The priority of this operation. Higher priority operations
+                  are likely to be executed before other operations.
+
+    Returns:
+        The list of tensors, averaged or summed across all processes.
+    """
+    _grouped_allreduce(tensors, tensors, average, name, priority)
+    return tensors
+
+
 def allgather(tensor, name=None, priority=0):
     """
     A function that concatenates the input tensor with the same input tensor on
@@ -13,8 +13,10 @@
 # limitations under the License.
 # =============================================================================
 import collections
+import time
 
-from six.moves import BaseHTTPServer, SimpleHTTPServer
+from six.moves import BaseHTTPServer, SimpleHTTPServer, socketserver
+from six.moves.urllib.parse import parse_qs, urlparse
 from horovod.run.util.network import find_port
 import threading
 import socket
@@ -25,6 +27,9 @@ SINGLE_REQUEST_TIMEOUT = 3
 # Timeout for accepting new request
 TOTAL_TIMEOUT = 60
 
+# Longest time a batched GET waits for missing keys, in seconds
+MAX_WAIT_TIMEOUT = 30
+
 BAD_REQUEST = 400
 TIMEOUT = 408
 OK = 200
@@ -36,7 +41,8 @@ class RendezvousHandler(SimpleHTTPServer.SimpleHTTPRequestHandler):
 
     # Override GET handler
     def do_GET(self):
-        paths = self.path.split('/')
+        url = urlparse(self.path)
+        paths = url.path.split('/')
         if len(paths) < 3:
             print(
                 'Rendezvous ERROR: Invalid request path: {path}.'.format(
@@ -45,6 +51,10 @@ class RendezvousHandler(SimpleHTTPServer.SimpleHTTPRequestHandler):
             return
 
         _, scope, key = paths
+        if not key:
+            self.get_scope(scope, parse_qs(url.query))
+            return
+
         with self.server.cache_lock:
             value = self.server.cache.get(scope, {}).get(key)
 
@@ -56,6 +66,38 @@ class RendezvousHandler(SimpleHTTPServer.SimpleHTTPRequestHandler):
             self.end_headers()
             self.wfile.write(value)
 
+    # Batched GET of /<scope>/?keys=<key>,...&timeout=<milliseconds>: waits
+    # until all the given keys are set, or until the timeout, and returns
+    # every key of the scope set so far. This saves the workers from polling
+    # each key, and from another request for most keys they wait for later.
+    # Each key and value is preceded by a line with their lengths.
+    def get_scope(self, scope, query):
+        keys = [key for key in query.get('keys', [''])[0].split(',') if key]
+        try:
+            timeout = float(query.get('timeout', ['0'])[0]) / 1000
+        except ValueError:
+            self.send_status_code(BAD_REQUEST)
+            return
+        deadline = time.time() + min(timeout, MAX_WAIT_TIMEOUT)
+
+        with self.server.cache_cond:
+            scope_dict = self.server.cache.get(scope, {})
+            while not all(key in scope_dict for key in keys):
+                remaining = deadline - time.time()
+                if remaining <= 0:
+                    break
+                self.server.cache_cond.wait(remaining)
+                scope_dict = self.server.cache.get(scope, {})
+            items = list(scope_dict.items())
+
+        body = b''.join(
+            '{} {}\n'.format(len(key), len(value)).encode('ascii') +
+            key.encode('utf-8') + value for key, value in items)
+        self.send_response(OK)
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
     # Override PUT handler
     def do_PUT(self):
         paths = self.path.split('/')
@@ -83,9 +125,10 @@ class RendezvousHandler(SimpleHTTPServer.SimpleHTTPRequestHandler):
             self.send_status_code(TIMEOUT)
             return
 
-        with self.server.cache_lock:
+        with self.server.cache_cond:
             scope_dict = self.server.cache.setdefault(scope, {})
             scope_dict[key] = value
+            self.server.cache_cond.notify_all()
             if self.server.verbose:
                 print(scope, self.server.cache[scope].keys())
 
@@ -119,7 +162,15 @@ class RendezvousHandler(SimpleHTTPServer.SimpleHTTPRequestHandler):
         pass
 
 
-class RendezvousHTTPServer(BaseHTTPServer.HTTPServer, object):
+# Requests are handled on their own threads, so that batched GETs waiting for
+# keys do not hold up the PUTs setting them.
+class RendezvousHTTPServer(socketserver.ThreadingMixIn,
+                           BaseHTTPServer.HTTPServer, object):
+    daemon_threads = True
+
+    # Every worker connects at about the same time at startup.
+    request_queue_size = 1024
+
     def __init__(self, addr, handler, verbose):
         # This class has to inherit from object since HTTPServer is an old-style
         # class that does not inherit from object.
@@ -132,8 +183,10 @@ class RendezvousHTTPServer(BaseHTTPServer.HTTPServer, object):
         # Total size for scopes
         self.scope_size = {}
 
-        # Cache that provides the store
+        # Cache that provides the store, the condition is notified whenever a
+        # key is set
         self.cache_lock = threading.Lock()
+        self.cache_cond = threading.Condition(self.cache_lock)
         self.cache = {}
 
         self.verbose = verbose
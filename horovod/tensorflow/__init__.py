@@ -20,30 +20,81 @@ from __future__ import division
 from __future__ import print_function
 
 from horovod.common.util import check_extension
+from horovod.common.util import Average, Sum, Adasum, Min, Max, Product
+from horovod.common.util import REDUCE_OP_SUM, get_reduce_op
 
 check_extension('horovod.tensorflow', 'HOROVOD_WITH_TENSORFLOW', __file__, 'mpi_lib')
 
 from horovod.tensorflow.compression import Compression
 from horovod.tensorflow.mpi_ops import allgather, broadcast, _allreduce
-from horovod.tensorflow.mpi_ops import init, shutdown
+from horovod.tensorflow.mpi_ops import _grouped_allreduce
+from horovod.tensorflow.mpi_ops import init, shutdown, reset
 from horovod.tensorflow.mpi_ops import size, local_size, rank, local_rank
 from horovod.tensorflow.mpi_ops import mpi_threads_supported, mpi_enabled, mpi_built
 from horovod.tensorflow.mpi_ops import gloo_enabled, gloo_built
 from horovod.tensorflow.mpi_ops import nccl_built, ddl_built, mlsl_built
+from horovod.tensorflow.mpi_ops import metrics
+from horovod.tensorflow.mpi_ops import stats
+from horovod.tensorflow.mpi_ops import set_parameters
+from horovod.tensorflow.mpi_ops import start_timeline, stop_timeline
 from horovod.tensorflow.util import _executing_eagerly, _make_subgraph, _cache
 
 import tensorflow as tf
 import warnings
 
 
+# Value types of tf.IndexedSlices that are allgathered together with their
+# indices, packed into a single uint8 tensor.
+_PACKED_SPARSE_TYPES = (tf.float16, tf.float32, tf.float64)
+
+
+def _allgather_indexed_slices(values, indices, dedup):
+    """Allgathers the values and indices of a tf.IndexedSlices. Each row's
+    index and values are packed into one uint8 row, so that they are
+    negotiated and transferred as a single tensor. Sums the values of
+    duplicate indices if dedup is True."""
+    if values.dtype in _PACKED_SPARSE_TYPES:
+        values_shape = tf.shape(values)
+        rows = values_shape[0]
+        inner = tf.reduce_prod(values_shape[1:])
+        itemsize = values.dtype.size
+        value_bytes = tf.reshape(
+            tf.bitcast(tf.reshape(values, [rows, inner]), tf.uint8),
+            [rows, inner * itemsize])
+        index_bytes = tf.bitcast(tf.cast(indices, tf.int64), tf.uint8)
+        gathered = allgather(tf.concat([index_bytes, value_bytes], axis=1))
+
+        gathered_rows = tf.shape(gathered)[0]
+        new_indices = tf.cast(tf.bitcast(gathered[:, :8], tf.int64),
+                              indices.dtype)
+        new_values = tf.bitcast(
+            tf.reshape(gathered[:, 8:], [gathered_rows, inner, itemsize]),
+            values.dtype)
+        new_values = tf.reshape(
+            new_values, tf.concat([[gathered_rows], values_shape[1:]], axis=0))
+    else:
+        new_values = allgather(values)
+        new_indices = allgather(indices)
+
+    if dedup:
+        try:
+            segment_sum = tf.math.unsorted_segment_sum
+        except AttributeError:
+            segment_sum = tf.unsorted_segment_sum
+        new_indices, segments = tf.unique(new_indices)
+        new_values = segment_sum(new_values, segments, tf.shape(new_indices)[0])
+    return new_values, new_indices
+
+
 def allreduce(tensor, average=True, device_dense='', device_sparse='',
-              compression=Compression.none):
+              compression=Compression.none, sparse_dedup=False, op=None):
     """Perform an allreduce on a tf.Tensor or tf.IndexedSlices.
 
     This function performs a bandwidth-optimal ring allreduce on the input
     tensor. If the input is an tf.IndexedSlices, the function instead does an
     allgather on the values and the indices, effectively doing an allreduce on
-    the represented tensor.
+    the represented tensor. Floating point values are gathered together with
+    their indices in a single allgather.
 
     Arguments:
         tensor: tf.Tensor, tf.Variable, or tf.IndexedSlices to reduce.
@@ -57,17 +108,26 @@ def allreduce(tensor, average=True, device_dense='', device_sparse='',
         compression: Compression algorithm used to reduce the amount of data
                      sent and received by each worker node.  Defaults to not
                      using compression.
+        sparse_dedup: If True, sums the gathered values of tf.IndexedSlices
+                      with the same index, so that each index appears once.
+        op: The reduction, one of `Average`, `Sum`, `Adasum`, `Min`, `Max` or
+            `Product`. Overrides `average` if set. tf.IndexedSlices only
+            support `Average` and `Sum`.
 
     Returns:
-        A tensor of the same shape and type as `tensor`, summed across all
+        A tensor of the same shape and type as `tensor`, reduced across all
         processes.
     """
+    average, reduce_op = get_reduce_op(average, op)
     if isinstance(tensor, tf.IndexedSlices):
+        if reduce_op != REDUCE_OP_SUM:
+            raise NotImplementedError(
+                'The %s reduction is not supported for tf.IndexedSlices.' % op)
         with tf.device(device_sparse):
-            # For IndexedSlices, do two allgathers instead of an allreduce.
+            # For IndexedSlices, do an allgather instead of an allreduce.
             horovod_size = tf.cast(size(), tensor.values.dtype)
-            values = allgather(tensor.values)
-            indices = allgather(tensor.indices)
+            values, indices = _allgather_indexed_slices(
+                tensor.values, tensor.indices, sparse_dedup)
 
             # To make this operation into an average, divide allgathered values by
             # the Horovod size.
@@ -78,12 +138,49 @@ def allreduce(tensor, average=True, device_dense='', device_sparse='',
         with tf.device(device_dense):
             horovod_size = tf.cast(size(), dtype=tensor.dtype)
             tensor_compressed, ctx = compression.compress(tensor)
-            summed_tensor_compressed = _allreduce(tensor_compressed)
+            summed_tensor_compressed = _allreduce(tensor_compressed,
+                                                  reduce_op=reduce_op)
             summed_tensor = compression.decompress(summed_tensor_compressed, ctx)
             new_tensor = (summed_tensor / horovod_size) if average else summed_tensor
         return new_tensor
 
 
+def grouped_allreduce(tensors, average=True, device_dense='',
+                      compression=Compression.none):
+    """Perform an allreduce on a list of tf.Tensor, which are negotiated as a
+    single group and fused together.
+
+    One request is sent for the whole group rather than one per tensor, which
+    cuts the negotiation of models with many small gradients.
+
+    Arguments:
+        tensors: List of tf.Tensor or tf.Variable to reduce, all of the same
+                 type. The number of tensors and their shapes must be
+                 identical across all ranks.
+        average: If True, computes the average over all ranks.
+                 Otherwise, computes the sum over all ranks.
+        device_dense: Device to be used for the tensors. Uses GPU by default
+                      if Horovod was built with HOROVOD_GPU_ALLREDUCE.
+        compression: Compression algorithm used to reduce the amount of data
+                     sent and received by each worker node.  Defaults to not
+                     using compression.
+
+    Returns:
+        A list of tensors of the same shapes and type as `tensors`, summed
+        across all processes.
+    """
+    with tf.device(device_dense):
+        horovod_size = tf.cast(size(), dtype=tensors[0].dtype)
+        tensors_compressed, ctxs = zip(*[compression.compress(tensor)
+                                         for tensor in tensors])
+        summed_tensors_compressed = _grouped_allreduce(list(tensors_compressed))
+        summed_tensors = [compression.decompress(t, ctx) for t, ctx
+                          in zip(summed_tensors_compressed, ctxs)]
+        if average:
+            summed_tensors = [t / horovod_size for t in summed_tensors]
+    return summed_tensors
+
+
 @_cache
 def _make_broadcast_group_fn():
     if _executing_eagerly():
@@ -195,7 +292,7 @@ if _SessionRunHook is not None and _get_default_graph is not None:
 
 @_cache
 def _make_allreduce_grads_fn(name, device_dense, device_sparse,
-                             compression, sparse_as_dense):
+                             compression, sparse_as_dense, grouped=False):
     def allreduce_grads(grads):
         with tf.name_scope(name + "_Allreduce"):
             if sparse_as_dense:
@@ -203,6 +300,28 @@ def _make_allreduce_grads_fn(name, device_dense, device_sparse,
                          if grad is not None and isinstance(grad, tf.IndexedSlices)
                          else grad for grad in grads]
 
+            if grouped:
+                # Dense gradients are reduced in one group per dtype, sparse
+                # ones are still allgathered one by one.
+                grads = list(grads)
+                dense = {}
+                for i, grad in enumerate(grads):
+                    if grad is not None and not isinstance(grad, tf.IndexedSlices):
+                        dense.setdefault(grad.dtype, []).append(i)
+                reduced = list(grads)
+                for dtype in sorted(dense, key=lambda dtype: dtype.name):
+                    indices = dense[dtype]
+                    summed = grouped_allreduce([grads[i] for i in indices],
+                                               device_dense=device_dense,
+                                               compression=compression)
+                    for i, grad in zip(indices, summed):
+                        reduced[i] = grad
+                return [allreduce(grad, device_dense=device_dense,
+                                  device_sparse=device_sparse,
+                                  compression=compression)
+                        if isinstance(grad, tf.IndexedSlices) else reduced[i]
+                        for i, grad in enumerate(grads)]
+
             return [allreduce(grad,
                               device_dense=device_dense,
                               device_sparse=device_sparse,
@@ -322,7 +441,7 @@ def DistributedOptimizer(optimizer, name=None, use_locking=False, device_dense='
 if hasattr(tf, 'GradientTape'):
     class _DistributedGradientTape(tf.GradientTape):
         def __init__(self, tape, device_dense, device_sparse, compression, sparse_as_dense,
-                     persistent=False, watch_accessed_variables=True):
+                     persistent=False, watch_accessed_variables=True, grouped=False):
             if hasattr(tape, '_watch_accessed_variables'):
                 super(self.__class__, self).__init__(persistent, watch_accessed_variables)
             else:
@@ -331,7 +450,7 @@ if hasattr(tf, 'GradientTape'):
             self._tape = tape
             self._allreduce_grads = _make_allreduce_grads_fn(
                 'DistributedGradientTape', device_dense, device_sparse, compression,
-                sparse_as_dense)
+                sparse_as_dense, grouped)
 
         def gradient(self, target, sources, output_gradients=None):
             gradients = super(self.__class__, self).gradient(target, sources, output_gradients)
@@ -342,7 +461,8 @@ if hasattr(tf, 'GradientTape'):
 
 
     def DistributedGradientTape(gradtape, device_dense='', device_sparse='',
-                                compression=Compression.none, sparse_as_dense=False):
+                                compression=Compression.none, sparse_as_dense=False,
+                                grouped=False):
         """A tape that wraps another tf.GradientTape, using an allreduce to
         average gradient values before applying gradients to model weights.
 
@@ -363,6 +483,10 @@ if hasattr(tf, 'GradientTape'):
             Treat all sparse gradients as dense tensors.  This can help improve
             performance and memory utilization if the original sparse gradient
             has high density.  Defaults to false.
+          grouped:
+            Allreduce the dense gradients of each dtype as one group, which
+            is negotiated as a single request and fused together, instead of
+            one allreduce per gradient.  Defaults to false.
         """
         warnings.warn('`hvd.DistributedGradientTape()` has been deprecated. '
                       'Please use `hvd.DistributedOptimizer()` instead.')
@@ -371,7 +495,7 @@ if hasattr(tf, 'GradientTape'):
         if hasattr(gradtape, '_watch_accessed_variables'):
             return cls(gradtape._tape, device_dense, device_sparse, compression,
                        sparse_as_dense, gradtape._persistent,
-                       gradtape._watch_accessed_variables)
+                       gradtape._watch_accessed_variables, grouped)
         else:
             return cls(gradtape._tape, device_dense, device_sparse, compression,
-                       sparse_as_dense, gradtape._persistent)
+                       sparse_as_dense, gradtape._persistent, grouped=grouped)
@@ -14,6 +14,7 @@
 // limitations under the License.
 // =============================================================================
 
+#include <atomic>
 #include <memory>
 #include <queue>
 #include <thread>
@@ -26,7 +27,11 @@
 #define EIGEN_USE_THREADS
 
 #if HAVE_CUDA
+#include <cuda_runtime.h>
+#include <mutex>
+
 #include "tensorflow/stream_executor/stream.h"
+#include "tensorflow/stream_executor/stream_executor_internal.h"
 #endif
 
 #define OMPI_SKIP_MPICXX
@@ -75,13 +80,18 @@ common::Status ConvertStatus(const Status& status) {
 }
 
 #if HAVE_CUDA
+// CUDA event recorded on the TF compute stream. NCCL allreduce makes its
+// stream wait for it, other operations poll it from the background thread.
 class TFReadyEvent : public common::ReadyEvent {
 public:
-  TFReadyEvent(DeviceContext* device_context);
+  TFReadyEvent(DeviceContext* device_context, int device);
+  ~TFReadyEvent() override;
   bool Ready() const override;
+  cudaEvent_t CudaEvent() const override;
 
 private:
-  std::shared_ptr<perftools::gputools::Event> event_;
+  int device_;
+  cudaEvent_t cuda_event_ = nullptr;
 };
 #endif
 
@@ -123,18 +133,47 @@ private:
 };
 
 #if HAVE_CUDA
-TFReadyEvent::TFReadyEvent(DeviceContext* device_context) {
-  auto executor = device_context->stream()->parent();
-  auto ready_event = new perftools::gputools::Event(executor);
-  ready_event->Init();
-  device_context->stream()->ThenRecordEvent(ready_event);
-  event_ = std::shared_ptr<perftools::gputools::Event>(ready_event);
+// Events are reused once released, since creating one per tensor and step
+// costs more than recording it.
+struct ReadyEventRegistry {
+  std::unordered_map<int, std::queue<cudaEvent_t>> cuda_events;
+  std::mutex mutex;
+};
+
+static ReadyEventRegistry ready_event_registry;
+
+TFReadyEvent::TFReadyEvent(DeviceContext* device_context, int device)
+    : device_(device) {
+  int restore_device;
+  cudaGetDevice(&restore_device);
+  cudaSetDevice(device_);
+  {
+    std::lock_guard<std::mutex> guard(ready_event_registry.mutex);
+    auto& queue = ready_event_registry.cuda_events[device_];
+    if (!queue.empty()) {
+      cuda_event_ = queue.front();
+      queue.pop();
+    }
+  }
+  if (cuda_event_ == nullptr) {
+    cudaEventCreateWithFlags(&cuda_event_, cudaEventDisableTiming);
+  }
+  auto stream = reinterpret_cast<cudaStream_t>(
+      device_context->stream()->implementation()->GpuStreamMemberHack());
+  cudaEventRecord(cuda_event_, stream);
+  cudaSetDevice(restore_device);
+}
+
+TFReadyEvent::~TFReadyEvent() {
+  std::lock_guard<std::mutex> guard(ready_event_registry.mutex);
+  ready_event_registry.cuda_events[device_].push(cuda_event_);
 }
 
 bool TFReadyEvent::Ready() const {
-  return event_->PollForStatus() !=
-         perftools::gputools::Event::Status::kPending;
+  return cudaEventQuery(cuda_event_) != cudaErrorNotReady;
 }
+
+cudaEvent_t TFReadyEvent::CudaEvent() const { return cuda_event_; }
 #endif
 
 TFPersistentBuffer::TFPersistentBuffer(OpKernelContext* context, int64_t size) {
@@ -192,6 +231,8 @@ const common::DataType TFTensor::dtype() const {
     return common::HOROVOD_FLOAT64;
   case DT_BOOL:
     return common::HOROVOD_BOOL;
+  case DT_BFLOAT16:
+    return common::HOROVOD_BFLOAT16;
   default:
     throw std::logic_error("Invalid tensor type.");
   }
@@ -265,7 +306,7 @@ common::ReadyEvent* RecordReadyEvent(OpKernelContext* context) {
 #if HAVE_CUDA
   auto device_context = context->op_device_context();
   if (device_context != nullptr) {
-    return new TFReadyEvent(device_context);
+    return new TFReadyEvent(device_context, GetDeviceID(context));
   }
 #endif
   return nullptr;
@@ -276,7 +317,9 @@ common::ReadyEvent* RecordReadyEvent(OpKernelContext* context) {
 class HorovodAllreduceOp : public AsyncOpKernel {
 public:
   explicit HorovodAllreduceOp(OpKernelConstruction* context)
-      : AsyncOpKernel(context) {}
+      : AsyncOpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("reduce_op", &reduce_op_));
+  }
 
   void ComputeAsync(OpKernelContext* context, DoneCallback done) override {
     OP_REQUIRES_OK_ASYNC(context, ConvertStatus(common::CheckInitialized()),
@@ -284,10 +327,16 @@ public:
 
     auto node_name = name();
     auto device = GetDeviceID(context);
-    auto tensor = context->input(0);
+    // The input is reduced in place when TensorFlow lets the output reuse its
+    // buffer. It is only forwarded while the op holds the sole reference to
+    // it, so the output is set up before the input is copied.
     Tensor* output;
     OP_REQUIRES_OK_ASYNC(
-        context, context->allocate_output(0, tensor.shape(), &output), done);
+        context,
+        context->forward_input_or_allocate_output(
+            {0}, 0, context->input(0).shape(), &output),
+        done);
+    auto tensor = context->input(0);
     // ReadyEvent makes sure input tensor is ready, and output is allocated.
     auto ready_event = std::shared_ptr<common::ReadyEvent>(RecordReadyEvent(context));
     auto hvd_context = std::make_shared<TFOpContext>(context);
@@ -298,9 +347,13 @@ public:
         [context, done](const common::Status& status) {
           context->SetStatus(ConvertStatus(status));
           done();
-        });
+        }, /*priority=*/0, /*prescale_factor=*/1.0, /*postscale_factor=*/1.0,
+        static_cast<common::ReduceOp>(reduce_op_));
     OP_REQUIRES_OK_ASYNC(context, ConvertStatus(enqueue_result), done);
   }
+
+private:
+  int reduce_op_;
 };
 
 REGISTER_KERNEL_BUILDER(Name("HorovodAllreduce").Device(DEVICE_CPU),
@@ -311,7 +364,8 @@ REGISTER_KERNEL_BUILDER(Name("HorovodAllreduce").Device(DEVICE_GPU),
 #endif
 
 REGISTER_OP("HorovodAllreduce")
-    .Attr("T: {int32, int64, float16, float32, float64}")
+    .Attr("T: {int32, int64, float16, bfloat16, float32, float64}")
+    .Attr("reduce_op: int = 0")
     .Input("tensor: T")
     .Output("sum: T")
     .SetShapeFn([](shape_inference::InferenceContext* c) {
@@ -326,9 +380,99 @@ allreduce.
 
 Arguments
     tensor:     A tensor to reduce.
+    reduce_op:  How the tensors are combined: 0 sums them, 1 applies Adasum,
+                2, 3 and 4 take their elementwise minimum, maximum and product.
+
+Output
+    sum:    A tensor with the same shape as `tensor`, reduced across all MPI processes.
+)doc");
+
+class HorovodGroupedAllreduceOp : public AsyncOpKernel {
+public:
+  explicit HorovodGroupedAllreduceOp(OpKernelConstruction* context)
+      : AsyncOpKernel(context) {}
+
+  void ComputeAsync(OpKernelContext* context, DoneCallback done) override {
+    OP_REQUIRES_OK_ASYNC(context, ConvertStatus(common::CheckInitialized()),
+                         done);
+
+    auto node_name = name();
+    auto device = GetDeviceID(context);
+    auto num_tensors = context->num_inputs();
+    std::vector<std::shared_ptr<common::OpContext>> hvd_contexts;
+    std::vector<std::shared_ptr<common::Tensor>> hvd_tensors;
+    std::vector<std::shared_ptr<common::Tensor>> hvd_outputs;
+    std::vector<std::string> names;
+    for (int i = 0; i < num_tensors; ++i) {
+      // Reduced in place when possible, like single allreduces.
+      Tensor* output;
+      OP_REQUIRES_OK_ASYNC(
+          context,
+          context->forward_input_or_allocate_output(
+              {i}, i, context->input(i).shape(), &output),
+          done);
+      auto tensor = context->input(i);
+      hvd_contexts.push_back(std::make_shared<TFOpContext>(context));
+      hvd_tensors.push_back(std::make_shared<TFTensor>(tensor));
+      hvd_outputs.push_back(std::make_shared<TFTensor>(*output));
+      names.push_back(node_name + "." + std::to_string(i));
+    }
+    // One ReadyEvent recorded after all outputs are allocated covers all the
+    // inputs of the group.
+    auto ready_event = std::shared_ptr<common::ReadyEvent>(RecordReadyEvent(context));
+    std::vector<std::shared_ptr<common::ReadyEvent>> ready_events(num_tensors,
+                                                                  ready_event);
+    // The kernel is done once the callbacks of all the tensors have run.
+    auto remaining = std::make_shared<std::atomic_int>(num_tensors);
+    std::vector<common::StatusCallback> callbacks;
+    for (int i = 0; i < num_tensors; ++i) {
+      callbacks.emplace_back(
+          [context, done, remaining](const common::Status& status) {
+            if (!status.ok()) {
+              context->SetStatus(ConvertStatus(status));
+            }
+            if (remaining->fetch_sub(1) == 1) {
+              done();
+            }
+          });
+    }
+    auto enqueue_result = EnqueueTensorAllreduces(
+        hvd_contexts, hvd_tensors, hvd_outputs, ready_events, names, node_name,
+        device, callbacks);
+    OP_REQUIRES_OK_ASYNC(context, ConvertStatus(enqueue_result), done);
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("HorovodGroupedAllreduce").Device(DEVICE_CPU),
+                        HorovodGroupedAllreduceOp);
+#if HOROVOD_GPU_ALLREDUCE
+REGISTER_KERNEL_BUILDER(Name("HorovodGroupedAllreduce").Device(DEVICE_GPU),
+                        HorovodGroupedAllreduceOp);
+#endif
+
+REGISTER_OP("HorovodGroupedAllreduce")
+    .Attr("T: {int32, int64, float16, bfloat16, float32, float64}")
+    .Attr("N: int >= 1")
+    .Input("tensors: N * T")
+    .Output("sums: N * T")
+    .SetShapeFn([](shape_inference::InferenceContext* c) {
+      for (int i = 0; i < c->num_inputs(); ++i) {
+        c->set_output(i, c->input(i));
+      }
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Perform an MPI Allreduce on a list of tensors, which are negotiated as a single
+group and fused together. All other processes that do a grouped reduction with
+the same node name must pass the same number of tensors, with the same
+dimensions.
+
+Arguments
+    tensors:    Tensors to reduce.
 
 Output
-    sum:    A tensor with the same shape as `tensor`, summed across all MPI processes.
+    sums:    Tensors with the same shapes as `tensors`, summed across all MPI
+             processes.
 )doc");
 
 class HorovodAllgatherOp : public AsyncOpKernel {
@@ -368,7 +512,8 @@ REGISTER_KERNEL_BUILDER(Name("HorovodAllgather").Device(DEVICE_GPU),
 
 REGISTER_OP("HorovodAllgather")
     .Attr(
-        "T: {uint8, int8, uint16, int16, int32, int64, float16, float32, float64, bool}")
+        "T: {uint8, int8, uint16, int16, int32, int64, float16, bfloat16, "
+        "float32, float64, bool}")
     .Input("tensor: T")
     .Output("output: T")
     .SetShapeFn([](shape_inference::InferenceContext* c) {
@@ -441,7 +586,8 @@ REGISTER_KERNEL_BUILDER(Name("HorovodBroadcast").Device(DEVICE_GPU),
 
 REGISTER_OP("HorovodBroadcast")
     .Attr(
-        "T: {uint8, int8, uint16, int16, int32, int64, float16, float32, float64, bool}")
+        "T: {uint8, int8, uint16, int16, int32, int64, float16, bfloat16, "
+        "float32, float64, bool}")
     .Attr("root_rank: int")
     .Input("tensor: T")
     .Output("output: T")
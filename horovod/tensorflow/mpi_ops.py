@@ -26,6 +26,7 @@ from tensorflow.python.framework import ops
 from tensorflow.python.platform import resource_loader
 
 from horovod.common.util import get_ext_suffix
+from horovod.common.util import REDUCE_OP_SUM, REDUCE_OP_ADASUM
 from horovod.common.basics import HorovodBasics as _HorovodBasics
 from horovod.tensorflow.util import _executing_eagerly
 
@@ -51,6 +52,7 @@ _basics = _HorovodBasics(__file__, 'mpi_lib')
 # import basic methods
 init = _basics.init
 shutdown = _basics.shutdown
+reset = _basics.reset
 size = _basics.size
 local_size = _basics.local_size
 rank = _basics.rank
@@ -63,6 +65,11 @@ gloo_built = _basics.gloo_built
 nccl_built = _basics.nccl_built
 ddl_built = _basics.ddl_built
 mlsl_built = _basics.mlsl_built
+metrics = _basics.metrics
+stats = _basics.stats
+set_parameters = _basics.set_parameters
+start_timeline = _basics.start_timeline
+stop_timeline = _basics.stop_timeline
 
 
 def _normalize_name(name):
@@ -70,20 +77,21 @@ def _normalize_name(name):
     return re.sub('[^a-zA-Z0-9_]', '_', name)
 
 
-def _allreduce(tensor, name=None):
-    """An op which sums an input tensor over all the Horovod processes.
+def _allreduce(tensor, name=None, reduce_op=REDUCE_OP_SUM):
+    """An op which sums an input tensor over all the Horovod processes, or
+    combines it with the given core reduction.
 
     The reduction operation is keyed by the name of the op. The tensor type and
     shape must be the same on all Horovod processes for a given name. The reduction
     will not start until all processes are ready to send and receive the tensor.
 
     Returns:
-      A tensor of the same shape and type as `tensor`, summed across all
+      A tensor of the same shape and type as `tensor`, reduced across all
       processes.
     """
     if name is None and not _executing_eagerly():
         name = 'HorovodAllreduce_%s' % _normalize_name(tensor.name)
-    return MPI_LIB.horovod_allreduce(tensor, name=name)
+    return MPI_LIB.horovod_allreduce(tensor, name=name, reduce_op=reduce_op)
 
 
 @ops.RegisterGradient('HorovodAllreduce')
@@ -97,7 +105,42 @@ def _allreduce_grad(op, grad):
     Returns:
       The gradient with respect to the input of the op.
     """
-    return _allreduce(grad)
+    reduce_op = op.get_attr('reduce_op')
+    if reduce_op not in (REDUCE_OP_SUM, REDUCE_OP_ADASUM):
+        raise NotImplementedError(
+            'The gradient of a min, max or product allreduce is not implemented.')
+    return _allreduce(grad, reduce_op=reduce_op)
+
+
+def _grouped_allreduce(tensors, name=None):
+    """An op which sums a list of input tensors over all the Horovod processes.
+
+    The tensors are negotiated as a single group, keyed by the name of the op,
+    and are fused together. The tensor types must be the same, and the number
+    of tensors and their shapes must be the same on all Horovod processes for a
+    given name.
+
+    Returns:
+      A list of tensors of the same shapes and type as `tensors`, summed across
+      all processes.
+    """
+    if name is None and not _executing_eagerly():
+        name = 'HorovodGroupedAllreduce_%s' % _normalize_name(tensors[0].name)
+    return MPI_LIB.horovod_grouped_allreduce(tensors, name=name)
+
+
+@ops.RegisterGradient('HorovodGroupedAllreduce')
+def _grouped_allreduce_grad(op, *grads):
+    """Gradient for grouped allreduce op.
+
+    Args:
+      op: An operation.
+      grads: `Tensor` gradients with respect to the outputs of the op.
+
+    Returns:
+      The gradients with respect to the inputs of the op.
+    """
+    return _grouped_allreduce(list(grads))
 
 
 def allgather(tensor, name=None):
@@ -0,0 +1,398 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#if HAVE_CUDA && HAVE_XLA_OPS
+
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <cuda_runtime.h>
+
+#include "tensorflow/compiler/tf2xla/shape_util.h"
+#include "tensorflow/compiler/tf2xla/xla_op_kernel.h"
+#include "tensorflow/compiler/tf2xla/xla_op_registry.h"
+#include "tensorflow/compiler/xla/client/xla_builder.h"
+#include "tensorflow/compiler/xla/service/custom_call_target_registry.h"
+
+#define OMPI_SKIP_MPICXX
+#include "../common/operations.h"
+
+using namespace tensorflow;
+
+namespace horovod {
+namespace tensorflow {
+
+namespace {
+
+// Tensor of an allreduce, serialized into the opaque string of its custom
+// calls, which is all they get at run time besides the buffers.
+struct CustomCallConfig {
+  std::string tensor_name;
+  common::DataType tensor_type;
+  std::vector<int64_t> tensor_shape;
+  common::ReduceOp reduce_op = common::ReduceOp::SUM;
+
+  std::string Serialize() const {
+    std::string opaque;
+    int32_t type = tensor_type;
+    int32_t op = (int32_t)reduce_op;
+    int32_t dims = (int32_t)tensor_shape.size();
+    opaque.append(reinterpret_cast<const char*>(&type), sizeof(type));
+    opaque.append(reinterpret_cast<const char*>(&op), sizeof(op));
+    opaque.append(reinterpret_cast<const char*>(&dims), sizeof(dims));
+    opaque.append(reinterpret_cast<const char*>(tensor_shape.data()),
+                  tensor_shape.size() * sizeof(int64_t));
+    opaque.append(tensor_name);
+    return opaque;
+  }
+
+  static CustomCallConfig Deserialize(const char* opaque, size_t opaque_len) {
+    CustomCallConfig config;
+    int32_t type;
+    int32_t op;
+    int32_t dims;
+    std::memcpy(&type, opaque, sizeof(type));
+    std::memcpy(&op, opaque + sizeof(type), sizeof(op));
+    std::memcpy(&dims, opaque + sizeof(type) + sizeof(op), sizeof(dims));
+    auto offset = sizeof(type) + sizeof(op) + sizeof(dims);
+    config.tensor_type = (common::DataType)type;
+    config.reduce_op = (common::ReduceOp)op;
+    config.tensor_shape.resize(dims);
+    std::memcpy(config.tensor_shape.data(), opaque + offset,
+                dims * sizeof(int64_t));
+    offset += dims * sizeof(int64_t);
+    config.tensor_name.assign(opaque + offset, opaque_len - offset);
+    return config;
+  }
+};
+
+bool GetHVDType(DataType type, common::DataType* hvd_type) {
+  switch (type) {
+  case DT_INT32:
+    *hvd_type = common::HOROVOD_INT32;
+    return true;
+  case DT_INT64:
+    *hvd_type = common::HOROVOD_INT64;
+    return true;
+  case DT_HALF:
+    *hvd_type = common::HOROVOD_FLOAT16;
+    return true;
+  case DT_BFLOAT16:
+    *hvd_type = common::HOROVOD_BFLOAT16;
+    return true;
+  case DT_FLOAT:
+    *hvd_type = common::HOROVOD_FLOAT32;
+    return true;
+  case DT_DOUBLE:
+    *hvd_type = common::HOROVOD_FLOAT64;
+    return true;
+  default:
+    return false;
+  }
+}
+
+int64_t ElementSize(common::DataType type) {
+  switch (type) {
+  case common::HOROVOD_FLOAT16:
+  case common::HOROVOD_BFLOAT16:
+    return 2;
+  case common::HOROVOD_INT32:
+  case common::HOROVOD_FLOAT32:
+    return 4;
+  default:
+    return 8;
+  }
+}
+
+// Recorded on the XLA stream when the allreduce is enqueued, so that the
+// collective stream waits for the inputs without blocking the host.
+class XLAReadyEvent : public common::ReadyEvent {
+public:
+  explicit XLAReadyEvent(cudaStream_t stream) {
+    cudaEventCreateWithFlags(&event_, cudaEventDisableTiming);
+    cudaEventRecord(event_, stream);
+  }
+  ~XLAReadyEvent() override { cudaEventDestroy(event_); }
+
+  bool Ready() const override {
+    return cudaEventQuery(event_) != cudaErrorNotReady;
+  }
+
+  cudaEvent_t CudaEvent() const override { return event_; }
+
+private:
+  cudaEvent_t event_;
+};
+
+// XLA buffers are plain device memory owned by the compiled program.
+class XLATensor : public common::Tensor {
+public:
+  XLATensor(const CustomCallConfig& config, void* data)
+      : config_(config), data_(data) {}
+
+  const common::DataType dtype() const override {
+    return config_.tensor_type;
+  }
+
+  const common::TensorShape shape() const override {
+    common::TensorShape shape;
+    for (auto dim : config_.tensor_shape) {
+      shape.AddDim(dim);
+    }
+    return shape;
+  }
+
+  const void* data() const override { return data_; }
+
+  int64_t size() const override {
+    return shape().num_elements() * ElementSize(config_.tensor_type);
+  }
+
+private:
+  const CustomCallConfig& config_;
+  void* data_;
+};
+
+class XLAPersistentBuffer : public common::PersistentBuffer {
+public:
+  XLAPersistentBuffer(int device, int64_t size) {
+    int restore_device;
+    cudaGetDevice(&restore_device);
+    cudaSetDevice(device);
+    status_ = cudaMalloc(&buffer_, size);
+    cudaSetDevice(restore_device);
+  }
+
+  ~XLAPersistentBuffer() override {
+    if (status_ == cudaSuccess) {
+      cudaFree(buffer_);
+    }
+  }
+
+  cudaError_t status() const { return status_; }
+
+  const void*
+  AccessData(std::shared_ptr<common::OpContext> context) const override {
+    return buffer_;
+  }
+
+private:
+  void* buffer_ = nullptr;
+  cudaError_t status_;
+};
+
+class XLAOpContext : public common::OpContext {
+public:
+  explicit XLAOpContext(int device) : device_(device) {}
+
+  common::Status AllocatePersistent(
+      int64_t size,
+      std::shared_ptr<common::PersistentBuffer>* tensor) override {
+    auto buffer = std::make_shared<XLAPersistentBuffer>(device_, size);
+    if (buffer->status() != cudaSuccess) {
+      return common::Status::UnknownError(
+          std::string("Unable to allocate the fusion buffer: ") +
+          cudaGetErrorString(buffer->status()));
+    }
+    *tensor = buffer;
+    return common::Status::OK();
+  }
+
+  common::Status
+  AllocateOutput(common::TensorShape shape,
+                 std::shared_ptr<common::Tensor>* tensor) override {
+    return common::Status::PreconditionError(
+        "XLA operations have static output shapes.");
+  }
+
+  common::Framework framework() const override {
+    return common::Framework::XLA;
+  }
+
+private:
+  int device_;
+};
+
+// Statuses of the allreduces enqueued by custom calls, which their done
+// custom calls wait for.
+class XLAOpCompletions {
+public:
+  void Register(const std::string& name) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    pending_[name] = Completion();
+  }
+
+  void Done(const std::string& name, const common::Status& status) {
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      auto& completion = pending_[name];
+      completion.done = true;
+      completion.status = status;
+    }
+    cond_.notify_all();
+  }
+
+  common::Status Wait(const std::string& name) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this, &name]() {
+      auto it = pending_.find(name);
+      return it == pending_.end() || it->second.done;
+    });
+    auto it = pending_.find(name);
+    if (it == pending_.end()) {
+      return common::Status::PreconditionError(
+          "Allreduce " + name + " was not enqueued.");
+    }
+    auto status = it->second.status;
+    pending_.erase(it);
+    return status;
+  }
+
+private:
+  struct Completion {
+    bool done = false;
+    common::Status status;
+  };
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::unordered_map<std::string, Completion> pending_;
+};
+
+XLAOpCompletions xla_op_completions;
+
+int GetBufferDevice(const void* buffer) {
+  cudaPointerAttributes attributes;
+  if (cudaPointerGetAttributes(&attributes, buffer) != cudaSuccess) {
+    int device;
+    cudaGetDevice(&device);
+    return device;
+  }
+  return attributes.device;
+}
+
+// Lowers HorovodAllreduce to a custom call that enqueues the allreduce and a
+// second one, aliasing its operand, that blocks until it is done. Both have
+// side effects, so that XLA neither removes nor reorders them, and the
+// training step stays in one compiled cluster.
+class HVDAllreduceOp : public XlaOpKernel {
+public:
+  explicit HVDAllreduceOp(OpKernelConstruction* context)
+      : XlaOpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("reduce_op", &reduce_op_));
+  }
+
+  void Compile(XlaOpKernelContext* ctx) override {
+    CustomCallConfig config;
+    config.tensor_name = name();
+    config.reduce_op = static_cast<common::ReduceOp>(reduce_op_);
+    OP_REQUIRES(ctx, GetHVDType(ctx->input_type(0), &config.tensor_type),
+                errors::InvalidArgument("Unsupported allreduce type ",
+                                        DataTypeString(ctx->input_type(0))));
+    auto shape = ctx->InputShape(0);
+    for (auto dim : shape.dim_sizes()) {
+      config.tensor_shape.push_back(dim);
+    }
+    ::xla::Shape output_shape;
+    OP_REQUIRES_OK(ctx, TensorShapeToXLAShape(ctx->input_type(0), shape,
+                                              &output_shape));
+
+    auto opaque = config.Serialize();
+    auto result = ::xla::CustomCall(ctx->builder(), "CallbackHVDAllreduce",
+                                    {ctx->Input(0)}, output_shape, opaque,
+                                    /*has_side_effect=*/true);
+    auto done = ::xla::CustomCall(
+        ctx->builder(), "CallbackHVDAllreduceDone", {result}, output_shape,
+        opaque, /*has_side_effect=*/true,
+        /*output_operand_aliasing=*/{{::xla::ShapeIndex{},
+                                      {0, ::xla::ShapeIndex{}}}});
+    ctx->SetOutput(0, done);
+  }
+
+private:
+  int reduce_op_;
+};
+
+void CallbackHVDAllreduce(cudaStream_t stream, void** buffers,
+                          const char* opaque, size_t opaque_len) {
+  auto config = std::make_shared<CustomCallConfig>(
+      CustomCallConfig::Deserialize(opaque, opaque_len));
+  auto name = config->tensor_name;
+  xla_op_completions.Register(name);
+
+  auto status = common::CheckInitialized();
+  if (status.ok()) {
+    auto device = GetBufferDevice(buffers[0]);
+    auto hvd_context = std::make_shared<XLAOpContext>(device);
+    auto hvd_tensor = std::make_shared<XLATensor>(*config, buffers[0]);
+    auto hvd_output = std::make_shared<XLATensor>(*config, buffers[1]);
+    auto ready_event = std::make_shared<XLAReadyEvent>(stream);
+    status = EnqueueTensorAllreduce(
+        hvd_context, hvd_tensor, hvd_output, ready_event, name, device,
+        // Keeps the config alive while the tensors refer to it.
+        [config, name](const common::Status& status) {
+          xla_op_completions.Done(name, status);
+        }, /*priority=*/0, /*prescale_factor=*/1.0, /*postscale_factor=*/1.0,
+        config->reduce_op);
+  }
+  if (!status.ok()) {
+    xla_op_completions.Done(name, status);
+  }
+}
+
+void CallbackHVDAllreduceDone(cudaStream_t stream, void** buffers,
+                              const char* opaque, size_t opaque_len) {
+  auto config = CustomCallConfig::Deserialize(opaque, opaque_len);
+  auto status = xla_op_completions.Wait(config.tensor_name);
+  // Legacy custom calls cannot report errors to the XLA runtime.
+  if (!status.ok()) {
+    LOG(FATAL) << "Horovod allreduce " << config.tensor_name
+               << " failed: " << status.reason();
+  }
+}
+
+// Registering an XLA kernel makes XLA cluster the op instead of breaking the
+// cluster around it, so it is only done when asked for.
+bool RegisterXlaOps() {
+  const char* enable = std::getenv(HOROVOD_ENABLE_XLA_OPS);
+  if (enable == nullptr || std::strtol(enable, nullptr, 10) <= 0) {
+    return false;
+  }
+  static XlaOpRegistrar allreduce_registrar(
+      XlaOpRegistrationBuilder::Name("HorovodAllreduce")
+          .Device(DEVICE_GPU_XLA_JIT)
+          .Build([](OpKernelConstruction* context) -> OpKernel* {
+            return new HVDAllreduceOp(context);
+          }));
+  return true;
+}
+
+bool xla_ops_registered = RegisterXlaOps();
+
+} // namespace
+
+XLA_REGISTER_CUSTOM_CALL_TARGET(CallbackHVDAllreduce, "CUDA");
+XLA_REGISTER_CUSTOM_CALL_TARGET(CallbackHVDAllreduceDone, "CUDA");
+
+} // namespace tensorflow
+} // namespace horovod
+
+#endif // HAVE_CUDA && HAVE_XLA_OPS
@@ -29,16 +29,30 @@ except:
     check_extension('horovod.torch', 'HOROVOD_WITH_PYTORCH',
                     __file__, 'mpi_lib', '_mpi_lib')
 
+from horovod.common.util import get_reduce_op as _reduce_op
 from horovod.torch.compression import Compression
 from horovod.torch.mpi_ops import allreduce, allreduce_async, allreduce_, allreduce_async_
+from horovod.torch.mpi_ops import grouped_allreduce, grouped_allreduce_async, \
+    grouped_allreduce_, grouped_allreduce_async_
+from horovod.torch.mpi_ops import capturable_allreduce_
+from horovod.torch.mpi_ops import Average, Sum, Adasum, Min, Max, Product
+from horovod.torch.mpi_ops import Int8, Int4
 from horovod.torch.mpi_ops import allgather, allgather_async
+from horovod.torch.mpi_ops import reducescatter, reducescatter_async
+from horovod.torch.mpi_ops import alltoall, alltoall_async
 from horovod.torch.mpi_ops import broadcast, broadcast_async, broadcast_, broadcast_async_
-from horovod.torch.mpi_ops import poll, synchronize
-from horovod.torch.mpi_ops import init, shutdown
+from horovod.torch.mpi_ops import poll, synchronize, synchronize_all, wait_any
+from horovod.torch.mpi_ops import join
+from horovod.torch.mpi_ops import init, shutdown, reset
 from horovod.torch.mpi_ops import size, local_size, rank, local_rank
 from horovod.torch.mpi_ops import mpi_threads_supported, mpi_enabled, mpi_built
 from horovod.torch.mpi_ops import gloo_enabled, gloo_built
 from horovod.torch.mpi_ops import nccl_built, ddl_built, mlsl_built
+from horovod.torch.mpi_ops import metrics
+from horovod.torch.mpi_ops import mpi_lib as _mpi_lib
+from horovod.torch.mpi_ops import stats
+from horovod.torch.mpi_ops import set_parameters
+from horovod.torch.mpi_ops import start_timeline, stop_timeline
 
 import torch
 import collections
@@ -46,9 +60,11 @@ import collections
 
 class _DistributedOptimizer(torch.optim.Optimizer):
     def __init__(self, params, named_parameters, compression,
-                 backward_passes_per_step=1):
+                 backward_passes_per_step=1, num_groups=0, op=Average):
         super(self.__class__, self).__init__(params)
         self._compression = compression
+        self._op = op
+        self._num_groups = num_groups
 
         if named_parameters is not None:
             named_parameters = list(named_parameters)
@@ -79,11 +95,23 @@ class _DistributedOptimizer(torch.optim.Optimizer):
                              '%s' % ', '.join(str(id) for id in unnamed_param_ids))
 
         self._parameter_names = {v: k for k, v in sorted(named_parameters)}
+        # Gradients of the first layers are computed last in the backward
+        # pass but needed first in the next forward pass, so reduce them
+        # ahead of anything else that is ready at the same time.
+        all_params = [v for param_group in self.param_groups
+                      for v in param_group['params']]
+        self._priorities = {v: len(all_params) - i
+                            for i, v in enumerate(all_params)}
         self.backward_passes_per_step = backward_passes_per_step
         self._allreduce_delay = {v: self.backward_passes_per_step
                                  for _, v in sorted(named_parameters)}
         self._handles = {}
+        self._groups = {}
+        self._group_ready = {}
+        if num_groups > 0:
+            self._make_groups(all_params)
         self._grad_accs = []
+        self._reducer = None
         self._requires_update = set()
         self._synchronized = False
         self._should_synchronize = True
@@ -104,6 +132,27 @@ class _DistributedOptimizer(torch.optim.Optimizer):
         self.backward_passes_per_step = passes
         for p in self._allreduce_delay:
             self._allreduce_delay[p] = self.backward_passes_per_step
+        if self._reducer is not None:
+            self._reducer.set_backward_passes_per_step(passes)
+
+    def _make_groups(self, all_params):
+        # Split the parameters in order into num_groups groups of consecutive
+        # parameters, which are further split by dtype and device since a
+        # group is reduced as one fused buffer. Each group is negotiated as a
+        # single request once all of its gradients are ready.
+        params = [p for p in all_params if p.requires_grad]
+        group_size = (len(params) + self._num_groups - 1) // self._num_groups
+        index = 0
+        for i in range(0, len(params), max(group_size, 1)):
+            split = collections.OrderedDict()
+            for p in params[i:i + group_size]:
+                split.setdefault((p.dtype, p.device), []).append(p)
+            for group in split.values():
+                group = tuple(group)
+                for p in group:
+                    self._groups[p] = (index, group)
+                self._group_ready[group] = set()
+                index += 1
 
     def _register_hooks(self):
         for param_group in self.param_groups:
@@ -111,19 +160,67 @@ class _DistributedOptimizer(torch.optim.Optimizer):
                 if p.requires_grad:
                     p.grad = p.data.new(p.size()).zero_()
                     self._requires_update.add(p)
+        if self._compression is Compression.none and hasattr(_mpi_lib, 'Reducer'):
+            self._register_reducer()
+            return
+        for param_group in self.param_groups:
+            for p in param_group['params']:
+                if p.requires_grad:
                     p_tmp = p.expand_as(p)
                     grad_acc = p_tmp.grad_fn.next_functions[0][0]
                     grad_acc.register_hook(self._make_hook(p))
                     self._grad_accs.append(grad_acc)
 
+    def _register_reducer(self):
+        # Without compression, the gradients are reduced from autograd hooks
+        # registered in C++, one grouped allreduce per bucket, so that the
+        # backward pass does not take the GIL for each parameter. The buckets
+        # are the groups of num_groups, or single parameters.
+        params = [p for param_group in self.param_groups
+                  for p in param_group['params'] if p.requires_grad]
+        index = {p: i for i, p in enumerate(params)}
+        buckets, names, priorities = [], [], []
+        for p in params:
+            if p in self._groups:
+                group_index, group = self._groups[p]
+                if p is not group[0]:
+                    continue
+                buckets.append([index[q] for q in group])
+                names.append('allreduce.group.%d' % group_index)
+                priorities.append(max(self._priorities.get(q, 0) for q in group))
+            else:
+                buckets.append([index[p]])
+                names.append(self._parameter_names.get(p))
+                priorities.append(self._priorities.get(p, 0))
+        average, reduce_op = _reduce_op(None, self._op)
+        self._reducer = _mpi_lib.Reducer(params, buckets, names, priorities,
+                                         int(bool(average)), reduce_op,
+                                         self.backward_passes_per_step)
+
     def _allreduce_grad_async(self, p):
         name = self._parameter_names.get(p)
         tensor = p.grad
         tensor_compressed, ctx = self._compression.compress(tensor)
 
-        handle = allreduce_async_(tensor_compressed, average=True, name=name)
+        handle = allreduce_async_(tensor_compressed, name=name,
+                                  priority=self._priorities.get(p, 0),
+                                  op=self._op,
+                                  quantization=getattr(self._compression,
+                                                       'quantization', None))
         return handle, ctx
 
+    def _grouped_allreduce_grad_async(self, index, group):
+        tensors_compressed, ctxs = zip(*[self._compression.compress(p.grad)
+                                         for p in group])
+        handles = grouped_allreduce_async_(
+            list(tensors_compressed),
+            name='allreduce.group.%d' % index,
+            priority=max(self._priorities.get(p, 0) for p in group),
+            op=self._op,
+            quantization=getattr(self._compression, 'quantization', None))
+        for p, handle, ctx in zip(group, handles, ctxs):
+            self._handles[p] = (handle, ctx)
+
     def _make_hook(self, p):
         def hook(*ignore):
             if p in self._handles and self._handles[p][0] is not None:
@@ -137,27 +234,51 @@ class _DistributedOptimizer(torch.optim.Optimizer):
             assert self._allreduce_delay[p] > 0
             handle, ctx = None, None
             self._allreduce_delay[p] -= 1
-            if self._allreduce_delay[p] == 0:
+            if self._allreduce_delay[p] == 0 and p not in self._groups:
                 handle, ctx = self._allreduce_grad_async(p)
             self._handles[p] = (handle, ctx)
+            if self._allreduce_delay[p] == 0 and p in self._groups:
+                index, group = self._groups[p]
+                ready = self._group_ready[group]
+                ready.add(p)
+                if len(ready) == len(group):
+                    self._grouped_allreduce_grad_async(index, group)
         return hook
 
     def synchronize(self):
+        if self._reducer is not None:
+            self._reducer.synchronize()
+            self._synchronized = True
+            return
+
         missing_p = self._requires_update - set(self._handles.keys())
         for p in missing_p:
+            if p in self._groups:
+                self._handles[p] = (None, None)
+                continue
             handle, ctx = self._allreduce_grad_async(p)
             self._handles[p] = (handle, ctx)
 
-        for p, value in self._handles.items():
-            handle, ctx = value
-            if handle is None:
+        for p in list(self._handles.keys()):
+            handle, ctx = self._handles[p]
+            if handle is not None:
+                continue
+            if p in self._groups:
+                # Groups whose gradients were not all computed are submitted
+                # whole, the handles of all their parameters are set at once.
+                self._grouped_allreduce_grad_async(*self._groups[p])
+            else:
                 handle, ctx = self._allreduce_grad_async(p)
                 self._handles[p] = (handle, ctx)
-        for p, (handle, _) in self._handles.items():
-            output = synchronize(handle)
+        params = list(self._handles.keys())
+        outputs = synchronize_all([self._handles[p][0] for p in params])
+        for p, output in zip(params, outputs):
+            _, ctx = self._handles[p]
             self._allreduce_delay[p] = self.backward_passes_per_step
             p.grad.set_(self._compression.decompress(output, ctx))
         self._handles.clear()
+        for ready in self._group_ready.values():
+            ready.clear()
 
         self._synchronized = True
 
@@ -195,7 +316,7 @@ class _DistributedOptimizer(torch.optim.Optimizer):
         return super(self.__class__, self).step(closure)
 
     def zero_grad(self):
-        if self._handles:
+        if self._handles or (self._reducer is not None and self._reducer.pending()):
             raise AssertionError("optimizer.zero_grad() was called after loss.backward() "
                                  "but before optimizer.step() or optimizer.synchronize(). "
                                  "This is prohibited as it can cause a race condition.")
@@ -204,7 +325,8 @@ class _DistributedOptimizer(torch.optim.Optimizer):
 
 def DistributedOptimizer(optimizer, named_parameters=None,
                          compression=Compression.none,
-                         backward_passes_per_step=1):
+                         backward_passes_per_step=1,
+                         num_groups=0, op=Average):
     """
     An optimizer that wraps another torch.optim.Optimizer, using an allreduce to
     average gradient values before applying gradients to model weights.
@@ -237,19 +359,30 @@ def DistributedOptimizer(optimizer, named_parameters=None,
                           allreduce operations. Typically just ``model.named_parameters()``.
         compression: Compression algorithm used during allreduce to reduce the amount
                      of data sent during the each parameter update step.  Defaults to
-                     not using compression.
+                     not using compression. `Compression.int8` and `Compression.int4`
+                     quantize float32 gradients reduced on the CPU inside Horovod.
         backward_passes_per_step: Number of expected backward passes to perform
                                   before calling step()/synchronize(). This
                                   allows accumulating gradients over multiple
                                   mini-batches before executing averaging and
                                   applying them.
+        num_groups: If positive, split the parameters in order into this
+                    many groups, further split by dtype and device. The
+                    gradients of a group are allreduced as one negotiation
+                    unit once they are all computed, and are always fused
+                    together. Defaults to 0, which allreduces each gradient
+                    as soon as it is computed.
+        op: The reduction of the gradients, ``hvd.Average`` by default.
+            ``hvd.Adasum`` combines them with adaptive summation, which keeps
+            the update from growing with the number of processes and usually
+            allows the learning rate of a single process to be kept.
     """
     # We dynamically create a new class that inherits from the optimizer that was passed in.
     # The goal is to override the `step()` method with an allreduce implementation.
     cls = type(optimizer.__class__.__name__, (optimizer.__class__,),
                dict(_DistributedOptimizer.__dict__))
     return cls(optimizer.param_groups, named_parameters,
-               compression, backward_passes_per_step)
+               compression, backward_passes_per_step, num_groups, op)
 
 
 def broadcast_parameters(params, root_rank):
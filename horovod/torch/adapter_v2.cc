@@ -13,6 +13,10 @@
 // limitations under the License.
 // =============================================================================
 
+#if HAVE_CUDA
+#include "cuda_runtime.h"
+#endif
+
 #include "adapter_v2.h"
 #include "cuda_util.h"
 
@@ -54,6 +58,10 @@ const DataType TorchTensor::dtype() const {
     return common::HOROVOD_FLOAT32;
   case ::torch::kDouble:
     return common::HOROVOD_FLOAT64;
+#if TORCH_VERSION >= 1003000000
+  case ::torch::kBFloat16:
+    return common::HOROVOD_BFLOAT16;
+#endif
   default:
     throw std::logic_error("Invalid tensor type.");
   }
@@ -101,6 +109,58 @@ Status TorchOpContext::AllocateOutput(TensorShape shape,
   return Status::OK();
 }
 
+Status TorchOpContext::AllocateZeros(int64_t num_elements, DataType dtype,
+                                     std::shared_ptr<Tensor>* tensor) {
+  ::torch::ScalarType scalar_type;
+  switch (dtype) {
+  case common::HOROVOD_UINT8:
+    scalar_type = ::torch::kByte;
+    break;
+  case common::HOROVOD_INT8:
+    scalar_type = ::torch::kChar;
+    break;
+  case common::HOROVOD_INT16:
+    scalar_type = ::torch::kShort;
+    break;
+  case common::HOROVOD_INT32:
+    scalar_type = ::torch::kInt;
+    break;
+  case common::HOROVOD_INT64:
+    scalar_type = ::torch::kLong;
+    break;
+  case common::HOROVOD_FLOAT16:
+    scalar_type = ::torch::kHalf;
+    break;
+  case common::HOROVOD_FLOAT32:
+    scalar_type = ::torch::kFloat;
+    break;
+  case common::HOROVOD_FLOAT64:
+    scalar_type = ::torch::kDouble;
+    break;
+#if TORCH_VERSION >= 1003000000
+  case common::HOROVOD_BFLOAT16:
+    scalar_type = ::torch::kBFloat16;
+    break;
+#endif
+  default:
+    return Status::InvalidArgument("Type " + DataType_Name(dtype) +
+                                   " is not supported by PyTorch.");
+  }
+  with_device device_context(device_);
+  auto device = device_ == CPU_DEVICE_ID ? ::torch::kCPU : ::torch::kCUDA;
+  auto zeros = ::torch::zeros(num_elements,
+                              ::torch::device(device).dtype(scalar_type));
+#if HAVE_CUDA
+  // The zeros are written on the default stream, which the collective does
+  // not wait for.
+  if (device_ != CPU_DEVICE_ID) {
+    cudaDeviceSynchronize();
+  }
+#endif
+  *tensor = std::make_shared<TorchTensor>(zeros);
+  return Status::OK();
+}
+
 Framework TorchOpContext::framework() const {
   return Framework::PYTORCH;
 }
@@ -16,6 +16,8 @@
 
 import torch
 
+from horovod.common.util import Int8, Int4
+
 
 class Compressor(object):
     """Interface for compressing and decompressing a given tensor."""
@@ -64,6 +66,16 @@ class FP16Compressor(Compressor):
         return tensor_decompressed
 
 
+class Int8Compressor(NoneCompressor):
+    """Quantize float32 gradients in host memory to 8 bits inside allreduce."""
+    quantization = Int8
+
+
+class Int4Compressor(NoneCompressor):
+    """Quantize float32 gradients in host memory to 4 bits inside allreduce."""
+    quantization = Int4
+
+
 class Compression(object):
     """Optional gradient compression algorithm used during allreduce."""
 
@@ -72,3 +84,11 @@ class Compression(object):
 
     """Compress all floating point gradients to 16-bit."""
     fp16 = FP16Compressor
+
+    """Quantize float32 gradients to 8-bit integers with stochastic rounding and
+    error feedback while they are reduced on the CPU."""
+    int8 = Int8Compressor
+
+    """Quantize float32 gradients to 4-bit integers with stochastic rounding and
+    error feedback while they are reduced on the CPU."""
+    int4 = Int4Compressor
@@ -15,40 +15,257 @@
 
 #include "handle_manager.h"
 
+#include <stdexcept>
+#include <string>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 namespace horovod {
 namespace torch {
 
+namespace {
+
+// Handles are positive ints holding the generation of the slot above the
+// slot index.
+constexpr uint32_t INDEX_BITS = 20;
+constexpr uint32_t CHUNK_BITS = 12;
+constexpr uint32_t CHUNK_SIZE = 1u << CHUNK_BITS;
+constexpr uint32_t MAX_CHUNKS = 1u << (INDEX_BITS - CHUNK_BITS);
+constexpr uint32_t MAX_GENERATION = (1u << (31 - INDEX_BITS)) - 1;
+
+constexpr uint32_t STATE_DONE = 1;
+constexpr uint32_t STATE_WAITER = 2;
+constexpr uint32_t STATE_ALLOCATED = 4;
+constexpr uint32_t GENERATION_SHIFT = 3;
+
+uint32_t Generation(uint32_t state) { return state >> GENERATION_SHIFT; }
+
+std::invalid_argument InvalidHandle(int handle) {
+  return std::invalid_argument("Handle " + std::to_string(handle) +
+                               " was not created or has been cleared.");
+}
+
+} // namespace
+
+HandleManager::HandleManager()
+    : chunks_(new std::atomic<Slot*>[MAX_CHUNKS]), num_chunks_(0),
+      free_head_(0), completions_(0), any_waiters_(0) {
+  for (uint32_t i = 0; i < MAX_CHUNKS; ++i) {
+    chunks_[i].store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+HandleManager::~HandleManager() {
+  for (uint32_t i = 0; i < num_chunks_.load(); ++i) {
+    delete[] chunks_[i].load();
+  }
+  delete[] chunks_;
+}
+
+uint32_t HandleManager::PopFreeSlot() {
+  auto head = free_head_.load(std::memory_order_acquire);
+  while (true) {
+    auto first = static_cast<uint32_t>(head);
+    if (first == 0) {
+      break;
+    }
+    auto& slot = chunks_[(first - 1) >> CHUNK_BITS].load(
+        std::memory_order_acquire)[(first - 1) & (CHUNK_SIZE - 1)];
+    auto next = slot.next_free.load(std::memory_order_relaxed);
+    auto tag = (head >> 32) + 1;
+    if (free_head_.compare_exchange_weak(head, (tag << 32) | next,
+                                         std::memory_order_acq_rel)) {
+      return first - 1;
+    }
+  }
+
+  // The free list is empty, add a chunk of slots. Concurrent allocations keep
+  // popping slots released in the meantime.
+  std::lock_guard<std::mutex> guard(grow_mutex_);
+  auto chunk = num_chunks_.load(std::memory_order_relaxed);
+  if (chunk == MAX_CHUNKS) {
+    throw std::runtime_error(
+        "Too many asynchronous operations in flight, at most " +
+        std::to_string(MAX_CHUNKS * CHUNK_SIZE) +
+        " handles can be awaited at the same time.");
+  }
+  auto slots = new Slot[CHUNK_SIZE];
+  for (uint32_t i = 0; i < CHUNK_SIZE; ++i) {
+    slots[i].state.store(1u << GENERATION_SHIFT, std::memory_order_relaxed);
+    slots[i].next_free.store(chunk * CHUNK_SIZE + i + 2,
+                             std::memory_order_relaxed);
+  }
+  chunks_[chunk].store(slots, std::memory_order_release);
+  num_chunks_.store(chunk + 1, std::memory_order_release);
+  // Keep the first slot of the chunk and free the others.
+  PushFreeSlots(chunk * CHUNK_SIZE + 1, (chunk + 1) * CHUNK_SIZE - 1);
+  return chunk * CHUNK_SIZE;
+}
+
+void HandleManager::PushFreeSlots(uint32_t first, uint32_t last) {
+  auto& last_slot = chunks_[last >> CHUNK_BITS].load(
+      std::memory_order_acquire)[last & (CHUNK_SIZE - 1)];
+  auto head = free_head_.load(std::memory_order_relaxed);
+  while (true) {
+    last_slot.next_free.store(static_cast<uint32_t>(head),
+                              std::memory_order_relaxed);
+    auto tag = (head >> 32) + 1;
+    if (free_head_.compare_exchange_weak(head, (tag << 32) | (first + 1),
+                                         std::memory_order_acq_rel)) {
+      return;
+    }
+  }
+}
+
+HandleManager::Slot& HandleManager::CheckHandle(int handle, uint32_t& state) {
+  if (handle <= 0) {
+    throw InvalidHandle(handle);
+  }
+  auto index = static_cast<uint32_t>(handle) & ((1u << INDEX_BITS) - 1);
+  auto generation = static_cast<uint32_t>(handle) >> INDEX_BITS;
+  auto chunk = chunks_[index >> CHUNK_BITS].load(std::memory_order_acquire);
+  if (chunk == nullptr) {
+    throw InvalidHandle(handle);
+  }
+  auto& slot = chunk[index & (CHUNK_SIZE - 1)];
+  state = slot.state.load(std::memory_order_acquire);
+  if (Generation(state) != generation || !(state & STATE_ALLOCATED)) {
+    throw InvalidHandle(handle);
+  }
+  return slot;
+}
+
 int HandleManager::AllocateHandle() {
-  int handle = last_handle_.fetch_add(1) + 1;
-  std::lock_guard<std::mutex> guard(mutex_);
-  results_[handle] = nullptr;
-  return handle;
+  auto index = PopFreeSlot();
+  auto& slot = chunks_[index >> CHUNK_BITS].load(
+      std::memory_order_acquire)[index & (CHUNK_SIZE - 1)];
+  auto generation = Generation(slot.state.load(std::memory_order_relaxed));
+  slot.state.store((generation << GENERATION_SHIFT) | STATE_ALLOCATED,
+                   std::memory_order_release);
+  return static_cast<int>((generation << INDEX_BITS) | index);
 }
 
 void HandleManager::MarkDone(int handle, const Status& status) {
-  std::lock_guard<std::mutex> guard(mutex_);
-  results_[handle] = std::make_shared<Status>(status);
+  uint32_t state;
+  auto& slot = CheckHandle(handle, state);
+  slot.status = status;
+  auto old_state = slot.state.fetch_or(STATE_DONE, std::memory_order_acq_rel);
+  if (old_state & STATE_WAITER) {
+    WakeWord(slot.state);
+  }
+  // Pairs with the fence of WaitAny, so that either the waiter sees the done
+  // state or the count is bumped.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (any_waiters_.load(std::memory_order_seq_cst) > 0) {
+    completions_.fetch_add(1, std::memory_order_seq_cst);
+    WakeWord(completions_);
+  }
 }
 
 bool HandleManager::PollHandle(int handle) {
-  std::lock_guard<std::mutex> guard(mutex_);
-  if (results_.find(handle) == results_.end()) {
-    throw std::invalid_argument("Handle " + std::to_string(handle) +
-                                " was not created or has been cleared.");
+  uint32_t state;
+  CheckHandle(handle, state);
+  return (state & STATE_DONE) != 0;
+}
+
+void HandleManager::WaitHandle(int handle) {
+  uint32_t state;
+  auto& slot = CheckHandle(handle, state);
+  while (!(state & STATE_DONE)) {
+    // Flag the slot so that MarkDone only wakes waiters when there are any.
+    if (!(state & STATE_WAITER)) {
+      if (!slot.state.compare_exchange_weak(state, state | STATE_WAITER,
+                                            std::memory_order_acq_rel)) {
+        continue;
+      }
+      state |= STATE_WAITER;
+    }
+    WaitWord(slot.state, state);
+    state = slot.state.load(std::memory_order_acquire);
+  }
+}
+
+void HandleManager::WaitAll(const std::vector<int>& handles) {
+  // Each wait returns as soon as its operation is done, so the last one
+  // returns once all are done.
+  for (auto handle : handles) {
+    WaitHandle(handle);
   }
-  return results_[handle] != nullptr;
 }
 
-std::shared_ptr<Status> HandleManager::ReleaseHandle(int handle) {
-  std::lock_guard<std::mutex> guard(mutex_);
-  if (results_.find(handle) == results_.end()) {
-    throw std::invalid_argument("Handle " + std::to_string(handle) +
-        " was not created or has been cleared.");
+size_t HandleManager::WaitAny(const std::vector<int>& handles) {
+  if (handles.empty()) {
+    throw std::invalid_argument("WaitAny needs at least one handle.");
   }
-  auto status = results_[handle];
-  results_.erase(handle);
+  any_waiters_.fetch_add(1, std::memory_order_seq_cst);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  while (true) {
+    // Read the count before checking the handles, so that a completion in
+    // between changes it and the wait returns right away.
+    auto completions = completions_.load(std::memory_order_seq_cst);
+    for (size_t i = 0; i < handles.size(); ++i) {
+      bool done;
+      try {
+        done = PollHandle(handles[i]);
+      } catch (...) {
+        any_waiters_.fetch_sub(1, std::memory_order_seq_cst);
+        throw;
+      }
+      if (done) {
+        any_waiters_.fetch_sub(1, std::memory_order_seq_cst);
+        return i;
+      }
+    }
+    WaitWord(completions_, completions);
+  }
+}
+
+Status HandleManager::ReleaseHandle(int handle) {
+  uint32_t state;
+  auto& slot = CheckHandle(handle, state);
+  if (!(state & STATE_DONE)) {
+    throw std::logic_error("Handle " + std::to_string(handle) +
+                           " was released before its operation was done.");
+  }
+  auto status = std::move(slot.status);
+  slot.status = Status::OK();
+  auto generation = Generation(state) % MAX_GENERATION + 1;
+  slot.state.store(generation << GENERATION_SHIFT, std::memory_order_release);
+  auto index = static_cast<uint32_t>(handle) & ((1u << INDEX_BITS) - 1);
+  PushFreeSlots(index, index);
   return status;
 }
 
+#if defined(__linux__)
+// Waits on the word itself, slot states stay put since chunks are never
+// freed.
+void HandleManager::WaitWord(std::atomic<uint32_t>& word, uint32_t value) {
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE,
+          value, nullptr, nullptr, 0);
+}
+
+void HandleManager::WakeWord(std::atomic<uint32_t>& word) {
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE,
+          INT32_MAX, nullptr, nullptr, 0);
+}
+#else
+void HandleManager::WaitWord(std::atomic<uint32_t>& word, uint32_t value) {
+  std::unique_lock<std::mutex> lock(wait_mutex_);
+  wait_cond_.wait(lock, [&word, value]() {
+    return word.load(std::memory_order_acquire) != value;
+  });
+}
+
+void HandleManager::WakeWord(std::atomic<uint32_t>& word) {
+  // Taking the lock orders the wake after a waiter that checked the state.
+  std::lock_guard<std::mutex> guard(wait_mutex_);
+  wait_cond_.notify_all();
+}
+#endif
+
 } // namespace torch
-} // namespace horovod
\ No newline at end of file
+} // namespace horovod
@@ -17,9 +17,10 @@
 #define HOROVOD_TORCH_HANDLE_MANAGER_H
 
 #include <atomic>
-#include <memory>
+#include <condition_variable>
+#include <cstdint>
 #include <mutex>
-#include <unordered_map>
+#include <vector>
 
 #include "../common/common.h"
 
@@ -28,17 +29,57 @@ namespace torch {
 
 using namespace horovod::common;
 
+// Tracks the asynchronous operations in flight. Each handle refers to a slot
+// of a slab, which grows in chunks that are never freed, so that allocating,
+// completing, polling and releasing a handle do not take a lock. A handle
+// encodes the index of its slot and the generation of the slot, which changes
+// each time the slot is released, so that stale handles are detected.
 class HandleManager {
 public:
+  HandleManager();
+  ~HandleManager();
+
   int AllocateHandle();
   void MarkDone(int handle, const Status& status);
   bool PollHandle(int handle);
-  std::shared_ptr<Status> ReleaseHandle(int handle);
+  // Blocks until the operation of the handle is done.
+  void WaitHandle(int handle);
+  // Blocks until the operations of all the handles are done.
+  void WaitAll(const std::vector<int>& handles);
+  // Blocks until the operation of one of the handles is done and returns its
+  // position in handles.
+  size_t WaitAny(const std::vector<int>& handles);
+  Status ReleaseHandle(int handle);
 
 private:
-  std::atomic_int last_handle_;
-  std::unordered_map<int, std::shared_ptr<Status>> results_;
-  std::mutex mutex_;
+  struct Slot {
+    // Generation of the slot and whether it is allocated, done and waited on.
+    std::atomic<uint32_t> state;
+    // Index plus one of the next slot in the free list.
+    std::atomic<uint32_t> next_free;
+    Status status;
+  };
+
+  Slot& CheckHandle(int handle, uint32_t& state);
+  uint32_t PopFreeSlot();
+  void PushFreeSlots(uint32_t first, uint32_t last);
+  void WaitWord(std::atomic<uint32_t>& word, uint32_t value);
+  void WakeWord(std::atomic<uint32_t>& word);
+
+  std::atomic<Slot*>* chunks_;
+  std::atomic<uint32_t> num_chunks_;
+  // Tag in the upper half, against ABA, and index plus one of the first free
+  // slot, or zero, in the lower half.
+  std::atomic<uint64_t> free_head_;
+  std::mutex grow_mutex_;
+  // Bumped by MarkDone while WaitAny callers are blocked, which wait on it
+  // for a completion of any handle.
+  std::atomic<uint32_t> completions_;
+  std::atomic<int> any_waiters_;
+#if !defined(__linux__)
+  std::mutex wait_mutex_;
+  std::condition_variable wait_cond_;
+#endif
 };
 
 } // namespace torch
@@ -0,0 +1,173 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#if HAVE_CUDA
+#include <THC/THC.h>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#endif
+
+#include "cuda_util.h"
+#include "host_staging.h"
+#include "ready_event.h"
+
+#if HAVE_CUDA
+extern THCState* state;
+#endif
+
+namespace horovod {
+namespace torch {
+
+#if HAVE_CUDA
+namespace {
+
+// Smallest pinned block, so that small tensors share a few sizes.
+const size_t MIN_BLOCK_BYTES = 4096;
+
+struct PinnedBlock {
+  void* data;
+  size_t bytes;
+  // Recorded after the last copy from or to the block.
+  cudaEvent_t event;
+};
+
+// Pinned host blocks of power of two sizes, kept per device since the events
+// of the blocks belong to one. Blocks are never freed, so that the pool holds
+// at most about twice the largest set of tensors staged at once.
+class PinnedPool {
+public:
+  // Must be called with device current.
+  PinnedBlock Acquire(int device, size_t bytes) {
+    size_t block_bytes = MIN_BLOCK_BYTES;
+    while (block_bytes < bytes) {
+      block_bytes *= 2;
+    }
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      auto& blocks = free_blocks_[device];
+      auto range = blocks.equal_range(block_bytes);
+      for (auto it = range.first; it != range.second; ++it) {
+        auto status = cudaEventQuery(it->second.event);
+        if (status == cudaErrorNotReady) {
+          continue;
+        }
+        THCudaCheck(status);
+        auto block = it->second;
+        blocks.erase(it);
+        return block;
+      }
+    }
+
+    PinnedBlock block;
+    block.bytes = block_bytes;
+    THCudaCheck(
+        cudaHostAlloc(&block.data, block_bytes, cudaHostAllocPortable));
+    THCudaCheck(
+        cudaEventCreateWithFlags(&block.event, cudaEventDisableTiming));
+    return block;
+  }
+
+  // Must be called with device current.
+  void Release(int device, const PinnedBlock& block, cudaStream_t stream) {
+    THCudaCheck(cudaEventRecord(block.event, stream));
+    std::lock_guard<std::mutex> guard(mutex_);
+    free_blocks_[device].emplace(block.bytes, block);
+  }
+
+  // Non-blocking stream of the device for the copies to the host. Must be
+  // called with device current.
+  cudaStream_t SideStream(int device) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto& stream = side_streams_[device];
+    if (stream == nullptr) {
+      THCudaCheck(cudaStreamCreateWithFlags(&stream, cudaStreamNonBlocking));
+    }
+    return stream;
+  }
+
+private:
+  std::mutex mutex_;
+  std::unordered_map<int, std::multimap<size_t, PinnedBlock>> free_blocks_;
+  std::unordered_map<int, cudaStream_t> side_streams_;
+};
+
+PinnedPool pinned_pool;
+
+} // namespace
+#endif
+
+HostStaging::HostStaging(const ::torch::Tensor& tensor)
+    : device_(tensor.device().index()) {
+#if HAVE_CUDA
+  with_device device_guard(device_);
+  input_ = tensor.contiguous();
+  bytes_ = input_.numel() * input_.element_size();
+  stream_ = THCState_getCurrentStreamOnDevice(state, device_);
+
+  auto block = pinned_pool.Acquire(device_, bytes_);
+  block_ = block.data;
+  block_bytes_ = block.bytes;
+  block_event_ = block.event;
+  host_ = ::torch::from_blob(block_, input_.sizes(),
+                             input_.options().device(::torch::kCPU));
+
+  // The side stream waits for the values of the tensor on the current stream,
+  // which meanwhile moves on to the next kernels.
+  auto side_stream = pinned_pool.SideStream(device_);
+  auto input_ready = RecordReadyEvent(device_);
+  THCudaCheck(cudaStreamWaitEvent(side_stream, input_ready->CudaEvent(), 0));
+  THCudaCheck(cudaMemcpyAsync(block_, input_.data_ptr(), bytes_,
+                              cudaMemcpyDeviceToHost, side_stream));
+  ready_event_ = RecordReadyEvent(device_, side_stream);
+  last_stream_ = side_stream;
+#else
+  host_ = tensor.to(::torch::Device(::torch::kCPU), /*non_blocking=*/true);
+  ready_event_ = RecordReadyEvent(device_);
+#endif
+}
+
+HostStaging::~HostStaging() {
+#if HAVE_CUDA
+  with_device device_guard(device_);
+  pinned_pool.Release(device_, PinnedBlock{block_, block_bytes_, block_event_},
+                      last_stream_);
+#endif
+}
+
+void HostStaging::CopyToDevice(::torch::Tensor& output) {
+  with_device device_guard(device_);
+#if HAVE_CUDA
+  if (output.is_contiguous() && output.scalar_type() == host_.scalar_type() &&
+      static_cast<size_t>(output.numel() * output.element_size()) == bytes_) {
+    THCudaCheck(cudaMemcpyAsync(output.data_ptr(), block_, bytes_,
+                                cudaMemcpyHostToDevice, stream_));
+    last_stream_ = stream_;
+    return;
+  }
+#endif
+  output.copy_(host_);
+}
+
+void HostStaging::Synchronize() {
+#if HAVE_CUDA
+  if (last_stream_ == stream_) {
+    THCudaCheck(cudaStreamSynchronize(stream_));
+  }
+#endif
+}
+
+} // namespace torch
+} // namespace horovod
@@ -0,0 +1,77 @@
+// Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HOROVOD_TORCH_HOST_STAGING_H
+#define HOROVOD_TORCH_HOST_STAGING_H
+
+#if HAVE_CUDA
+#include "cuda_runtime.h"
+#endif
+
+#include <memory>
+#include <torch/torch.h>
+
+#include "../common/common.h"
+
+namespace horovod {
+namespace torch {
+
+using namespace horovod::common;
+
+// Host copy of a GPU tensor for a collective run on the CPU. The copy is made
+// into a pinned buffer, taken from a pool reused across calls, on a side
+// stream of the device once the work queued so far on the current stream is
+// done, so that neither the caller nor the current stream wait for it. The
+// buffer returns to the pool when the staging is destroyed, once the copies
+// queued on it are done.
+class HostStaging {
+public:
+  explicit HostStaging(const ::torch::Tensor& tensor);
+  ~HostStaging();
+
+  // Pinned host tensor of the shape and type of the staged tensor.
+  const ::torch::Tensor& host() const { return host_; }
+
+  // Signals that the host tensor holds the staged values.
+  std::shared_ptr<ReadyEvent> ready_event() const { return ready_event_; }
+
+  // Queues a copy of the host tensor into output on the stream that was
+  // current when the tensor was staged. Outputs that are not contiguous or
+  // differ in size are copied synchronously.
+  void CopyToDevice(::torch::Tensor& output);
+
+  // Waits for the copy queued by CopyToDevice.
+  void Synchronize();
+
+private:
+  int device_;
+  size_t bytes_ = 0;
+  ::torch::Tensor input_;
+  ::torch::Tensor host_;
+  std::shared_ptr<ReadyEvent> ready_event_;
+#if HAVE_CUDA
+  void* block_ = nullptr;
+  size_t block_bytes_ = 0;
+  cudaEvent_t block_event_ = nullptr;
+  cudaStream_t stream_ = nullptr;
+  // Stream of the last copy from or to the block.
+  cudaStream_t last_stream_ = nullptr;
+#endif
+};
+
+} // namespace torch
+} // namespace horovod
+
+#endif // HOROVOD_TORCH_HOST_STAGING_H
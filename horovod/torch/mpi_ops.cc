@@ -13,9 +13,7 @@
 // limitations under the License.
 // =============================================================================
 
-#include <chrono>
 #include <memory>
-#include <thread>
 
 #include "../common/operations.h"
 #include "adapter.h"
@@ -391,11 +389,8 @@ extern "C" int horovod_torch_poll(int handle) {
 }
 
 extern "C" void horovod_torch_wait_and_clear(int handle) {
-  while (!handle_manager.PollHandle(handle)) {
-    std::this_thread::sleep_for(std::chrono::milliseconds(1));
-  }
-  auto status = handle_manager.ReleaseHandle(handle);
-  ThrowIfError(*status);
+  handle_manager.WaitHandle(handle);
+  ThrowIfError(handle_manager.ReleaseHandle(handle));
 }
 
 } // namespace torch
@@ -18,6 +18,7 @@ from __future__ import division
 from __future__ import print_function
 
 from distutils.version import LooseVersion
+import time
 
 # Load all the necessary PyTorch C types.
 import torch
@@ -36,11 +37,17 @@ else:
     _NULL = mpi_lib._ffi.NULL
     _basics = _HorovodBasics(__file__, 'mpi_lib_impl', '_mpi_lib_impl')
 
+from horovod.common.util import Average, Sum, Adasum, Min, Max, Product
+from horovod.common.util import Int8, Int4
+from horovod.common.util import get_compression as _compression
+from horovod.common.util import REDUCE_OP_SUM as _REDUCE_OP_SUM
+from horovod.common.util import get_reduce_op as _reduce_op
 from horovod.torch.compression import Compression
 
 # import basic methods
 init = _basics.init
 shutdown = _basics.shutdown
+reset = _basics.reset
 size = _basics.size
 local_size = _basics.local_size
 rank = _basics.rank
@@ -53,6 +60,14 @@ gloo_built = _basics.gloo_built
 nccl_built = _basics.nccl_built
 ddl_built = _basics.ddl_built
 mlsl_built = _basics.mlsl_built
+metrics = _basics.metrics
+stats = _basics.stats
+set_parameters = _basics.set_parameters
+start_timeline = _basics.start_timeline
+stop_timeline = _basics.stop_timeline
+add_process_set = _basics.add_process_set
+process_set_rank = _basics.process_set_rank
+process_set_size = _basics.process_set_size
 
 
 # Schema: handle -> input, output
@@ -77,20 +92,52 @@ def _allreduce_function_factory(tensor):
     return 'horovod_torch_allreduce_async_' + tensor.type().replace('.', '_')
 
 
-def _allreduce_async(tensor, output, average, name):
+def _allreduce_async(tensor, output, average, name, priority=0,
+                     prescale_factor=1.0, postscale_factor=1.0, op=None,
+                     process_set=0, quantization=None, accumulate=False):
+    average, reduce_op = _reduce_op(average, op)
+    compression = _compression(quantization)
     if tensor.dtype == torch.float16 and not _fp16_supported:
         raise NotImplementedError(
             'float16 allreduce is not supported for PyTorch version {} < 1.0.0'
             .format(torch.__version__))
+    if not _v2_api and (prescale_factor != 1.0 or postscale_factor != 1.0):
+        raise NotImplementedError(
+            'prescale_factor and postscale_factor are not supported for '
+            'PyTorch version {} < 1.0.0'.format(torch.__version__))
+    if not _v2_api and reduce_op != _REDUCE_OP_SUM:
+        raise NotImplementedError(
+            'reductions other than Average and Sum are not supported for '
+            'PyTorch version {} < 1.0.0'.format(torch.__version__))
+    if not _v2_api and process_set != 0:
+        raise NotImplementedError(
+            'process sets are not supported for PyTorch version {} < 1.0.0'
+            .format(torch.__version__))
+    if not _v2_api and compression != 0:
+        raise NotImplementedError(
+            'quantization is not supported for PyTorch version {} < 1.0.0'
+            .format(torch.__version__))
+    if not _v2_api and accumulate:
+        raise NotImplementedError(
+            'accumulation is not supported for PyTorch version {} < 1.0.0'
+            .format(torch.__version__))
 
     function = _check_function(_allreduce_function_factory, tensor)
-    handle = getattr(mpi_lib, function)(tensor, output, average,
-                                        name.encode() if name is not None else _NULL)
+    args = [tensor, output, average,
+            name.encode() if name is not None else _NULL]
+    if _v2_api:
+        # Priorities, scale factors, reductions, process sets, quantization
+        # and accumulation are not supported by the legacy FFI extension.
+        args += [priority, prescale_factor, postscale_factor, reduce_op,
+                 process_set, compression, accumulate]
+    handle = getattr(mpi_lib, function)(*args)
     _handle_map[handle] = (tensor, output)
     return handle
 
 
-def allreduce_async(tensor, average=True, name=None):
+def allreduce_async(tensor, average=True, name=None, priority=0,
+                    prescale_factor=1.0, postscale_factor=1.0, op=None,
+                    process_set=0, quantization=None, accumulate=False):
     """
     A function that performs asynchronous averaging or summation of the input tensor
     over all the Horovod processes. The input tensor is not modified.
@@ -105,30 +152,72 @@ def allreduce_async(tensor, average=True, name=None):
         average: A flag indicating whether to compute average or summation,
                  defaults to average.
         name: A name of the reduction operation.
+        priority: Tensors with higher priority are fused and reduced first.
+                  Must be the same on all Horovod processes for a given name.
+        prescale_factor: Multiplicative factor applied to the tensor while it
+                         is packed for the reduction, e.g. to keep float16
+                         gradients from overflowing.
+        postscale_factor: Multiplicative factor applied to the reduced values
+                          while they are copied to the output.
+        op: The reduction, one of `Average`, `Sum`, `Adasum`, `Min`, `Max`
+            or `Product`. Overrides `average` if set.
+        process_set: Id of the process set, from `add_process_set()`, to
+                     reduce within, or 0 for all processes. Averages are over
+                     the members of the set.
+        quantization: `Int8` or `Int4` to send float32 tensors in host
+                      memory as integers of that width, or None. Must be the
+                      same on all Horovod processes for a given name.
+        accumulate: If True, a sum allreduce of a tensor in host memory is
+                    summed locally over HOROVOD_GRADIENT_ACCUMULATION_STEPS
+                    submissions of its name, and only the last of them is
+                    allreduced. Must be the same on all Horovod processes for
+                    a given name.
 
     Returns:
         A handle to the allreduce operation that can be used with `poll()` or
         `synchronize()`.
     """
     output = tensor.new(tensor.shape)
-    return _allreduce_async(tensor, output, average, name)
+    return _allreduce_async(tensor, output, average, name, priority,
+                            prescale_factor, postscale_factor, op, process_set,
+                            quantization, accumulate)
 
 
 class HorovodAllreduce(torch.autograd.Function):
     """An autograd function that performs allreduce on a tensor."""
 
     @staticmethod
-    def forward(ctx, tensor, average, name):
+    def forward(ctx, tensor, average, name, prescale_factor, postscale_factor, op,
+                process_set, quantization):
         ctx.average = average
-        handle = allreduce_async(tensor, average, name)
+        ctx.prescale_factor = prescale_factor
+        ctx.postscale_factor = postscale_factor
+        ctx.op = op
+        ctx.process_set = process_set
+        ctx.quantization = quantization
+        handle = allreduce_async(tensor, average, name,
+                                 prescale_factor=prescale_factor,
+                                 postscale_factor=postscale_factor, op=op,
+                                 process_set=process_set,
+                                 quantization=quantization)
         return synchronize(handle)
 
     @staticmethod
     def backward(ctx, grad_output):
-        return allreduce(grad_output, ctx.average), None, None
-
-
-def allreduce(tensor, average=True, name=None, compression=Compression.none):
+        if ctx.op in (Min, Max, Product):
+            raise NotImplementedError(
+                'The gradient of a %s allreduce is not implemented.' % ctx.op)
+        return allreduce(grad_output, ctx.average,
+                         prescale_factor=ctx.prescale_factor,
+                         postscale_factor=ctx.postscale_factor, op=ctx.op,
+                         process_set=ctx.process_set,
+                         quantization=ctx.quantization), \
+            None, None, None, None, None, None, None
+
+
+def allreduce(tensor, average=True, name=None, compression=Compression.none,
+              prescale_factor=1.0, postscale_factor=1.0, op=None,
+              process_set=0, quantization=None):
     """
     A function that performs averaging or summation of the input tensor over all the
     Horovod processes. The input tensor is not modified.
@@ -150,17 +239,33 @@ def allreduce(tensor, average=True, name=None, compression=Compression.none):
         compression: Compression algorithm used during allreduce to reduce the amount
                      of data sent during the each parameter update step.  Defaults to
                      not using compression.
+        prescale_factor: Multiplicative factor applied to the tensor while it
+                         is packed for the reduction.
+        postscale_factor: Multiplicative factor applied to the reduced values
+                          while they are copied to the output.
+        op: The reduction, one of `Average`, `Sum`, `Adasum`, `Min`, `Max`
+            or `Product`. Overrides `average` if set.
+        process_set: Id of the process set, from `add_process_set()`, to
+                     reduce within, or 0 for all processes. Averages are over
+                     the members of the set.
+        quantization: `Int8` or `Int4` to send float32 tensors in host
+                      memory as integers of that width, or None. Must be the
+                      same on all Horovod processes for a given name.
 
     Returns:
         A tensor of the same shape and type as `tensor`, averaged or summed across all
         processes.
     """
     tensor_compressed, ctx = compression.compress(tensor)
-    summed_tensor_compressed = HorovodAllreduce.apply(tensor_compressed, average, name)
+    summed_tensor_compressed = HorovodAllreduce.apply(tensor_compressed, average, name,
+                                                      prescale_factor, postscale_factor,
+                                                      op, process_set, quantization)
     return compression.decompress(summed_tensor_compressed, ctx)
 
 
-def allreduce_async_(tensor, average=True, name=None):
+def allreduce_async_(tensor, average=True, name=None, priority=0,
+                     prescale_factor=1.0, postscale_factor=1.0, op=None,
+                     process_set=0, quantization=None, accumulate=False):
     """
     A function that performs asynchronous in-place averaging or summation of the input
     tensor over all the Horovod processes.
@@ -175,15 +280,38 @@ def allreduce_async_(tensor, average=True, name=None):
         average: A flag indicating whether to compute average or summation,
                  defaults to average.
         name: A name of the reduction operation.
+        priority: Tensors with higher priority are fused and reduced first.
+                  Must be the same on all Horovod processes for a given name.
+        prescale_factor: Multiplicative factor applied to the tensor while it
+                         is packed for the reduction, e.g. to keep float16
+                         gradients from overflowing.
+        postscale_factor: Multiplicative factor applied to the reduced values
+                          while they are copied to the output.
+        op: The reduction, one of `Average`, `Sum`, `Adasum`, `Min`, `Max`
+            or `Product`. Overrides `average` if set.
+        process_set: Id of the process set, from `add_process_set()`, to
+                     reduce within, or 0 for all processes. Averages are over
+                     the members of the set.
+        quantization: `Int8` or `Int4` to send float32 tensors in host
+                      memory as integers of that width, or None. Must be the
+                      same on all Horovod processes for a given name.
+        accumulate: If True, a sum allreduce of a tensor in host memory is
+                    summed locally over HOROVOD_GRADIENT_ACCUMULATION_STEPS
+                    submissions of its name, and only the last of them is
+                    allreduced. Must be the same on all Horovod processes for
+                    a given name.
 
     Returns:
         A handle to the allreduce operation that can be used with `poll()` or
         `synchronize()`.
     """
-    return _allreduce_async(tensor, tensor, average, name)
+    return _allreduce_async(tensor, tensor, average, name, priority,
+                            prescale_factor, postscale_factor, op, process_set,
+                            quantization, accumulate)
 
 
-def allreduce_(tensor, average=True, name=None):
+def allreduce_(tensor, average=True, name=None, prescale_factor=1.0,
+               postscale_factor=1.0, op=None, process_set=0, quantization=None):
     """
     A function that performs in-place averaging or summation of the input tensor over
     all the Horovod processes.
@@ -198,15 +326,239 @@ def allreduce_(tensor, average=True, name=None):
         average: A flag indicating whether to compute average or summation,
                  defaults to average.
         name: A name of the reduction operation.
+        prescale_factor: Multiplicative factor applied to the tensor while it
+                         is packed for the reduction.
+        postscale_factor: Multiplicative factor applied to the reduced values
+                          while they are copied to the output.
+        op: The reduction, one of `Average`, `Sum`, `Adasum`, `Min`, `Max`
+            or `Product`. Overrides `average` if set.
+        process_set: Id of the process set, from `add_process_set()`, to
+                     reduce within, or 0 for all processes. Averages are over
+                     the members of the set.
+        quantization: `Int8` or `Int4` to send float32 tensors in host
+                      memory as integers of that width, or None. Must be the
+                      same on all Horovod processes for a given name.
 
     Returns:
         A tensor of the same shape and type as `tensor`, averaged or summed across all
         processes.
     """
-    handle = allreduce_async_(tensor, average, name)
+    handle = allreduce_async_(tensor, average, name,
+                              prescale_factor=prescale_factor,
+                              postscale_factor=postscale_factor, op=op,
+                              process_set=process_set,
+                              quantization=quantization)
     return synchronize(handle)
 
 
+def _grouped_allreduce_async(tensors, outputs, average, name, priority=0,
+                             prescale_factor=1.0, postscale_factor=1.0, op=None,
+                             quantization=None):
+    average, reduce_op = _reduce_op(average, op)
+    compression = _compression(quantization)
+    if not _v2_api:
+        raise NotImplementedError(
+            'grouped allreduce is not supported for PyTorch version {} < 1.0.0'
+            .format(torch.__version__))
+    if len(tensors) == 0:
+        raise ValueError('grouped allreduce needs at least one tensor.')
+    for tensor in tensors:
+        _check_function(_allreduce_function_factory, tensor)
+        if tensor.type() != tensors[0].type():
+            raise ValueError('Tensors of a grouped allreduce must have the same '
+                             'type, got %s and %s.' % (tensors[0].type(), tensor.type()))
+
+    function = 'horovod_torch_grouped_allreduce_async'
+    if tensors[0].is_cuda:
+        function += '_cuda'
+    handles = getattr(mpi_lib, function)(
+        tensors, outputs, average, name.encode() if name is not None else _NULL,
+        priority, prescale_factor, postscale_factor, reduce_op, compression)
+    for tensor, output, handle in zip(tensors, outputs, handles):
+        _handle_map[handle] = (tensor, output)
+    return handles
+
+
+def grouped_allreduce_async(tensors, average=True, name=None, priority=0,
+                            prescale_factor=1.0, postscale_factor=1.0, op=None,
+                            quantization=None):
+    """
+    A function that performs asynchronous averaging or summation of a list of input
+    tensors over all the Horovod processes. The input tensors are not modified.
+
+    The tensors are negotiated as a single group, keyed by the name, and are
+    fused together. If name is not provided, an incremented auto-generated name
+    is used. The tensors must have the same type and device, and the number of
+    tensors and their sizes must be the same on all Horovod processes for a
+    given name.
+
+    Arguments:
+        tensors: A list of tensors to average and sum.
+        average: A flag indicating whether to compute average or summation,
+                 defaults to average.
+        name: A name of the group.
+        priority: Groups with higher priority are fused and reduced first.
+        prescale_factor: Multiplicative factor applied to the tensors while
+                         they are packed for the reduction.
+        postscale_factor: Multiplicative factor applied to the reduced values
+                          while they are copied to the outputs.
+        op: The reduction, one of `Average`, `Sum`, `Adasum`, `Min`, `Max`
+            or `Product`. Overrides `average` if set.
+        quantization: `Int8` or `Int4` to send float32 tensors in host
+                      memory as integers of that width, or None.
+
+    Returns:
+        A list of handles, one per tensor, that can be used with `poll()` or
+        `synchronize()`.
+    """
+    outputs = [tensor.new(tensor.shape) for tensor in tensors]
+    return _grouped_allreduce_async(tensors, outputs, average, name, priority,
+                                    prescale_factor, postscale_factor, op,
+                                    quantization)
+
+
+def grouped_allreduce_async_(tensors, average=True, name=None, priority=0,
+                             prescale_factor=1.0, postscale_factor=1.0, op=None,
+                             quantization=None):
+    """
+    A function that performs asynchronous in-place averaging or summation of a
+    list of input tensors over all the Horovod processes, negotiated as a single
+    group and fused together.
+
+    Arguments:
+        tensors: A list of tensors to average and sum.
+        average: A flag indicating whether to compute average or summation,
+                 defaults to average.
+        name: A name of the group.
+        priority: Groups with higher priority are fused and reduced first.
+        prescale_factor: Multiplicative factor applied to the tensors while
+                         they are packed for the reduction.
+        postscale_factor: Multiplicative factor applied to the reduced values
+                          while they are copied to the outputs.
+        op: The reduction, one of `Average`, `Sum`, `Adasum`, `Min`, `Max`
+            or `Product`. Overrides `average` if set.
+        quantization: `Int8` or `Int4` to send float32 tensors in host
+                      memory as integers of that width, or None.
+
+    Returns:
+        A list of handles, one per tensor, that can be used with `poll()` or
+        `synchronize()`.
+    """
+    return _grouped_allreduce_async(tensors, tensors, average, name, priority,
+                                    prescale_factor, postscale_factor, op,
+                                    quantization)
+
+
+def grouped_allreduce(tensors, average=True, name=None, prescale_factor=1.0,
+                      postscale_factor=1.0, op=None, quantization=None):
+    """
+    A function that performs averaging or summation of a list of input tensors
+    over all the Horovod processes, negotiated as a single group and fused
+    together. The input tensors are not modified.
+
+    Arguments:
+        tensors: A list of tensors to average and sum.
+        average: A flag indicating whether to compute average or summation,
+                 defaults to average.
+        name: A name of the group.
+        prescale_factor: Multiplicative factor applied to the tensors while
+                         they are packed for the reduction.
+        postscale_factor: Multiplicative factor applied to the reduced values
+                          while they are copied to the outputs.
+        op: The reduction, one of `Average`, `Sum`, `Adasum`, `Min`, `Max`
+            or `Product`. Overrides `average` if set.
+        quantization: `Int8` or `Int4` to send float32 tensors in host
+                      memory as integers of that width, or None.
+
+    Returns:
+        A list of tensors of the same shapes and type as `tensors`, averaged or
+        summed across all processes.
+    """
+    handles = grouped_allreduce_async(tensors, average, name,
+                                      prescale_factor=prescale_factor,
+                                      postscale_factor=postscale_factor, op=op,
+                                      quantization=quantization)
+    return [synchronize(handle) for handle in handles]
+
+
+def grouped_allreduce_(tensors, average=True, name=None, prescale_factor=1.0,
+                       postscale_factor=1.0, op=None, quantization=None):
+    """
+    A function that performs in-place averaging or summation of a list of input
+    tensors over all the Horovod processes, negotiated as a single group and
+    fused together.
+
+    Arguments:
+        tensors: A list of tensors to average and sum.
+        average: A flag indicating whether to compute average or summation,
+                 defaults to average.
+        name: A name of the group.
+        prescale_factor: Multiplicative factor applied to the tensors while
+                         they are packed for the reduction.
+        postscale_factor: Multiplicative factor applied to the reduced values
+                          while they are copied to the outputs.
+        op: The reduction, one of `Average`, `Sum`, `Adasum`, `Min`, `Max`
+            or `Product`. Overrides `average` if set.
+        quantization: `Int8` or `Int4` to send float32 tensors in host
+                      memory as integers of that width, or None.
+
+    Returns:
+        The list of tensors, averaged or summed across all processes.
+    """
+    handles = grouped_allreduce_async_(tensors, average, name,
+                                       prescale_factor=prescale_factor,
+                                       postscale_factor=postscale_factor, op=op,
+                                       quantization=quantization)
+    return [synchronize(handle) for handle in handles]
+
+
+def capturable_allreduce_(tensors, average=True, prescale_factor=1.0,
+                          postscale_factor=1.0, op=None):
+    """
+    A function that performs in-place averaging or summation of a list of GPU
+    tensors over all the Horovod processes on the current CUDA stream, so that
+    it can be captured into a CUDA graph and replayed.
+
+    Unlike `grouped_allreduce_()`, the call is not negotiated with the other
+    processes and returns once the reduction is queued on the stream. Every
+    process must call it with the same tensors, in the same order, and no
+    other Horovod operation may be in flight on that stream. Horovod must be
+    started with `HOROVOD_CUDA_GRAPH=1`, and the call must be made once
+    outside of capture before the graph is recorded so that the staging
+    buffer for several tensors is allocated.
+
+    Arguments:
+        tensors: A list of CUDA tensors of the same type to average and sum.
+        average: A flag indicating whether to compute average or summation,
+                 defaults to average.
+        prescale_factor: Multiplicative factor applied to the tensors while
+                         they are packed for the reduction.
+        postscale_factor: Multiplicative factor applied to the reduced values
+                          while they are copied back.
+        op: The reduction, one of `Average`, `Sum`, `Min`, `Max` or
+            `Product`. Overrides `average` if set.
+
+    Returns:
+        The list of tensors, averaged or summed across all processes.
+    """
+    average, reduce_op = _reduce_op(average, op)
+    if not _v2_api:
+        raise NotImplementedError(
+            'capturable allreduce is not supported for PyTorch version {} < 1.0.0'
+            .format(torch.__version__))
+    if len(tensors) == 0:
+        raise ValueError('capturable allreduce needs at least one tensor.')
+    for tensor in tensors:
+        if not tensor.is_cuda:
+            raise ValueError('capturable allreduce needs CUDA tensors.')
+        if tensor.type() != tensors[0].type():
+            raise ValueError('Tensors of a capturable allreduce must have the same '
+                             'type, got %s and %s.' % (tensors[0].type(), tensor.type()))
+    mpi_lib.horovod_torch_capturable_allreduce_(
+        tensors, average, prescale_factor, postscale_factor, reduce_op)
+    return tensors
+
+
 def _allgather_function_factory(tensor):
     return 'horovod_torch_allgather_async_' + tensor.type().replace('.', '_')
 
@@ -219,7 +571,7 @@ def _allgather_async(tensor, output, name):
     return handle
 
 
-def allgather_async(tensor, name=None):
+def allgather_async(tensor, name=None, output=None):
     """
     A function that asynchronously concatenates the input tensor with the same input
     tensor on all other Horovod processes. The input tensor is not modified.
@@ -228,15 +580,24 @@ def allgather_async(tensor, name=None):
     different processes must have the same rank and shape, except for the first
     dimension, which is allowed to be different.
 
+    Allgathers with a name gather into the memory of the previous output of the
+    same name when the gathered tensor fits and the previous output is no longer
+    referenced, so that variable-length allgathers do not allocate every step.
+
     Arguments:
         tensor: A tensor to allgather.
         name: A name of the allgather operation.
+        output: An optional tensor of the same type and device as `tensor` to
+                gather into. It is resized to the gathered shape and keeps its
+                memory when the result fits, so preallocating it with the
+                largest expected number of elements avoids allocations.
 
     Returns:
         A handle to the allgather operation that can be used with `poll()` or
         `synchronize()`.
     """
-    output = tensor.new()
+    if output is None:
+        output = tensor.new()
     return _allgather_async(tensor, output, name)
 
 
@@ -287,6 +648,164 @@ def allgather(tensor, name=None):
     return HorovodAllgather.apply(tensor, name)
 
 
+def _reducescatter_function_factory(tensor):
+    return 'horovod_torch_reducescatter_async_' + tensor.type().replace('.', '_')
+
+
+def _reducescatter_async(tensor, output, name):
+    function = _check_function(_reducescatter_function_factory, tensor)
+    handle = getattr(mpi_lib, function)(
+        tensor, output, name.encode() if name is not None else _NULL)
+    _handle_map[handle] = (tensor, output)
+    return handle
+
+
+def reducescatter_async(tensor, name=None):
+    """
+    A function that asynchronously sums the input tensor over all Horovod processes
+    and scatters the result along the first dimension. The input tensor is not
+    modified.
+
+    The input tensor must have the same shape on all processes. Rows of the first
+    dimension are split in rank order, the first `dim0 % size()` ranks receiving
+    one row more than the others.
+
+    Arguments:
+        tensor: A tensor to reduce and scatter.
+        name: A name of the reducescatter operation.
+
+    Returns:
+        A handle to the reducescatter operation that can be used with `poll()` or
+        `synchronize()`.
+    """
+    output = tensor.new()
+    return _reducescatter_async(tensor, output, name)
+
+
+class HorovodReducescatter(torch.autograd.Function):
+    """An autograd function that performs reducescatter on a tensor."""
+
+    @staticmethod
+    def forward(ctx, tensor, name):
+        handle = reducescatter_async(tensor, name)
+        return synchronize(handle)
+
+    @staticmethod
+    def backward(ctx, grad_output):
+        return allgather(grad_output), None
+
+
+def reducescatter(tensor, name=None):
+    """
+    A function that sums the input tensor over all Horovod processes and scatters
+    the result along the first dimension. The input tensor is not modified.
+
+    This acts as a thin wrapper around an autograd function.  If your input
+    tensor requires gradients, then callings this function will allow gradients
+    to be computed and backpropagated.
+
+    Arguments:
+        tensor: A tensor to reduce and scatter.
+        name: A name of the reducescatter operation.
+
+    Returns:
+        A tensor of the same type as `tensor`, holding the rows of the sum that
+        belong to this process.
+    """
+    return HorovodReducescatter.apply(tensor, name)
+
+
+def _alltoall_function_factory(tensor):
+    return 'horovod_torch_alltoall_async_' + tensor.type().replace('.', '_')
+
+
+def _alltoall_async(tensor, splits, output, name):
+    function = _check_function(_alltoall_function_factory, tensor)
+    handle = getattr(mpi_lib, function)(
+        tensor, splits, output, name.encode() if name is not None else _NULL)
+    _handle_map[handle] = (tensor, output)
+    return handle
+
+
+def alltoall_async(tensor, splits=None, name=None):
+    """
+    A function that asynchronously scatters slices of the input tensor to all
+    Horovod processes and concatenates the slices received from them. The input
+    tensor is not modified.
+
+    The slices are taken along the first dimension. `splits` gives the number of
+    rows sent to each process, in rank order, and must sum to the first dimension
+    of `tensor`. If it is not given, the first dimension must be divisible by
+    `size()` and is split evenly.
+
+    Arguments:
+        tensor: A tensor to distribute.
+        splits: A list or 1-D integer tensor of `size()` row counts.
+        name: A name of the alltoall operation.
+
+    Returns:
+        A handle to the alltoall operation that can be used with `poll()` or
+        `synchronize()`.
+    """
+    if splits is None:
+        splits = torch.LongTensor()
+    elif not isinstance(splits, torch.Tensor):
+        splits = torch.LongTensor(list(splits))
+    output = tensor.new()
+    return _alltoall_async(tensor, splits, output, name)
+
+
+class HorovodAlltoall(torch.autograd.Function):
+    """An autograd function that performs alltoall on a tensor."""
+
+    @staticmethod
+    def forward(ctx, tensor, splits, name):
+        ctx.splits = splits
+        ctx.dim = tensor.shape[0]
+        handle = alltoall_async(tensor, splits, name)
+        return synchronize(handle)
+
+    @staticmethod
+    def backward(ctx, grad_output):
+        # Send every gradient row back to the process it came from, which takes
+        # the number of rows this process received from each of them.
+        if ctx.splits is None:
+            recv_splits = None
+        else:
+            splits = ctx.splits
+            if not isinstance(splits, torch.Tensor):
+                splits = torch.LongTensor(list(splits))
+            recv_splits = alltoall(splits.long().cpu())
+        return alltoall(grad_output, recv_splits), None, None
+
+
+def alltoall(tensor, splits=None, name=None):
+    """
+    A function that scatters slices of the input tensor to all Horovod processes
+    and concatenates the slices received from them. The input tensor is not
+    modified.
+
+    The slices are taken along the first dimension. `splits` gives the number of
+    rows sent to each process, in rank order, and must sum to the first dimension
+    of `tensor`. If it is not given, the first dimension must be divisible by
+    `size()` and is split evenly.
+
+    This acts as a thin wrapper around an autograd function.  If your input
+    tensor requires gradients, then callings this function will allow gradients
+    to be computed and backpropagated.
+
+    Arguments:
+        tensor: A tensor to distribute.
+        splits: A list or 1-D integer tensor of `size()` row counts.
+        name: A name of the alltoall operation.
+
+    Returns:
+        A tensor of the same type as `tensor`, concatenating in rank order the rows
+        received from all processes.
+    """
+    return HorovodAlltoall.apply(tensor, splits, name)
+
+
 def _broadcast_function_factory(tensor):
     return 'horovod_torch_broadcast_async_' + tensor.type().replace('.', '_')
 
@@ -410,6 +929,30 @@ def broadcast_(tensor, root_rank, name=None):
     return synchronize(handle)
 
 
+def join(device=-1):
+    """
+    A function that indicates that this process has no more data to train on,
+    and blocks until all Horovod processes have called it.
+
+    Until then, the process takes part in the sum allreduces and broadcasts of
+    the other processes with tensors of zeros, so that processes with more
+    batches than others do not wait for the ones that ran out. Averages still
+    divide by the number of processes. Other operations fail while processes
+    have joined, and so do grouped allreduces.
+
+    Arguments:
+        device: The id of the GPU the other processes reduce their tensors on,
+                or -1 for tensors in host memory.
+    """
+    if not _v2_api:
+        raise NotImplementedError(
+            'join is not supported for PyTorch version {} < 1.0.0'
+            .format(torch.__version__))
+    handle = mpi_lib.horovod_torch_join(device)
+    _handle_map[handle] = (None, None)
+    synchronize(handle)
+
+
 def poll(handle):
     """
     Polls an allreduce, allgather or broadcast handle to determine whether underlying
@@ -443,3 +986,56 @@ def synchronize(handle):
     mpi_lib.horovod_torch_wait_and_clear(handle)
     _, output = _handle_map.pop(handle)
     return output
+
+
+def synchronize_all(handles):
+    """
+    Synchronizes a list of asynchronous operations until they are all
+    completed. The wait blocks once for all the handles, without polling, and
+    stops as soon as the last operation is done.
+
+    Arguments:
+        handles: A list of handles returned by asynchronous operations.
+
+    Returns:
+        A list of the output tensors of the operations, in the order of
+        `handles`.
+    """
+    handles = list(handles)
+    pending = [handle for handle in handles if handle in _handle_map]
+    if not _v2_api:
+        for handle in pending:
+            mpi_lib.horovod_torch_wait_and_clear(handle)
+    else:
+        try:
+            mpi_lib.horovod_torch_wait_all_and_clear(pending)
+        except Exception:
+            # The handles were all released, drop their tensors too.
+            for handle in pending:
+                _handle_map.pop(handle, None)
+            raise
+    return [_handle_map.pop(handle)[1] if handle in pending else None
+            for handle in handles]
+
+
+def wait_any(handles):
+    """
+    Blocks until one of a list of asynchronous operations is completed, without
+    polling. The operation is not synchronized, call `synchronize()` on its
+    handle to get its output.
+
+    Arguments:
+        handles: A non-empty list of handles returned by asynchronous
+                 operations.
+
+    Returns:
+        The position in `handles` of a completed operation.
+    """
+    handles = list(handles)
+    if not _v2_api:
+        while True:
+            for i, handle in enumerate(handles):
+                if poll(handle):
+                    return i
+            time.sleep(0.001)
+    return mpi_lib.horovod_torch_wait_any(handles)
@@ -13,18 +13,31 @@
 // limitations under the License.
 // =============================================================================
 
-#include <chrono>
+#if HAVE_CUDA
+#include <THC/THC.h>
+#endif
+#include <algorithm>
 #include <memory>
-#include <thread>
+#include <mutex>
+#include <unordered_map>
 #include <torch/extension.h>
 #include <torch/torch.h>
+#if TORCH_VERSION >= 1004000000
+#include <torch/csrc/autograd/function_hook.h>
+#include <torch/csrc/autograd/variable.h>
+#endif
 
 #include "../common/operations.h"
 #include "adapter_v2.h"
 #include "cuda_util.h"
 #include "handle_manager.h"
+#include "host_staging.h"
 #include "ready_event.h"
 
+#if HAVE_CUDA
+extern THCState* state;
+#endif
+
 namespace horovod {
 namespace torch {
 
@@ -47,11 +60,49 @@ int GetDeviceID(const ::torch::Tensor& tensor) {
   return CPU_DEVICE_ID;
 }
 
+// Floating point averages over size processes are computed while the reduced
+// values are unpacked from the fusion buffer, instead of in an extra pass over
+// the output. Integer averages keep the rounding of div_.
+void AverageInPostscale(const ::torch::Tensor& tensor, int size, int& average,
+                        double& postscale_factor) {
+  if (average && tensor.is_floating_point()) {
+    postscale_factor /= size;
+    average = 0;
+  }
+}
+
+// Outputs of the last allgather of each name. An allgather of the same name
+// gathers into the storage of the previous output when nothing else refers to
+// it any more, so that variable-length allgathers do not allocate every step
+// when the gathered shape is unchanged or smaller.
+std::unordered_map<std::string, ::torch::Tensor> allgather_outputs;
+std::mutex allgather_outputs_mutex;
+
+void ReuseAllgatherOutput(const std::string& name, ::torch::Tensor& output) {
+  std::lock_guard<std::mutex> guard(allgather_outputs_mutex);
+  auto it = allgather_outputs.find(name);
+  if (it != allgather_outputs.end()) {
+    auto& previous = it->second;
+    // Outputs with elements were preallocated by the caller, keep them.
+    if (output.numel() == 0 && previous.use_count() == 1 &&
+        previous.unsafeGetTensorImpl()->storage().use_count() == 1 &&
+        previous.scalar_type() == output.scalar_type() &&
+        previous.device() == output.device()) {
+      output.set_(previous);
+    }
+  }
+  allgather_outputs[name] = output;
+}
+
 } // namespace
 
 int DoAllreduce(::torch::Tensor tensor, ::torch::Tensor output, int average,
-                const std::string& name) {
+                const std::string& name, int priority, double prescale_factor,
+                double postscale_factor, int reduce_op, int process_set_id,
+                int compression, bool accumulate) {
   ThrowIfError(common::CheckInitialized());
+  int size = horovod_process_set_size(process_set_id);
+  AverageInPostscale(tensor, size, average, postscale_factor);
 
   auto handle = handle_manager.AllocateHandle();
   auto device = GetDeviceID(tensor);
@@ -63,56 +114,212 @@ int DoAllreduce(::torch::Tensor tensor, ::torch::Tensor output, int average,
   auto enqueue_result = EnqueueTensorAllreduce(
       hvd_context, hvd_tensor, hvd_output, ready_event,
       GetOpName("allreduce", name, handle), device,
-      [handle, average, output](const Status& status) mutable {
+      [handle, average, size, output](const Status& status) mutable {
         // Will execute in the `device` context.
         if (average) {
-          output.div_(horovod_size());
+          output.div_(size);
         }
         handle_manager.MarkDone(handle, status);
-      });
+      }, priority, prescale_factor, postscale_factor,
+      static_cast<ReduceOp>(reduce_op), process_set_id,
+      static_cast<Compression>(compression), accumulate);
   ThrowIfError(enqueue_result);
 
   return handle;
 }
 
 int DoAllreduceCudaOnCPU(::torch::Tensor tensor, ::torch::Tensor output, int average,
-                         const std::string& name) {
+                         const std::string& name, int priority,
+                         double prescale_factor, double postscale_factor,
+                         int reduce_op, int process_set_id, int compression,
+                         bool accumulate) {
   ThrowIfError(common::CheckInitialized());
+  int size = horovod_process_set_size(process_set_id);
+  AverageInPostscale(tensor, size, average, postscale_factor);
 
-  // Make async copy of input tensor to CPU tensor and record completion event.
+  // Stage the input tensor in pinned host memory, reduce it there in place,
+  // and queue the copy back on the stream of the caller.
   auto device = GetDeviceID(tensor);
-  auto cpu_buffer =
-      tensor.to(::torch::Device(::torch::kCPU), /*non_blocking=*/true);
+  auto staging = std::make_shared<HostStaging>(tensor);
+  auto cpu_buffer = staging->host();
   auto hvd_cpu_buffer = std::make_shared<TorchTensor>(cpu_buffer);
-  auto ready_event = RecordReadyEvent(device);
 
   auto hvd_context =
       std::make_shared<TorchOpContext>(CPU_DEVICE_ID, cpu_buffer);
 
   auto handle = handle_manager.AllocateHandle();
   auto enqueue_result = EnqueueTensorAllreduce(
-      hvd_context, hvd_cpu_buffer, hvd_cpu_buffer, ready_event,
+      hvd_context, hvd_cpu_buffer, hvd_cpu_buffer, staging->ready_event(),
       GetOpName("allreduce", name, handle), CPU_DEVICE_ID,
-      [handle, average, cpu_buffer, output,
+      [handle, average, size, staging, output,
        device](const Status& status) mutable {
-        // Since the operation was on CPU, need to perform copy with the GPU
-        // device guard.
-        with_device device_guard(device);
-        output.copy_(cpu_buffer);
-        if (average) {
-          output.div_(horovod_size());
+        if (status.ok()) {
+          staging->CopyToDevice(output);
+          if (average) {
+            staging->Synchronize();
+            with_device device_guard(device);
+            output.div_(size);
+          }
         }
         handle_manager.MarkDone(handle, status);
-      });
+      }, priority, prescale_factor, postscale_factor,
+      static_cast<ReduceOp>(reduce_op), process_set_id,
+      static_cast<Compression>(compression), accumulate);
   ThrowIfError(enqueue_result);
 
   return handle;
 }
 
+std::vector<int> DoGroupedAllreduce(const std::vector<::torch::Tensor>& tensors,
+                                    const std::vector<::torch::Tensor>& outputs,
+                                    int average, const std::string& name,
+                                    int priority, double prescale_factor,
+                                    double postscale_factor, int reduce_op,
+                                    int compression) {
+  ThrowIfError(common::CheckInitialized());
+  AverageInPostscale(tensors[0], horovod_size(), average, postscale_factor);
+
+  auto device = GetDeviceID(tensors[0]);
+  auto ready_event = RecordReadyEvent(device);
+
+  std::vector<int> handles;
+  std::vector<std::shared_ptr<OpContext>> hvd_contexts;
+  std::vector<std::shared_ptr<Tensor>> hvd_tensors;
+  std::vector<std::shared_ptr<Tensor>> hvd_outputs;
+  std::vector<std::shared_ptr<common::ReadyEvent>> ready_events;
+  std::vector<std::string> names;
+  std::vector<StatusCallback> callbacks;
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    auto handle = handle_manager.AllocateHandle();
+    auto output = outputs[i];
+    handles.push_back(handle);
+    hvd_contexts.push_back(std::make_shared<TorchOpContext>(device, output));
+    hvd_tensors.push_back(std::make_shared<TorchTensor>(tensors[i]));
+    hvd_outputs.push_back(std::make_shared<TorchTensor>(output));
+    ready_events.push_back(ready_event);
+    callbacks.push_back([handle, average, output](const Status& status) mutable {
+      // Will execute in the `device` context.
+      if (average) {
+        output.div_(horovod_size());
+      }
+      handle_manager.MarkDone(handle, status);
+    });
+  }
+  auto group_name = GetOpName("grouped_allreduce", name, handles[0]);
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    names.push_back(group_name + "." + std::to_string(i));
+  }
+
+  auto enqueue_result = EnqueueTensorAllreduces(
+      hvd_contexts, hvd_tensors, hvd_outputs, ready_events, names, group_name,
+      device, callbacks, priority, prescale_factor, postscale_factor,
+      static_cast<ReduceOp>(reduce_op), static_cast<Compression>(compression));
+  ThrowIfError(enqueue_result);
+
+  return handles;
+}
+
+std::vector<int>
+DoGroupedAllreduceCudaOnCPU(const std::vector<::torch::Tensor>& tensors,
+                            const std::vector<::torch::Tensor>& outputs,
+                            int average, const std::string& name, int priority,
+                            double prescale_factor, double postscale_factor,
+                            int reduce_op, int compression) {
+  ThrowIfError(common::CheckInitialized());
+  AverageInPostscale(tensors[0], horovod_size(), average, postscale_factor);
+
+  // Stage the input tensors in pinned host memory. The copies are queued on
+  // one side stream, so the event of the last one covers all of them.
+  auto device = GetDeviceID(tensors[0]);
+  std::vector<std::shared_ptr<HostStaging>> stagings;
+  for (auto& tensor : tensors) {
+    stagings.push_back(std::make_shared<HostStaging>(tensor));
+  }
+  auto ready_event = stagings.back()->ready_event();
+
+  std::vector<int> handles;
+  std::vector<std::shared_ptr<OpContext>> hvd_contexts;
+  std::vector<std::shared_ptr<Tensor>> hvd_cpu_buffers;
+  std::vector<std::shared_ptr<common::ReadyEvent>> ready_events;
+  std::vector<std::string> names;
+  std::vector<StatusCallback> callbacks;
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    auto handle = handle_manager.AllocateHandle();
+    auto staging = stagings[i];
+    auto cpu_buffer = staging->host();
+    auto output = outputs[i];
+    handles.push_back(handle);
+    hvd_contexts.push_back(
+        std::make_shared<TorchOpContext>(CPU_DEVICE_ID, cpu_buffer));
+    hvd_cpu_buffers.push_back(std::make_shared<TorchTensor>(cpu_buffer));
+    ready_events.push_back(ready_event);
+    callbacks.push_back([handle, average, staging, output,
+                         device](const Status& status) mutable {
+      if (status.ok()) {
+        staging->CopyToDevice(output);
+        if (average) {
+          staging->Synchronize();
+          with_device device_guard(device);
+          output.div_(horovod_size());
+        }
+      }
+      handle_manager.MarkDone(handle, status);
+    });
+  }
+  auto group_name = GetOpName("grouped_allreduce", name, handles[0]);
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    names.push_back(group_name + "." + std::to_string(i));
+  }
+
+  auto enqueue_result = EnqueueTensorAllreduces(
+      hvd_contexts, hvd_cpu_buffers, hvd_cpu_buffers, ready_events, names,
+      group_name, CPU_DEVICE_ID, callbacks, priority, prescale_factor,
+      postscale_factor, static_cast<ReduceOp>(reduce_op),
+      static_cast<Compression>(compression));
+  ThrowIfError(enqueue_result);
+
+  return handles;
+}
+
+// Reduces the tensors in place on the current stream of their device, without
+// negotiation, so that the call can be captured into a CUDA graph.
+void DoCapturableAllreduce(const std::vector<::torch::Tensor>& tensors,
+                           int average, double prescale_factor,
+                           double postscale_factor, int reduce_op) {
+  ThrowIfError(common::CheckInitialized());
+  AverageInPostscale(tensors[0], horovod_size(), average, postscale_factor);
+
+  auto device = GetDeviceID(tensors[0]);
+  std::vector<std::shared_ptr<Tensor>> hvd_tensors;
+  for (auto& tensor : tensors) {
+    hvd_tensors.push_back(std::make_shared<TorchTensor>(tensor));
+  }
+
+  void* stream = nullptr;
+#if HAVE_CUDA
+  if (device != CPU_DEVICE_ID) {
+    stream = THCState_getCurrentStreamOnDevice(state, device);
+  }
+#endif
+  ThrowIfError(common::CapturableAllreduce(
+      hvd_tensors, hvd_tensors, device, stream, prescale_factor,
+      postscale_factor, static_cast<ReduceOp>(reduce_op)));
+
+  // Queued on the same stream, so it is captured along with the reduction.
+  if (average) {
+    for (auto& tensor : tensors) {
+      tensor.div_(horovod_size());
+    }
+  }
+}
+
 int DoAllgather(::torch::Tensor tensor, ::torch::Tensor output, const std::string& name) {
   ThrowIfError(common::CheckInitialized());
 
   auto device = GetDeviceID(tensor);
+  if (!name.empty()) {
+    ReuseAllgatherOutput(name, output);
+  }
   auto ready_event = RecordReadyEvent(device);
   auto hvd_tensor = std::make_shared<TorchTensor>(tensor);
   auto hvd_context = std::make_shared<TorchOpContext>(device, output);
@@ -133,12 +340,12 @@ int DoAllgatherCudaOnCPU(::torch::Tensor tensor, ::torch::Tensor output,
                          const std::string& name) {
   ThrowIfError(common::CheckInitialized());
 
-  // Make async copy of input tensor to CPU tensor and record completion event.
+  // Stage the input tensor in pinned host memory.
   auto device = GetDeviceID(tensor);
-  auto cpu_tensor =
-      tensor.to(::torch::Device(::torch::kCPU), /*non_blocking=*/true);
+  auto staging = std::make_shared<HostStaging>(tensor);
+  auto cpu_tensor = staging->host();
   auto hvd_cpu_tensor = std::make_shared<TorchTensor>(cpu_tensor);
-  auto ready_event = RecordReadyEvent(device);
+  auto ready_event = staging->ready_event();
 
   auto cpu_output = ::torch::empty_like(cpu_tensor);
   auto hvd_cpu_output = std::make_shared<TorchTensor>(cpu_output);
@@ -149,7 +356,8 @@ int DoAllgatherCudaOnCPU(::torch::Tensor tensor, ::torch::Tensor output,
   auto enqueue_result = EnqueueTensorAllgather(
       hvd_context, hvd_cpu_tensor, ready_event,
       GetOpName("allgather", name, handle), CPU_DEVICE_ID,
-      [handle, cpu_output, output, device](const Status& status) mutable {
+      [handle, staging, cpu_output, output,
+       device](const Status& status) mutable {
         // Since the operation was on CPU, need to perform copy with the GPU
         // device guard.
         with_device device_guard(device);
@@ -197,25 +405,87 @@ int DoBroadcastCudaOnCPU(::torch::Tensor tensor, ::torch::Tensor output, int roo
                          const std::string& name) {
   ThrowIfError(common::CheckInitialized());
 
-  // Make async copy of input tensor to CPU tensor and record completion event.
-  auto device = GetDeviceID(tensor);
-  auto cpu_buffer =
-      tensor.to(::torch::Device(::torch::kCPU), /*non_blocking=*/true);
+  // Stage the input tensor in pinned host memory, broadcast it there in
+  // place, and queue the copy back on the stream of the caller.
+  auto staging = std::make_shared<HostStaging>(tensor);
+  auto cpu_buffer = staging->host();
   auto hvd_cpu_buffer = std::make_shared<TorchTensor>(cpu_buffer);
-  auto ready_event = RecordReadyEvent(device);
 
   auto hvd_context =
       std::make_shared<TorchOpContext>(CPU_DEVICE_ID, cpu_buffer);
 
   auto handle = handle_manager.AllocateHandle();
   auto enqueue_result = EnqueueTensorBroadcast(
-      hvd_context, hvd_cpu_buffer, hvd_cpu_buffer, root_rank, ready_event,
-      GetOpName("broadcast", name, handle), CPU_DEVICE_ID,
-      [handle, cpu_buffer, output, device](const Status& status) mutable {
-        // Since the operation was on CPU, need to perform copy with the GPU
-        // device guard.
-        with_device device_guard(device);
-        output.copy_(cpu_buffer);
+      hvd_context, hvd_cpu_buffer, hvd_cpu_buffer, root_rank,
+      staging->ready_event(), GetOpName("broadcast", name, handle),
+      CPU_DEVICE_ID, [handle, staging, output](const Status& status) mutable {
+        if (status.ok()) {
+          staging->CopyToDevice(output);
+        }
+        handle_manager.MarkDone(handle, status);
+      });
+  ThrowIfError(enqueue_result);
+
+  return handle;
+}
+
+int DoReducescatter(::torch::Tensor tensor, ::torch::Tensor output,
+                    const std::string& name) {
+  ThrowIfError(common::CheckInitialized());
+
+  auto device = GetDeviceID(tensor);
+  auto ready_event = RecordReadyEvent(device);
+  auto hvd_tensor = std::make_shared<TorchTensor>(tensor);
+  auto hvd_context = std::make_shared<TorchOpContext>(device, output);
+
+  auto handle = handle_manager.AllocateHandle();
+  auto enqueue_result =
+      EnqueueTensorReducescatter(hvd_context, hvd_tensor, ready_event,
+                                 GetOpName("reducescatter", name, handle),
+                                 device, [handle](const Status& status) {
+                                   handle_manager.MarkDone(handle, status);
+                                 });
+  ThrowIfError(enqueue_result);
+
+  return handle;
+}
+
+int DoAlltoall(::torch::Tensor tensor, ::torch::Tensor splits,
+               ::torch::Tensor output, const std::string& name) {
+  ThrowIfError(common::CheckInitialized());
+
+  // An empty splits tensor splits the first dimension evenly.
+  std::vector<int64_t> splits_vec;
+  auto cpu_splits = splits.to(::torch::Device(::torch::kCPU))
+                        .to(::torch::kLong)
+                        .contiguous();
+  auto splits_data = static_cast<int64_t*>(cpu_splits.data_ptr());
+  splits_vec.assign(splits_data, splits_data + cpu_splits.numel());
+
+  auto device = GetDeviceID(tensor);
+  auto ready_event = RecordReadyEvent(device);
+  auto hvd_tensor = std::make_shared<TorchTensor>(tensor);
+  auto hvd_context = std::make_shared<TorchOpContext>(device, output);
+
+  auto handle = handle_manager.AllocateHandle();
+  auto enqueue_result =
+      EnqueueTensorAlltoall(hvd_context, hvd_tensor, splits_vec, ready_event,
+                            GetOpName("alltoall", name, handle), device,
+                            [handle](const Status& status) {
+                              handle_manager.MarkDone(handle, status);
+                            });
+  ThrowIfError(enqueue_result);
+
+  return handle;
+}
+
+int DoJoin(int device) {
+  ThrowIfError(common::CheckInitialized());
+
+  auto hvd_context = std::make_shared<TorchOpContext>(device, ::torch::Tensor());
+  auto handle = handle_manager.AllocateHandle();
+  auto enqueue_result =
+      EnqueueJoin(hvd_context, device, [handle](const Status& status) {
         handle_manager.MarkDone(handle, status);
       });
   ThrowIfError(enqueue_result);
@@ -226,13 +496,208 @@ int DoBroadcastCudaOnCPU(::torch::Tensor tensor, ::torch::Tensor output, int roo
 int PollHandle(int handle) { return handle_manager.PollHandle(handle) ? 1 : 0; }
 
 void WaitAndClear(int handle) {
-  while (!handle_manager.PollHandle(handle)) {
-    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  handle_manager.WaitHandle(handle);
+  ThrowIfError(handle_manager.ReleaseHandle(handle));
+}
+
+void WaitAllAndClear(const std::vector<int>& handles) {
+  // A handle given twice is released once, since releasing it again would
+  // throw and leak the handles after it.
+  std::vector<int> unique_handles(handles);
+  std::sort(unique_handles.begin(), unique_handles.end());
+  unique_handles.erase(
+      std::unique(unique_handles.begin(), unique_handles.end()),
+      unique_handles.end());
+  handle_manager.WaitAll(unique_handles);
+  // Release all the handles before reporting the first error, so that none
+  // of them leaks.
+  Status first_error;
+  for (auto handle : unique_handles) {
+    auto status = handle_manager.ReleaseHandle(handle);
+    if (!status.ok() && first_error.ok()) {
+      first_error = status;
+    }
   }
-  auto status = handle_manager.ReleaseHandle(handle);
-  ThrowIfError(*status);
+  ThrowIfError(first_error);
+}
+
+int WaitAny(const std::vector<int>& handles) {
+  return static_cast<int>(handle_manager.WaitAny(handles));
 }
 
+#if TORCH_VERSION >= 1004000000
+class GradAccumulatorHook : public ::torch::autograd::FunctionPostHook {
+public:
+  explicit GradAccumulatorHook(std::function<void()> fn) : fn_(std::move(fn)) {}
+
+  ::torch::autograd::variable_list
+  operator()(const ::torch::autograd::variable_list& outputs,
+             const ::torch::autograd::variable_list& inputs) override {
+    fn_();
+    return outputs;
+  }
+
+private:
+  std::function<void()> fn_;
+};
+
+// Allreduces the gradients of buckets of parameters in place from autograd
+// hooks registered in C++, so that the backward pass does not take the GIL
+// once per parameter. A bucket is enqueued as a group once the gradients of
+// all its parameters were accumulated backward_passes_per_step times.
+//
+// The hooks stay registered on the accumulators of the parameters, which may
+// outlive the reducer, so they only hold a weak reference to it.
+class Reducer {
+public:
+  static std::shared_ptr<Reducer>
+  Create(const std::vector<::torch::Tensor>& params,
+         const std::vector<std::vector<int64_t>>& buckets,
+         const std::vector<std::string>& names,
+         const std::vector<int>& priorities, int average, int reduce_op,
+         int backward_passes_per_step) {
+    std::shared_ptr<Reducer> reducer(
+        new Reducer(params, buckets, names, priorities, average, reduce_op,
+                    backward_passes_per_step));
+    std::weak_ptr<Reducer> weak_reducer = reducer;
+    for (size_t i = 0; i < params.size(); ++i) {
+      auto grad_accumulator =
+          ::torch::autograd::impl::grad_accumulator(params[i]);
+      grad_accumulator->add_post_hook(
+          std::unique_ptr<::torch::autograd::FunctionPostHook>(
+              new GradAccumulatorHook([weak_reducer, i]() {
+                if (auto reducer = weak_reducer.lock()) {
+                  reducer->MarkReady(i);
+                }
+              })));
+      // The parameters only hold weak references to their accumulators.
+      reducer->grad_accumulators_.push_back(std::move(grad_accumulator));
+    }
+    return reducer;
+  }
+
+  // Enqueues the buckets that are not complete, as the gradients of some of
+  // their parameters were not computed, and waits for all the buckets.
+  void Synchronize() {
+    std::vector<int> handles;
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      for (size_t b = 0; b < buckets_.size(); ++b) {
+        if (handles_[b].empty()) {
+          Enqueue(b);
+        }
+        handles.insert(handles.end(), handles_[b].begin(), handles_[b].end());
+        handles_[b].clear();
+        ready_[b] = 0;
+      }
+      delays_.assign(params_.size(), backward_passes_per_step_);
+    }
+    WaitAllAndClear(handles);
+  }
+
+  bool Pending() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    for (size_t i = 0; i < params_.size(); ++i) {
+      if (delays_[i] != backward_passes_per_step_) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void SetBackwardPassesPerStep(int passes) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    backward_passes_per_step_ = passes;
+    delays_.assign(params_.size(), passes);
+  }
+
+private:
+  Reducer(const std::vector<::torch::Tensor>& params,
+          const std::vector<std::vector<int64_t>>& buckets,
+          const std::vector<std::string>& names,
+          const std::vector<int>& priorities, int average, int reduce_op,
+          int backward_passes_per_step)
+      : params_(params), buckets_(buckets), names_(names),
+        priorities_(priorities), average_(average), reduce_op_(reduce_op),
+        backward_passes_per_step_(backward_passes_per_step) {
+    param_bucket_.resize(params_.size());
+    delays_.assign(params_.size(), backward_passes_per_step_);
+    for (size_t b = 0; b < buckets_.size(); ++b) {
+      for (auto i : buckets_[b]) {
+        param_bucket_[i] = b;
+      }
+    }
+    ready_.assign(buckets_.size(), 0);
+    handles_.resize(buckets_.size());
+  }
+
+  // Called by the autograd engine, on the thread of the device of the
+  // parameter, after its gradient was accumulated.
+  void MarkReady(size_t i) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (delays_[i] <= 0) {
+      throw std::logic_error(
+          "Gradients were computed more than backward_passes_per_step times "
+          "before call to step(). Increase backward_passes_per_step to "
+          "accumulate gradients locally.");
+    }
+    if (--delays_[i] > 0) {
+      return;
+    }
+    auto b = param_bucket_[i];
+    if (++ready_[b] == buckets_[b].size()) {
+      Enqueue(b);
+    }
+  }
+
+  // Parameters whose gradient was not computed, or was set to None, take
+  // part with zeros, so that the groups are the same on all ranks.
+  void Enqueue(size_t b) {
+    std::vector<::torch::Tensor> grads;
+    for (auto i : buckets_[b]) {
+      if (!params_[i].grad().defined()) {
+#if TORCH_VERSION >= 1005000000
+        params_[i].mutable_grad() = ::torch::zeros_like(params_[i]);
+#else
+        params_[i].grad() = ::torch::zeros_like(params_[i]);
+#endif
+      }
+      grads.push_back(params_[i].grad());
+    }
+#if HOROVOD_GPU_ALLREDUCE
+    handles_[b] = DoGroupedAllreduce(grads, grads, average_, names_[b],
+                                     priorities_[b], 1.0, 1.0, reduce_op_, 0);
+#else
+    handles_[b] = grads[0].is_cuda()
+                      ? DoGroupedAllreduceCudaOnCPU(
+                            grads, grads, average_, names_[b], priorities_[b],
+                            1.0, 1.0, reduce_op_, 0)
+                      : DoGroupedAllreduce(grads, grads, average_, names_[b],
+                                           priorities_[b], 1.0, 1.0,
+                                           reduce_op_, 0);
+#endif
+  }
+
+  std::vector<::torch::Tensor> params_;
+  std::vector<std::vector<int64_t>> buckets_;
+  std::vector<std::string> names_;
+  std::vector<int> priorities_;
+  int average_;
+  int reduce_op_;
+  int backward_passes_per_step_;
+
+  std::vector<std::shared_ptr<::torch::autograd::Node>> grad_accumulators_;
+  std::vector<size_t> param_bucket_;
+  std::mutex mutex_;
+  // Backward passes left before the gradient of each parameter is reduced.
+  std::vector<int> delays_;
+  // Parameters of each bucket whose gradients are ready.
+  std::vector<size_t> ready_;
+  // Handles of the enqueued buckets, empty for the others.
+  std::vector<std::vector<int>> handles_;
+};
+#endif
+
 PYBIND11_MODULE(mpi_lib_v2, m) {
   // allreduce
   m.def("horovod_torch_allreduce_async_torch_IntTensor", &DoAllreduce);
@@ -240,12 +705,19 @@ PYBIND11_MODULE(mpi_lib_v2, m) {
   m.def("horovod_torch_allreduce_async_torch_HalfTensor", &DoAllreduce);
   m.def("horovod_torch_allreduce_async_torch_FloatTensor", &DoAllreduce);
   m.def("horovod_torch_allreduce_async_torch_DoubleTensor", &DoAllreduce);
+#if TORCH_VERSION >= 1003000000
+  m.def("horovod_torch_allreduce_async_torch_BFloat16Tensor", &DoAllreduce);
+#endif
 #if HOROVOD_GPU_ALLREDUCE
   m.def("horovod_torch_allreduce_async_torch_cuda_IntTensor", &DoAllreduce);
   m.def("horovod_torch_allreduce_async_torch_cuda_LongTensor", &DoAllreduce);
   m.def("horovod_torch_allreduce_async_torch_cuda_HalfTensor", &DoAllreduce);
   m.def("horovod_torch_allreduce_async_torch_cuda_FloatTensor", &DoAllreduce);
   m.def("horovod_torch_allreduce_async_torch_cuda_DoubleTensor", &DoAllreduce);
+#if TORCH_VERSION >= 1003000000
+  m.def("horovod_torch_allreduce_async_torch_cuda_BFloat16Tensor",
+        &DoAllreduce);
+#endif
 #else
   m.def("horovod_torch_allreduce_async_torch_cuda_IntTensor",
         &DoAllreduceCudaOnCPU);
@@ -257,6 +729,28 @@ PYBIND11_MODULE(mpi_lib_v2, m) {
         &DoAllreduceCudaOnCPU);
   m.def("horovod_torch_allreduce_async_torch_cuda_DoubleTensor",
         &DoAllreduceCudaOnCPU);
+#if TORCH_VERSION >= 1003000000
+  m.def("horovod_torch_allreduce_async_torch_cuda_BFloat16Tensor",
+        &DoAllreduceCudaOnCPU);
+#endif
+#endif
+
+  // grouped allreduce
+  m.def("horovod_torch_grouped_allreduce_async", &DoGroupedAllreduce);
+#if HOROVOD_GPU_ALLREDUCE
+  m.def("horovod_torch_grouped_allreduce_async_cuda", &DoGroupedAllreduce);
+#else
+  m.def("horovod_torch_grouped_allreduce_async_cuda",
+        &DoGroupedAllreduceCudaOnCPU);
+#endif
+  m.def("horovod_torch_capturable_allreduce_", &DoCapturableAllreduce);
+#if TORCH_VERSION >= 1004000000
+  pybind11::class_<Reducer, std::shared_ptr<Reducer>>(m, "Reducer")
+      .def(pybind11::init(&Reducer::Create))
+      .def("synchronize", &Reducer::Synchronize,
+           pybind11::call_guard<pybind11::gil_scoped_release>())
+      .def("pending", &Reducer::Pending)
+      .def("set_backward_passes_per_step", &Reducer::SetBackwardPassesPerStep);
 #endif
 
   // allgather
@@ -268,6 +762,9 @@ PYBIND11_MODULE(mpi_lib_v2, m) {
   m.def("horovod_torch_allgather_async_torch_HalfTensor", &DoAllgather);
   m.def("horovod_torch_allgather_async_torch_FloatTensor", &DoAllgather);
   m.def("horovod_torch_allgather_async_torch_DoubleTensor", &DoAllgather);
+#if TORCH_VERSION >= 1003000000
+  m.def("horovod_torch_allgather_async_torch_BFloat16Tensor", &DoAllgather);
+#endif
 #if HOROVOD_GPU_ALLGATHER
   m.def("horovod_torch_allgather_async_torch_cuda_ByteTensor", &DoAllgather);
   m.def("horovod_torch_allgather_async_torch_cuda_CharTensor", &DoAllgather);
@@ -277,6 +774,10 @@ PYBIND11_MODULE(mpi_lib_v2, m) {
   m.def("horovod_torch_allgather_async_torch_cuda_HalfTensor", &DoAllgather);
   m.def("horovod_torch_allgather_async_torch_cuda_FloatTensor", &DoAllgather);
   m.def("horovod_torch_allgather_async_torch_cuda_DoubleTensor", &DoAllgather);
+#if TORCH_VERSION >= 1003000000
+  m.def("horovod_torch_allgather_async_torch_cuda_BFloat16Tensor",
+        &DoAllgather);
+#endif
 #else
   m.def("horovod_torch_allgather_async_torch_cuda_ByteTensor",
         &DoAllgatherCudaOnCPU);
@@ -294,6 +795,10 @@ PYBIND11_MODULE(mpi_lib_v2, m) {
         &DoAllgatherCudaOnCPU);
   m.def("horovod_torch_allgather_async_torch_cuda_DoubleTensor",
         &DoAllgatherCudaOnCPU);
+#if TORCH_VERSION >= 1003000000
+  m.def("horovod_torch_allgather_async_torch_cuda_BFloat16Tensor",
+        &DoAllgatherCudaOnCPU);
+#endif
 #endif
 
   // broadcast
@@ -305,6 +810,9 @@ PYBIND11_MODULE(mpi_lib_v2, m) {
   m.def("horovod_torch_broadcast_async_torch_HalfTensor", &DoBroadcast);
   m.def("horovod_torch_broadcast_async_torch_FloatTensor", &DoBroadcast);
   m.def("horovod_torch_broadcast_async_torch_DoubleTensor", &DoBroadcast);
+#if TORCH_VERSION >= 1003000000
+  m.def("horovod_torch_broadcast_async_torch_BFloat16Tensor", &DoBroadcast);
+#endif
 #if HOROVOD_GPU_BROADCAST
   m.def("horovod_torch_broadcast_async_torch_cuda_ByteTensor", &DoBroadcast);
   m.def("horovod_torch_broadcast_async_torch_cuda_CharTensor", &DoBroadcast);
@@ -314,6 +822,10 @@ PYBIND11_MODULE(mpi_lib_v2, m) {
   m.def("horovod_torch_broadcast_async_torch_cuda_HalfTensor", &DoBroadcast);
   m.def("horovod_torch_broadcast_async_torch_cuda_FloatTensor", &DoBroadcast);
   m.def("horovod_torch_broadcast_async_torch_cuda_DoubleTensor", &DoBroadcast);
+#if TORCH_VERSION >= 1003000000
+  m.def("horovod_torch_broadcast_async_torch_cuda_BFloat16Tensor",
+        &DoBroadcast);
+#endif
 #else
   m.def("horovod_torch_broadcast_async_torch_cuda_ByteTensor",
         &DoBroadcastCudaOnCPU);
@@ -331,11 +843,73 @@ PYBIND11_MODULE(mpi_lib_v2, m) {
         &DoBroadcastCudaOnCPU);
   m.def("horovod_torch_broadcast_async_torch_cuda_DoubleTensor",
         &DoBroadcastCudaOnCPU);
+#if TORCH_VERSION >= 1003000000
+  m.def("horovod_torch_broadcast_async_torch_cuda_BFloat16Tensor",
+        &DoBroadcastCudaOnCPU);
+#endif
+#endif
+
+  // reducescatter
+  m.def("horovod_torch_reducescatter_async_torch_IntTensor", &DoReducescatter);
+  m.def("horovod_torch_reducescatter_async_torch_LongTensor", &DoReducescatter);
+  m.def("horovod_torch_reducescatter_async_torch_HalfTensor", &DoReducescatter);
+  m.def("horovod_torch_reducescatter_async_torch_FloatTensor",
+        &DoReducescatter);
+  m.def("horovod_torch_reducescatter_async_torch_DoubleTensor",
+        &DoReducescatter);
+#if TORCH_VERSION >= 1003000000
+  m.def("horovod_torch_reducescatter_async_torch_BFloat16Tensor",
+        &DoReducescatter);
 #endif
+#if HOROVOD_GPU_ALLREDUCE == 'N'
+  m.def("horovod_torch_reducescatter_async_torch_cuda_IntTensor",
+        &DoReducescatter);
+  m.def("horovod_torch_reducescatter_async_torch_cuda_LongTensor",
+        &DoReducescatter);
+  m.def("horovod_torch_reducescatter_async_torch_cuda_HalfTensor",
+        &DoReducescatter);
+  m.def("horovod_torch_reducescatter_async_torch_cuda_FloatTensor",
+        &DoReducescatter);
+  m.def("horovod_torch_reducescatter_async_torch_cuda_DoubleTensor",
+        &DoReducescatter);
+#endif
+
+  // alltoall
+  m.def("horovod_torch_alltoall_async_torch_ByteTensor", &DoAlltoall);
+  m.def("horovod_torch_alltoall_async_torch_CharTensor", &DoAlltoall);
+  m.def("horovod_torch_alltoall_async_torch_ShortTensor", &DoAlltoall);
+  m.def("horovod_torch_alltoall_async_torch_IntTensor", &DoAlltoall);
+  m.def("horovod_torch_alltoall_async_torch_LongTensor", &DoAlltoall);
+  m.def("horovod_torch_alltoall_async_torch_HalfTensor", &DoAlltoall);
+  m.def("horovod_torch_alltoall_async_torch_FloatTensor", &DoAlltoall);
+  m.def("horovod_torch_alltoall_async_torch_DoubleTensor", &DoAlltoall);
+#if TORCH_VERSION >= 1003000000
+  m.def("horovod_torch_alltoall_async_torch_BFloat16Tensor", &DoAlltoall);
+#endif
+#if HOROVOD_GPU_ALLREDUCE == 'N'
+  m.def("horovod_torch_alltoall_async_torch_cuda_ByteTensor", &DoAlltoall);
+  m.def("horovod_torch_alltoall_async_torch_cuda_CharTensor", &DoAlltoall);
+  m.def("horovod_torch_alltoall_async_torch_cuda_ShortTensor", &DoAlltoall);
+  m.def("horovod_torch_alltoall_async_torch_cuda_IntTensor", &DoAlltoall);
+  m.def("horovod_torch_alltoall_async_torch_cuda_LongTensor", &DoAlltoall);
+  m.def("horovod_torch_alltoall_async_torch_cuda_HalfTensor", &DoAlltoall);
+  m.def("horovod_torch_alltoall_async_torch_cuda_FloatTensor", &DoAlltoall);
+  m.def("horovod_torch_alltoall_async_torch_cuda_DoubleTensor", &DoAlltoall);
+#endif
+
+  // join
+  m.def("horovod_torch_join", &DoJoin);
 
   // basics
   m.def("horovod_torch_poll", &PollHandle);
-  m.def("horovod_torch_wait_and_clear", &WaitAndClear);
+  // Waiting does not need the GIL, so that other Python threads can enqueue
+  // operations in the meantime.
+  m.def("horovod_torch_wait_and_clear", &WaitAndClear,
+        pybind11::call_guard<pybind11::gil_scoped_release>());
+  m.def("horovod_torch_wait_all_and_clear", &WaitAllAndClear,
+        pybind11::call_guard<pybind11::gil_scoped_release>());
+  m.def("horovod_torch_wait_any", &WaitAny,
+        pybind11::call_guard<pybind11::gil_scoped_release>());
 }
 
 } // namespace torch
@@ -39,7 +39,12 @@ struct ReadyEventRegistry {
 
 static ReadyEventRegistry ready_event_registry;
 
-TorchReadyEvent::TorchReadyEvent(int device) : device_(device) {
+TorchReadyEvent::TorchReadyEvent(int device)
+    : TorchReadyEvent(device,
+                      THCState_getCurrentStreamOnDevice(state, device)) {}
+
+TorchReadyEvent::TorchReadyEvent(int device, cudaStream_t stream)
+    : device_(device) {
   assert(device_ != CPU_DEVICE_ID);
 
   with_device device_context(device_);
@@ -54,7 +59,6 @@ TorchReadyEvent::TorchReadyEvent(int device) : device_(device) {
           &cuda_event_, cudaEventBlockingSync | cudaEventDisableTiming));
     }
   }
-  auto stream = THCState_getCurrentStreamOnDevice(state, device_);
   THCudaCheck(cudaEventRecord(cuda_event_, stream));
 }
 
@@ -74,6 +78,10 @@ bool TorchReadyEvent::Ready() const {
   THCudaCheck(status);
   return true;
 }
+
+cudaEvent_t TorchReadyEvent::CudaEvent() const {
+  return cuda_event_;
+}
 #endif
 
 // On GPU this event will signal that GPU computations are done and data is
@@ -91,5 +99,11 @@ std::shared_ptr<ReadyEvent> RecordReadyEvent(int device) {
   }
 }
 
+#if HAVE_CUDA
+std::shared_ptr<ReadyEvent> RecordReadyEvent(int device, cudaStream_t stream) {
+  return std::make_shared<TorchReadyEvent>(device, stream);
+}
+#endif
+
 } // namespace torch
 } // namespace horovod
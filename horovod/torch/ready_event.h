@@ -33,8 +33,10 @@ using namespace horovod::common;
 class TorchReadyEvent : public ReadyEvent {
 public:
   TorchReadyEvent(int device);
+  TorchReadyEvent(int device, cudaStream_t stream);
   ~TorchReadyEvent();
   virtual bool Ready() const override;
+  virtual cudaEvent_t CudaEvent() const override;
 
 private:
   int device_ = CPU_DEVICE_ID;
@@ -43,6 +45,10 @@ private:
 #endif
 
 std::shared_ptr<ReadyEvent> RecordReadyEvent(int device);
+#if HAVE_CUDA
+// Records the event on the given stream instead of the current one.
+std::shared_ptr<ReadyEvent> RecordReadyEvent(int device, cudaStream_t stream);
+#endif
 
 } // namespace torch
 } // namespace horovod
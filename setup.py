@@ -421,6 +421,32 @@ def get_cuda_dirs(build_ext, cpp_flags):
     return cuda_include_dirs, cuda_lib_dirs
 
 
+def build_cuda_kernels(build_ext, cuda_include_dirs):
+    cuda_home = os.environ.get('HOROVOD_CUDA_HOME', '/usr/local/cuda')
+    nvcc = os.path.join(cuda_home, 'bin', 'nvcc')
+    if not os.path.exists(nvcc):
+        nvcc = 'nvcc'
+
+    kernels_dir = os.path.join(build_ext.build_temp, 'cuda_kernels')
+    if not os.path.exists(kernels_dir):
+        os.makedirs(kernels_dir)
+    kernels_lib = os.path.join(kernels_dir, 'libhorovod_cuda_kernels.a')
+
+    command = [nvcc, '-O3', '-std=c++11', '-Xcompiler', '-fPIC', '-lib',
+               '-o', kernels_lib,
+               'horovod/common/ops/cuda/cuda_kernels.cu']
+    command += ['-I%s' % include_dir for include_dir in cuda_include_dirs]
+    try:
+        subprocess.check_call(command)
+    except (OSError, subprocess.CalledProcessError):
+        raise DistutilsPlatformError(
+            'Unable to compile Horovod CUDA kernels with %s (see error above).\n'
+            'Please make sure nvcc is installed in $HOROVOD_CUDA_HOME/bin.'
+            % nvcc)
+
+    return kernels_dir
+
+
 def get_nccl_vals(build_ext, cuda_include_dirs, cuda_lib_dirs, cpp_flags):
     nccl_include_dirs = []
     nccl_lib_dirs = []
@@ -577,19 +603,22 @@ def get_common_options(build_ext):
 
     gpu_allreduce = os.environ.get('HOROVOD_GPU_ALLREDUCE')
     if gpu_allreduce and gpu_allreduce != 'MPI' and gpu_allreduce != 'NCCL' and \
-        gpu_allreduce != 'DDL':
+        gpu_allreduce != 'DDL' and gpu_allreduce != 'GLOO':
         raise DistutilsError('HOROVOD_GPU_ALLREDUCE=%s is invalid, supported '
-                             'values are "", "MPI", "NCCL", "DDL".' % gpu_allreduce)
+                             'values are "", "MPI", "NCCL", "DDL", "GLOO".' % gpu_allreduce)
+    if gpu_allreduce == 'GLOO' and not have_gloo:
+        raise DistutilsError('HOROVOD_GPU_ALLREDUCE=GLOO requires Horovod to be '
+                             'built with Gloo.')
 
     gpu_allgather = os.environ.get('HOROVOD_GPU_ALLGATHER')
-    if gpu_allgather and gpu_allgather != 'MPI':
+    if gpu_allgather and gpu_allgather != 'MPI' and gpu_allgather != 'NCCL':
         raise DistutilsError('HOROVOD_GPU_ALLGATHER=%s is invalid, supported '
-                             'values are "", "MPI".' % gpu_allgather)
+                             'values are "", "MPI", "NCCL".' % gpu_allgather)
 
     gpu_broadcast = os.environ.get('HOROVOD_GPU_BROADCAST')
-    if gpu_broadcast and gpu_broadcast != 'MPI':
+    if gpu_broadcast and gpu_broadcast != 'MPI' and gpu_broadcast != 'NCCL':
         raise DistutilsError('HOROVOD_GPU_BROADCAST=%s is invalid, supported '
-                             'values are "", "MPI".' % gpu_broadcast)
+                             'values are "", "MPI", "NCCL".' % gpu_broadcast)
 
     if gpu_allreduce or gpu_allgather or gpu_broadcast:
         have_cuda = True
@@ -598,7 +627,8 @@ def get_common_options(build_ext):
         have_cuda = False
         cuda_include_dirs = cuda_lib_dirs = []
 
-    if gpu_allreduce == 'NCCL':
+    if gpu_allreduce == 'NCCL' or gpu_allgather == 'NCCL' or \
+            gpu_broadcast == 'NCCL':
         have_nccl = True
         nccl_include_dirs, nccl_lib_dirs, nccl_libs = get_nccl_vals(
             build_ext, cuda_include_dirs, cuda_lib_dirs, cpp_flags)
@@ -644,24 +674,39 @@ def get_common_options(build_ext):
     SOURCES = ['horovod/common/common.cc',
                'horovod/common/controller.cc',
                'horovod/common/fusion_buffer_manager.cc',
+               'horovod/common/half.cc',
                'horovod/common/logging.cc',
                'horovod/common/message.cc',
                'horovod/common/operations.cc',
                'horovod/common/parameter_manager.cc',
+               'horovod/common/process_set.cc',
+               'horovod/common/request_trace.cc',
                'horovod/common/response_cache.cc',
+               'horovod/common/response_queue.cc',
+               'horovod/common/shared_memory.cc',
                'horovod/common/stall_inspector.cc',
                'horovod/common/timeline.cc',
+               'horovod/common/topology.cc',
                'horovod/common/tensor_queue.cc',
+               'horovod/common/thread_pool.cc',
+               'horovod/common/metrics.cc',
                'horovod/common/ops/collective_operations.cc',
                'horovod/common/ops/operation_manager.cc',
+               'horovod/common/ops/quantized_operations.cc',
+               'horovod/common/ops/sparse_operations.cc',
                'horovod/common/optim/bayesian_optimization.cc',
                'horovod/common/optim/gaussian_process.cc',
-               'horovod/common/utils/env_parser.cc'
+               'horovod/common/utils/env_parser.cc',
+               'horovod/common/utils/huge_pages.cc'
                ]
     COMPILE_FLAGS = cpp_flags + shlex.split(mpi_flags)
     LINK_FLAGS = link_flags + shlex.split(mpi_flags)
     LIBRARY_DIRS = []
     LIBRARIES = []
+    GLOO_CMAKE_ARGS = []
+    if not is_mac:
+        # shm_open() lives in librt on older glibc.
+        LIBRARIES += ['rt']
 
     cpu_operation = os.environ.get('HOROVOD_CPU_OPERATIONS')
     if cpu_operation:
@@ -685,9 +730,9 @@ def get_common_options(build_ext):
 
     if have_mpi:
         MACROS += [('HAVE_MPI', '1')]
-        SOURCES += ['horovod/common/half.cc',
-                    'horovod/common/mpi/mpi_context.cc',
+        SOURCES += ['horovod/common/mpi/mpi_context.cc',
                     'horovod/common/mpi/mpi_controller.cc',
+                    'horovod/common/ops/adasum_operations.cc',
                     'horovod/common/ops/mpi_operations.cc']
         COMPILE_FLAGS += shlex.split(mpi_flags)
         LINK_FLAGS += shlex.split(mpi_flags)
@@ -700,6 +745,15 @@ def get_common_options(build_ext):
                     'horovod/common/gloo/http_store.cc',
                     'horovod/common/gloo/memory_store.cc',
                     'horovod/common/ops/gloo_operations.cc']
+        # Transports besides TCP, which need their libraries at build time.
+        if os.environ.get('HOROVOD_GLOO_WITH_IBVERBS'):
+            MACROS += [('HAVE_GLOO_IBVERBS', '1')]
+            LIBRARIES += ['ibverbs']
+            GLOO_CMAKE_ARGS += ['-DUSE_IBVERBS=ON']
+        if os.environ.get('HOROVOD_GLOO_WITH_UV'):
+            MACROS += [('HAVE_GLOO_UV', '1')]
+            LIBRARIES += ['uv']
+            GLOO_CMAKE_ARGS += ['-DUSE_LIBUV=ON']
 
     if have_mlsl:
         MACROS += [('HAVE_MLSL', '1')]
@@ -714,8 +768,11 @@ def get_common_options(build_ext):
         SOURCES += ['horovod/common/ops/cuda_operations.cc']
         if have_mpi:
             SOURCES += ['horovod/common/ops/mpi_cuda_operations.cc']
+        if have_gloo:
+            SOURCES += ['horovod/common/ops/gloo_cuda_operations.cc']
+        LIBRARY_DIRS += [build_cuda_kernels(build_ext, cuda_include_dirs)]
         LIBRARY_DIRS += cuda_lib_dirs
-        LIBRARIES += ['cudart']
+        LIBRARIES += ['horovod_cuda_kernels', 'cudart']
 
     if have_nccl:
         MACROS += [('HAVE_NCCL', '1')]
@@ -749,6 +806,7 @@ def get_common_options(build_ext):
                 LIBRARY_DIRS=LIBRARY_DIRS,
                 LIBRARIES=LIBRARIES,
                 BUILD_GLOO=have_gloo,
+                GLOO_CMAKE_ARGS=GLOO_CMAKE_ARGS,
                 BUILD_MPI=have_mpi,
                 )
 
@@ -843,6 +901,20 @@ def filter_compile_macros(compile_flags):
     return res
 
 
+def has_tf_xla():
+    import tensorflow as tf
+    return os.path.exists(os.path.join(
+        tf.sysconfig.get_include(),
+        'tensorflow/compiler/xla/service/custom_call_target_registry.h'))
+
+
+def get_tf_xla_link_flags():
+    import tensorflow as tf
+    python_dir = os.path.join(os.path.dirname(tf.__file__), 'python')
+    return ['-L%s' % python_dir, '-l:_pywrap_tensorflow_internal.so',
+            '-Wl,-rpath,%s' % python_dir]
+
+
 def build_tf_extension(build_ext, global_options):
     # Backup the options, preventing other plugins access libs that
     # compiled with compiler of this plugin
@@ -854,13 +926,22 @@ def build_tf_extension(build_ext, global_options):
 
     gloo_compile_macros = filter_compile_macros(tf_compile_flags)
 
+    tf_sources = ['horovod/tensorflow/mpi_ops.cc']
+    tf_xla_link_flags = []
+    if check_macro(options['MACROS'], 'HAVE_CUDA') and has_tf_xla():
+        # XLA custom calls are only registered for GPU. The XLA op registry
+        # lives in the TensorFlow Python extension.
+        options['MACROS'] += [('HAVE_XLA_OPS', '1')]
+        tf_sources += ['horovod/tensorflow/xla_mpi_ops.cc']
+        tf_xla_link_flags = get_tf_xla_link_flags()
+
     tensorflow_mpi_lib.define_macros = options['MACROS']
     tensorflow_mpi_lib.include_dirs = options['INCLUDES']
-    tensorflow_mpi_lib.sources = options['SOURCES'] + \
-                                 ['horovod/tensorflow/mpi_ops.cc']
+    tensorflow_mpi_lib.sources = options['SOURCES'] + tf_sources
     tensorflow_mpi_lib.extra_compile_args = options['COMPILE_FLAGS'] + \
                                             tf_compile_flags
-    tensorflow_mpi_lib.extra_link_args = options['LINK_FLAGS'] + tf_link_flags
+    tensorflow_mpi_lib.extra_link_args = options['LINK_FLAGS'] + tf_link_flags + \
+                                         tf_xla_link_flags
 
     tensorflow_mpi_lib.library_dirs = options['LIBRARY_DIRS']
     tensorflow_mpi_lib.libraries = options['LIBRARIES']
@@ -1019,8 +1100,10 @@ def build_mx_extension(build_ext, global_options):
         options['SOURCES'] += ['horovod/common/ops/cuda_operations.cc']
         if options['BUILD_MPI']:
             options['SOURCES'] += ['horovod/common/ops/mpi_cuda_operations.cc']
+        options['LIBRARY_DIRS'] += [build_cuda_kernels(build_ext,
+                                                       cuda_include_dirs)]
         options['LIBRARY_DIRS'] += cuda_lib_dirs
-        options['LIBRARIES'] += ['cudart']
+        options['LIBRARIES'] += ['horovod_cuda_kernels', 'cudart']
 
     mxnet_mpi_lib.define_macros = options['MACROS']
     if check_macro(options['MACROS'], 'HAVE_CUDA'):
@@ -1252,6 +1335,7 @@ def build_torch_extension_v2(build_ext, global_options, torch_version):
                             'horovod/torch/handle_manager.cc',
                             'horovod/torch/ready_event.cc',
                             'horovod/torch/cuda_util.cc',
+                            'horovod/torch/host_staging.cc',
                             'horovod/torch/adapter_v2.cc'],
                         extra_compile_args=options['COMPILE_FLAGS'],
                         extra_link_args=options['LINK_FLAGS'],
@@ -1333,7 +1417,7 @@ def build_cmake(build_ext, ext, prefix, additional_flags, options, plugin_ext=No
                   '-DCMAKE_LIBRARY_OUTPUT_DIRECTORY_{}={}'.format(config.upper(), extdir),
                   '-DCMAKE_ARCHIVE_OUTPUT_DIRECTORY_{}={}'.format(config.upper(),
                                                                   lib_output_dir),
-                  ]
+                  ] + options['GLOO_CMAKE_ARGS']
 
     cmake_build_args = [
         '--config', config,
@@ -1360,6 +1444,61 @@ def build_cmake(build_ext, ext, prefix, additional_flags, options, plugin_ext=No
         plugin_ext.libraries.append(ext.name)
 
 
+# Benchmark executables and their sources besides the core library.
+BENCHMARKS = {
+    'horovod_common_benchmarks': ['horovod/common/benchmarks/common_benchmarks.cc'],
+    'hvd_bench': ['horovod/common/benchmarks/hvd_bench.cc'],
+    'hvd_controller_sim': ['horovod/common/benchmarks/hvd_controller_sim.cc'],
+}
+
+# Benchmarks that run collectives across processes, which need MPI to launch
+# without the Gloo library.
+MPI_BENCHMARKS = ['hvd_bench']
+
+
+def build_benchmarks(build_ext, global_options):
+    # The benchmarks are linked without Gloo, whose library is only built for
+    # the framework plugins, so the collective ones are launched with mpirun.
+    options = deepcopy(global_options)
+    macros = [macro for macro in options['MACROS'] if macro[0] != 'HAVE_GLOO']
+    have_mpi = ('HAVE_MPI', '1') in macros
+    sources = [source for source in options['SOURCES']
+               if not source.startswith('horovod/common/gloo/') and
+               source != 'horovod/common/ops/gloo_operations.cc']
+    sources += ['horovod/common/benchmarks/benchmark.cc',
+                'horovod/common/benchmarks/mock_controller.cc']
+    # The version script only applies to the plugins.
+    link_flags = [flag for flag in options['LINK_FLAGS']
+                  if 'version-script' not in flag and
+                  'exported_symbols_list' not in flag]
+
+    output_dir = os.path.join(build_ext.build_temp, 'benchmarks')
+    customize_compiler(build_ext.compiler)
+    objects = build_ext.compiler.compile(sources,
+                                         output_dir=output_dir,
+                                         macros=macros,
+                                         include_dirs=options['INCLUDES'],
+                                         extra_postargs=options['COMPILE_FLAGS'])
+    for name, benchmark_sources in BENCHMARKS.items():
+        if name in MPI_BENCHMARKS and not have_mpi:
+            print('INFO: Skipping benchmark %s, which requires MPI' % name)
+            continue
+        benchmark_objects = build_ext.compiler.compile(
+            benchmark_sources,
+            output_dir=output_dir,
+            macros=macros,
+            include_dirs=options['INCLUDES'],
+            extra_postargs=options['COMPILE_FLAGS'])
+        build_ext.compiler.link_executable(
+            objects + benchmark_objects, name,
+            output_dir=output_dir,
+            libraries=options['LIBRARIES'] + ['pthread'],
+            library_dirs=options['LIBRARY_DIRS'],
+            extra_postargs=link_flags,
+            target_lang='c++')
+        print('INFO: Built benchmark %s' % os.path.join(output_dir, name))
+
+
 # run the customize_compiler
 class custom_build_ext(build_ext):
     def build_extensions(self):
@@ -1416,6 +1555,8 @@ class custom_build_ext(build_ext):
         if not any(built_plugins):
             raise DistutilsError(
                 'None of TensorFlow, PyTorch, or MXNet plugins were built. See errors above.')
+        if os.environ.get('HOROVOD_BUILD_BENCHMARKS'):
+            build_benchmarks(self, options)
 
 
 require_list = ['cloudpickle', 'psutil', 'six']
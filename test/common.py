@@ -19,6 +19,10 @@ from __future__ import division
 from __future__ import print_function
 
 import os
+import unittest
+import warnings
+
+from horovod.common.util import env
 
 
 def mpi_env_rank_and_size():
@@ -54,3 +58,21 @@ def mpi_env_rank_and_size():
 
     # Default to rank zero and size one if there are no environment variables
     return 0, 1
+
+
+class EnvTestCase(unittest.TestCase):
+    """
+    Base of the tests of settings that Horovod reads from the environment
+    when it is initialized. They are read once per process, and every test
+    file runs in a process of its own, so each set of settings has a file.
+    """
+
+    def __init__(self, *args, **kwargs):
+        super(EnvTestCase, self).__init__(*args, **kwargs)
+        warnings.simplefilter('module')
+
+    def init_horovod(self, hvd, **settings):
+        """Initialize hvd with the environment variables in settings set,
+        restoring them afterwards."""
+        with env(**settings):
+            hvd.init()
@@ -0,0 +1,68 @@
+# Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+import time
+import torch
+
+import horovod.torch as hvd
+
+from common import EnvTestCase
+
+
+class BufferMemoryBudgetTests(EnvTestCase):
+    """
+    Tests for HOROVOD_BUFFER_MEMORY_BUDGET and HOROVOD_BUFFER_IDLE_CYCLES.
+    """
+
+    def test_buffer_memory_budget(self):
+        """Test that fused allreduces stay correct and within the budget, and
+        that the buffers are released once idle."""
+        # With a fusion threshold below 1 MB every buffer is 1 MB. The budget
+        # holds the buffers of one stream, while four streams would need four.
+        self.init_horovod(hvd, HOROVOD_FUSION_THRESHOLD=str(512 * 1024),
+                          HOROVOD_FUSION_BUFFER_SLOTS='1',
+                          HOROVOD_NUM_NCCL_STREAMS='4', HOROVOD_CYCLE_TIME='1',
+                          HOROVOD_BUFFER_MEMORY_BUDGET=str(1 << 20),
+                          HOROVOD_BUFFER_IDLE_CYCLES='20')
+        size = hvd.size()
+        budget = 1 << 20
+
+        devices = [torch.device('cpu')]
+        if torch.cuda.is_available():
+            devices.append(torch.device('cuda', hvd.local_rank()))
+
+        for device in devices:
+            max_bytes = 0
+            for step in range(10):
+                tensors = [torch.FloatTensor(1000).fill_(step + i).to(device)
+                           for i in range(8)]
+                handles = [hvd.allreduce_async(tensor, average=False,
+                                               name='budget.%s.%d' % (device.type, i))
+                           for i, tensor in enumerate(tensors)]
+                for tensor, handle in zip(tensors, handles):
+                    assert hvd.synchronize(handle).equal(tensor * size)
+                max_bytes = max(max_bytes,
+                                hvd.stats()['fusion_buffers']['bytes'])
+            assert 0 < max_bytes <= budget, max_bytes
+
+            # Let the buffers go idle.
+            deadline = time.time() + 30
+            while hvd.stats()['fusion_buffers']['bytes'] > 0:
+                assert time.time() < deadline, hvd.stats()['fusion_buffers']
+                time.sleep(0.1)
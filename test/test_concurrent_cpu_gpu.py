@@ -0,0 +1,67 @@
+# Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+import torch
+
+import horovod.torch as hvd
+
+from common import EnvTestCase
+
+
+class ConcurrentCPUGPUTests(EnvTestCase):
+    """
+    Tests for HOROVOD_CONCURRENT_CPU_GPU.
+    """
+
+    def test_concurrent_cpu_gpu_allreduce(self):
+        """Test that host and GPU allreduces negotiated in the same cycle,
+        whose NCCL allreduces are enqueued on a worker while the background
+        thread runs the host ones, both produce correct sums."""
+        if not torch.cuda.is_available():
+            self.skipTest('CUDA is not available')
+
+        # A long cycle puts the tensors of a step in the same response list.
+        self.init_horovod(hvd, HOROVOD_CONCURRENT_CPU_GPU='1',
+                          HOROVOD_CYCLE_TIME='50')
+        rank = hvd.rank()
+        size = hvd.size()
+        device = torch.device('cuda', hvd.local_rank() % torch.cuda.device_count())
+        expected = size * (size + 1) / 2
+
+        for step in range(3):
+            cpu_tensors = [torch.ones(1000) * (rank + 1) * (i + 1)
+                           for i in range(4)]
+            gpu_tensors = [torch.ones(1000, device=device) * (rank + 1) * (i + 1)
+                           for i in range(4)]
+            handles = []
+            for i in range(4):
+                handles.append(hvd.allreduce_async(
+                    cpu_tensors[i], average=False,
+                    name='concurrent.cpu.%d' % i))
+                handles.append(hvd.allreduce_async(
+                    gpu_tensors[i], average=False,
+                    name='concurrent.gpu.%d' % i))
+            for i in range(4):
+                summed_cpu = hvd.synchronize(handles[2 * i])
+                summed_gpu = hvd.synchronize(handles[2 * i + 1])
+                assert summed_cpu.equal(
+                    torch.ones(1000) * expected * (i + 1)), (step, i)
+                assert summed_gpu.device == device
+                assert summed_gpu.equal(
+                    torch.ones(1000, device=device) * expected * (i + 1)), (step, i)
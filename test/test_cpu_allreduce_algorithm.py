@@ -0,0 +1,53 @@
+# Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+import torch
+
+import horovod.torch as hvd
+
+from common import EnvTestCase
+
+
+class CPUAllreduceAlgorithmTests(EnvTestCase):
+    """
+    Tests for HOROVOD_CPU_ALLREDUCE_LATENCY_THRESHOLD.
+    """
+
+    def test_latency_optimized_allreduce(self):
+        """Test that allreduce of buffers below the latency threshold, which
+        are reduced by recursive doubling or bcube, returns the sums for single
+        and fused tensors of all types."""
+        self.init_horovod(
+            hvd, HOROVOD_CPU_ALLREDUCE_LATENCY_THRESHOLD=str(1 << 30))
+        size = hvd.size()
+
+        dtypes = [torch.IntTensor, torch.LongTensor,
+                  torch.FloatTensor, torch.DoubleTensor, torch.HalfTensor]
+        torch.manual_seed(1234)
+        for dtype in dtypes:
+            tensors = [torch.FloatTensor(*([17] * dim)).random_(-8, 8).type(dtype)
+                       for dim in [1, 2, 3]]
+            handles = [hvd.allreduce_async(tensor, average=False,
+                                           name='latency_%s_%d' % (dtype.__name__, i))
+                       for i, tensor in enumerate(tensors)]
+            summed = hvd.allreduce(tensors[0], average=False,
+                                   name='latency_%s_single' % dtype.__name__)
+            assert summed.float().equal(tensors[0].float() * size)
+            for tensor, handle in zip(tensors, handles):
+                assert hvd.synchronize(handle).float().equal(tensor.float() * size)
@@ -0,0 +1,51 @@
+# Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+import torch
+
+import horovod.torch as hvd
+
+from common import EnvTestCase
+
+
+class CPUCompressionTests(EnvTestCase):
+    """
+    Tests for HOROVOD_CPU_COMPRESSION.
+    """
+
+    def test_cpu_compression(self):
+        """Test that float32 allreduce compressed to bfloat16 on the wire
+        returns float32 sums, for single and fused tensors."""
+        self.init_horovod(hvd, HOROVOD_CPU_COMPRESSION='bf16')
+        size = hvd.size()
+
+        # Small integers and their sums are exact in bfloat16.
+        torch.manual_seed(1234)
+        tensors = [torch.FloatTensor(*([17] * dim)).random_(-8, 8)
+                   for dim in [1, 2, 3]]
+        handles = [hvd.allreduce_async(tensor, average=False,
+                                       name='compressed_%d' % i)
+                   for i, tensor in enumerate(tensors)]
+        summed = hvd.allreduce(tensors[0], average=False,
+                               name='compressed_single')
+        assert summed.dtype == torch.float32
+        assert summed.equal(tensors[0] * size)
+        for tensor, handle in zip(tensors, handles):
+            assert hvd.synchronize(handle).equal(tensor * size)
+
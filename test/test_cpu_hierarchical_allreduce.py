@@ -0,0 +1,52 @@
+# Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+import torch
+
+import horovod.torch as hvd
+
+from common import EnvTestCase
+
+
+class CPUHierarchicalAllreduceTests(EnvTestCase):
+    """
+    Tests for HOROVOD_HIERARCHICAL_ALLREDUCE with tensors in host memory.
+    """
+
+    def test_hierarchical_allreduce(self):
+        """Test that the hierarchical allreduce returns the sums for single and
+        fused tensors, including ones with fewer elements than local ranks."""
+        self.init_horovod(hvd, HOROVOD_HIERARCHICAL_ALLREDUCE='1')
+        size = hvd.size()
+
+        dtypes = [torch.IntTensor, torch.LongTensor,
+                  torch.FloatTensor, torch.DoubleTensor]
+        torch.manual_seed(1234)
+        for dtype in dtypes:
+            tensors = [torch.FloatTensor(*([17] * dim)).random_(-100, 100).type(dtype)
+                       for dim in [1, 2, 3]]
+            tensors.append(torch.FloatTensor([3]).type(dtype))
+            handles = [hvd.allreduce_async(tensor, average=False,
+                                           name='hierarchical_%s_%d' % (dtype.__name__, i))
+                       for i, tensor in enumerate(tensors)]
+            for tensor in tensors:
+                summed = hvd.allreduce(tensor, average=False)
+                assert summed.equal(tensor * size)
+            for tensor, handle in zip(tensors, handles):
+                assert hvd.synchronize(handle).equal(tensor * size)
@@ -0,0 +1,55 @@
+# Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+import torch
+
+import horovod.torch as hvd
+
+from common import EnvTestCase
+
+
+class GradientAccumulationTests(EnvTestCase):
+    """
+    Tests for HOROVOD_GRADIENT_ACCUMULATION_STEPS.
+    """
+
+    def test_gradient_accumulation(self):
+        """Test that only the tensors that opt in are summed locally over the
+        accumulated steps, and the others are allreduced every step."""
+        self.init_horovod(hvd, HOROVOD_GRADIENT_ACCUMULATION_STEPS='2')
+        size = hvd.size()
+
+        for step in range(4):
+            grad = torch.FloatTensor(17).fill_(step + 1)
+            loss = torch.FloatTensor(1).fill_(step + 1)
+            grad_handle = hvd.allreduce_async(grad, op=hvd.Sum,
+                                              name='accumulated.grad',
+                                              accumulate=True)
+            loss_handle = hvd.allreduce_async(loss, op=hvd.Sum,
+                                              name='accumulated.loss')
+            summed_grad = hvd.synchronize(grad_handle)
+            summed_loss = hvd.synchronize(loss_handle)
+
+            assert summed_loss.equal(loss * size), step
+            if step % 2 == 0:
+                # The first step of two only holds the local tensor.
+                assert summed_grad.equal(grad), step
+            else:
+                expected = torch.FloatTensor(17).fill_((2 * step + 1) * size)
+                assert summed_grad.equal(expected), step
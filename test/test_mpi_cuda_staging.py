@@ -0,0 +1,58 @@
+# Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+import torch
+
+import horovod.torch as hvd
+
+from common import EnvTestCase
+
+
+class MPICUDAStagingTests(EnvTestCase):
+    """
+    Tests for MPI allreduce of GPU tensors staged through host memory.
+    """
+
+    def test_staged_allreduce(self):
+        """Test that GPU allreduce staged in chunks through pinned host memory
+        returns the sums for single and fused tensors."""
+        if not torch.cuda.is_available():
+            self.skipTest('CUDA is not available')
+
+        # Small chunks split most tensors into several of them.
+        self.init_horovod(hvd, HOROVOD_MPI_CUDA_AWARE='0',
+                          HOROVOD_MPI_CUDA_CHUNK_SIZE='4096')
+        size = hvd.size()
+        device = torch.device('cuda', hvd.local_rank())
+
+        dtypes = [torch.cuda.IntTensor, torch.cuda.FloatTensor,
+                  torch.cuda.DoubleTensor]
+        torch.manual_seed(1234)
+        for dtype in dtypes:
+            tensors = [torch.FloatTensor(*([17] * dim)).random_(-100, 100).type(dtype)
+                       for dim in [1, 2, 3]]
+            tensors = [tensor.to(device) for tensor in tensors]
+            handles = [hvd.allreduce_async(tensor, average=False,
+                                           name='staged_%s_%d' % (dtype.__name__, i))
+                       for i, tensor in enumerate(tensors)]
+            for tensor in tensors:
+                summed = hvd.allreduce(tensor, average=False)
+                assert summed.equal(tensor * size)
+            for tensor, handle in zip(tensors, handles):
+                assert hvd.synchronize(handle).equal(tensor * size)
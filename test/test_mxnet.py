@@ -89,6 +89,46 @@ class MXTests(unittest.TestCase):
             assert max_difference <= threshold, 'hvd.allreduce produces \
                                                  incorrect results'
 
+    def test_horovod_grouped_allreduce(self):
+        """Test that the grouped allreduce correctly sums and averages a list
+        of 1D, 2D, 3D tensors."""
+        hvd.init()
+        size = hvd.size()
+        dtypes = self.filter_supported_types(['int32',   'int64',
+                                              'float32', 'float64'])
+        ctx = self._current_context()
+        shapes = [(17), (17, 17), (17, 17, 17)]
+        for dtype in dtypes:
+            mx.random.seed(1234, ctx=ctx)
+            tensors = [mx.nd.random.uniform(-100, 100, shape=shape,
+                                            ctx=ctx).astype(dtype)
+                       for shape in shapes]
+            summed = hvd.grouped_allreduce(tensors, average=False,
+                                           name='grouped_' + dtype)
+            averaged = hvd.grouped_allreduce(tensors, average=True,
+                                             name='grouped_avg_' + dtype)
+
+            if size <= 3 or dtype in ['int32', 'int64']:
+                threshold = 0
+            elif size < 10:
+                threshold = 1e-4
+            elif size < 15:
+                threshold = 5e-4
+            else:
+                break
+
+            for tensor, s, a in zip(tensors, summed, averaged):
+                assert s.shape == tensor.shape
+                max_difference = mx.nd.max(mx.nd.abs(
+                    mx.nd.subtract(s, tensor * size)))
+                assert max_difference <= threshold, \
+                    'hvd.grouped_allreduce produces incorrect results'
+                if dtype not in ['int32', 'int64']:
+                    max_difference = mx.nd.max(mx.nd.abs(
+                        mx.nd.subtract(a, tensor)))
+                    assert max_difference <= threshold, \
+                        'hvd.grouped_allreduce produces incorrect averages'
+
     def test_horovod_allreduce_average(self):
         """Test that the allreduce correctly sums 1D, 2D, 3D tensors."""
         hvd.init()
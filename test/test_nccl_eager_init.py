@@ -0,0 +1,56 @@
+# Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+import torch
+
+import horovod.torch as hvd
+
+from common import EnvTestCase
+
+
+class NCCLEagerInitTests(EnvTestCase):
+    """
+    Tests for NCCL communicators created at initialization.
+    """
+
+    def test_eager_init_collectives(self):
+        """Test that allreduce, allgather and broadcast of GPU tensors on the
+        device of the local rank work with eagerly created communicators."""
+        if not torch.cuda.is_available():
+            self.skipTest('CUDA is not available')
+
+        self.init_horovod(hvd, HOROVOD_NCCL_EAGER_INIT='1',
+                          HOROVOD_NUM_NCCL_STREAMS='2')
+        rank = hvd.rank()
+        size = hvd.size()
+        device = torch.device('cuda', hvd.local_rank() % torch.cuda.device_count())
+
+        # Two steps use both streams.
+        for step in range(2):
+            tensor = torch.ones(17, device=device) * (rank + 1)
+            summed = hvd.allreduce(tensor, average=False, name='eager_%d' % step)
+            assert summed.equal(torch.ones(17, device=device) * size * (size + 1) / 2)
+
+        gathered = hvd.allgather(torch.ones(2, 3, device=device) * rank)
+        assert list(gathered.shape) == [2 * size, 3]
+        for r in range(size):
+            assert gathered[2 * r:2 * (r + 1)].eq(r).all()
+
+        broadcasted = hvd.broadcast(torch.ones(5, device=device) * rank, root_rank=0)
+        assert broadcasted.eq(0).all()
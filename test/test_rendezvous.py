@@ -0,0 +1,94 @@
+# Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+import collections
+import threading
+import time
+import unittest
+
+from six.moves import http_client
+
+from horovod.run.rendezvous.http_server import RendezvousServer
+
+SlotInfo = collections.namedtuple(
+    'SlotInfo', ['size', 'local_size', 'cross_size', 'local_rank', 'cross_rank'])
+
+
+def parse_scope(body):
+    """Splits a batched GET response into a dict of keys to values."""
+    result = {}
+    pos = 0
+    while pos < len(body):
+        line_end = body.index(b'\n', pos)
+        key_len, value_len = [int(n) for n in body[pos:line_end].split()]
+        pos = line_end + 1
+        key = body[pos:pos + key_len].decode('utf-8')
+        result[key] = body[pos + key_len:pos + key_len + value_len]
+        pos += key_len + value_len
+    return result
+
+
+class RendezvousTests(unittest.TestCase):
+    """
+    Tests for the Gloo rendezvous HTTP server.
+    """
+
+    def setUp(self):
+        self.server = RendezvousServer(verbose=False)
+        self.port = self.server.start_server(
+            [SlotInfo(2, 2, 1, local_rank, 0) for local_rank in range(2)])
+
+    def request(self, method, path, body=None):
+        conn = http_client.HTTPConnection('localhost', self.port)
+        conn.request(method, '/global_/' + path, body)
+        response = conn.getresponse()
+        result = response.status, response.read()
+        conn.close()
+        return result
+
+    def test_batched_get(self):
+        """Test that the batched GET returns all keys of the scope, with values
+        containing newlines and null bytes."""
+        self.assertEqual(self.request('PUT', 'rank_0', b'a\nb\x00')[0], 200)
+        self.assertEqual(self.request('PUT', 'rank_1', b'')[0], 200)
+
+        status, body = self.request('GET', '?keys=rank_0&timeout=0')
+        self.assertEqual(status, 200)
+        self.assertEqual(parse_scope(body), {'rank_0': b'a\nb\x00', 'rank_1': b''})
+        self.assertEqual(self.request('GET', 'rank_0'), (200, b'a\nb\x00'))
+
+    def test_batched_get_waits(self):
+        """Test that the batched GET waits for missing keys, and returns what is
+        set when it times out."""
+        self.request('PUT', 'rank_0', b'0')
+
+        start = time.time()
+        status, body = self.request('GET', '?keys=rank_0,rank_1&timeout=200')
+        self.assertEqual(status, 200)
+        self.assertEqual(parse_scope(body), {'rank_0': b'0'})
+        self.assertGreaterEqual(time.time() - start, 0.2)
+
+        timer = threading.Timer(0.2, self.request, ('PUT', 'rank_1', b'1'))
+        timer.start()
+        status, body = self.request('GET', '?keys=rank_0,rank_1&timeout=10000')
+        timer.join()
+        self.assertEqual(parse_scope(body), {'rank_0': b'0', 'rank_1': b'1'})
+
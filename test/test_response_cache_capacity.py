@@ -0,0 +1,62 @@
+# Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+import torch
+
+import horovod.torch as hvd
+
+from common import EnvTestCase
+
+
+def _cache_hits():
+    for line in hvd.metrics().splitlines():
+        if line.startswith('horovod_response_cache_hits_total '):
+            return int(line.split()[1])
+    return 0
+
+
+class ResponseCacheCapacityTests(EnvTestCase):
+    """
+    Tests for HOROVOD_CACHE_CAPACITY_MAX.
+    """
+
+    def test_cache_capacity_grows(self):
+        """Test that the response cache grows to hold more tensors than its
+        initial capacity, and that the cached tensors keep being reduced
+        correctly on all ranks as it does."""
+        num_tensors = 16
+        self.init_horovod(hvd, HOROVOD_CACHE_CAPACITY='4',
+                          HOROVOD_CACHE_CAPACITY_MAX='64')
+        size = hvd.size()
+
+        hits = []
+        for step in range(20):
+            tensors = [torch.FloatTensor(17).fill_(i + step)
+                       for i in range(num_tensors)]
+            handles = [hvd.allreduce_async(tensor, op=hvd.Sum,
+                                           name='capacity.%d' % i)
+                       for i, tensor in enumerate(tensors)]
+            for tensor, handle in zip(tensors, handles):
+                summed = hvd.synchronize(handle)
+                assert summed.equal(tensor * size), step
+            hits.append(_cache_hits())
+
+        # Evicted before they are used again at the initial capacity, all
+        # tensors are cached once the capacity has grown.
+        assert hits[-1] - hits[-2] >= num_tensors, hits
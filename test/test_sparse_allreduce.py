@@ -0,0 +1,52 @@
+# Copyright 2019 Uber Technologies, Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+import os
+import torch
+
+import horovod.torch as hvd
+
+from common import EnvTestCase
+
+
+class SparseAllreduceTests(EnvTestCase):
+    """
+    Tests for HOROVOD_SPARSE_ALLREDUCE_RATIO.
+    """
+
+    def test_sparse_allreduce(self):
+        """Test that the top-k allreduce sums the largest elements and sends
+        the rest in later steps."""
+        if 'MLSL_ROOT' in os.environ:
+            self.skipTest('MLSL allreduces densely')
+        self.init_horovod(hvd, HOROVOD_SPARSE_ALLREDUCE_RATIO='0.1')
+        size = hvd.size()
+
+        tensor = torch.arange(1, 101, dtype=torch.float32)
+        summed = hvd.allreduce(tensor, average=False, name='sparse')
+        expected = torch.zeros(100)
+        expected[90:] = tensor[90:] * size
+        assert summed.equal(expected), summed
+
+        # The residuals of the first step are sent next, largest first.
+        summed = hvd.allreduce(torch.zeros(100), average=False,
+                               name='sparse')
+        expected = torch.zeros(100)
+        expected[80:90] = tensor[80:90] * size
+        assert summed.equal(expected), summed
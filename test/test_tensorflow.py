@@ -149,6 +149,50 @@ class MPITests(tf.test.TestCase):
             self.assertTrue(diff <= threshold,
                             "hvd.allreduce produces incorrect results")
 
+    def test_horovod_allreduce_cpu_in_place(self):
+        """Test on CPU that an allreduce reducing its input in place gives the
+        sum, and that inputs used by other ops are left unchanged."""
+        hvd.init()
+        size = hvd.size()
+        with tf.device("/cpu:0"):
+            base = tf.cast(tf.range(17), tf.float32)
+            # Only used by the allreduce, so its buffer may be forwarded.
+            summed = hvd.allreduce(base * 2, average=False)
+            # Also used after the allreduce, so it must not be reduced in
+            # place.
+            kept = base + 1
+            summed_kept = hvd.allreduce(kept, average=False)
+            kept_after = kept * 1
+        summed, summed_kept, kept_after, base = self.evaluate(
+            [summed, summed_kept, kept_after, base])
+        self.assertTrue(np.array_equal(summed, base * 2 * size),
+                        "hvd.allreduce produces incorrect results in place")
+        self.assertTrue(np.array_equal(summed_kept, (base + 1) * size),
+                        "hvd.allreduce produces incorrect results")
+        self.assertTrue(np.array_equal(kept_after, base + 1),
+                        "hvd.allreduce modified an input used by another op")
+
+    def test_horovod_allreduce_cpu_min_max(self):
+        """Test on CPU that the allreduce takes the elementwise minimum and
+        maximum of the tensors of the ranks."""
+        hvd.init()
+        rank = hvd.rank()
+        size = hvd.size()
+        dtypes = self.filter_supported_types([tf.int32, tf.int64, tf.float32, tf.float64])
+        for dtype in dtypes:
+            with tf.device("/cpu:0"):
+                base = tf.cast(tf.range(-8, 9), dtype)
+                tensor = base + tf.cast(rank, dtype)
+                minimum = hvd.allreduce(tensor, op=hvd.Min)
+                maximum = hvd.allreduce(tensor, op=hvd.Max)
+            min_difference = tf.reduce_max(tf.abs(minimum - base))
+            max_difference = tf.reduce_max(
+                tf.abs(maximum - base - tf.cast(size - 1, dtype)))
+            self.assertEqual(self.evaluate(min_difference), 0,
+                             "hvd.allreduce produces incorrect minimums")
+            self.assertEqual(self.evaluate(max_difference), 0,
+                             "hvd.allreduce produces incorrect maximums")
+
     def test_horovod_allreduce_cpu_fused(self):
         """Test on CPU that the allreduce correctly sums 1D, 2D, 3D tensors
         with Tensor Fusion."""
@@ -311,6 +355,35 @@ class MPITests(tf.test.TestCase):
             self.assertTrue(diff <= threshold,
                             "hvd.allreduce on GPU produces incorrect results")
 
+    def test_horovod_allreduce_indexed_slices(self):
+        """Test that the allreduce of tf.IndexedSlices gathers the values and
+        indices of all ranks, and sums duplicates with sparse_dedup."""
+        hvd.init()
+        rank = hvd.rank()
+        size = hvd.size()
+
+        for dtype in [tf.float16, tf.float32, tf.float64, tf.int32]:
+            values = tf.cast(tf.ones([2, 3]) * (rank + 1), dtype)
+            indices = tf.constant([0, rank + 1], dtype=tf.int64)
+            slices = tf.IndexedSlices(values, indices,
+                                      dense_shape=tf.constant([size + 1, 3]))
+            reduced = hvd.allreduce(slices, average=False)
+            gathered_values, gathered_indices = self.evaluate(
+                [reduced.values, reduced.indices])
+            self.assertEqual(list(gathered_values.shape), [2 * size, 3])
+            for i in range(size):
+                self.assertEqual(list(gathered_indices[2 * i:2 * i + 2]),
+                                 [0, i + 1])
+                self.assertTrue((gathered_values[2 * i:2 * i + 2] == i + 1).all(),
+                                "hvd.allreduce produces incorrect values")
+
+            deduped = hvd.allreduce(slices, average=False, sparse_dedup=True)
+            deduped_values, deduped_indices = self.evaluate(
+                [deduped.values, deduped.indices])
+            self.assertEqual(list(deduped_indices), list(range(size + 1)))
+            self.assertTrue((deduped_values[0] == size * (size + 1) // 2).all(),
+                            "hvd.allreduce does not sum duplicate indices")
+
     def test_horovod_allreduce_error(self):
         """Test that the allreduce raises an error if different ranks try to
         send tensors of different rank or dimension."""
@@ -17,6 +17,7 @@ from __future__ import absolute_import
 from __future__ import division
 from __future__ import print_function
 
+import os
 import tempfile
 import time
 import torch
@@ -24,6 +25,7 @@ import unittest
 import warnings
 
 import horovod.torch as hvd
+from horovod.common import timeline
 from horovod.common.util import env
 
 
@@ -54,3 +56,63 @@ class TimelineTests(unittest.TestCase):
                         assert 'NEGOTIATE_ALLREDUCE' in timeline_text, timeline_text
                         assert 'ALLREDUCE' in timeline_text, timeline_text
                         assert 'CYCLE_START' in timeline_text, timeline_text
+
+    def test_convert_binary_timeline(self):
+        def name(name_id, value):
+            value = value.encode('utf-8')
+            return timeline.RECORD.pack(0, name_id, -1, -1, timeline.NAME,
+                                        b' ', len(value)) + value
+
+        def event(ts, name_id, phase, op_id=-1, args_id=-1):
+            return timeline.RECORD.pack(ts, name_id, op_id, args_id,
+                                        timeline.EVENT, phase, 0)
+
+        tmpdir = tempfile.mkdtemp()
+        binary_path = os.path.join(tmpdir, 'timeline.bin')
+        json_path = os.path.join(tmpdir, 'timeline.json')
+        with open(binary_path, 'wb') as f:
+            f.write(timeline.MAGIC)
+            f.write(name(0, 'allreduce.test_allreduce'))
+            f.write(name(1, 'NEGOTIATE_ALLREDUCE'))
+            f.write(event(1, 0, b'B', op_id=1))
+            f.write(event(2, 0, b'E'))
+            f.write(name(2, 'CYCLE_START'))
+            f.write(timeline.RECORD.pack(3, 2, -1, -1, timeline.MARKER, b' ', 0))
+            # A truncated trailing record is ignored.
+            f.write(event(4, 0, b'B')[:10])
+
+        timeline.convert(binary_path, json_path)
+        with open(json_path, 'r') as tf:
+            timeline_text = tf.read()
+        assert '"args": {"name": "allreduce.test_allreduce"}' in timeline_text, timeline_text
+        assert '{"ph": "B", "name": "NEGOTIATE_ALLREDUCE", "ts": 1, "pid": 1}' in timeline_text, \
+            timeline_text
+        assert '{"ph": "E", "ts": 2, "pid": 1}' in timeline_text, timeline_text
+        assert '"name": "CYCLE_START", "ts": 3' in timeline_text, timeline_text
+        assert '"ts": 4' not in timeline_text, timeline_text
+
+    def test_merge_timeline_shards(self):
+        tmpdir = tempfile.mkdtemp()
+        shard_prefix = os.path.join(tmpdir, 'timeline')
+        with open(shard_prefix + '.0', 'wb') as f:
+            f.write(timeline.MAGIC)
+            name = b'allreduce.test_allreduce'
+            f.write(timeline.RECORD.pack(0, 0, -1, -1, timeline.NAME, b' ', len(name)) + name)
+            f.write(timeline.RECORD.pack(1, 0, -1, -1, timeline.EVENT, b'B', 0))
+            f.write(timeline.RECORD.pack(2, 0, -1, -1, timeline.EVENT, b'E', 0))
+        with open(shard_prefix + '.1', 'w') as f:
+            f.write('[\n')
+            f.write('{"name": "process_name", "ph": "M", "pid": 1, '
+                    '"args": {"name": "allreduce.test_allreduce"}},\n')
+            f.write('{"ph": "B", "name": "WAIT_FOR_DATA", "ts": 3, "pid": 1},\n')
+            f.write('{"ph": "E", "ts": 4, "pid": 1},\n')
+
+        json_path = os.path.join(tmpdir, 'merged.json')
+        timeline.merge([shard_prefix + '.1', shard_prefix + '.0'], json_path)
+        with open(json_path, 'r') as tf:
+            timeline_text = tf.read()
+        assert timeline_text.count('"name": "process_name"') == 1, timeline_text
+        assert '"tid": 0, "args": {"name": "rank 0"}' in timeline_text, timeline_text
+        assert '"tid": 1, "args": {"name": "rank 1"}' in timeline_text, timeline_text
+        assert '{"ph": "E", "ts": 2, "pid": 1, "tid": 0}' in timeline_text, timeline_text
+        assert '"WAIT_FOR_DATA", "ts": 3, "pid": 1, "tid": 1}' in timeline_text, timeline_text
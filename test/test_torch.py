@@ -35,6 +35,7 @@ import horovod.torch as hvd
 from common import mpi_env_rank_and_size
 
 _fp16_supported = LooseVersion(torch.__version__) >= LooseVersion('1.0.0')
+_bf16_supported = LooseVersion(torch.__version__) >= LooseVersion('1.3.0')
 
 # MLSL supports only byte, float and double data types
 mlsl_supported_types = set([torch.FloatTensor, torch.DoubleTensor])
@@ -100,6 +101,26 @@ class TorchTests(unittest.TestCase):
         else:
             assert gloo_size == size
 
+    def test_horovod_reset(self):
+        """Test that hvd.reset() keeps the rank and size of an unchanged job with Gloo, and fails with MPI."""
+        hvd.init()
+        rank, size = hvd.rank(), hvd.size()
+        if hvd.mpi_enabled() or not hvd.gloo_enabled():
+            with self.assertRaises(RuntimeError):
+                hvd.reset()
+            return
+
+        # Rendezvous again under a new generation of keys.
+        generation = int(os.environ.get('HOROVOD_GLOO_RENDEZVOUS_GENERATION', '0')) + 1
+        os.environ['HOROVOD_GLOO_RENDEZVOUS_GENERATION'] = str(generation)
+        hvd.reset()
+        assert hvd.rank() == rank
+        assert hvd.size() == size
+
+        tensor = torch.ones(17)
+        summed = hvd.allreduce(tensor, average=False, name='test_horovod_reset')
+        assert summed.equal(tensor * size)
+
     def test_horovod_allreduce(self):
         """Test that the allreduce correctly sums 1D, 2D, 3D tensors."""
         hvd.init()
@@ -137,6 +158,24 @@ class TorchTests(unittest.TestCase):
 
             assert max_difference <= threshold, 'hvd.allreduce produces incorrect results'
 
+    def test_horovod_allreduce_bfloat16(self):
+        """Test that the allreduce correctly sums bfloat16 tensors."""
+        if not _bf16_supported or 'MLSL_ROOT' in os.environ:
+            self.skipTest('bfloat16 is not supported')
+        hvd.init()
+        size = hvd.size()
+
+        # Small integers and their sums are exact in bfloat16.
+        dims = [1, 2, 3]
+        for dim in dims:
+            torch.manual_seed(1234)
+            tensor = torch.FloatTensor(*([17] * dim)).random_(-8, 8)
+            summed = hvd.allreduce(tensor.type(torch.BFloat16Tensor),
+                                   average=False)
+            assert summed.dtype == torch.bfloat16
+            max_difference = summed.float().sub(tensor * size).abs().max()
+            assert max_difference == 0, 'hvd.allreduce produces incorrect results'
+
     def test_horovod_allreduce_average(self):
         """Test that the allreduce correctly sums 1D, 2D, 3D tensors."""
         hvd.init()
@@ -170,6 +209,163 @@ class TorchTests(unittest.TestCase):
 
             assert max_difference <= threshold, 'hvd.allreduce produces incorrect results'
 
+    def test_horovod_allreduce_prescale_postscale(self):
+        """Test that the allreduce applies the scale factors to fused and
+        unfused tensors."""
+        hvd.init()
+        size = hvd.size()
+        dtypes = self.filter_supported_types([torch.FloatTensor, torch.DoubleTensor])
+        if torch.cuda.is_available():
+            dtypes += [torch.cuda.FloatTensor, torch.cuda.DoubleTensor]
+        dims = [1, 2, 3]
+        for dtype, dim in itertools.product(dtypes, dims):
+            torch.manual_seed(1234)
+            tensors = [self.cast_and_place(
+                torch.FloatTensor(*([17] * dim)).random_(-100, 100), dtype)
+                for _ in range(3)]
+            handles = [hvd.allreduce_async(tensor, average=False,
+                                           name='scaled_%s_%d_%d' % (dtype, dim, i),
+                                           prescale_factor=0.5, postscale_factor=4.0)
+                       for i, tensor in enumerate(tensors)]
+            for tensor, handle in zip(tensors, handles):
+                scaled = hvd.synchronize(handle)
+                expected = tensor * (2.0 * size)
+                max_difference = scaled.data.sub(expected).abs().max()
+                assert max_difference <= 1e-4 * size, \
+                    'hvd.allreduce produces incorrect scaled results'
+
+            averaged = hvd.allreduce(tensors[0], average=True, prescale_factor=2.0)
+            max_difference = averaged.data.sub(tensors[0] * 2.0).abs().max()
+            assert max_difference <= 1e-4 * size, \
+                'hvd.allreduce produces incorrect scaled averages'
+
+    def test_horovod_allreduce_adasum(self):
+        """Test that Adasum returns identical tensors unchanged and sums
+        orthogonal ones."""
+        hvd.init()
+        if not hvd.mpi_enabled():
+            # Adasum is only implemented with MPI.
+            return
+        rank = hvd.rank()
+        size = hvd.size()
+        dtypes = self.filter_supported_types([torch.FloatTensor, torch.DoubleTensor])
+        for dtype in dtypes:
+            torch.manual_seed(1234)
+            tensor = torch.FloatTensor(37).uniform_(-1, 1).type(dtype)
+            reduced = hvd.allreduce(tensor, name='adasum_same_%s' % dtype,
+                                    op=hvd.Adasum)
+            max_difference = reduced.sub(tensor).abs().max()
+            assert max_difference <= 1e-5, \
+                'hvd.allreduce with Adasum changes identical tensors'
+
+            # Disjoint supports on every rank make the tensors orthogonal.
+            tensor = torch.zeros(4 * size).type(dtype)
+            tensor[4 * rank:4 * rank + 4] = rank + 1
+            reduced = hvd.allreduce(tensor, name='adasum_orthogonal_%s' % dtype,
+                                    op=hvd.Adasum)
+            expected = torch.FloatTensor([i // 4 + 1 for i in range(4 * size)]).type(dtype)
+            max_difference = reduced.sub(expected).abs().max()
+            assert max_difference <= 1e-5, \
+                'hvd.allreduce with Adasum does not sum orthogonal tensors'
+
+    def test_horovod_allreduce_min_max_product(self):
+        """Test that the allreduce takes the elementwise minimum, maximum and
+        product of the tensors of the ranks."""
+        hvd.init()
+        rank = hvd.rank()
+        size = hvd.size()
+        dtypes = self.filter_supported_types([torch.IntTensor, torch.LongTensor,
+                     torch.FloatTensor, torch.DoubleTensor])
+        if torch.cuda.is_available():
+            dtypes += [torch.cuda.IntTensor, torch.cuda.LongTensor,
+                       torch.cuda.FloatTensor, torch.cuda.DoubleTensor]
+        for dtype in dtypes:
+            torch.manual_seed(1234)
+            base = torch.FloatTensor(17, 3).random_(-100, 100)
+            tensor = self.cast_and_place(base + rank, dtype)
+            minimum = hvd.allreduce(tensor, name='min_%s' % dtype, op=hvd.Min)
+            maximum = hvd.allreduce(tensor, name='max_%s' % dtype, op=hvd.Max)
+            assert minimum.equal(self.cast_and_place(base, dtype)), \
+                'hvd.allreduce produces incorrect minimums'
+            assert maximum.equal(self.cast_and_place(base + size - 1, dtype)), \
+                'hvd.allreduce produces incorrect maximums'
+
+            factor = 2 if rank % 2 == 0 else -1
+            tensor = self.cast_and_place(torch.ones(17, 3) * factor, dtype)
+            product = hvd.allreduce(tensor, name='product_%s' % dtype,
+                                    op=hvd.Product)
+            expected = 2 ** ((size + 1) // 2) * (-1) ** (size // 2)
+            assert product.equal(self.cast_and_place(torch.ones(17, 3) * expected,
+                                                     dtype)), \
+                'hvd.allreduce produces incorrect products'
+
+    def test_horovod_grouped_allreduce(self):
+        """Test that the grouped allreduce correctly sums a list of tensors of
+        different shapes."""
+        hvd.init()
+        size = hvd.size()
+        dtypes = self.filter_supported_types([torch.IntTensor, torch.LongTensor,
+                     torch.FloatTensor, torch.DoubleTensor])
+        if torch.cuda.is_available():
+            dtypes += [torch.cuda.IntTensor, torch.cuda.LongTensor,
+                       torch.cuda.FloatTensor, torch.cuda.DoubleTensor]
+        for dtype in dtypes:
+            torch.manual_seed(1234)
+            tensors = [self.cast_and_place(
+                torch.FloatTensor(*([17] * dim)).random_(-100, 100), dtype)
+                for dim in [1, 2, 3]]
+            summed = hvd.grouped_allreduce(tensors, average=False,
+                                           name='grouped_%s' % dtype)
+            in_place = [tensor.clone() for tensor in tensors]
+            hvd.grouped_allreduce_(in_place, average=False,
+                                   name='grouped_inplace_%s' % dtype)
+            for tensor, result, result_inplace in zip(tensors, summed, in_place):
+                multiplied = tensor * size
+                assert result.shape == tensor.shape
+                max_difference = result.data.sub(multiplied).abs().max()
+                max_difference_inplace = result_inplace.data.sub(multiplied).abs().max()
+
+                # Threshold for floating point equality depends on number of
+                # ranks, since we're comparing against precise multiplication.
+                if size <= 3 or dtype in [torch.IntTensor, torch.LongTensor,
+                                          torch.cuda.IntTensor, torch.cuda.LongTensor]:
+                    threshold = 0
+                elif size < 10:
+                    threshold = 1e-4
+                elif size < 15:
+                    threshold = 5e-4
+                else:
+                    break
+
+                assert max_difference <= threshold, \
+                    'hvd.grouped_allreduce produces incorrect results'
+                assert max_difference_inplace <= threshold, \
+                    'hvd.grouped_allreduce_ produces incorrect results'
+
+    def test_horovod_grouped_allreduce_error(self):
+        """Test that the grouped allreduce raises an error for tensors of
+        different types."""
+        hvd.init()
+        with self.assertRaises(ValueError):
+            hvd.grouped_allreduce([torch.FloatTensor(4).fill_(1),
+                                   torch.DoubleTensor(4).fill_(1)])
+
+    def test_horovod_synchronize_all_wait_any(self):
+        """Test that synchronize_all returns the outputs of all the handles in
+        order and that wait_any returns a completed handle."""
+        hvd.init()
+        size = hvd.size()
+        tensors = [torch.FloatTensor(8).fill_(i) for i in range(10)]
+        handles = [hvd.allreduce_async(tensor, average=False, name='sync_all_%d' % i)
+                   for i, tensor in enumerate(tensors)]
+        index = hvd.wait_any(handles)
+        assert hvd.poll(handles[index]), 'hvd.wait_any returned a pending handle'
+        outputs = hvd.synchronize_all(handles)
+        assert len(outputs) == len(tensors)
+        for tensor, output in zip(tensors, outputs):
+            assert output.data.sub(tensor * size).abs().max() == 0, \
+                'hvd.synchronize_all produces incorrect results'
+
     def test_horovod_allreduce_inplace(self):
         """Test that the allreduce correctly sums 1D, 2D, 3D tensors."""
         hvd.init()
@@ -207,6 +403,180 @@ class TorchTests(unittest.TestCase):
 
             assert max_difference <= threshold, 'hvd.allreduce produces incorrect results'
 
+    def test_horovod_allreduce_priority(self):
+        """Test that the allreduce correctly sums tensors submitted with
+        different priorities."""
+        hvd.init()
+        size = hvd.size()
+        handles = []
+        for i in range(10):
+            torch.manual_seed(1234 + i)
+            tensor = torch.FloatTensor(17, 17).random_(-100, 100)
+            handle = hvd.allreduce_async(tensor, average=False,
+                                         name='priority.%d' % i, priority=i % 3)
+            handles.append((tensor * size, handle))
+
+        for multiplied, handle in handles:
+            summed = hvd.synchronize(handle)
+            assert torch.allclose(summed, multiplied), \
+                'hvd.allreduce produces incorrect results with priorities'
+
+    def test_horovod_metrics(self):
+        """Test that the metrics count performed collectives."""
+        hvd.init()
+        hvd.allreduce(torch.FloatTensor(17).fill_(1), name='metrics.allreduce')
+        metrics = hvd.metrics()
+        assert 'horovod_collectives_total{type="ALLREDUCE"}' in metrics, metrics
+        assert 'horovod_cycles_total' in metrics, metrics
+
+    def test_horovod_stats(self):
+        """Test that the stats break down the time of performed collectives."""
+        hvd.init()
+        hvd.allreduce(torch.FloatTensor(17).fill_(1), name='stats.allreduce')
+        stats = hvd.stats()
+        assert stats['cycle']['count'] > 0, stats
+        assert stats['negotiation']['count'] > 0, stats
+        assert stats['collective']['bytes'] >= 17 * 4, stats
+        operations = [name for name in stats
+                      if name not in ('cycle', 'negotiation',
+                                      'wait_for_data', 'memcpy',
+                                      'collective', 'fusion_buffers',
+                                      'host_buffers')]
+        assert operations, stats
+        assert sum(stats[name]['count'] for name in operations) > 0, stats
+
+    def test_horovod_stats_buffers(self):
+        """Test that the stats report the memory held in fusion buffers."""
+        hvd.init()
+        handles = [hvd.allreduce_async(torch.FloatTensor(1024).fill_(1),
+                                       name='stats.fused.%d' % i)
+                   for i in range(4)]
+        for handle in handles:
+            hvd.synchronize(handle)
+        usage = hvd.stats()['fusion_buffers']
+        assert usage['total_us'] == 0, usage
+        # Every buffer is at least 1 MB.
+        assert usage['bytes'] >= usage['count'] * (1 << 20), usage
+
+    def test_horovod_set_parameters(self):
+        """Test that parameters set on rank 0 at runtime are applied on all
+        ranks between the same collectives."""
+        hvd.init()
+        size = hvd.size()
+
+        def metric(name):
+            for line in hvd.metrics().splitlines():
+                if line.startswith(name + ' '):
+                    return int(line.split()[1])
+            return 0
+
+        try:
+            if hvd.rank() == 0:
+                hvd.set_parameters(fusion_threshold_bytes=1024,
+                                   cycle_time_ms=1, cache_capacity=0)
+            else:
+                with self.assertRaises(ValueError):
+                    hvd.set_parameters(cycle_time_ms=1)
+
+            # Allreduces before, during and after the change must agree.
+            for i in range(10):
+                if i == 9:
+                    hits = metric('horovod_response_cache_hits_total')
+                    collectives = metric(
+                        'horovod_collectives_total{type="ALLREDUCE"}')
+                tensors = [torch.FloatTensor(1000).fill_(i + j)
+                           for j in range(4)]
+                handles = [hvd.allreduce_async(tensor, average=False,
+                                               name='set_parameters.%d' % j)
+                           for j, tensor in enumerate(tensors)]
+                for j, handle in enumerate(handles):
+                    summed = hvd.synchronize(handle)
+                    assert torch.equal(summed, tensors[j] * size), (i, j)
+
+            # Without a cache nothing is hit, and tensors larger than the
+            # fusion threshold are reduced one by one.
+            assert metric('horovod_response_cache_hits_total') == hits
+            assert metric('horovod_collectives_total{type="ALLREDUCE"}') == \
+                collectives + 4
+        finally:
+            if hvd.rank() == 0:
+                hvd.set_parameters(
+                    fusion_threshold_bytes=int(os.environ.get(
+                        'HOROVOD_FUSION_THRESHOLD', 64 * 1024 * 1024)),
+                    cycle_time_ms=float(os.environ.get(
+                        'HOROVOD_CYCLE_TIME', 5)),
+                    cache_capacity=int(os.environ.get(
+                        'HOROVOD_CACHE_CAPACITY', 1024)))
+            # The defaults are applied on all ranks with the next collective.
+            hvd.allreduce(torch.FloatTensor(1).fill_(1),
+                          name='set_parameters.restore')
+
+    def test_horovod_start_stop_timeline(self):
+        """Test that the timeline records the tensors reduced between
+        starting and stopping it at runtime, and nothing after."""
+        hvd.init()
+        size = hvd.size()
+        fd, fname = tempfile.mkstemp('.json')
+        os.close(fd)
+        try:
+            hvd.start_timeline(fname)
+            for i in range(3):
+                tensor = torch.FloatTensor(100).fill_(i)
+                summed = hvd.allreduce(tensor, average=False,
+                                       name='timeline.recorded')
+                assert torch.equal(summed, tensor * size)
+            hvd.stop_timeline()
+
+            tensor = torch.FloatTensor(100).fill_(1)
+            hvd.allreduce(tensor, average=False, name='timeline.stopped')
+            with open(fname) as f:
+                timeline = f.read()
+            assert 'timeline.recorded' in timeline, timeline
+            assert 'timeline.stopped' not in timeline, timeline
+        finally:
+            os.remove(fname)
+
+    def test_horovod_allreduce_quantized(self):
+        """Test that quantized sums are within two quantization steps of the
+        exact sum."""
+        if 'MLSL_ROOT' in os.environ:
+            self.skipTest('MLSL allreduces densely')
+        hvd.init()
+        size = hvd.size()
+        torch.manual_seed(1234)
+        tensor = torch.rand(4096) * 2 - 1
+        for quantization, levels in [(hvd.Int8, 127), (hvd.Int4, 7)]:
+            summed = hvd.allreduce(tensor, average=False,
+                                   name='quantized.%s' % quantization,
+                                   quantization=quantization)
+            error = (summed - tensor * size).abs().max().item()
+            assert error <= 2.0 * size / levels + 1e-5, error
+
+    def test_horovod_allreduce_quantized_error_feedback(self):
+        """Test that the quantization errors are sent in later steps, so that
+        the sum over steps follows the exact sum."""
+        if 'MLSL_ROOT' in os.environ:
+            self.skipTest('MLSL allreduces densely')
+        hvd.init()
+        size = hvd.size()
+        tensor = torch.full((4096,), 0.01)
+        tensor[0] = 1.0
+        total = torch.zeros(4096)
+        steps = 50
+        for _ in range(steps):
+            total += hvd.allreduce(tensor, average=False, name='feedback',
+                                   quantization=hvd.Int4)
+        # The errors of the workers cancel out over steps, and those of the
+        # sums are unbiased, so the mean is within a fraction of a step.
+        error = (total / steps - tensor * size).abs().max().item()
+        assert error <= 0.5 * size / 7, error
+
+    def test_horovod_allreduce_quantized_unknown(self):
+        """Test that unknown quantizations are rejected."""
+        hvd.init()
+        with self.assertRaises(ValueError):
+            hvd.allreduce(torch.zeros(10), quantization='int2')
+
     def test_horovod_allreduce_async_fused(self):
         """Test that the allreduce correctly sums 1D, 2D, 3D tensors
         with Tensor Fusion."""
@@ -493,6 +863,33 @@ class TorchTests(unittest.TestCase):
                 assert rank_tensor.data.min() == i, 'hvd.allgather produces incorrect gathered tensor'
                 assert rank_tensor.data.max() == i, 'hvd.allgather produces incorrect gathered tensor'
 
+    def test_horovod_allgather_reuse_output(self):
+        """Test that named allgathers of shrinking tensors do not overwrite
+        outputs that are still referenced, and gather into a preallocated
+        output."""
+        hvd.init()
+        size = hvd.size()
+        previous = None
+        for rows in [8, 8, 4, 2]:
+            tensor = torch.FloatTensor(rows, 3).fill_(rows)
+            gathered = hvd.synchronize(hvd.allgather_async(tensor, name='reused_gather'))
+            assert list(gathered.shape) == [rows * size, 3]
+            assert gathered.min() == rows and gathered.max() == rows
+            if previous is not None:
+                prev_rows, prev_gathered = previous
+                assert prev_gathered.min() == prev_rows, \
+                    'hvd.allgather overwrote a referenced output'
+            previous = (rows, gathered)
+
+        output = torch.FloatTensor(8 * size, 3)
+        data_ptr = output.data_ptr()
+        tensor = torch.FloatTensor(5, 3).fill_(1)
+        gathered = hvd.synchronize(hvd.allgather_async(tensor, output=output))
+        assert gathered is output
+        assert list(gathered.shape) == [5 * size, 3]
+        assert gathered.data_ptr() == data_ptr, \
+            'hvd.allgather reallocated a preallocated output'
+
     def test_horovod_allgather_variable_size(self):
         """Test that the allgather correctly gathers 1D, 2D, 3D tensors,
         even if those tensors have different sizes along the first dim."""
@@ -536,6 +933,25 @@ class TorchTests(unittest.TestCase):
                 assert rank_tensor.data.min() == i
                 assert rank_tensor.data.max() == i
 
+    def test_horovod_allgather_cached_size_change(self):
+        """Test that a named allgather answered from the response cache is
+        negotiated again when the first dimension of one rank changes."""
+        hvd.init()
+        rank = hvd.rank()
+        size = hvd.size()
+
+        for step in range(6):
+            # Rank 0 changes its size after three steps, the others do not.
+            sizes = [3 if step < 3 else 5] + [rank_index + 1 for rank_index in range(1, size)]
+            tensor = torch.FloatTensor(sizes[rank], 4).fill_(rank)
+            gathered = hvd.allgather(tensor, name='allgather.cached')
+            assert list(gathered.shape) == [sum(sizes), 4]
+            for i in range(size):
+                rank_tensor = gathered[sum(sizes[:i]):sum(sizes[:i + 1])]
+                assert rank_tensor.shape[0] == sizes[i]
+                assert rank_tensor.data.min() == i
+                assert rank_tensor.data.max() == i
+
     def test_horovod_allgather_error(self):
         """Test that the allgather returns an error if any dimension besides
         the first is different among the tensors being gathered."""
@@ -645,6 +1061,80 @@ class TorchTests(unittest.TestCase):
                             "gradient %s differs from expected %s, "
                             "error: %s" % (grad_out, expected, str(err)))
 
+    def test_horovod_reducescatter(self):
+        """Test that the reducescatter correctly sums and scatters 1D, 2D, 3D tensors."""
+        hvd.init()
+        rank = hvd.rank()
+        size = hvd.size()
+
+        dtypes = [torch.IntTensor, torch.LongTensor,
+                  torch.FloatTensor, torch.DoubleTensor]
+        dims = [1, 2, 3]
+        for dtype, dim in itertools.product(dtypes, dims):
+            # Uneven number of rows, the first ranks get one more.
+            rows = 3 * size + 1
+            torch.manual_seed(1234)
+            tensor = torch.FloatTensor(*([rows] + [17] * (dim - 1))).random_(-100, 100)
+            tensor = self.cast_and_place(tensor, dtype)
+            scattered = hvd.reducescatter(tensor)
+
+            first_row = rank * 3 + min(rank, 1)
+            my_rows = 4 if rank == 0 else 3
+            expected = tensor[first_row:first_row + my_rows] * size
+            assert list(scattered.shape) == [my_rows] + [17] * (dim - 1), \
+                'hvd.reducescatter produces incorrect scattered shape'
+            assert torch.equal(scattered, expected), \
+                'hvd.reducescatter produces incorrect scattered tensor'
+
+    def test_horovod_alltoall(self):
+        """Test that the alltoall correctly distributes 1D, 2D, 3D tensors
+        with uneven splits."""
+        hvd.init()
+        rank = hvd.rank()
+        size = hvd.size()
+
+        dtypes = [torch.ByteTensor, torch.CharTensor, torch.ShortTensor,
+                  torch.IntTensor, torch.LongTensor, torch.FloatTensor, torch.DoubleTensor]
+        dims = [1, 2, 3]
+        for dtype, dim in itertools.product(dtypes, dims):
+            # Rank r sends (i + 1) rows holding r to rank i.
+            splits = [i + 1 for i in range(size)]
+            tensor = torch.FloatTensor(
+                *([sum(splits)] + [17] * (dim - 1))).fill_(1).mul_(rank)
+            tensor = self.cast_and_place(tensor, dtype)
+            received = hvd.alltoall(tensor, splits)
+
+            assert list(received.shape) == [(rank + 1) * size] + [17] * (dim - 1), \
+                'hvd.alltoall produces incorrect received shape'
+            for i in range(size):
+                rank_tensor = received[i * (rank + 1):(i + 1) * (rank + 1)]
+                assert rank_tensor.data.min() == i, 'hvd.alltoall produces incorrect received tensor'
+                assert rank_tensor.data.max() == i, 'hvd.alltoall produces incorrect received tensor'
+
+    def test_horovod_alltoall_even_split(self):
+        """Test that the alltoall splits the first dimension evenly when no
+        splits are given, and that it returns an error if it cannot."""
+        hvd.init()
+        rank = hvd.rank()
+        size = hvd.size()
+
+        tensor = torch.arange(2 * size, dtype=torch.float32) + rank * 2 * size
+        received = hvd.alltoall(tensor)
+        expected = torch.FloatTensor(
+            [i * 2 * size + 2 * rank + j for i in range(size) for j in range(2)])
+        assert torch.equal(received, expected), \
+            'hvd.alltoall produces incorrect received tensor'
+
+        # This error case does not apply if there is only one worker.
+        if size == 1:
+            return
+
+        try:
+            hvd.alltoall(torch.FloatTensor(2 * size + 1).fill_(rank))
+            assert False, 'hvd.alltoall did not throw error'
+        except (torch.FatalError, RuntimeError):
+            pass
+
     def test_horovod_broadcast(self):
         """Test that the broadcast correctly broadcasts 1D, 2D, 3D tensors."""
         hvd.init()
@@ -681,6 +1171,35 @@ class TorchTests(unittest.TestCase):
             assert (broadcasted_tensor.data == root_tensor).min() == 1, \
                 'hvd.broadcast produces incorrect broadcasted tensor'
 
+    def test_horovod_broadcast_async_fused(self):
+        """Test that the broadcast correctly broadcasts many small tensors
+        with Tensor Fusion."""
+        hvd.init()
+        rank = hvd.rank()
+        size = hvd.size()
+
+        # This test does not apply if there is only one worker.
+        if size == 1:
+            return
+
+        dtypes = [torch.IntTensor, torch.FloatTensor, torch.DoubleTensor]
+        root_ranks = list(range(size))
+        tests = []
+        for i, (dtype, root_rank) in enumerate(
+                itertools.product(dtypes * 20, root_ranks)):
+            tensor = torch.FloatTensor(17, i % 5 + 1).fill_(1).mul_(rank)
+            root_tensor = torch.FloatTensor(17, i % 5 + 1).fill_(1).mul_(root_rank)
+            tensor = self.cast_and_place(tensor, dtype)
+            root_tensor = self.cast_and_place(root_tensor, dtype)
+            handle = hvd.broadcast_async(tensor, root_rank,
+                                         name='broadcast.fused.%d' % i)
+            tests.append((root_tensor, handle))
+
+        for root_tensor, handle in tests:
+            broadcasted_tensor = hvd.synchronize(handle)
+            assert (broadcasted_tensor.data == root_tensor).min() == 1, \
+                'hvd.broadcast produces incorrect broadcasted tensor'
+
     def test_horovod_broadcast_inplace(self):
         """Test that the broadcast correctly broadcasts 1D, 2D, 3D tensors."""
         hvd.init()
@@ -834,6 +1353,35 @@ class TorchTests(unittest.TestCase):
                             "gradient %s differs from expected %s, "
                             "error: %s" % (grad_out, expected, str(err)))
 
+    def test_horovod_join(self):
+        """Test that the ranks that did not join allreduce and broadcast
+        with the ranks that joined, which take part with zeros."""
+        hvd.init()
+        rank = hvd.rank()
+        size = hvd.size()
+
+        # This test does not apply if there is only one worker.
+        if size == 1:
+            return
+
+        dtypes = [torch.FloatTensor, torch.DoubleTensor]
+        if torch.cuda.is_available():
+            dtypes += [torch.cuda.FloatTensor, torch.cuda.DoubleTensor]
+        for dtype in dtypes:
+            tensor = self.cast_and_place(torch.FloatTensor(17, 3).fill_(1), dtype)
+            device = tensor.device.index if tensor.is_cuda else -1
+            # The last rank runs out of data first.
+            if rank != size - 1:
+                summed = hvd.allreduce(tensor, average=False, name='join_sum')
+                assert summed.data.min() == size - 1 and summed.data.max() == size - 1, \
+                    'hvd.allreduce produces incorrect results with joined ranks'
+
+                tensor = self.cast_and_place(torch.FloatTensor(17).fill_(rank), dtype)
+                broadcasted = hvd.broadcast(tensor, 0, name='join_bcast')
+                assert broadcasted.data.max() == 0, \
+                    'hvd.broadcast produces incorrect results with joined ranks'
+            hvd.join(device)
+
     def test_broadcast_state(self):
         hvd.init()
 
@@ -1295,6 +1843,42 @@ class TorchTests(unittest.TestCase):
         with optimizer.skip_synchronize():
             optimizer.step()
 
+    def test_horovod_allreduce_mixed_layouts(self):
+        """Test that a fused allreduce is correct when only some ranks hold
+        the tensors back to back in memory."""
+        hvd.init()
+        rank = hvd.rank()
+        size = hvd.size()
+
+        # This test does not apply if there is only one worker.
+        if size == 1:
+            return
+
+        sizes = [17, 5, 33]
+        if rank % 2 == 0:
+            # Slices of one flat buffer, submitted in reverse address order.
+            flat = torch.FloatTensor(sum(sizes))
+            tensors, offset = [], 0
+            for n in sizes:
+                tensors.append(flat[offset:offset + n])
+                offset += n
+        else:
+            tensors = [torch.FloatTensor(n) for n in sizes]
+        for i, tensor in enumerate(tensors):
+            tensor.fill_(rank * 10 + i)
+
+        handles = [hvd.allreduce_async_(tensors[i], average=False,
+                                        name='mixed_layout.%d' % i)
+                   for i in reversed(range(len(tensors)))]
+        for handle in handles:
+            hvd.synchronize(handle)
+
+        base = 10 * size * (size - 1) / 2
+        for i, tensor in enumerate(tensors):
+            expected = torch.FloatTensor(sizes[i]).fill_(base + size * i)
+            assert torch.equal(tensor, expected), \
+                'mixed layout allreduce produces incorrect results'
+
     def test_synchronize_step_warning(self):
         """
         Test that .synchronize() followed by .step() without